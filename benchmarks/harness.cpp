@@ -0,0 +1,193 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Implementation of the benchmark harness
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <regex>
+#include <sstream>
+
+#include "exceptions.h"
+#include "harness.h"
+#include "logging.h"
+
+namespace shark {
+namespace benchmarks {
+
+// Where checksums end up, so no benchmark can be optimised away
+static volatile double checksum_sink = 0;
+
+void BenchmarkSuite::add(const std::string &name, std::size_t operations, const std::function<double()> &run,
+                         const std::function<void()> &setup)
+{
+	benchmarks.push_back({name, std::max(operations, std::size_t(1)), run, setup});
+}
+
+std::vector<std::string> BenchmarkSuite::names(const std::string &filter) const
+{
+	std::regex filter_regex(filter);
+	std::vector<std::string> matching;
+	for (auto &benchmark: benchmarks) {
+		if (std::regex_search(benchmark.name, filter_regex)) {
+			matching.push_back(benchmark.name);
+		}
+	}
+	return matching;
+}
+
+static
+double run_once(const Benchmark &benchmark, double &checksum)
+{
+	if (benchmark.setup) {
+		benchmark.setup();
+	}
+	auto t0 = std::chrono::steady_clock::now();
+	checksum = benchmark.run();
+	auto t1 = std::chrono::steady_clock::now();
+	checksum_sink = checksum;
+	return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+std::vector<BenchmarkResult> BenchmarkSuite::run(const std::string &filter, unsigned int repetitions, unsigned int warmup) const
+{
+	repetitions = std::max(repetitions, 1u);
+	std::regex filter_regex(filter);
+	std::vector<BenchmarkResult> results;
+	for (auto &benchmark: benchmarks) {
+		if (!std::regex_search(benchmark.name, filter_regex)) {
+			continue;
+		}
+
+		double checksum = 0;
+		for (unsigned int i = 0; i != warmup; i++) {
+			run_once(benchmark, checksum);
+		}
+
+		std::vector<double> times(repetitions);
+		for (auto &time: times) {
+			time = run_once(benchmark, checksum) / benchmark.operations;
+		}
+		std::sort(times.begin(), times.end());
+		double median = times[times.size() / 2];
+		if (times.size() % 2 == 0) {
+			median = (median + times[times.size() / 2 - 1]) / 2;
+		}
+
+		LOG(info) << benchmark.name << ": " << median << " [ns/op]";
+		results.push_back({benchmark.name, benchmark.operations, repetitions, median, times.front(), times.back(), checksum});
+	}
+	return results;
+}
+
+void write_table(std::ostream &os, const std::vector<BenchmarkResult> &results)
+{
+	std::size_t name_width = 9;
+	for (auto &result: results) {
+		name_width = std::max(name_width, result.name.size());
+	}
+
+	os << std::left << std::setw(name_width) << "benchmark" << std::right
+	   << std::setw(10) << "ops/run" << std::setw(14) << "median [ns]"
+	   << std::setw(14) << "min [ns]" << std::setw(14) << "max [ns]" << std::setw(16) << "checksum" << '\n';
+	for (auto &result: results) {
+		os << std::left << std::setw(name_width) << result.name << std::right
+		   << std::setw(10) << result.operations << std::fixed << std::setprecision(1)
+		   << std::setw(14) << result.median_ns << std::setw(14) << result.min_ns << std::setw(14) << result.max_ns
+		   << std::scientific << std::setprecision(6) << std::setw(16) << result.checksum
+		   << std::defaultfloat << '\n';
+	}
+}
+
+void write_csv(std::ostream &os, const std::vector<BenchmarkResult> &results)
+{
+	os << "benchmark,operations,repetitions,median_ns,min_ns,max_ns,checksum\n";
+	for (auto &result: results) {
+		os << result.name << ',' << result.operations << ',' << result.repetitions << ','
+		   << std::setprecision(std::numeric_limits<double>::max_digits10)
+		   << result.median_ns << ',' << result.min_ns << ',' << result.max_ns << ',' << result.checksum << '\n';
+	}
+}
+
+std::vector<BenchmarkResult> read_csv(std::istream &is)
+{
+	std::vector<BenchmarkResult> results;
+	std::string line;
+	std::getline(is, line);
+	while (std::getline(is, line)) {
+		if (line.empty()) {
+			continue;
+		}
+		std::istringstream fields(line);
+		BenchmarkResult result;
+		char comma;
+		if (!std::getline(fields, result.name, ',') ||
+		    !(fields >> result.operations >> comma >> result.repetitions >> comma >> result.median_ns >> comma
+		             >> result.min_ns >> comma >> result.max_ns >> comma >> result.checksum)) {
+			throw invalid_data("malformed benchmark results line: " + line);
+		}
+		results.push_back(result);
+	}
+	return results;
+}
+
+std::vector<BenchmarkComparison> compare(const std::vector<BenchmarkResult> &results,
+                                         const std::vector<BenchmarkResult> &baseline, double tolerance)
+{
+	std::vector<BenchmarkComparison> comparisons;
+	for (auto &result: results) {
+		auto it = std::find_if(baseline.begin(), baseline.end(), [&result](const BenchmarkResult &baseline_result) {
+			return baseline_result.name == result.name;
+		});
+		if (it == baseline.end() || it->median_ns <= 0) {
+			LOG(warning) << "Benchmark " << result.name << " has no baseline, not comparing it";
+			continue;
+		}
+		double change = result.median_ns / it->median_ns - 1;
+		comparisons.push_back({result.name, it->median_ns, result.median_ns, change, change > tolerance});
+	}
+	return comparisons;
+}
+
+void write_table(std::ostream &os, const std::vector<BenchmarkComparison> &comparisons)
+{
+	std::size_t name_width = 9;
+	for (auto &comparison: comparisons) {
+		name_width = std::max(name_width, comparison.name.size());
+	}
+
+	os << std::left << std::setw(name_width) << "benchmark" << std::right
+	   << std::setw(16) << "baseline [ns]" << std::setw(14) << "median [ns]"
+	   << std::setw(12) << "change [%]" << "  status" << '\n';
+	for (auto &comparison: comparisons) {
+		os << std::left << std::setw(name_width) << comparison.name << std::right << std::fixed << std::setprecision(1)
+		   << std::setw(16) << comparison.baseline_ns << std::setw(14) << comparison.median_ns
+		   << std::setw(12) << comparison.change * 100 << "  " << (comparison.regressed ? "REGRESSED" : "ok")
+		   << std::defaultfloat << '\n';
+	}
+}
+
+}  // namespace benchmarks
+}  // namespace shark
@@ -0,0 +1,126 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * A minimal harness to time small pieces of code
+ */
+
+#ifndef SHARK_BENCHMARKS_HARNESS_H_
+#define SHARK_BENCHMARKS_HARNESS_H_
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace shark {
+namespace benchmarks {
+
+/**
+ * A named piece of code to time. Each run of a benchmark performs a fixed
+ * number of operations (e.g., one call to the benchmarked function for each
+ * of its inputs), and returns a checksum of their results. Checksums keep the
+ * compiler from optimising the operations away, and tell whether two
+ * executions computed the same values.
+ */
+struct Benchmark {
+	std::string name;
+	std::size_t operations;
+	std::function<double()> run;
+
+	/// Brings the inputs back to their initial state before each run, for
+	/// benchmarked functions that modify them. It is not timed.
+	std::function<void()> setup;
+};
+
+/// The timings of all runs of a benchmark
+struct BenchmarkResult {
+	std::string name;
+	std::size_t operations;
+	unsigned int repetitions;
+	double median_ns;
+	double min_ns;
+	double max_ns;
+	double checksum;
+};
+
+/**
+ * A collection of benchmarks, run in the order they were added.
+ */
+class BenchmarkSuite {
+
+public:
+
+	/// Adds a new benchmark
+	void add(const std::string &name, std::size_t operations, const std::function<double()> &run,
+	         const std::function<void()> &setup = std::function<void()>());
+
+	/// @return The names of all benchmarks matching the @p filter regular expression
+	std::vector<std::string> names(const std::string &filter) const;
+
+	/**
+	 * Runs all benchmarks whose names match the @p filter regular expression.
+	 * Each benchmark runs @p warmup untimed times, and then @p repetitions
+	 * timed ones. Results are reported per operation.
+	 */
+	std::vector<BenchmarkResult> run(const std::string &filter, unsigned int repetitions, unsigned int warmup) const;
+
+private:
+	std::vector<Benchmark> benchmarks;
+};
+
+/// Writes @p results as an aligned table
+void write_table(std::ostream &os, const std::vector<BenchmarkResult> &results);
+
+/// Writes @p results as CSV, with a header line
+void write_csv(std::ostream &os, const std::vector<BenchmarkResult> &results);
+
+/// Reads results written by write_csv
+std::vector<BenchmarkResult> read_csv(std::istream &is);
+
+/// How the median time of a benchmark compares to that of a baseline
+struct BenchmarkComparison {
+	std::string name;
+	double baseline_ns;
+	double median_ns;
+	/// The relative change of the median time; positive if slower
+	double change;
+	bool regressed;
+};
+
+/**
+ * Compares the median times of @p results against those of @p baseline.
+ * Benchmarks more than @p tolerance (a fraction of the baseline time) slower
+ * than in the baseline are regressions. Benchmarks missing from either of
+ * them are not compared.
+ */
+std::vector<BenchmarkComparison> compare(const std::vector<BenchmarkResult> &results,
+                                         const std::vector<BenchmarkResult> &baseline, double tolerance);
+
+/// Writes @p comparisons as an aligned table
+void write_table(std::ostream &os, const std::vector<BenchmarkComparison> &comparisons);
+
+}  // namespace benchmarks
+}  // namespace shark
+
+#endif // SHARK_BENCHMARKS_HARNESS_H_
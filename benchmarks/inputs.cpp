@@ -0,0 +1,233 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Physics objects and inputs used by the benchmarks
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "agn_feedback.h"
+#include "environment.h"
+#include "exceptions.h"
+#include "inputs.h"
+#include "numerical_constants.h"
+#include "reincorporation.h"
+#include "reionisation.h"
+#include "stellar_feedback.h"
+
+namespace shark {
+namespace benchmarks {
+
+static
+const gsl_odeiv2_step_type *gsl_stepper(ExecutionParameters::ode_stepper_t stepper)
+{
+	if (stepper == ExecutionParameters::MSBDF) {
+		return gsl_odeiv2_step_msbdf;
+	}
+	else if (stepper == ExecutionParameters::BSIMP) {
+		return gsl_odeiv2_step_bsimp;
+	}
+	return gsl_odeiv2_step_rkck;
+}
+
+Physics::Physics(const Options &options) :
+	cosmo_params(options), dark_matter_halo_params(options),
+	exec_params(options), gas_cooling_params(options),
+	recycling_params(options), simulation_params(options),
+	star_formation_params(options),
+	cosmology(make_cosmology(cosmo_params, simulation_params.redshifts)),
+	dark_matter_halos(shark::make_dark_matter_halos(dark_matter_halo_params, cosmology, simulation_params, exec_params)),
+	star_formation(star_formation_params, recycling_params, cosmology),
+	gas_cooling(make_gas_cooling(options)),
+	physical_model(std::make_shared<BasicPhysicalModel>(exec_params.ode_solver_precision,
+		gsl_stepper(exec_params.ode_stepper), gsl_stepper(exec_params.ode_starburst_stepper),
+		exec_params.warm_start_ode, gas_cooling, StellarFeedback(StellarFeedbackParameters(options)),
+		star_formation, recycling_params, gas_cooling_params))
+{
+	// no-op
+}
+
+GasCooling Physics::make_gas_cooling(const Options &options)
+{
+	auto agnfeedback = make_agn_feedback(AGNFeedbackParameters(options), cosmology);
+	auto environment = make_environment(EnvironmentParameters(options));
+	auto reionisation = make_reionisation(ReionisationParameters(options));
+	auto reincorporation = make_reincorporation(ReincorporationParameters(options), dark_matter_halos);
+	return GasCooling(gas_cooling_params, star_formation_params, reionisation, cosmology, agnfeedback, dark_matter_halos, reincorporation, environment);
+}
+
+DarkMatterHalosPtr Physics::make_dark_matter_halos(DarkMatterHaloParameters::DarkMatterProfile profile, bool tabulated)
+{
+	DarkMatterHaloParameters params = dark_matter_halo_params;
+	params.haloprofile = profile;
+	params.tabulated_profiles = tabulated;
+	return shark::make_dark_matter_halos(params, cosmology, simulation_params, exec_params);
+}
+
+std::vector<galaxy_sample> sample_galaxies(std::size_t n, const Physics &physics, Sampler &sampler)
+{
+	// Redshifts decrease as snapshots increase
+	std::vector<double> redshifts, time_steps;
+	const auto &snapshot_redshifts = physics.simulation_params.redshifts;
+	for (auto it = snapshot_redshifts.begin(); it != snapshot_redshifts.end(); it++) {
+		auto next = std::next(it);
+		if (it->second > 6 || next == snapshot_redshifts.end()) {
+			continue;
+		}
+		redshifts.push_back(it->second);
+		time_steps.push_back(physics.cosmology->convert_redshift_to_age(next->second) - physics.cosmology->convert_redshift_to_age(it->second));
+	}
+	if (redshifts.empty()) {
+		throw invalid_data("no simulation snapshot is below z = 6");
+	}
+
+	const double solar_metallicity = 0.0134;
+	const double h = physics.cosmo_params.Hubble_h;
+	const double baryon_fraction = physics.cosmology->universal_baryon_fraction();
+
+	std::vector<galaxy_sample> samples(n);
+	for (auto &s: samples) {
+		auto z_idx = std::min(std::size_t(sampler.uniform(0, double(redshifts.size()))), redshifts.size() - 1);
+		s.z = redshifts[z_idx];
+		s.delta_t = time_steps[z_idx];
+
+		// dn/dM of the halo mass function below its knee
+		s.mvir = sampler.power_law(1e10, 3e14, -1.9);
+		s.vvir = physics.dark_matter_halos->halo_virial_velocity(s.mvir, s.z);
+		s.concentration = physics.dark_matter_halos->nfw_concentration(s.mvir, s.z);
+		s.lambda = sampler.log_normal(std::log10(0.035), 0.23);
+
+		// Stellar-to-halo mass relation of Moster et al. (2013)
+		double x = s.mvir / std::pow(10., 11.59);
+		s.mstars = s.mvir * 2 * 0.0351 / (std::pow(x, -1.376) + std::pow(x, 0.608)) * sampler.log_normal(0, 0.15);
+		double log_mstars = std::log10(s.mstars);
+
+		// Cold gas fractions decrease with stellar mass, the remaining
+		// baryons are either in the hot halo or ejected from it
+		s.mcold = s.mstars * sampler.log_normal(-0.3 - 0.5 * (log_mstars - 10), 0.3);
+		double mremaining = std::max(baryon_fraction * s.mvir - s.mstars - s.mcold, 0.);
+		double hot_fraction = sampler.uniform(0.5, 0.9);
+		s.mhot = mremaining * hot_fraction;
+		s.mejected = mremaining * (1 - hot_fraction) / 2;
+		s.mbh = sampler.log_normal(std::log10(0.3 * s.mstars) - 2.7, 0.3);
+
+		// Mass-size relation of disks in physical [kpc], converted to [cMpc/h]
+		s.rstars = sampler.log_normal(0.6 + 0.2 * (log_mstars - 10), 0.2) * 1e-3 * (1 + s.z) * h;
+		s.rgas = s.rstars * sampler.log_normal(0.2, 0.1);
+
+		// Mass-metallicity relation, flattening at high masses
+		s.zgas = solar_metallicity * sampler.log_normal(std::min(0.3 * (log_mstars - 10.5), 0.3), 0.15);
+		s.vgal = s.vvir * sampler.log_normal(0.1, 0.05);
+	}
+	return samples;
+}
+
+std::vector<HaloPtr> make_halos(const std::vector<galaxy_sample> &samples, const Physics &physics)
+{
+	std::vector<HaloPtr> halos;
+	halos.reserve(samples.size());
+	for (std::size_t i = 0; i != samples.size(); i++) {
+		auto &s = samples[i];
+		auto halo = std::make_shared<Halo>(i, 0);
+		halo->Vvir = s.vvir;
+		halo->concentration = s.concentration;
+
+		auto subhalo = std::make_shared<Subhalo>(i, 0);
+		subhalo->subhalo_type = Subhalo::CENTRAL;
+		subhalo->host_halo = halo;
+		subhalo->Mvir = s.mvir;
+		subhalo->Vvir = s.vvir;
+		subhalo->Vcirc = 1.1 * s.vvir;
+		subhalo->concentration = s.concentration;
+		subhalo->lambda = s.lambda;
+		double rvir = physics.dark_matter_halos->halo_virial_radius(*subhalo);
+		subhalo->L.z = constants::SQRT2 * s.lambda * s.mvir * s.vvir * rvir;
+
+		auto galaxy = std::make_shared<Galaxy>(i);
+		galaxy->galaxy_type = Galaxy::CENTRAL;
+		galaxy->disk_stars.rscale = s.rstars;
+		galaxy->disk_stars.sAM = s.rstars * s.vgal / constants::EAGLEJconv;
+		galaxy->disk_gas.rscale = s.rgas;
+		galaxy->disk_gas.sAM = s.rgas * s.vgal / constants::EAGLEJconv;
+		subhalo->galaxies.push_back(galaxy);
+
+		halo->add_subhalo(std::move(subhalo));
+		reset_baryons(halo, s);
+		halos.push_back(std::move(halo));
+	}
+	return halos;
+}
+
+void reset_baryons(const HaloPtr &halo, const galaxy_sample &sample)
+{
+	auto &subhalo = *halo->central_subhalo;
+	subhalo.hot_halo_gas.mass = sample.mhot;
+	subhalo.hot_halo_gas.mass_metals = sample.mhot * sample.zgas / 3;
+	subhalo.cold_halo_gas = Baryon();
+	subhalo.ejected_galaxy_gas.mass = sample.mejected;
+	subhalo.ejected_galaxy_gas.mass_metals = sample.mejected * sample.zgas / 3;
+	subhalo.cooling_subhalo_tracking = CoolingSubhaloTracking();
+
+	auto &galaxy = *subhalo.galaxies.front();
+	galaxy.vmax = subhalo.Vcirc;
+	galaxy.disk_stars.mass = sample.mstars;
+	galaxy.disk_stars.mass_metals = sample.mstars * sample.zgas;
+	galaxy.disk_gas.mass = sample.mcold;
+	galaxy.disk_gas.mass_metals = sample.mcold * sample.zgas;
+	galaxy.smbh = BlackHole();
+	galaxy.smbh.mass = sample.mbh;
+}
+
+std::vector<HaloPtr> make_halos_with_satellites(const std::vector<galaxy_sample> &samples, Sampler &sampler)
+{
+	std::vector<HaloPtr> halos;
+	halos.reserve(samples.size());
+	Subhalo::id_t subhalo_id = 0;
+	for (std::size_t i = 0; i != samples.size(); i++) {
+		auto &s = samples[i];
+		auto halo = std::make_shared<Halo>(i, 0);
+
+		auto central = std::make_shared<Subhalo>(subhalo_id++, 0);
+		central->subhalo_type = Subhalo::CENTRAL;
+		central->host_halo = halo;
+		central->Mvir = s.mvir;
+		halo->add_subhalo(std::move(central));
+
+		// The number of resolved satellites grows almost linearly with the
+		// host mass; satellites follow the subhalo mass function
+		auto n_satellites = sampler.poisson(std::pow(s.mvir / 2e11, 0.95));
+		for (unsigned int j = 0; j != n_satellites; j++) {
+			auto satellite = std::make_shared<Subhalo>(subhalo_id++, 0);
+			satellite->subhalo_type = Subhalo::SATELLITE;
+			satellite->host_halo = halo;
+			satellite->Mvir = sampler.power_law(1e10, std::max(s.mvir / 10, 2e10), -1.9);
+			halo->add_subhalo(std::move(satellite));
+		}
+		halos.push_back(std::move(halo));
+	}
+	return halos;
+}
+
+}  // namespace benchmarks
+}  // namespace shark
@@ -0,0 +1,147 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Physics objects and inputs used by the benchmarks
+ */
+
+#ifndef SHARK_BENCHMARKS_INPUTS_H_
+#define SHARK_BENCHMARKS_INPUTS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "components.h"
+#include "cosmology.h"
+#include "dark_matter_halos.h"
+#include "execution.h"
+#include "gas_cooling.h"
+#include "options.h"
+#include "physical_model.h"
+#include "recycling.h"
+#include "simulation.h"
+#include "star_formation.h"
+
+#include "harness.h"
+#include "sampler.h"
+
+namespace shark {
+namespace benchmarks {
+
+/**
+ * The parameters and physics objects needed by the benchmarks, built from
+ * options in the same way SharkRunner builds them.
+ */
+class Physics {
+
+public:
+	explicit Physics(const Options &options);
+
+	CosmologicalParameters cosmo_params;
+	DarkMatterHaloParameters dark_matter_halo_params;
+	ExecutionParameters exec_params;
+	GasCoolingParameters gas_cooling_params;
+	RecyclingParameters recycling_params;
+	SimulationParameters simulation_params;
+	StarFormationParameters star_formation_params;
+	CosmologyPtr cosmology;
+	DarkMatterHalosPtr dark_matter_halos;
+	StarFormation star_formation;
+	GasCooling gas_cooling;
+	std::shared_ptr<BasicPhysicalModel> physical_model;
+
+	/// @return A new DarkMatterHalos object with the given profile settings
+	DarkMatterHalosPtr make_dark_matter_halos(DarkMatterHaloParameters::DarkMatterProfile profile, bool tabulated);
+
+private:
+	GasCooling make_gas_cooling(const Options &options);
+};
+
+/**
+ * The properties of a central galaxy and its host halo. Masses are in
+ * [Msun/h], sizes are comoving half-mass radii in [cMpc/h], velocities in
+ * [km/s], times in [Gyr] and metallicities are mass fractions.
+ */
+struct galaxy_sample {
+	double z;
+	double delta_t;
+	double mvir;
+	double vvir;
+	double concentration;
+	double lambda;
+	double mstars;
+	double mcold;
+	double mhot;
+	double mejected;
+	double mbh;
+	double rstars;
+	double rgas;
+	double zgas;
+	double vgal;
+};
+
+/**
+ * Draws @p n central galaxies at the redshifts of the simulation snapshots
+ * up to z = 6, each evolved over the time until the next snapshot. Halo
+ * masses follow the low-mass slope of the halo mass function between 1e10
+ * and 3e14 [Msun/h], and galaxy properties follow the scaling relations
+ * (stellar-to-halo mass, gas fractions, mass-size and mass-metallicity) of
+ * the observed galaxy population, with their scatter.
+ */
+std::vector<galaxy_sample> sample_galaxies(std::size_t n, const Physics &physics, Sampler &sampler);
+
+/**
+ * Builds one halo per sample, with a central subhalo holding its central
+ * galaxy. Baryons are set as given by the sample.
+ */
+std::vector<HaloPtr> make_halos(const std::vector<galaxy_sample> &samples, const Physics &physics);
+
+/**
+ * Sets the baryons of the central subhalo and galaxy of @p halo, built by
+ * make_halos(), back to those given by @p sample.
+ */
+void reset_baryons(const HaloPtr &halo, const galaxy_sample &sample);
+
+/**
+ * Builds one halo per sample, each with a number of satellite subhalos that
+ * grows with its mass as in N-body simulations (Poisson-distributed, with
+ * hundreds of satellites in the most massive halos).
+ */
+std::vector<HaloPtr> make_halos_with_satellites(const std::vector<galaxy_sample> &samples, Sampler &sampler);
+
+/// Adds the benchmarks of the physics functions to @p suite
+void add_physics_benchmarks(BenchmarkSuite &suite, Physics &physics, const std::vector<galaxy_sample> &samples);
+
+/// Adds the benchmarks of data structures and I/O to @p suite, which write
+/// their files under @p directory
+void add_structure_benchmarks(BenchmarkSuite &suite, const std::vector<galaxy_sample> &samples, Sampler &sampler,
+                              const std::string &directory);
+
+/// Adds the benchmarks of whole shark executions over synthetic merger trees
+/// to @p suite, which are evolved with @p options and written under @p directory
+void add_pipeline_benchmarks(BenchmarkSuite &suite, const Options &options, const std::string &directory);
+
+}  // namespace benchmarks
+}  // namespace shark
+
+#endif // SHARK_BENCHMARKS_INPUTS_H_
@@ -0,0 +1,251 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * The main function for the shark-benchmarks executable
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <gsl/gsl_errno.h>
+
+#include "exceptions.h"
+#include "git_revision.h"
+#include "harness.h"
+#include "inputs.h"
+#include "logging.h"
+#include "options.h"
+
+namespace shark {
+namespace benchmarks {
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+static
+void throw_exception_gsl_handler(const char *reason, const char *file, int line, int gsl_errno)
+{
+	if (scoped_gsl_error_suppression::active()) {
+		return;
+	}
+	throw gsl_error(reason, file, line, gsl_errno, gsl_strerror(gsl_errno));
+}
+
+static
+void setup_logging(int verbosity)
+{
+	namespace log = ::boost::log;
+	namespace trivial = ::boost::log::trivial;
+
+	verbosity = 5 - std::min(std::max(verbosity, 0), 5);
+	trivial::severity_level sev_lvl = logging_level = trivial::severity_level(verbosity);
+	log::core::get()->set_filter([sev_lvl](log::attribute_value_set const &s) {
+		return s["Severity"].extract<trivial::severity_level>() >= sev_lvl;
+	});
+}
+
+/// Removes a directory and its contents when going out of scope
+struct scoped_directory {
+	explicit scoped_directory(const fs::path &path) : path(path)
+	{
+		fs::create_directories(path);
+	}
+	~scoped_directory()
+	{
+		boost::system::error_code ec;
+		fs::remove_all(path, ec);
+	}
+	fs::path path;
+};
+
+/**
+ * Writes a redshift table like those of N-body simulations: 200 snapshots
+ * from z = 20 down to z = 0, equally spaced in log(1 + z)
+ */
+static
+void write_redshift_table(const std::string &filename)
+{
+	const int n_snapshots = 200;
+	std::ofstream f(filename);
+	for (int snapshot = 0; snapshot != n_snapshots; snapshot++) {
+		double log_expansion = std::log10(21.) * (n_snapshots - 1 - snapshot) / (n_snapshots - 1);
+		f << snapshot << " " << std::pow(10., log_expansion) - 1 << "\n";
+	}
+	if (!f) {
+		throw exception("error while writing " + filename);
+	}
+}
+
+static
+Options read_options(const po::variables_map &vm, const fs::path &directory)
+{
+	Options options(vm["config"].as<std::string>());
+	for (auto &opt_spec: vm["options"].as<std::vector<std::string>>()) {
+		options.add(opt_spec);
+	}
+
+	// The sample configuration file doesn't point to an actual simulation
+	std::string redshift_file;
+	options.load("simulation.redshift_file", redshift_file);
+	if (!fs::exists(redshift_file)) {
+		redshift_file = (directory / "redshifts.txt").string();
+		write_redshift_table(redshift_file);
+		options.add("simulation.redshift_file=" + redshift_file);
+	}
+	return options;
+}
+
+static
+void write_csv_file(const std::string &filename, const std::vector<BenchmarkResult> &results)
+{
+	std::ofstream csv(filename);
+	write_csv(csv, results);
+	if (!csv) {
+		throw exception("error while writing " + filename);
+	}
+}
+
+/**
+ * Compares @p results against those in @p baseline_file, returning the number
+ * of regressions. If the file doesn't exist the results are written into it
+ * instead, becoming the baseline of later comparisons.
+ */
+static
+std::size_t compare_with_baseline(const std::vector<BenchmarkResult> &results, const std::string &baseline_file, double tolerance)
+{
+	if (!fs::exists(baseline_file)) {
+		LOG(warning) << "Baseline " << baseline_file << " doesn't exist, recording these results as the baseline";
+		write_csv_file(baseline_file, results);
+		return 0;
+	}
+
+	std::ifstream f(baseline_file);
+	auto comparisons = compare(results, read_csv(f), tolerance);
+	std::cout << std::endl;
+	write_table(std::cout, comparisons);
+	return std::count_if(comparisons.begin(), comparisons.end(), [](const BenchmarkComparison &comparison) {
+		return comparison.regressed;
+	});
+}
+
+static
+int run(int argc, char **argv)
+{
+	po::options_description opts("shark-benchmarks options");
+	opts.add_options()
+		("help,h",        "Show this help message")
+		("verbose,v",     po::value<int>()->default_value(2), "Verbosity level. Higher is more verbose")
+		("config,c",      po::value<std::string>()->default_value(SHARK_BENCHMARKS_CONFIG),
+		                  "Configuration file with the physics options to benchmark")
+		("options,o",     po::value<std::vector<std::string>>()->multitoken()->default_value({}, ""),
+		                  "Space-separated additional options to override the configuration file")
+		("filter,f",      po::value<std::string>()->default_value(""), "Run only benchmarks whose names match this regular expression")
+		("list,l",        "List the benchmarks and exit")
+		("repetitions,r", po::value<unsigned int>()->default_value(10), "Timed runs of each benchmark")
+		("warmup,w",      po::value<unsigned int>()->default_value(1), "Untimed runs of each benchmark before the timed ones")
+		("samples,n",     po::value<std::size_t>()->default_value(10000), "Number of galaxies and halos used as inputs")
+		("seed,s",        po::value<std::uint64_t>()->default_value(1), "Seed of the random inputs")
+		("csv",           po::value<std::string>(), "Also write the results into this CSV file")
+		("baseline",      po::value<std::string>(), "Compare the results against those in this CSV file, failing on regressions. "
+		                  "If the file doesn't exist the results are recorded into it")
+		("tolerance",     po::value<double>()->default_value(0.2), "Fraction by which benchmarks can be slower than their baseline");
+
+	try {
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, opts), vm);
+		po::notify(vm);
+
+		if (vm.count("help")) {
+			std::cout << "Usage: " << argv[0] << " [options]" << std::endl << std::endl;
+			std::cout << "Times the physics hot paths of shark on random, but reproducible," << std::endl;
+			std::cout << "galaxies and halos drawn from realistic distributions." << std::endl << std::endl;
+			std::cout << opts << std::endl;
+			return 0;
+		}
+
+		setup_logging(vm["verbose"].as<int>());
+		gsl_set_error_handler(&throw_exception_gsl_handler);
+		LOG(info) << "shark git version: " << git_sha1();
+
+		scoped_directory directory(fs::temp_directory_path() / fs::unique_path("shark-benchmarks-%%%%-%%%%-%%%%"));
+		auto options = read_options(vm, directory.path);
+		Physics physics(options);
+		Sampler sampler(vm["seed"].as<std::uint64_t>());
+		auto samples = sample_galaxies(vm["samples"].as<std::size_t>(), physics, sampler);
+
+		BenchmarkSuite suite;
+		add_physics_benchmarks(suite, physics, samples);
+		add_structure_benchmarks(suite, samples, sampler, directory.path.string());
+		add_pipeline_benchmarks(suite, options, directory.path.string());
+
+		auto filter = vm["filter"].as<std::string>();
+		if (vm.count("list")) {
+			for (auto &name: suite.names(filter)) {
+				std::cout << name << std::endl;
+			}
+			return 0;
+		}
+
+		auto results = suite.run(filter, vm["repetitions"].as<unsigned int>(), vm["warmup"].as<unsigned int>());
+		write_table(std::cout, results);
+		if (vm.count("csv")) {
+			write_csv_file(vm["csv"].as<std::string>(), results);
+		}
+		if (vm.count("baseline")) {
+			auto tolerance = vm["tolerance"].as<double>();
+			auto regressions = compare_with_baseline(results, vm["baseline"].as<std::string>(), tolerance);
+			if (regressions != 0) {
+				std::cerr << regressions << " benchmark(s) more than " << tolerance * 100 << "% slower than their baseline" << std::endl;
+				return 1;
+			}
+		}
+		return 0;
+	} catch (const shark::missing_option &e) {
+		std::cerr << "Missing option: " << e.what() << std::endl;
+		return 1;
+	} catch (const shark::exception &e) {
+		std::cerr << "Unexpected shark exception found while running:" << std::endl << std::endl;
+		std::cerr << e.what() << std::endl;
+		return 1;
+	} catch (const po::error &e) {
+		std::cerr << "Error while parsing command-line: " << e.what() << std::endl;
+		return 1;
+	} catch (const std::exception &e) {
+		std::cerr << "Unexpected exception while running" << std::endl << std::endl;
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
+
+}  // namespace benchmarks
+}  // namespace shark
+
+int main(int argc, char **argv) {
+	return shark::benchmarks::run(argc, argv);
+}
@@ -0,0 +1,274 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Benchmarks of the physics functions called for every galaxy
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gsl/gsl_sf_lambert.h>
+
+#include "inputs.h"
+#include "interpolator.h"
+#include "nfw_distribution.h"
+#include "numerical_constants.h"
+
+namespace shark {
+namespace benchmarks {
+
+static
+void add_physical_model_benchmarks(BenchmarkSuite &suite, Physics &physics, const std::vector<galaxy_sample> &samples)
+{
+	typedef BasicPhysicalModel::solver_params solver_params;
+	typedef BasicPhysicalModel::state_t state_t;
+
+	// The ODE system is evaluated on the initial state of each galaxy, with
+	// the cooling rate the galaxy would get
+	auto halos = make_halos(samples, physics);
+	auto states = std::make_shared<std::vector<state_t>>();
+	auto params = std::make_shared<std::vector<solver_params>>();
+	for (std::size_t i = 0; i != samples.size(); i++) {
+		auto &subhalo = *halos[i]->central_subhalo;
+		auto &galaxy = *subhalo.galaxies.front();
+		states->push_back(physics.physical_model->from_galaxy(subhalo, galaxy));
+		double mcoolrate = physics.gas_cooling.cooling_rate(subhalo, galaxy, samples[i].z, samples[i].delta_t);
+		params->push_back(solver_params {*physics.physical_model, samples[i].rgas, samples[i].rstars, mcoolrate,
+		                                 subhalo.cold_halo_gas.sAM, samples[i].delta_t, samples[i].z, samples[i].vvir,
+		                                 samples[i].vgal, false, {}});
+		physics.physical_model->prepare_solver_params(params->back());
+	}
+
+	suite.add("physical_model/evaluator", samples.size(), [states, params]() {
+		double checksum = 0;
+		state_t f;
+		for (std::size_t i = 0; i != states->size(); i++) {
+			basic_physicalmodel_evaluator(0, (*states)[i].data(), f.data(), &(*params)[i]);
+			checksum += f[0] + f[1];
+		}
+		return checksum;
+	});
+}
+
+static
+void add_star_formation_benchmarks(BenchmarkSuite &suite, Physics &physics, const std::vector<galaxy_sample> &samples)
+{
+	auto &star_formation = physics.star_formation;
+
+	suite.add("star_formation/star_formation_rate", samples.size(), [&star_formation, samples]() {
+		double checksum = 0;
+		for (auto &s: samples) {
+			double jrate;
+			double jgas = 2 * s.vgal * s.rgas / constants::RDISK_HALF_SCALE;
+			checksum += star_formation.star_formation_rate(s.mcold, s.mstars, s.rgas, s.rstars, s.zgas, s.z, false, s.vgal, jrate, jgas);
+		}
+		return checksum;
+	});
+
+	// With and without the angular momentum of the molecular gas, which
+	// needs another integration
+	for (bool jcalc: {false, true}) {
+		std::string name = jcalc ? "star_formation/molecular_hydrogen_j" : "star_formation/molecular_hydrogen";
+		suite.add(name, samples.size(), [&star_formation, samples, jcalc]() {
+			double checksum = 0;
+			for (auto &s: samples) {
+				double jmol;
+				double jgas = 2 * s.vgal * s.rgas / constants::RDISK_HALF_SCALE;
+				checksum += star_formation.molecular_hydrogen(s.mcold, s.mstars, s.rgas, s.rstars, s.zgas, s.z, jmol, jgas, s.vgal, false, jcalc);
+			}
+			return checksum;
+		});
+	}
+
+	// As calculated on snapshots that are not output with
+	// execution.tracked_molecular_gas = approximate
+	suite.add("star_formation/molecular_hydrogen_approximate", samples.size(), [&star_formation, samples]() {
+		double checksum = 0;
+		for (auto &s: samples) {
+			double jmol;
+			checksum += star_formation.molecular_hydrogen(s.mcold, s.mstars, s.rgas, s.rstars, s.zgas, s.z, jmol, 0, s.vgal, false, false, true);
+		}
+		return checksum;
+	});
+}
+
+static
+void add_gas_cooling_benchmarks(BenchmarkSuite &suite, Physics &physics, const std::vector<galaxy_sample> &samples)
+{
+	// Cooling changes the baryons of the subhalo and galaxy, so they are
+	// reset before each run
+	auto halos = std::make_shared<std::vector<HaloPtr>>(make_halos(samples, physics));
+	auto &gas_cooling = physics.gas_cooling;
+
+	auto setup = [halos, samples]() {
+		for (std::size_t i = 0; i != samples.size(); i++) {
+			reset_baryons((*halos)[i], samples[i]);
+		}
+	};
+	suite.add("gas_cooling/cooling_rate", samples.size(), [&gas_cooling, halos, samples]() {
+		double checksum = 0;
+		for (std::size_t i = 0; i != samples.size(); i++) {
+			auto &subhalo = *(*halos)[i]->central_subhalo;
+			checksum += gas_cooling.cooling_rate(subhalo, *subhalo.galaxies.front(), samples[i].z, samples[i].delta_t);
+		}
+		return checksum;
+	}, setup);
+}
+
+static
+void add_interpolator_benchmarks(BenchmarkSuite &suite, Physics &physics, const std::vector<galaxy_sample> &samples)
+{
+	// The cooling function table, queried at the virial temperature and hot
+	// gas metallicity of each halo, as during gas cooling
+	auto &table = physics.gas_cooling_params.cooling_table;
+	auto interpolator = std::make_shared<Interpolator>(table.get_temperatures(), table.get_metallicities(), table.get_lambda());
+	auto grid_interpolator = std::make_shared<GridInterpolator>(table.get_temperatures(), table.get_metallicities(), table.get_lambda());
+
+	auto log_tvir = std::make_shared<std::vector<double>>();
+	auto zhot = std::make_shared<std::vector<double>>();
+	for (auto &s: samples) {
+		log_tvir->push_back(std::log10(97.48 * s.vvir * s.vvir));
+		zhot->push_back(s.zgas / 3);
+	}
+
+	suite.add("interpolator/bilinear", samples.size(), [interpolator, log_tvir, zhot]() {
+		double checksum = 0;
+		for (std::size_t i = 0; i != log_tvir->size(); i++) {
+			checksum += interpolator->get((*log_tvir)[i], (*zhot)[i]);
+		}
+		return checksum;
+	});
+	suite.add("interpolator/grid", samples.size(), [grid_interpolator, log_tvir, zhot]() {
+		double checksum = 0;
+		for (std::size_t i = 0; i != log_tvir->size(); i++) {
+			checksum += grid_interpolator->get((*log_tvir)[i], (*zhot)[i]);
+		}
+		return checksum;
+	});
+
+	auto values = std::make_shared<std::vector<double>>(samples.size());
+	suite.add("interpolator/grid_batch", samples.size(), [grid_interpolator, log_tvir, zhot, values]() {
+		grid_interpolator->get(log_tvir->data(), zhot->data(), values->data(), values->size());
+		double checksum = 0;
+		for (double value: *values) {
+			checksum += value;
+		}
+		return checksum;
+	});
+}
+
+static
+void add_dark_matter_halos_benchmarks(BenchmarkSuite &suite, Physics &physics, const std::vector<galaxy_sample> &samples)
+{
+	// Profiles are evaluated at the sizes of galaxies, normalised by the
+	// virial radius of their halos
+	auto radii = std::make_shared<std::vector<double>>();
+	auto concentrations = std::make_shared<std::vector<double>>();
+	for (auto &s: samples) {
+		double rvir = constants::G * s.mvir / (s.vvir * s.vvir);
+		radii->push_back(std::min(s.rgas / rvir, 1.));
+		concentrations->push_back(s.concentration);
+	}
+
+	const std::vector<std::pair<std::string, DarkMatterHaloParameters::DarkMatterProfile>> profiles {
+		{"nfw", DarkMatterHaloParameters::NFW},
+		{"einasto", DarkMatterHaloParameters::EINASTO}
+	};
+	for (auto &profile: profiles) {
+		for (bool tabulated: {false, true}) {
+			std::shared_ptr<const DarkMatterHalos> halos = physics.make_dark_matter_halos(profile.second, tabulated);
+			std::string prefix = "dark_matter_halos/" + profile.first + (tabulated ? "_tabulated/" : "/");
+
+			suite.add(prefix + "enclosed_mass", samples.size(), [halos, radii, concentrations]() {
+				double checksum = 0;
+				for (std::size_t i = 0; i != radii->size(); i++) {
+					checksum += halos->enclosed_mass((*radii)[i], (*concentrations)[i]);
+				}
+				return checksum;
+			});
+			suite.add(prefix + "grav_potential_halo", samples.size(), [halos, radii, concentrations]() {
+				double checksum = 0;
+				for (std::size_t i = 0; i != radii->size(); i++) {
+					checksum += halos->grav_potential_halo((*radii)[i], (*concentrations)[i]);
+				}
+				return checksum;
+			});
+		}
+	}
+}
+
+/// The Lambert W0 function of GSL, evaluated one value at a time
+struct gsl_lambert_w0 {
+	void operator()(const double x[], double w[], std::size_t n) const
+	{
+		for (std::size_t i = 0; i != n; i++) {
+			w[i] = gsl_sf_lambert_W0(x[i]);
+		}
+	}
+};
+
+template <typename W>
+static
+void add_nfw_quantiles_benchmark(BenchmarkSuite &suite, const std::string &name, const std::vector<galaxy_sample> &samples,
+                                 const std::shared_ptr<std::vector<double>> &deviates)
+{
+	// Radii of satellites within a halo of the median concentration
+	auto concentration = samples[samples.size() / 2].concentration;
+	auto values = std::make_shared<std::vector<double>>(deviates->size());
+	suite.add(name, deviates->size(), [concentration, deviates, values]() {
+		*values = *deviates;
+		nfw_distribution<double>(concentration).quantiles<W>(values->data(), values->size());
+		double checksum = 0;
+		for (double value: *values) {
+			checksum += value;
+		}
+		return checksum;
+	});
+}
+
+static
+void add_nfw_distribution_benchmarks(BenchmarkSuite &suite, const std::vector<galaxy_sample> &samples)
+{
+	// The cost doesn't depend on the order of the deviates
+	auto deviates = std::make_shared<std::vector<double>>();
+	for (std::size_t i = 0; i != samples.size(); i++) {
+		deviates->push_back((i + 0.5) / samples.size());
+	}
+	add_nfw_quantiles_benchmark<approx_lambert_w0<double>>(suite, "nfw_distribution/quantiles", samples, deviates);
+	add_nfw_quantiles_benchmark<gsl_lambert_w0>(suite, "nfw_distribution/quantiles_gsl", samples, deviates);
+}
+
+void add_physics_benchmarks(BenchmarkSuite &suite, Physics &physics, const std::vector<galaxy_sample> &samples)
+{
+	add_physical_model_benchmarks(suite, physics, samples);
+	add_star_formation_benchmarks(suite, physics, samples);
+	add_gas_cooling_benchmarks(suite, physics, samples);
+	add_interpolator_benchmarks(suite, physics, samples);
+	add_dark_matter_halos_benchmarks(suite, physics, samples);
+	add_nfw_distribution_benchmarks(suite, samples);
+}
+
+}  // namespace benchmarks
+}  // namespace shark
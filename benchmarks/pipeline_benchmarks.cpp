@@ -0,0 +1,95 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Benchmarks of whole shark executions
+ */
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "inputs.h"
+#include "shark_session.h"
+#include "synthtrees.h"
+
+namespace shark {
+namespace benchmarks {
+
+void add_pipeline_benchmarks(BenchmarkSuite &suite, const Options &options, const std::string &directory)
+{
+	// A (10 Mpc/h)^3 volume has about 200 trees and 10000 subhalos over 200
+	// snapshots, which a single thread evolves in about a second
+	synthtrees_params params;
+	params.volume = 1000;
+	SyntheticTrees trees(params);
+	auto prefix = directory + "/synthetic_trees";
+	auto redshift_file = directory + "/synthetic_redshifts.txt";
+	auto tree_file = prefix + ".0.hdf5";
+	trees.write_redshifts(redshift_file);
+	auto stats = trees.write_batch(0, tree_file, 65536);
+	auto tree_file_size = boost::filesystem::file_size(tree_file);
+
+	auto last_snapshot = std::to_string(params.snapshots - 1);
+	auto pipeline_options = std::make_shared<Options>(options);
+	for (auto &optspec: {
+	        "simulation.volume=" + std::to_string(params.volume),
+	        "simulation.lbox=" + std::to_string(std::cbrt(params.volume)),
+	        "simulation.particle_mass=" + std::to_string(params.min_mass / 20),
+	        std::string("simulation.tot_n_subvolumes=1"),
+	        std::string("simulation.min_snapshot=0"),
+	        "simulation.max_snapshot=" + last_snapshot,
+	        "simulation.tree_files_prefix=" + prefix,
+	        "simulation.redshift_file=" + redshift_file,
+	        std::string("execution.simulation_batches=0"),
+	        "execution.output_snapshots=" + last_snapshot,
+	        "execution.output_directory=" + directory}) {
+		pipeline_options->add(optspec);
+	}
+
+	// Reading the trees file and building the trees, per byte of the file
+	suite.add("pipeline/import", tree_file_size, [pipeline_options]() {
+		SharkSession session(*pipeline_options, 1);
+		return 0.;
+	});
+
+	// The evolution of all galaxies, per subhalo (i.e., roughly per central
+	// galaxy evolved over a snapshot). Trees are imported only once, when
+	// first needed, outside of the timed runs
+	auto session = std::make_shared<std::unique_ptr<SharkSession>>();
+	auto setup = [session, pipeline_options]() {
+		if (!*session) {
+			session->reset(new SharkSession(*pipeline_options, 1));
+		}
+	};
+	int output_snapshot = params.snapshots - 1;
+	suite.add("pipeline/evolve", stats.subhalos, [session, output_snapshot]() {
+		(*session)->run();
+		return (*session)->get(output_snapshot, "run_info/n_galaxies").at(0);
+	}, setup);
+}
+
+}  // namespace benchmarks
+}  // namespace shark
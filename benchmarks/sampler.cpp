@@ -0,0 +1,97 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Reproducible random numbers used by the benchmarks
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "numerical_constants.h"
+#include "sampler.h"
+
+namespace shark {
+namespace benchmarks {
+
+Sampler::Sampler(std::uint64_t seed) :
+	engine(seed)
+{
+	// no-op
+}
+
+double Sampler::uniform(double min, double max)
+{
+	// The 53 most significant bits make a double in [0, 1)
+	double u = double(engine() >> 11) * (1.0 / 9007199254740992.0);
+	return min + u * (max - min);
+}
+
+double Sampler::normal(double mean, double stddev)
+{
+	// Box-Muller transform, which gives two values at a time
+	if (has_spare_normal) {
+		has_spare_normal = false;
+		return mean + stddev * spare_normal;
+	}
+	double u1 = 1 - uniform(0, 1);
+	double u2 = uniform(0, 1);
+	double r = std::sqrt(-2 * std::log(u1));
+	spare_normal = r * std::sin(2 * constants::PI * u2);
+	has_spare_normal = true;
+	return mean + stddev * r * std::cos(2 * constants::PI * u2);
+}
+
+double Sampler::log_normal(double log10_mean, double dex)
+{
+	return std::pow(10., normal(log10_mean, dex));
+}
+
+double Sampler::power_law(double min, double max, double slope)
+{
+	double a = slope + 1;
+	double min_a = std::pow(min, a);
+	return std::pow(min_a + uniform(0, 1) * (std::pow(max, a) - min_a), 1 / a);
+}
+
+double Sampler::exponential(double mean)
+{
+	return -mean * std::log(1 - uniform(0, 1));
+}
+
+unsigned int Sampler::poisson(double mean)
+{
+	// Large means are well approximated by a normal distribution
+	if (mean > 30) {
+		return (unsigned int)std::max(0., std::round(normal(mean, std::sqrt(mean))));
+	}
+	double limit = std::exp(-mean);
+	double product = uniform(0, 1);
+	unsigned int count = 0;
+	while (product > limit) {
+		product *= uniform(0, 1);
+		count++;
+	}
+	return count;
+}
+
+}  // namespace benchmarks
+}  // namespace shark
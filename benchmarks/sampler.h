@@ -0,0 +1,73 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Reproducible random numbers used by the benchmarks
+ */
+
+#ifndef SHARK_BENCHMARKS_SAMPLER_H_
+#define SHARK_BENCHMARKS_SAMPLER_H_
+
+#include <cstdint>
+#include <random>
+
+namespace shark {
+namespace benchmarks {
+
+/**
+ * A source of random numbers giving the same sequence on all platforms for
+ * the same seed. The sequence of std::mt19937_64 is fixed by the standard,
+ * but that of the standard distributions isn't, so these are implemented
+ * here instead.
+ */
+class Sampler {
+
+public:
+	explicit Sampler(std::uint64_t seed);
+
+	/// A uniformly distributed value in [min, max)
+	double uniform(double min, double max);
+
+	/// A normally distributed value
+	double normal(double mean, double stddev);
+
+	/// A value whose log10 is normally distributed with @p log10_mean and @p dex
+	double log_normal(double log10_mean, double dex);
+
+	/// A value in [min, max) distributed as dN/dx ~ x^slope, with slope != -1
+	double power_law(double min, double max, double slope);
+
+	/// An exponentially distributed value with the given @p mean
+	double exponential(double mean);
+
+	/// A Poisson-distributed count with the given @p mean
+	unsigned int poisson(double mean);
+
+private:
+	std::mt19937_64 engine;
+	bool has_spare_normal = false;
+	double spare_normal = 0;
+};
+
+}  // namespace benchmarks
+}  // namespace shark
+
+#endif // SHARK_BENCHMARKS_SAMPLER_H_
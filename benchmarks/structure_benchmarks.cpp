@@ -0,0 +1,118 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Benchmarks of data structures and I/O
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hdf5/writer.h"
+#include "inputs.h"
+
+namespace shark {
+namespace benchmarks {
+
+static
+void add_halo_benchmarks(BenchmarkSuite &suite, const std::vector<galaxy_sample> &samples, Sampler &sampler)
+{
+	auto halos = std::make_shared<std::vector<HaloPtr>>(make_halos_with_satellites(samples, sampler));
+
+	// all_subhalos() builds a new vector on each call, while subhalos()
+	// returns a view over a list kept by the halo
+	suite.add("halo/all_subhalos", samples.size(), [halos]() {
+		double checksum = 0;
+		for (auto &halo: *halos) {
+			for (auto &subhalo: halo->all_subhalos()) {
+				checksum += subhalo->Mvir;
+			}
+		}
+		return checksum;
+	});
+	suite.add("halo/subhalos", samples.size(), [halos]() {
+		double checksum = 0;
+		for (auto &halo: *halos) {
+			for (auto &subhalo: halo->subhalos()) {
+				checksum += subhalo->Mvir;
+			}
+		}
+		return checksum;
+	});
+}
+
+/// Galaxy properties as they are written into the galaxies.hdf5 files
+struct galaxy_columns {
+	std::vector<std::int64_t> id_galaxy;
+	std::vector<int> type;
+	std::vector<std::vector<float>> properties;
+};
+
+static
+void add_hdf5_benchmarks(BenchmarkSuite &suite, const std::vector<galaxy_sample> &samples, const std::string &directory)
+{
+	auto columns = std::make_shared<galaxy_columns>();
+	columns->properties.resize(8);
+	for (std::size_t i = 0; i != samples.size(); i++) {
+		auto &s = samples[i];
+		columns->id_galaxy.push_back(std::int64_t(i) + (std::int64_t(1) << 40));
+		columns->type.push_back(0);
+		std::size_t p = 0;
+		for (double value: {s.mstars, s.mcold, s.mhot, s.mbh, s.rstars, s.rgas, s.zgas, s.vvir}) {
+			columns->properties[p++].push_back(float(value));
+		}
+	}
+	const std::size_t values = samples.size() * (columns->properties.size() + 2);
+
+	const std::vector<std::pair<std::string, hdf5::dataset_storage::compression_t>> compressions {
+		{"", hdf5::dataset_storage::NONE},
+		{"_deflate", hdf5::dataset_storage::DEFLATE}
+	};
+	for (auto &compression: compressions) {
+		hdf5::dataset_storage storage;
+		storage.compression = compression.second;
+		std::string filename = directory + "/galaxies" + compression.first + ".hdf5";
+
+		// Each run writes a whole file, including its creation and closing
+		suite.add("hdf5/write_columns" + compression.first, values, [columns, storage, filename]() {
+			hdf5::Writer writer(filename);
+			writer.set_storage(storage);
+			writer.write_dataset("galaxies/id_galaxy", columns->id_galaxy);
+			writer.write_dataset("galaxies/type", columns->type);
+			for (std::size_t p = 0; p != columns->properties.size(); p++) {
+				writer.write_dataset("galaxies/property_" + std::to_string(p), columns->properties[p]);
+			}
+			return double(columns->id_galaxy.size());
+		});
+	}
+}
+
+void add_structure_benchmarks(BenchmarkSuite &suite, const std::vector<galaxy_sample> &samples, Sampler &sampler,
+                              const std::string &directory)
+{
+	add_halo_benchmarks(suite, samples, sampler);
+	add_hdf5_benchmarks(suite, samples, directory);
+}
+
+}  // namespace benchmarks
+}  // namespace shark
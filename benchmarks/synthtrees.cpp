@@ -0,0 +1,349 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Generation of synthetic merger trees in the SURFS format
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "exceptions.h"
+#include "importer/surfs.h"
+#include "numerical_constants.h"
+#include "synthtrees.h"
+
+namespace shark {
+namespace benchmarks {
+
+namespace {
+
+// The cosmology of the sample configuration file, used only to give subhalos
+// virial velocities and spins in the range shark expects
+constexpr double OMEGA_M = 0.3121;
+constexpr double HUBBLE_H = 0.6751;
+
+// The cumulative abundance of halos at z = 0, n(>M) ~ M^-0.9 exp(-M/M_cut),
+// normalised to that of Milky Way-sized halos
+constexpr double MASS_FUNCTION_NORM = 3e-3;
+constexpr double MASS_FUNCTION_PIVOT = 1e12;
+constexpr double MASS_FUNCTION_SLOPE = -0.9;
+constexpr double MASS_FUNCTION_CUTOFF = 3e14;
+
+// The subhalo mass function of halos at z = 0, N(>m/M) = A (m/M)^-0.9, up
+// to a tenth of the mass of the halo
+constexpr double SUBHALO_MASS_FUNCTION_NORM = 0.01;
+constexpr double SUBHALO_MASS_FUNCTION_SLOPE = -0.9;
+constexpr double SUBHALO_MAX_MASS_RATIO = 0.1;
+
+// The distributions of the mass accretion rate of trees and of spins
+constexpr double LOG10_ALPHA_DEX = 0.15;
+constexpr double LOG10_LAMBDA_MEAN = -1.456;
+constexpr double LOG10_LAMBDA_DEX = 0.23;
+
+// Vmax/Vvir, the peculiar velocity dispersion of halos in km/s and the
+// scatter in the position of progenitors in Mpc/h
+constexpr double VMAX_TO_VVIR = 1.2;
+constexpr double HALO_VELOCITY_DISPERSION = 300;
+constexpr double PROGENITOR_DISPLACEMENT = 0.05;
+
+// Ids are prefixed by the snapshot number, as in VELOCIraptor
+constexpr Subhalo::id_t SNAPSHOT_ID_PREFIX = 1000000000000;
+
+xyz<double> random_direction(Sampler &sampler)
+{
+	double cos_theta = sampler.uniform(-1, 1);
+	double sin_theta = std::sqrt(1 - cos_theta * cos_theta);
+	double phi = sampler.uniform(0, 2 * constants::PI);
+	return {sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta};
+}
+
+double wrap(double x, double side)
+{
+	x = std::fmod(x, side);
+	return x < 0 ? x + side : x;
+}
+
+double hubble_parameter(double z)
+{
+	return HUBBLE_H * 100 * std::sqrt(OMEGA_M * std::pow(1 + z, 3) + (1 - OMEGA_M));
+}
+
+}  // anonymous namespace
+
+SyntheticTrees::SyntheticTrees(const synthtrees_params &params) :
+	params(params),
+	box_side(std::cbrt(params.volume))
+{
+	if (params.volume <= 0) {
+		throw invalid_argument("the volume of the synthetic trees must be positive");
+	}
+	if (params.batches == 0) {
+		throw invalid_argument("the synthetic trees need at least one batch");
+	}
+	if (params.snapshots < 2) {
+		throw invalid_argument("the synthetic trees need at least two snapshots");
+	}
+	if (params.max_redshift <= 0) {
+		throw invalid_argument("the maximum redshift of the synthetic trees must be positive");
+	}
+	if (params.min_mass <= 0 || params.min_mass >= params.max_mass) {
+		throw invalid_argument("the minimum mass of the synthetic trees must be positive and below their maximum mass");
+	}
+
+	// Snapshots are equally spaced in log(1 + z), down to z = 0
+	auto last = params.snapshots - 1;
+	for (unsigned int snapshot = 0; snapshot != params.snapshots; snapshot++) {
+		redshifts.push_back(std::pow(1 + params.max_redshift, double(last - snapshot) / last) - 1);
+	}
+}
+
+void SyntheticTrees::write_redshifts(const std::string &filename) const
+{
+	std::ofstream f(filename);
+	for (std::size_t snapshot = 0; snapshot != redshifts.size(); snapshot++) {
+		f << snapshot << " " << redshifts[snapshot] << "\n";
+	}
+	if (!f) {
+		throw exception("error while writing " + filename);
+	}
+}
+
+double SyntheticTrees::virial_velocity(double mass, double z) const
+{
+	// As in DarkMatterHalos::halo_virial_velocity
+	return std::cbrt(10.0 * constants::G * mass * hubble_parameter(z));
+}
+
+void SyntheticTrees::add_satellites(halo_node &halo, snapshot_nodes &nodes, Sampler &sampler) const
+{
+	double halo_mass = nodes.subhalos[halo.first_subhalo].mass;
+	double min_ratio = params.min_mass / halo_mass;
+	if (min_ratio >= SUBHALO_MAX_MASS_RATIO) {
+		return;
+	}
+
+	auto n_satellites = sampler.poisson(SUBHALO_MASS_FUNCTION_NORM * (std::pow(min_ratio, SUBHALO_MASS_FUNCTION_SLOPE) - std::pow(SUBHALO_MAX_MASS_RATIO, SUBHALO_MASS_FUNCTION_SLOPE)));
+	for (unsigned int i = 0; i != n_satellites; i++) {
+		double mass = halo_mass * sampler.power_law(min_ratio, SUBHALO_MAX_MASS_RATIO, SUBHALO_MASS_FUNCTION_SLOPE - 1);
+		nodes.subhalos.push_back({-1, -1, mass, sampler.exponential(params.satellite_lifetime), false, false});
+		halo.n_subhalos++;
+	}
+}
+
+SyntheticTrees::snapshot_nodes SyntheticTrees::make_roots(unsigned int batch, Sampler &sampler) const
+{
+	// Each batch is a slab of the volume along the X axis
+	double slab_width = box_side / params.batches;
+	double slab_volume = params.volume / params.batches;
+	auto abundance = [](double mass) {
+		return MASS_FUNCTION_NORM * std::pow(mass / MASS_FUNCTION_PIVOT, MASS_FUNCTION_SLOPE);
+	};
+
+	// Masses are drawn from the power law, and then thinned by its cutoff
+	snapshot_nodes roots;
+	auto n_candidates = sampler.poisson(slab_volume * (abundance(params.min_mass) - abundance(params.max_mass)));
+	for (unsigned int i = 0; i != n_candidates; i++) {
+		double mass = sampler.power_law(params.min_mass, params.max_mass, MASS_FUNCTION_SLOPE - 1);
+		if (sampler.uniform(0, 1) >= std::exp(-mass / MASS_FUNCTION_CUTOFF)) {
+			continue;
+		}
+
+		halo_node halo;
+		halo.first_subhalo = roots.subhalos.size();
+		halo.n_subhalos = 1;
+		halo.alpha = sampler.log_normal(0, LOG10_ALPHA_DEX);
+		halo.position = {sampler.uniform(batch * slab_width, (batch + 1) * slab_width),
+		                 sampler.uniform(0, box_side), sampler.uniform(0, box_side)};
+		halo.velocity = {sampler.normal(0, HALO_VELOCITY_DISPERSION), sampler.normal(0, HALO_VELOCITY_DISPERSION),
+		                 sampler.normal(0, HALO_VELOCITY_DISPERSION)};
+		roots.subhalos.push_back({-1, -1, mass, 0, false, false});
+		add_satellites(halo, roots, sampler);
+		roots.halos.push_back(halo);
+	}
+	return roots;
+}
+
+SyntheticTrees::snapshot_nodes SyntheticTrees::make_progenitors(int snapshot, const snapshot_nodes &nodes,
+                                                                const std::vector<Subhalo::id_t> &ids, Sampler &sampler) const
+{
+	double z = redshifts[snapshot];
+	double dz = redshifts[snapshot - 1] - z;
+	double dlog_z = std::log((1 + redshifts[snapshot - 1]) / (1 + z));
+
+	// The halos of satellites that had not fallen yet are added at the end,
+	// after all main progenitor halos
+	snapshot_nodes progenitors;
+	std::vector<std::pair<halo_node, subhalo_node>> infalling;
+	for (auto &halo: nodes.halos) {
+
+		auto &central = nodes.subhalos[halo.first_subhalo];
+		auto host_id = ids[halo.first_subhalo];
+		double central_mass = central.mass * std::exp(-halo.alpha * dz);
+		if (central_mass < params.min_mass) {
+			continue;
+		}
+
+		halo_node progenitor;
+		progenitor.first_subhalo = progenitors.subhalos.size();
+		progenitor.n_subhalos = 1;
+		progenitor.alpha = halo.alpha;
+		progenitor.position = {wrap(halo.position.x + sampler.normal(0, PROGENITOR_DISPLACEMENT), box_side),
+		                       wrap(halo.position.y + sampler.normal(0, PROGENITOR_DISPLACEMENT), box_side),
+		                       wrap(halo.position.z + sampler.normal(0, PROGENITOR_DISPLACEMENT), box_side)};
+		progenitor.velocity = halo.velocity;
+		progenitors.subhalos.push_back({host_id, host_id, central_mass, 0, true, false});
+
+		// Resolved mergers into the central during this step
+		double min_ratio = params.min_mass / central_mass;
+		if (min_ratio < 1) {
+			auto n_mergers = sampler.poisson(params.merger_rate * dz * (1 / min_ratio - 1));
+			for (unsigned int i = 0; i != n_mergers; i++) {
+				double mass = central_mass * sampler.power_law(min_ratio, 1, -2);
+				progenitors.subhalos.push_back({host_id, host_id, mass, sampler.exponential(params.satellite_lifetime), false, false});
+				progenitor.n_subhalos++;
+			}
+		}
+
+		// Satellites were either already satellites, or the centrals of their
+		// own halos before falling into this one
+		for (std::size_t i = 1; i != halo.n_subhalos; i++) {
+			auto &satellite = nodes.subhalos[halo.first_subhalo + i];
+			auto satellite_id = ids[halo.first_subhalo + i];
+			double lifetime = satellite.lifetime - dlog_z;
+			if (lifetime > 0) {
+				bool interpolated = sampler.uniform(0, 1) < params.interpolated_fraction;
+				progenitors.subhalos.push_back({satellite_id, host_id, satellite.mass, lifetime, true, interpolated});
+				progenitor.n_subhalos++;
+				continue;
+			}
+
+			halo_node satellite_halo;
+			satellite_halo.n_subhalos = 1;
+			satellite_halo.alpha = halo.alpha;
+			satellite_halo.position = progenitor.position;
+			satellite_halo.velocity = halo.velocity;
+			infalling.emplace_back(satellite_halo, subhalo_node {satellite_id, host_id, satellite.mass, 0, true, false});
+		}
+
+		progenitors.halos.push_back(progenitor);
+	}
+
+	for (auto &halo_and_central: infalling) {
+		auto &halo = halo_and_central.first;
+		halo.first_subhalo = progenitors.subhalos.size();
+		progenitors.subhalos.push_back(halo_and_central.second);
+		progenitors.halos.push_back(halo);
+	}
+	return progenitors;
+}
+
+void SyntheticTrees::fill_rows(int snapshot, const snapshot_nodes &nodes, const std::vector<Subhalo::id_t> &ids,
+                               importer::surfs_rows &rows, Sampler &sampler) const
+{
+	double z = redshifts[snapshot];
+	double lambda_factor = std::pow(10.0 * hubble_parameter(z), 0.33);
+
+	rows.resize(nodes.subhalos.size());
+	for (auto &halo: nodes.halos) {
+
+		// Satellites are spread within the comoving virial radius of the
+		// central, and move with respect to it
+		double central_vvir = virial_velocity(nodes.subhalos[halo.first_subhalo].mass, z);
+		double central_rvir = constants::G * nodes.subhalos[halo.first_subhalo].mass / (central_vvir * central_vvir) * (1 + z);
+		auto host_id = ids[halo.first_subhalo];
+
+		for (std::size_t j = 0; j != halo.n_subhalos; j++) {
+			auto i = halo.first_subhalo + j;
+			auto &node = nodes.subhalos[i];
+
+			auto position = halo.position;
+			auto velocity = halo.velocity;
+			if (j > 0) {
+				position += random_direction(sampler) * (central_rvir * std::cbrt(sampler.uniform(0, 1)));
+				velocity += random_direction(sampler) * std::abs(sampler.normal(0, central_vvir));
+			}
+
+			// The inverse of DarkMatterHalos::halo_lambda
+			double lambda = sampler.log_normal(LOG10_LAMBDA_MEAN, LOG10_LAMBDA_DEX);
+			double L = lambda * std::sqrt(2.) * node.mass * std::pow(constants::G * node.mass, 0.666) / lambda_factor;
+			auto spin = random_direction(sampler) * L;
+
+			rows.nodeIndex[i] = ids[i];
+			rows.descendantIndex[i] = node.descendant_id;
+			rows.hostIndex[i] = host_id;
+			rows.descendantHost[i] = node.descendant_host;
+			rows.snapshotNumber[i] = snapshot;
+			rows.nodeMass[i] = float(node.mass);
+			rows.maximumCircularVelocity[i] = float(VMAX_TO_VVIR * virial_velocity(node.mass, z));
+			rows.position[3 * i] = float(position.x);
+			rows.position[3 * i + 1] = float(position.y);
+			rows.position[3 * i + 2] = float(position.z);
+			rows.velocity[3 * i] = float(velocity.x);
+			rows.velocity[3 * i + 1] = float(velocity.y);
+			rows.velocity[3 * i + 2] = float(velocity.z);
+			rows.angularMomentum[3 * i] = float(spin.x);
+			rows.angularMomentum[3 * i + 1] = float(spin.y);
+			rows.angularMomentum[3 * i + 2] = float(spin.z);
+			rows.isMainProgenitor[i] = node.main_progenitor;
+			rows.isDHaloCentre[i] = (j == 0);
+			rows.isInterpolated[i] = node.interpolated;
+		}
+	}
+}
+
+synthtrees_stats SyntheticTrees::write_batch(unsigned int batch, const std::string &filename, unsigned long chunk_size) const
+{
+	Sampler sampler(params.seed * 6364136223846793005ull + batch);
+	importer::SURFSWriter writer(filename, chunk_size, params.batches);
+
+	synthtrees_stats stats;
+	auto nodes = make_roots(batch, sampler);
+	stats.trees = nodes.halos.size();
+
+	// Like the importer, snapshots go from last to first
+	std::vector<Subhalo::id_t> ids;
+	for (int snapshot = int(params.snapshots) - 1; snapshot >= 0 && !nodes.halos.empty(); snapshot--) {
+
+		// Ids are unique across batches
+		ids.resize(nodes.subhalos.size());
+		for (std::size_t i = 0; i != ids.size(); i++) {
+			ids[i] = snapshot * SNAPSHOT_ID_PREFIX + Subhalo::id_t(i) * params.batches + batch + 1;
+		}
+
+		importer::surfs_rows rows;
+		fill_rows(snapshot, nodes, ids, rows, sampler);
+		writer.append(snapshot, rows);
+
+		stats.halos += nodes.halos.size();
+		stats.subhalos += rows.size();
+		stats.interpolated += std::count(rows.isInterpolated.begin(), rows.isInterpolated.end(), 1);
+
+		if (snapshot > 0) {
+			nodes = make_progenitors(snapshot, nodes, ids, sampler);
+		}
+	}
+	return stats;
+}
+
+}  // namespace benchmarks
+}  // namespace shark
@@ -0,0 +1,186 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Generation of synthetic merger trees in the SURFS format
+ */
+
+#ifndef SHARK_BENCHMARKS_SYNTHTREES_H_
+#define SHARK_BENCHMARKS_SYNTHTREES_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "components.h"
+#include "mixins.h"
+#include "sampler.h"
+
+namespace shark {
+
+namespace importer {
+struct surfs_rows;
+}
+
+namespace benchmarks {
+
+/**
+ * The parameters of the synthetic merger trees. Masses are in Msun/h,
+ * lengths in comoving Mpc/h.
+ */
+struct synthtrees_params {
+
+	/// The volume of the whole simulation, in (Mpc/h)^3
+	double volume = 1000;
+
+	/// The number of batches (files) the volume is split into
+	unsigned int batches = 1;
+
+	/// The number of snapshots
+	unsigned int snapshots = 200;
+
+	/// The redshift of the first snapshot; the last one is at z = 0
+	double max_redshift = 20;
+
+	/// The mass below which halos and subhalos are not resolved
+	double min_mass = 1e10;
+
+	/// The mass above which no halos exist at z = 0
+	double max_mass = 1e15;
+
+	/// The normalisation of the halo merger rate, per unit redshift
+	double merger_rate = 0.05;
+
+	/// The mean time satellites survive before merging, in ln(1 + z)
+	double satellite_lifetime = 0.25;
+
+	/// The fraction of satellite subhalos flagged as interpolated
+	double interpolated_fraction = 0.02;
+
+	/// The seed of the trees; each batch derives its own from it
+	std::uint64_t seed = 1;
+};
+
+/// Counts of what was written into a batch file
+struct synthtrees_stats {
+	unsigned long trees = 0;
+	unsigned long halos = 0;
+	unsigned long subhalos = 0;
+	unsigned long interpolated = 0;
+};
+
+/**
+ * Generates statistically realistic merger trees and writes them in the
+ * SURFS format read by SURFSReader.
+ *
+ * Halos at z = 0 are drawn from a power-law mass function with an
+ * exponential cutoff, normalised to the abundance of Milky Way-sized halos,
+ * and placed uniformly in the slab of the volume that corresponds to their
+ * batch. Trees then grow backwards in time, one snapshot at a time, in a
+ * simplified Monte-Carlo fashion:
+ *
+ *  - Centrals follow exponential mass accretion histories,
+ *    M(z) = M0 exp(-alpha z), with alpha drawn for each tree.
+ *  - Halos accrete resolved progenitors at a rate dN/dxi/dz ~ A xi^-2, with
+ *    xi the progenitor to descendant mass ratio. These progenitors are
+ *    satellite subhalos of the main progenitor halo that merge into its
+ *    central subhalo.
+ *  - Satellites live for an exponentially distributed time; before that they
+ *    were the centrals of their own halos, whose trees grow in turn.
+ *  - A fraction of the satellites are flagged as interpolated.
+ *
+ * Branches end once their mass falls below the resolution. Only a snapshot
+ * is held in memory at a time, so the size of the trees is limited only by
+ * disk space. Each batch is generated from its own seed, so batches can be
+ * generated independently and in any order.
+ */
+class SyntheticTrees {
+
+public:
+
+	explicit SyntheticTrees(const synthtrees_params &params);
+
+	/// @return The redshift of each snapshot
+	const std::vector<double> &get_redshifts() const
+	{
+		return redshifts;
+	}
+
+	/**
+	 * Writes the redshift of each snapshot in the format expected by the
+	 * simulation.redshift_file option.
+	 *
+	 * @param filename The name of the file to write
+	 */
+	void write_redshifts(const std::string &filename) const;
+
+	/**
+	 * Generates the trees of a batch and writes them into a SURFS file.
+	 *
+	 * @param batch The batch to generate
+	 * @param filename The name of the file to write
+	 * @param chunk_size The number of rows of each chunk of the datasets
+	 * @return What was written into the file
+	 */
+	synthtrees_stats write_batch(unsigned int batch, const std::string &filename, unsigned long chunk_size) const;
+
+private:
+
+	struct subhalo_node {
+		Subhalo::id_t descendant_id;
+		Halo::id_t descendant_host;
+		double mass;
+		double lifetime;
+		bool main_progenitor;
+		bool interpolated;
+	};
+
+	struct halo_node {
+		std::size_t first_subhalo;
+		std::size_t n_subhalos;
+		double alpha;
+		xyz<double> position;
+		xyz<double> velocity;
+	};
+
+	struct snapshot_nodes {
+		std::vector<halo_node> halos;
+		std::vector<subhalo_node> subhalos;
+	};
+
+	synthtrees_params params;
+	double box_side;
+	std::vector<double> redshifts;
+
+	snapshot_nodes make_roots(unsigned int batch, Sampler &sampler) const;
+	snapshot_nodes make_progenitors(int snapshot, const snapshot_nodes &nodes, const std::vector<Subhalo::id_t> &ids,
+	                                Sampler &sampler) const;
+	void add_satellites(halo_node &halo, snapshot_nodes &nodes, Sampler &sampler) const;
+	void fill_rows(int snapshot, const snapshot_nodes &nodes, const std::vector<Subhalo::id_t> &ids,
+	               importer::surfs_rows &rows, Sampler &sampler) const;
+
+	double virial_velocity(double mass, double z) const;
+};
+
+}  // namespace benchmarks
+}  // namespace shark
+
+#endif // SHARK_BENCHMARKS_SYNTHTREES_H_
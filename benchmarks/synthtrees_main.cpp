@@ -0,0 +1,141 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * The main function for the shark-synthtrees executable
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "exceptions.h"
+#include "synthtrees.h"
+#include "timer.h"
+
+namespace shark {
+namespace benchmarks {
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+static
+int run(int argc, char **argv)
+{
+	synthtrees_params params;
+	po::options_description opts("shark-synthtrees options");
+	opts.add_options()
+		("help,h",                "Show this help message")
+		("output-dir,d",          po::value<std::string>()->default_value("."), "Directory where files are written")
+		("prefix,p",              po::value<std::string>()->default_value("tree"), "Prefix of the tree files")
+		("volume,V",              po::value<double>(&params.volume)->default_value(params.volume), "Volume of the simulation, in (Mpc/h)^3")
+		("batches,b",             po::value<unsigned int>(&params.batches)->default_value(params.batches), "Number of batches (files) the volume is split into")
+		("batch,B",               po::value<std::vector<unsigned int>>()->multitoken(), "Write only these batches (default: all)")
+		("snapshots,n",           po::value<unsigned int>(&params.snapshots)->default_value(params.snapshots), "Number of snapshots")
+		("max-redshift,z",        po::value<double>(&params.max_redshift)->default_value(params.max_redshift), "Redshift of the first snapshot")
+		("min-mass,m",            po::value<double>(&params.min_mass)->default_value(params.min_mass), "Mass resolution, in Msun/h")
+		("max-mass,M",            po::value<double>(&params.max_mass)->default_value(params.max_mass), "Maximum halo mass at z = 0, in Msun/h")
+		("merger-rate",           po::value<double>(&params.merger_rate)->default_value(params.merger_rate), "Normalisation of the halo merger rate, per unit redshift")
+		("satellite-lifetime",    po::value<double>(&params.satellite_lifetime)->default_value(params.satellite_lifetime), "Mean lifetime of satellites, in ln(1 + z)")
+		("interpolated-fraction", po::value<double>(&params.interpolated_fraction)->default_value(params.interpolated_fraction), "Fraction of satellites flagged as interpolated")
+		("seed,s",                po::value<std::uint64_t>(&params.seed)->default_value(params.seed), "Seed of the trees")
+		("chunk-size",            po::value<unsigned long>()->default_value(65536), "Number of rows of each chunk of the datasets");
+
+	try {
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, opts), vm);
+		po::notify(vm);
+
+		if (vm.count("help")) {
+			std::cout << "Usage: " << argv[0] << " [options]" << std::endl << std::endl;
+			std::cout << "Generates synthetic, statistically realistic merger trees in the SURFS format," << std::endl;
+			std::cout << "together with their redshift table." << std::endl << std::endl;
+			std::cout << opts << std::endl;
+			return 0;
+		}
+
+		SyntheticTrees trees(params);
+		std::vector<unsigned int> batches;
+		if (vm.count("batch")) {
+			batches = vm["batch"].as<std::vector<unsigned int>>();
+		}
+		else {
+			for (unsigned int batch = 0; batch != params.batches; batch++) {
+				batches.push_back(batch);
+			}
+		}
+		for (auto batch: batches) {
+			if (batch >= params.batches) {
+				throw invalid_argument("batch " + std::to_string(batch) + " is not below the number of batches");
+			}
+		}
+
+		fs::path output_dir(vm["output-dir"].as<std::string>());
+		fs::create_directories(output_dir);
+		auto prefix = (output_dir / vm["prefix"].as<std::string>()).string();
+		auto redshift_file = (output_dir / "redshifts.txt").string();
+		trees.write_redshifts(redshift_file);
+
+		auto chunk_size = vm["chunk-size"].as<unsigned long>();
+		for (auto batch: batches) {
+			Timer timer;
+			auto filename = prefix + "." + std::to_string(batch) + ".hdf5";
+			auto stats = trees.write_batch(batch, filename, chunk_size);
+			std::cout << "Batch " << batch << " with " << stats.trees << " trees, " << stats.halos << " halos and "
+			          << stats.subhalos << " subhalos (" << stats.interpolated << " interpolated) written to "
+			          << filename << " in " << timer.get() << " [ms]" << std::endl;
+		}
+
+		// What shark needs to read these trees
+		std::cout << std::endl << "Simulation options for these trees:" << std::endl << std::endl;
+		std::cout << "[simulation]" << std::endl;
+		std::cout << "volume = " << params.volume << std::endl;
+		std::cout << "particle_mass = " << params.min_mass / 20 << std::endl;
+		std::cout << "lbox = " << std::cbrt(params.volume) << std::endl;
+		std::cout << "tot_n_subvolumes = " << params.batches << std::endl;
+		std::cout << "min_snapshot = 0" << std::endl;
+		std::cout << "max_snapshot = " << params.snapshots - 1 << std::endl;
+		std::cout << "tree_files_prefix = " << prefix << std::endl;
+		std::cout << "redshift_file = " << redshift_file << std::endl;
+		return 0;
+	} catch (const shark::exception &e) {
+		std::cerr << "Error while generating the trees: " << e.what() << std::endl;
+		return 1;
+	} catch (const po::error &e) {
+		std::cerr << "Error while parsing command-line: " << e.what() << std::endl;
+		return 1;
+	} catch (const std::exception &e) {
+		std::cerr << "Unexpected exception while running" << std::endl << std::endl;
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
+
+}  // namespace benchmarks
+}  // namespace shark
+
+int main(int argc, char **argv) {
+	return shark::benchmarks::run(argc, argv);
+}
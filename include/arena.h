@@ -0,0 +1,189 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Arena allocation of shared objects
+ */
+
+#ifndef SHARK_ARENA_H
+#define SHARK_ARENA_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "huge_pages.h"
+
+namespace shark {
+
+/**
+ * A bump allocator handing out memory from large, contiguous blocks.
+ *
+ * Memory is never given back to the arena on deallocation; instead, all
+ * blocks are released together when the arena is destroyed. Arenas are
+ * therefore meant for many small objects that live and die together, like
+ * the halos of a snapshot. Arenas are not thread-safe: each thread
+ * allocating objects should use its own.
+ *
+ * Blocks are backed by huge pages if these are enabled (see
+ * huge_pages::enable), which reduces TLB misses when traversing the objects
+ * of large arenas.
+ */
+class Arena {
+
+public:
+
+	/// The default size of the blocks allocated by arenas
+	static constexpr std::size_t default_block_size = 1024 * 1024;
+
+	explicit Arena(std::size_t block_size = default_block_size);
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+	~Arena();
+
+	/// Returns @p size bytes of memory aligned to @p alignment
+	void *allocate(std::size_t size, std::size_t alignment);
+
+	/// @return The number of bytes allocated by this arena's blocks
+	std::size_t reserved() const {
+		return reserved_bytes;
+	}
+
+	/// @return The number of bytes handed out by this arena
+	std::size_t used() const {
+		return used_bytes;
+	}
+
+private:
+	std::size_t block_size;
+	std::vector<huge_pages::block> blocks;
+	char *current;
+	std::size_t remaining;
+	std::size_t reserved_bytes;
+	std::size_t used_bytes;
+};
+
+typedef std::shared_ptr<Arena> ArenaPtr;
+
+/**
+ * A standard allocator taking memory from an Arena. Each allocator keeps its
+ * arena alive, so objects created with allocate_shared and this allocator
+ * (whose control blocks hold a copy of it) keep their arena alive until the
+ * last of them is released.
+ */
+template <typename T>
+class arena_allocator {
+
+public:
+	typedef T value_type;
+
+	explicit arena_allocator(ArenaPtr arena) : arena(std::move(arena)) {}
+
+	template <typename U>
+	arena_allocator(const arena_allocator<U> &other) : arena(other.arena) {}
+
+	T *allocate(std::size_t n)
+	{
+		return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *, std::size_t)
+	{
+		// Memory is released with the arena
+	}
+
+	template <typename U>
+	bool operator==(const arena_allocator<U> &other) const {
+		return arena == other.arena;
+	}
+
+	template <typename U>
+	bool operator!=(const arena_allocator<U> &other) const {
+		return arena != other.arena;
+	}
+
+private:
+	ArenaPtr arena;
+
+	template <typename U>
+	friend class arena_allocator;
+};
+
+/**
+ * Like std::make_shared, but allocates the new object from @p arena if given
+ */
+template <typename T, typename ...Args>
+std::shared_ptr<T> make_shared_in(const ArenaPtr &arena, Args&&...args)
+{
+	if (!arena) {
+		return std::make_shared<T>(std::forward<Args>(args)...);
+	}
+	return std::allocate_shared<T>(arena_allocator<T>(arena), std::forward<Args>(args)...);
+}
+
+/**
+ * A set of arenas, one per key (e.g., a snapshot), so that objects sharing a
+ * key are placed together and released together
+ */
+template <typename Key>
+class ArenaSet {
+
+public:
+
+	/// Returns the arena for @p key, creating it if necessary
+	const ArenaPtr &get(const Key &key)
+	{
+		auto &arena = arenas[key];
+		if (!arena) {
+			arena = std::make_shared<Arena>();
+		}
+		return arena;
+	}
+
+	/// @return The number of bytes allocated by the blocks of all arenas
+	std::size_t reserved() const {
+		std::size_t total = 0;
+		for (auto &key_and_arena: arenas) {
+			total += key_and_arena.second->reserved();
+		}
+		return total;
+	}
+
+	/// @return The number of bytes handed out by all arenas
+	std::size_t used() const {
+		std::size_t total = 0;
+		for (auto &key_and_arena: arenas) {
+			total += key_and_arena.second->used();
+		}
+		return total;
+	}
+
+private:
+	std::map<Key, ArenaPtr> arenas;
+};
+
+}  // namespace shark
+
+#endif // SHARK_ARENA_H
@@ -0,0 +1,96 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * A worker thread that executes jobs in the background
+ */
+
+#ifndef SHARK_BACKGROUND_WORKER_H_
+#define SHARK_BACKGROUND_WORKER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace shark {
+
+/**
+ * A single thread that executes submitted jobs in the background, in the same
+ * order they were submitted. At most a given number of jobs can be pending
+ * (i.e., queued or being executed) at any time; further submissions block
+ * until a pending job finishes. Exceptions thrown by jobs are re-thrown to the
+ * submitting thread on the next call to submit() or wait().
+ */
+class BackgroundWorker {
+
+public:
+	typedef std::function<void()> job_t;
+
+	/**
+	 * Creates a new worker and starts its thread
+	 *
+	 * @param max_pending_jobs The maximum number of jobs that can be pending at
+	 * any given time. Must be greater than 0.
+	 */
+	explicit BackgroundWorker(unsigned int max_pending_jobs);
+
+	/**
+	 * Waits for all pending jobs and stops the thread. Errors from outstanding
+	 * jobs are logged, but not re-thrown.
+	 */
+	~BackgroundWorker();
+
+	BackgroundWorker(const BackgroundWorker &) = delete;
+	BackgroundWorker &operator=(const BackgroundWorker &) = delete;
+
+	/**
+	 * Submits a new job for execution, blocking until the maximum number of
+	 * pending jobs allows it
+	 *
+	 * @param job The job to execute
+	 */
+	void submit(job_t &&job);
+
+	/**
+	 * Waits until all pending jobs have finished
+	 */
+	void wait();
+
+private:
+	unsigned int max_pending_jobs;
+	std::deque<job_t> jobs;
+	bool job_running;
+	bool stopping;
+	std::exception_ptr error;
+	std::mutex mutex;
+	std::condition_variable jobs_changed;
+	std::thread thread;
+
+	void run();
+	void rethrow_error();
+};
+
+}  // namespace shark
+
+#endif // SHARK_BACKGROUND_WORKER_H_
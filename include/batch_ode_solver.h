@@ -0,0 +1,140 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Batched ODE solver definition
+ */
+
+#ifndef SHARK_BATCH_ODE_SOLVER_H_
+#define SHARK_BATCH_ODE_SOLVER_H_
+
+#include <array>
+#include <vector>
+
+#include "ode_solver.h"
+
+namespace shark {
+
+/**
+ * A solver that evolves many independent ODE systems of the same dimension
+ * in lockstep.
+ *
+ * Systems are advanced together using the same embedded Runge-Kutta
+ * Cash-Karp method and step size control used by ODESolver, but with each
+ * system (or *lane*) having its own step size. Lanes that reach their final
+ * time are masked out while the remaining ones continue. Values are kept in
+ * a structure-of-arrays layout, and the Runge-Kutta stages are combined for
+ * all lanes at once in plain loops. This is not a SIMD solver: no
+ * vector instructions are used explicitly, and the evaluator is called
+ * once per lane with scalar code.
+ */
+class BatchODESolver {
+
+public:
+
+	/**
+	 * Creates a new BatchODESolver
+	 *
+	 * @param dimension The number of components of the ODE systems to solve
+	 * @param precision The relative precision to use for the adaptive step sizes
+	 * @param evaluator The function evaluating each system at time `t`
+	 * @param max_steps The maximum number of steps a system can take before
+	 * its integration is stopped.
+	 */
+	BatchODESolver(std::size_t dimension, double precision, ODESolver::ode_evaluator evaluator, unsigned long int max_steps = 1000000);
+
+	/**
+	 * Evolves a batch of systems from `t = 0` up to their respective
+	 * `delta_t`. Values are given in a structure-of-arrays layout: with `n`
+	 * systems, component `c` of system `l` is found at `y[c * n + l]`.
+	 *
+	 * @param y The initial values of all systems, overwritten with the final
+	 * ones.
+	 * @param delta_t The time up to which each system is evolved. Its size
+	 * determines the number of systems.
+	 * @param params The user-provided data passed to the evaluator for each
+	 * system.
+	 * @param h_start The initial step size of each system. If empty, or for
+	 * values that are not positive or larger than their `delta_t`, the
+	 * corresponding `delta_t` is used.
+	 */
+	void evolve(std::vector<double> &y, const std::vector<double> &delta_t, const std::vector<void *> &params,
+	            const std::vector<double> &h_start = {});
+
+	/**
+	 * Returns the number of steps that a system of the last batch took.
+	 *
+	 * @param system The index of the system within the last batch
+	 * @return The number of steps taken by the system
+	 */
+	unsigned long int num_evaluations(std::size_t system) const {
+		return steps[system];
+	}
+
+	/**
+	 * Returns the mean size of the steps that a system of the last batch
+	 * took, or 0 if it took none.
+	 *
+	 * @param system The index of the system within the last batch
+	 * @return The mean step size of the system
+	 */
+	double mean_step(std::size_t system) const {
+		if (steps[system] == 0) {
+			return 0;
+		}
+		return t[system] / steps[system];
+	}
+
+	/// @return The dimension of the systems solved by this solver
+	std::size_t get_dimension() const {
+		return dimension;
+	}
+
+private:
+	std::size_t dimension;
+	double precision;
+	ODESolver::ode_evaluator evaluator;
+	unsigned long int max_steps;
+
+	// Per-lane state, reused across batches to avoid reallocations
+	std::vector<double> t;
+	std::vector<double> h;
+	std::vector<double> h_step;
+	std::vector<char> active;
+	std::vector<unsigned long int> steps;
+
+	// Per-component, per-lane values
+	std::array<std::vector<double>, 6> k;
+	std::vector<double> y_stage;
+	std::vector<double> y_new;
+	std::vector<double> y_err;
+
+	// Scratch space to call the evaluator on a single lane
+	std::vector<double> lane_y;
+	std::vector<double> lane_f;
+
+	void evaluate(std::vector<double> &f, const std::vector<double> &y, double stage_fraction, const std::vector<void *> &params);
+	void combine(std::vector<double> &out, const std::vector<double> &y, const double coefficients[], std::size_t n_terms);
+};
+
+}  // namespace shark
+
+#endif // SHARK_BATCH_ODE_SOLVER_H_
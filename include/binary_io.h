@@ -0,0 +1,152 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Raw reading and writing of values in the host's native binary format
+ */
+
+#ifndef SHARK_BINARY_IO_H_
+#define SHARK_BINARY_IO_H_
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "exceptions.h"
+
+namespace shark {
+
+/**
+ * Writes trivially copyable values, and vectors, strings and maps of them,
+ * into a stream exactly as they are laid out in memory. Containers are
+ * prefixed with their size.
+ */
+class binary_writer {
+
+public:
+	explicit binary_writer(std::ostream &os) : os(os) {}
+
+	template <typename T>
+	void write(const T &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be written raw");
+		os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	template <typename T>
+	void write(const std::vector<T> &values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be written raw");
+		write(std::uint64_t(values.size()));
+		os.write(reinterpret_cast<const char *>(values.data()), sizeof(T) * values.size());
+	}
+
+	void write(const std::string &s)
+	{
+		write(std::uint64_t(s.size()));
+		os.write(s.data(), s.size());
+	}
+
+	template <typename K, typename V>
+	void write(const std::map<K, V> &values)
+	{
+		write(std::uint64_t(values.size()));
+		for (auto &item: values) {
+			write(item.first);
+			write(item.second);
+		}
+	}
+
+private:
+	std::ostream &os;
+};
+
+/**
+ * Reads back what a binary_writer wrote. An invalid_data exception is thrown
+ * if the stream ends before all requested data has been read.
+ */
+class binary_reader {
+
+public:
+	binary_reader(std::istream &is, const std::string &filename) : is(is), filename(filename) {}
+
+	template <typename T>
+	void read(T &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be read raw");
+		read_bytes(reinterpret_cast<char *>(&value), sizeof(T));
+	}
+
+	template <typename T>
+	void read(std::vector<T> &values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be read raw");
+		values.resize(read_size());
+		read_bytes(reinterpret_cast<char *>(values.data()), sizeof(T) * values.size());
+	}
+
+	void read(std::string &s)
+	{
+		s.resize(read_size());
+		read_bytes(&s[0], s.size());
+	}
+
+	template <typename K, typename V>
+	void read(std::map<K, V> &values)
+	{
+		values.clear();
+		auto size = read_size();
+		for (std::uint64_t i = 0; i != size; i++) {
+			K key;
+			V value;
+			read(key);
+			read(value);
+			values.emplace(key, value);
+		}
+	}
+
+	std::uint64_t read_size()
+	{
+		std::uint64_t size;
+		read(size);
+		return size;
+	}
+
+private:
+	std::istream &is;
+	const std::string &filename;
+
+	void read_bytes(char *buf, std::size_t size)
+	{
+		is.read(buf, size);
+		if (!is) {
+			throw invalid_data(filename + " is truncated or corrupted");
+		}
+	}
+};
+
+}  // namespace shark
+
+#endif // SHARK_BINARY_IO_H_
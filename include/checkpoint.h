@@ -0,0 +1,125 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Saving and restoring of the evolution state at snapshot boundaries
+ */
+
+#ifndef SHARK_CHECKPOINT_H_
+#define SHARK_CHECKPOINT_H_
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "components.h"
+
+namespace shark {
+
+class binary_reader;
+class binary_writer;
+
+/**
+ * Writes the ID of @p subhalo and its evolution state (its gas reservoirs and
+ * galaxies) in the format used by checkpoints.
+ *
+ * @param w The writer to write with
+ * @param subhalo The subhalo to write
+ */
+void write_subhalo_state(binary_writer &w, const Subhalo &subhalo);
+
+/**
+ * Reads the evolution state of @p subhalo written by write_subhalo_state,
+ * whose ID must have been read already. The galaxies of @p subhalo are
+ * replaced by the ones read.
+ *
+ * @param r The reader to read with
+ * @param subhalo The subhalo whose state is read
+ */
+void read_subhalo_state(binary_reader &r, Subhalo &subhalo);
+
+/**
+ * The state of a shark execution at a snapshot boundary, excluding the merger
+ * trees themselves, which are deterministically re-created from the input
+ * data and the options on restart.
+ *
+ * The checkpoint holds the galaxies and baryon reservoirs of all subhalos of
+ * the snapshot that would be evolved next and the TotalBaryon accumulators,
+ * which is all that changes during the evolution. Random numbers are drawn
+ * from counter-based streams (see philox_engine), so they need no saving.
+ */
+class Checkpoint {
+
+public:
+
+	/// The snapshot from which galaxies will continue to be evolved
+	int snapshot = 0;
+
+	/// The number of galaxy IDs handed out by the GalaxyCreator
+	Galaxy::id_t n_galaxy_ids = 0;
+
+	/// The options of the execution that wrote the checkpoint, used to
+	/// check whether other executions can branch off from it
+	std::map<std::string, std::string> options {};
+
+	/**
+	 * Writes a checkpoint of the current state into @p filename.
+	 *
+	 * Checkpoints are written in the host's native binary format, and are
+	 * therefore meant to be read only by the same shark build on the same
+	 * kind of machine.
+	 *
+	 * @param filename The name of the checkpoint file
+	 * @param merger_trees All merger trees of this execution
+	 * @param all_baryons The global baryon tracking object
+	 */
+	void write(const std::string &filename, const std::vector<MergerTreePtr> &merger_trees, const TotalBaryon &all_baryons) const;
+
+	/**
+	 * Reads the checkpoint stored in @p filename, restoring the galaxies and
+	 * baryons of the corresponding subhalos in @p merger_trees. All galaxies
+	 * already present in these subhalos are discarded. The snapshot and the
+	 * number of galaxy IDs are loaded in this object, and it is up to the
+	 * caller to use them.
+	 *
+	 * @param filename The name of the checkpoint file
+	 * @param merger_trees All merger trees of this execution, re-created from
+	 * the same input data and options used when writing the checkpoint
+	 * @param all_baryons The global baryon tracking object, which is overwritten
+	 */
+	void read(const std::string &filename, const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &all_baryons);
+
+	/**
+	 * Reads only the snapshot and options of the checkpoint stored in
+	 * @p filename into this object.
+	 *
+	 * @param filename The name of the checkpoint file
+	 */
+	void read_header(const std::string &filename);
+
+private:
+	void read_header(std::istream &is, const std::string &filename);
+};
+
+}  // namespace shark
+
+#endif // SHARK_CHECKPOINT_H_
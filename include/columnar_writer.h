@@ -0,0 +1,195 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Header file for the ColumnarWriter class
+ */
+
+#ifndef SHARK_COLUMNAR_WRITER_H_
+#define SHARK_COLUMNAR_WRITER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "exceptions.h"
+
+namespace shark {
+
+/**
+ * An object with the same writing interface as hdf5::Writer that writes
+ * each dataset of numerical values as a raw, little-endian column file under
+ * a directory, plus a schema.json file describing all columns and holding
+ * all scalar values and attributes.
+ *
+ * Column files have no headers or padding, and can therefore be
+ * memory-mapped by analysis tools and used as they are.
+ *
+ * Like hdf5::DeferredWriter, values are kept in memory until flush() is
+ * called, so they can be collected in one thread and written in another.
+ */
+class ColumnarWriter {
+
+public:
+
+	/**
+	 * Constructs a new ColumnarWriter object.
+	 *
+	 * @param directory The directory where columns are written
+	 */
+	explicit ColumnarWriter(const std::string &directory);
+
+	template<typename T>
+	void write_attribute(const std::string &name, const T &value) {
+		attributes.push_back({name, std::string(), json_value(value), std::string()});
+	}
+
+	template<typename T>
+	void write_dataset(const std::string &name, const T &value, const std::string &comment = std::string()) {
+		scalars.push_back({name, type_name<T>(), json_value(value), comment});
+	}
+
+	void write_dataset(const std::string &name, const std::string &value, const std::string &comment = std::string()) {
+		scalars.push_back({name, "string", json_value(value), comment});
+	}
+
+	void write_dataset(const std::string &name, const char *value, const std::string &comment = std::string()) {
+		write_dataset(name, std::string(value), comment);
+	}
+
+	template<typename T>
+	void write_dataset(const std::string &name, const std::vector<T> &values, const std::string &comment = std::string()) {
+		column col {name, type_name<T>(), {values.size()}, comment, {}};
+		append_values(col.data, values, std::is_same<T, bool>());
+		columns.emplace_back(std::move(col));
+	}
+
+	template<typename T>
+	void write_dataset(const std::string &name, const std::vector<std::vector<T>> &values, const std::string &comment = std::string()) {
+		std::size_t width = values.empty() ? 0 : values[0].size();
+		column col {name, type_name<T>(), {values.size(), width}, comment, {}};
+		col.data.reserve(values.size() * width * sizeof(T));
+		for (auto &row: values) {
+			if (row.size() != width) {
+				throw invalid_argument("rows of dataset " + name + " have different sizes");
+			}
+			append_values(col.data, row, std::is_same<T, bool>());
+		}
+		columns.emplace_back(std::move(col));
+	}
+
+	/**
+	 * Creates the directory and writes all the columns given so far, plus the
+	 * schema file, into it.
+	 */
+	void flush();
+
+	/**
+	 * Returns the directory this object will write to.
+	 * @return The directory this object will write to.
+	 */
+	const std::string &get_directory() const {
+		return directory;
+	}
+
+private:
+
+	struct column {
+		std::string name;
+		std::string type;
+		std::vector<std::size_t> shape;
+		std::string comment;
+		std::vector<char> data;
+	};
+
+	struct value {
+		std::string name;
+		std::string type;
+		std::string json;
+		std::string comment;
+	};
+
+	template <typename T>
+	static std::string type_name() {
+		static_assert(std::is_arithmetic<T>::value, "only numerical values can be written as columns");
+		if (std::is_same<T, bool>::value) {
+			return "bool";
+		}
+		std::string kind = std::is_floating_point<T>::value ? "float" : (std::is_signed<T>::value ? "int" : "uint");
+		return kind + std::to_string(sizeof(T) * 8);
+	}
+
+	template <typename T>
+	static std::string json_value(const T &value) {
+		static_assert(std::is_arithmetic<T>::value, "only numerical and string values can be written");
+		if (std::is_same<T, bool>::value) {
+			return value ? "true" : "false";
+		}
+		// JSON has no representation for these
+		if (value != value || value > std::numeric_limits<T>::max() || value < std::numeric_limits<T>::lowest()) {
+			return "null";
+		}
+		std::ostringstream os;
+		os.precision(std::numeric_limits<T>::max_digits10);
+		os << +value;
+		return os.str();
+	}
+
+	static std::string json_value(const std::string &value);
+
+	static bool big_endian();
+
+	/// Appends the bytes of @p values, in little-endian order
+	template <typename T>
+	static void append_values(std::vector<char> &data, const std::vector<T> &values, std::false_type) {
+		auto start = data.size();
+		data.resize(start + values.size() * sizeof(T));
+		if (!values.empty()) {
+			std::memcpy(data.data() + start, values.data(), values.size() * sizeof(T));
+		}
+		if (sizeof(T) > 1 && big_endian()) {
+			swap_bytes(data.data() + start, values.size(), sizeof(T));
+		}
+	}
+
+	/// Booleans are written as one byte each
+	template <typename T>
+	static void append_values(std::vector<char> &data, const std::vector<T> &values, std::true_type) {
+		for (bool b: values) {
+			data.push_back(b ? 1 : 0);
+		}
+	}
+
+	static void swap_bytes(char *data, std::size_t count, std::size_t size);
+
+	std::string directory;
+	std::vector<column> columns {};
+	std::vector<value> scalars {};
+	std::vector<value> attributes {};
+};
+
+}  // namespace shark
+
+#endif // SHARK_COLUMNAR_WRITER_H_
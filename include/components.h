@@ -30,10 +30,12 @@
 #include <map>
 #include <memory>
 #include <ostream>
-#include <set>
 #include <vector>
 
+#include "galaxy_history.h"
 #include "mixins.h"
+#include "small_vector.h"
+#include "span.h"
 
 namespace shark {
 
@@ -48,8 +50,11 @@ typedef std::shared_ptr<Subhalo> SubhaloPtr;
 typedef std::shared_ptr<Halo> HaloPtr;
 typedef std::shared_ptr<MergerTree> MergerTreePtr;
 
+/// The list of galaxies of a subhalo, normally holding a single galaxy
+typedef small_vector<GalaxyPtr, 1> galaxies_t;
+
 /// Type used by galaxy_count() methods
-typedef typename std::vector<GalaxyPtr>::size_type galaxies_size_type;
+typedef typename galaxies_t::size_type galaxies_size_type;
 
 /**
  * The common base for all baryon component types.
@@ -141,19 +146,6 @@ public:
 
 
 
-/**
- * Structure that saves the history of relevant baryon components needed for SED calculation later on.
- */
-struct HistoryItem {
-	float sfr_disk;
-	float sfr_bulge_mergers;
-	float sfr_bulge_diskins;
-	float sfr_z_disk;
-	float sfr_z_bulge_mergers;
-	float sfr_z_bulge_diskins;
-	int snapshot;
-};
-
 struct InteractionItem{
 	int major_mergers = 0;
 	int minor_mergers = 0;
@@ -191,10 +183,14 @@ public:
 	};
 
 
-	/**
-	 * The ID of the descendant of this galaxy.
+	/*
+	 * Members are laid out in two blocks. The first one holds the evolution
+	 * state read and written by the ODE integrations, mergers and disk
+	 * instabilities for every galaxy on every snapshot, and is kept compact
+	 * so it spans as few cache lines as possible. The second one holds
+	 * bookkeeping that is touched once per snapshot or only when writing
+	 * outputs.
 	 */
-	id_t descendant_id = -1;
 
 	/**
 	 * The type of galaxy
@@ -219,6 +215,43 @@ public:
 	float sfr_z_bulge_mergers = 0;
 	float sfr_z_bulge_diskins = 0;
 
+	/**
+	 * Mean step size [Gyr] of the last integration of this galaxy's ODE
+	 * system, used as the initial step of the next one when warm-starting
+	 * ODE integrations. 0 means unknown. This is only a hint for the
+	 * adaptive stepper, so single precision is enough.
+	 */
+	float ode_step = 0;
+
+	/**
+	 * merger_age: age of the universe [Gyr] at which this galaxy merges with the central galaxy of its halo,
+	 * given by its dynamical friction timescale, which is defined only if galaxy is satellite.
+	 * Until the galaxy becomes type 2 this is instead its remaining timescale [Gyr], which only starts elapsing then
+	 * (see Subhalo::queue_merger).
+	 * concentration_type2: concentration of the subhalo this galaxy was before becoming type 2 (only relevant for type 2 galaxies).
+	 * msubhalo_type2: subhalo mass of this galaxy before it became type 2 (only relevant for type 2 galaxies).
+	 * vvir_type2: subhalo virial velocity of this galaxy before it became type 2 (only relevant for type 2 galaxies).
+	 * lambda_type2: subhalo spin parameter of this galaxy before it became type 2 (only relevant for type 2 galaxies).
+	 */
+	double merger_age = 0;
+	float concentration_type2 = 0;
+	float msubhalo_type2 = 0;
+	float vvir_type2 = 0;
+	float lambda_type2 = 0;
+
+	/**
+	 * The ID of the descendant of this galaxy.
+	 */
+	id_t descendant_id = -1;
+
+	/**
+	 * The key of this galaxy's counter-based random streams (see
+	 * philox_engine). It is the ID the galaxy was created with, and unlike
+	 * its ID it is kept when its merger tree migrates to another process, so
+	 * random numbers don't depend on how trees are balanced.
+	 */
+	id_t random_key {id};
+
 	/**
 	 * Keep track of mean stellar age using:
 	 *  mean_stellar_age: stellar mass formed times the mean age at which they formed.
@@ -230,24 +263,11 @@ public:
 	//save maximum circular velocity.
 	float vmax = 0;
 
-	//save star formation and gas history
-	std::vector<HistoryItem>  history {};
-
 	//save interactions of this galaxy during this snapshot.
 	InteractionItem interaction {};
 
-	/**
-	 * tmerge: dynamical friction timescale, which is defined only if galaxy is satellite.
-	 * concentration_type2: concentration of the subhalo this galaxy was before becoming type 2 (only relevant for type 2 galaxies).
-	 * msubhalo_type2: subhalo mass of this galaxy before it became type 2 (only relevant for type 2 galaxies).
-	 * vvir_type2: subhalo virial velocity of this galaxy before it became type 2 (only relevant for type 2 galaxies).
-	 * lambda_type2: subhalo spin parameter of this galaxy before it became type 2 (only relevant for type 2 galaxies).
-	 */
-	float tmerge = 0;
-	float concentration_type2 = 0;
-	float msubhalo_type2 = 0;
-	float vvir_type2 = 0;
-	float lambda_type2 = 0;
+	//save star formation and gas history
+	GalaxyHistory history {id};
 
 	/**
 	 * Define functions to calculate total mass and metals of various components.
@@ -374,24 +394,31 @@ public:
 
 /**
  * This structure keeps track of the properties of the halo gas, which are necessary to implement a more sophisticated cooling model.
+ *
+ * The cooling model only uses the history of the virial temperature, total
+ * halo gas and cooling time through the integral of T * M / tcool over time,
+ * so only that integral is kept, accumulated as each step is added. This keeps
+ * the structure small and trivially copyable, instead of holding a growing
+ * history.
  */
 struct CoolingSubhaloTracking {
 	/**
 	 * Initialize values in zero.
 	 */
 	CoolingSubhaloTracking():
-		deltat(),
-		temp(),
-		mass(),
-		tcooling(),
+		integral(0),
 		rheat(0)
 	{
 		//no=op
 	};
-	std::vector<double> deltat;
-	std::vector<double> temp;
-	std::vector<double> mass;
-	std::vector<double> tcooling;
+
+	/// Adds a time step of length deltat to the history
+	void add(double deltat, double temp, double mass, double tcooling) {
+		integral += temp * mass / tcooling * deltat;
+	}
+
+	/// Integral of T * M / tcool over the history
+	double integral;
 	double rheat;
 };
 
@@ -424,61 +451,75 @@ public:
 		FLYBY
 	};
 
-	/**
-	 * The snapshot at which this subhalo is found
+	/*
+	 * As in Galaxy, members are split in two blocks: the first one holds the
+	 * state used while evolving the subhalo's galaxies on every snapshot, the
+	 * second one the tree bookkeeping only used while building trees and
+	 * moving galaxies between snapshots.
 	 */
-	int snapshot;
 
 	/**
-	 * Whether this subhalo has a descendant or not
+	 * The subhalo type
 	 */
-	bool has_descendant = false;
+	subhalo_type_t subhalo_type = CENTRAL;
+
+	/** Vvir: virial velocity of the subhalo [km/s]
+	 * Mvir: virial mass of the subhalo [Msun/h]
+	 * L: angular momentum of subhalo [Msun/h km/s Mpc/h]
+	 * Vcirc: maximum circular velocity of the subhalo [km/s]
+	 * concentration: NFW concentration parameter of subhalo
+	 * lambda: spin parameter of subhalo
+	 *  */
+	float Vvir = 0;
+	float Mvir = 0;
+	xyz<float> L {0, 0, 0};
+	float Vcirc = 0;
+	float concentration = 0;
+	float lambda = 0;
 
 	/**
-	 * Boolean property indicating if subhalo is a main progenitor of its descendant.
+	 * Quantities derived from Vvir and Mvir, which don't change once trees
+	 * are built, and are needed by several physics modules on every snapshot:
+	 * the virial radius [Mpc/h] and log10 of the virial temperature [K].
+	 * DarkMatterHalos calculates them when first needed; rvir is negative
+	 * until then.
 	 */
-	bool main_progenitor = false;
+	double rvir = -1;
+	double log_tvir = 0;
 
 	/**
-	 * Boolean property indicating if subhalo is the result of an interpolation in snapshots were descendants were missing. In this case Dhalos puts a subhalo in those snapshots
-	 * to ensure continuation of the merger tree.
+	 * The accreted baryonic mass onto the subhalo. This information comes from the merger tree.
 	 */
-	bool IsInterpolated = false;
+	float accreted_mass = 0;
 
 	/**
-	 * The ID of the descendant of this subhalo.
-	 * Valid only if has_descendant is \code{true}
+	 * cooling_subhalo_tracking: saves que information of the virial temperature, total halo gas and cooling time history.
 	 */
-	id_t descendant_id = 0;
+	CoolingSubhaloTracking cooling_subhalo_tracking {};
 
 	/**
-	 * The ID of the Halo containing the descendant of this subhalo
+	 * Hot gas component of the halo and outside the galaxies that is
+	 * allowed to cool down and/or fall onto the galaxy.
 	 */
-	id_t descendant_halo_id = 0;
+	Baryon hot_halo_gas {};
 
 	/**
-	 * The snapshot at which the descendant of this subhalo can be found
+	 * Cold gas component of the halo and outside the galaxies that has
+	 * cooled down.
 	 */
-	int descendant_snapshot = -1;
-
-    /**
-     * Integer that shows if this subhalo will disappear from the tree in the next snapshot.
-     * last_snapshot_identified = 1 if disappears in the next snapshot, =0 otherwise.
-     */
-
-    int last_snapshot_identified = -1;
+	Baryon cold_halo_gas {};
 
 	/**
-	 * A pointer to the descendant of this subhalo.
-	 * If this pointer is set then descendant_id and descendant_subhalo are
-	 * meaningless.
+	 * Hot gas component of the halo and outside galaxies that tracks
+	 * the ejected outflowing gas from the galaxy and that is not
+	 * available for cooling yet.
 	 */
-	SubhaloPtr descendant {};
+	Baryon ejected_galaxy_gas {};
 
 	/**
 	 * The list of galaxies in this subhalo.
 	 */
-	std::vector<GalaxyPtr> galaxies {};
+	galaxies_t galaxies {};
 
 	/** Returns a pointer to the central galaxy. If no central galaxy is found
 	 in this Subhalo, then an empty pointer is returned.
@@ -496,69 +537,131 @@ public:
 	std::vector<GalaxyPtr> all_type2_galaxies() const;
 
 	/**
-	 * The subhalo type
+	 * The type 2 satellites of this subhalo arranged as a min-heap on their
+	 * merger_age, so those merging first are found without going through all
+	 * galaxies. Kept up to date when galaxies are transferred between
+	 * subhalos; otherwise see queue_merger and rebuild_merger_queue.
 	 */
-	subhalo_type_t subhalo_type = CENTRAL;
+	std::vector<GalaxyPtr> merger_queue {};
 
 	/**
-	 * haloID: ID of the Halo this Subhalo belong to
+	 * Adds a galaxy of this subhalo that just became type 2 to merger_queue,
+	 * turning its remaining merging timescale into a merger_age
+	 *
+	 * @param galaxy The galaxy
+	 * @param age The age of the universe [Gyr] from which its merging
+	 * timescale elapses
 	 */
-	id_t haloID = 0;
+	void queue_merger(const GalaxyPtr &galaxy, double age);
 
-	/** Vvir: virial velocity of the subhalo [km/s]
-	 * Mvir: virial mass of the subhalo [Msun/h]
-	 * L: angular momentum of subhalo [Msun/h km/s Mpc/h]
-	 * Vcirc: maximum circular velocity of the subhalo [km/s]
-	 * concentration: NFW concentration parameter of subhalo
-	 * lambda: spin parameter of subhalo
-	 *  */
-	float Vvir = 0;
-	float Mvir = 0;
-	xyz<float> L {0, 0, 0};
-	float Vcirc = 0;
-	float concentration = 0;
-	float lambda = 0;
+	/**
+	 * Builds merger_queue again from the type 2 galaxies of this subhalo,
+	 * e.g., after changing their merger_age
+	 */
+	void rebuild_merger_queue();
 
 	/**
-	 * cooling_subhalo_tracking: saves que information of the virial temperature, total halo gas and cooling time history.
+	 * Removes from this subhalo the type 2 galaxies merging before @p age
+	 *
+	 * @param age An age of the universe [Gyr]
+	 * @return The removed galaxies, in the order they had in this subhalo
 	 */
-	CoolingSubhaloTracking cooling_subhalo_tracking {};
+	std::vector<GalaxyPtr> remove_mergers(double age);
 
+	/**
+	 * Calls @p f on each type 2 galaxy of this subhalo merging before
+	 * @p age, in no particular order
+	 *
+	 * @param age An age of the universe [Gyr]
+	 * @param f A callable taking a galaxy
+	 */
+	template <typename Callable>
+	void for_each_merger_before(double age, Callable &&f) const
+	{
+		// Only the top of the heap needs visiting
+		if (merger_queue.empty() || merger_queue.front()->merger_age >= age) {
+			return;
+		}
+		std::vector<std::size_t> pending {0};
+		while (!pending.empty()) {
+			auto i = pending.back();
+			pending.pop_back();
+			f(merger_queue[i]);
+			for (auto child: {2 * i + 1, 2 * i + 2}) {
+				if (child < merger_queue.size() && merger_queue[child]->merger_age < age) {
+					pending.push_back(child);
+				}
+			}
+		}
+	}
 
 	/**
-	 * Hot gas component of the halo and outside the galaxies that is
-	 * allowed to cool down and/or fall onto the galaxy.
+	 * The halo that holds this subhalo.
 	 */
-	Baryon hot_halo_gas {};
+	HaloPtr host_halo {};
 
 	/**
-	 * Cold gas component of the halo and outside the galaxies that has
-	 * cooled down.
+	 * The snapshot at which this subhalo is found
 	 */
-	Baryon cold_halo_gas {};
+	int snapshot;
+
+    /**
+     * Integer that shows if this subhalo will disappear from the tree in the next snapshot.
+     * last_snapshot_identified = 1 if disappears in the next snapshot, =0 otherwise.
+     */
+
+    int last_snapshot_identified = -1;
 
 	/**
-	 * Hot gas component of the halo and outside galaxies that tracks
-	 * the ejected outflowing gas from the galaxy and that is not
-	 * available for cooling yet.
+	 * The snapshot at which the descendant of this subhalo can be found
 	 */
-	Baryon ejected_galaxy_gas {};
+	int descendant_snapshot = -1;
 
 	/**
-	 * A list of pointers to the ascendants of this subhalo, sorted by mass in
-	 * descending order
+	 * Whether this subhalo has a descendant or not
 	 */
-	std::vector<SubhaloPtr> ascendants {};
+	bool has_descendant = false;
 
 	/**
-	 * The accreted baryonic mass onto the subhalo. This information comes from the merger tree.
+	 * Boolean property indicating if subhalo is a main progenitor of its descendant.
 	 */
-	float accreted_mass = 0;
+	bool main_progenitor = false;
 
 	/**
-	 * The halo that holds this subhalo.
+	 * Boolean property indicating if subhalo is the result of an interpolation in snapshots were descendants were missing. In this case Dhalos puts a subhalo in those snapshots
+	 * to ensure continuation of the merger tree.
 	 */
-	HaloPtr host_halo {};
+	bool IsInterpolated = false;
+
+	/**
+	 * The ID of the descendant of this subhalo.
+	 * Valid only if has_descendant is \code{true}
+	 */
+	id_t descendant_id = 0;
+
+	/**
+	 * The ID of the Halo containing the descendant of this subhalo
+	 */
+	id_t descendant_halo_id = 0;
+
+	/**
+	 * haloID: ID of the Halo this Subhalo belong to
+	 */
+	id_t haloID = 0;
+
+	/**
+	 * A pointer to the descendant of this subhalo.
+	 * If this pointer is set then descendant_id and descendant_subhalo are
+	 * meaningless.
+	 */
+	SubhaloPtr descendant {};
+
+	/**
+	 * A list of pointers to the ascendants of this subhalo, sorted by mass in
+	 * descending order. Most subhalos have one or two ascendants, which are
+	 * stored inline.
+	 */
+	small_vector<SubhaloPtr, 2> ascendants {};
 
 	/**
 	 * @return The main progenitor of this Subhalo
@@ -571,7 +674,7 @@ public:
 	 * @param target The subhalo where galaxies will be copied to
 	 * @param gals The galaxies to copy to the target subhalo; defaults to all our galaxies
 	 */
-	void copy_galaxies_to(SubhaloPtr &target, const std::vector<GalaxyPtr> &gals) const;
+	void copy_galaxies_to(SubhaloPtr &target, span<GalaxyPtr> gals) const;
 
 	/**
 	 * Transfers (i.e., moves) the galaxies from this Subhalo into @a target
@@ -588,11 +691,12 @@ public:
 	void transfer_type2galaxies_to(SubhaloPtr &target);
 
 	/**
-	 * Removes galaxies from this Subhalo
+	 * Removes galaxies from this Subhalo. Type 2 galaxies must be removed
+	 * from merger_queue separately (see remove_mergers).
 	 *
-	 * @param to_remove A vector of galaxies to remove.
+	 * @param to_remove The galaxies to remove.
 	 */
-	void remove_galaxies(const std::vector<GalaxyPtr> &to_remove);
+	void remove_galaxies(span<GalaxyPtr> to_remove);
 
 	/// Returns the number of galaxies contained in this Halo
 	galaxies_size_type galaxy_count() const
@@ -626,6 +730,7 @@ public:
 private:
 	void do_check_satellite_subhalo_galaxy_composition() const;
 	void do_check_central_subhalo_galaxy_composition() const;
+	void transfer_merger_queue_to(Subhalo &target);
 
 };
 
@@ -692,6 +797,36 @@ public:
 	 */
 	std::vector<SubhaloPtr> all_subhalos() const;
 
+	/**
+	 * Returns a view over all subhalos contained in this halo, in the same
+	 * order given by all_subhalos(). The ordered list is kept by the halo,
+	 * and is built the first time it is needed after the halo's subhalos
+	 * change; after that, no allocations nor copies happen. The view is
+	 * invalidated by the next change of subhalos.
+	 *
+	 * Callers modifying central_subhalo or satellite_subhalos directly must
+	 * call subhalos_changed() afterwards.
+	 *
+	 * @return A view with all subhalos
+	 */
+	span<SubhaloPtr> subhalos() const;
+
+	/**
+	 * Builds the ordered list of subhalos returned by subhalos() if needed.
+	 * Calling this on all halos once their structure is final ensures later
+	 * calls to subhalos() only read data, and can therefore happen
+	 * concurrently.
+	 */
+	void order_subhalos() const;
+
+	/**
+	 * Signals that the subhalos of this halo have changed
+	 */
+	void subhalos_changed() {
+		subhalos_ordered = false;
+		ordered_subhalos.clear();
+	}
+
 	/**
 	 * Removes @a subhalo from this Halo. If the subhalo is not part of this
 	 * Halo, a subhalo_not_found exception is thrown.
@@ -722,7 +857,13 @@ public:
 	bool main_progenitor = false;
 
 	HaloPtr descendant {};
-	std::set<HaloPtr> ascendants {};
+
+	/**
+	 * The ascendants of this halo, without duplicates and in the order they
+	 * were added. Most halos have one or two ascendants, which are stored
+	 * inline.
+	 */
+	small_vector<HaloPtr, 2> ascendants {};
 
 	/**
 	 * The merger tree that holds this halo.
@@ -736,6 +877,14 @@ public:
 	 */
 	void add_subhalo(const SubhaloPtr &&subhalo);
 
+	/**
+	 * Adds @a halo as an ascendant of this Halo, unless it was already added.
+	 *
+	 * @param halo The ascendant halo
+	 * @return Whether @a halo was newly added
+	 */
+	bool add_ascendant(const HaloPtr &halo);
+
 	///
 	/// Returns the number of galaxies contained in this Halo
 	///
@@ -746,6 +895,10 @@ public:
 	 */
 	double total_baryon_mass() const;
 
+private:
+	mutable std::vector<SubhaloPtr> ordered_subhalos {};
+	mutable bool subhalos_ordered = false;
+
 };
 
 template <typename T>
@@ -782,9 +935,26 @@ public:
 	 */
 	std::map<int, std::vector<HaloPtr>> halos;
 
+	/**
+	 * The number of merger trees this tree stands for when only a sample of
+	 * them is evolved (see ExecutionParameters::tree_sampling_rate)
+	 */
+	double weight = 1;
+
 	void add_halo(const HaloPtr &halo) {
 		halos[halo->snapshot].push_back(halo);
 	}
+
+	/**
+	 * Removes the halos at @p snapshot from this tree, breaking all links
+	 * between them, their subhalos and the rest of the structures (including
+	 * the ascendants of their descendants) so their memory is released once
+	 * no longer referenced from elsewhere. This must happen only after
+	 * galaxies have been evolved from @p snapshot into the next one.
+	 *
+	 * @param snapshot The snapshot whose halos should be released
+	 */
+	void release_snapshot(int snapshot);
 };
 
 class TotalBaryon {
@@ -816,6 +986,8 @@ public:
 	 * mDM: total mass in the form of dark matter.
 	 * SFR: integrated SFR of all galaxies over a snapshot.
 	 * baryon_total_created: keeps track of the baryons deposited in DM halos to ensure mass convervations.
+	 * baryon_total_pruned: baryons (i.e., the universal baryon fraction of the halo mass) in the halos pruned
+	 *  from merger trees at each snapshot (see ExecutionParameters::min_branch_mass).
 	 */
 
 	std::vector<BaryonBase> mcold;
@@ -845,10 +1017,22 @@ public:
 
 	std::map<int,double> baryon_total_created;
 	std::map<int,double> baryon_total_lost;
+	std::map<int,double> baryon_total_pruned;
 
 	std::vector<double> get_masses (const std::vector<BaryonBase> &B) const;
 	std::vector<double> get_metals (const std::vector<BaryonBase> &B) const;
 
+	/**
+	 * Adds the amounts tracked in @p other, which must have been tracked
+	 * over the same snapshots, to the ones tracked by this object.
+	 */
+	TotalBaryon &operator+=(const TotalBaryon &other);
+
+	/**
+	 * Drops all per-snapshot amounts beyond the first @p n_snapshots ones
+	 */
+	void truncate(std::size_t n_snapshots);
+
 };
 
 template <typename T>
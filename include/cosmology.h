@@ -26,6 +26,7 @@
 #ifndef SHARK_COSMOLOGY_H_
 #define SHARK_COSMOLOGY_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -74,6 +75,28 @@ class Cosmology {
 public:
 	Cosmology(const CosmologicalParameters &parameters);
 
+	/**
+	 * Like the other constructor, but caching the redshift-dependent values
+	 * (expansion factor, Hubble parameter and age of the universe) at the
+	 * given snapshot redshifts. Calls with exactly one of these redshifts
+	 * read these values instead of calculating them; calls with other
+	 * redshifts still calculate them as usual.
+	 */
+	Cosmology(const CosmologicalParameters &parameters, const std::map<int, double> &snapshot_redshifts);
+
+	/// Redshift-dependent values cached for a snapshot redshift
+	struct redshift_factors {
+		double z;
+		double a;
+		double inv_a;
+		double hubble_parameter;
+		double age;
+	};
+
+	/// @return The cached values for redshift @p z, or nullptr if @p z is
+	/// not a snapshot redshift
+	const redshift_factors *cached_factors(double z) const;
+
 	double comoving_to_physical_angularmomentum(double r, double z) const;
 	double comoving_to_physical_size(double r, double z) const;
 	double comoving_to_physical_velocity(double v, double z) const;
@@ -96,6 +119,14 @@ public:
 
 	CosmologicalParameters parameters;
 
+private:
+	/// Sorted by redshift, and immutable after construction, so no
+	/// synchronisation is needed to read it
+	std::vector<redshift_factors> redshift_cache;
+
+	double calculate_redshift_to_age(double z) const;
+	double calculate_hubble_parameter(double z) const;
+
 };
 
 /// Type to be used by users handling pointers to this class
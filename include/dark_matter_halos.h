@@ -24,6 +24,9 @@
 #ifndef INCLUDE_DARK_MATTER_HALOS_H_
 #define INCLUDE_DARK_MATTER_HALOS_H_
 
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <random>
 #include <string>
@@ -32,8 +35,10 @@
 
 #include <gsl/gsl_sf_lambert.h>
 
+#include "interpolator.h"
 #include "mixins.h"
 #include "numerical_constants.h"
+#include "philox_engine.h"
 #include "components.h"
 #include "cosmology.h"
 #include "simulation.h"
@@ -73,6 +78,81 @@ public:
 	bool use_converged_lambda_catalog = false; 
 	int  min_part_convergence = 100;
 
+	/**
+	If tabulated_profiles = true, the enclosed mass and gravitational potential of the halo profile are interpolated
+	from tables built at startup, which are refined until their relative error is below profile_table_accuracy.
+	**/
+	bool tabulated_profiles = false;
+	double profile_table_accuracy = 1e-4;
+
+};
+
+/**
+ * A table of a function of a halo profile (e.g., its enclosed mass) over a
+ * regular grid of log10(r) and log10(c), where r is the radius normalised by
+ * the virial radius and c the concentration of the halo. Values are stored
+ * in log10 and linearly interpolated between grid points. The grid is
+ * refined at construction time until the interpolated values are within the
+ * requested relative accuracy of the function at the center and edge
+ * midpoints of all grid cells.
+ */
+class DarkMatterProfileTable {
+
+public:
+
+	/// The tabulated function, taking r and c
+	typedef std::function<double(double, double)> profile_t;
+
+	/// The range of normalised radii covered by tables
+	static constexpr double min_log_r = -4;
+	static constexpr double max_log_r = 0;
+
+	/// The range of concentrations covered by tables
+	static constexpr double min_log_c = 0;
+	static constexpr double max_log_c = 2;
+
+	/**
+	 * Creates a new table of @p profile. If @p profile is not strictly
+	 * positive or strictly negative over the table range no values can be
+	 * interpolated, and get() always returns false.
+	 *
+	 * @param name The name of the tabulated function, used for logging
+	 * @param profile The tabulated function
+	 * @param accuracy The maximum allowed relative error of the table
+	 */
+	DarkMatterProfileTable(const std::string &name, const profile_t &profile, double accuracy);
+
+	/**
+	 * Interpolates the tabulated function at (@p r, @p c).
+	 *
+	 * @return Whether the point lies within the table. If false, @p value is
+	 * left untouched.
+	 */
+	bool get(double r, double c, double &value) const
+	{
+		if (!values || !(r >= r_min && r < 1 && c >= c_min && c <= c_max)) {
+			return false;
+		}
+		value = sign * std::pow(10., values->get(std::log10(r), std::log10(c)));
+		return true;
+	}
+
+	/// @return The number of grid points of this table
+	std::size_t size() const {
+		return n_points;
+	}
+
+private:
+	static const double r_min;
+	static const double c_min;
+	static const double c_max;
+
+	std::unique_ptr<GridInterpolator> values;
+	double sign;
+	std::size_t n_points;
+
+	static std::unique_ptr<GridInterpolator> tabulate(const profile_t &profile, double sign, unsigned int points_per_dex, std::size_t &n_points);
+	double max_relative_error(const profile_t &profile, const std::vector<double> &log_r, const std::vector<double> &log_c) const;
 };
 
 class DarkMatterHalos {
@@ -97,9 +177,32 @@ public:
 
 	double halo_virial_radius(Subhalo &subhalo);
 
+	/// log10 of the virial temperature [K] of @p subhalo
+	double log_virial_temperature(Subhalo &subhalo);
+
 	double halo_virial_velocity (double mvir, double redshift);
 
-	float halo_lambda (xyz<float> L, float m, double z, double npart);
+	/**
+	 * Randomises, if requested, the spin parameter @p lambda of subhalo
+	 * @p id at @p snapshot with @p npart particles that was calculated from
+	 * its angular momentum
+	 */
+	float halo_lambda (float lambda, double npart, Subhalo::id_t id, int snapshot);
+
+	/**
+	 * Array versions of nfw_concentration, halo_virial_velocity and the
+	 * angular momentum-based spin parameter of halo_lambda, evaluating @p n
+	 * halos at once. Halo @p i has mass @p mvir[i], angular momentum
+	 * (@p L[3i], @p L[3i+1], @p L[3i+2]) and lives at snapshot
+	 * @p snapshot[i]. The redshift-dependent factors of each snapshot are
+	 * precomputed at construction time, so the loops only do the mass-dependent
+	 * work. Halos at snapshots without a known redshift get NaN values.
+	 */
+	///@{
+	void nfw_concentration(const float mvir[], const int snapshot[], std::size_t n, double concentration[]) const;
+	void halo_virial_velocity(const float mvir[], const int snapshot[], std::size_t n, double vvir[]) const;
+	void halo_lambda(const float L[], const float mvir[], const int snapshot[], std::size_t n, float lambda[]) const;
+	///@}
 
 	double disk_size_theory (Subhalo &subhalo, double z);
 
@@ -121,18 +224,59 @@ public:
 	double v2disk (double x, double m, double c, double r);
 	double v2bulge (double x, double m, double c, double r);
 
-	void generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz<float> &L, double total_am, const HaloPtr &halo);
+	/**
+	 * Draws a random position, velocity and angular momentum for the galaxy
+	 * with random key @p random_key (see Galaxy::random_key) orbiting within
+	 * @p halo. The values depend only on the galaxy, the halo's snapshot and
+	 * the execution seed.
+	 */
+	void generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz<float> &L, double total_am, const HaloPtr &halo, Galaxy::id_t random_key);
+
+	/**
+	 * Batch version of generate_random_orbits for the @p n galaxies with
+	 * random keys @p random_key orbiting within @p halo. The radii of all galaxies are
+	 * drawn from the NFW distribution at once, but each galaxy still draws
+	 * from its own random stream, so its values don't depend on the other
+	 * galaxies in the batch.
+	 */
+	void generate_random_orbits(xyz<float> pos[], xyz<float> v[], xyz<float> L[], const double total_am[], const HaloPtr &halo, const Galaxy::id_t random_key[], std::size_t n);
 
 protected:
 	DarkMatterHaloParameters params;
 	CosmologyPtr cosmology;
 	SimulationParameters sim_params;
-	std::default_random_engine generator;
+	std::uint32_t seed;
 	std::lognormal_distribution<double> distribution;
 	std::uniform_real_distribution<float> flat_distribution;
 
 private:
-	xyz<float> random_point_in_sphere(float r);
+	xyz<float> random_point_in_sphere(float r, philox_engine &engine);
+
+	/// Calculates the derived quantities of @p subhalo, if not done yet
+	static void derive_properties(Subhalo &subhalo);
+
+	/// Redshift-dependent factors of the derived halo properties
+	struct redshift_factors {
+		double hubble_parameter;
+		double lambda_factor;
+		double concentration_a;
+		double concentration_b;
+	};
+
+	/// Indexed by snapshot
+	std::vector<redshift_factors> snapshot_factors;
+
+	redshift_factors get_redshift_factors(double z) const;
+	const redshift_factors &get_snapshot_factors(int snapshot) const;
+	double nfw_concentration(double mvir, const redshift_factors &factors) const;
+
+	/// nfw_concentration and its array version for a fixed concentration model
+	///@{
+	template <DarkMatterHaloParameters::ConcentrationModel Model>
+	static double nfw_concentration(double mvir, const redshift_factors &factors);
+	template <DarkMatterHaloParameters::ConcentrationModel Model>
+	void nfw_concentration(const float mvir[], const int snapshot[], std::size_t n, double concentration[]) const;
+	///@}
 };
 
 /// Type used by users to keep track o
@@ -157,14 +301,64 @@ public:
 };
 
 
+/**
+ * A halo profile whose enclosed mass and gravitational potential are
+ * interpolated from tables of those of @p Profile, falling back to
+ * @p Profile itself outside the tables.
+ */
+template <typename Profile>
+class TabulatedDarkMatterHalos : public Profile {
+
+public:
+	template <typename ...Ts>
+	TabulatedDarkMatterHalos(const DarkMatterHaloParameters &params, Ts&&...ts) :
+		Profile(params, std::forward<Ts>(ts)...),
+		potential_table("gravitational potential", [this](double r, double c) {
+			return Profile::grav_potential_halo(r, c);
+		}, params.profile_table_accuracy),
+		enclosed_mass_table("enclosed mass", [this](double r, double c) {
+			return Profile::enclosed_mass(r, c);
+		}, params.profile_table_accuracy)
+	{
+	}
+
+	double grav_potential_halo(double r, double c) const override
+	{
+		double value;
+		if (potential_table.get(r, c, value)) {
+			return value;
+		}
+		return Profile::grav_potential_halo(r, c);
+	}
+
+	double enclosed_mass(double r, double c) const override
+	{
+		double value;
+		if (enclosed_mass_table.get(r, c, value)) {
+			return value;
+		}
+		return Profile::enclosed_mass(r, c);
+	}
+
+private:
+	DarkMatterProfileTable potential_table;
+	DarkMatterProfileTable enclosed_mass_table;
+};
+
 /// Factory of DarkMatterHaloPtrs
 template <typename ...Ts>
 DarkMatterHalosPtr make_dark_matter_halos(const DarkMatterHaloParameters &dmh_parameters, Ts&&...ts)
 {
 	if (dmh_parameters.haloprofile == DarkMatterHaloParameters::NFW) {
+		if (dmh_parameters.tabulated_profiles) {
+			return std::make_shared<TabulatedDarkMatterHalos<NFWDarkMatterHalos>>(dmh_parameters, std::forward<Ts>(ts)...);
+		}
 		return std::make_shared<NFWDarkMatterHalos>(dmh_parameters, std::forward<Ts>(ts)...);
 	}
 	else if (dmh_parameters.haloprofile == DarkMatterHaloParameters::EINASTO) {
+		if (dmh_parameters.tabulated_profiles) {
+			return std::make_shared<TabulatedDarkMatterHalos<EinastoDarkMatterHalos>>(dmh_parameters, std::forward<Ts>(ts)...);
+		}
 		return std::make_shared<EinastoDarkMatterHalos>(dmh_parameters, std::forward<Ts>(ts)...);
 	}
 
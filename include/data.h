@@ -26,6 +26,8 @@
 #ifndef SHARK_DATA_H_
 #define SHARK_DATA_H_
 
+#include <istream>
+#include <memory>
 #include <string>
 
 namespace shark
@@ -38,11 +40,26 @@ namespace shark
  * actual filename returned by this routine does not belong to the repository
  * (e.g., if shark is running from a globally installed location).
  *
+ * Files under the directory given by the @p SHARK_DATA_DIR environment
+ * variable, if any, are found first.
+ *
  * @param fname The file to find
  * @return The actual path to the file on disk
  */
 std::string get_static_data_filepath(const std::string &fname);
 
+/**
+ * Opens the static data file @a fname for reading. @a fname is relative to the
+ * @p data directory, like in get_static_data_filepath. Files compiled into
+ * shark (see the SHARK_EMBED_DATA CMake option) are read from memory, unless
+ * the @p SHARK_DATA_DIR directory has its own version of them; other files
+ * are read from disk.
+ *
+ * @param fname The file to open
+ * @return A stream with the contents of the file
+ */
+std::unique_ptr<std::istream> open_static_data(const std::string &fname);
+
 }  // namespace shark
 
 
@@ -55,9 +55,18 @@ public:
 
 	double toomre_parameter(GalaxyPtr &galaxy);
 
+	/**
+	 * Whether the disk of @p galaxy is unstable, i.e., whether its Toomre
+	 * parameter is below the stability threshold. This is equivalent to
+	 * comparing toomre_parameter() against the threshold, but avoids its
+	 * square root, and is used to screen galaxies before doing any other
+	 * work for them.
+	 */
+	bool is_unstable(Galaxy &galaxy) const;
+
 	void evaluate_disk_instability (HaloPtr &halo, int snapshot, double delta_t);
 
-	void create_starburst(SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z, double delta_t);
+	void create_starburst(const SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z, double delta_t);
 
 	void transfer_history_disk_to_bulge(GalaxyPtr &central, int snapshot);
 
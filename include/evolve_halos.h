@@ -29,6 +29,7 @@
 
 #include <cmath>
 #include <memory>
+#include <vector>
 
 #include "components.h"
 #include "cosmology.h"
@@ -36,21 +37,188 @@
 #include "physical_model.h"
 #include "simulation.h"
 #include "star_formation.h"
+#include "tree_index.h"
 
 namespace shark {
 
+/// Baryons lost while transferring galaxies into the next snapshot
+struct transfer_totals {
+
+	unsigned int subhalos_without_descendant = 0;
+	double baryon_mass_loss = 0;
+
+	transfer_totals &operator+=(const transfer_totals &other)
+	{
+		subhalos_without_descendant += other.subhalos_without_descendant;
+		baryon_mass_loss += other.baryon_mass_loss;
+		return *this;
+	}
+};
+
+/**
+ * Transfers galaxies of the subhalos of a snapshot into the corresponding
+ * subhalos of the next snapshot one merger tree at a time, accumulating the
+ * baryons lost in the process per thread. Descendants are always in the same
+ * merger tree, so different trees can be transferred concurrently.
+ */
+class GalaxyTransfer {
+
+public:
+
+	/**
+	 * @param snapshot The snapshot whose galaxies are transferred
+	 * @param age The age of the universe at the next snapshot [Gyr]
+	 * @param threads The number of threads transferring merger trees
+	 */
+	GalaxyTransfer(int snapshot, double age, unsigned int threads);
+
+	/**
+	 * Transfers the galaxies of @p tree_halos, which must be all the halos
+	 * of a merger tree at this snapshot
+	 *
+	 * @param tree_halos The halos of the merger tree
+	 * @param thread_idx The index of the calling thread
+	 */
+	void transfer(span<HaloPtr> tree_halos, int thread_idx);
+
+	/// Records the baryons lost by all the transfers into @p AllBaryons
+	void add_losses(TotalBaryon &AllBaryons) const;
+
+private:
+	int snapshot;
+	double age;
+	std::vector<transfer_totals> partial_totals;
+};
+
 /**
  * Transfers galaxies of the subhalos of this snapshot into the corresponding
  * subhalos of the next snapshot, and baryon components from subhalo to subhalo.
+ * Merger trees are transferred in parallel.
  *
- * @param halos The halos whose subhalos need to be transferred to the next snapshot
+ * @param tree_index The index over the merger trees being evolved
+ * @param n_trees The number of merger trees in @p tree_index
  * @param snapshot This snapshot
+ * @param age The age of the universe at the next snapshot [Gyr], from which
+ * the merging timescales of galaxies becoming type 2 elapse
  * @param AllBaryons The TotalBaryon accummulation object
+ * @param threads The number of threads to use
  */
-void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int snapshot, TotalBaryon &AllBaryons);
+void transfer_galaxies_to_next_snapshot(const TreeIndex &tree_index, std::size_t n_trees, int snapshot, double age, TotalBaryon &AllBaryons, unsigned int threads);
+
+/// Baryon amounts accumulated over (part of) the galaxies of a snapshot
+struct baryon_totals {
+
+	BaryonBase mcold_total;
+	BaryonBase mhothalo_total;
+	BaryonBase mcoldhalo_total;
+	BaryonBase mejectedhalo_total;
+	BaryonBase mstars_total;
+	BaryonBase mstars_bursts_galaxymergers;
+	BaryonBase mstars_bursts_diskinstabilities;
+	BaryonBase MBH_total;
+	BaryonBase mHI_total;
+	BaryonBase mH2_total;
+	BaryonBase mDM_total;
+
+	double SFR_total_disk = 0;
+	double SFR_total_burst = 0;
+
+	// Counts are weighted like masses when only a sample of trees is evolved
+	double number_major_mergers = 0;
+	double number_minor_mergers = 0;
+	double number_disk_instabil = 0;
+
+	/// Adds @p other, with all its amounts multiplied by @p weight
+	baryon_totals &add(const baryon_totals &other, double weight)
+	{
+		add(mcold_total, other.mcold_total, weight);
+		add(mhothalo_total, other.mhothalo_total, weight);
+		add(mcoldhalo_total, other.mcoldhalo_total, weight);
+		add(mejectedhalo_total, other.mejectedhalo_total, weight);
+		add(mstars_total, other.mstars_total, weight);
+		add(mstars_bursts_galaxymergers, other.mstars_bursts_galaxymergers, weight);
+		add(mstars_bursts_diskinstabilities, other.mstars_bursts_diskinstabilities, weight);
+		add(MBH_total, other.MBH_total, weight);
+		add(mHI_total, other.mHI_total, weight);
+		add(mH2_total, other.mH2_total, weight);
+		add(mDM_total, other.mDM_total, weight);
+		SFR_total_disk += other.SFR_total_disk * weight;
+		SFR_total_burst += other.SFR_total_burst * weight;
+		number_major_mergers += other.number_major_mergers * weight;
+		number_minor_mergers += other.number_minor_mergers * weight;
+		number_disk_instabil += other.number_disk_instabil * weight;
+		return *this;
+	}
 
-void track_total_baryons(StarFormation &starformation, Cosmology &cosmology, ExecutionParameters execparams, SimulationParameters simulation_params, const std::vector<HaloPtr> &halos,
-		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat);
+	baryon_totals &operator+=(const baryon_totals &other)
+	{
+		return add(other, 1);
+	}
+
+private:
+	static void add(BaryonBase &total, const BaryonBase &other, double weight)
+	{
+		total.mass += other.mass * weight;
+		total.mass_metals += other.mass_metals * weight;
+	}
+};
+
+/**
+ * Accumulates the baryon amounts of the galaxies and subhalos of a snapshot
+ * one halo at a time, each thread into its own partial totals, and records
+ * the star formation history items of that snapshot into galaxies if
+ * requested. Each halo contributes with the weight of its merger tree.
+ */
+class BaryonTracker {
+
+public:
+
+	/**
+	 * @param snapshot The snapshot whose baryons are tracked
+	 * @param molgas The molecular gas of each galaxy of this snapshot
+	 * @param deltat The time step from this snapshot to the next one [Gyr]
+	 * @param threads The number of threads tracking halos
+	 */
+	BaryonTracker(Cosmology &cosmology, const ExecutionParameters &execparams, const SimulationParameters &simulation_params,
+			int snapshot, const molgas_per_galaxy &molgas, double deltat, unsigned int threads);
+
+	/**
+	 * Accumulates the baryons of @p halo, which must be of this snapshot
+	 *
+	 * @param halo The halo
+	 * @param thread_idx The index of the calling thread
+	 */
+	void track(const HaloPtr &halo, int thread_idx);
+
+	/**
+	 * Appends the totals of all tracked halos, combined in thread order, as
+	 * the totals of this snapshot in @p AllBaryons
+	 */
+	void add_totals(TotalBaryon &AllBaryons) const;
+
+private:
+	const ExecutionParameters &execparams;
+	int snapshot;
+	const molgas_per_galaxy &molgas;
+	double deltat;
+	double mean_age;
+	std::vector<baryon_totals> partial_totals;
+};
+
+/**
+ * Accumulates the baryon amounts of all galaxies and subhalos of this snapshot
+ * into @p AllBaryons, and records the star formation history items of this
+ * snapshot into galaxies if requested. Galaxies are visited in parallel.
+ *
+ * @param halos The halos of this snapshot
+ * @param AllBaryons The TotalBaryon accummulation object
+ * @param snapshot This snapshot
+ * @param molgas The molecular gas of each galaxy of this snapshot
+ * @param deltat The time step from this snapshot to the next one [Gyr]
+ * @param threads The number of threads to use
+ */
+void track_total_baryons(Cosmology &cosmology, const ExecutionParameters &execparams, const SimulationParameters &simulation_params, const std::vector<HaloPtr> &halos,
+		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat, unsigned int threads);
 
 }  // namespace shark
 
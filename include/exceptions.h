@@ -71,6 +71,15 @@ public:
 	invalid_argument(const std::string &what) : exception(what) {}
 };
 
+/**
+ * An exception indicating that the memory used by shark went over the memory
+ * budget given by the user.
+ */
+class memory_budget_exceeded : public exception {
+public:
+	memory_budget_exceeded(const std::string &what) : exception(what) {}
+};
+
 /**
  * An exception indicating that a required option value is missing
  */
@@ -175,6 +184,32 @@ private:
 	std::string errmsg;
 };
 
+/**
+ * While alive, GSL errors raised by the calling thread are not turned into
+ * gsl_error exceptions by the GSL error handler installed by shark, so GSL
+ * functions report them only through their return codes. Used by code that
+ * expects and handles GSL errors locally, avoiding the cost of throwing
+ * exceptions across GSL frames.
+ */
+class scoped_gsl_error_suppression {
+public:
+	scoped_gsl_error_suppression() { depth()++; }
+	~scoped_gsl_error_suppression() { depth()--; }
+
+	scoped_gsl_error_suppression(const scoped_gsl_error_suppression &) = delete;
+	scoped_gsl_error_suppression &operator=(const scoped_gsl_error_suppression &) = delete;
+
+	/// Whether GSL errors are suppressed in the calling thread
+	static bool active() { return depth() > 0; }
+
+private:
+	static int &depth()
+	{
+		static thread_local int depth = 0;
+		return depth;
+	}
+};
+
 }  // namespace shark
 
 #endif // SHARK_EXCEPTIONS_H
\ No newline at end of file
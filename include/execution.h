@@ -31,24 +31,54 @@
 #include <vector>
 
 #include "options.h"
+#include "spatial_selection.h"
 
 namespace shark {
 
+class OptionDependencies;
+
 class ExecutionParameters {
 
 public:
 	ExecutionParameters(const Options &options);
 
+	/// Declares the options that don't affect the evolution of galaxies
+	static void declare_dependencies(OptionDependencies &dependencies);
+
 	std::set<int> output_snapshots {};
 	Options::file_format_t output_format = Options::HDF5;
 	std::string output_directory {};
 	std::string name_model {};
 	std::random_device::result_type seed = std::random_device()();
 	std::vector<unsigned int> simulation_batches {};
+
+	/**
+	 * Fraction of the merger trees that are evolved. Trees are sampled
+	 * separately on bins of root halo mass, and each evolved tree gets a
+	 * weight equal to the number of trees it represents in its bin.
+	 */
+	double tree_sampling_rate = 1;
+
+	/**
+	 * The region of the simulated volume whose merger trees are evolved, as
+	 * given by the position of their root halos. Only the rows of the
+	 * selected trees are read from the merger tree files.
+	 */
+	SpatialSelection spatial_selection {};
+
+	/**
+	 * Halos whose mass never reaches this value [Msun/h], neither in them
+	 * nor in any of their progenitors, are pruned from merger trees before
+	 * evolving them. Whole trees are dropped if their root halo is pruned,
+	 * otherwise the mass of pruned branches is later accreted by their
+	 * descendants. 0 disables pruning.
+	 */
+	double min_branch_mass = 0;
+
 	std::time_t starting_time = std::time(nullptr);
 
 	bool output_snapshot(int snapshot);
-	int last_output_snapshot();
+	int last_output_snapshot() const;
 
 	bool skip_missing_descendants = true;
 	bool warn_on_missing_descendants = true;
@@ -58,11 +88,377 @@ public:
 	 * Parameters of sf histories:
 	 * output_sf_histories: boolean parameter set to true if the user wants the star formation histories to be output.
 	 * snapshots_sf_histories: vector of int with the snapshots the user wants the star formation histories output at.
+	 * stream_sf_histories: boolean parameter set to true if histories should be streamed into disk as the evolution proceeds
+	 *  instead of being kept in memory, and read back when they are output.
 	 */
 	bool output_sf_histories = false;
 	std::vector<int> snapshots_sf_histories {};
+	bool stream_sf_histories = false;
+
+	/**
+	 * How the histories of each galaxy are written:
+	 * SFH_DENSE: as rows of a matrix with one column per snapshot.
+	 * SFH_SPARSE: only the snapshots with non-zero values, in compressed
+	 * sparse row format. This is lossless.
+	 */
+	enum sf_histories_encoding_t {
+		SFH_DENSE = 0,
+		SFH_SPARSE
+	};
+
+	sf_histories_encoding_t sf_histories_encoding = SFH_DENSE;
 
 	float ode_solver_precision = 0;
+
+	/**
+	 * How merger trees are distributed across threads during evolution:
+	 * STATIC: each thread gets a fixed, contiguous range of trees.
+	 * DYNAMIC: trees are handed out one at a time, in their original order.
+	 * COST_AWARE: trees are sorted by their estimated cost, largest first,
+	 * and handed out one at a time.
+	 */
+	enum tree_scheduling_t {
+		STATIC = 0,
+		DYNAMIC,
+		COST_AWARE
+	};
+
+	tree_scheduling_t tree_scheduling = STATIC;
+
+	/**
+	 * How the ODE systems of galaxies are solved:
+	 * ODE_GSL: one galaxy at a time, using GSL.
+	 * ODE_BATCHED: many galaxies (never of the same subhalo) are solved
+	 * in lockstep by a BatchODESolver, which is not vectorised: the
+	 * evolution equations are still evaluated one galaxy at a time.
+	 */
+	enum ode_solver_t {
+		ODE_GSL = 0,
+		ODE_BATCHED
+	};
+
+	ode_solver_t ode_solver = ODE_GSL;
+
+	/**
+	 * If positive, galaxies evolved by the ODE_BATCHED solver are evolved
+	 * again by the GSL solver, used as a reference. Solutions with a
+	 * component differing by more than this relative tolerance are reported.
+	 * Results still come from the batched solver.
+	 */
+	double batch_ode_check_tolerance = 0;
+
+	/**
+	 * The GSL steppers used by the ODE_GSL solver to evolve galaxies and
+	 * starbursts, respectively:
+	 * RKCK: explicit embedded Runge-Kutta Cash-Karp (4, 5) method.
+	 * MSBDF: implicit variable-coefficient linear multistep backward
+	 * differentiation formula method, suited for stiff systems.
+	 * BSIMP: implicit Bulirsch-Stoer method of Bader and Deuflhard.
+	 */
+	enum ode_stepper_t {
+		RKCK = 0,
+		MSBDF,
+		BSIMP
+	};
+
+	ode_stepper_t ode_stepper = RKCK;
+	ode_stepper_t ode_starburst_stepper = RKCK;
+
+	/**
+	 * Whether the ODE integration of each galaxy starts with the mean step
+	 * size of its previous integration, instead of with the whole time step.
+	 */
+	bool warm_start_ode = false;
+
+	/**
+	 * Whether galaxies are evolved in parallel at the halo level, rather than
+	 * at the merger tree level. This removes the imbalance caused by few,
+	 * very large merger trees.
+	 */
+	bool halo_parallelism = false;
+
+	/**
+	 * Whether the molecular gas content of galaxies is calculated right after
+	 * each galaxy is evolved, instead of in a separate pass over all galaxies.
+	 */
+	bool fused_molecular_gas = false;
+
+	/**
+	 * Whether the gas cooling rates of all central galaxies about to be
+	 * evolved are calculated together in a separate pass, before any of them
+	 * is evolved. Galaxies evolved before the central galaxy of their own
+	 * subhalo then don't influence its cooling rate.
+	 */
+	bool cooling_prepass = false;
+
+	/**
+	 * Whether each merger tree has its baryons tracked, and its galaxies
+	 * transferred into the next snapshot, by the same thread right after
+	 * evolving it, instead of in separate passes over all halos once all trees
+	 * are evolved. Galaxies are only transferred this way from snapshots that
+	 * are neither output nor streamed. Requires fused_molecular_gas and tree
+	 * level parallelism.
+	 */
+	bool pipelined_snapshots = false;
+
+	/**
+	 * How the molecular gas of galaxies is calculated on snapshots that are
+	 * not output, where it is only needed for the global HI and H2 masses:
+	 * MOLGAS_FULL: with the same integrals used on output snapshots.
+	 * MOLGAS_APPROXIMATE: with a single application of a fixed-order
+	 * quadrature rule over the H2 surface density, and without the angular
+	 * momentum of the atomic and molecular gas.
+	 * MOLGAS_NONE: not calculated, the global HI and H2 masses of these
+	 * snapshots are then 0.
+	 */
+	enum tracked_molecular_gas_t {
+		MOLGAS_FULL = 0,
+		MOLGAS_APPROXIMATE,
+		MOLGAS_NONE
+	};
+
+	tracked_molecular_gas_t tracked_molecular_gas = MOLGAS_FULL;
+
+	/**
+	 * Maximum number of output snapshots that can be written in the background
+	 * while galaxies continue to be evolved. 0 means that outputs are written
+	 * synchronously.
+	 */
+	unsigned int output_snapshots_in_flight = 0;
+
+	/**
+	 * How the datasets of the galaxies and star formation histories output
+	 * files are compressed:
+	 * COMPRESSION_NONE: datasets are not compressed.
+	 * COMPRESSION_DEFLATE: datasets are compressed with DEFLATE (gzip) at
+	 * output_compression_level.
+	 * COMPRESSION_LZ4: datasets are compressed with LZ4 if the HDF5 LZ4 filter
+	 * plugin is available, and with DEFLATE otherwise.
+	 */
+	enum output_compression_t {
+		COMPRESSION_NONE = 0,
+		COMPRESSION_DEFLATE,
+		COMPRESSION_LZ4
+	};
+
+	output_compression_t output_compression = COMPRESSION_NONE;
+	unsigned int output_compression_level = 4;
+
+	/**
+	 * Whether the bytes of values are shuffled before compressing them,
+	 * which usually improves compression of numerical data
+	 */
+	bool output_shuffle = true;
+
+	/**
+	 * Maximum number of values in each chunk of the output datasets. 0 means
+	 * datasets are chunked only when compressed, using a default chunk size.
+	 */
+	unsigned int output_chunk_size = 0;
+
+	/**
+	 * Whether all processes of an MPI execution write their galaxies into a
+	 * single galaxies.hdf5 file per snapshot, directly under the snapshot's
+	 * output directory, instead of one file per process. Files are written
+	 * collectively, and never in the background.
+	 */
+	bool shared_output = false;
+
+	/**
+	 * Names of the galaxies output properties that are written, as documented
+	 * in hdf5_properties (e.g., galaxies/mstars_disk). Naming a group (e.g.,
+	 * subhalo) selects all of its properties. Empty means all properties.
+	 */
+	std::vector<std::string> output_properties {};
+
+	/**
+	 * Names of the galaxies output properties that are not written, even if
+	 * selected by output_properties. Groups can be named too.
+	 */
+	std::vector<std::string> excluded_output_properties {};
+
+	/**
+	 * @return Whether the galaxies output property @p name is written
+	 */
+	bool output_property(const std::string &name) const;
+
+	/**
+	 * Whether a summary.hdf5 file with the mass functions, size-mass relation
+	 * and star formation rate density of all galaxies is written for each
+	 * output snapshot. If summary_only is also set, it is written instead of
+	 * all other galaxy output files.
+	 */
+	bool summary_statistics = false;
+	bool summary_only = false;
+
+	/**
+	 * The minimum and maximum log10(M [Msun/h]), and the bin width [dex], of
+	 * the mass bins used by summary statistics
+	 */
+	std::vector<double> summary_mass_bins {6, 13, 0.2};
+
+	/**
+	 * Maximum number of merger tree batch files (or chunks of them, see
+	 * reader_chunk_size) that can be read in the background while the halos
+	 * of a previous one are created. 0 means that batch files are read
+	 * synchronously.
+	 */
+	unsigned int reader_batches_in_flight = 0;
+
+	/**
+	 * Maximum number of rows of a merger tree batch file that are read at a
+	 * time. Subhalos are created for each chunk of rows before the next one
+	 * is read, bounding the memory taken by raw data. 0 means that batch
+	 * files are read as a whole.
+	 */
+	unsigned int reader_chunk_size = 0;
+
+	/**
+	 * A directory where merger trees are cached after being built, keyed by
+	 * the contents of the input files and the options used to build them.
+	 * Later executions with the same key load the trees from there instead
+	 * of reading and building them again. Empty if trees are not cached.
+	 */
+	std::string tree_cache_directory {};
+
+	/**
+	 * Snapshots at which the full evolution state is saved into a checkpoint
+	 * file, once galaxies have been evolved up to them
+	 */
+	std::set<int> checkpoint_snapshots {};
+
+	/**
+	 * A checkpoint file to restart the evolution from. Empty if the evolution
+	 * should start from the beginning.
+	 */
+	std::string restart_file {};
+
+	/**
+	 * A CSV file where performance metrics are written for each evolved
+	 * snapshot. Empty if no metrics should be written.
+	 */
+	std::string metrics_file {};
+
+	/**
+	 * A CSV file where the initial state and solver parameters of the
+	 * ode_costs_count most expensive ODE systems of each evolved snapshot
+	 * are written, for later replay. Empty if not needed.
+	 */
+	std::string ode_costs_file {};
+	unsigned int ode_costs_count = 10;
+
+	/**
+	 * The number of merger trees that took the most wall time, and ODE
+	 * evaluations, to be reported in the statistics of each evolved snapshot.
+	 */
+	unsigned int tree_costs_count = 5;
+
+	/**
+	 * The fraction of the adaptive star formation integrations of a snapshot
+	 * that can fail, falling back to a cruder integration, before the
+	 * execution stops with an error. 1 means failures are only reported.
+	 */
+	double integration_failure_budget = 1;
+
+	/**
+	 * A JSON file where a timeline of the import stages, snapshot phases and
+	 * tree tasks of each thread is written in the Chrome trace-event format.
+	 * Empty if no trace should be recorded.
+	 */
+	std::string trace_file {};
+
+	/**
+	 * A JSON file rewritten after every phase and evolved snapshot with the
+	 * progress, throughput, memory usage and estimated time to completion of
+	 * the execution. Empty if no status should be written.
+	 */
+	std::string status_file {};
+
+	/**
+	 * The number of simulation batches that are imported, evolved and written
+	 * together before moving on to the next ones. 0 means all batches at once.
+	 */
+	unsigned int batch_group_size = 0;
+
+	/**
+	 * The number of threads importing the merger trees of the next batch
+	 * group in the background while the current one is evolved and written.
+	 * At most two batch groups are then in memory at a time. 0 means batch
+	 * groups are imported only once the previous one is done.
+	 */
+	unsigned int prefetch_threads = 0;
+
+	/**
+	 * Whether the halos and subhalos of a snapshot should be released as soon
+	 * as galaxies have been evolved from it into the next snapshot
+	 */
+	bool release_evolved_snapshots = false;
+
+	/**
+	 * Whether halos, subhalos and galaxies are allocated from per-snapshot
+	 * arenas instead of individually, so that objects of a snapshot lie
+	 * contiguously in memory and are released together
+	 */
+	bool arena_allocation = false;
+
+	/**
+	 * Whether threads are bound to CPUs and each merger tree is given to a
+	 * single thread, which creates its halos, subhalos and galaxies and
+	 * evolves it. This keeps the memory of each tree in the NUMA node of the
+	 * thread evolving it. Requires static tree scheduling.
+	 */
+	bool numa_placement = false;
+
+	/**
+	 * Whether the blocks of memory arenas and the galaxy columns written
+	 * into HDF5 files are backed by huge pages, which reduces TLB misses.
+	 * Explicit huge pages are used if enough of them are reserved, and
+	 * transparent huge pages otherwise.
+	 */
+	bool huge_pages = false;
+
+	/**
+	 * The maximum amount of memory [GB] this execution is allowed to use.
+	 * The execution is aborted, with an estimate of the memory it would need,
+	 * as soon as it is seen using more than this. 0 means there is no budget.
+	 */
+	float memory_budget = 0;
+
+	/**
+	 * What is done when a memory budget is given:
+	 * BUDGET_ABORT: the execution is only aborted if it goes over the budget.
+	 * BUDGET_ADAPT: additionally, if merger trees and initial galaxies already
+	 * take more than half of the budget, release_evolved_snapshots and, where
+	 * possible, stream_sf_histories are enabled before evolving them.
+	 */
+	enum memory_budget_policy_t {
+		BUDGET_ABORT = 0,
+		BUDGET_ADAPT
+	};
+
+	memory_budget_policy_t memory_budget_policy = BUDGET_ABORT;
+
+	/**
+	 * Whether whole merger trees, with their galaxies, are migrated between
+	 * the processes of an MPI execution after each snapshot to balance their
+	 * load. The cost of each tree is the number of ODE evaluations it took
+	 * in the last evolved snapshot. Requires shared_output, so migrated trees
+	 * are written together with the rest of the volume.
+	 */
+	bool tree_migration = false;
+
+	/**
+	 * The ratio between the largest and the mean load of all processes
+	 * above which merger trees are migrated.
+	 */
+	double tree_migration_imbalance = 1.1;
+
+	/**
+	 * Suffix appended to the name of the output directory of an execution
+	 * handling multiple batches, when these are only part of the batches
+	 * handled by the whole execution. Not read from the options.
+	 */
+	std::string batch_directory_suffix {};
 };
 
 } // namespace shark
@@ -24,10 +24,12 @@
 #ifndef SHARK_GALAXY_CREATOR_H_
 #define SHARK_GALAXY_CREATOR_H_
 
+#include "arena.h"
 #include "cosmology.h"
 #include "components.h"
 #include "dark_matter_halos.h"
 #include "gas_cooling.h"
+#include "numa.h"
 #include "simulation.h"
 
 namespace shark {
@@ -35,15 +37,44 @@ namespace shark {
 class GalaxyCreator {
 
 public:
-	GalaxyCreator(const CosmologyPtr &cosmology, GasCoolingParameters cool_params, SimulationParameters sim_params);
-	void create_galaxies(const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &AllBaryons);
+	/**
+	 * Constructor
+	 *
+	 * @param arena_allocation Whether galaxies are allocated from arenas, one
+	 * per snapshot where they are created
+	 */
+	GalaxyCreator(const CosmologyPtr &cosmology, GasCoolingParameters cool_params, SimulationParameters sim_params, bool arena_allocation = false);
+
+	/**
+	 * Creates the initial galaxies of all merger trees.
+	 *
+	 * @param merger_trees The merger trees where galaxies will be created
+	 * @param AllBaryons The global baryon tracking object
+	 * @return The number of galaxies created. Galaxies are given IDs in the
+	 * range @p [0, n), where @p n is this number.
+	 */
+	Galaxy::id_t create_galaxies(const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &AllBaryons);
+
+	/**
+	 * Like create_galaxies(const std::vector<MergerTreePtr> &, TotalBaryon &),
+	 * but galaxies of each tree are created by the thread given the tree by
+	 * @p assignment, so they lie in memory local to it. Galaxies are given the
+	 * same IDs as when created sequentially.
+	 *
+	 * @param merger_trees The merger trees where galaxies will be created
+	 * @param AllBaryons The global baryon tracking object
+	 * @param assignment The assignment of merger trees to threads
+	 * @return The number of galaxies created
+	 */
+	Galaxy::id_t create_galaxies(const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &AllBaryons, const TreeAssignment &assignment);
 
 private:
-	bool create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t ID);
+	bool create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t ID, const ArenaPtr &arena);
 
 	CosmologyPtr cosmology;
 	GasCoolingParameters cool_params;
 	SimulationParameters sim_params;
+	bool arena_allocation;
 };
 
 }  // namespace shark
@@ -0,0 +1,210 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Snapshot-indexed star formation histories of galaxies
+ */
+
+#ifndef SHARK_GALAXY_HISTORY_H
+#define SHARK_GALAXY_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace shark {
+
+/**
+ * Structure that saves the history of relevant baryon components needed for SED calculation later on.
+ */
+struct HistoryItem {
+	float sfr_disk;
+	float sfr_bulge_mergers;
+	float sfr_bulge_diskins;
+	float sfr_z_disk;
+	float sfr_z_bulge_mergers;
+	float sfr_z_bulge_diskins;
+	int snapshot;
+};
+
+/**
+ * A transfer of mass between the history columns of galaxies. Transfers are
+ * recorded as events only for streamed histories, so they can be replayed on
+ * the items that have already been streamed out of memory.
+ */
+struct HistoryEvent {
+
+	enum type_t : std::int32_t {
+		DISK_TO_BULGE_DISKINS = 0,
+		DISK_TO_BULGE_MERGERS,
+		SATELLITE_TO_BULGE_MERGERS
+	};
+
+	std::int32_t type;
+	std::int32_t first_snapshot;
+	std::int32_t last_snapshot;
+	std::int64_t galaxy_id;
+	std::int64_t satellite_id;
+};
+
+/**
+ * The star formation history of a galaxy.
+ *
+ * Histories are stored column-wise and indexed by snapshot, covering the
+ * contiguous range of snapshots between the earliest and the latest item
+ * recorded for the galaxy. Looking up, adding or modifying the item of a
+ * given snapshot is therefore a constant-time operation, and whole columns
+ * can be operated on at once.
+ */
+class GalaxyHistory {
+
+public:
+
+	/// The columns stored for each snapshot
+	enum column {
+		SFR_DISK = 0,
+		SFR_BULGE_MERGERS,
+		SFR_BULGE_DISKINS,
+		SFR_Z_DISK,
+		SFR_Z_BULGE_MERGERS,
+		SFR_Z_BULGE_DISKINS,
+		N_COLUMNS
+	};
+
+	/**
+	 * Creates a new, empty history
+	 *
+	 * @param galaxy_id The ID of the galaxy owning this history
+	 */
+	explicit GalaxyHistory(std::int64_t galaxy_id = -1) : galaxy_id(galaxy_id) {}
+
+	/// Adds @p item to this history, replacing any existing item for the same snapshot
+	void add(const HistoryItem &item);
+
+	/// Whether there is an item for @p snapshot in this history
+	bool exists(int snapshot) const
+	{
+		return snapshot >= first && snapshot < first + int(present.size()) && present[snapshot - first];
+	}
+
+	/// Returns the item for @p snapshot, which must exist
+	HistoryItem get(int snapshot) const;
+
+	/// Returns a reference to the value of @p col at @p snapshot, which must exist
+	float &value(column col, int snapshot)
+	{
+		return columns[col][snapshot - first];
+	}
+
+	/// Returns the value of @p col at @p snapshot, which must exist
+	float value(column col, int snapshot) const
+	{
+		return columns[col][snapshot - first];
+	}
+
+	/// The first snapshot covered by this history
+	int first_snapshot() const
+	{
+		return first;
+	}
+
+	/// The last snapshot covered by this history, or first_snapshot() - 1 if empty
+	int last_snapshot() const
+	{
+		return first + int(present.size()) - 1;
+	}
+
+	/// The number of items in this history
+	std::size_t size() const
+	{
+		return n_items;
+	}
+
+	/// Whether this history contains no items
+	bool empty() const
+	{
+		return n_items == 0;
+	}
+
+	/// The snapshots for which there is an item, in increasing order
+	std::vector<int> snapshots() const;
+
+	/// All items of this history, in increasing snapshot order
+	std::vector<HistoryItem> items() const;
+
+	/// Removes all items from this history
+	void clear();
+
+	/**
+	 * Transfers the disk star formation of snapshots in
+	 * [@p from_snapshot, @p to_snapshot] to the bulge formed via disk
+	 * instabilities.
+	 */
+	void transfer_disk_to_bulge_diskins(int from_snapshot, int to_snapshot);
+
+	/**
+	 * Transfers the disk and disk instabilities bulge star formation of
+	 * snapshots in [@p from_snapshot, @p to_snapshot] to the bulge formed
+	 * via mergers.
+	 */
+	void transfer_disk_to_bulge_mergers(int from_snapshot, int to_snapshot);
+
+	/**
+	 * Adds all the star formation of @p satellite in snapshots
+	 * [@p from_snapshot, @p to_snapshot] to the bulge formed via mergers
+	 * of this history.
+	 */
+	void transfer_satellite_to_bulge_mergers(GalaxyHistory &satellite, int from_snapshot, int to_snapshot);
+
+	/// Whether the items of this history are being streamed out of memory
+	bool streamed() const
+	{
+		return is_streamed;
+	}
+
+	/**
+	 * Marks this history as streamed. From now on all transfers are recorded
+	 * as events, which can be retrieved via take_events().
+	 */
+	void set_streamed()
+	{
+		is_streamed = true;
+	}
+
+	/// Returns and forgets the events recorded since the last call
+	std::vector<HistoryEvent> take_events();
+
+private:
+	std::int64_t galaxy_id;
+	int first = 0;
+	std::uint32_t n_items = 0;
+	bool is_streamed = false;
+	std::vector<bool> present;
+	std::vector<float> columns[N_COLUMNS];
+	std::vector<HistoryEvent> events;
+
+	void cover(int snapshot);
+};
+
+}  // namespace shark
+
+#endif // SHARK_GALAXY_HISTORY_H
@@ -24,8 +24,10 @@
 #ifndef INCLUDE_GALAXY_MERGERS_H_
 #define INCLUDE_GALAXY_MERGERS_H_
 
+#include <cstdint>
 #include <memory>
 #include <random>
+#include <string>
 #include <vector>
 
 #include "agn_feedback.h"
@@ -91,7 +93,8 @@ public:
 
 	double merging_timescale_mass(double mp, double ms);
 
-	double merging_timescale_orbital();
+	/// Draws the orbital part of the merging timescale of the galaxy with random key @p random_key at @p snapshot
+	double merging_timescale_orbital(Galaxy::id_t random_key, int snapshot);
 
 	/**
 	 * Calculates the dynamical friction timescale for the subhalo secondary to merge into the subhalo primary,
@@ -118,7 +121,7 @@ public:
 	 * @param halo the halo where subhalos are going to be possibly merged
 	 * @param z the redshift
 	 */
-	void merging_subhalos(HaloPtr &halo, double z);
+	void merging_subhalos(const HaloPtr &halo, double z);
 
 	void merging_galaxies(HaloPtr &halo, int snapshot, double delta_t);
 
@@ -132,13 +135,12 @@ public:
 
 	void transfer_baryon_mass(SubhaloPtr central, SubhaloPtr satellite);
 
-	void transfer_bulge_gas(SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z);
+	void transfer_bulge_gas(const SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z);
 
 	void transfer_history_satellite_to_bulge(GalaxyPtr &central, GalaxyPtr &satellite, int snapshot);
 
 	void transfer_history_disk_to_bulge(GalaxyPtr &central, int snapshot);
 
-
 private:
 	GalaxyMergerParameters parameters;
 	std::shared_ptr<Cosmology> cosmology;
@@ -147,7 +149,7 @@ private:
 	std::shared_ptr<BasicPhysicalModel> physicalmodel;
 	AGNFeedbackPtr agnfeedback;
 
-	std::default_random_engine generator;
+	std::uint32_t seed;
 	std::lognormal_distribution<double> distribution;
 
 };
@@ -26,19 +26,21 @@
 #ifndef SHARK_GALAXY_WRITER_H_
 #define SHARK_GALAXY_WRITER_H_
 
-#include <fstream>
 #include <map>
+#include <ostream>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "background_worker.h"
 #include "components.h"
 #include "cosmology.h"
 #include "dark_matter_halos.h"
 #include "execution.h"
 #include "hdf5/writer.h"
+#include "history_stream.h"
 #include "simulation.h"
 #include "star_formation.h"
 
@@ -52,11 +54,56 @@ public:
 			CosmologicalParameters cosmo_params,
 			const CosmologyPtr &cosmology,
 			const DarkMatterHalosPtr &darkmatterhalo,
-			SimulationParameters sim_params);
+			SimulationParameters sim_params,
+			unsigned int threads = 1);
 	virtual ~GalaxyWriter() {};
 
 	virtual void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal) = 0;
 
+	/**
+	 * Writes the global properties of the whole execution (i.e., combined
+	 * across all the processes of an MPI execution) for the given snapshot.
+	 * By default nothing is written.
+	 *
+	 * @param snapshot The snapshot being written
+	 * @param AllBaryons The baryon amounts combined across all processes
+	 */
+	virtual void write_global(int snapshot, TotalBaryon &AllBaryons) {};
+
+	/**
+	 * Streams the star formation history items recorded for the given
+	 * snapshot out of memory, if requested by the user. By default nothing is
+	 * streamed.
+	 *
+	 * @param snapshot The snapshot whose history items have just been recorded
+	 * @param halos The halos of that snapshot
+	 */
+	virtual void stream_histories(int snapshot, const std::vector<HaloPtr> &halos) {};
+
+	/**
+	 * Writes the summary statistics of the galaxies of the given snapshot
+	 * into a summary.hdf5 file, regardless of the output format.
+	 *
+	 * @param snapshot The snapshot being written
+	 * @param halos The halos of that snapshot
+	 * @param molgas_per_gal The molecular gas of the galaxies of those halos
+	 */
+	void write_summary(int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal);
+
+	/**
+	 * Waits until all outputs being written in the background, if any, have
+	 * been written to disk.
+	 */
+	void finish();
+
+	std::string get_output_directory(int snapshot);
+
+	/**
+	 * @return The directory under which outputs of all batches are written
+	 * for the given snapshot
+	 */
+	std::string get_snapshot_directory(int snapshot);
+
 	void track_total_baryons(int snapshot, const std::vector<HaloPtr> &halos);
 
 protected:
@@ -67,7 +114,22 @@ protected:
 	DarkMatterHalosPtr darkmatterhalo;
 	SimulationParameters sim_params;
 
-	std::string get_output_directory(int snapshot);
+	/// Number of threads used to collect the values to write
+	unsigned int threads;
+
+	/**
+	 * Whether outputs are written in the background
+	 */
+	bool asynchronous() const;
+
+	/**
+	 * Runs @p job, which writes data into disk, in the background if
+	 * asynchronous() is true, or straight away otherwise.
+	 */
+	void submit(BackgroundWorker::job_t &&job);
+
+private:
+	std::unique_ptr<BackgroundWorker> io_worker;
 };
 
 class HDF5GalaxyWriter : public GalaxyWriter {
@@ -75,12 +137,51 @@ class HDF5GalaxyWriter : public GalaxyWriter {
 public:
 	using GalaxyWriter::GalaxyWriter;
 	void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal) override;
+	void write_global(int snapshot, TotalBaryon &AllBaryons) override;
+	void stream_histories(int snapshot, const std::vector<HaloPtr> &halos) override;
+
+protected:
+	using galaxy_histories_t = std::vector<std::pair<Galaxy::id_t, const GalaxyHistory *>>;
+	std::shared_ptr<HistoryStream> history_stream;
+
+	bool sf_histories_snapshot(int snapshot) const;
+	hdf5::dataset_storage output_storage() const;
+	void write_streamed_histories(int snapshot, const std::vector<HaloPtr> &halos);
+	template <typename FileWriter>
+	std::vector<std::shared_ptr<FileWriter>> write_files(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal);
+	void write_shared(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal);
+	template <typename FileWriter>
+	void write_header (FileWriter &file, int snapshot, std::size_t n_batches);
+	template <typename FileWriter>
+	void write_galaxies (FileWriter &file, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal);
+	template <typename FileWriter, typename T>
+	void write_property (FileWriter &file, const std::string &name, const std::vector<T> &values, const std::string &comment);
+	template <typename FileWriter>
+	void write_global_properties (FileWriter &file, int snapshot, TotalBaryon &AllBaryons);
+	template <typename FileWriter>
+	std::shared_ptr<FileWriter> write_histories (int snapshot, const std::vector<HaloPtr> &halos);
+	template <typename FileWriter>
+	void write_histories (FileWriter &file, int snapshot, const galaxy_histories_t &histories);
+	template <typename FileWriter>
+	void write_history_times (FileWriter &file, int snapshot);
+};
+
+/**
+ * A GalaxyWriter that writes the same galaxy properties as HDF5GalaxyWriter
+ * as raw column files (see ColumnarWriter) under a galaxies directory,
+ * together with an index sorted by galaxy ID. Star formation histories are
+ * still written in HDF5.
+ */
+class ColumnarGalaxyWriter : public HDF5GalaxyWriter {
+
+public:
+	using HDF5GalaxyWriter::HDF5GalaxyWriter;
+	void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal) override;
+	void write_global(int snapshot, TotalBaryon &AllBaryons) override;
 
 private:
-	void write_header (hdf5::Writer &file, int snapshot);
-	void write_galaxies (hdf5::Writer &file, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal);
-	void write_global_properties (hdf5::Writer &file, int snapshot, TotalBaryon &AllBaryons);
-	void write_histories (int snapshot, const std::vector<HaloPtr> &halos);
+	template <typename FileWriter>
+	void write_galaxy_index (FileWriter &file, const std::vector<HaloPtr> &halos);
 };
 
 class ASCIIGalaxyWriter : public GalaxyWriter {
@@ -90,7 +191,11 @@ public:
 	void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal) override;
 
 private:
-	void write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &subhalo, int snapshot, std::ofstream &f, const molgas_per_galaxy &molgas_per_gal);
+	/// Number of consecutive halos whose galaxies are formatted into the same
+	/// buffer, which is the unit of work of formatting threads
+	static constexpr std::size_t ascii_halos_per_block = 1000;
+
+	void write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &subhalo, int snapshot, std::string &buffer, const molgas_per_galaxy &molgas_per_gal);
 
 };
 
@@ -105,6 +210,9 @@ GalaxyWriterPtr make_galaxy_writer(const ExecutionParameters &exec_params, Ts&&.
 	else if (exec_params.output_format == Options::ASCII) {
 		return GalaxyWriterPtr(new ASCIIGalaxyWriter(exec_params, std::forward<Ts>(ts)...));
 	}
+	else if (exec_params.output_format == Options::COLUMNAR) {
+		return GalaxyWriterPtr(new ColumnarGalaxyWriter(exec_params, std::forward<Ts>(ts)...));
+	}
 
 	std::ostringstream os;
 	os << "Output format " << exec_params.output_format << " not currently supported";
@@ -27,6 +27,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 
@@ -59,7 +60,10 @@ public:
 	std::vector<double> get_lambda();
 
 private:
-	std::map<double, std::map<double, double>> _table;
+	typedef std::map<double, std::map<double, double>> table_t;
+
+	// Tables don't change once loaded, so copies share them
+	std::shared_ptr<table_t> _table = std::make_shared<table_t>();
 };
 
 class GasCoolingParameters {
@@ -109,6 +113,15 @@ public:
 			const EnvironmentPtr &environment);
 
 	double cooling_rate(Subhalo &subhalo, Galaxy &galaxy, double z, double deltat);
+
+	/**
+	 * Calculates the cooling rates of many central galaxies at once, writing
+	 * them into @p rates. Results are the same as those of calling
+	 * cooling_rate() on each galaxy, but the calculations shared by all
+	 * galaxies are done for all of them together, evaluating the cooling
+	 * function in a single batch. All galaxies must belong to different halos.
+	 */
+	void cooling_rates(const std::vector<std::pair<Subhalo *, Galaxy *>> &galaxies, double z, double deltat, double rates[]);
 	double cooling_time(double Tvir, double logl, double nh_density);
 	double mean_density(double mhot, double rvir);
 	double cooling_radius(double mhot, double rvir, double tcharac, double logl, double Tvir);
@@ -126,7 +139,47 @@ private:
 	DarkMatterHalosPtr darkmatterhalos;
 	ReincorporationPtr reincorporation;
 	EnvironmentPtr environment;
-	Interpolator cooling_lambda_interpolator;
+	// Shared by all copies of this object (e.g., those of each thread)
+	std::shared_ptr<const GridInterpolator> cooling_lambda_interpolator;
+
+	/// The properties of a halo determining its cooling rate,
+	/// first calculated by prepare_cooling() and then by cooling_functions()
+	struct cooling_inputs {
+		double mhot;
+		double mhot_ejec;
+		double mzhot;
+		double zhot;
+		double vvir;
+		double Tvir;
+		double lgTvir;
+		double Rvir;
+		double Ledd;
+		double logl;
+		double nh_density;
+		double tcool;
+	};
+
+	// Reused across calls to cooling_rates to avoid reallocations
+	std::vector<cooling_inputs> batch_inputs;
+	std::vector<std::size_t> batch_indices;
+	std::vector<double> lgTvir_values;
+	std::vector<double> zhot_values;
+	std::vector<double> logl_values;
+
+	// The reionisation velocity threshold of the last redshift it was
+	// calculated for, as all galaxies of a snapshot share it
+	double reionisation_z = -1;
+	double reionisation_vthresh = 0;
+
+	/// The velocity below which halos at @p z are affected by reionisation
+	double reionisation_threshold(double z);
+
+	/// Updates the subhalo's gas before cooling, and calculates the
+	/// cooling inputs; returns false if the subhalo has no cooling,
+	/// including when its velocity is below the reionisation @p vthresh
+	bool prepare_cooling(Subhalo &subhalo, Galaxy &galaxy, double z, double deltat, double vthresh, cooling_inputs &inputs);
+	void cooling_functions(cooling_inputs inputs[], std::size_t n);
+	double finish_cooling(Subhalo &subhalo, Galaxy &galaxy, double z, double deltat, const cooling_inputs &inputs);
 
 };
 
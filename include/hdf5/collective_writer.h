@@ -0,0 +1,183 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Header file for the hdf5::CollectiveWriter class
+ */
+
+#ifndef SHARK_HDF5_COLLECTIVE_WRITER_H_
+#define SHARK_HDF5_COLLECTIVE_WRITER_H_
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "hdf5/writer.h"
+
+namespace shark {
+
+namespace hdf5 {
+
+/**
+ * A Writer through which all the processes of an MPI execution write a single
+ * file together using MPI-IO.
+ *
+ * All processes must perform the same sequence of writes, with the same names.
+ * Datasets under one of the given distributed paths hold the concatenation of
+ * the values given by all processes, in rank order, each process writing its
+ * own slice collectively. All other datasets and attributes are replicated,
+ * and hold the values given by process 0.
+ *
+ * This class can be used only if shark has been compiled with MPI support
+ * against a parallel HDF5 library.
+ */
+class CollectiveWriter : public Writer {
+
+public:
+
+	/**
+	 * Collectively creates a new file.
+	 *
+	 * @param filename The name of the HDF5 file to write
+	 * @param distributed_paths Groups or datasets whose values are
+	 * distributed across processes
+	 */
+	CollectiveWriter(const std::string &filename, const std::vector<std::string> &distributed_paths);
+
+	/**
+	 * @return Whether this shark build can write files collectively
+	 */
+	static bool supported();
+
+	/**
+	 * Returns the offset at which @p count values given by this process start
+	 * when concatenating the values of all processes. This is a collective
+	 * operation.
+	 *
+	 * @param count The number of values given by this process
+	 * @return The number of values given by all processes before this one
+	 */
+	hsize_t global_offset(hsize_t count) const;
+
+	template<typename T>
+	void write_dataset(const std::string &name, const T &value, const std::string &comment = NO_COMMENT) {
+		library_lock lock;
+		H5::DataSpace dataSpace(H5S_SCALAR);
+		H5::DataType dataType = _datatype<T>(value);
+		auto dataset = ensure_dataset(tokenize(name, "/"), dataType, dataSpace);
+		set_comment(dataset, comment);
+		if (rank == 0) {
+			_write_dataset(dataset, dataType, dataSpace, value);
+		}
+	}
+
+	template<typename T>
+	void write_dataset(const std::string &name, const std::vector<T> &values, const std::string &comment = NO_COMMENT) {
+		library_lock lock;
+		typedef std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value> distributable;
+		if (distributable::value && is_distributed(name)) {
+			write_distributed(name, values, comment, distributable());
+			return;
+		}
+		const hsize_t size = replicated_size(values.size());
+		H5::DataSpace dataSpace(1, &size);
+		H5::DataType dataType = _datatype<T>(values);
+		auto dataset = ensure_dataset(tokenize(name, "/"), dataType, dataSpace);
+		set_comment(dataset, comment);
+		if (rank == 0) {
+			_write_dataset(dataset, dataType, dataSpace, values);
+		}
+	}
+
+	template<typename T>
+	void write_dataset(const std::string &name, const std::vector<std::vector<T>> &values, const std::string &comment = NO_COMMENT) {
+		library_lock lock;
+		if (!is_distributed(name)) {
+			const hsize_t sizes[] = {replicated_size(values.size()), replicated_size(values.empty() ? 0 : values[0].size())};
+			if (sizes[0] == 0) {
+				return;
+			}
+			H5::DataSpace dataSpace(2, sizes);
+			H5::DataType dataType = _datatype<T>(values);
+			auto dataset = ensure_dataset(tokenize(name, "/"), dataType, dataSpace);
+			set_comment(dataset, comment);
+			if (rank == 0) {
+				_write_dataset(dataset, dataType, dataSpace, values);
+			}
+			return;
+		}
+
+		// Rows are flattened and written as a single slice of the dataset
+		hsize_t width = max_size(values.empty() ? 0 : values[0].size());
+		std::vector<T> flat_values;
+		flat_values.reserve(values.size() * width);
+		for (auto &row: values) {
+			if (row.size() != width) {
+				throw invalid_argument("rows of dataset " + name + " have different sizes");
+			}
+			flat_values.insert(flat_values.end(), row.begin(), row.end());
+		}
+		H5::DataType dataType = _datatype<T>(values);
+		H5::DataType mem_dataType(datatype_traits<T>::native_type);
+		write_slice(name, dataType, mem_dataType, flat_values.data(), 2, values.size(), width, comment);
+	}
+
+private:
+
+	template <typename T>
+	void write_distributed(const std::string &name, const std::vector<T> &values, const std::string &comment, std::true_type)
+	{
+		H5::DataType dataType = _datatype<T>(values);
+		H5::DataType mem_dataType(datatype_traits<T>::native_type);
+		write_slice(name, dataType, mem_dataType, values.data(), 1, values.size(), 1, comment);
+	}
+
+	template <typename T>
+	void write_distributed(const std::string &name, const std::vector<T> &values, const std::string &comment, std::false_type)
+	{
+		// never called, non-numerical values are always replicated
+	}
+
+	/**
+	 * Collectively creates a one- or two-dimensional dataset with the rows
+	 * given by all processes, and writes the @p rows rows of @p width values
+	 * given by this process into their place.
+	 */
+	void write_slice(const std::string &name, const H5::DataType &dataType, const H5::DataType &mem_dataType,
+	                 const void *values, int ndims, hsize_t rows, hsize_t width, const std::string &comment);
+
+	bool is_distributed(const std::string &name) const;
+
+	/// The size of the replicated values given by process 0
+	hsize_t replicated_size(hsize_t size) const;
+
+	/// The maximum size given by any process
+	hsize_t max_size(hsize_t size) const;
+
+	std::vector<std::string> distributed_paths;
+	int rank;
+};
+
+}  // namespace hdf5
+
+}  // namespace shark
+
+#endif // SHARK_HDF5_COLLECTIVE_WRITER_H_
@@ -0,0 +1,136 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Header file for the hdf5::DeferredWriter class
+ */
+
+#ifndef SHARK_HDF5_DEFERRED_WRITER_H_
+#define SHARK_HDF5_DEFERRED_WRITER_H_
+
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hdf5/writer.h"
+
+namespace shark {
+
+namespace hdf5 {
+
+/**
+ * An object with the same writing interface as Writer, but which keeps a copy
+ * of all the given values in memory instead of writing them straight away.
+ * The file is created and all values are written into it when flush() is
+ * called.
+ *
+ * Since no HDF5 calls are made until flush() is called, this class allows to
+ * collect data in one thread and write it into disk in a different one.
+ */
+class DeferredWriter {
+
+public:
+
+	/**
+	 * Constructs a new DeferredWriter object.
+	 *
+	 * @param filename The name of the HDF5 file to write
+	 */
+	explicit DeferredWriter(const std::string &filename) :
+		filename(filename)
+	{
+		// no-op
+	}
+
+	/**
+	 * Sets how the datasets of the file are stored once it is written.
+	 *
+	 * @param storage The storage settings for the file's datasets
+	 */
+	void set_storage(const dataset_storage &storage) {
+		this->storage = storage;
+	}
+
+	template<typename T>
+	void write_attribute(const std::string &name, T &&value) {
+		typedef typename std::decay<T>::type value_t;
+		operations.emplace_back(attribute_operation<value_t>{name, std::forward<T>(value)});
+	}
+
+	template<typename T>
+	void write_dataset(const std::string &name, T &&value, const std::string &comment = std::string()) {
+		typedef typename std::decay<T>::type value_t;
+		operations.emplace_back(dataset_operation<value_t>{name, std::forward<T>(value), comment});
+	}
+
+	/**
+	 * Creates the HDF5 file and writes all the values given so far into it.
+	 */
+	void flush() {
+		Writer writer(filename);
+		writer.set_storage(storage);
+		for (auto &operation: operations) {
+			operation(writer);
+		}
+		operations.clear();
+	}
+
+	/**
+	 * Returns the filename this object will write to.
+	 * @return The filename this object will write to.
+	 */
+	const std::string &get_filename() const {
+		return filename;
+	}
+
+private:
+
+	template <typename T>
+	struct attribute_operation {
+		std::string name;
+		T value;
+		void operator()(Writer &writer) const {
+			writer.write_attribute(name, value);
+		}
+	};
+
+	template <typename T>
+	struct dataset_operation {
+		std::string name;
+		T value;
+		std::string comment;
+		void operator()(Writer &writer) const {
+			writer.write_dataset(name, value, comment);
+		}
+	};
+
+	std::string filename;
+	dataset_storage storage {};
+	std::vector<std::function<void(Writer &)>> operations {};
+};
+
+}  // namespace hdf5
+
+}  // namespace shark
+
+#endif // SHARK_HDF5_DEFERRED_WRITER_H_
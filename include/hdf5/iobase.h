@@ -26,6 +26,7 @@
 #ifndef INCLUDE_HDF5_IOBASE_H_
 #define INCLUDE_HDF5_IOBASE_H_
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -52,7 +53,25 @@ namespace shark {
 namespace hdf5 {
 
 /**
- * Base class for objects handling HDF5 I/O
+ * A lock on the process-wide mutex serialising all calls into the HDF5
+ * library. HDF5 is usually not built thread-safe, but shark reads and writes
+ * files from background threads (merger trees prefetched or read ahead,
+ * outputs written while galaxies are evolved), so every piece of code calling
+ * HDF5 holds one of these while doing so. The mutex is recursive, so code
+ * already holding a lock can call other functions taking one.
+ */
+class library_lock {
+
+public:
+	library_lock();
+
+private:
+	std::lock_guard<std::recursive_mutex> lock;
+};
+
+/**
+ * Base class for objects handling HDF5 I/O. All HDF5 calls made through this
+ * class and its subclasses hold a library_lock.
  */
 class IOBase {
 
@@ -71,6 +90,16 @@ public:
 	 */
 	IOBase(const std::string &filename, unsigned int flags);
 
+	/**
+	 * Opens the given file in the given mode, with the given file access
+	 * properties
+	 *
+	 * @param filename The HDF5 filename
+	 * @param flags The mode in which the file will be opened
+	 * @param access_plist The file access properties
+	 */
+	IOBase(const std::string &filename, unsigned int flags, const H5::FileAccPropList &access_plist);
+
 	/**
 	 * Closes the file and destroys this class
 	 */
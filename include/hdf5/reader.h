@@ -34,13 +34,24 @@
 
 #include <H5Cpp.h>
 
+#include "exceptions.h"
+#include "span.h"
 #include "utils.h"
 #include "hdf5/iobase.h"
+#include "hdf5/traits.h"
 
 namespace shark {
 
 namespace hdf5 {
 
+/**
+ * A contiguous range of rows of a dataset
+ */
+struct row_range {
+	hsize_t first;
+	hsize_t count;
+};
+
 class Reader : public IOBase {
 
 public:
@@ -55,6 +66,7 @@ public:
 
 	template<typename T>
 	const T read_attribute(const std::string &name) const {
+		library_lock lock;
 		std::string attr_name;
 		H5::Attribute attr = get_attribute(name);
 		H5::DataType type = attr.getDataType();
@@ -66,21 +78,210 @@ public:
 
 	template<typename T>
 	T read_dataset(const std::string &name) const {
+		library_lock lock;
 		return _read_dataset<T>(get_dataset(name));
 	}
 
 	template<typename T>
 	std::vector<T> read_dataset_v(const std::string &name) const {
+		library_lock lock;
 		return _read_dataset_v<T>(get_dataset(name));
 	}
 
 	template<typename T>
 	std::vector<T> read_dataset_v_2(const std::string &name) const {
+		library_lock lock;
 		return _read_dataset_v_2<T>(get_dataset(name));
 	}
 
+	/**
+	 * Reads @p count rows of a 1-dimensional dataset starting at row @p first
+	 *
+	 * @param name The name of the dataset
+	 * @param first The first row to read
+	 * @param count The number of rows to read
+	 * @return The values of the selected rows
+	 */
+	template<typename T>
+	std::vector<T> read_dataset_v(const std::string &name, hsize_t first, hsize_t count) const {
+		library_lock lock;
+		return _read_dataset_v<T>(get_dataset(name), {{first, count}});
+	}
+
+	/**
+	 * Reads the given ranges of rows of a 1-dimensional dataset. The values
+	 * of all ranges are returned one after the other
+	 *
+	 * @param name The name of the dataset
+	 * @param rows The ranges of rows to read, in increasing order and not
+	 * overlapping
+	 * @return The values of the selected rows
+	 */
+	template<typename T>
+	std::vector<T> read_dataset_v(const std::string &name, const std::vector<row_range> &rows) const {
+		library_lock lock;
+		return _read_dataset_v<T>(get_dataset(name), rows);
+	}
+
+	/**
+	 * Reads @p count rows of a 2-dimensional dataset starting at row @p first.
+	 * The values of all columns of the selected rows are returned in row-major
+	 * order
+	 *
+	 * @param name The name of the dataset
+	 * @param first The first row to read
+	 * @param count The number of rows to read
+	 * @return The values of the selected rows
+	 */
+	template<typename T>
+	std::vector<T> read_dataset_v_2(const std::string &name, hsize_t first, hsize_t count) const {
+		library_lock lock;
+		return _read_dataset_v_2<T>(get_dataset(name), {{first, count}});
+	}
+
+	/**
+	 * Reads the given ranges of rows of a 2-dimensional dataset. The values of
+	 * all columns of the selected rows are returned in row-major order
+	 *
+	 * @param name The name of the dataset
+	 * @param rows The ranges of rows to read, in increasing order and not
+	 * overlapping
+	 * @return The values of the selected rows
+	 */
+	template<typename T>
+	std::vector<T> read_dataset_v_2(const std::string &name, const std::vector<row_range> &rows) const {
+		library_lock lock;
+		return _read_dataset_v_2<T>(get_dataset(name), rows);
+	}
+
+	/**
+	 * Reads a whole dataset into a caller-provided buffer, avoiding any
+	 * intermediate copies. Values of datasets with more than one dimension are
+	 * read in row-major order, and scalar datasets are read as a single value.
+	 * HDF5 converts values from the type they have in the file into @p T.
+	 *
+	 * @param name The name of the dataset
+	 * @param out The buffer to read values into, which must have exactly as
+	 * many elements as the dataset
+	 */
+	template<typename T>
+	void read_dataset_into(const std::string &name, mutable_span<T> out) const {
+		library_lock lock;
+		H5::DataSet dataset = get_dataset(name);
+		H5::DataSpace space = dataset.getSpace();
+		_read_selection_into<T>(name, dataset, space, out);
+	}
+
+	/**
+	 * Like read_dataset_into(const std::string &, mutable_span<T>), but reads
+	 * only the given ranges of rows
+	 *
+	 * @param name The name of the dataset
+	 * @param rows The ranges of rows to read, in increasing order and not
+	 * overlapping
+	 * @param out The buffer to read values into, which must have exactly as
+	 * many elements as the selected rows
+	 */
+	template<typename T>
+	void read_dataset_into(const std::string &name, const std::vector<row_range> &rows, mutable_span<T> out) const {
+		library_lock lock;
+		_read_dataset_into<T>(name, rows, -1, out);
+	}
+
+	/**
+	 * Reads the given ranges of rows of a 2-dimensional dataset, scattering
+	 * each column into its own caller-provided buffer (e.g., the x, y and z
+	 * components of a structure of arrays)
+	 *
+	 * @param name The name of the dataset
+	 * @param rows The ranges of rows to read, in increasing order and not
+	 * overlapping
+	 * @param columns One buffer per column of the dataset, each with exactly
+	 * as many elements as the selected rows
+	 */
+	template<typename T>
+	void read_dataset_columns_into(const std::string &name, const std::vector<row_range> &rows, const std::vector<mutable_span<T>> &columns) const {
+		library_lock lock;
+		for (std::size_t column = 0; column != columns.size(); column++) {
+			_read_dataset_into<T>(name, rows, int(column), columns[column]);
+		}
+	}
+
+	/**
+	 * Returns the number of rows (i.e., the size of the first dimension) of
+	 * the given dataset
+	 *
+	 * @param name The name of the dataset
+	 * @return The number of rows of the dataset
+	 */
+	hsize_t get_dataset_rows(const std::string &name) const;
+
+	/**
+	 * Returns the size of each dimension of the given dataset, which is empty
+	 * for scalar datasets
+	 *
+	 * @param name The name of the dataset
+	 * @return The dimensions of the dataset
+	 */
+	std::vector<hsize_t> get_dataset_dimensions(const std::string &name) const;
+
+	/**
+	 * Returns whether the values of the given dataset are integer or
+	 * floating-point numbers, which can be read as any arithmetic type
+	 *
+	 * @param name The name of the dataset
+	 * @return Whether the dataset is numeric
+	 */
+	bool is_numeric_dataset(const std::string &name) const;
+
+	/**
+	 * Returns the names of all datasets in the file, including those in
+	 * nested groups, as paths relative to the root of the file
+	 * (e.g., galaxies/id_galaxy) in the order they are stored
+	 *
+	 * @return The names of all datasets
+	 */
+	std::vector<std::string> get_dataset_names() const;
+
+	/**
+	 * Returns whether the given group or dataset exists in the file
+	 *
+	 * @param name The name of the group or dataset
+	 * @return Whether it exists
+	 */
+	bool exists(const std::string &name) const;
+
 private:
 
+	hsize_t select_rows(H5::DataSpace &space, const std::vector<row_range> &rows, int column = -1) const;
+
+	template<typename T>
+	void _read_dataset_into(const std::string &name, const std::vector<row_range> &rows, int column, mutable_span<T> out) const {
+
+		H5::DataSet dataset = get_dataset(name);
+		H5::DataSpace space = dataset.getSpace();
+		select_rows(space, rows, column);
+		_read_selection_into<T>(name, dataset, space, out);
+	}
+
+	template<typename T>
+	void _read_selection_into(const std::string &name, const H5::DataSet &dataset, const H5::DataSpace &space, mutable_span<T> out) const {
+
+		hsize_t n_values = space.getSelectNpoints();
+		if (n_values != out.size()) {
+			std::ostringstream os;
+			os << "Buffer for dataset " << name << " in " << get_filename() << " has " << out.size();
+			os << " elements, but " << n_values << " values were selected";
+			throw invalid_argument(os.str());
+		}
+		if (n_values == 0) {
+			return;
+		}
+
+		H5::DataSpace mem_space(1, &n_values);
+		dataset.read(out.data(), datatype_traits<T>::native_type, mem_space, space);
+	}
+
 	H5::Attribute get_attribute(const std::string &name) const;
 
 	template<typename T>
@@ -117,6 +318,41 @@ private:
 		return data;
 	}
 
+	template<typename T>
+	typename std::enable_if<std::is_arithmetic<T>::value, std::vector<T>>::type
+	_read_dataset_v(const H5::DataSet &dataset, const std::vector<row_range> &rows) const {
+
+		H5::DataSpace space = get_1d_dataspace(dataset);
+		hsize_t count = select_rows(space, rows);
+		if (count == 0) {
+			return {};
+		}
+
+		H5::DataSpace mem_space(1, &count);
+		std::vector<T> data(count);
+		dataset.read(data.data(), dataset.getDataType(), mem_space, space);
+		return data;
+	}
+
+	template<typename T>
+	typename std::enable_if<std::is_arithmetic<T>::value, std::vector<T>>::type
+	_read_dataset_v_2(const H5::DataSet &dataset, const std::vector<row_range> &rows) const {
+
+		H5::DataSpace space = get_2d_dataspace(dataset);
+		hsize_t dim_sizes[2];
+		space.getSimpleExtentDims(dim_sizes, NULL);
+		hsize_t count = select_rows(space, rows);
+		if (count == 0) {
+			return {};
+		}
+
+		hsize_t counts[2] = {count, dim_sizes[1]};
+		H5::DataSpace mem_space(2, counts);
+		std::vector<T> data(counts[0] * counts[1]);
+		dataset.read(data.data(), dataset.getDataType(), mem_space, space);
+		return data;
+	}
+
 };
 
 }  // namespace hdf5
@@ -26,10 +26,12 @@
 #ifndef SHARK_HDF5_WRITER_H_
 #define SHARK_HDF5_WRITER_H_
 
+#include <cstddef>
 #include <iterator>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <H5Cpp.h>
@@ -194,6 +196,36 @@ void _create_and_write_attribute(AttributeHolder &dataset, const std::string &na
 	_write_attribute<T>(attr, dataType, value);
 }
 
+/**
+ * How the datasets created by a Writer are stored in the file.
+ */
+struct dataset_storage {
+
+	enum compression_t {
+		NONE = 0,
+		DEFLATE,
+		LZ4
+	};
+
+	/// Maximum number of values per chunk. 0 means datasets are chunked only
+	/// if they are compressed, using a default chunk size
+	unsigned int chunk_size = 0;
+
+	/// The compression filter applied to each chunk. LZ4 needs the HDF5 LZ4
+	/// filter plugin, otherwise DEFLATE is used instead
+	compression_t compression = NONE;
+
+	/// The DEFLATE compression level, from 1 to 9
+	unsigned int level = 4;
+
+	/// Whether the shuffle filter is applied before compressing chunks
+	bool shuffle = true;
+
+	/// Number of threads used to compress the chunks of a dataset, when
+	/// shark can compress them itself
+	unsigned int threads = 1;
+};
+
 /**
  * An object that can write data in the form of attributes and datasets into an
  * HDF5 file.
@@ -213,8 +245,16 @@ public:
 		naming_convention dataset_naming_convention = naming_convention::SNAKE_CASE,
 		naming_convention attr_naming_convention = naming_convention::SNAKE_CASE);
 
+	/**
+	 * Sets how the datasets created from now on are stored in the file
+	 *
+	 * @param storage The storage settings for new datasets
+	 */
+	void set_storage(const dataset_storage &storage);
+
 	void set_comment(H5::DataSet &dataset, const std::string &comment)
 	{
+		library_lock lock;
 		if (comment.empty()) {
 			return;
 		}
@@ -232,6 +272,7 @@ public:
 
 	template<typename T>
 	void write_attribute(const std::string &name, const T &value) {
+		library_lock lock;
 
 		std::vector<std::string> parts = tokenize(name, "/");
 
@@ -261,6 +302,7 @@ public:
 
 	template<typename T>
 	void write_dataset(const std::string &name, const T &value, const std::string &comment = NO_COMMENT) {
+		library_lock lock;
 		H5::DataSpace dataSpace(H5S_SCALAR);
 		H5::DataType dataType = _datatype<T>(value);
 		auto dataset = ensure_dataset(tokenize(name, "/"), dataType, dataSpace);
@@ -270,16 +312,21 @@ public:
 
 	template<typename T>
 	void write_dataset(const std::string &name, const std::vector<T> &values, const std::string &comment = NO_COMMENT) {
+		library_lock lock;
 		const hsize_t size = values.size();
 		H5::DataSpace dataSpace(1, &size);
 		H5::DataType dataType = _datatype<T>(values);
 		auto dataset = ensure_dataset(tokenize(name, "/"), dataType, dataSpace);
 		set_comment(dataset, comment);
-		_write_dataset(dataset, dataType, dataSpace, values);
+		typedef std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value> compressible;
+		if (!write_chunks(dataset, values, compressible())) {
+			_write_dataset(dataset, dataType, dataSpace, values);
+		}
 	}
 
 	template<typename T>
 	void write_dataset(const std::string &name, const std::vector<std::vector<T>> &values, const std::string &comment = NO_COMMENT) {
+		library_lock lock;
 		if (values.empty()) {
 			return;
 		}
@@ -291,11 +338,49 @@ public:
 		_write_dataset(dataset, dataType, dataSpace, values);
 	}
 
-private:
+protected:
+
+	/**
+	 * Constructs a new Writer object for a file opened with the given file
+	 * access properties, overwriting it if it exists.
+	 *
+	 * @param filename The name of the HDF5 file to write
+	 * @param access_plist The file access properties
+	 */
+	Writer(const std::string &filename, const H5::FileAccPropList &access_plist);
 
 	H5::Group ensure_group(const std::vector<std::string> &path) const;
 	H5::DataSet ensure_dataset(const std::vector<std::string> &path, const H5::DataType &dataType, const H5::DataSpace &dataSpace) const;
 
+	static const std::string NO_COMMENT;
+
+private:
+
+	H5::DSetCreatPropList creation_properties(const H5::DataType &dataType, const H5::DataSpace &dataSpace) const;
+
+	template <typename T>
+	bool write_chunks(const H5::DataSet &dataset, const std::vector<T> &values, std::true_type) const
+	{
+		H5::DataType mem_dataType(datatype_traits<T>::native_type);
+		return write_chunks(dataset, mem_dataType, values.data(), sizeof(T), values.size());
+	}
+
+	template <typename T>
+	bool write_chunks(const H5::DataSet &dataset, const std::vector<T> &values, std::false_type) const
+	{
+		return false;
+	}
+
+	/**
+	 * Compresses the chunks of a one-dimensional DEFLATE-compressed dataset
+	 * in parallel and writes them directly into the file. Returns false if
+	 * this is not possible for the given dataset, in which case values
+	 * should be written normally.
+	 */
+	bool write_chunks(const H5::DataSet &dataset, const H5::DataType &mem_dataType, const void *values, std::size_t value_size, hsize_t n_values) const;
+
+	dataset_storage storage;
+
 	naming_convention group_naming_convention;
 	naming_convention dataset_naming_convention;
 	naming_convention attr_naming_convention;
@@ -303,8 +388,6 @@ private:
 	void check_group_name(const std::string &group_name) const;
 	void check_dataset_name(const std::string &dataset_name) const;
 	void check_attr_name(const std::string &attr_name) const;
-
-	static const std::string NO_COMMENT;
 };
 
 }  // namespace hdf5
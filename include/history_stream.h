@@ -0,0 +1,128 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Streaming of star formation histories into disk
+ */
+
+#ifndef SHARK_HISTORY_STREAM_H
+#define SHARK_HISTORY_STREAM_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "components.h"
+#include "galaxy_history.h"
+
+namespace H5 {
+class H5File;
+}
+
+namespace shark {
+
+/**
+ * Streams the star formation histories of galaxies into extendible,
+ * chunked HDF5 datasets as the evolution proceeds, so they don't need to be
+ * kept in memory for the whole execution.
+ *
+ * Every snapshot the new history items of all galaxies are appended to the
+ * stream together with the transfers between history columns that happened
+ * during that snapshot (see HistoryEvent). The final histories of galaxies
+ * are later assembled by replaying the appended items and events in order.
+ *
+ * The stream file contains a @c rows group with one dataset per history
+ * column plus the @c galaxy_id and @c snapshot of each item, an @c events
+ * group with one dataset per HistoryEvent member, and an @c index group
+ * with the @c snapshot, @c row_offset and @c event_offset of each appended
+ * snapshot.
+ *
+ * Objects of this class are not thread-safe; in particular, collect() must
+ * be called from the thread evolving galaxies, while append() and
+ * assemble() can be called from a different one.
+ */
+class HistoryStream {
+
+public:
+
+	/// The items and events of a single snapshot
+	struct snapshot_block {
+		int snapshot;
+		std::vector<std::int64_t> galaxy_ids;
+		std::vector<HistoryItem> items;
+		std::vector<HistoryEvent> events;
+	};
+
+	/// Assembled histories, indexed by galaxy ID
+	using histories_t = std::unordered_map<std::int64_t, GalaxyHistory>;
+
+	/**
+	 * Creates a new stream. The underlying file is created only when the
+	 * first snapshot is appended.
+	 *
+	 * @param filename The name of the HDF5 file to stream histories into
+	 */
+	explicit HistoryStream(const std::string &filename);
+	~HistoryStream();
+
+	/**
+	 * Collects the history items and events of all galaxies in @p halos,
+	 * removing them from the galaxies' in-memory histories.
+	 *
+	 * @param snapshot The snapshot being collected
+	 * @param halos The halos whose galaxies' histories are collected
+	 * @return The collected items and events
+	 */
+	static snapshot_block collect(int snapshot, const std::vector<HaloPtr> &halos);
+
+	/**
+	 * Appends @p block to the stream
+	 */
+	void append(const snapshot_block &block);
+
+	/**
+	 * Assembles the histories of the given galaxies from everything appended
+	 * to this stream so far.
+	 *
+	 * @param galaxy_ids The IDs of the galaxies whose histories are needed
+	 * @return The histories of the requested galaxies
+	 */
+	histories_t assemble(const std::vector<std::int64_t> &galaxy_ids);
+
+	/// Returns the name of the file this stream writes to
+	const std::string &get_filename() const
+	{
+		return filename;
+	}
+
+private:
+	std::string filename;
+	std::unique_ptr<H5::H5File> file;
+	std::int64_t n_rows = 0;
+	std::int64_t n_events = 0;
+};
+
+}  // namespace shark
+
+#endif // SHARK_HISTORY_STREAM_H
@@ -0,0 +1,101 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Backing of large buffers with huge pages
+ */
+
+#ifndef SHARK_HUGE_PAGES_H_
+#define SHARK_HUGE_PAGES_H_
+
+#include <cstddef>
+
+namespace shark {
+namespace huge_pages {
+
+/// The size of huge pages [bytes]
+constexpr std::size_t page_size = 2 * 1024 * 1024;
+
+/// How a block of memory is backed
+enum backing {
+	/// Regular pages, taken from operator new
+	REGULAR = 0,
+	/// Transparent huge pages, which the kernel provides on a best-effort basis
+	TRANSPARENT,
+	/// Explicit huge pages, reserved by the system administrator
+	/// (see /proc/sys/vm/nr_hugepages)
+	EXPLICIT
+};
+
+/// A block of memory given by allocate()
+struct block {
+	char *data;
+	std::size_t size;
+	backing backed_by;
+};
+
+/**
+ * Enables or disables the use of huge pages by allocate() and advise() from
+ * now on. Huge pages are disabled by default.
+ */
+void enable(bool enabled = true);
+
+/// Whether huge pages are enabled
+bool enabled();
+
+/**
+ * Allocates a block of at least @p size bytes. If huge pages are enabled the
+ * block is rounded up to whole huge pages and backed by explicit huge pages
+ * if the system has enough of them reserved, or else advised to be backed by
+ * transparent huge pages. Otherwise, or where huge pages are not supported,
+ * the block is backed by regular pages.
+ *
+ * @param size The minimum size of the block [bytes]
+ * @return The block, which must be released with deallocate()
+ * @throws std::bad_alloc if there is no memory left
+ */
+block allocate(std::size_t size);
+
+/// Releases a block given by allocate()
+void deallocate(const block &b);
+
+/**
+ * If huge pages are enabled, advises the kernel to back the whole huge pages
+ * within [@p ptr, @p ptr + @p size) with transparent huge pages. This should
+ * be done before the memory is first written, which is when pages are given
+ * to the process. Errors (e.g., transparent huge pages being disabled) are
+ * ignored, so memory remains backed by regular pages.
+ */
+void advise(void *ptr, std::size_t size);
+
+/// @return The memory currently allocated by allocate() with explicit huge
+/// pages, which doesn't count towards the resident set size [bytes]
+std::size_t explicit_bytes();
+
+/// @return The memory of this process currently backed by transparent huge
+/// pages, or 0 if it cannot be determined [bytes]
+std::size_t transparent_bytes();
+
+}  // namespace huge_pages
+}  // namespace shark
+
+#endif // SHARK_HUGE_PAGES_H_
@@ -26,6 +26,7 @@
 #ifndef SHARK_IMPORTER_DESCENDANTS
 #define SHARK_IMPORTER_DESCENDANTS
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -43,30 +44,72 @@ struct descendants_data_t {
 	int  descendant_snapshot;
 };
 
+/**
+ * The contents of a descendants file, one column per field
+ */
+struct descendants_columns {
+	std::vector<long> halo_id;
+	std::vector<int> halo_snapshot;
+	std::vector<long> descendant_id;
+	std::vector<int> descendant_snapshot;
+
+	/// Resizes all columns to hold @p n descendants
+	void resize(std::size_t n);
+
+	/// @return The number of descendants in these columns
+	std::size_t size() const
+	{
+		return halo_id.size();
+	}
+};
+
 class DescendantReader {
 
 public:
 	DescendantReader(const std::string &filename);
 	virtual ~DescendantReader();
-	virtual std::vector<descendants_data_t> read_whole() = 0;
+
+	/**
+	 * Reads the whole descendants file into columns
+	 *
+	 * @return The contents of the file
+	 */
+	virtual descendants_columns read_columns() = 0;
+
+	/**
+	 * Reads the whole descendants file into a list of descendants
+	 *
+	 * @return The contents of the file
+	 */
+	std::vector<descendants_data_t> read_whole();
 
 protected:
 	std::string filename;
 };
 
+/**
+ * Reads ASCII descendants files. Their first line contains the number of
+ * descendants, and each following line the halo ID, halo snapshot,
+ * descendant ID and descendant snapshot of one descendant.
+ *
+ * The file is memory-mapped and split into blocks of whole lines, which are
+ * then parsed in parallel into preallocated columns.
+ */
 class AsciiDescendantReader : public DescendantReader {
 
 public:
-	AsciiDescendantReader(const std::string &filename);
-	std::vector<descendants_data_t> read_whole() override;
+	AsciiDescendantReader(const std::string &filename, unsigned int threads = 1);
+	descendants_columns read_columns() override;
 
+private:
+	unsigned int threads;
 };
 
 class HDF5DescendantReader : public DescendantReader {
 
 public:
 	HDF5DescendantReader(const std::string &filename);
-	std::vector<descendants_data_t> read_whole() override;
+	descendants_columns read_columns() override;
 
 };
 
@@ -26,15 +26,32 @@
 #ifndef SHARK_IMPORTER_READER
 #define SHARK_IMPORTER_READER
 
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
 #include "components.h"
+#include "importer/surfs.h"
 
 namespace shark {
 
 namespace importer {
 
+/**
+ * The data of a snapshot as read from disk, before conversion. Each Reader
+ * subclasses this to hold its own raw columns.
+ */
+struct raw_snapshot {
+	virtual ~raw_snapshot();
+	int snapshot = 0;
+};
+
+/**
+ * Base class for readers of merger tree formats. Reading happens in two
+ * phases: read_raw() performs all the I/O, and convert() turns the raw data
+ * into SURFS rows. This allows I/O (which for HDF5 must be serialised) to
+ * overlap with the conversion of a different snapshot.
+ */
 class Reader {
 
 public:
@@ -42,12 +59,30 @@ public:
 	virtual ~Reader() = 0;
 
 	/**
-	 * Reads all the subhalos for a given snapshot
+	 * Reads the raw data for a given snapshot from disk
+	 *
+	 * @param snapshot The snapshot number
+	 * @return The raw data of the snapshot
+	 */
+	virtual std::unique_ptr<raw_snapshot> read_raw(int snapshot) = 0;
+
+	/**
+	 * Converts the raw data of a snapshot into SURFS rows. Snapshots must be
+	 * converted in decreasing order, since information from later snapshots
+	 * can be required.
+	 *
+	 * @param raw The raw data, as returned by read_raw()
+	 * @return The SURFS rows of the snapshot
+	 */
+	virtual surfs_rows convert(raw_snapshot &raw) = 0;
+
+	/**
+	 * Reads and converts all the subhalos for a given snapshot
 	 *
 	 * @param snapshot The snapshot number
-	 * @return A list of populated Subhalos
+	 * @return The SURFS rows of the snapshot
 	 */
-	virtual const std::vector<Subhalo> read_subhalos(int snapshot) = 0;
+	surfs_rows read_subhalos(int snapshot);
 
 };
 
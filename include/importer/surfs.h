@@ -0,0 +1,119 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * SURFS-layout rows and writer class definitions
+ */
+
+#ifndef SHARK_IMPORTER_SURFS
+#define SHARK_IMPORTER_SURFS
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "components.h"
+
+namespace H5 {
+class H5File;
+}
+
+namespace shark {
+
+namespace importer {
+
+/**
+ * The SURFS merger tree columns of a number of subhalos, one value per
+ * subhalo (three, in row-major order, for vector quantities). These are the
+ * columns read by shark's SURFSReader.
+ */
+struct surfs_rows {
+
+	std::vector<Subhalo::id_t> nodeIndex;
+	std::vector<Subhalo::id_t> descendantIndex;
+	std::vector<Halo::id_t> hostIndex;
+	std::vector<Halo::id_t> descendantHost;
+	std::vector<int> snapshotNumber;
+	std::vector<float> nodeMass;
+	std::vector<float> maximumCircularVelocity;
+	std::vector<float> position;
+	std::vector<float> velocity;
+	std::vector<float> angularMomentum;
+	std::vector<int> isMainProgenitor;
+	std::vector<int> isDHaloCentre;
+	std::vector<int> isInterpolated;
+
+	/// Resizes all columns to hold @p n subhalos
+	void resize(std::size_t n);
+
+	/// @return The number of subhalos in these rows
+	std::size_t size() const
+	{
+		return nodeIndex.size();
+	}
+};
+
+/**
+ * Streams SURFS rows into a single SURFS-layout merger tree file, one
+ * snapshot at a time, so no more than a snapshot needs to be held in memory.
+ *
+ * Columns are written into extendible, chunked datasets under the
+ * @c haloTrees group. Since the rows of each snapshot are contiguous, a
+ * @c treeIndex group with the @c snapshotNumber, @c firstRow and
+ * @c numberOfRows of each snapshot is also written, which SURFSReader uses
+ * to read only the snapshots it needs.
+ *
+ * Objects of this class are not thread-safe.
+ */
+class SURFSWriter {
+
+public:
+
+	/**
+	 * Creates the file, overwriting it if it exists
+	 *
+	 * @param filename The name of the file to write
+	 * @param chunk_size The number of rows of each chunk of the datasets
+	 * @param n_files The number of files the trees are split into
+	 */
+	SURFSWriter(const std::string &filename, unsigned long chunk_size, unsigned int n_files = 1);
+	~SURFSWriter();
+
+	/**
+	 * Appends the rows of a snapshot to the file
+	 *
+	 * @param snapshot The snapshot the rows belong to
+	 * @param rows The rows to append
+	 */
+	void append(int snapshot, const surfs_rows &rows);
+
+private:
+	std::unique_ptr<H5::H5File> file;
+	std::int64_t n_rows = 0;
+};
+
+}  // namespace importer
+
+}  // namespace shark
+
+#endif // SHARK_IMPORTER_SURFS
@@ -26,8 +26,10 @@
 #ifndef SHARK_IMPORTER_VELOCIRAPTOR
 #define SHARK_IMPORTER_VELOCIRAPTOR
 
-#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "importer/descendants.h"
 #include "importer/reader.h"
@@ -43,22 +45,28 @@ public:
 	/**
 	 * Constructor.
 	 *
+	 * @param descendant_reader The reader for the descendants information
 	 * @param trees_dir Directory where all tree files are located
+	 * @param threads The number of threads used to convert snapshots
 	 */
-	VELOCIraptorReader(std::shared_ptr<DescendantReader> &descendant_reader, const std::string &trees_dir);
+	VELOCIraptorReader(std::shared_ptr<DescendantReader> &descendant_reader, const std::string &trees_dir, unsigned int threads = 1);
 
-	virtual const std::vector<Subhalo> read_subhalos(int snapshot) override;
+	std::unique_ptr<raw_snapshot> read_raw(int snapshot) override;
+	surfs_rows convert(raw_snapshot &raw) override;
 
 private:
 
 	// Indexed by halo_id
-	std::map<long, descendants_data_t> descendants_data;
+	std::unordered_map<long, descendants_data_t> descendants_data;
+
+	// The host of each subhalo of the last converted snapshot, indexed by
+	// subhalo id, used to find the descendantHost of the next one
+	std::unordered_map<Subhalo::id_t, Halo::id_t> hosts;
 
-	std::string descendants_file;
 	std::string trees_dir;
+	unsigned int threads;
 
 	const std::string get_filename(int snapshot, int batch);
-	const std::vector<Subhalo> read_subhalos_batch(int snapshot, int batch);
 };
 
 }  // namespace importer
@@ -23,7 +23,10 @@
  * Integrator class headers
  */
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <vector>
 
 #include <gsl/gsl_integration.h>
 
@@ -32,6 +35,22 @@
 
 namespace shark {
 
+namespace detail {
+
+/// Nodes and weights of the 21-point Kronrod rule and its embedded 10-point
+/// Gauss rule, as used by GSL_INTEG_GAUSS21
+struct gauss_kronrod21 {
+	static constexpr std::size_t n_points = 21;
+	static const double xgk[11];
+	static const double wg[5];
+	static const double wgk[11];
+};
+
+/// Estimates the error of a Gauss-Kronrod integration like GSL does
+double rescale_error(double err, double result_abs, double result_asc);
+
+}  // namespace detail
+
 ///
 /// A class that integrates functions through different ranges
 ///
@@ -41,6 +60,12 @@ public:
 
 	typedef double (*func_t)(double x, void *);
 
+	///
+	/// A vector-valued function, writing the value of each of its
+	/// components at `x` into its last argument
+	///
+	typedef void (*vector_func_t)(double x, void *, double f[]);
+
 	///
 	/// Creates a new Integrator that will integrate using at most
 	/// `max_intervals` intervals internally.
@@ -60,6 +85,53 @@ public:
 	///
 	double integrate(func_t f, void *params, double from, double to, double epsabs, double epsrel);
 
+	///
+	/// Like integrate(), but GSL errors are not raised through the GSL error
+	/// handler. The GSL error code of the integration (GSL_SUCCESS if it
+	/// succeeded) is returned instead, and the best estimate found is
+	/// written into `result` regardless.
+	///
+	int try_integrate(func_t f, void *params, double from, double to, double epsabs, double epsrel, double &result);
+
+	///
+	/// Integrates the `n` components of the vector-valued function `f` with
+	/// parameters `params` between `from` and `to`, writing the integrals
+	/// into `result`. All components are integrated together over the same
+	/// adaptively-chosen intervals, so each evaluation of `f` is shared by all
+	/// of them, using the same Gauss-Kronrod rule of integrate(). The
+	/// integration finishes when all components meet the error tolerances.
+	///
+	/// @throws gsl_error with GSL_EMAXITER if the tolerances can't be met
+	/// within the maximum number of intervals
+	///
+	void integrate(vector_func_t f, void *params, std::size_t n, double from, double to, double epsabs, double epsrel, double result[]);
+
+	///
+	/// Like the vector integrate(), but returns GSL_EMAXITER instead of
+	/// throwing if the tolerances can't be met, and GSL_SUCCESS otherwise.
+	/// `result` holds the best estimates found regardless.
+	///
+	int try_integrate(vector_func_t f, void *params, std::size_t n, double from, double to, double epsabs, double epsrel, double result[]);
+
+	///
+	/// Integrates the `n` components of a function between `from` and `to`
+	/// with a single application of the 21-point Gauss-Kronrod rule, writing
+	/// the integrals into `result`. Suited for smooth integrands, which can
+	/// be integrated this way without the overhead of adaptive quadrature.
+	///
+	/// The integrand is a batch function, called only once with all the
+	/// nodes of the rule as `f(const double x[], std::size_t n_points, double values[])`
+	/// and writing component `c` of node `i` into `values[c * n_points + i]`.
+	/// Being a template parameter it can be inlined, and evaluate all nodes
+	/// in vectorisable loops.
+	///
+	/// @return Whether the estimated error of all components is within
+	/// tolerances. If not, callers should probably fall back to an adaptive
+	/// integration.
+	///
+	template <typename BatchFunction>
+	bool integrate_fixed(BatchFunction &&f, std::size_t n, double from, double to, double epsabs, double epsrel, double result[]);
+
 	///
 	/// Returns the number of internal intervals used during all integrations
 	/// so far, or since the last call to reset_num_intervals.
@@ -73,14 +145,95 @@ public:
 	///
 	void reset_num_intervals();
 
+	///
+	/// Returns the maximum number of intervals this Integrator uses
+	///
+	std::size_t get_max_intervals() const {
+		return max_intervals;
+	}
+
 private:
 	std::unique_ptr<gsl_integration_workspace> workspace;
 	size_t max_intervals;
 	unsigned long int num_intervals;
 
+	// Scratch space for vector integrations: per-interval bounds, and
+	// per-interval, per-component results and errors
+	std::vector<double> lower_bounds;
+	std::vector<double> upper_bounds;
+	std::vector<double> interval_results;
+	std::vector<double> interval_errors;
+	std::vector<double> f_values;
+	std::vector<double> fixed_values;
+
 	void init_gsl_objects();
+	void gauss_kronrod(vector_func_t f, void *params, std::size_t n, double a, double b, double result[], double error[]);
 };
 
+///
+/// Returns the Integrator of the calling thread that uses at most
+/// `max_intervals` intervals, creating it on first use. These per-thread
+/// Integrators form a pool that classes performing integrations can borrow
+/// from instead of owning one: copying them then doesn't allocate new GSL
+/// workspaces, and all objects used by a thread reuse the same workspace.
+/// The returned Integrator must therefore not be used by other threads.
+///
+Integrator &thread_integrator(std::size_t max_intervals);
+
+template <typename BatchFunction>
+bool Integrator::integrate_fixed(BatchFunction &&f, std::size_t n, double from, double to, double epsabs, double epsrel, double result[])
+{
+	using rule = detail::gauss_kronrod21;
+	constexpr std::size_t n_points = rule::n_points;
+	constexpr std::size_t n_pairs = n_points / 2;
+
+	// Nodes go from left to right, with the center in the middle
+	const double center = (from + to) / 2;
+	const double half_length = (to - from) / 2;
+	double x[n_points];
+	for (std::size_t j = 0; j != n_pairs; j++) {
+		x[j] = center - half_length * rule::xgk[j];
+		x[n_points - 1 - j] = center + half_length * rule::xgk[j];
+	}
+	x[n_pairs] = center;
+
+	fixed_values.resize(n * n_points);
+	f(x, n_points, fixed_values.data());
+	num_intervals++;
+
+	bool converged = true;
+	for (std::size_t c = 0; c != n; c++) {
+		const double *values = &fixed_values[c * n_points];
+		double fc = values[n_pairs];
+		double result_gauss = 0;
+		double result_kronrod = fc * rule::wgk[n_pairs];
+		double result_abs = std::abs(result_kronrod);
+		for (std::size_t j = 0; j != n_pairs; j++) {
+			double f1 = values[j];
+			double f2 = values[n_points - 1 - j];
+			if (j % 2 == 1) {
+				result_gauss += rule::wg[j / 2] * (f1 + f2);
+			}
+			result_kronrod += rule::wgk[j] * (f1 + f2);
+			result_abs += rule::wgk[j] * (std::abs(f1) + std::abs(f2));
+		}
+
+		double mean = result_kronrod / 2;
+		double result_asc = rule::wgk[n_pairs] * std::abs(fc - mean);
+		for (std::size_t j = 0; j != n_pairs; j++) {
+			result_asc += rule::wgk[j] * (std::abs(values[j] - mean) + std::abs(values[n_points - 1 - j] - mean));
+		}
+
+		result[c] = result_kronrod * half_length;
+		double error = detail::rescale_error((result_kronrod - result_gauss) * half_length,
+		                                     result_abs * std::abs(half_length),
+		                                     result_asc * std::abs(half_length));
+		converged = converged && error <= std::max(epsabs, epsrel * std::abs(result[c]));
+	}
+
+	return converged;
+}
+
 }  // namespace shark
 
 #endif // SHARK_INTEGRATOR_H_
\ No newline at end of file
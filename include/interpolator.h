@@ -65,6 +65,56 @@ private:
 	const gsl_interp2d_type *to_gsl(InterpolatorType type) const;
 };
 
+/**
+ * A bilinear 2D interpolator specialised for small, regular grids.
+ *
+ * It gives the same results as a BILINEAR Interpolator, but finds the grid
+ * cell of each point in constant time using index maps precomputed over each
+ * axis instead of binary searches, and holds no mutable state, so can be
+ * shared across threads. Values are stored contiguously, and can be
+ * evaluated for many points at once with the batch version of get().
+ */
+class GridInterpolator {
+
+public:
+
+	/// Same arguments as Interpolator's: values are given for all x
+	/// for the first y, then for the second y, and so on
+	GridInterpolator(std::vector<double> xvals, std::vector<double> yvals, std::vector<double> zvals);
+
+	/// Returns the interpolated value at (x, y), where both coordinates are
+	/// first truncated to the grid limits
+	double get(double x, double y) const;
+
+	/// Writes into out the interpolated values at the n points given by x and y
+	void get(const double *x, const double *y, double *out, std::size_t n) const;
+
+private:
+
+	/// An axis of the grid, together with its index map
+	class axis {
+	public:
+		axis(std::vector<double> values);
+
+		std::size_t size() const { return values.size(); }
+
+		/// Truncates v to the limits of the axis, and returns the index i
+		/// of the grid cell [values[i], values[i + 1]] containing it,
+		/// together with its relative position within the cell
+		std::size_t cell(double v, double &t) const;
+
+	private:
+		std::vector<double> values;
+		double inv_bucket_width;
+		/// For each bucket of equal width along the axis, the first cell it overlaps
+		std::vector<std::size_t> buckets;
+	};
+
+	axis x;
+	axis y;
+	std::vector<double> z;
+};
+
 }  // namespace shark
 
 #endif // SHARK_INTERPOLATION_H_
\ No newline at end of file
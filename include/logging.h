@@ -26,15 +26,92 @@
 #ifndef SHARK_LOGGING_H_
 #define SHARK_LOGGING_H_
 
+#include <atomic>
+#include <memory>
+#include <string>
+
 #define BOOST_LOG_DYN_LINK 1
 #include <boost/log/expressions/keyword.hpp>
 #include <boost/log/trivial.hpp>
 
-#define LOG(lvl) BOOST_LOG_TRIVIAL(lvl)
-
 /// The logging level set on this application
 extern ::boost::log::trivial::severity_level logging_level;
 
 #define LOG_ENABLED(lvl) (::boost::log::trivial::severity_level::lvl >= logging_level)
 
+// Disabled levels are discarded before creating a record or evaluating
+// the streamed expressions
+#define LOG(lvl) if (!LOG_ENABLED(lvl)) {} else BOOST_LOG_TRIVIAL(lvl)
+
+/**
+ * Like LOG, but for messages that can be repeated for many galaxies or
+ * halos. Only the first messages of each call site are written until
+ * shark::report_suppressed_log_messages is called; the rest are counted
+ * without being formatted.
+ */
+#define LOG_LIMITED(lvl) \
+	if (!LOG_ENABLED(lvl) || !([]() -> ::shark::LogSite & { \
+		static ::shark::LogSite site(__FILE__, __LINE__); \
+		return site; \
+	}()).allow()) {} else BOOST_LOG_TRIVIAL(lvl)
+
+namespace shark {
+
+/// A place in the code logging through LOG_LIMITED
+class LogSite {
+
+public:
+
+	/// Messages written by each site between reports
+	static constexpr unsigned long max_messages = 10;
+
+	LogSite(const char *file, int line);
+
+	/// Whether a new message from this site should be written
+	bool allow()
+	{
+		return messages.fetch_add(1, std::memory_order_relaxed) < max_messages;
+	}
+
+	/// Returns the number of messages suppressed since the last call
+	unsigned long take_suppressed();
+
+	const char *file;
+	int line;
+
+private:
+	std::atomic<unsigned long> messages {0};
+};
+
+/**
+ * Logs how many messages each LOG_LIMITED site suppressed since the previous
+ * call, allowing them to write messages again.
+ *
+ * @param period A description of the period being reported, e.g.,
+ *  "during snapshot 10"
+ */
+void report_suppressed_log_messages(const std::string &period);
+
+/**
+ * Writes log records to the console from a background thread, so threads
+ * don't wait on the console or each other to log. Records are queued in
+ * order, and those still queued are written when this object is flushed or
+ * destroyed.
+ */
+class AsyncLogging {
+
+public:
+	AsyncLogging();
+	~AsyncLogging();
+
+	/// Waits until all queued records have been written
+	void flush();
+
+private:
+	class impl;
+	std::unique_ptr<impl> pimpl;
+};
+
+}  // namespace shark
+
 #endif /* SHARK_LOGGING_H_ */
@@ -0,0 +1,77 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Read-only memory-mapped files
+ */
+
+#ifndef SHARK_MAPPED_FILE_H_
+#define SHARK_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace shark {
+
+/**
+ * A file whose whole contents are mapped read-only into memory, so they can
+ * be accessed (e.g., parsed by many threads at once) without copying them
+ * into user buffers first. On platforms without mmap the file is instead
+ * read into memory when opened.
+ */
+class MappedFile {
+
+public:
+
+	/**
+	 * Maps the contents of @p filename into memory
+	 *
+	 * @param filename The name of the file to map
+	 */
+	explicit MappedFile(const std::string &filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	/// @return A pointer to the first byte of the file
+	const char *data() const
+	{
+		return _data;
+	}
+
+	/// @return The size of the file, in bytes
+	std::size_t size() const
+	{
+		return _size;
+	}
+
+private:
+	const char *_data;
+	std::size_t _size;
+	std::vector<char> buffer;
+};
+
+}  // namespace shark
+
+#endif // SHARK_MAPPED_FILE_H_
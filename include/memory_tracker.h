@@ -0,0 +1,127 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Per-phase memory usage tracking, and memory budget enforcement
+ */
+
+#ifndef SHARK_MEMORY_TRACKER_H
+#define SHARK_MEMORY_TRACKER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace shark {
+
+/**
+ * The memory used by shark at the end of a given phase of the execution
+ */
+struct MemoryUsage {
+
+	/// The name of the phase
+	std::string phase;
+
+	/// The resident set size at the end of the phase [bytes]
+	std::size_t rss;
+
+	/// The peak resident set size up to the end of the phase [bytes]
+	std::size_t peak_rss;
+
+	/// The memory backed by huge pages at the end of the phase [bytes].
+	/// Explicit huge pages are not part of the resident set size
+	std::size_t huge_pages;
+};
+
+/**
+ * Records the memory used by shark at the end of each phase of the execution
+ * (reading, tree building, the evolution of each snapshot, etc.), and checks
+ * it against an optional memory budget.
+ *
+ * Where the budget is exceeded, a memory_budget_exceeded exception is thrown
+ * with an estimate of the memory that would be needed to finish the
+ * execution, so that jobs fail early and with a clear message instead of
+ * being killed once the machine runs out of memory.
+ */
+class MemoryTracker {
+
+public:
+
+	/**
+	 * @param budget The maximum amount of memory that can be used [bytes].
+	 * 0 means there is no budget.
+	 */
+	explicit MemoryTracker(std::size_t budget = 0);
+
+	/**
+	 * Records the memory used at the end of @p phase.
+	 *
+	 * @param phase The name of the phase that just finished
+	 * @param remaining_snapshots For phases ending the evolution of a
+	 * snapshot, the number of snapshots that still need to be evolved. They
+	 * are used to extrapolate the memory growth observed so far. Negative if
+	 * @p phase is not the end of the evolution of a snapshot.
+	 * @return The memory usage recorded for @p phase
+	 * @throws memory_budget_exceeded if the peak memory usage is above the budget
+	 */
+	const MemoryUsage &record(const std::string &phase, int remaining_snapshots = -1);
+
+	/**
+	 * Returns the peak memory expected after evolving @p remaining_snapshots
+	 * more snapshots, assuming memory keeps growing at the rate observed
+	 * between the snapshots that have been recorded so far.
+	 */
+	std::size_t projected_peak_rss(int remaining_snapshots) const;
+
+	/// Whether @p amount of memory is within the budget, if any
+	bool within_budget(std::size_t amount) const
+	{
+		return budget == 0 || amount <= budget;
+	}
+
+	/// The memory budget [bytes], or 0 if there is no budget
+	std::size_t get_budget() const
+	{
+		return budget;
+	}
+
+	/// All recorded phases, in the order they were recorded
+	const std::vector<MemoryUsage> &get_phases() const
+	{
+		return phases;
+	}
+
+private:
+	std::size_t budget;
+	std::vector<MemoryUsage> phases;
+
+	/// RSS at the end of the first and last snapshots recorded, and how many
+	std::size_t first_snapshot_rss = 0;
+	std::size_t last_snapshot_rss = 0;
+	unsigned int n_snapshots = 0;
+
+	bool projection_warned = false;
+};
+
+}  // namespace shark
+
+#endif // SHARK_MEMORY_TRACKER_H
@@ -24,12 +24,19 @@
 #ifndef INCLUDE_MERGER_TREE_READER_H_
 #define INCLUDE_MERGER_TREE_READER_H_
 
+#include <functional>
+#include <limits>
+#include <future>
 #include <map>
 #include <memory>
 
+#include "arena.h"
 #include "components.h"
 #include "dark_matter_halos.h"
+#include "memory_tracker.h"
 #include "simulation.h"
+#include "spatial_selection.h"
+#include "hdf5/reader.h"
 
 namespace shark {
 
@@ -41,20 +48,109 @@ public:
 	 * Constructor.
 	 *
 	 * @param trees_dir Directory where all tree files are located
+	 * @param arena_allocation Whether Subhalos and Halos are allocated from
+	 * per-snapshot arenas
+	 * @param memory_tracker If given, where the memory used after each
+	 * reading phase is recorded
+	 * @param batches_in_flight The maximum number of batch files read in the
+	 * background while subhalos and halos of a previous one are created. 0
+	 * means files are read synchronously.
+	 * @param chunk_size The maximum number of rows of a batch file read at a
+	 * time. Each chunk is turned into subhalos before the next one is read.
+	 * 0 means files are read as a whole.
+	 * @param spatial_selection The region where the root halos of the merger
+	 * trees that are read lie. Only the rows of these trees are read.
 	 */
-	SURFSReader(const std::string &prefix, const DarkMatterHalosPtr &dark_matter_halos, const SimulationParameters &sim_params, unsigned int threads);
+	SURFSReader(const std::string &prefix, const DarkMatterHalosPtr &dark_matter_halos, const SimulationParameters &sim_params, unsigned int threads, bool arena_allocation = false, MemoryTracker *memory_tracker = nullptr, unsigned int batches_in_flight = 0, unsigned long chunk_size = 0, const SpatialSelection &spatial_selection = SpatialSelection());
 
-	const std::vector<HaloPtr> read_halos(std::vector<unsigned int> batches);
+	/**
+	 * Reads the halos of the given batches
+	 *
+	 * @param batches The batch files to read
+	 * @param last_snapshot Halos after this snapshot are not needed. If this
+	 * or simulation.min_snapshot narrow down the snapshots present in the
+	 * files, only the rows of the needed snapshots are read
+	 * @param root_snapshot The snapshot of the root halos of merger trees,
+	 * whose positions decide which trees a spatial selection reads. -1 means
+	 * the last snapshot read
+	 * @return The halos read from all batches
+	 */
+	const std::vector<HaloPtr> read_halos(std::vector<unsigned int> batches, int last_snapshot = std::numeric_limits<int>::max(), int root_snapshot = -1);
+
+	/**
+	 * @param batch The batch number
+	 * @return The name of the file containing the given batch
+	 */
+	const std::string get_filename(int batch);
+
+	/**
+	 * @param prefix The prefix of all tree files, as in
+	 * simulation.tree_files_prefix
+	 * @param batch The batch number
+	 * @return The name of the file containing the given batch
+	 */
+	static std::string get_filename(const std::string &prefix, int batch);
 
 private:
 	std::string prefix;
 	DarkMatterHalosPtr dark_matter_halos;
 	SimulationParameters simulation_params;
 	unsigned int threads;
+	bool arena_allocation;
+	MemoryTracker *memory_tracker;
+	unsigned int batches_in_flight;
+	unsigned long chunk_size;
+	SpatialSelection spatial_selection;
 
-	const std::vector<HaloPtr> read_halos(unsigned int batch);
-	const std::vector<SubhaloPtr> read_subhalos(unsigned int batch);
-	const std::string get_filename(int batch);
+	/**
+	 * The raw subhalo data of some rows of a batch file. The datasets
+	 * needed to calculate derived properties are read first, so these
+	 * calculations can overlap with the reading of the rest.
+	 */
+	struct raw_chunk {
+
+		raw_chunk(unsigned int batch, const std::string &filename, std::vector<hdf5::row_range> &&rows, unsigned long count) :
+			batch(batch), filename(filename), rows(std::move(rows)), count(count),
+			derived_inputs_ready(derived_inputs_read.get_future()),
+			all_ready(all_read.get_future())
+		{}
+
+		unsigned int batch;
+		std::string filename;
+		std::vector<hdf5::row_range> rows;
+		unsigned long count;
+
+		// Needed to calculate derived properties
+		std::vector<float> Mvir;
+		std::vector<int> snap;
+		std::vector<float> L;
+
+		std::vector<float> position;
+		std::vector<float> velocity;
+		std::vector<float> Vcirc;
+		std::vector<Subhalo::id_t> nodeIndex;
+		std::vector<Subhalo::id_t> descIndex;
+		std::vector<Halo::id_t> hostIndex;
+		std::vector<Halo::id_t> descHost;
+		std::vector<int> IsMain;
+		std::vector<int> IsCentre;
+		std::vector<int> IsInterpolated;
+
+		std::promise<void> derived_inputs_read;
+		std::promise<void> all_read;
+		std::future<void> derived_inputs_ready;
+		std::future<void> all_ready;
+	};
+
+	typedef std::function<std::shared_ptr<raw_chunk>()> chunk_source;
+
+	static void read_raw_chunk(raw_chunk &raw);
+
+	void record_memory(const std::string &phase, unsigned int batch);
+	std::vector<hdf5::row_range> select_tree_rows(const hdf5::Reader &batch_file, const std::vector<hdf5::row_range> &rows, int root_snapshot);
+	const std::vector<HaloPtr> read_halos(unsigned int batch, unsigned long n_subhalos, unsigned int n_chunks, const chunk_source &next_chunk);
+	const std::vector<SubhaloPtr> read_subhalos(unsigned int batch, unsigned long n_subhalos, unsigned int n_chunks, const chunk_source &next_chunk);
+	void create_subhalos(raw_chunk &raw, std::vector<SubhaloPtr> &subhalos, std::vector<ArenaSet<int>> &t_arenas);
 	const std::vector<Subhalo> read_subhalos_batch(int batch);
 
 
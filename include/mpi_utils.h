@@ -0,0 +1,119 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * MPI-related utilities. When shark is compiled without MPI support these
+ * behave as if a single process (rank 0 of 1) was running, so callers don't
+ * need to deal with the presence or absence of MPI themselves.
+ */
+
+#ifndef SHARK_MPI_UTILS_H_
+#define SHARK_MPI_UTILS_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "components.h"
+
+namespace shark {
+
+namespace mpi {
+
+/**
+ * Initialises MPI on construction and finalises it on destruction.
+ * Only one instance should exist during the lifetime of the program.
+ */
+class Environment {
+
+public:
+	Environment(int &argc, char **&argv);
+	~Environment();
+
+	Environment(const Environment &) = delete;
+	Environment &operator=(const Environment &) = delete;
+};
+
+/// @return The rank of this process
+int rank();
+
+/// @return The number of processes taking part in this execution
+int size();
+
+/**
+ * Aborts all processes taking part in this execution, so those that are
+ * waiting on a collective operation don't wait forever on a failed process.
+ *
+ * @param error_code The error code to abort with
+ */
+void abort(int error_code);
+
+/**
+ * Returns the simulation batches that process @p rank out of @p size should
+ * handle, distributing @p batches in a round-robin fashion.
+ *
+ * @param batches All simulation batches to process
+ * @param rank The rank of the process
+ * @param size The total number of processes
+ * @return The batches assigned to @p rank
+ */
+std::vector<unsigned int> distribute_batches(const std::vector<unsigned int> &batches, int rank, int size);
+
+/**
+ * Sums @p all_baryons across all processes, leaving the result on all of them.
+ * This is a collective operation.
+ *
+ * @param all_baryons The baryon amounts tracked by this process
+ */
+void sum_all(TotalBaryon &all_baryons);
+
+/**
+ * Sums @p value across all processes. This is a collective operation.
+ *
+ * @param value The value given by this process
+ * @return The sum of the values given by all processes
+ */
+std::size_t sum_all(std::size_t value);
+
+/**
+ * Gathers @p value from all processes. This is a collective operation.
+ *
+ * @param value The value given by this process
+ * @return The values given by all processes, in rank order
+ */
+std::vector<double> gather_all(double value);
+
+/**
+ * Sends a buffer to each process and receives one from each of them.
+ * This is a collective operation.
+ *
+ * @param outgoing The bytes to send to each process, in rank order, empty
+ * for processes nothing is sent to
+ * @return The bytes received from each process, in rank order
+ */
+std::vector<std::string> exchange(const std::vector<std::string> &outgoing);
+
+}  // namespace mpi
+
+}  // namespace shark
+
+#endif // SHARK_MPI_UTILS_H_
@@ -0,0 +1,107 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Placement of threads and merger trees across CPUs and NUMA nodes
+ */
+
+#ifndef SHARK_NUMA_H_
+#define SHARK_NUMA_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "components.h"
+
+namespace shark {
+
+/// The CPU and NUMA node a thread runs on
+struct ThreadPlacement {
+	int cpu;
+	int node;
+};
+
+/**
+ * Binds each of @p threads OpenMP threads to the CPUs of a NUMA node, so the
+ * memory it first touches stays local to it. Threads are spread evenly over
+ * the CPUs this process can run on, with consecutive threads sharing nodes.
+ * Threads are bound only if the OpenMP runtime doesn't bind them itself
+ * (i.e., if OMP_PROC_BIND isn't set); otherwise their nodes are only reported.
+ *
+ * Binding is only supported on Linux; elsewhere threads are left unbound.
+ *
+ * @param threads The number of threads
+ * @return The placement of each thread, or nothing if it is unknown
+ */
+std::vector<ThreadPlacement> pin_threads(unsigned int threads);
+
+/**
+ * An assignment of merger trees to threads, each of which is given a
+ * contiguous range of trees of about the same total cost. Structures of a
+ * tree are then created, evolved and released by the same thread, which
+ * keeps them in memory local to it.
+ */
+class TreeAssignment {
+
+public:
+
+	TreeAssignment() = default;
+
+	/**
+	 * Creates an assignment of trees with the given @p costs to @p threads
+	 * threads
+	 *
+	 * @param costs The cost of each tree
+	 * @param threads The number of threads
+	 */
+	TreeAssignment(const std::vector<std::size_t> &costs, unsigned int threads);
+
+	/// @return The cost of each of @p merger_trees, which is its number of halos
+	static std::vector<std::size_t> tree_costs(const std::vector<MergerTreePtr> &merger_trees);
+
+	/// @return Whether trees have been assigned to any thread
+	bool empty() const {
+		return offsets.empty();
+	}
+
+	/// @return The number of threads trees are assigned to
+	unsigned int threads() const {
+		return empty() ? 0 : static_cast<unsigned int>(offsets.size() - 1);
+	}
+
+	/// @return The first tree of @p thread
+	std::size_t begin(unsigned int thread) const {
+		return offsets[thread];
+	}
+
+	/// @return One past the last tree of @p thread
+	std::size_t end(unsigned int thread) const {
+		return offsets[thread + 1];
+	}
+
+private:
+	std::vector<std::size_t> offsets;
+};
+
+}  // namespace shark
+
+#endif // SHARK_NUMA_H_
@@ -0,0 +1,131 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Per-galaxy ODE cost statistics
+ */
+
+#ifndef SHARK_ODE_COSTS_H_
+#define SHARK_ODE_COSTS_H_
+
+#include <array>
+#include <ostream>
+#include <vector>
+
+namespace shark {
+
+/**
+ * A histogram of the number of ODE evaluations that solving the system of
+ * each galaxy took. Bin 0 counts galaxies that took no evaluations, and bin
+ * `i > 0` counts those that took between `2^(i-1)` and `2^i - 1`.
+ */
+class ODECostHistogram {
+
+public:
+	static constexpr std::size_t n_bins = 40;
+
+	/// Counts one more galaxy that took @p evaluations ODE evaluations
+	void add(unsigned long int evaluations);
+
+	/// Adds all counts of @p other into this histogram
+	ODECostHistogram &operator+=(const ODECostHistogram &other);
+
+	/// Sets all counts back to zero
+	void reset();
+
+	/// @return the count of bin @p i
+	unsigned long int operator[](std::size_t i) const {
+		return bins[i];
+	}
+
+	/// @return The bin where @p evaluations are counted
+	static std::size_t bin(unsigned long int evaluations);
+
+private:
+	std::array<unsigned long int, n_bins> bins {};
+};
+
+/// Writes the non-empty bins of @p histogram as a single line
+std::ostream &operator<<(std::ostream &os, const ODECostHistogram &histogram);
+
+/**
+ * The ODE system of a galaxy that was expensive to solve, with everything
+ * needed to solve it again.
+ */
+struct ODECostRecord {
+	unsigned long int evaluations;
+	long long galaxy_id;
+	bool starburst;
+	/// The solver parameters: rgas, rstar, mcoolrate, jcold_halo, delta_t,
+	/// redshift, vsubh and vgal
+	std::array<double, 8> params;
+	/// The initial state, as given by PhysicalModel::from_galaxy
+	std::vector<double> y0;
+};
+
+/**
+ * Keeps the N most expensive ODE systems that have been added to it.
+ */
+class ODECostRanking {
+
+public:
+	explicit ODECostRanking(std::size_t capacity = 0) :
+		capacity(capacity)
+	{
+		// no-op
+	}
+
+	/// Whether a system with this many evaluations would enter the ranking
+	bool accepts(unsigned long int evaluations) const;
+
+	/// Adds @p record to the ranking, if it is expensive enough
+	void add(ODECostRecord record);
+
+	/// Adds all records of @p other into this ranking
+	ODECostRanking &operator+=(const ODECostRanking &other);
+
+	/// Removes all records
+	void reset();
+
+	/// @return The records in this ranking, the most expensive first
+	std::vector<ODECostRecord> sorted() const;
+
+	std::size_t get_capacity() const {
+		return capacity;
+	}
+
+	/// Writes the header of the CSV-formatted records, for systems of
+	/// dimension @p dimension
+	static void write_csv_header(std::ostream &os, std::size_t dimension);
+
+	/// Writes the records of this ranking as CSV lines for @p snapshot
+	void write_csv(std::ostream &os, int snapshot) const;
+
+private:
+	std::size_t capacity;
+	// A min-heap on evaluations, so the cheapest record is the first out
+	std::vector<ODECostRecord> records {};
+};
+
+}  // namespace shark
+
+#endif // SHARK_ODE_COSTS_H_
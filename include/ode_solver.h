@@ -56,6 +56,18 @@ public:
 	 */
 	typedef int (*ode_evaluator)(double, const double y[], double f[], void *);
 
+	/**
+	 * The definition that ODE Jacobians must follow, as required by GSL
+	 * implicit steppers
+	 * @param t
+	 * @param y
+	 * @param dfdy The Jacobian matrix, in row-major order
+	 * @param dfdt The partial derivatives of the system with respect to `t`
+	 * @param A pointer to any user-provided data
+	 * @return
+	 */
+	typedef int (*ode_jacobian)(double t, const double y[], double *dfdy, double dfdt[], void *);
+
 	/**
 	 * Creates a new ODESolver
 	 *
@@ -84,6 +96,33 @@ public:
 	ODESolver(const std::vector<double> &y0, double t0, double delta_t,
 	          double precision, const std::shared_ptr<gsl_odeiv2_system> &ode_system);
 
+	/**
+	 * Creates a new ODESolver that can be reused to solve many different
+	 * systems of the same dimension. Initial values, time step and user data
+	 * are given on each call to `evolve(double[], double, void *)`, which
+	 * reuses the same internal GSL driver instead of allocating a new one.
+	 *
+	 * @param dimension The number of components of the ODE systems to solve
+	 * @param precision The precision to use for the adaptive step sizes.
+	 * @param evaluator The function evaluating the systems at time `t`
+	 */
+	ODESolver(std::size_t dimension, double precision, ode_evaluator evaluator);
+
+	/**
+	 * Like ODESolver(std::size_t, double, ode_evaluator), but letting users
+	 * choose the GSL stepper to use. Implicit steppers (e.g.,
+	 * `gsl_odeiv2_step_msbdf` or `gsl_odeiv2_step_bsimp`) need the Jacobian
+	 * of the system, which can be null for explicit ones.
+	 *
+	 * @param dimension The number of components of the ODE systems to solve
+	 * @param precision The precision to use for the adaptive step sizes.
+	 * @param evaluator The function evaluating the systems at time `t`
+	 * @param jacobian The function evaluating the Jacobian of the systems
+	 * @param stepper The GSL stepper to use
+	 */
+	ODESolver(std::size_t dimension, double precision, ode_evaluator evaluator,
+	          ode_jacobian jacobian, const gsl_odeiv2_step_type *stepper);
+
 	/**
 	 * Move constructor
 	 */
@@ -101,6 +140,27 @@ public:
 	 */
 	std::vector<double> evolve();
 
+	/**
+	 * Evolves the system given by the initial values `y` at `t = 0` up to
+	 * `t = delta_t`, writing the final values back into `y`.
+	 *
+	 * @param y The initial values of the system, overwritten with the final
+	 * values. It must contain as many values as the solver's dimension
+	 * @param delta_t The time up to which the system is evolved
+	 * @param params A pointer to any user-provided data for the evaluator,
+	 * used for this call only
+	 * @param h_start The initial step size. If not positive, or larger than
+	 * @p delta_t, @p delta_t is used
+	 */
+	void evolve(double y[], double delta_t, void *params, double h_start = 0);
+
+	/**
+	 * Returns the mean size of the steps taken by the last call to
+	 * `evolve(double[], double, void *, double)`, or 0 if no step was taken.
+	 * It is a good initial step size for a similar system.
+	 */
+	double mean_step() const;
+
 	/**
 	 * Returns the number of times that the internal ODE system has been
 	 * evaluated so far.
@@ -123,6 +183,8 @@ public:
 	ODESolver& operator=(ODESolver &&other);
 
 private:
+	void check_status(int status);
+
 	std::vector<double> y;
 	double t;
 	double t0;
@@ -29,17 +29,28 @@
  * version (5.0 is about to come out as of this writing), but on the one hand
  * we don't really need more at the moment, and it also means we can hit more
  * compilers.
+ *
+ * On top of the loops, a small task layer offers task groups, parallel
+ * reductions and prefix sums. Task groups use OpenMP tasks when available
+ * (OpenMP 3.0 onwards), and otherwise run their tasks as they are added.
  */
 
 #ifndef SHARK_OMP_UTILS_H_
 #define SHARK_OMP_UTILS_H_
 
+#include <algorithm>
+#include <exception>
+#include <mutex>
 #include <type_traits>
+#include <vector>
 
 #include "config.h"
 
 #ifdef SHARK_OPENMP
 #include <omp.h>
+#if defined(_OPENMP) && _OPENMP >= 200805
+#define SHARK_OPENMP_TASKS
+#endif // _OPENMP >= 200805 (3.0)
 #endif // SHARK_OPENMP
 
 namespace shark {
@@ -151,6 +162,246 @@ void omp_dynamic_for(Container &&container, int num_threads, int chunk, Callable
 	});
 }
 
+/**
+ * Calls a function once for each of @p num_threads thread indices, in a
+ * single OpenMP parallel region. When OpenMP provides all requested threads,
+ * each index is handled by the thread with that same index, so work that is
+ * always given to the same index (e.g., all work on a given set of objects)
+ * always runs in the same thread. Otherwise the available threads share the
+ * indices among them. If OpenMP support is not present all indices are
+ * handled sequentially.
+ *
+ * @param num_threads The number of thread indices
+ * @param f A callable that takes a thread index in @p [0,num_threads) and the
+ * index of the thread under which it is being executed
+ */
+template <typename Callable>
+void omp_per_thread(unsigned int num_threads, Callable &&f)
+{
+#ifdef SHARK_OPENMP
+	#pragma omp parallel num_threads(num_threads)
+	{
+		unsigned int team_size = omp_get_num_threads();
+		for (unsigned int t = omp_get_thread_num(); t < num_threads; t += team_size) {
+			f(t, detail::thread_index());
+		}
+	}
+#else
+	for (unsigned int t = 0; t < num_threads; t++) {
+		f(t, detail::thread_index());
+	}
+#endif // SHARK_OPENMP
+}
+
+/**
+ * Reduces the range @p [first,last) in parallel, with the same static
+ * scheduling as omp_static_for. Each thread accumulates its share into its
+ * own copy of @p identity, and these are then combined in thread order, so
+ * results are reproducible for a given number of threads.
+ *
+ * @param first The first number of the range
+ * @param last The last (exclusive) number of the range
+ * @param num_threads The number of threads to use for parallelization
+ * @param identity The initial value of each thread's accumulator
+ * @param accumulate A callable that takes a thread's accumulator, a single
+ * number from the range and the thread index under which it is being executed
+ * @param combine A callable that takes the final result and one of the
+ * thread's accumulators, and adds the latter to the former
+ * @return The combination of all threads' accumulators
+ */
+template <typename T, typename Integer, typename Accumulate, typename Combine>
+T omp_parallel_reduce(Integer first, Integer last, int num_threads, const T &identity, Accumulate &&accumulate, Combine &&combine)
+{
+	typedef typename std::make_signed<Integer>::type omp_iterator_t;
+	std::vector<T> partials(std::max(num_threads, 1), identity);
+	omp_static_for(first, last, num_threads, [&](omp_iterator_t it, int thread_num) {
+		accumulate(partials[thread_num], Integer(it), thread_num);
+	});
+	for (std::size_t i = 1; i < partials.size(); i++) {
+		combine(partials[0], partials[i]);
+	}
+	return std::move(partials[0]);
+}
+
+/**
+ * Like omp_parallel_reduce<T, Integer, Accumulate, Combine>(Integer, Integer, int, const T &, Accumulate &&, Combine &&),
+ * but iterating over the elements of a container with random iterators.
+ *
+ * @param container A container of elements (set, vector, etc.)
+ * @param num_threads The number of threads to use for parallelization
+ * @param identity The initial value of each thread's accumulator
+ * @param accumulate A callable that takes a thread's accumulator, a single
+ * item from the container and the thread index under which it is being executed
+ * @param combine A callable that adds a thread's accumulator to the result
+ * @return The combination of all threads' accumulators
+ */
+template <typename T, typename Container, typename Accumulate, typename Combine>
+T omp_parallel_reduce(Container &&container, int num_threads, const T &identity, Accumulate &&accumulate, Combine &&combine)
+{
+	return omp_parallel_reduce(std::size_t(0), container.size(), num_threads, identity, [&](T &partial, std::size_t i, int thread_num) {
+		accumulate(partial, container[i], thread_num);
+	}, combine);
+}
+
+/**
+ * Replaces each value of @p values with the sum of all values up to, and
+ * including, itself (i.e., an inclusive prefix sum, like std::partial_sum).
+ * Values are split into one block per thread: blocks are summed in parallel,
+ * their totals are then accumulated sequentially, and finally added to the
+ * values of the following blocks in parallel.
+ *
+ * @param values The values to sum
+ * @param num_threads The number of threads to use for parallelization
+ * @return The sum of all values
+ */
+template <typename T>
+T omp_prefix_sum(std::vector<T> &values, int num_threads)
+{
+	auto n = values.size();
+	std::size_t n_blocks = std::max(num_threads, 1);
+	if (n_blocks == 1 || n < 2 * n_blocks) {
+		T total {};
+		for (auto &value: values) {
+			total += value;
+			value = total;
+		}
+		return total;
+	}
+
+	auto block_size = (n + n_blocks - 1) / n_blocks;
+	std::vector<T> block_totals(n_blocks);
+	omp_static_for(std::size_t(0), n_blocks, num_threads, [&](std::size_t block, int thread_num) {
+		T total {};
+		for (auto i = std::min(n, block * block_size); i != std::min(n, (block + 1) * block_size); i++) {
+			total += values[i];
+			values[i] = total;
+		}
+		block_totals[block] = total;
+	});
+	T total {};
+	for (auto &block_total: block_totals) {
+		auto offset = total;
+		total += block_total;
+		block_total = offset;
+	}
+	omp_static_for(std::size_t(1), n_blocks, num_threads, [&](std::size_t block, int thread_num) {
+		for (auto i = std::min(n, block * block_size); i != std::min(n, (block + 1) * block_size); i++) {
+			values[i] += block_totals[block];
+		}
+	});
+	return total;
+}
+
+/**
+ * Runs @p f in a parallel region of @p num_threads threads, but in a single
+ * one of them, so that the tasks it adds to omp_task_group objects are run by
+ * all threads of the region. Without OpenMP task support @p f is simply
+ * called, and tasks are run as they are added.
+ *
+ * @param num_threads The number of threads running tasks
+ * @param f A callable taking no arguments
+ */
+template <typename Callable>
+void omp_task_region(int num_threads, Callable &&f)
+{
+#ifdef SHARK_OPENMP_TASKS
+	std::exception_ptr error;
+	#pragma omp parallel num_threads(num_threads)
+	{
+		#pragma omp single
+		{
+			try {
+				f();
+			} catch (...) {
+				error = std::current_exception();
+			}
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+#else
+	f();
+#endif // SHARK_OPENMP_TASKS
+}
+
+/**
+ * A group of tasks, which run concurrently to the code adding them and are
+ * waited for together. Tasks run in parallel only when added within an
+ * omp_task_region (or any other OpenMP parallel region); otherwise, and
+ * without OpenMP task support, they run as they are added. Tasks can add
+ * tasks to task groups of their own, allowing nested parallelism.
+ *
+ * The first exception thrown by a task is rethrown by wait().
+ */
+class omp_task_group {
+
+public:
+
+	omp_task_group() = default;
+	omp_task_group(const omp_task_group &) = delete;
+	omp_task_group &operator=(const omp_task_group &) = delete;
+
+	/// Waits for all tasks, but ignores their errors
+	~omp_task_group()
+	{
+		wait_all();
+	}
+
+	/**
+	 * Adds a task to this group
+	 *
+	 * @param f A callable that takes the thread index under which it is being
+	 * executed. It is copied into the task.
+	 */
+	template <typename Callable>
+	void run(Callable f)
+	{
+#ifdef SHARK_OPENMP_TASKS
+		omp_task_group *group = this;
+		#pragma omp task firstprivate(f, group)
+		group->call(f);
+#else
+		call(f);
+#endif // SHARK_OPENMP_TASKS
+	}
+
+	/// Waits for all tasks added so far, rethrowing the first error of any
+	void wait()
+	{
+		wait_all();
+		if (error) {
+			auto task_error = error;
+			error = nullptr;
+			std::rethrow_exception(task_error);
+		}
+	}
+
+private:
+	std::mutex error_mutex;
+	std::exception_ptr error;
+
+	template <typename Callable>
+	void call(Callable &f)
+	{
+		try {
+			f(detail::thread_index());
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(error_mutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+	}
+
+	void wait_all()
+	{
+#ifdef SHARK_OPENMP_TASKS
+		#pragma omp taskwait
+#endif // SHARK_OPENMP_TASKS
+	}
+};
+
 }  // namespace shark
 
 #endif /* SHARK_OMP_UTILS_H_ */
\ No newline at end of file
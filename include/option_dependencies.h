@@ -0,0 +1,85 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Declarations of which part of the evolution each option affects
+ */
+
+#ifndef SHARK_OPTION_DEPENDENCIES_H_
+#define SHARK_OPTION_DEPENDENCIES_H_
+
+#include <functional>
+#include <map>
+#include <string>
+
+#include "options.h"
+
+namespace shark {
+
+/**
+ * Declares how far back in the evolution of galaxies a change in each option
+ * can have an effect, which tells whether galaxies already evolved with some
+ * options remain valid after changing them (e.g., to branch off from a
+ * checkpoint).
+ *
+ * Options act on galaxies at all times unless declared otherwise by the
+ * parameter class loading them, which can declare that an option never
+ * affects the evolution (e.g., output options) or that it acts only on
+ * galaxies below a redshift that depends on the options themselves.
+ */
+class OptionDependencies {
+
+public:
+
+	/// A function returning the redshift below which an option acts on
+	/// galaxies when using the given options
+	typedef std::function<double(const Options &)> redshift_function;
+
+	/// Declares that option @p name never affects the evolution of galaxies
+	void never(const std::string &name);
+
+	/// Declares that option @p name acts only on galaxies at redshifts below
+	/// the one returned by @p redshift
+	void acts_below(const std::string &name, redshift_function redshift);
+
+	/**
+	 * Finds the options that differ between @p before and @p after, and the
+	 * redshift below which galaxies evolved with either set of options might
+	 * differ because of each of them. This redshift is infinite for options
+	 * acting at all times, and negative for options never affecting galaxies.
+	 *
+	 * @param before The original options
+	 * @param after The changed options
+	 * @return The changed options, and the redshift below which they act
+	 */
+	std::map<std::string, double> changes(const Options &before, const Options &after) const;
+
+	/// @return The dependencies declared by all of shark's parameter classes
+	static const OptionDependencies &shark_options();
+
+private:
+	std::map<std::string, redshift_function> declarations {};
+};
+
+}  // namespace shark
+
+#endif // SHARK_OPTION_DEPENDENCIES_H_
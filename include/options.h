@@ -47,7 +47,8 @@ public:
 
 	enum file_format_t {
 		HDF5,
-		ASCII
+		ASCII,
+		COLUMNAR
 	};
 
 	///
@@ -62,6 +63,16 @@ public:
 	 */
 	Options(const std::string &filename);
 
+	/**
+	 * A ctor that takes all options at once
+	 *
+	 * @param options The options, indexed by their full name
+	 */
+	explicit Options(const options_t &options);
+
+	/// @return All options, indexed by their full name
+	const options_t &values() const;
+
 	/// Adds the options contained in file @p fname
 	///
 	/// @param fname A file with options to load
@@ -0,0 +1,150 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Comparison of the HDF5 outputs of two shark executions
+ */
+
+#ifndef SHARK_OUTPUT_COMPARISON_H_
+#define SHARK_OUTPUT_COMPARISON_H_
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace shark {
+
+/**
+ * The absolute and relative tolerances within which the values of some
+ * datasets are considered equal: two values a and b are equal if
+ * |a - b| <= absolute + relative * max(|a|, |b|)
+ */
+struct ComparisonTolerance {
+	/// Regular expression matching the whole name of the datasets these
+	/// tolerances apply to (e.g., galaxies/mstars_.*)
+	std::string datasets;
+	double absolute;
+	double relative;
+};
+
+/**
+ * Options of an OutputComparison
+ */
+struct OutputComparisonParameters {
+
+	/// Tolerances of the datasets matched by their patterns, the first
+	/// matching one is used
+	std::vector<ComparisonTolerance> tolerances {};
+
+	/// Tolerances of the datasets not matched by any pattern
+	double absolute_tolerance = 0;
+	double relative_tolerance = 0;
+
+	/// Regular expressions matching the names of datasets that are not
+	/// compared (e.g., run_info/.*)
+	std::vector<std::string> excluded_datasets {};
+
+	/// The number of galaxies with most differing properties reported
+	std::size_t max_galaxies = 10;
+
+	/// The number of threads comparing files
+	unsigned int threads = 1;
+};
+
+/// The differences found in a property (i.e., a dataset) over all files
+struct PropertyDifferences {
+	std::string name;
+	std::size_t files = 0;
+	std::size_t values = 0;
+	std::size_t differing_values = 0;
+	double max_absolute_difference = 0;
+	double max_relative_difference = 0;
+};
+
+/// A galaxy with properties that differ
+struct GalaxyDifferences {
+	/// The file the galaxy was found in, relative to the compared outputs
+	std::string file;
+	std::int64_t id_galaxy;
+	std::size_t differing_properties;
+};
+
+/**
+ * The comparison of the HDF5 outputs of two executions. All HDF5 files found
+ * under the two output directories (e.g., the galaxies.hdf5 file of each
+ * snapshot and batch) are paired by their relative paths, and all numeric
+ * datasets of each pair of files are compared value by value.
+ *
+ * Differences are summarised by property, and by galaxy for the datasets of
+ * the galaxies group: galaxies are identified by the id_galaxy dataset of
+ * the reference file, and their values are expected in the same rows.
+ */
+class OutputComparison {
+
+public:
+
+	/**
+	 * Compares the outputs found under @p reference and @p other. Files are
+	 * compared in parallel, but HDF5 is only accessed by one thread at a time.
+	 *
+	 * @param reference The directory with the reference outputs, or a single
+	 * HDF5 file
+	 * @param other The directory with the outputs to check, or a single HDF5
+	 * file
+	 * @param params The options of the comparison
+	 */
+	OutputComparison(const std::string &reference, const std::string &other, const OutputComparisonParameters &params);
+
+	/// Whether both outputs have the same files and datasets, with the same
+	/// shapes and values within tolerances
+	bool equal() const;
+
+	/// The number of pairs of files compared
+	std::size_t get_compared_files() const { return compared_files; }
+
+	/// Files, or datasets of compared files, found in only one of the outputs
+	/// (the latter as file:dataset)
+	const std::vector<std::string> &get_missing() const { return missing; }
+
+	/// Datasets of compared files (as file:dataset) with different shapes
+	const std::vector<std::string> &get_mismatched_shapes() const { return mismatched_shapes; }
+
+	/// The differences of each compared property, sorted by name
+	const std::vector<PropertyDifferences> &get_properties() const { return properties; }
+
+	/// The galaxies with most differing properties, most different first
+	const std::vector<GalaxyDifferences> &get_galaxies() const { return galaxies; }
+
+	/// Writes a human-readable summary of the comparison
+	void write(std::ostream &os) const;
+
+private:
+	std::size_t compared_files = 0;
+	std::vector<std::string> missing;
+	std::vector<std::string> mismatched_shapes;
+	std::vector<PropertyDifferences> properties;
+	std::vector<GalaxyDifferences> galaxies;
+};
+
+}  // namespace shark
+
+#endif // SHARK_OUTPUT_COMPARISON_H_
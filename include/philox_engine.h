@@ -0,0 +1,121 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * A counter-based random number engine
+ */
+
+#ifndef SHARK_PHILOX_ENGINE_H
+#define SHARK_PHILOX_ENGINE_H
+
+#include <cstdint>
+
+namespace shark {
+
+/**
+ * A counter-based random number engine implementing the Philox4x32-10
+ * generator of Salmon et al. (2011).
+ *
+ * Unlike sequential engines like std::default_random_engine, the numbers
+ * produced by this engine are a pure function of its key and counter. Shark
+ * uses it to give each entity (a subhalo, a galaxy) its own stream of random
+ * numbers for a given purpose and snapshot, identified by the global seed,
+ * the purpose of the stream, the entity ID and the snapshot. These numbers
+ * are then the same regardless of which thread draws them, or in which
+ * order entities are visited.
+ *
+ * This class models the UniformRandomBitGenerator concept, and can be
+ * therefore used with the random number distributions of the standard
+ * library. Each stream yields up to 2^34 numbers before repeating itself.
+ */
+class philox_engine {
+
+public:
+	typedef std::uint32_t result_type;
+
+	/// The purposes random numbers are drawn for, used as part of the key
+	enum stream {
+		HALO_SPIN = 0,
+		SATELLITE_ORBITS,
+		MERGING_TIMESCALE,
+		TREE_SAMPLING
+	};
+
+	/**
+	 * Creates a new engine for stream @p purpose of entity @p id at
+	 * snapshot @p snapshot, under the global seed @p seed.
+	 */
+	philox_engine(std::uint32_t seed, stream purpose, std::uint64_t id, int snapshot) :
+		key {seed, std::uint32_t(purpose)},
+		counter {std::uint32_t(id), std::uint32_t(id >> 32), std::uint32_t(snapshot), 0},
+		output(),
+		used(4)
+	{
+	}
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return 0xffffffff; }
+
+	result_type operator()()
+	{
+		if (used == 4) {
+			generate(counter, key, output);
+			counter[3]++;
+			used = 0;
+		}
+		return output[used++];
+	}
+
+	/**
+	 * The Philox4x32-10 bijection, writing into @p out the random block
+	 * corresponding to counter @p ctr and key @p k
+	 */
+	static void generate(const std::uint32_t ctr[4], const std::uint32_t k[2], std::uint32_t out[4])
+	{
+		std::uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+		std::uint32_t k0 = k[0], k1 = k[1];
+		for (int round = 0; round != 10; round++) {
+			auto p0 = std::uint64_t(0xD2511F53) * c0;
+			auto p1 = std::uint64_t(0xCD9E8D57) * c2;
+			c0 = std::uint32_t(p1 >> 32) ^ c1 ^ k0;
+			c1 = std::uint32_t(p1);
+			c2 = std::uint32_t(p0 >> 32) ^ c3 ^ k1;
+			c3 = std::uint32_t(p0);
+			k0 += 0x9E3779B9;
+			k1 += 0xBB67AE85;
+		}
+		out[0] = c0;
+		out[1] = c1;
+		out[2] = c2;
+		out[3] = c3;
+	}
+
+private:
+	std::uint32_t key[2];
+	std::uint32_t counter[4];
+	std::uint32_t output[4];
+	unsigned int used;
+};
+
+}  // namespace shark
+
+#endif // SHARK_PHILOX_ENGINE_H
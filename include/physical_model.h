@@ -26,18 +26,26 @@
 #ifndef SHARK_SYSTEM_H_
 #define SHARK_SYSTEM_H_
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <unordered_map>
 
 #include <gsl/gsl_odeiv2.h>
 #include <recycling.h>
+#include "batch_ode_solver.h"
 #include "components.h"
 #include "gas_cooling.h"
+#include "logging.h"
 #include "numerical_constants.h"
+#include "ode_costs.h"
 #include "ode_solver.h"
 #include "stellar_feedback.h"
 #include "star_formation.h"
+#include "timer.h"
 
 namespace shark {
 
@@ -46,6 +54,29 @@ class PhysicalModel {
 
 public:
 
+	/**
+	 * The state of the ODE system, with one value per component
+	 */
+	typedef std::array<double, NC> state_t;
+
+	/**
+	 * Values derived from the solver_params of a galaxy and the model
+	 * parameters, which remain constant while the galaxy evolves, and are
+	 * therefore calculated once per evolution (see prepare_solver_params)
+	 * instead of on every evaluation of the ODE system.
+	 */
+	struct solver_invariants {
+		StellarFeedback::outflow_factors outflows;
+		StarFormation::disk_properties disk;
+		/// sAM of the cold gas while there is no gas in the galaxy
+		double jgas;
+		/// Fraction of the newly formed stars that is not recycled
+		double rsub;
+		double yield;
+		/// Minimum metallicity of the cold and hot gas
+		double zmin;
+	};
+
 	/**
 	 * The set of parameters passed down to the ODESolver. It includes the
 	 * physical model itself, the galaxy and subhalo being evolved on each call,
@@ -62,17 +93,38 @@ public:
 		double vsubh;
 		double vgal;
 		bool   burst;
+		solver_invariants invariants;
 	};
 
+	/**
+	 * @param ode_solver_precision The precision of the ODE solvers
+	 * @param evaluator The evaluator of the ODE system
+	 * @param jacobian The Jacobian of the ODE system, needed by implicit steppers
+	 * @param stepper The GSL stepper used to evolve galaxies
+	 * @param starburst_stepper The GSL stepper used to evolve starbursts
+	 * @param warm_start_ode Whether galaxies start their evolution with the
+	 * mean step size of their previous evolution
+	 * @param gas_cooling The gas cooling calculator
+	 */
 	PhysicalModel(
 			double ode_solver_precision,
 			ODESolver::ode_evaluator evaluator,
+			ODESolver::ode_jacobian jacobian,
+			const gsl_odeiv2_step_type *stepper,
+			const gsl_odeiv2_step_type *starburst_stepper,
+			bool warm_start_ode,
 			GasCooling gas_cooling) :
-		evaluator(evaluator),
-		ode_solver_precision(ode_solver_precision),
+		ode_solver(NC, ode_solver_precision, evaluator, jacobian, stepper),
+		starburst_ode_solver(NC, ode_solver_precision, evaluator, jacobian, starburst_stepper),
+		batch_ode_solver(NC, ode_solver_precision, evaluator),
 		gas_cooling(gas_cooling),
+		warm_start_ode(warm_start_ode),
 		galaxy_ode_evaluations(0),
-		galaxy_starburst_ode_evaluations(0)
+		galaxy_starburst_ode_evaluations(0),
+		galaxy_fast_path_hits(0),
+		batch_ode_check_tolerance(0),
+		batch_ode_mismatches(0),
+		cooling_micros(0)
 	{
 		// no-op
 	}
@@ -82,18 +134,27 @@ public:
 		// no-op
 	}
 
-	ODESolver get_solver(double delta_t, const std::vector<double> &y0, solver_params &params) {
-		if (y0.size() != NC) {
-			std::ostringstream os;
-			os << "# initial values != ODE components: " << y0.size() << " != " << NC;
-			throw std::invalid_argument(os.str());
-		}
+	/**
+	 * Calculates the invariants of @p params, which depend only on the
+	 * galaxy and not on the state of the ODE system.
+	 */
+	virtual void prepare_solver_params(solver_params &params)
+	{
+		// no-op
+	}
 
-		auto system_ptr = std::shared_ptr<gsl_odeiv2_system>(new gsl_odeiv2_system{evaluator, nullptr, NC, &params});
-		return ODESolver(y0, 0, delta_t, ode_solver_precision, system_ptr);
+	/**
+	 * Evolves the ODE system with initial values @p y over @p delta_t
+	 * using @p solver, leaving the final values in @p y
+	 *
+	 * @return The number of ODE evaluations this took
+	 */
+	unsigned long int solve(ODESolver &solver, state_t &y, double delta_t, solver_params &params, double h_start = 0) {
+		solver.evolve(y.data(), delta_t, &params, h_start);
+		return solver.num_evaluations();
 	}
 
-	void evolve_galaxy(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t)
+	solver_params get_solver_params(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t)
 	{
 		/**
 		 * Parameters that are needed as input in the ode_solver:
@@ -109,7 +170,16 @@ public:
 		double mcoolrate = 0;
 		// Define cooling rate only in the case galaxy is central.
 		if(galaxy.galaxy_type == Galaxy::CENTRAL){
-			mcoolrate = gas_cooling.cooling_rate(subhalo, galaxy, z, delta_t);
+			auto precalculated = cooling_rates.find(&galaxy);
+			if (precalculated != cooling_rates.end()) {
+				mcoolrate = precalculated->second;
+				cooling_rates.erase(precalculated);
+			}
+			else {
+				Timer cooling_t;
+				mcoolrate = gas_cooling.cooling_rate(subhalo, galaxy, z, delta_t);
+				cooling_micros += cooling_t.get_micros();
+			}
 		}
 
 		double rgas       = galaxy.disk_gas.rscale; //gas scale radius.
@@ -127,12 +197,133 @@ public:
 		double jcold_halo = subhalo.cold_halo_gas.sAM;
 		bool   burst      = false;
 
-		std::vector<double> y0 = from_galaxy(subhalo, galaxy);
-		solver_params params{*this, rgas, rstar, mcoolrate, jcold_halo, delta_t, z, vsubh, vgal, burst};
-		auto ode_solver = get_solver(delta_t, y0, params);
-		std::vector<double> y1 = ode_solver.evolve();
-		galaxy_ode_evaluations += ode_solver.num_evaluations();
-		to_galaxy(y1, subhalo, galaxy, delta_t);
+		solver_params params{*this, rgas, rstar, mcoolrate, jcold_halo, delta_t, z, vsubh, vgal, burst, {}};
+		prepare_solver_params(params);
+		return params;
+	}
+
+	/**
+	 * Calculates the gas cooling rates of the given central galaxies all at
+	 * once, instead of doing so when each of them is evolved. The next
+	 * evolution of each galaxy then uses its precalculated rate.
+	 * No two galaxies can belong to the same halo.
+	 */
+	void calculate_cooling_rates(const std::vector<std::pair<Subhalo *, Galaxy *>> &galaxies, double z, double delta_t)
+	{
+		Timer cooling_t;
+		batch_cooling_rates.resize(galaxies.size());
+		gas_cooling.cooling_rates(galaxies, z, delta_t, batch_cooling_rates.data());
+		for (std::size_t i = 0; i != galaxies.size(); i++) {
+			cooling_rates[galaxies[i].second] = batch_cooling_rates[i];
+		}
+		cooling_micros += cooling_t.get_micros();
+	}
+
+	/**
+	 * Whether the ODE system with initial values @p y is stationary, and
+	 * therefore doesn't need to be solved. This happens when there is no gas
+	 * cooling and no cold gas to form stars from: all equations are driven by
+	 * the cooling and star formation rates, which are (and remain) zero.
+	 */
+	bool stationary(const state_t &y, const solver_params &params) const
+	{
+		return params.mcoolrate == 0 && y[1] <= constants::EPS3;
+	}
+
+	void evolve_galaxy(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t)
+	{
+		solver_params params = get_solver_params(subhalo, galaxy, z, delta_t);
+		state_t y = from_galaxy(subhalo, galaxy);
+		state_t y0 = y;
+		unsigned long int evaluations = 0;
+		if (stationary(y, params)) {
+			galaxy_fast_path_hits++;
+		}
+		else if (warm_start_ode) {
+			evaluations = solve(ode_solver, y, delta_t, params, galaxy.ode_step);
+			galaxy.ode_step = ode_solver.mean_step();
+		}
+		else {
+			evaluations = solve(ode_solver, y, delta_t, params);
+		}
+		galaxy_ode_evaluations += evaluations;
+		record_cost(evaluations, false, galaxy, y0, params);
+		to_galaxy(y, subhalo, galaxy, delta_t);
+	}
+
+	/**
+	 * Evolves many galaxies at once using the batched ODE solver. Results
+	 * are the same that would be obtained by calling evolve_galaxy on each
+	 * of them in turn, save for the different numerical integration.
+	 * No two galaxies can belong to the same subhalo, as galaxies of the same
+	 * subhalo exchange mass with it, and therefore depend on each other.
+	 *
+	 * @param galaxies The galaxies to evolve, together with their subhalos
+	 * @param z The redshift
+	 * @param delta_t The time interval over which galaxies are evolved
+	 */
+	void evolve_galaxies(const std::vector<std::pair<Subhalo *, Galaxy *>> &galaxies, double z, double delta_t)
+	{
+		// All parameters are stored first, and only then pointed to, so
+		// the pointers given to the solver remain valid.
+		// Stationary systems are not solved, and go straight to to_galaxy
+		batch_params.clear();
+		batch_params.reserve(galaxies.size());
+		batch_galaxies.clear();
+		batch_states.clear();
+		for (auto &subhalo_and_galaxy: galaxies) {
+			auto &subhalo = *subhalo_and_galaxy.first;
+			auto &galaxy = *subhalo_and_galaxy.second;
+			solver_params params = get_solver_params(subhalo, galaxy, z, delta_t);
+			state_t y = from_galaxy(subhalo, galaxy);
+			if (stationary(y, params)) {
+				galaxy_fast_path_hits++;
+				record_cost(0, false, galaxy, y, params);
+				to_galaxy(y, subhalo, galaxy, delta_t);
+				continue;
+			}
+			batch_params.emplace_back(params);
+			batch_galaxies.push_back(subhalo_and_galaxy);
+			batch_states.push_back(y);
+		}
+
+		auto n = batch_galaxies.size();
+		batch_y.resize(n * NC);
+		for (std::size_t l = 0; l != n; l++) {
+			for (std::size_t i = 0; i != NC; i++) {
+				batch_y[i * n + l] = batch_states[l][i];
+			}
+		}
+		batch_params_ptrs.clear();
+		for (auto &params: batch_params) {
+			batch_params_ptrs.push_back(&params);
+		}
+		batch_delta_t.assign(n, delta_t);
+		batch_h_start.clear();
+		if (warm_start_ode) {
+			for (auto &subhalo_and_galaxy: batch_galaxies) {
+				batch_h_start.push_back(subhalo_and_galaxy.second->ode_step);
+			}
+		}
+
+		batch_ode_solver.evolve(batch_y, batch_delta_t, batch_params_ptrs, batch_h_start);
+
+		for (std::size_t l = 0; l != n; l++) {
+			state_t y;
+			for (std::size_t i = 0; i != NC; i++) {
+				y[i] = batch_y[i * n + l];
+			}
+			auto evaluations = batch_ode_solver.num_evaluations(l);
+			galaxy_ode_evaluations += evaluations;
+			record_cost(evaluations, false, *batch_galaxies[l].second, batch_states[l], batch_params[l]);
+			if (warm_start_ode) {
+				batch_galaxies[l].second->ode_step = batch_ode_solver.mean_step(l);
+			}
+			if (batch_ode_check_tolerance > 0) {
+				check_batched_ode(y, l, delta_t);
+			}
+			to_galaxy(y, *batch_galaxies[l].first, *batch_galaxies[l].second, delta_t);
+		}
 	}
 
 	void evolve_galaxy_starburst(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t, bool from_galaxy_merger)
@@ -157,19 +348,27 @@ public:
 		double vgal       = galaxy.bulge_gas.sAM / galaxy.bulge_gas.rscale;
 		bool   burst      = true;
 
-		std::vector<double> y0 = from_galaxy_starburst(subhalo, galaxy);
-		solver_params params{*this, rgas, rstar, mcoolrate, jcold_halo, delta_t, z, vsubh, vgal, burst};
-		auto solver = get_solver(delta_t, y0, params);
-		std::vector<double> y1 = solver.evolve();
-		galaxy_starburst_ode_evaluations += solver.num_evaluations();
-		to_galaxy_starburst(y1, subhalo, galaxy, delta_t, from_galaxy_merger);
+		state_t y = from_galaxy_starburst(subhalo, galaxy);
+		state_t y0 = y;
+		solver_params params{*this, rgas, rstar, mcoolrate, jcold_halo, delta_t, z, vsubh, vgal, burst, {}};
+		prepare_solver_params(params);
+		unsigned long int evaluations = 0;
+		if (stationary(y, params)) {
+			galaxy_fast_path_hits++;
+		}
+		else {
+			evaluations = solve(starburst_ode_solver, y, delta_t, params);
+		}
+		galaxy_starburst_ode_evaluations += evaluations;
+		record_cost(evaluations, true, galaxy, y0, params);
+		to_galaxy_starburst(y, subhalo, galaxy, delta_t, from_galaxy_merger);
 	}
 
-	virtual std::vector<double> from_galaxy(const Subhalo &subhalo, const Galaxy &galaxy) = 0;
-	virtual void to_galaxy(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t) = 0;
+	virtual state_t from_galaxy(const Subhalo &subhalo, const Galaxy &galaxy) = 0;
+	virtual void to_galaxy(const state_t &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t) = 0;
 
-	virtual std::vector<double> from_galaxy_starburst(const Subhalo &subhalo, const Galaxy &galaxy) = 0;
-	virtual void to_galaxy_starburst(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger) = 0;
+	virtual state_t from_galaxy_starburst(const Subhalo &subhalo, const Galaxy &galaxy) = 0;
+	virtual void to_galaxy_starburst(const state_t &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger) = 0;
 
 	unsigned long int get_galaxy_ode_evaluations() {
 		return galaxy_ode_evaluations;
@@ -179,33 +378,155 @@ public:
 		return galaxy_starburst_ode_evaluations;
 	}
 
+	/**
+	 * @return The number of galaxy and starburst evolutions that didn't need
+	 * to solve their ODE system because it was stationary
+	 */
+	unsigned long int get_galaxy_fast_path_hits() {
+		return galaxy_fast_path_hits;
+	}
+
+	/// @return The time spent calculating gas cooling rates
+	Timer::duration get_cooling_micros() {
+		return cooling_micros;
+	}
+
+	/// @return The histogram of ODE evaluations per galaxy evolution
+	const ODECostHistogram &get_galaxy_ode_histogram() const {
+		return galaxy_ode_histogram;
+	}
+
+	/// @return The histogram of ODE evaluations per starburst
+	const ODECostHistogram &get_starburst_ode_histogram() const {
+		return starburst_ode_histogram;
+	}
+
+	/// @return The most expensive ODE systems solved by this model
+	const ODECostRanking &get_most_expensive_odes() const {
+		return most_expensive_odes;
+	}
+
+	/// Keep track of the @p n most expensive ODE systems solved by this model
+	void track_most_expensive_odes(std::size_t n) {
+		most_expensive_odes = ODECostRanking(n);
+	}
+
+	/**
+	 * Compare the solutions of the batched ODE solver against those of the
+	 * GSL solver, counting those with a component whose relative difference
+	 * is larger than @p tolerance. 0 disables the comparison.
+	 */
+	void check_batched_odes(double tolerance) {
+		batch_ode_check_tolerance = tolerance;
+	}
+
+	/// @return The number of batched ODE solutions that differed from the
+	/// GSL reference, see check_batched_odes
+	unsigned long int get_batch_ode_mismatches() const {
+		return batch_ode_mismatches;
+	}
+
 	void reset_ode_evaluations() {
 		galaxy_ode_evaluations = 0;
 		galaxy_starburst_ode_evaluations = 0;
+		galaxy_fast_path_hits = 0;
+		batch_ode_mismatches = 0;
+		cooling_micros = 0;
+		galaxy_ode_histogram.reset();
+		starburst_ode_histogram.reset();
+		most_expensive_odes.reset();
 	}
 
 private:
-	ODESolver::ode_evaluator evaluator;
-	double ode_solver_precision;
+
+	void record_cost(unsigned long int evaluations, bool starburst, const Galaxy &galaxy, const state_t &y0, const solver_params &params)
+	{
+		(starburst ? starburst_ode_histogram : galaxy_ode_histogram).add(evaluations);
+		if (most_expensive_odes.accepts(evaluations)) {
+			most_expensive_odes.add(ODECostRecord {
+				evaluations, galaxy.id, starburst,
+				{{params.rgas, params.rstar, params.mcoolrate, params.jcold_halo, params.delta_t, params.redshift, params.vsubh, params.vgal}},
+				std::vector<double>(y0.begin(), y0.end())
+			});
+		}
+	}
+
+	/**
+	 * Solves lane @p l of the last batch again with the GSL solver and
+	 * compares the solution against the batched one, @p y. Values are
+	 * compared relative to the reference, with components smaller than 1
+	 * compared in absolute terms instead.
+	 */
+	void check_batched_ode(const state_t &y, std::size_t l, double delta_t)
+	{
+		state_t y_ref = batch_states[l];
+		auto params = batch_params[l];
+		solve(ode_solver, y_ref, delta_t, params);
+		for (std::size_t i = 0; i != NC; i++) {
+			double difference = std::abs(y[i] - y_ref[i]) / std::max(std::abs(y_ref[i]), 1.);
+			if (difference > batch_ode_check_tolerance) {
+				batch_ode_mismatches++;
+				LOG_LIMITED(warning) << "Batched ODE solution of galaxy " << batch_galaxies[l].second->id
+				                     << " differs from the GSL reference by " << difference << " in component " << i
+				                     << ": " << y[i] << " vs " << y_ref[i];
+				break;
+			}
+		}
+	}
+
+	// Physical models are used by one thread at a time, so they can keep a
+	// single solver that is reused for all galaxies (and one for starbursts)
+	ODESolver ode_solver;
+	ODESolver starburst_ode_solver;
+	BatchODESolver batch_ode_solver;
 	GasCooling gas_cooling;
+	bool warm_start_ode;
+
+	// Reused across calls to evolve_galaxies to avoid reallocations
+	std::vector<solver_params> batch_params;
+	std::vector<std::pair<Subhalo *, Galaxy *>> batch_galaxies;
+	std::vector<state_t> batch_states;
+	std::vector<void *> batch_params_ptrs;
+	std::vector<double> batch_y;
+	std::vector<double> batch_delta_t;
+	std::vector<double> batch_h_start;
 	unsigned long int galaxy_ode_evaluations;
 	unsigned long int galaxy_starburst_ode_evaluations;
+	unsigned long int galaxy_fast_path_hits;
+	double batch_ode_check_tolerance;
+	unsigned long int batch_ode_mismatches;
+
+	// Cooling rates calculated in advance, waiting to be used
+	std::unordered_map<const Galaxy *, double> cooling_rates;
+	std::vector<double> batch_cooling_rates;
+	Timer::duration cooling_micros;
+
+	// Physical models are used by one thread at a time, so these need no
+	// synchronisation
+	ODECostHistogram galaxy_ode_histogram;
+	ODECostHistogram starburst_ode_histogram;
+	ODECostRanking most_expensive_odes;
 };
 
 class BasicPhysicalModel : public PhysicalModel<17> {
 public:
 	BasicPhysicalModel(double ode_solver_precision,
+			const gsl_odeiv2_step_type *stepper,
+			const gsl_odeiv2_step_type *starburst_stepper,
+			bool warm_start_ode,
 			GasCooling gas_cooling,
 			StellarFeedback stellar_feedback,
 			StarFormation star_formation,
 			RecyclingParameters recycling_parameters,
 			GasCoolingParameters gas_cooling_parameters);
 
-	std::vector<double> from_galaxy(const Subhalo &subhalo, const Galaxy &galaxy);
-	void to_galaxy(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t);
+	void prepare_solver_params(solver_params &params) override;
 
-	std::vector<double> from_galaxy_starburst(const Subhalo &subhalo, const Galaxy &galaxy);
-	void to_galaxy_starburst(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger);
+	state_t from_galaxy(const Subhalo &subhalo, const Galaxy &galaxy) override;
+	void to_galaxy(const state_t &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t) override;
+
+	state_t from_galaxy_starburst(const Subhalo &subhalo, const Galaxy &galaxy) override;
+	void to_galaxy_starburst(const state_t &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger) override;
 
 	StellarFeedback stellar_feedback;
 	StarFormation star_formation;
@@ -221,8 +542,23 @@ public:
 		return star_formation.get_integration_intervals();
 	}
 
+	unsigned long int get_star_formation_integrations() {
+		return star_formation.get_integrations();
+	}
+
+	unsigned long int get_star_formation_integration_failures() {
+		return star_formation.get_integration_failures();
+	}
+
 };
 
+/**
+ * The ODE system evolved by BasicPhysicalModel, evaluating into @p f the time
+ * derivatives of the 17 components of @p y. @p data points to the
+ * BasicPhysicalModel::solver_params of the galaxy being evolved.
+ */
+int basic_physicalmodel_evaluator(double t, const double y[], double f[], void *data);
+
 }  // namespace shark
 
 #endif // SHARK_SYSTEM_H_
@@ -0,0 +1,163 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Low-overhead, per-thread timing of the main physics modules
+ */
+
+#ifndef SHARK_PROFILING_H_
+#define SHARK_PROFILING_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+#include "config.h"
+
+namespace shark {
+
+namespace profiling {
+
+/// The regions of the code whose calls and time are measured
+enum region_t {
+	GAS_COOLING = 0,
+	STAR_FORMATION,
+	MOLECULAR_GAS,
+	ODE_SOLVER,
+	GALAXY_MERGERS,
+	SUBHALO_MERGERS,
+	DISK_INSTABILITY,
+	N_REGIONS
+};
+
+/// @return The name of @p region as shown in reports
+const char *region_name(region_t region);
+
+/**
+ * Returns the current value of the cycle counter where there is one, or of
+ * the steady clock otherwise. Ticks are converted into time by collect().
+ */
+inline
+std::uint64_t ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/**
+ * The calls to and ticks spent in each region by a single thread. Each thread
+ * writes only into its own counters, without locks or atomics; they are
+ * padded so the counters of different threads never share a cache line.
+ */
+struct thread_counters {
+	std::uint64_t calls[N_REGIONS];
+	std::uint64_t ticks[N_REGIONS];
+	char padding[64];
+};
+
+/// @return The counters of the calling thread, which are created on first use
+thread_counters &local_counters();
+
+/**
+ * Adds the time between its creation and destruction, and one call, to a
+ * region of the calling thread's counters.
+ *
+ * Regions can be nested, in which case the time of the inner region is
+ * also counted in the outer one.
+ */
+class scoped_timer {
+
+public:
+
+	explicit scoped_timer(region_t region) :
+		region(region), t0(ticks())
+	{
+		// no-op
+	}
+
+	~scoped_timer()
+	{
+		auto &counters = local_counters();
+		counters.ticks[region] += ticks() - t0;
+		counters.calls[region]++;
+	}
+
+	scoped_timer(const scoped_timer &) = delete;
+	scoped_timer &operator=(const scoped_timer &) = delete;
+
+private:
+	region_t region;
+	std::uint64_t t0;
+};
+
+/// The calls to and time spent in a region, summed over all threads
+struct region_totals {
+	region_t region;
+	std::uint64_t calls;
+	double millis;
+};
+
+/**
+ * Sums the counters of all threads for each region, returning one total per
+ * region in region order. It must not be called while other threads are
+ * measuring.
+ */
+std::vector<region_totals> collect();
+
+/// Zeroes the counters of all threads. The same restrictions of collect() apply
+void reset();
+
+/**
+ * Writes a table with the calls, total time and mean time per call of each
+ * region, and their time as a share of @p thread_millis.
+ *
+ * @param os The stream to write into
+ * @param totals The totals to write, as given by collect()
+ * @param thread_millis The time available to all threads during the
+ * measurement, i.e., its wall-clock time times the number of threads
+ */
+void write_table(std::ostream &os, const std::vector<region_totals> &totals, double thread_millis);
+
+}  // namespace profiling
+
+}  // namespace shark
+
+/**
+ * Measures the rest of the enclosing scope as part of the given
+ * shark::profiling::region_t region. This expands to nothing unless shark is
+ * compiled with SHARK_PROFILING, so it has no cost in regular builds.
+ */
+#ifdef SHARK_PROFILING
+# define SHARK_PROFILE(region) ::shark::profiling::scoped_timer shark_profiling_scope(::shark::profiling::region)
+#else
+# define SHARK_PROFILE(region)
+#endif
+
+#endif // SHARK_PROFILING_H_
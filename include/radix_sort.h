@@ -0,0 +1,54 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * A parallel radix sort for integer keys
+ */
+
+#ifndef SHARK_RADIX_SORT_H
+#define SHARK_RADIX_SORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace shark {
+
+/**
+ * Sorts @p keys in increasing order and returns the permutation applied to
+ * them, i.e., the original position of each sorted key. Equal keys keep
+ * their relative order.
+ *
+ * This is a least-significant-digit radix sort, where each pass over the keys
+ * is split in contiguous blocks between threads. Passes over digits that are
+ * equal for all keys are skipped, so it is particularly quick for keys with
+ * a narrow range of values.
+ *
+ * @param keys The keys to sort
+ * @param threads The number of threads to use
+ * @return The original index of each key after sorting
+ */
+std::vector<std::size_t> radix_sort(std::vector<std::int64_t> &keys, unsigned int threads);
+
+}  // namespace shark
+
+#endif // SHARK_RADIX_SORT_H
@@ -33,11 +33,16 @@
 
 namespace shark {
 
+class OptionDependencies;
+
 class ReionisationParameters {
 
 public:
 	ReionisationParameters(const Options &options);
 
+	/// Declares that reionisation only acts below zcut
+	static void declare_dependencies(OptionDependencies &dependencies);
+
 	enum ReionisationModel {
 		LACEY16 = 0,
 		SOBACCHI13
@@ -60,7 +65,17 @@ public:
 	virtual ~Reionisation();
 
 	/// Checks whether a halo of viral velocity @p v and redshift @p z is affected by reionisation
-	virtual bool reionised_halo (double v, double z) const = 0;
+	bool reionised_halo (double v, double z) const
+	{
+		return v < velocity_threshold(z);
+	}
+
+	/**
+	 * The virial velocity below which halos at redshift @p z are affected by
+	 * reionisation. It's the same for all halos of a snapshot, so it can be
+	 * calculated once and compared against each of them.
+	 */
+	virtual double velocity_threshold (double z) const = 0;
 
 protected:
 	const ReionisationParameters &get_reionisation_params() const { return parameters; }
@@ -73,14 +88,14 @@ private:
 class Lacey16Reionisation : public Reionisation {
 public:
 	using Reionisation::Reionisation;
-	virtual bool reionised_halo (double v, double z) const;
+	virtual double velocity_threshold (double z) const;
 };
 
 /// The Sobacchi13 model of reionisation
 class Sobacchi13Reionisation : public Reionisation {
 public:
 	using Reionisation::Reionisation;
-	virtual bool reionised_halo (double v, double z) const;
+	virtual double velocity_threshold (double z) const;
 };
 
 typedef std::shared_ptr<Reionisation> ReionisationPtr;
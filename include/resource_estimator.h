@@ -0,0 +1,125 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Estimation of the resources needed to evolve simulation batches
+ */
+
+#ifndef SHARK_RESOURCE_ESTIMATOR_H_
+#define SHARK_RESOURCE_ESTIMATOR_H_
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "execution.h"
+#include "simulation.h"
+
+namespace shark {
+
+/**
+ * The costs of each subhalo read from the merger trees, from which the
+ * resources of an execution are extrapolated.
+ *
+ * Default costs are rough figures based on the size of the structures that
+ * hold subhalos, halos and galaxies. Costs calibrated from the metrics of a
+ * previous execution of the same model (see execution.metrics_file) give
+ * much better estimates.
+ */
+struct ResourceCosts {
+
+	ResourceCosts();
+
+	/// Memory per subhalo, including its share of halos, galaxies, merger
+	/// trees and their indices [bytes]
+	double bytes_per_subhalo;
+
+	/// Memory needed regardless of the size of the merger trees [bytes]
+	double base_bytes;
+
+	/// Time to read a subhalo and build it into merger trees [us]
+	double import_micros_per_subhalo;
+
+	/// Galaxies evolved per subhalo
+	double galaxies_per_subhalo;
+
+	/// Time to evolve a galaxy over one snapshot, with a single thread [us]
+	double evolution_micros_per_galaxy;
+
+	/**
+	 * Calibrates the memory and evolution costs from the metrics CSV file
+	 * written by a previous execution. The import cost is kept, as it is not
+	 * part of the metrics.
+	 *
+	 * @param metrics The contents of the file given in execution.metrics_file
+	 * @return The calibrated costs
+	 * @throws invalid_data if @p metrics doesn't contain any snapshot metrics
+	 */
+	static ResourceCosts calibrate(std::istream &metrics);
+};
+
+/// The resources that evolving a single simulation batch is expected to need
+struct BatchEstimate {
+	unsigned int batch;
+	/// The subhalos within the snapshots that are read
+	unsigned long subhalos;
+	/// The peak memory usage [bytes]
+	std::size_t peak_memory;
+	/// The time to import the merger trees [s]
+	double import_seconds;
+	/// The time to evolve all galaxies [s]
+	double evolution_seconds;
+};
+
+/**
+ * Estimates the resources needed to evolve simulation batches without
+ * actually reading their merger trees: only the number of batch files and
+ * the sizes of their datasets (or, if present, of their snapshot index) are
+ * read.
+ */
+class ResourceEstimator {
+
+public:
+
+	ResourceEstimator(const SimulationParameters &simulation_params, const ExecutionParameters &exec_params,
+	                  unsigned int threads, const ResourceCosts &costs = ResourceCosts());
+
+	/// @return The estimate of each of the execution.simulation_batches
+	std::vector<BatchEstimate> estimate() const;
+
+	/// @return The estimate for @p batch
+	BatchEstimate estimate(unsigned int batch) const;
+
+	/// Writes @p estimates as CSV, with a header line
+	static void write_csv(std::ostream &os, const std::vector<BatchEstimate> &estimates);
+
+private:
+	SimulationParameters simulation_params;
+	ExecutionParameters exec_params;
+	unsigned int threads;
+	ResourceCosts costs;
+};
+
+}  // namespace shark
+
+#endif // SHARK_RESOURCE_ESTIMATOR_H_
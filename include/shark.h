@@ -43,6 +43,10 @@
  * first parses the command-line parameters, constructs an Options objects and
  * determine the number of threads to use. It then creates a SharkRunner instance,
  * and finally invokes its @ref SharkRunner::run method.
+ *
+ * Applications evaluating many models in-process (e.g., parameter optimisers)
+ * can use the SharkSession class instead, or its plain C interface in
+ * shark_c.h.
  */
 namespace shark {}
 
@@ -0,0 +1,103 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Plain C interface to evaluate shark models in-process, see SharkSession
+ */
+
+#ifndef SHARK_SHARK_C_H_
+#define SHARK_SHARK_C_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// An opaque handle to a shark session
+typedef struct shark_session shark_session;
+
+/**
+ * Creates a new session, importing and building the merger trees given by
+ * the options in @p config_files, which are loaded in order.
+ *
+ * @param config_files The configuration files
+ * @param n_config_files The number of configuration files
+ * @param threads The number of threads used to run shark
+ * @return The new session, or NULL on error
+ */
+shark_session *shark_session_create(const char *const *config_files, size_t n_config_files, unsigned int threads);
+
+/// Destroys @p session, which can be NULL
+void shark_session_destroy(shark_session *session);
+
+/**
+ * Overrides an option of the session's base options in all subsequent runs
+ *
+ * @param session The session
+ * @param optspec A "name = value" option specification
+ * @return 0 on success, -1 on error
+ */
+int shark_session_set_option(shark_session *session, const char *optspec);
+
+/**
+ * Discards all options given via shark_session_set_option
+ *
+ * @param session The session
+ * @return 0 on success, -1 on error
+ */
+int shark_session_reset_options(shark_session *session);
+
+/**
+ * Evolves a new galaxy population with the current options
+ *
+ * @param session The session
+ * @return 0 on success, -1 on error
+ */
+int shark_session_run(shark_session *session);
+
+/**
+ * Copies the values of a summary statistic of the last run into @p values,
+ * e.g., "stellar_mass_function/phi" (see the "Summary statistics" section
+ * of the documentation).
+ *
+ * @param session The session
+ * @param snapshot The output snapshot
+ * @param name The name of the statistic
+ * @param values Where at most @p n_values values are copied to; can be NULL
+ * @param n_values The number of elements of @p values
+ * @param n_total If not NULL, where the total number of values is stored
+ * @return 0 on success, -1 on error
+ */
+int shark_session_get_statistic(shark_session *session, int snapshot, const char *name, double *values, size_t n_values, size_t *n_total);
+
+/**
+ * @return The description of the last error that occurred in the calling
+ * thread, or an empty string
+ */
+const char *shark_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHARK_SHARK_C_H_
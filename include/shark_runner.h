@@ -26,12 +26,16 @@
 #ifndef SHARK_SHARK_RUNNER_H
 #define SHARK_SHARK_RUNNER_H
 
+#include <iosfwd>
+#include <map>
 #include <memory>
+#include <vector>
 
 namespace shark {
 
 // Forward declaration to avoid including options.h
 class Options;
+class SummaryStatistics;
 
 /**
  * The main driver of a shark instance run.
@@ -57,14 +61,71 @@ public:
 	 * @param threads The number of threads used to run shark
 	 */
 	SharkRunner(const Options &options, unsigned int threads);
+
+	/**
+	 * Constructor for several models evolved over the same merger trees.
+	 *
+	 * Models usually differ only in their physical parameters. Merger trees
+	 * are imported and built only once, and then loaded again from an
+	 * in-memory copy for each model, which is evolved and written into its
+	 * own output directory. Models are evolved one after the other, so only
+	 * the galaxies of one of them are kept in memory at any given time.
+	 *
+	 * All models must use the same merger tree inputs and the options that
+	 * change how trees are built (see TreeCache::make_key), have different
+	 * output directories, and restart from the same checkpoint, if any. If these conditions are not met, or if
+	 * there is any missing or invalid option, this constructor will throw an
+	 * exception.
+	 *
+	 * @param models The set of options of each model
+	 * @param threads The number of threads used to run shark
+	 */
+	SharkRunner(const std::vector<Options> &models, unsigned int threads);
+
+	/**
+	 * Constructor for a model whose merger trees are shared with other
+	 * runners, possibly created later on.
+	 *
+	 * If @p trees is empty the merger trees are imported and built as usual,
+	 * and stored into @p trees. Otherwise they are loaded from @p trees,
+	 * which is much faster.
+	 *
+	 * @param options The set of options used to run shark
+	 * @param threads The number of threads used to run shark
+	 * @param trees The shared merger trees
+	 */
+	SharkRunner(const Options &options, unsigned int threads, const std::shared_ptr<std::stringstream> &trees);
 	~SharkRunner();
 
+	/**
+	 * Imports and builds the merger trees ahead of running, if they are
+	 * shared with other runners and have not been imported yet. Otherwise
+	 * this is a no-op, as trees are imported by run().
+	 */
+	void import_trees();
+
 	/// Run shark until completion
 	void run();
 
+	/**
+	 * Run shark until completion without writing any output. Instead, the
+	 * summary statistics of the galaxies at each output snapshot are stored
+	 * into @p summaries, indexed by snapshot.
+	 *
+	 * This runner must have been created for a single model.
+	 *
+	 * @param summaries Where summary statistics are stored
+	 */
+	void run(std::map<int, SummaryStatistics> &summaries);
+
+	/// @return The galaxy and starburst ODE evaluations of all models run
+	/// so far
+	unsigned long get_ode_evaluations() const { return ode_evaluations; }
+
 private:
 	class impl;
-	std::unique_ptr<impl> pimpl;
+	std::vector<std::unique_ptr<impl>> pimpls;
+	unsigned long ode_evaluations = 0;
 
 };
 
@@ -0,0 +1,119 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * In-process evaluation of shark models over the same merger trees
+ */
+
+#ifndef SHARK_SHARK_SESSION_H_
+#define SHARK_SHARK_SESSION_H_
+
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "options.h"
+#include "summary_statistics.h"
+
+namespace shark {
+
+/**
+ * A session evaluates many variations of a model over the same merger trees
+ * without writing any output, which is what parameter optimisers need in
+ * order to calculate the likelihood of each set of parameters.
+ *
+ * Merger trees are imported and built once when the session is created, and
+ * are kept in memory in their compact serialized form (see TreeCache). Each
+ * call to run() evolves a fresh galaxy population over a new copy of these
+ * trees, using the session's base options overridden by those given via
+ * set(), and keeps the summary statistics (see SummaryStatistics) of the
+ * galaxies of each output snapshot in memory.
+ *
+ * Options that change how merger trees are built (see TreeCache::make_key)
+ * must not be overridden.
+ */
+class SharkSession {
+
+public:
+
+	/**
+	 * Creates a new session, importing and building the merger trees
+	 * given by @p options.
+	 *
+	 * @param options The base options of all models evolved by this session
+	 * @param threads The number of threads used to run shark
+	 */
+	SharkSession(const Options &options, unsigned int threads);
+
+	/**
+	 * Overrides an option of the base options in all subsequent runs
+	 *
+	 * @param optspec A ``name = value`` option specification
+	 */
+	void set(const std::string &optspec);
+
+	/// Discards all options given via set()
+	void reset();
+
+	/**
+	 * Evolves a new galaxy population with the current options. Statistics
+	 * of a previous run are discarded.
+	 */
+	void run();
+
+	/// @return The output snapshots with summary statistics from the last run
+	std::vector<int> snapshots() const;
+
+	/**
+	 * Returns the values of a summary statistic of the last run. Besides
+	 * those supported by SummaryStatistics::get, "run_info/redshift" and
+	 * "run_info/effective_volume" are also supported.
+	 *
+	 * @param snapshot The output snapshot
+	 * @param name The name of the statistic
+	 * @return The values of the statistic
+	 */
+	std::vector<double> get(int snapshot, const std::string &name) const;
+
+	/// @return The summary statistics of @p snapshot from the last run
+	const SummaryStatistics &summary(int snapshot) const;
+
+	/// @return The galaxy and starburst ODE evaluations of the last run
+	unsigned long ode_evaluations() const { return last_ode_evaluations; }
+
+private:
+	Options base_options;
+	std::vector<std::string> optspecs {};
+	unsigned int threads;
+	std::shared_ptr<std::stringstream> trees;
+	std::map<int, SummaryStatistics> summaries {};
+	std::map<int, double> redshifts {};
+	double volume = 0;
+	unsigned long last_ode_evaluations = 0;
+
+	Options current_options() const;
+};
+
+}  // namespace shark
+
+#endif // SHARK_SHARK_SESSION_H_
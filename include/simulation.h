@@ -34,11 +34,16 @@
 
 namespace shark {
 
+class OptionDependencies;
+
 class SimulationParameters {
 
 public:
 	SimulationParameters(const Options &options);
 
+	/// Declares the options that don't affect the evolution of galaxies
+	static void declare_dependencies(OptionDependencies &dependencies);
+
 	float volume = 0;
 	float particle_mass = 0;
 	float lbox  =0;
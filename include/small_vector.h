@@ -0,0 +1,277 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * A vector storing its first elements inline
+ */
+
+#ifndef SHARK_SMALL_VECTOR_H
+#define SHARK_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace shark {
+
+/**
+ * A contiguous, vector-like container storing up to @p N elements inline,
+ * without any heap allocation, and switching to heap storage only when
+ * growing beyond that.
+ *
+ * This is meant for the small collections linking our structures together
+ * (e.g., the ascendants of a halo, or the galaxies of a subhalo), which
+ * normally hold only one or two elements. Only the subset of the
+ * std::vector interface used in shark is provided.
+ */
+template <typename T, std::size_t N>
+class small_vector {
+
+public:
+	typedef T value_type;
+	typedef std::size_t size_type;
+	typedef T *iterator;
+	typedef const T *const_iterator;
+	typedef T &reference;
+	typedef const T &const_reference;
+
+	/// The number of elements stored inline
+	static constexpr size_type inline_capacity = N;
+
+	small_vector() = default;
+
+	small_vector(std::initializer_list<T> values)
+	{
+		insert(end(), values.begin(), values.end());
+	}
+
+	template <typename InputIt>
+	small_vector(InputIt first, InputIt last)
+	{
+		insert(end(), first, last);
+	}
+
+	small_vector(const small_vector &other)
+	{
+		insert(end(), other.begin(), other.end());
+	}
+
+	small_vector(small_vector &&other) noexcept(std::is_nothrow_move_constructible<T>::value)
+	{
+		take(std::move(other));
+	}
+
+	~small_vector()
+	{
+		destroy();
+	}
+
+	small_vector &operator=(const small_vector &other)
+	{
+		if (this != &other) {
+			clear();
+			insert(end(), other.begin(), other.end());
+		}
+		return *this;
+	}
+
+	small_vector &operator=(small_vector &&other) noexcept(std::is_nothrow_move_constructible<T>::value)
+	{
+		if (this != &other) {
+			destroy();
+			take(std::move(other));
+		}
+		return *this;
+	}
+
+	small_vector &operator=(std::initializer_list<T> values)
+	{
+		clear();
+		insert(end(), values.begin(), values.end());
+		return *this;
+	}
+
+	iterator begin() { return elements; }
+	iterator end() { return elements + n; }
+	const_iterator begin() const { return elements; }
+	const_iterator end() const { return elements + n; }
+	const_iterator cbegin() const { return elements; }
+	const_iterator cend() const { return elements + n; }
+
+	T *data() { return elements; }
+	const T *data() const { return elements; }
+	size_type size() const { return n; }
+	size_type capacity() const { return cap; }
+	bool empty() const { return n == 0; }
+
+	/// Whether elements are currently stored inline
+	bool is_inline() const { return elements == inline_elements(); }
+
+	T &operator[](size_type i) { return elements[i]; }
+	const T &operator[](size_type i) const { return elements[i]; }
+	T &front() { return elements[0]; }
+	const T &front() const { return elements[0]; }
+	T &back() { return elements[n - 1]; }
+	const T &back() const { return elements[n - 1]; }
+
+	void reserve(size_type new_cap)
+	{
+		if (new_cap <= cap) {
+			return;
+		}
+		T *new_elements = static_cast<T *>(::operator new(new_cap * sizeof(T)));
+		for (size_type i = 0; i != n; i++) {
+			::new (new_elements + i) T(std::move(elements[i]));
+			elements[i].~T();
+		}
+		release_heap();
+		elements = new_elements;
+		cap = new_cap;
+	}
+
+	template <typename ... Args>
+	T &emplace_back(Args && ... args)
+	{
+		if (n == cap) {
+			reserve(cap * 2);
+		}
+		::new (elements + n) T(std::forward<Args>(args)...);
+		return elements[n++];
+	}
+
+	void push_back(const T &value) { emplace_back(value); }
+	void push_back(T &&value) { emplace_back(std::move(value)); }
+
+	void pop_back()
+	{
+		elements[--n].~T();
+	}
+
+	/// Inserts the elements in [first, last) before @p pos
+	template <typename InputIt>
+	iterator insert(const_iterator pos, InputIt first, InputIt last)
+	{
+		auto offset = pos - elements;
+		auto old_size = n;
+		reserve_for(first, last, typename std::iterator_traits<InputIt>::iterator_category());
+		for (; first != last; ++first) {
+			emplace_back(*first);
+		}
+		std::rotate(elements + offset, elements + old_size, elements + n);
+		return elements + offset;
+	}
+
+	iterator erase(const_iterator pos)
+	{
+		return erase(pos, pos + 1);
+	}
+
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		auto dest = const_cast<iterator>(first);
+		auto new_end = std::move(const_cast<iterator>(last), end(), dest);
+		while (end() != new_end) {
+			pop_back();
+		}
+		return dest;
+	}
+
+	void clear()
+	{
+		while (n) {
+			pop_back();
+		}
+	}
+
+private:
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[N];
+	T *elements = inline_elements();
+	std::uint32_t n = 0;
+	std::uint32_t cap = N;
+
+	T *inline_elements()
+	{
+		return reinterpret_cast<T *>(storage);
+	}
+
+	const T *inline_elements() const
+	{
+		return reinterpret_cast<const T *>(storage);
+	}
+
+	template <typename InputIt>
+	void reserve_for(InputIt first, InputIt last, std::forward_iterator_tag)
+	{
+		auto needed = n + size_type(std::distance(first, last));
+		if (needed > cap) {
+			reserve(std::max(needed, size_type(cap) * 2));
+		}
+	}
+
+	template <typename InputIt>
+	void reserve_for(InputIt, InputIt, std::input_iterator_tag)
+	{
+		// no-op, elements are counted as they are inserted
+	}
+
+	void release_heap()
+	{
+		if (!is_inline()) {
+			::operator delete(elements);
+		}
+	}
+
+	void destroy()
+	{
+		clear();
+		release_heap();
+		elements = inline_elements();
+		cap = N;
+	}
+
+	void take(small_vector &&other)
+	{
+		if (other.is_inline()) {
+			for (auto &value: other) {
+				emplace_back(std::move(value));
+			}
+			other.clear();
+			return;
+		}
+		elements = other.elements;
+		n = other.n;
+		cap = other.cap;
+		other.elements = other.inline_elements();
+		other.n = 0;
+		other.cap = N;
+	}
+};
+
+}  // namespace shark
+
+#endif // SHARK_SMALL_VECTOR_H
@@ -0,0 +1,97 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * A non-owning view over contiguous elements
+ */
+
+#ifndef SHARK_SPAN_H
+#define SHARK_SPAN_H
+
+#include <cstddef>
+
+namespace shark {
+
+/**
+ * A non-owning, read-only view over a contiguous sequence of elements,
+ * similar to C++20's std::span. Views are cheap to copy, and allocate
+ * nothing.
+ */
+template <typename T>
+class span {
+
+public:
+	typedef T value_type;
+	typedef const T *iterator;
+
+	span() : first(nullptr), last(nullptr) {}
+	span(const T *first, const T *last) : first(first), last(last) {}
+
+	/// Views the elements of any contiguous container (e.g., std::vector, small_vector)
+	template <typename Container>
+	span(const Container &c) : first(c.data()), last(c.data() + c.size()) {}
+
+	iterator begin() const { return first; }
+	iterator end() const { return last; }
+	std::size_t size() const { return last - first; }
+	bool empty() const { return first == last; }
+	const T &operator[](std::size_t i) const { return first[i]; }
+
+private:
+	const T *first;
+	const T *last;
+};
+
+/**
+ * Like span, but allowing the viewed elements to be modified, e.g., by
+ * functions that fill caller-provided buffers.
+ */
+template <typename T>
+class mutable_span {
+
+public:
+	typedef T value_type;
+	typedef T *iterator;
+
+	mutable_span() : first(nullptr), last(nullptr) {}
+	mutable_span(T *first, T *last) : first(first), last(last) {}
+	mutable_span(T *first, std::size_t size) : first(first), last(first + size) {}
+
+	/// Views the elements of any contiguous container (e.g., std::vector, small_vector)
+	template <typename Container>
+	mutable_span(Container &c) : first(c.data()), last(c.data() + c.size()) {}
+
+	iterator begin() const { return first; }
+	iterator end() const { return last; }
+	T *data() const { return first; }
+	std::size_t size() const { return last - first; }
+	bool empty() const { return first == last; }
+	T &operator[](std::size_t i) const { return first[i]; }
+
+private:
+	T *first;
+	T *last;
+};
+
+}  // namespace shark
+
+#endif // SHARK_SPAN_H
@@ -0,0 +1,123 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Selection of the merger trees whose roots lie within a region of space
+ */
+
+#ifndef SHARK_SPATIAL_SELECTION_H_
+#define SHARK_SPATIAL_SELECTION_H_
+
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+#include "components.h"
+
+namespace shark {
+
+/**
+ * A region of the simulated volume, either a box or a sphere, that selects
+ * the merger trees whose root halos lie within it. Positions are compared as
+ * they are, without wrapping them around the periodic boundaries of the
+ * simulation box.
+ */
+class SpatialSelection {
+
+public:
+
+	/**
+	 * The shape of the region:
+	 * NONE: no region, all trees are selected.
+	 * BOX: an axis-aligned box, given by its minimum and maximum x, y and z.
+	 * SPHERE: a sphere, given by the x, y and z of its centre and its radius.
+	 */
+	enum shape_t {
+		NONE = 0,
+		BOX,
+		SPHERE
+	};
+
+	/// A selection of all trees
+	SpatialSelection() = default;
+
+	/**
+	 * Constructor.
+	 *
+	 * @param shape The shape of the region
+	 * @param region The minimum x, y and z and the maximum x, y and z of a
+	 * box, or the x, y and z of the centre and the radius of a sphere
+	 * [cMpc/h]. Empty if @p shape is NONE.
+	 */
+	SpatialSelection(shape_t shape, const std::vector<double> &region);
+
+	/// Whether only some trees are selected
+	bool enabled() const
+	{
+		return shape != NONE;
+	}
+
+	shape_t get_shape() const
+	{
+		return shape;
+	}
+
+	const std::vector<double> &get_region() const
+	{
+		return region;
+	}
+
+	/// Whether the position (@p x, @p y, @p z) lies within the region
+	bool contains(double x, double y, double z) const;
+
+	/**
+	 * Finds the rows of a merger tree file that belong to the trees whose
+	 * root halos lie within the region, using only the snapshot, host halo
+	 * and descendant host halo of each row.
+	 *
+	 * Trees have a root halo in @p root_snapshot, whose position is that of
+	 * its first row. Halos in earlier snapshots are selected if they descend
+	 * into a selected halo, and halos in later snapshots if a selected halo
+	 * descends into them, which is what building merger trees out of all rows
+	 * would link together.
+	 *
+	 * @param snapshots The snapshot of each row
+	 * @param host_halos The id of the host halo of each row
+	 * @param descendant_halos The id of the descendant host halo of each row
+	 * @param root_positions The x, y and z of each row in @p root_snapshot,
+	 * in row order
+	 * @param root_snapshot The snapshot of the root halos
+	 * @return The indices of the selected rows, in increasing order
+	 */
+	std::vector<std::size_t> tree_rows(const std::vector<int> &snapshots, const std::vector<Halo::id_t> &host_halos,
+	                                   const std::vector<Halo::id_t> &descendant_halos, const std::vector<float> &root_positions,
+	                                   int root_snapshot) const;
+
+private:
+	shape_t shape = NONE;
+	std::vector<double> region {};
+};
+
+std::ostream &operator<<(std::ostream &os, const SpatialSelection &selection);
+
+}  // namespace shark
+
+#endif // SHARK_SPATIAL_SELECTION_H_
@@ -27,14 +27,19 @@
 #define INCLUDE_STAR_FORMATION_H_
 
 #include <memory>
+#include <vector>
 
+#include "components.h"
 #include "cosmology.h"
 #include "integrator.h"
 #include "options.h"
 #include "recycling.h"
+#include "star_formation_table.h"
 
 namespace shark {
 
+struct galaxy_properties_for_integration;
+
 class StarFormationParameters {
 
 public:
@@ -52,6 +57,9 @@ public:
 	 * clump_factor_KMT09: clumping factor of the ISM for the Krumholz+ models.
 	 * sigma_crit_KMT09: critical gas surface density above which the SF law becomes superlinear in the KMT09 model.
 	 * angular_momentum_transfer: boolean parameter indicating whether the user wants to trigger the calculation of angular momentum transfer within the disk.
+	 * tabulated_integrals: whether the radial integrals of the SFR surface density are interpolated from a table built at startup instead of calculated each time.
+	 * table_points_per_dex: density of the grid of the tabulated integrals.
+	 * fixed_quadrature: whether the radial integrals are first attempted with a fixed-order Gauss-Kronrod rule, falling back to adaptive quadrature when its error estimate exceeds Accuracy_SFeqs.
 	 *
 	 */
 	enum StarFormationModel {
@@ -74,6 +82,11 @@ public:
 	double sigma_crit_KMT09 = 0;
 
 	bool angular_momentum_transfer = false;
+
+	bool tabulated_integrals = false;
+	unsigned int table_points_per_dex = 10;
+
+	bool fixed_quadrature = false;
 };
 
 
@@ -94,14 +107,55 @@ public:
 
 	typedef double (*func_t)(double x, void *);
 
+	/**
+	 * The sizes of a galaxy's disk, which remain constant while its star
+	 * formation rate is repeatedly calculated during its evolution.
+	 */
+	struct disk_properties {
+		/// Gas and stellar half-mass radii, in comoving units
+		double rgas;
+		double rstars;
+		/// Gas and stellar scale lengths, in physical units
+		double re;
+		double rse;
+	};
+
+	/**
+	 * Calculates the disk properties of a galaxy with half-mass radii
+	 * @p rgas and @p rstars (in comoving units) at redshift @p z.
+	 */
+	disk_properties get_disk_properties(double rgas, double rstars, double z) const;
+
 	/**
 	 * All input quantities should be in comoving units.
 	 */
 	double star_formation_rate(double mcold, double mstars, double rgas, double rstars, double zgas, double z,
 							   bool burst, double vgal, double &jrate, double jgas);
 
+	/**
+	 * As above, with the disk properties of the galaxy calculated in advance
+	 * by get_disk_properties.
+	 */
+	double star_formation_rate(double mcold, double mstars, const disk_properties &disk, double zgas,
+							   bool burst, double vgal, double &jrate, double jgas);
+
 	double star_formation_rate_surface_density(double r, void * params);
 
+	/**
+	 * Batch versions of the surface density profiles and the functions they
+	 * use, evaluating `n` radii (or surface densities) at once into
+	 * the given output array. Their loops are written to be vectorised, and
+	 * are used by the fixed-order quadrature to evaluate all its nodes at once.
+	 */
+	///@{
+	void star_formation_rate_surface_density(const double r[], std::size_t n, const galaxy_properties_for_integration &props, double sfr_density[]);
+	void molecular_surface_density(const double r[], std::size_t n, const galaxy_properties_for_integration &props, double mol_density[]);
+	void fmol(const double Sigma_gas[], const double Sigma_stars[], double zgas, const double r[], std::size_t n, double fmol[]);
+	void midplane_pressure(const double Sigma_gas[], const double Sigma_stars[], const double r[], std::size_t n, double pressure[]);
+	void kmt09_fmol(double zgas, const double sigma_gas[], std::size_t n, double func[]);
+	void k13_fmol(double zgas, const double sigma_gas[], std::size_t n, double func[]);
+	///@}
+
 	double manual_integral(func_t f, void * params, double rmin, double rmax);
 
 	double fmol(double Sigma_gas, double Sigma_stars, double zgas, double r);
@@ -115,18 +169,35 @@ public:
 	double k13_fmol(double zgas, double sigma_gas);
 
 	unsigned long int get_integration_intervals() {
-		return integrator.get_num_intervals();
+		return integration_intervals;
 	}
 
 	void reset_integration_intervals() {
-		return integrator.reset_num_intervals();
+		integration_intervals = 0;
+		integrations = 0;
+		integration_failures = 0;
+	}
+
+	/// The number of adaptive integrations performed, and of those that
+	/// failed and fell back to a cruder one, since the last reset
+	unsigned long int get_integrations() {
+		return integrations;
+	}
+
+	unsigned long int get_integration_failures() {
+		return integration_failures;
 	}
 
-	double molecular_hydrogen(double mcold, double mstars, double rgas, double rstars, double zgas, double z, double &jmol,  double jgas, double vgal, bool bulge, bool jcalc);
+	/**
+	 * The molecular gas mass of a disk or bulge. If @p approximate the H2
+	 * surface density is integrated with a single application of the
+	 * fixed-order quadrature rule, whatever its estimated error.
+	 */
+	double molecular_hydrogen(double mcold, double mstars, double rgas, double rstars, double zgas, double z, double &jmol,  double jgas, double vgal, bool bulge, bool jcalc, bool approximate = false);
 
 	double molecular_surface_density(double r, void * params);
 
-	molecular_gas get_molecular_gas(const GalaxyPtr &galaxy, double z, bool jcalc);
+	molecular_gas get_molecular_gas(const GalaxyPtr &galaxy, double z, bool jcalc, bool approximate = false);
 
 	double ionised_gas_fraction(double mgas, double rgas, double z);
 
@@ -134,12 +205,79 @@ private:
 	StarFormationParameters parameters;
 	RecyclingParameters recycleparams;
 	CosmologyPtr cosmology;
-	Integrator integrator;
+
+	// Integrations borrow the Integrator of the calling thread,
+	// but the intervals they use are counted per object
+	static constexpr std::size_t max_integration_intervals = 1000;
+	unsigned long int integration_intervals = 0;
+	unsigned long int integrations = 0;
+	unsigned long int integration_failures = 0;
+
+	// Immutable, and therefore shared by all copies of this object
+	std::shared_ptr<const StarFormationTable> integrals_table;
+
+	// Scratch space for the batch evaluation of surface densities
+	std::vector<double> sigma_gas_values;
+	std::vector<double> sigma_stars_values;
+	std::vector<double> fmol_values;
+
+	typedef void (StarFormation::*batch_density_t)(const double r[], std::size_t n, const galaxy_properties_for_integration &props, double values[]);
+
+	void surface_densities(const double r[], std::size_t n, const galaxy_properties_for_integration &props);
+	bool integrate_fixed(batch_density_t density, const galaxy_properties_for_integration &props, std::size_t n, double epsrel, double result[]);
+
+	double integrate(func_t f, galaxy_properties_for_integration &props, double epsrel, const char *name);
+	void integrate(Integrator::vector_func_t f, func_t f0, func_t f1, galaxy_properties_for_integration &props, double epsrel,
+	               const char *name, double &i0, double &i1);
+	void table_integrals(const std::vector<double> &coords, double &i0, double &i1);
+	std::shared_ptr<const StarFormationTable> create_integrals_table();
+	bool tabulated_integrals(const galaxy_properties_for_integration &props, double &sfr, double &jsfr) const;
 
 };
 
-/// A collection of galaxy-indexed molecular gas objects
-typedef std::map<GalaxyPtr, StarFormation::molecular_gas> molgas_per_galaxy;
+/**
+ * A collection of galaxy-indexed molecular gas objects.
+ *
+ * Galaxy IDs are handed out contiguously starting from 0, so objects are
+ * stored in a flat vector addressed directly by galaxy ID. Since each galaxy
+ * owns its own slot, different threads can fill this container concurrently
+ * without synchronisation, as long as it has been sized up-front.
+ */
+class molgas_per_galaxy {
+
+public:
+	molgas_per_galaxy() = default;
+
+	/**
+	 * Creates a collection with enough room for galaxies with IDs in
+	 * @p [0, n_galaxy_ids)
+	 *
+	 * @param n_galaxy_ids The number of galaxy IDs this collection can hold
+	 */
+	explicit molgas_per_galaxy(std::size_t n_galaxy_ids) :
+		values(n_galaxy_ids)
+	{
+		// no-op
+	}
+
+	StarFormation::molecular_gas &operator[](const GalaxyPtr &galaxy)
+	{
+		return values[galaxy->id];
+	}
+
+	const StarFormation::molecular_gas &at(const GalaxyPtr &galaxy) const
+	{
+		return values.at(galaxy->id);
+	}
+
+	std::size_t size() const
+	{
+		return values.size();
+	}
+
+private:
+	std::vector<StarFormation::molecular_gas> values {};
+};
 
 }  // namespace shark
 
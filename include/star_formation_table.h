@@ -0,0 +1,106 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Tabulated star formation integrals
+ */
+
+#ifndef SHARK_STAR_FORMATION_TABLE_H_
+#define SHARK_STAR_FORMATION_TABLE_H_
+
+#include <functional>
+#include <vector>
+
+namespace shark {
+
+/**
+ * A table of the two radial integrals of the SFR surface density used by
+ * StarFormation (that of the SFR itself, and that weighted by radius used for
+ * the angular momentum transfer) over a regular grid of log10 coordinates.
+ * Values are stored in log10 and linearly interpolated between grid points.
+ */
+class StarFormationTable {
+
+public:
+
+	/**
+	 * A regular axis of the table, in log10 coordinates
+	 */
+	struct axis {
+		double min;
+		double max;
+		unsigned int n;
+
+		double at(unsigned int i) const {
+			return min + (max - min) * i / (n - 1);
+		}
+	};
+
+	/**
+	 * The function calculating the two integrals at the given log10 coordinates
+	 */
+	typedef std::function<void(const std::vector<double> &, double &, double &)> integrals_t;
+
+	/**
+	 * Creates a new table, calculating its values with @p integrals
+	 *
+	 * @param axes The axes of the table, at least two points each
+	 * @param integrals The function used to calculate the tabulated integrals
+	 */
+	StarFormationTable(std::vector<axis> axes, const integrals_t &integrals);
+
+	/**
+	 * Interpolates both integrals at the given log10 coordinates.
+	 *
+	 * @param coords The log10 coordinates, one per axis
+	 * @param i0 The interpolated SFR integral
+	 * @param i1 The interpolated radius-weighted SFR integral
+	 * @return Whether the coordinates were within the table and the table
+	 * had only positive values around them. If false, @p i0 and @p i1 are
+	 * left untouched.
+	 */
+	bool get(const std::vector<double> &coords, double &i0, double &i1) const;
+
+	/**
+	 * Calculates the maximum relative error of the interpolated values with
+	 * respect to @p integrals, evaluated at the center of (at most
+	 * @p max_samples evenly spread) grid cells.
+	 */
+	double max_relative_error(const integrals_t &integrals, std::size_t max_samples) const;
+
+	/**
+	 * @return The number of grid points of this table
+	 */
+	std::size_t size() const {
+		return log_i0.size();
+	}
+
+private:
+	std::vector<axis> axes;
+	std::vector<std::size_t> strides;
+	std::vector<double> log_i0;
+	std::vector<double> log_i1;
+};
+
+}  // namespace shark
+
+#endif // SHARK_STAR_FORMATION_TABLE_H_
@@ -0,0 +1,153 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * A live status file describing the progress of an execution
+ */
+
+#ifndef SHARK_STATUS_FILE_H_
+#define SHARK_STATUS_FILE_H_
+
+#include <cstddef>
+#include <ctime>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "timer.h"
+
+namespace shark {
+
+/**
+ * A small JSON file describing where an execution is and how fast it is
+ * progressing, rewritten after every phase and evolved snapshot so batch
+ * schedulers and dashboards can poll it. The file is replaced atomically,
+ * so readers never see a partially written status.
+ */
+class StatusFile {
+
+public:
+
+	/**
+	 * Constructor. Writes the initial status into @p filename.
+	 *
+	 * @param filename The file where the status is written
+	 * @param model The name of the model being evolved
+	 * @param batch_groups The number of batch groups evolved one after the other
+	 */
+	StatusFile(const std::string &filename, const std::string &model, std::size_t batch_groups);
+
+	/**
+	 * Starts processing a new batch group.
+	 *
+	 * @param group The index of the batch group
+	 */
+	void start_batch_group(std::size_t group);
+
+	/**
+	 * Sets the number of snapshots that will be evolved for the current
+	 * batch group, once its merger trees are imported.
+	 *
+	 * @param snapshots The number of snapshots to evolve
+	 */
+	void set_group_snapshots(int snapshots);
+
+	/**
+	 * Records that the execution moved into a new phase.
+	 *
+	 * @param phase The name of the phase
+	 * @param snapshot The snapshot being evolved, if any
+	 */
+	void phase(const std::string &phase, int snapshot = -1);
+
+	/**
+	 * Records the evolution of a snapshot.
+	 *
+	 * @param snapshot The evolved snapshot
+	 * @param n_galaxies The number of galaxies evolved in the snapshot
+	 * @param duration_millis The wall time spent on the snapshot [ms]
+	 * @param ode_evaluations The ODE evaluations of all evolved snapshots
+	 * @param rss The current resident set size [bytes]
+	 * @param peak_rss The peak resident set size [bytes]
+	 */
+	void snapshot_evolved(int snapshot, std::size_t n_galaxies, Timer::duration duration_millis,
+	                      unsigned long ode_evaluations, std::size_t rss, std::size_t peak_rss);
+
+	/// Records that the execution finished
+	void finish();
+
+	/**
+	 * Estimates the wall time left until the execution finishes, from the
+	 * trend of the durations of the last evolved snapshots of the current
+	 * batch group and from the duration of the earlier batch groups.
+	 *
+	 * @return The estimated time to completion [s], or a negative number if
+	 * no snapshot has been evolved yet
+	 */
+	double eta_seconds() const;
+
+	/**
+	 * Writes the status as a JSON object.
+	 *
+	 * @param os The stream to write into
+	 * @param now The time at which the status is written
+	 */
+	void write(std::ostream &os, std::time_t now) const;
+
+	/// The number of evolved snapshot durations used to extrapolate the ETA
+	static constexpr std::size_t trend_snapshots = 8;
+
+private:
+	std::string filename;
+	std::string model;
+	std::string current_phase {"starting"};
+	int snapshot = -1;
+	std::size_t batch_group = 0;
+	std::size_t batch_groups;
+	int group_snapshots = 0;
+	double galaxies_per_second = 0;
+	unsigned long ode_evaluations = 0;
+	std::size_t rss = 0;
+	std::size_t peak_rss = 0;
+	bool finished = false;
+
+	Timer start_t;
+	Timer group_t;
+
+	/// The wall time of each evolved snapshot of the current batch group [ms]
+	std::vector<double> group_durations {};
+
+	/// The wall time of each completed batch group [ms]
+	std::vector<double> completed_groups {};
+
+	/// Estimated wall time left for the current batch group [ms]
+	double group_remaining_millis() const;
+
+	/// Replaces the file with the current status, logging failures
+	void update();
+
+	/// Replaces the file with the current status, throwing on failures
+	void write_file() const;
+};
+
+}  // namespace shark
+
+#endif // SHARK_STATUS_FILE_H_
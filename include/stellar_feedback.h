@@ -82,6 +82,33 @@ class StellarFeedback {
 public:
 	StellarFeedback(StellarFeedbackParameters parameters);
 
+	/**
+	 * The parts of the outflow rate of a galaxy that depend only on its
+	 * velocity and redshift, and therefore remain constant while it evolves.
+	 */
+	struct outflow_factors {
+		/// Mass loading of the gas reheated from the galaxy, before capping
+		double reheating = 0;
+		/// Ratio between the feedback energy and the binding energy of the halo
+		double ejection = 0;
+	};
+
+	/**
+	 * Calculates the outflow factors of a galaxy.
+	 *
+	 * @param vsubh The virial velocity of the host subhalo [km/s]
+	 * @param vgal The velocity of the galaxy [km/s]
+	 * @param z The redshift
+	 */
+	outflow_factors get_outflow_factors(double vsubh, double vgal, double z) const;
+
+	/**
+	 * Calculates the mass and angular momentum loading of the outflows of a
+	 * galaxy forming stars at a rate @p sfr, using its precalculated
+	 * outflow @p factors.
+	 */
+	void outflow_rate(double sfr, const outflow_factors &factors, double &b1, double &b2, double &bj_1, double &bj_2) const;
+
 	void outflow_rate(double sfr, double vsubh, double vgal, double z, double &b1, double &b2, double &b_1, double &bj_2);
 
 private:
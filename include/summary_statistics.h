@@ -0,0 +1,132 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Header file for the SummaryStatistics class
+ */
+
+#ifndef SHARK_SUMMARY_STATISTICS_H_
+#define SHARK_SUMMARY_STATISTICS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "components.h"
+#include "hdf5/writer.h"
+#include "star_formation.h"
+
+namespace shark {
+
+/**
+ * Statistics of a galaxy population commonly used to calibrate the model:
+ * stellar, atomic and molecular gas mass functions, the stellar size-mass
+ * relation and the star formation rate density. All distributions use the
+ * same logarithmic mass bins.
+ *
+ * Statistics are accumulated one galaxy at a time, and partial statistics
+ * (e.g., those of different threads) can be combined with merge().
+ */
+class SummaryStatistics {
+
+public:
+
+	/**
+	 * Creates empty statistics
+	 *
+	 * @param log_mass_min The lower edge of the first bin, in log10(M [Msun/h])
+	 * @param log_mass_max The upper edge of the last bin, in log10(M [Msun/h])
+	 * @param bin_width The width of each bin [dex]
+	 */
+	SummaryStatistics(double log_mass_min, double log_mass_max, double bin_width);
+
+	/**
+	 * Collects the statistics of all galaxies in @p halos. Each thread
+	 * accumulates the galaxies of a fixed set of halos, and partial statistics
+	 * are merged in thread order so results are reproducible.
+	 */
+	static SummaryStatistics collect(const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal,
+	                                 double log_mass_min, double log_mass_max, double bin_width, unsigned int threads);
+
+	/**
+	 * Adds @p galaxy, whose molecular gas content is @p molgas, counting it
+	 * @p weight times (see MergerTree::weight)
+	 */
+	void add(const Galaxy &galaxy, const StarFormation::molecular_gas &molgas, double weight = 1);
+
+	/// Adds the statistics of @p other, which must use the same bins
+	void merge(const SummaryStatistics &other);
+
+	/**
+	 * Writes these statistics, normalising distributions by @p volume
+	 *
+	 * @param file The file to write to
+	 * @param redshift The redshift of the galaxies
+	 * @param volume The volume where the galaxies reside [(cMpc/h)^3]
+	 */
+	void write(hdf5::Writer &file, double redshift, double volume) const;
+
+	/**
+	 * Returns the values of one of the statistics written by write(), like
+	 * "stellar_mass_function/phi" or "sfr_density". Scalars are returned as
+	 * single-element vectors.
+	 *
+	 * @param name The name of the statistic, as written by write()
+	 * @param volume The volume where the galaxies reside [(cMpc/h)^3]
+	 * @return The values of the statistic
+	 */
+	std::vector<double> get(const std::string &name, double volume) const;
+
+	/// The bin index of @p mass, or -1 if it falls outside all bins
+	int bin(double mass) const;
+
+	/// @return The centres of all bins, in log10(M [Msun/h])
+	std::vector<double> bin_centres() const;
+
+	double log_mass_min;
+	double bin_width;
+	std::size_t n_bins;
+
+	/// Weighted number of galaxies per bin of stellar, atomic and molecular
+	/// gas mass
+	std::vector<double> stellar_mass_counts;
+	std::vector<double> atomic_mass_counts;
+	std::vector<double> molecular_mass_counts;
+
+	/// Weighted sums of log10 of the stellar half-mass radius [cMpc/h], and
+	/// of its square, per stellar mass bin, over the galaxies with a non-zero
+	/// size
+	std::vector<double> size_counts;
+	std::vector<double> log_rstar_sum;
+	std::vector<double> log_rstar_sum2;
+
+	/// Weighted total star formation rate [Msun/Gyr/h], and number of
+	/// galaxies actually added
+	double total_sfr = 0;
+	std::int64_t n_galaxies = 0;
+
+private:
+	void size_moments(std::vector<double> &mean, std::vector<double> &stddev) const;
+};
+
+}  // namespace shark
+
+#endif // SHARK_SUMMARY_STATISTICS_H_
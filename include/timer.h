@@ -60,6 +60,17 @@ public:
 		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
 	}
 
+	/**
+	 * Like get(), but with microsecond resolution, which is useful when
+	 * accumulating many short measurements
+	 *
+	 * @return The time elapsed since the creation of the timer, in [us]
+	 */
+	inline
+	duration get_micros() const {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+	}
+
 private:
 	std::chrono::steady_clock::time_point t0;
 
@@ -0,0 +1,127 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Speed/accuracy tuning of the numerical tolerances of galaxy evolution
+ */
+
+#ifndef SHARK_TOLERANCE_TUNER_H_
+#define SHARK_TOLERANCE_TUNER_H_
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "options.h"
+#include "summary_statistics.h"
+#include "timer.h"
+
+namespace shark {
+
+/// The tolerances tried by a ToleranceTuner
+struct ToleranceSettings {
+	/// execution.ode_solver_precision
+	double ode_solver_precision;
+	/// star_formation.accuracy_sf_eqs
+	double accuracy_sf_eqs;
+};
+
+/// The cost and accuracy of evolving the same merger trees with some tolerances
+struct ToleranceTrial {
+	ToleranceSettings settings;
+	unsigned long ode_evaluations;
+	Timer::duration millis;
+
+	/// Largest deviation of each key property, over all output snapshots,
+	/// from that obtained with the tightest tolerances
+	std::map<std::string, double> deviations;
+
+	/// @return The largest of all deviations
+	double max_deviation() const;
+};
+
+/**
+ * Evolves the same merger trees (usually a sample of them, see
+ * ExecutionParameters::tree_sampling_rate) with all combinations of the given
+ * ODE solver precisions and star formation integration accuracies, and
+ * measures their cost and how much the summary statistics of the resulting
+ * galaxies (see SummaryStatistics) deviate from those obtained with the
+ * tightest tolerances.
+ *
+ * Trees are imported and built only once (see SharkSession).
+ */
+class ToleranceTuner {
+
+public:
+
+	/// The properties whose deviations are measured
+	static const std::vector<std::string> properties;
+
+	/**
+	 * Creates a new tuner, importing and building the merger trees
+	 * given by @p options.
+	 *
+	 * @param options The options of the model to tune
+	 * @param threads The number of threads used to run shark
+	 * @param ode_solver_precisions The values of execution.ode_solver_precision to try
+	 * @param accuracies_sf_eqs The values of star_formation.accuracy_sf_eqs to try
+	 */
+	ToleranceTuner(const Options &options, unsigned int threads,
+	               std::vector<double> ode_solver_precisions, std::vector<double> accuracies_sf_eqs);
+
+	/**
+	 * Evolves the model with each combination of tolerances, tightest first
+	 *
+	 * @return The trials of each combination, the first of which is the
+	 * reference of all deviations
+	 */
+	std::vector<ToleranceTrial> run();
+
+	/**
+	 * Measures how much @p property deviates in @p stats from @p reference.
+	 * The deviation of a mass function is the sum of the absolute differences
+	 * of its counts over the sum of the reference counts (i.e., the fraction
+	 * of galaxies changing bins); that of the star formation rate density is
+	 * its relative difference.
+	 */
+	static double deviation(const SummaryStatistics &stats, const SummaryStatistics &reference, const std::string &property);
+
+	/**
+	 * Returns the index of the fastest trial whose properties deviate at most
+	 * @p max_deviation from the reference
+	 */
+	static std::size_t recommend(const std::vector<ToleranceTrial> &trials, double max_deviation);
+
+	/// Writes @p trials as CSV, flagging the @p recommended one
+	static void write_csv(std::ostream &os, const std::vector<ToleranceTrial> &trials, std::size_t recommended);
+
+private:
+	Options options;
+	unsigned int threads;
+	std::vector<double> ode_solver_precisions;
+	std::vector<double> accuracies_sf_eqs;
+};
+
+}  // namespace shark
+
+#endif // SHARK_TOLERANCE_TUNER_H_
@@ -0,0 +1,152 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Recording of timelines in the Chrome trace-event format
+ */
+
+#ifndef SHARK_TRACING_H_
+#define SHARK_TRACING_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace shark {
+
+namespace tracing {
+
+/**
+ * A span of time spent by one thread in a stage, phase or task. Names,
+ * categories and argument names are not copied, and thus must be string
+ * literals.
+ */
+struct event {
+	const char *name;
+	const char *category;
+	/// The name of the single argument of the event, or nullptr if it has none
+	const char *arg_name;
+	std::int64_t arg;
+	/// The begin and end of the event, in [ns] since an arbitrary origin
+	std::int64_t begin;
+	std::int64_t end;
+};
+
+/**
+ * The events recorded by a single thread. Each thread appends only to its own
+ * buffer, without locks or atomics.
+ */
+struct thread_events {
+	/// The identifier of the thread in traces, given in order of registration
+	unsigned int tid;
+	std::vector<event> events;
+};
+
+/// @return The current time in [ns], as used in events
+inline
+std::int64_t now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Discards all events recorded so far and starts recording new ones. Like
+ * stop(), it must not be called while other threads are recording events.
+ */
+void start();
+
+/// Stops recording events, keeping those recorded so far
+void stop();
+
+/// @return Whether events are being recorded
+bool enabled();
+
+/// @return The events of the calling thread, which are created on first use
+thread_events &local_events();
+
+/**
+ * Records the time between its creation and destruction as an event of the
+ * calling thread. Nothing is recorded, and no time is taken, when tracing is
+ * not enabled at creation.
+ */
+class scoped_event {
+
+public:
+
+	scoped_event(const char *name, const char *category, const char *arg_name = nullptr, std::int64_t arg = 0) :
+		name(name), category(category), arg_name(arg_name), arg(arg),
+		begin(enabled() ? now() : -1)
+	{
+		// no-op
+	}
+
+	~scoped_event()
+	{
+		finish();
+	}
+
+	/// Records the event now instead of at destruction
+	void finish()
+	{
+		if (begin >= 0) {
+			local_events().events.push_back(event {name, category, arg_name, arg, begin, now()});
+			begin = -1;
+		}
+	}
+
+	scoped_event(const scoped_event &) = delete;
+	scoped_event &operator=(const scoped_event &) = delete;
+
+private:
+	const char *name;
+	const char *category;
+	const char *arg_name;
+	std::int64_t arg;
+	std::int64_t begin;
+};
+
+/**
+ * Writes the events of all threads as a JSON Chrome trace-event document,
+ * which can be opened in Perfetto (https://ui.perfetto.dev) or
+ * chrome://tracing. It must not be called while other threads are recording
+ * events.
+ *
+ * @param os The stream to write into
+ * @param pid The process identifier given to all events
+ */
+void write_chrome_trace(std::ostream &os, int pid = 0);
+
+/**
+ * Like write_chrome_trace(std::ostream &, int), but writing into a file.
+ *
+ * @param filename The file to write into
+ * @param pid The process identifier given to all events
+ */
+void write_chrome_trace(const std::string &filename, int pid = 0);
+
+}  // namespace tracing
+
+}  // namespace shark
+
+#endif // SHARK_TRACING_H_
@@ -47,6 +47,7 @@ public:
 protected:
 
 	ExecutionParameters &get_exec_params();
+	unsigned int get_threads() const;
 
 	virtual void loop_through_halos(const std::vector<HaloPtr> &halos) = 0;
 
@@ -55,6 +56,8 @@ protected:
 
 private:
 	void ensure_trees_are_self_contained(const std::vector<MergerTreePtr> &trees) const;
+	void prune_trees(std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params, Cosmology &cosmology, TotalBaryon &AllBaryons) const;
+	void sample_trees(std::vector<MergerTreePtr> &trees) const;
 	void ensure_halo_mass_growth(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
 	void spin_interpolated_halos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
 	void define_central_subhalos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
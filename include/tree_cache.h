@@ -0,0 +1,154 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Saving and loading of built merger trees
+ */
+
+#ifndef SHARK_TREE_CACHE_H_
+#define SHARK_TREE_CACHE_H_
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "components.h"
+#include "cosmology.h"
+#include "dark_matter_halos.h"
+#include "execution.h"
+#include "simulation.h"
+
+namespace shark {
+
+/**
+ * A binary cache of the merger trees built by a TreeBuilder, so executions
+ * over the same input data can skip reading and building them again.
+ *
+ * Trees are stored as flat arrays of fixed-size halo and subhalo records,
+ * with links between them expressed as indices into these arrays. Loading
+ * them is therefore a matter of a few bulk reads followed by the creation of
+ * the objects, without any parsing or searching.
+ *
+ * Each cache has a key identifying the input files and the options used to
+ * build its trees (see make_key); caches with a different key are ignored.
+ */
+class TreeCache {
+
+public:
+
+	/// The key of the cached trees
+	std::uint64_t key = 0;
+
+	/**
+	 * Calculates a checksum of the contents of @p filename
+	 *
+	 * @param filename The name of the file
+	 * @return The checksum of the file contents
+	 */
+	static std::uint64_t checksum(const std::string &filename);
+
+	/**
+	 * Calculates the key of the merger trees built from @p tree_files with
+	 * the given parameters. It considers the contents of the files and all
+	 * the options that change the halos, subhalos and trees that are built
+	 * (snapshot range, dark matter halo profile and concentration models,
+	 * cosmology, etc.), but not those that only affect the evolution of
+	 * galaxies.
+	 *
+	 * @param tree_files The merger tree files the trees are read from
+	 * @param exec_params The execution parameters
+	 * @param sim_params The simulation parameters
+	 * @param dark_matter_halo_params The dark matter halo parameters
+	 * @param cosmo_params The cosmological parameters
+	 * @return The key of the merger trees
+	 */
+	static std::uint64_t make_key(const std::vector<std::string> &tree_files, const ExecutionParameters &exec_params,
+	                              const SimulationParameters &sim_params, const DarkMatterHaloParameters &dark_matter_halo_params,
+	                              const CosmologicalParameters &cosmo_params);
+
+	/**
+	 * Writes @p merger_trees into @p filename under this cache's key.
+	 *
+	 * Caches are written in the host's native binary format, and are
+	 * therefore meant to be read only by the same shark build on the same
+	 * kind of machine.
+	 *
+	 * @param filename The name of the cache file
+	 * @param merger_trees The merger trees, as built by a TreeBuilder and
+	 * before any galaxy is created in them
+	 * @param all_baryons The global baryon tracking object, whose baryons
+	 * created over time are calculated while building the trees
+	 */
+	void write(const std::string &filename, const std::vector<MergerTreePtr> &merger_trees, const TotalBaryon &all_baryons) const;
+
+	/**
+	 * Like write(const std::string &, const std::vector<MergerTreePtr> &, const TotalBaryon &) const,
+	 * but writing into @p os, e.g., to keep the cached trees in memory.
+	 *
+	 * @param os The stream to write to
+	 * @param name The name of the cache, used only for reporting
+	 * @param merger_trees The merger trees
+	 * @param all_baryons The global baryon tracking object
+	 */
+	void write(std::ostream &os, const std::string &name, const std::vector<MergerTreePtr> &merger_trees, const TotalBaryon &all_baryons) const;
+
+	/**
+	 * Reads the merger trees stored in @p filename, if it exists and was
+	 * written under this cache's key.
+	 *
+	 * @param filename The name of the cache file
+	 * @param merger_trees Where the merger trees are loaded into
+	 * @param all_baryons The global baryon tracking object, whose baryons
+	 * created over time are loaded
+	 * @param threads The number of threads used to create the halos and
+	 * subhalos
+	 * @param arena_allocation Whether halos and subhalos are allocated from
+	 * per-snapshot arenas
+	 * @param local_placement Whether the halos and subhalos of each tree are
+	 * created by the thread the tree is given by a TreeAssignment, so they lie
+	 * in memory local to it
+	 * @return Whether the merger trees were loaded
+	 */
+	bool read(const std::string &filename, std::vector<MergerTreePtr> &merger_trees, TotalBaryon &all_baryons, unsigned int threads, bool arena_allocation = false, bool local_placement = false) const;
+
+	/**
+	 * Like read(const std::string &, std::vector<MergerTreePtr> &, TotalBaryon &, unsigned int, bool, bool) const,
+	 * but reading from @p is.
+	 *
+	 * @param is The stream to read from
+	 * @param name The name of the cache, used only for reporting
+	 * @param merger_trees Where the merger trees are loaded into
+	 * @param all_baryons The global baryon tracking object
+	 * @param threads The number of threads used to create the halos and
+	 * subhalos
+	 * @param arena_allocation Whether halos and subhalos are allocated from
+	 * per-snapshot arenas
+	 * @param local_placement Whether the halos and subhalos of each tree are
+	 * created by the thread the tree is given by a TreeAssignment
+	 * @return Whether the merger trees were loaded
+	 */
+	bool read(std::istream &is, const std::string &name, std::vector<MergerTreePtr> &merger_trees, TotalBaryon &all_baryons, unsigned int threads, bool arena_allocation = false, bool local_placement = false) const;
+};
+
+}  // namespace shark
+
+#endif // SHARK_TREE_CACHE_H_
@@ -0,0 +1,117 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * A flat, index-based view over merger trees
+ */
+
+#ifndef SHARK_TREE_INDEX_H
+#define SHARK_TREE_INDEX_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "components.h"
+#include "span.h"
+
+namespace shark {
+
+/**
+ * A dense, per-snapshot view over the halos and subhalos of a set of merger
+ * trees.
+ *
+ * For each snapshot the index holds the halos of all trees contiguously
+ * (grouped by tree, in tree order), the subhalos of all these halos
+ * contiguously (grouped by halo, central first), and the links between
+ * them as plain integer indices into these arrays. Iterating over a
+ * snapshot, or over the part of a snapshot belonging to a single tree,
+ * doesn't then need to look up each tree's map of halos, nor chase and
+ * copy the shared pointers linking structures.
+ *
+ * The index is built once trees are complete, and stays valid as long as
+ * their structure doesn't change. Galaxies moving across subhalos don't
+ * affect it.
+ */
+class TreeIndex {
+
+public:
+
+	typedef std::uint32_t index_t;
+
+	/// Value given to links pointing nowhere
+	static constexpr index_t none = index_t(-1);
+
+	/// All structures of a snapshot, and the links between them
+	struct snapshot_index {
+
+		/// Halos of all trees, grouped by tree
+		std::vector<HaloPtr> halos;
+
+		/// For tree @p t, its halos are those in [tree_offsets[t], tree_offsets[t + 1])
+		std::vector<index_t> tree_offsets;
+
+		/// Subhalos of all halos, grouped by halo, central first
+		std::vector<Subhalo *> subhalos;
+
+		/// For halo @p h, its subhalos are those in [subhalo_offsets[h], subhalo_offsets[h + 1])
+		std::vector<index_t> subhalo_offsets;
+
+		/// For each subhalo, the index of its host halo
+		std::vector<index_t> host_halo;
+
+		/// For each subhalo, the index of its descendant in the next snapshot, or none
+		std::vector<index_t> descendant;
+	};
+
+	/**
+	 * Builds an index over @p merger_trees
+	 */
+	explicit TreeIndex(const std::vector<MergerTreePtr> &merger_trees);
+
+	/// @return The halos of all trees at @p snapshot, grouped by tree
+	const std::vector<HaloPtr> &halos(int snapshot) const;
+
+	/// @return The halos of tree @p tree (an index into the trees given at construction time) at @p snapshot
+	span<HaloPtr> tree_halos(int snapshot, std::size_t tree) const;
+
+	/// @return All subhalos at @p snapshot, grouped by halo
+	span<Subhalo *> subhalos(int snapshot) const;
+
+	/// @return The full index of @p snapshot, or nullptr if it holds no structures
+	const snapshot_index *at(int snapshot) const;
+
+	/**
+	 * Forgets the structures of @p snapshot, so they are not kept alive by
+	 * this index once released from their merger trees
+	 */
+	void release_snapshot(int snapshot);
+
+private:
+	std::size_t n_trees;
+	std::map<int, snapshot_index> snapshots;
+	snapshot_index empty_snapshot;
+};
+
+}  // namespace shark
+
+#endif // SHARK_TREE_INDEX_H
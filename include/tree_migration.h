@@ -0,0 +1,97 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Migration of whole merger trees between processes to balance their load
+ */
+
+#ifndef SHARK_TREE_MIGRATION_H_
+#define SHARK_TREE_MIGRATION_H_
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "components.h"
+
+namespace shark {
+
+namespace tree_migration {
+
+/**
+ * Plans how much cost each process should send to each other one so that all
+ * of them end up with about the mean cost. Overloaded processes send their
+ * excess to underloaded ones, the largest excess going to the largest deficit
+ * first, so the plan is the same on all processes given the same loads.
+ *
+ * @param loads The cost of the merger trees of each process
+ * @param max_imbalance The ratio between the largest and the mean cost up to
+ * which no migration is planned
+ * @return For each process, the cost it should send to each process, or an
+ * empty vector if no migration is needed
+ */
+std::vector<std::vector<double>> plan_transfers(const std::vector<double> &loads, double max_imbalance);
+
+/**
+ * Chooses the merger trees a process sends to carry out its planned
+ * transfers. Trees are considered from the most expensive down, and each one
+ * goes to the first process whose planned cost it still fits in, so no
+ * process receives more than planned. Trees without cost always stay.
+ *
+ * @param tree_costs The cost of each merger tree of this process
+ * @param transfers The cost this process should send to each process
+ * @return The process each tree should go to, or -1 if it stays
+ */
+std::vector<int> select_trees(const std::vector<double> &tree_costs, const std::vector<double> &transfers);
+
+/**
+ * Writes @p merger_trees, and the galaxies and baryon reservoirs of their
+ * subhalos, so they can continue to be evolved from @p snapshot by another
+ * process. The structure of the trees is written as a tree cache (see
+ * TreeCache), and the state of their subhalos as in checkpoints.
+ *
+ * @param os The stream to write to
+ * @param name The name of the destination, used only for reporting
+ * @param merger_trees The merger trees, whose halos before @p snapshot must
+ * have been released already (see MergerTree::release_snapshot)
+ * @param snapshot The snapshot from which the trees will be evolved
+ */
+void write_trees(std::ostream &os, const std::string &name, const std::vector<MergerTreePtr> &merger_trees, int snapshot);
+
+/**
+ * Reads the merger trees written by write_trees, appending them to
+ * @p merger_trees. Their galaxies are given new IDs starting at
+ * @p n_galaxy_ids, so they don't clash with those of this process.
+ *
+ * @param is The stream to read from
+ * @param name The name of the source, used only for reporting
+ * @param merger_trees Where the merger trees are appended to
+ * @param n_galaxy_ids The number of galaxy IDs handed out by this process,
+ * increased by the number of galaxies read
+ * @param threads The number of threads used to create the halos and subhalos
+ */
+void read_trees(std::istream &is, const std::string &name, std::vector<MergerTreePtr> &merger_trees, Galaxy::id_t &n_galaxy_ids, unsigned int threads);
+
+}  // namespace tree_migration
+
+}  // namespace shark
+
+#endif // SHARK_TREE_MIGRATION_H_
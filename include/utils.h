@@ -44,6 +44,22 @@ namespace shark {
  */
 std::vector<std::string> tokenize(const std::string &s, const std::string &delims);
 
+/**
+ * Returns the peak resident set size (i.e., the maximum amount of physical
+ * memory) used by this process so far
+ *
+ * @return The peak resident set size in bytes, or 0 if it cannot be determined
+ */
+std::size_t peak_rss();
+
+/**
+ * Returns the current resident set size (i.e., the amount of physical memory)
+ * used by this process
+ *
+ * @return The current resident set size in bytes, or 0 if it cannot be determined
+ */
+std::size_t current_rss();
+
 /**
  * Changes string `s` to be all lower-case
  * @param s A string
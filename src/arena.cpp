@@ -0,0 +1,78 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Arena implementation
+ */
+
+#include <algorithm>
+#include <cstdint>
+
+#include "arena.h"
+
+namespace shark {
+
+constexpr std::size_t Arena::default_block_size;
+
+Arena::Arena(std::size_t block_size) :
+	block_size(block_size),
+	blocks(),
+	current(nullptr),
+	remaining(0),
+	reserved_bytes(0),
+	used_bytes(0)
+{
+}
+
+Arena::~Arena()
+{
+	for (auto &block: blocks) {
+		huge_pages::deallocate(block);
+	}
+}
+
+void *Arena::allocate(std::size_t size, std::size_t alignment)
+{
+	auto padding = [&]() {
+		auto address = reinterpret_cast<std::uintptr_t>(current);
+		return (alignment - address % alignment) % alignment;
+	};
+
+	if (!current || padding() + size > remaining) {
+		// Big objects get a block of their own
+		blocks.reserve(blocks.size() + 1);
+		auto block = huge_pages::allocate(std::max(block_size, size + alignment));
+		blocks.push_back(block);
+		current = block.data;
+		remaining = block.size;
+		reserved_bytes += block.size;
+	}
+
+	auto pad = padding();
+	void *ptr = current + pad;
+	current += pad + size;
+	remaining -= pad + size;
+	used_bytes += size;
+	return ptr;
+}
+
+}  // namespace shark
@@ -0,0 +1,134 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * BackgroundWorker implementation
+ */
+
+#include "background_worker.h"
+#include "exceptions.h"
+#include "logging.h"
+
+namespace shark {
+
+BackgroundWorker::BackgroundWorker(unsigned int max_pending_jobs) :
+	max_pending_jobs(max_pending_jobs),
+	jobs(),
+	job_running(false),
+	stopping(false),
+	error(),
+	mutex(),
+	jobs_changed(),
+	thread()
+{
+	if (max_pending_jobs == 0) {
+		throw invalid_argument("BackgroundWorker needs to allow at least one pending job");
+	}
+	thread = std::thread(&BackgroundWorker::run, this);
+}
+
+BackgroundWorker::~BackgroundWorker()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobs_changed.notify_all();
+	thread.join();
+
+	if (error) {
+		try {
+			std::rethrow_exception(error);
+		} catch (const std::exception &e) {
+			LOG(error) << "Error while running background job: " << e.what();
+		} catch (...) {
+			LOG(error) << "Unknown error while running background job";
+		}
+	}
+}
+
+void BackgroundWorker::rethrow_error()
+{
+	if (error) {
+		auto e = error;
+		error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+void BackgroundWorker::submit(job_t &&job)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobs_changed.wait(lock, [this]() {
+		return jobs.size() + (job_running ? 1 : 0) < max_pending_jobs;
+	});
+	rethrow_error();
+	jobs.emplace_back(std::move(job));
+	lock.unlock();
+	jobs_changed.notify_all();
+}
+
+void BackgroundWorker::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobs_changed.wait(lock, [this]() {
+		return jobs.empty() && !job_running;
+	});
+	rethrow_error();
+}
+
+void BackgroundWorker::run()
+{
+	while (true) {
+
+		job_t job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobs_changed.wait(lock, [this]() {
+				return stopping || !jobs.empty();
+			});
+			if (jobs.empty()) {
+				return;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			job_running = true;
+		}
+
+		std::exception_ptr job_error;
+		try {
+			job();
+		} catch (...) {
+			job_error = std::current_exception();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			job_running = false;
+			if (job_error && !error) {
+				error = job_error;
+			}
+		}
+		jobs_changed.notify_all();
+	}
+}
+
+}  // namespace shark
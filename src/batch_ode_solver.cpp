@@ -0,0 +1,227 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Batched ODE solver implementation
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include <gsl/gsl_errno.h>
+
+#include "batch_ode_solver.h"
+#include "exceptions.h"
+#include "logging.h"
+#include "profiling.h"
+
+namespace shark {
+
+namespace {
+
+// Cash-Karp coefficients, the same used by gsl_odeiv2_step_rkck
+const double ah[] = {1.0 / 5.0, 0.3, 3.0 / 5.0, 1.0, 7.0 / 8.0};
+const double b2[] = {1.0 / 5.0};
+const double b3[] = {3.0 / 40.0, 9.0 / 40.0};
+const double b4[] = {0.3, -0.9, 1.2};
+const double b5[] = {-11.0 / 54.0, 2.5, -70.0 / 27.0, 35.0 / 27.0};
+const double b6[] = {1631.0 / 55296.0, 175.0 / 512.0, 575.0 / 13824.0, 44275.0 / 110592.0, 253.0 / 4096.0};
+
+// Fifth-order solution, and its difference with the embedded fourth-order one
+const double c[] = {37.0 / 378.0, 0, 250.0 / 621.0, 125.0 / 594.0, 0, 512.0 / 1771.0};
+const double ec[] = {
+	37.0 / 378.0 - 2825.0 / 27648.0,
+	0,
+	250.0 / 621.0 - 18575.0 / 48384.0,
+	125.0 / 594.0 - 13525.0 / 55296.0,
+	-277.0 / 14336.0,
+	512.0 / 1771.0 - 0.25
+};
+
+// Standard step size control, as done by gsl_odeiv2_control_standard_new
+// with a_y = 1 and a_dydt = 0 for a method of order 4
+const double safety = 0.9;
+const double order = 4;
+
+}  // namespace
+
+BatchODESolver::BatchODESolver(std::size_t dimension, double precision, ODESolver::ode_evaluator evaluator, unsigned long int max_steps) :
+	dimension(dimension),
+	precision(precision),
+	evaluator(evaluator),
+	max_steps(max_steps),
+	t(), h(), h_step(), active(), steps(),
+	k(), y_stage(), y_new(), y_err(),
+	lane_y(dimension), lane_f(dimension)
+{
+	// no-op
+}
+
+void BatchODESolver::evaluate(std::vector<double> &f, const std::vector<double> &y, double stage_fraction, const std::vector<void *> &params)
+{
+	auto n = t.size();
+	for (std::size_t l = 0; l != n; l++) {
+		if (!active[l]) {
+			continue;
+		}
+		for (std::size_t i = 0; i != dimension; i++) {
+			lane_y[i] = y[i * n + l];
+		}
+		int status = evaluator(t[l] + stage_fraction * h_step[l], lane_y.data(), lane_f.data(), params[l]);
+		if (status != GSL_SUCCESS) {
+			throw math_error("Error while solving ODE system: user function signaled an error");
+		}
+		for (std::size_t i = 0; i != dimension; i++) {
+			f[i * n + l] = lane_f[i];
+		}
+	}
+}
+
+void BatchODESolver::combine(std::vector<double> &out, const std::vector<double> &y, const double coefficients[], std::size_t n_terms)
+{
+	// Inactive lanes have a step of 0, so they need no special treatment
+	auto n = t.size();
+	for (std::size_t i = 0; i != dimension; i++) {
+		auto offset = i * n;
+		for (std::size_t l = 0; l != n; l++) {
+			double sum = 0;
+			for (std::size_t j = 0; j != n_terms; j++) {
+				sum += coefficients[j] * k[j][offset + l];
+			}
+			out[offset + l] = y[offset + l] + h_step[l] * sum;
+		}
+	}
+}
+
+void BatchODESolver::evolve(std::vector<double> &y, const std::vector<double> &delta_t, const std::vector<void *> &params,
+                            const std::vector<double> &h_start)
+{
+	SHARK_PROFILE(ODE_SOLVER);
+
+	auto n = delta_t.size();
+	if (y.size() != n * dimension || params.size() != n || (!h_start.empty() && h_start.size() != n)) {
+		std::ostringstream os;
+		os << "Inconsistent batch sizes: " << y.size() << " values, " << n << " time steps and ";
+		os << params.size() << " parameters and " << h_start.size() << " initial steps for systems of dimension " << dimension;
+		throw invalid_argument(os.str());
+	}
+
+	// Like in a newly-created GSL driver the initial step covers the whole
+	// interval, unless told otherwise
+	t.assign(n, 0);
+	h.assign(delta_t.begin(), delta_t.end());
+	for (std::size_t l = 0; l != h_start.size(); l++) {
+		if (h_start[l] > 0 && h_start[l] < delta_t[l]) {
+			h[l] = h_start[l];
+		}
+	}
+	h_step.assign(n, 0);
+	steps.assign(n, 0);
+	active.resize(n);
+	std::transform(delta_t.begin(), delta_t.end(), active.begin(), [](double dt) {
+		return char(dt > 0);
+	});
+	for (auto &k_i: k) {
+		k_i.assign(n * dimension, 0);
+	}
+	y_stage.resize(n * dimension);
+	y_new.resize(n * dimension);
+	y_err.resize(n * dimension);
+
+	auto n_active = std::count(active.begin(), active.end(), 1);
+	while (n_active > 0) {
+
+		for (std::size_t l = 0; l != n; l++) {
+			h_step[l] = active[l] ? std::min(h[l], delta_t[l] - t[l]) : 0;
+		}
+
+		evaluate(k[0], y, 0, params);
+		combine(y_stage, y, b2, 1);
+		evaluate(k[1], y_stage, ah[0], params);
+		combine(y_stage, y, b3, 2);
+		evaluate(k[2], y_stage, ah[1], params);
+		combine(y_stage, y, b4, 3);
+		evaluate(k[3], y_stage, ah[2], params);
+		combine(y_stage, y, b5, 4);
+		evaluate(k[4], y_stage, ah[3], params);
+		combine(y_stage, y, b6, 5);
+		evaluate(k[5], y_stage, ah[4], params);
+		combine(y_new, y, c, 6);
+
+		// The error estimate doesn't depend on y, only on the k terms
+		std::fill(y_err.begin(), y_err.end(), 0);
+		combine(y_err, y_err, ec, 6);
+
+		for (std::size_t l = 0; l != n; l++) {
+			if (!active[l]) {
+				continue;
+			}
+
+			// Like in GSL, components with no tolerance (i.e., y = 0) are
+			// skipped unless their error is non-zero
+			double rmax = 0;
+			for (std::size_t i = 0; i != dimension; i++) {
+				auto idx = i * n + l;
+				double r = std::abs(y_err[idx]) / (precision * std::abs(y_new[idx]));
+				rmax = std::isnan(r) ? rmax : std::max(r, rmax);
+			}
+
+			if (rmax > 1.1) {
+				h[l] = h_step[l] * std::max(safety / std::pow(rmax, 1.0 / order), 0.2);
+				if (h[l] < std::numeric_limits<double>::epsilon() * delta_t[l]) {
+					LOG_LIMITED(warning) << "ODE: step size decreases below machine precision. Will force integration to finish regardless of desired accuracy not reached.";
+					active[l] = 0;
+					n_active--;
+				}
+				continue;
+			}
+
+			for (std::size_t i = 0; i != dimension; i++) {
+				y[i * n + l] = y_new[i * n + l];
+			}
+			steps[l]++;
+
+			bool last_step = h_step[l] == delta_t[l] - t[l];
+			t[l] = last_step ? delta_t[l] : t[l] + h_step[l];
+			if (rmax < 0.5) {
+				auto r = (rmax == 0) ? 5. : safety / std::pow(rmax, 1.0 / (order + 1.0));
+				h[l] = h_step[l] * std::min(std::max(r, 1.), 5.);
+			}
+			else {
+				h[l] = h_step[l];
+			}
+
+			if (last_step) {
+				active[l] = 0;
+				n_active--;
+			}
+			else if (steps[l] >= max_steps) {
+				LOG_LIMITED(warning) << "ODE:maximum number of steps reached. Will force integration to finish regardless of desired accuracy not reached.";
+				active[l] = 0;
+				n_active--;
+			}
+		}
+	}
+}
+
+}  // namespace shark
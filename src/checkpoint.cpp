@@ -0,0 +1,380 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Checkpoint implementation
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+#include "binary_io.h"
+#include "checkpoint.h"
+#include "exceptions.h"
+#include "logging.h"
+#include "timer.h"
+
+namespace shark {
+
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = {'S', 'H', 'A', 'R', 'K', 'C', 'K', 'P'};
+const std::uint32_t CHECKPOINT_VERSION = 8;
+
+// Galaxy and baryon components are written member by member rather than
+// as raw class instances to keep the format independent of class padding
+// and of members that are not part of the evolution state
+
+void write_baryon(binary_writer &w, const Baryon &b)
+{
+	w.write(b.mass);
+	w.write(b.mass_metals);
+	w.write(b.rscale);
+	w.write(b.sAM);
+}
+
+void read_baryon(binary_reader &r, Baryon &b)
+{
+	r.read(b.mass);
+	r.read(b.mass_metals);
+	r.read(b.rscale);
+	r.read(b.sAM);
+}
+
+void write_galaxy(binary_writer &w, const Galaxy &galaxy)
+{
+	w.write(galaxy.id);
+	w.write(galaxy.descendant_id);
+	w.write(galaxy.random_key);
+	w.write(std::int32_t(galaxy.galaxy_type));
+	write_baryon(w, galaxy.bulge_stars);
+	write_baryon(w, galaxy.bulge_gas);
+	write_baryon(w, galaxy.disk_stars);
+	write_baryon(w, galaxy.disk_gas);
+	write_baryon(w, galaxy.galaxymergers_burst_stars);
+	write_baryon(w, galaxy.galaxymergers_assembly_stars);
+	write_baryon(w, galaxy.diskinstabilities_burst_stars);
+	write_baryon(w, galaxy.diskinstabilities_assembly_stars);
+	w.write(galaxy.smbh.mass);
+	w.write(galaxy.smbh.mass_metals);
+	w.write(galaxy.smbh.macc_hh);
+	w.write(galaxy.smbh.macc_sb);
+	w.write(galaxy.sfr_disk);
+	w.write(galaxy.sfr_bulge_mergers);
+	w.write(galaxy.sfr_bulge_diskins);
+	w.write(galaxy.sfr_z_disk);
+	w.write(galaxy.sfr_z_bulge_mergers);
+	w.write(galaxy.sfr_z_bulge_diskins);
+	w.write(galaxy.mean_stellar_age);
+	w.write(galaxy.total_stellar_mass_ever_formed);
+	w.write(galaxy.vmax);
+	w.write(galaxy.history.items());
+	w.write(galaxy.interaction.major_mergers);
+	w.write(galaxy.interaction.minor_mergers);
+	w.write(galaxy.interaction.disk_instabilities);
+	w.write(galaxy.merger_age);
+	w.write(galaxy.concentration_type2);
+	w.write(galaxy.msubhalo_type2);
+	w.write(galaxy.vvir_type2);
+	w.write(galaxy.lambda_type2);
+	w.write(double(galaxy.ode_step));
+}
+
+GalaxyPtr read_galaxy(binary_reader &r)
+{
+	Galaxy::id_t id;
+	r.read(id);
+	auto galaxy = std::make_shared<Galaxy>(id);
+	r.read(galaxy->descendant_id);
+	r.read(galaxy->random_key);
+	std::int32_t galaxy_type;
+	r.read(galaxy_type);
+	galaxy->galaxy_type = Galaxy::galaxy_type_t(galaxy_type);
+	read_baryon(r, galaxy->bulge_stars);
+	read_baryon(r, galaxy->bulge_gas);
+	read_baryon(r, galaxy->disk_stars);
+	read_baryon(r, galaxy->disk_gas);
+	read_baryon(r, galaxy->galaxymergers_burst_stars);
+	read_baryon(r, galaxy->galaxymergers_assembly_stars);
+	read_baryon(r, galaxy->diskinstabilities_burst_stars);
+	read_baryon(r, galaxy->diskinstabilities_assembly_stars);
+	r.read(galaxy->smbh.mass);
+	r.read(galaxy->smbh.mass_metals);
+	r.read(galaxy->smbh.macc_hh);
+	r.read(galaxy->smbh.macc_sb);
+	r.read(galaxy->sfr_disk);
+	r.read(galaxy->sfr_bulge_mergers);
+	r.read(galaxy->sfr_bulge_diskins);
+	r.read(galaxy->sfr_z_disk);
+	r.read(galaxy->sfr_z_bulge_mergers);
+	r.read(galaxy->sfr_z_bulge_diskins);
+	r.read(galaxy->mean_stellar_age);
+	r.read(galaxy->total_stellar_mass_ever_formed);
+	r.read(galaxy->vmax);
+	std::vector<HistoryItem> history;
+	r.read(history);
+	for (auto &item: history) {
+		galaxy->history.add(item);
+	}
+	r.read(galaxy->interaction.major_mergers);
+	r.read(galaxy->interaction.minor_mergers);
+	r.read(galaxy->interaction.disk_instabilities);
+	r.read(galaxy->merger_age);
+	r.read(galaxy->concentration_type2);
+	r.read(galaxy->msubhalo_type2);
+	r.read(galaxy->vvir_type2);
+	r.read(galaxy->lambda_type2);
+	double ode_step;
+	r.read(ode_step);
+	galaxy->ode_step = float(ode_step);
+	return galaxy;
+}
+
+}  // anonymous namespace
+
+void write_subhalo_state(binary_writer &w, const Subhalo &subhalo)
+{
+	w.write(subhalo.id);
+	write_baryon(w, subhalo.hot_halo_gas);
+	write_baryon(w, subhalo.cold_halo_gas);
+	write_baryon(w, subhalo.ejected_galaxy_gas);
+	auto &tracking = subhalo.cooling_subhalo_tracking;
+	w.write(tracking.integral);
+	w.write(tracking.rheat);
+	w.write(std::uint64_t(subhalo.galaxies.size()));
+	for (auto &galaxy: subhalo.galaxies) {
+		write_galaxy(w, *galaxy);
+	}
+}
+
+void read_subhalo_state(binary_reader &r, Subhalo &subhalo)
+{
+	read_baryon(r, subhalo.hot_halo_gas);
+	read_baryon(r, subhalo.cold_halo_gas);
+	read_baryon(r, subhalo.ejected_galaxy_gas);
+	auto &tracking = subhalo.cooling_subhalo_tracking;
+	r.read(tracking.integral);
+	r.read(tracking.rheat);
+	subhalo.galaxies.clear();
+	auto n_galaxies = r.read_size();
+	for (std::uint64_t i = 0; i != n_galaxies; i++) {
+		subhalo.galaxies.emplace_back(read_galaxy(r));
+	}
+	subhalo.rebuild_merger_queue();
+}
+
+namespace {
+
+void write_total_baryons(binary_writer &w, const TotalBaryon &all_baryons)
+{
+	for (auto *v: {&all_baryons.mcold, &all_baryons.mstars, &all_baryons.mstars_burst_galaxymergers,
+	               &all_baryons.mstars_burst_diskinstabilities, &all_baryons.mhot_halo, &all_baryons.mcold_halo,
+	               &all_baryons.mejected_halo, &all_baryons.mBH, &all_baryons.mHI, &all_baryons.mH2, &all_baryons.mDM}) {
+		w.write(std::uint64_t(v->size()));
+		for (auto &b: *v) {
+			w.write(b.mass);
+			w.write(b.mass_metals);
+		}
+	}
+	w.write(all_baryons.SFR_disk);
+	w.write(all_baryons.SFR_bulge);
+	w.write(all_baryons.major_mergers);
+	w.write(all_baryons.minor_mergers);
+	w.write(all_baryons.disk_instabil);
+	w.write(all_baryons.baryon_total_created);
+	w.write(all_baryons.baryon_total_lost);
+}
+
+void read_total_baryons(binary_reader &r, TotalBaryon &all_baryons)
+{
+	for (auto *v: {&all_baryons.mcold, &all_baryons.mstars, &all_baryons.mstars_burst_galaxymergers,
+	               &all_baryons.mstars_burst_diskinstabilities, &all_baryons.mhot_halo, &all_baryons.mcold_halo,
+	               &all_baryons.mejected_halo, &all_baryons.mBH, &all_baryons.mHI, &all_baryons.mH2, &all_baryons.mDM}) {
+		v->resize(r.read_size());
+		for (auto &b: *v) {
+			r.read(b.mass);
+			r.read(b.mass_metals);
+		}
+	}
+	r.read(all_baryons.SFR_disk);
+	r.read(all_baryons.SFR_bulge);
+	r.read(all_baryons.major_mergers);
+	r.read(all_baryons.minor_mergers);
+	r.read(all_baryons.disk_instabil);
+	r.read(all_baryons.baryon_total_created);
+	r.read(all_baryons.baryon_total_lost);
+}
+
+}  // anonymous namespace
+
+void Checkpoint::write(const std::string &filename, const std::vector<MergerTreePtr> &merger_trees, const TotalBaryon &all_baryons) const
+{
+	Timer t;
+
+	// Write into a temporary file first so a failure while writing
+	// never leaves a truncated checkpoint behind under the final name
+	auto tmp_filename = filename + ".tmp";
+	std::ofstream f(tmp_filename, std::ios::binary | std::ios::trunc);
+	if (!f) {
+		throw exception("cannot open checkpoint file " + tmp_filename + " for writing");
+	}
+
+	binary_writer w(f);
+	w.write(CHECKPOINT_MAGIC);
+	w.write(CHECKPOINT_VERSION);
+	w.write(std::int32_t(snapshot));
+	w.write(options);
+	w.write(std::int64_t(n_galaxy_ids));
+	w.write(std::uint64_t(merger_trees.size()));
+
+	write_total_baryons(w, all_baryons);
+
+	std::uint64_t n_subhalos = 0;
+	for (auto &tree: merger_trees) {
+		auto it = tree->halos.find(snapshot);
+		if (it == tree->halos.end()) {
+			continue;
+		}
+		for (auto &halo: it->second) {
+			n_subhalos += halo->subhalo_count();
+		}
+	}
+	w.write(n_subhalos);
+	for (auto &tree: merger_trees) {
+		auto it = tree->halos.find(snapshot);
+		if (it == tree->halos.end()) {
+			continue;
+		}
+		for (auto &halo: it->second) {
+			for (auto &subhalo: halo->subhalos()) {
+				write_subhalo_state(w, *subhalo);
+			}
+		}
+	}
+
+	f.close();
+	if (!f) {
+		throw exception("error while writing checkpoint file " + tmp_filename);
+	}
+	if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		throw exception("cannot rename " + tmp_filename + " to " + filename);
+	}
+
+	LOG(info) << "Checkpoint for snapshot " << snapshot << " written to " << filename << " in " << t;
+}
+
+void Checkpoint::read_header(std::istream &is, const std::string &filename)
+{
+	binary_reader r(is, filename);
+	char magic[sizeof(CHECKPOINT_MAGIC)];
+	r.read(magic);
+	if (std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+		throw invalid_data(filename + " is not a shark checkpoint file");
+	}
+	std::uint32_t version;
+	r.read(version);
+	if (version != CHECKPOINT_VERSION) {
+		std::ostringstream os;
+		os << "Unsupported checkpoint version in " << filename << ": " << version << " (expected " << CHECKPOINT_VERSION << ")";
+		throw invalid_data(os.str());
+	}
+
+	std::int32_t snapshot_;
+	r.read(snapshot_);
+	r.read(options);
+	snapshot = snapshot_;
+}
+
+void Checkpoint::read_header(const std::string &filename)
+{
+	std::ifstream f(filename, std::ios::binary);
+	if (!f) {
+		throw invalid_argument("cannot open checkpoint file " + filename);
+	}
+	read_header(f, filename);
+}
+
+void Checkpoint::read(const std::string &filename, const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &all_baryons)
+{
+	Timer t;
+
+	std::ifstream f(filename, std::ios::binary);
+	if (!f) {
+		throw invalid_argument("cannot open checkpoint file " + filename);
+	}
+	read_header(f, filename);
+
+	binary_reader r(f, filename);
+	std::int64_t n_galaxy_ids_;
+	std::uint64_t n_trees;
+	r.read(n_galaxy_ids_);
+	r.read(n_trees);
+	if (n_trees != merger_trees.size() || n_galaxy_ids_ != n_galaxy_ids) {
+		std::ostringstream os;
+		os << "Checkpoint " << filename << " was written for " << n_trees << " merger trees and ";
+		os << n_galaxy_ids_ << " galaxy IDs, but the current execution has " << merger_trees.size();
+		os << " merger trees and " << n_galaxy_ids << " galaxy IDs. Are the input data and options the same?";
+		throw invalid_data(os.str());
+	}
+
+	read_total_baryons(r, all_baryons);
+
+	std::unordered_map<Subhalo::id_t, SubhaloPtr> subhalos;
+	for (auto &tree: merger_trees) {
+		auto it = tree->halos.find(snapshot);
+		if (it == tree->halos.end()) {
+			continue;
+		}
+		for (auto &halo: it->second) {
+			for (auto &subhalo: halo->subhalos()) {
+				subhalos[subhalo->id] = subhalo;
+			}
+		}
+	}
+
+	auto n_subhalos = r.read_size();
+	if (n_subhalos != subhalos.size()) {
+		std::ostringstream os;
+		os << "Checkpoint " << filename << " contains " << n_subhalos << " subhalos for snapshot " << snapshot;
+		os << ", but the current execution has " << subhalos.size();
+		throw invalid_data(os.str());
+	}
+	for (std::uint64_t i = 0; i != n_subhalos; i++) {
+		Subhalo::id_t id;
+		r.read(id);
+		auto it = subhalos.find(id);
+		if (it == subhalos.end()) {
+			std::ostringstream os;
+			os << "Subhalo " << id << " from checkpoint " << filename << " not found in snapshot " << snapshot;
+			throw invalid_data(os.str());
+		}
+		read_subhalo_state(r, *it->second);
+	}
+
+	LOG(info) << "Checkpoint for snapshot " << snapshot << " read from " << filename << " in " << t;
+}
+
+}  // namespace shark
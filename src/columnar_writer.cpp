@@ -0,0 +1,137 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Implementation of ColumnarWriter class methods
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include <boost/filesystem.hpp>
+
+#include "columnar_writer.h"
+#include "logging.h"
+#include "timer.h"
+
+namespace shark {
+
+namespace fs = boost::filesystem;
+
+ColumnarWriter::ColumnarWriter(const std::string &directory) :
+	directory(directory)
+{
+	// no-op
+}
+
+bool ColumnarWriter::big_endian()
+{
+	const std::uint16_t one = 1;
+	return *reinterpret_cast<const char *>(&one) == 0;
+}
+
+void ColumnarWriter::swap_bytes(char *data, std::size_t count, std::size_t size)
+{
+	for (std::size_t i = 0; i != count; i++) {
+		std::reverse(data + i * size, data + (i + 1) * size);
+	}
+}
+
+std::string ColumnarWriter::json_value(const std::string &value)
+{
+	std::ostringstream os;
+	os << '"';
+	for (char c: value) {
+		if (c == '"' || c == '\\') {
+			os << '\\' << c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20) {
+			os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+		}
+		else {
+			os << c;
+		}
+	}
+	os << '"';
+	return os.str();
+}
+
+void ColumnarWriter::flush()
+{
+	Timer t;
+	fs::create_directories(directory);
+
+	std::ofstream schema(directory + "/schema.json");
+	schema << "{\n  \"format\": \"shark-columnar\",\n  \"version\": 1,\n  \"byte_order\": \"little\",\n";
+
+	// One file per column, each written with a single sequential write
+	std::size_t total = 0;
+	schema << "  \"columns\": [";
+	for (std::size_t i = 0; i != columns.size(); i++) {
+		auto &col = columns[i];
+		std::string filename = col.name + ".bin";
+		fs::path path(directory + "/" + filename);
+		fs::create_directories(path.parent_path());
+		std::ofstream f(path.string(), std::ios::binary | std::ios::trunc);
+		f.write(col.data.data(), col.data.size());
+		if (!f) {
+			throw exception("error while writing column file " + path.string());
+		}
+		total += col.data.size();
+
+		schema << (i ? ",\n" : "\n") << "    {\"name\": " << json_value(col.name)
+		       << ", \"file\": " << json_value(filename)
+		       << ", \"type\": " << json_value(col.type) << ", \"shape\": [";
+		for (std::size_t d = 0; d != col.shape.size(); d++) {
+			schema << (d ? ", " : "") << col.shape[d];
+		}
+		schema << "], \"comment\": " << json_value(col.comment) << "}";
+	}
+	schema << "\n  ],\n";
+
+	schema << "  \"values\": [";
+	for (std::size_t i = 0; i != scalars.size(); i++) {
+		auto &val = scalars[i];
+		schema << (i ? ",\n" : "\n") << "    {\"name\": " << json_value(val.name)
+		       << ", \"type\": " << json_value(val.type) << ", \"value\": " << val.json
+		       << ", \"comment\": " << json_value(val.comment) << "}";
+	}
+	schema << "\n  ],\n";
+
+	schema << "  \"attributes\": [";
+	for (std::size_t i = 0; i != attributes.size(); i++) {
+		auto &attr = attributes[i];
+		schema << (i ? ",\n" : "\n") << "    {\"name\": " << json_value(attr.name)
+		       << ", \"value\": " << attr.json << "}";
+	}
+	schema << "\n  ]\n}\n";
+	if (!schema) {
+		throw exception("error while writing " + directory + "/schema.json");
+	}
+
+	LOG(debug) << columns.size() << " columns (" << memory_amount(total) << ") written into " << directory << " in " << t;
+	columns.clear();
+	scalars.clear();
+	attributes.clear();
+}
+
+}  // namespace shark
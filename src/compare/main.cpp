@@ -0,0 +1,171 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * The main function for the shark-compare executable
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#ifdef SHARK_OPENMP
+#include <omp.h>
+#endif // SHARK_OPENMP
+
+#include <boost/program_options.hpp>
+
+#include "exceptions.h"
+#include "logging.h"
+#include "output_comparison.h"
+#include "timer.h"
+#include "utils.h"
+
+namespace shark {
+namespace compare {
+
+namespace po = boost::program_options;
+
+static
+void setup_logging(int verbosity)
+{
+	namespace log = ::boost::log;
+	namespace trivial = ::boost::log::trivial;
+
+	verbosity = 5 - std::min(std::max(verbosity, 0), 5);
+	trivial::severity_level sev_lvl = logging_level = trivial::severity_level(verbosity);
+	log::core::get()->set_filter([sev_lvl](log::attribute_value_set const &s) {
+		return s["Severity"].extract<trivial::severity_level>() >= sev_lvl;
+	});
+}
+
+/// Parses a tolerance given as <regex>=<absolute>,<relative>
+static
+ComparisonTolerance parse_tolerance(const std::string &spec)
+{
+	auto equals = spec.rfind('=');
+	if (equals != std::string::npos) {
+		auto values = tokenize(spec.substr(equals + 1), ",");
+		if (values.size() == 2) {
+			try {
+				return ComparisonTolerance {spec.substr(0, equals), std::stod(values[0]), std::stod(values[1])};
+			} catch (const std::logic_error &) {
+				// reported below
+			}
+		}
+	}
+	throw invalid_argument("tolerance " + spec + " is not of the form <regex>=<absolute>,<relative>");
+}
+
+static
+unsigned int read_threads(const po::variables_map &vm)
+{
+#ifdef SHARK_OPENMP
+	auto threads = vm["threads"].as<unsigned int>();
+	if (threads == 0) {
+		threads = omp_get_max_threads();
+	}
+	return threads;
+#else
+	return 1;
+#endif // SHARK_OPENMP
+}
+
+static
+int run(int argc, char **argv)
+{
+	po::options_description opts("shark-compare options");
+	opts.add_options()
+		("help,h",      "Show this help message")
+		("verbose,v",   po::value<int>()->default_value(2), "Verbosity level. Higher is more verbose")
+		("threads,t",   po::value<unsigned int>()->default_value(1), "Threads comparing files. 0 means use OpenMP default number of threads")
+		("absolute,a",  po::value<double>()->default_value(0), "Absolute tolerance of datasets without a specific tolerance")
+		("relative,r",  po::value<double>()->default_value(0), "Relative tolerance of datasets without a specific tolerance")
+		("tolerance",   po::value<std::vector<std::string>>()->composing()->default_value({}, ""),
+		                "Tolerances of the datasets whose names match a regular expression, as <regex>=<absolute>,<relative>. "
+		                "Can be given multiple times, the first matching one is used")
+		("exclude,x",   po::value<std::vector<std::string>>()->composing()->default_value({"run_info/.*"}, "run_info/.*"),
+		                "Regular expression of the names of datasets not to compare. Can be given multiple times")
+		("galaxies,g",  po::value<std::size_t>()->default_value(10), "Number of galaxies with most differing properties to report");
+
+	po::options_description all_opts;
+	all_opts.add(opts);
+	all_opts.add_options()
+		("outputs", po::value<std::vector<std::string>>(), "The reference and the other outputs");
+	po::positional_options_description pdesc;
+	pdesc.add("outputs", 2);
+
+	try {
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(all_opts).positional(pdesc).run(), vm);
+		po::notify(vm);
+
+		if (vm.count("help") || vm.count("outputs") == 0 || vm["outputs"].as<std::vector<std::string>>().size() != 2) {
+			std::cout << "Usage: " << argv[0] << " [options] reference other" << std::endl << std::endl;
+			std::cout << "Compares the HDF5 outputs of two shark executions, either two output" << std::endl;
+			std::cout << "directories (e.g., <output_directory>/<name_model>) or two files. Files" << std::endl;
+			std::cout << "are paired by their paths relative to the given directories, and all" << std::endl;
+			std::cout << "their numeric datasets compared value by value. Two values a and b are" << std::endl;
+			std::cout << "equal if |a - b| <= absolute + relative * max(|a|, |b|)." << std::endl << std::endl;
+			std::cout << "The exit code is 0 if the outputs are equal, 1 if they differ and 2 on errors." << std::endl << std::endl;
+			std::cout << opts << std::endl;
+			return vm.count("help") ? 0 : 2;
+		}
+
+		setup_logging(vm["verbose"].as<int>());
+
+		OutputComparisonParameters params;
+		params.absolute_tolerance = vm["absolute"].as<double>();
+		params.relative_tolerance = vm["relative"].as<double>();
+		for (auto &spec: vm["tolerance"].as<std::vector<std::string>>()) {
+			params.tolerances.push_back(parse_tolerance(spec));
+		}
+		params.excluded_datasets = vm["exclude"].as<std::vector<std::string>>();
+		params.max_galaxies = vm["galaxies"].as<std::size_t>();
+		params.threads = read_threads(vm);
+
+		Timer t;
+		auto &outputs = vm["outputs"].as<std::vector<std::string>>();
+		OutputComparison comparison(outputs[0], outputs[1], params);
+		comparison.write(std::cout);
+		LOG(info) << "Outputs compared in " << t;
+		return comparison.equal() ? 0 : 1;
+	} catch (const shark::exception &e) {
+		std::cerr << "Error while comparing outputs: " << e.what() << std::endl;
+		return 2;
+	} catch (const po::error &e) {
+		std::cerr << "Error while parsing command-line: " << e.what() << std::endl;
+		return 2;
+	} catch (const std::exception &e) {
+		std::cerr << "Unexpected exception while comparing outputs" << std::endl << std::endl;
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+}
+
+}  // namespace compare
+}  // namespace shark
+
+int main(int argc, char **argv) {
+	return shark::compare::run(argc, argv);
+}
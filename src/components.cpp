@@ -26,6 +26,7 @@
 #include <iterator>
 #include <numeric>
 #include <sstream>
+#include <unordered_set>
 
 #include "components.h"
 #include "exceptions.h"
@@ -33,6 +34,16 @@
 
 namespace shark {
 
+namespace {
+
+/// Orders galaxies such that merger queues are min-heaps on their merger_age
+bool merges_later(const GalaxyPtr &lhs, const GalaxyPtr &rhs)
+{
+	return lhs->merger_age > rhs->merger_age;
+}
+
+}  // anonymous namespace
+
 SubhaloPtr Subhalo::main() const
 {
 	for (auto &sub: ascendants) {
@@ -163,7 +174,66 @@ std::vector<GalaxyPtr> Subhalo::all_type2_galaxies() const
 	return all;
 }
 
-void Subhalo::copy_galaxies_to(SubhaloPtr &target, const std::vector<GalaxyPtr> &gals) const
+void Subhalo::queue_merger(const GalaxyPtr &galaxy, double age)
+{
+	galaxy->merger_age += age;
+	merger_queue.push_back(galaxy);
+	std::push_heap(merger_queue.begin(), merger_queue.end(), merges_later);
+}
+
+void Subhalo::rebuild_merger_queue()
+{
+	merger_queue = all_type2_galaxies();
+	std::make_heap(merger_queue.begin(), merger_queue.end(), merges_later);
+}
+
+std::vector<GalaxyPtr> Subhalo::remove_mergers(double age)
+{
+	std::vector<GalaxyPtr> mergers;
+	if (merger_queue.empty() || merger_queue.front()->merger_age >= age) {
+		return mergers;
+	}
+
+	std::unordered_set<const Galaxy *> merging;
+	while (!merger_queue.empty() && merger_queue.front()->merger_age < age) {
+		std::pop_heap(merger_queue.begin(), merger_queue.end(), merges_later);
+		merging.insert(merger_queue.back().get());
+		merger_queue.pop_back();
+	}
+
+	// Galaxies merge in the order they have in this subhalo
+	auto remaining = galaxies.begin();
+	for (auto it = galaxies.begin(); it != galaxies.end(); it++) {
+		if (merging.count(it->get())) {
+			mergers.push_back(std::move(*it));
+		}
+		else {
+			if (remaining != it) {
+				*remaining = std::move(*it);
+			}
+			remaining++;
+		}
+	}
+	galaxies.erase(remaining, galaxies.end());
+	return mergers;
+}
+
+void Subhalo::transfer_merger_queue_to(Subhalo &target)
+{
+	if (merger_queue.empty()) {
+		return;
+	}
+	auto &target_queue = target.merger_queue;
+	if (target_queue.empty()) {
+		target_queue.swap(merger_queue);
+		return;
+	}
+	target_queue.insert(target_queue.end(), std::make_move_iterator(merger_queue.begin()), std::make_move_iterator(merger_queue.end()));
+	std::make_heap(target_queue.begin(), target_queue.end(), merges_later);
+	merger_queue.clear();
+}
+
+void Subhalo::copy_galaxies_to(SubhaloPtr &target, span<GalaxyPtr> gals) const
 {
 	target->galaxies.insert(target->galaxies.end(), gals.begin(), gals.end());
 }
@@ -174,8 +244,10 @@ void Subhalo::transfer_galaxies_to(SubhaloPtr &target)
 	auto our_gals = galaxies.size();
 	LOG(trace) << "Transferring " << our_gals << " galaxies from " << *this << " to " << target << " (currently " << gals_before << " galaxies)";
 
-	copy_galaxies_to(target, galaxies);
+	auto &target_gals = target->galaxies;
+	target_gals.insert(target_gals.end(), std::make_move_iterator(galaxies.begin()), std::make_move_iterator(galaxies.end()));
 	galaxies.clear();
+	transfer_merger_queue_to(*target);
 
 	assert(gals_before + our_gals == target->galaxy_count());
 }
@@ -189,24 +261,42 @@ void Subhalo::transfer_type2galaxies_to(SubhaloPtr &target)
 
 	copy_galaxies_to(target, type2_gals);
 	remove_galaxies(type2_gals);
+	transfer_merger_queue_to(*target);
 
 	assert(gals_before + our_gals == target->galaxy_count());
 }
 
 
-void Subhalo::remove_galaxies(const std::vector<GalaxyPtr> &to_remove)
+void Subhalo::remove_galaxies(span<GalaxyPtr> to_remove)
 {
-	// TODO: Maybe not most efficiently, but it will do for now
-	for(auto &galaxy: to_remove) {
-		auto it = std::find(galaxies.begin(), galaxies.end(), galaxy);
-		if (it == galaxies.end()) {
-			LOG(warning) << "Trying to remove galaxy " << galaxy << " which is not in subhalo " << *this << ", ignoring";
-			continue;
+	if (to_remove.empty()) {
+		return;
+	}
+
+	// Mark the galaxies to remove, then compact the remaining ones in a single pass
+	std::unordered_set<const Galaxy *> marked;
+	marked.reserve(to_remove.size());
+	for (const auto &galaxy: to_remove) {
+		marked.insert(galaxy.get());
+	}
+
+	auto new_end = std::remove_if(galaxies.begin(), galaxies.end(), [&](const GalaxyPtr &galaxy) {
+		auto it = marked.find(galaxy.get());
+		if (it == marked.end()) {
+			return false;
 		}
 		if (LOG_ENABLED(debug)) {
 			LOG(debug) << "Removing galaxy " << galaxy << " from subhalo " << *this;
 		}
-		galaxies.erase(it);
+		marked.erase(it);
+		return true;
+	});
+	galaxies.erase(new_end, galaxies.end());
+
+	for (const auto &galaxy: to_remove) {
+		if (marked.count(galaxy.get())) {
+			LOG(warning) << "Trying to remove galaxy " << galaxy << " which is not in subhalo " << *this << ", ignoring";
+		}
 	}
 }
 
@@ -231,8 +321,24 @@ std::vector<SubhaloPtr> Halo::all_subhalos() const
 	return all;
 }
 
+span<SubhaloPtr> Halo::subhalos() const
+{
+	order_subhalos();
+	return ordered_subhalos;
+}
+
+void Halo::order_subhalos() const
+{
+	if (!subhalos_ordered) {
+		ordered_subhalos = all_subhalos();
+		subhalos_ordered = true;
+	}
+}
+
 void Halo::add_subhalo(const SubhaloPtr &&subhalo)
 {
+	subhalos_changed();
+
 	// Add subhalo mass to halo
 	Mvir += subhalo->Mvir;
 
@@ -245,8 +351,18 @@ void Halo::add_subhalo(const SubhaloPtr &&subhalo)
 	}
 }
 
+bool Halo::add_ascendant(const HaloPtr &halo)
+{
+	if (std::find(ascendants.begin(), ascendants.end(), halo) != ascendants.end()) {
+		return false;
+	}
+	ascendants.push_back(halo);
+	return true;
+}
+
 void Halo::remove_subhalo(const SubhaloPtr &subhalo)
 {
+	subhalos_changed();
 	if (subhalo == central_subhalo) {
 		central_subhalo.reset();
 		return;
@@ -277,7 +393,7 @@ double Halo::total_baryon_mass() const
 {
 	double mass= 0.0;
 
-	for (auto &subhalo: all_subhalos()){
+	for (auto &subhalo: subhalos()){
 		mass += subhalo->total_baryon_mass();
 	}
 
@@ -315,4 +431,102 @@ std::vector<double> TotalBaryon::get_metals (const std::vector<BaryonBase> &B) c
 	return masses;
 }
 
+namespace detail {
+
+template <typename T>
+void add_elementwise(std::vector<T> &x, const std::vector<T> &y)
+{
+	if (x.size() != y.size()) {
+		std::ostringstream os;
+		os << "Cannot add baryon amounts tracked over " << y.size() << " snapshots to amounts tracked over " << x.size();
+		throw invalid_argument(os.str());
+	}
+	std::transform(x.begin(), x.end(), y.begin(), x.begin(), [](const T &a, const T &b) {
+		T sum = a;
+		sum += b;
+		return sum;
+	});
+}
+
+template <typename T>
+void truncate(std::vector<T> &x, std::size_t n)
+{
+	if (x.size() > n) {
+		x.resize(n);
+	}
+}
+
+}  // namespace detail
+
+TotalBaryon &TotalBaryon::operator+=(const TotalBaryon &other)
+{
+	for (auto member: {&TotalBaryon::mcold, &TotalBaryon::mstars, &TotalBaryon::mstars_burst_galaxymergers,
+	                   &TotalBaryon::mstars_burst_diskinstabilities, &TotalBaryon::mhot_halo, &TotalBaryon::mcold_halo,
+	                   &TotalBaryon::mejected_halo, &TotalBaryon::mBH, &TotalBaryon::mHI, &TotalBaryon::mH2, &TotalBaryon::mDM}) {
+		detail::add_elementwise(this->*member, other.*member);
+	}
+	detail::add_elementwise(SFR_disk, other.SFR_disk);
+	detail::add_elementwise(SFR_bulge, other.SFR_bulge);
+	detail::add_elementwise(major_mergers, other.major_mergers);
+	detail::add_elementwise(minor_mergers, other.minor_mergers);
+	detail::add_elementwise(disk_instabil, other.disk_instabil);
+	for (auto &created: other.baryon_total_created) {
+		baryon_total_created[created.first] += created.second;
+	}
+	for (auto &lost: other.baryon_total_lost) {
+		baryon_total_lost[lost.first] += lost.second;
+	}
+	for (auto &pruned: other.baryon_total_pruned) {
+		baryon_total_pruned[pruned.first] += pruned.second;
+	}
+	return *this;
+}
+
+void TotalBaryon::truncate(std::size_t n_snapshots)
+{
+	for (auto member: {&TotalBaryon::mcold, &TotalBaryon::mstars, &TotalBaryon::mstars_burst_galaxymergers,
+	                   &TotalBaryon::mstars_burst_diskinstabilities, &TotalBaryon::mhot_halo, &TotalBaryon::mcold_halo,
+	                   &TotalBaryon::mejected_halo, &TotalBaryon::mBH, &TotalBaryon::mHI, &TotalBaryon::mH2, &TotalBaryon::mDM}) {
+		detail::truncate(this->*member, n_snapshots);
+	}
+	detail::truncate(SFR_disk, n_snapshots);
+	detail::truncate(SFR_bulge, n_snapshots);
+	detail::truncate(major_mergers, n_snapshots);
+	detail::truncate(minor_mergers, n_snapshots);
+	detail::truncate(disk_instabil, n_snapshots);
+}
+
+void MergerTree::release_snapshot(int snapshot)
+{
+	auto it = halos.find(snapshot);
+	if (it == halos.end()) {
+		return;
+	}
+
+	// Descendants are always in the next snapshot, and their ascendants
+	// (i.e., the structures being released) are not used anymore either
+	for (auto &halo: it->second) {
+		for (auto &subhalo: halo->all_subhalos()) {
+			if (subhalo->descendant) {
+				subhalo->descendant->ascendants.clear();
+			}
+			subhalo->ascendants.clear();
+			subhalo->descendant.reset();
+			subhalo->host_halo.reset();
+			subhalo->galaxies.clear();
+			subhalo->merger_queue.clear();
+		}
+		if (halo->descendant) {
+			halo->descendant->ascendants.clear();
+		}
+		halo->central_subhalo.reset();
+		halo->satellite_subhalos.clear();
+		halo->subhalos_changed();
+		halo->ascendants.clear();
+		halo->descendant.reset();
+		halo->merger_tree.reset();
+	}
+	halos.erase(it);
+}
+
 }  // namespace shark
@@ -21,6 +21,7 @@
  * @file
  */
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -92,7 +93,7 @@ CosmologicalParameters::CosmologicalParameters(const Options &options)
 	options.load("cosmology.sigma8", sigma8);
 	options.load("cosmology.hubble_h", Hubble_h);
 	options.load("cosmology.power_spectrum", ps_type);
-	load_tables(get_static_data_filepath(std::string("Power_Spec/") + power_spectrum_files[ps_type]));
+	load_tables(std::string("Power_Spec/") + power_spectrum_files[ps_type]);
 }
 
 void CosmologicalParameters::load_tables(const std::string &power_spec_file)
@@ -102,9 +103,9 @@ void CosmologicalParameters::load_tables(const std::string &power_spec_file)
 
 	LOG(debug) << "Reading table " << power_spec_file ;
 
-	ifstream f = open_file(power_spec_file);
+	auto f = open_static_data(power_spec_file);
 	string line;
-	while ( getline(f, line) ) {
+	while ( getline(*f, line) ) {
 
 		trim(line);
 		if (empty_or_comment(line)) {
@@ -119,7 +120,6 @@ void CosmologicalParameters::load_tables(const std::string &power_spec_file)
 		power_spectrum.p.push_back(p);
 
 	}
-	f.close();
 
 }
 
@@ -129,6 +129,30 @@ Cosmology::Cosmology(const CosmologicalParameters &parameters) :
 	// no-op
 }
 
+Cosmology::Cosmology(const CosmologicalParameters &parameters, const std::map<int, double> &snapshot_redshifts) :
+	parameters(parameters)
+{
+	for (auto &snapshot_and_redshift: snapshot_redshifts) {
+		double z = snapshot_and_redshift.second;
+		double a = 1 / (1 + z);
+		redshift_cache.push_back({z, a, 1 / a, calculate_hubble_parameter(z), calculate_redshift_to_age(z)});
+	}
+	std::sort(redshift_cache.begin(), redshift_cache.end(), [](const redshift_factors &f1, const redshift_factors &f2) {
+		return f1.z < f2.z;
+	});
+}
+
+const Cosmology::redshift_factors *Cosmology::cached_factors(double z) const
+{
+	auto it = std::lower_bound(redshift_cache.begin(), redshift_cache.end(), z, [](const redshift_factors &f, double z) {
+		return f.z < z;
+	});
+	if (it == redshift_cache.end() || it->z != z) {
+		return nullptr;
+	}
+	return &*it;
+}
+
 double Cosmology::comoving_to_physical_angularmomentum(double L, double z) const {
 	return L / std::pow(parameters.Hubble_h, 2) / (1 + z);
 }
@@ -152,6 +176,14 @@ double Cosmology::physical_to_comoving_mass(double m) const {
 }
 
 double Cosmology::convert_redshift_to_age(double z) const {
+	auto factors = cached_factors(z);
+	if (factors) {
+		return factors->age;
+	}
+	return calculate_redshift_to_age(z);
+}
+
+double Cosmology::calculate_redshift_to_age(double z) const {
 
 	/**
 	 * Function that calculates an age of the universe from a redshift.
@@ -233,6 +265,14 @@ double Cosmology::expansion_factor(double t) const {
 }
 
 double Cosmology::hubble_parameter (double z) const {
+	auto factors = cached_factors(z);
+	if (factors) {
+		return factors->hubble_parameter;
+	}
+	return calculate_hubble_parameter(z);
+}
+
+double Cosmology::calculate_hubble_parameter (double z) const {
 	double H2 = (parameters.OmegaM * std::pow(1.0 + z, 3.0) + parameters.OmegaL);
 	return parameters.Hubble_h * 100.0 * std::sqrt(H2);
 }
@@ -23,8 +23,10 @@
 
 #include <cmath>
 #include <fstream>
+#include <limits>
 #include <map>
 #include <random>
+#include <sstream>
 #include <stdexcept>
 #include <tuple>
 
@@ -33,6 +35,7 @@
 #include "logging.h"
 #include "nfw_distribution.h"
 #include "numerical_constants.h"
+#include "timer.h"
 #include "utils.h"
 
 
@@ -46,6 +49,12 @@ DarkMatterHaloParameters::DarkMatterHaloParameters(const Options &options)
 	options.load("dark_matter_halo.concentration_model", concentrationmodel);
 	options.load("dark_matter_halo.use_converged_lambda_catalog", use_converged_lambda_catalog);
 	options.load("dark_matter_halo.min_part_convergence", min_part_convergence);
+	options.load("dark_matter_halo.tabulated_profiles", tabulated_profiles);
+	options.load("dark_matter_halo.profile_table_accuracy", profile_table_accuracy);
+
+	if (tabulated_profiles && profile_table_accuracy <= 0) {
+		throw invalid_option("dark_matter_halo.profile_table_accuracy must be positive");
+	}
 
 }
 
@@ -104,11 +113,47 @@ DarkMatterHalos::DarkMatterHalos(
 	params(params),
 	cosmology(cosmology),
 	sim_params(sim_params),
-	generator(exec_params.seed),
+	seed(exec_params.seed),
 	distribution(std::log(0.03), std::abs(std::log(0.5))),
-	flat_distribution(0,1)
+	flat_distribution(0,1),
+	snapshot_factors()
+{
+	if (!sim_params.redshifts.empty()) {
+		auto max_snapshot = sim_params.redshifts.rbegin()->first;
+		double nan = std::numeric_limits<double>::quiet_NaN();
+		snapshot_factors.resize(std::max(max_snapshot + 1, 0), {nan, nan, nan, nan});
+		for (auto &snapshot_and_redshift: sim_params.redshifts) {
+			if (snapshot_and_redshift.first >= 0) {
+				snapshot_factors[snapshot_and_redshift.first] = get_redshift_factors(snapshot_and_redshift.second);
+			}
+		}
+	}
+}
+
+DarkMatterHalos::redshift_factors DarkMatterHalos::get_redshift_factors(double z) const
+{
+	redshift_factors factors;
+	factors.hubble_parameter = cosmology->hubble_parameter(z);
+	factors.lambda_factor = std::pow(10.0 * factors.hubble_parameter, 0.33);
+	if (params.concentrationmodel == DarkMatterHaloParameters::DUFFY08) {
+		factors.concentration_a = 7.85 * std::pow(1.0+z, -0.71);
+		factors.concentration_b = 0;
+	}
+	else {
+		factors.concentration_a = 0.537 + (1.025 - 0.537) * std::exp(-0.718 * std::pow(z,1.08));
+		factors.concentration_b = -0.097 + 0.024 * z;
+	}
+	return factors;
+}
+
+const DarkMatterHalos::redshift_factors &DarkMatterHalos::get_snapshot_factors(int snapshot) const
 {
-	// no-op
+	static const double nan = std::numeric_limits<double>::quiet_NaN();
+	static const redshift_factors unknown {nan, nan, nan, nan};
+	if (snapshot < 0 || std::size_t(snapshot) >= snapshot_factors.size()) {
+		return unknown;
+	}
+	return snapshot_factors[snapshot];
 }
 
 double DarkMatterHalos::energy_circular (double r, double c){
@@ -143,20 +188,29 @@ double DarkMatterHalos::halo_virial_radius(Subhalo &subhalo){
 	/**
 	 * Function to calculate the halo virial radius. Returns virial radius in physical Mpc/h.
 	 */
-	return constants::G * subhalo.Mvir / std::pow(subhalo.Vvir,2);
+	derive_properties(subhalo);
+	return subhalo.rvir;
 }
 
-float DarkMatterHalos::halo_lambda (xyz<float> L, float m, double z, double npart){
-
-	//Spin parameter either read from the DM files or assumed a random distribution.
-	double H0 = 10.0* cosmology->hubble_parameter(z);
-        double lambda = L.norm() / m / 1.41421356237 / std::pow(constants::G * m, 0.666) * std::pow(H0,0.33);
+double DarkMatterHalos::log_virial_temperature(Subhalo &subhalo){
+	derive_properties(subhalo);
+	return subhalo.log_tvir;
+}
 
-	if(lambda > 1){
-			lambda = 1;
+void DarkMatterHalos::derive_properties(Subhalo &subhalo){
+	if (subhalo.rvir >= 0) {
+		return;
 	}
+	subhalo.rvir = constants::G * subhalo.Mvir / std::pow(subhalo.Vvir,2);
+	subhalo.log_tvir = std::log10(97.48 * std::pow(subhalo.Vvir, 2.0)); //in K.
+}
 
-	auto lambda_random = distribution(generator);
+float DarkMatterHalos::halo_lambda (float lambda, double npart, Subhalo::id_t id, int snapshot){
+
+	//Spin parameter either read from the DM files or assumed a random distribution.
+	philox_engine engine(seed, philox_engine::HALO_SPIN, id, snapshot);
+	std::lognormal_distribution<double> lambda_distribution(distribution.param());
+	auto lambda_random = lambda_distribution(engine);
 
 	// Avoid zero values. In that case assume small lambda value.
 	if(lambda_random == 0){
@@ -241,6 +295,121 @@ double NFWDarkMatterHalos::enclosed_mass(double r, double c) const
 
 }
 
+constexpr double DarkMatterProfileTable::min_log_r;
+constexpr double DarkMatterProfileTable::max_log_r;
+constexpr double DarkMatterProfileTable::min_log_c;
+constexpr double DarkMatterProfileTable::max_log_c;
+const double DarkMatterProfileTable::r_min = std::pow(10., DarkMatterProfileTable::min_log_r);
+const double DarkMatterProfileTable::c_min = std::pow(10., DarkMatterProfileTable::min_log_c);
+const double DarkMatterProfileTable::c_max = std::pow(10., DarkMatterProfileTable::max_log_c);
+
+/// The coarsest and finest grid densities tried when building tables
+static constexpr unsigned int min_profile_points_per_dex = 8;
+static constexpr unsigned int max_profile_points_per_dex = 256;
+
+static
+std::vector<double> profile_table_axis(double min, double max, unsigned int points_per_dex)
+{
+	auto n = static_cast<std::size_t>(std::ceil((max - min) * points_per_dex)) + 1;
+	std::vector<double> values(n);
+	for (std::size_t i = 0; i != n; i++) {
+		values[i] = min + (max - min) * i / (n - 1);
+	}
+	return values;
+}
+
+DarkMatterProfileTable::DarkMatterProfileTable(const std::string &name, const profile_t &profile, double accuracy) :
+	values(),
+	sign(0),
+	n_points(0)
+{
+	// Values are tabulated in log10, so the profile must keep its sign
+	// over the whole table
+	auto sign_at = [&](double log_r, double log_c) {
+		double value = profile(std::pow(10., log_r), std::pow(10., log_c));
+		return value > 0 ? 1. : (value < 0 ? -1. : 0.);
+	};
+	sign = sign_at(min_log_r, min_log_c);
+	auto log_r_check = profile_table_axis(min_log_r, max_log_r, min_profile_points_per_dex);
+	auto log_c_check = profile_table_axis(min_log_c, max_log_c, min_profile_points_per_dex);
+	for (auto log_r: log_r_check) {
+		for (auto log_c: log_c_check) {
+			if (sign == 0 || sign_at(log_r, log_c) != sign) {
+				LOG(warning) << "Halo profile " << name << " changes sign or is zero, not tabulating it";
+				return;
+			}
+		}
+	}
+
+	Timer t;
+	double error = 0;
+	for (auto points_per_dex = min_profile_points_per_dex; points_per_dex <= max_profile_points_per_dex; points_per_dex *= 2) {
+		values = tabulate(profile, sign, points_per_dex, n_points);
+		auto log_r = profile_table_axis(min_log_r, max_log_r, points_per_dex);
+		auto log_c = profile_table_axis(min_log_c, max_log_c, points_per_dex);
+		error = max_relative_error(profile, log_r, log_c);
+		if (error <= accuracy) {
+			LOG(info) << "Created table of halo profile " << name << " with " << n_points
+			          << " points in " << t << ", maximum relative error is " << error;
+			return;
+		}
+	}
+
+	std::ostringstream os;
+	os << "Maximum relative error of tabulated halo profile " << name << " (" << error << ") ";
+	os << "with " << max_profile_points_per_dex << " points per dex is larger than ";
+	os << "dark_matter_halo.profile_table_accuracy (" << accuracy << ")";
+	throw invalid_option(os.str());
+}
+
+std::unique_ptr<GridInterpolator> DarkMatterProfileTable::tabulate(const profile_t &profile, double sign, unsigned int points_per_dex, std::size_t &n_points)
+{
+	auto log_r = profile_table_axis(min_log_r, max_log_r, points_per_dex);
+	auto log_c = profile_table_axis(min_log_c, max_log_c, points_per_dex);
+	std::vector<double> log_values;
+	log_values.reserve(log_r.size() * log_c.size());
+	for (auto lc: log_c) {
+		double c = std::pow(10., lc);
+		for (auto lr: log_r) {
+			// The last radius is kept just inside the virial radius, which
+			// profiles usually handle separately
+			double r = std::min(std::pow(10., lr), std::nextafter(1., 0.));
+			log_values.push_back(std::log10(sign * profile(r, c)));
+		}
+	}
+	n_points = log_values.size();
+	return std::unique_ptr<GridInterpolator>(new GridInterpolator(std::move(log_r), std::move(log_c), std::move(log_values)));
+}
+
+double DarkMatterProfileTable::max_relative_error(const profile_t &profile, const std::vector<double> &log_r, const std::vector<double> &log_c) const
+{
+	double max_error = 0;
+	auto check = [&](double lr, double lc) {
+		double r = std::pow(10., lr);
+		double c = std::pow(10., lc);
+		double expected = profile(r, c);
+		double value;
+		if (!get(r, c, value)) {
+			return;
+		}
+		double error = std::abs(value - expected) / std::abs(expected);
+		if (!(error <= max_error)) {
+			max_error = error;
+		}
+	};
+
+	for (std::size_t j = 0; j + 1 < log_c.size(); j++) {
+		double lc_mid = (log_c[j] + log_c[j + 1]) / 2;
+		for (std::size_t i = 0; i + 1 < log_r.size(); i++) {
+			double lr_mid = (log_r[i] + log_r[i + 1]) / 2;
+			check(lr_mid, log_c[j]);
+			check(log_r[i], lc_mid);
+			check(lr_mid, lc_mid);
+		}
+	}
+	return max_error;
+}
+
 double EinastoDarkMatterHalos::grav_potential_halo(double r, double c) const
 {
 	//TODO: implement Einasto profile.
@@ -404,20 +573,67 @@ double DarkMatterHalos::v2bulge (double x, double m, double c, double r){
 }
 
 double DarkMatterHalos::nfw_concentration(double mvir, double z){
+	return nfw_concentration(mvir, get_redshift_factors(z));
+}
+
+template <DarkMatterHaloParameters::ConcentrationModel Model>
+double DarkMatterHalos::nfw_concentration(double mvir, const redshift_factors &factors) {
 
-	if(params.concentrationmodel == DarkMatterHaloParameters::DUFFY08){ 
+	if(Model == DarkMatterHaloParameters::DUFFY08){
 		// From Duffy et al. (2008). Full sample from z=0-2 for Virial masses.
-		return 7.85 * std::pow(1.0+z, -0.71) * std::pow(mvir/2.0e12,-0.081);
+		return factors.concentration_a * std::pow(mvir/2.0e12,-0.081);
 	}
-	else if(params.concentrationmodel == DarkMatterHaloParameters::DUTTON14){
+	else {
 		//From Dutton & Maccio (2014) for virial masses.
-		double b = -0.097 + 0.024 * z;
-		double a = 0.537 + (1.025 - 0.537) * std::exp(-0.718 * std::pow(z,1.08));
-		return std::pow(10.0, a + b * std::log10(mvir/1e12));
+		return std::pow(10.0, factors.concentration_a + factors.concentration_b * std::log10(mvir/1e12));
 	}
 
 }
 
+template <DarkMatterHaloParameters::ConcentrationModel Model>
+void DarkMatterHalos::nfw_concentration(const float mvir[], const int snapshot[], std::size_t n, double concentration[]) const
+{
+	for (std::size_t i = 0; i != n; i++) {
+		concentration[i] = nfw_concentration<Model>(mvir[i], get_snapshot_factors(snapshot[i]));
+	}
+}
+
+double DarkMatterHalos::nfw_concentration(double mvir, const redshift_factors &factors) const {
+	if (params.concentrationmodel == DarkMatterHaloParameters::DUFFY08) {
+		return nfw_concentration<DarkMatterHaloParameters::DUFFY08>(mvir, factors);
+	}
+	return nfw_concentration<DarkMatterHaloParameters::DUTTON14>(mvir, factors);
+}
+
+void DarkMatterHalos::nfw_concentration(const float mvir[], const int snapshot[], std::size_t n, double concentration[]) const
+{
+	// The model is chosen once for all halos, keeping the loop free of branches
+	if (params.concentrationmodel == DarkMatterHaloParameters::DUFFY08) {
+		nfw_concentration<DarkMatterHaloParameters::DUFFY08>(mvir, snapshot, n, concentration);
+	}
+	else {
+		nfw_concentration<DarkMatterHaloParameters::DUTTON14>(mvir, snapshot, n, concentration);
+	}
+}
+
+void DarkMatterHalos::halo_virial_velocity(const float mvir[], const int snapshot[], std::size_t n, double vvir[]) const
+{
+	for (std::size_t i = 0; i != n; i++) {
+		double hparam = get_snapshot_factors(snapshot[i]).hubble_parameter;
+		vvir[i] = std::cbrt(10.0 *constants::G * double(mvir[i]) * hparam);
+	}
+}
+
+void DarkMatterHalos::halo_lambda(const float L[], const float mvir[], const int snapshot[], std::size_t n, float lambda[]) const
+{
+	for (std::size_t i = 0; i != n; i++) {
+		xyz<float> Li {L[3 * i], L[3 * i + 1], L[3 * i + 2]};
+		float m = mvir[i];
+		double lambda_i = Li.norm() / m / 1.41421356237 / std::pow(constants::G * m, 0.666) * get_snapshot_factors(snapshot[i]).lambda_factor;
+		lambda[i] = lambda_i > 1 ? 1 : lambda_i;
+	}
+}
+
 /// Specialization of lambert_w0 implemented using GSL
 template <>
 struct lambert_w0<double>
@@ -427,14 +643,15 @@ struct lambert_w0<double>
 	}
 };
 
-xyz<float> DarkMatterHalos::random_point_in_sphere(float r)
+xyz<float> DarkMatterHalos::random_point_in_sphere(float r, philox_engine &engine)
 {
 	// We distribute cos_theta flatly instead of theta itself to end up with a
 	// more uniform distribution of points in the sphere
-	float cos_theta = flat_distribution(generator) * 2.0 - 1; //flat between -1 and 1.
+	auto flat = flat_distribution;
+	float cos_theta = flat(engine) * 2.0 - 1; //flat between -1 and 1.
 	float theta = std::acos(cos_theta);
 	float sin_theta = std::sin(theta);
-	float phi = flat_distribution(generator) * constants::PI2; //flat between 0 and 2PI.
+	float phi = flat(engine) * constants::PI2; //flat between 0 and 2PI.
 	return {
 		sin_theta * std::cos(phi) * r,
 		sin_theta * std::sin(phi) * r,
@@ -442,33 +659,48 @@ xyz<float> DarkMatterHalos::random_point_in_sphere(float r)
 	};
 }
 
-void DarkMatterHalos::generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz<float> &L, double total_am, const HaloPtr &halo){
+void DarkMatterHalos::generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz<float> &L, double total_am, const HaloPtr &halo, Galaxy::id_t random_key){
+	generate_random_orbits(&pos, &v, &L, &total_am, halo, &random_key, 1);
+}
+
+void DarkMatterHalos::generate_random_orbits(xyz<float> pos[], xyz<float> v[], xyz<float> L[], const double total_am[], const HaloPtr &halo, const Galaxy::id_t random_key[], std::size_t n){
 
 	double c = halo->concentration;
 
 	double rvir = constants::G * halo->Mvir / std::pow(halo->Vvir,2);
-	double vvir = halo->Vvir;
 
-	// Assign positions based on an NFW halo of concentration c.
-	nfw_distribution<double> r(c);
-	double rproj = r(generator);
-	pos = halo->position + random_point_in_sphere(rvir * rproj);
+	// Assign positions based on an NFW halo of concentration c. The first
+	// number of each galaxy's stream is turned into its radius, all galaxies
+	// at once.
+	std::vector<philox_engine> engines;
+	engines.reserve(n);
+	std::vector<double> rproj(n);
+	std::uniform_real_distribution<double> uniform(0, 1);
+	for (std::size_t i = 0; i != n; i++) {
+		engines.emplace_back(seed, philox_engine::SATELLITE_ORBITS, random_key[i], halo->snapshot);
+		rproj[i] = uniform(engines[i]);
+	}
+	nfw_distribution<double>(c).quantiles(rproj.data(), n);
 
-	// Assign velocities using NFW velocity dispersion at the radius in which the galaxy is and assuming isotropy.
-	double sigma = std::sqrt(0.333 * constants::G * halo->Mvir * enclosed_mass(rproj, c) / (rvir * rproj));
+	for (std::size_t i = 0; i != n; i++) {
+		auto &engine = engines[i];
+		pos[i] = halo->position + random_point_in_sphere(rvir * rproj[i], engine);
 
-	// Add the velocity bias of Dieman et al. (2005) found between subhalos and DM particles.
-	sigma = sigma * 1.12 * std::pow(rproj, -0.1);
+		// Assign velocities using NFW velocity dispersion at the radius in which the galaxy is and assuming isotropy.
+		double sigma = std::sqrt(0.333 * constants::G * halo->Mvir * enclosed_mass(rproj[i], c) / (rvir * rproj[i]));
 
-	std::normal_distribution<double> normal_distribution(0, sigma);
-	xyz<double> delta_v {normal_distribution(generator), normal_distribution(generator), normal_distribution(generator)};
+		// Add the velocity bias of Dieman et al. (2005) found between subhalos and DM particles.
+		sigma = sigma * 1.12 * std::pow(rproj[i], -0.1);
 
-	//delta_v and velocity are in physical km/s.
-	v = halo->velocity + delta_v;
+		std::normal_distribution<double> normal_distribution(0, sigma);
+		xyz<double> delta_v {normal_distribution(engine), normal_distribution(engine), normal_distribution(engine)};
 
-	// Assign angular momentum based on random angles,
-	L = random_point_in_sphere(total_am);
+		//delta_v and velocity are in physical km/s.
+		v[i] = halo->velocity + delta_v;
 
+		// Assign angular momentum based on random angles,
+		L[i] = random_point_in_sphere(total_am[i], engine);
+	}
 }
 
 } // namespace shark
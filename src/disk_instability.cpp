@@ -30,6 +30,7 @@
 #include "components.h"
 #include "disk_instability.h"
 #include "numerical_constants.h"
+#include "profiling.h"
 
 namespace shark {
 
@@ -57,12 +58,13 @@ DiskInstability::DiskInstability(DiskInstabilityParameters parameters,
 
 void DiskInstability::evaluate_disk_instability (HaloPtr &halo, int snapshot, double delta_t){
 
+	SHARK_PROFILE(DISK_INSTABILITY);
+
 	double z = simparams.redshifts[snapshot];
 
-	for (auto &subhalo: halo->all_subhalos()){
+	for (auto &subhalo: halo->subhalos()){
 		for (auto &galaxy: subhalo->galaxies){
-			double f = toomre_parameter(galaxy);
-			if(f < parameters.stable){
+			if(is_unstable(*galaxy)){
 				/**
  				* Count number of disk instability episodes.
 		 		*/ 
@@ -129,6 +131,20 @@ double DiskInstability::toomre_parameter(GalaxyPtr &galaxy){
 	return t;
 }
 
+bool DiskInstability::is_unstable(Galaxy &galaxy) const
+{
+	double md = galaxy.disk_mass();
+	double rd = galaxy.disk_size();
+	if (md <= 0 || rd <= 0) {
+		return 100 < parameters.stable;
+	}
+
+	// vc / sqrt(1.68 G md / rd) < stable, with both sides squared
+	double vc = galaxy.vmax;
+	double stable = parameters.stable;
+	return stable > 0 && vc * vc * rd < stable * stable * 1.68 * constants::G * md;
+}
+
 double DiskInstability::bulge_size(GalaxyPtr &galaxy){
 
 	double md = galaxy->disk_mass();
@@ -171,7 +187,7 @@ double DiskInstability::bulge_size(GalaxyPtr &galaxy){
 
 }
 
-void DiskInstability::create_starburst(SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z, double delta_t){
+void DiskInstability::create_starburst(const SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z, double delta_t){
 
 	// Trigger starburst only in case there is gas in the bulge.
 	if(galaxy->bulge_gas.mass > merger_params.mass_min){
@@ -226,27 +242,7 @@ void DiskInstability::transfer_history_disk_to_bulge(GalaxyPtr &galaxy, int snap
 	 */
 
 	//Transfer history of stellar mass growth until the previous snapshot.
-	for(int s=simparams.min_snapshot; s <= snapshot-1; s++) {
-
-		auto it = std::find_if(galaxy->history.begin(), galaxy->history.end(), [s](const HistoryItem &hitem) {
-			return hitem.snapshot == s;
-		});
-
-		if (it == galaxy->history.end()){ //galaxy didn't exist.
-			//no-opt.
-		}
-		else { // both galaxies exist at this snapshot
-			auto &hist = *it;
-
-			//transfer disk information to bulge formed via disk instabilites
-			hist.sfr_bulge_diskins   += hist.sfr_disk;
-			hist.sfr_z_bulge_diskins += hist.sfr_z_disk;
-
-			//make disk properties = 0;
-			hist.sfr_disk   = 0;
-			hist.sfr_z_disk = 0;
-		}
-	}
+	galaxy->history.transfer_disk_to_bulge_diskins(simparams.min_snapshot, snapshot - 1);
 
 }
 
@@ -21,19 +21,23 @@
  * @file
  */
 
+#include <algorithm>
 #include <cmath>
 #include <memory>
+#include <vector>
 
 #include "components.h"
 #include "evolve_halos.h"
 #include "logging.h"
 #include "numerical_constants.h"
+#include "omp_utils.h"
+#include "tree_index.h"
 
 using namespace std;
 
 namespace shark {
 
-void adjust_main_galaxy(const SubhaloPtr &parent, const SubhaloPtr &descendant)
+void adjust_main_galaxy(const SubhaloPtr &parent, const SubhaloPtr &descendant, double age)
 {
 	// A subhalo that is not main progenitor of its descendant cannot
 	// contribute its central galaxy (CENTRAL or TYPE1, depending on the
@@ -59,18 +63,29 @@ void adjust_main_galaxy(const SubhaloPtr &parent, const SubhaloPtr &descendant)
 		main_galaxy->concentration_type2 = parent->concentration;
 		main_galaxy->msubhalo_type2 = parent->Mvir;
 		main_galaxy->lambda_type2 = parent->lambda;
+		parent->queue_merger(main_galaxy, age);
 	}
 
 }
 
-void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int snapshot, TotalBaryon &AllBaryons)
+namespace {
+
+/// The weight of the merger tree of @p halo, if any
+double tree_weight(const Halo &halo)
+{
+	return halo.merger_tree ? halo.merger_tree->weight : 1;
+}
+
+// Transfers the galaxies of @p halos, which must be all the halos of a given
+// merger tree at a given snapshot. Descendants are always in the same merger
+// tree, so different trees can be transferred concurrently.
+transfer_totals transfer_tree_galaxies(span<HaloPtr> halos, double age)
 {
-	unsigned int subhalos_without_descendant = 0;
-	double baryon_mass_loss = 0;
+	transfer_totals totals;
 
 	// Make sure descendants are completely empty
 	for(auto &halo: halos){
-		for(auto &subhalo: halo->all_subhalos()) {
+		for(auto &subhalo: halo->subhalos()) {
 			if (!subhalo->descendant) {
 				continue;
 			}
@@ -79,7 +94,7 @@ void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int s
 	}
 
 	for(auto &halo: halos){
-		for(auto &subhalo: halo->all_subhalos()) {
+		for(auto &subhalo: halo->subhalos()) {
 
 			// Make sure all SFRs (in mass and metals) are set to 0 for the next snapshot
 			for (GalaxyPtr & galaxy: subhalo->galaxies){
@@ -103,8 +118,8 @@ void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int s
 			auto descendant_subhalo = subhalo->descendant;
 
 			if (!descendant_subhalo) {
-				subhalos_without_descendant++;
-				baryon_mass_loss += subhalo->total_baryon_mass();
+				totals.subhalos_without_descendant++;
+				totals.baryon_mass_loss += subhalo->total_baryon_mass() * tree_weight(*halo);
 				continue;
 			}
 
@@ -121,7 +136,7 @@ void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int s
 			// galaxy of this subhalo and then transfer ownership of galaxies
 			// over to the descendant
 			subhalo->check_subhalo_galaxy_composition();
-			adjust_main_galaxy(subhalo, descendant_subhalo);
+			adjust_main_galaxy(subhalo, descendant_subhalo, age);
 			subhalo->transfer_galaxies_to(descendant_subhalo);
 
 			// Transfer subhalo baryon components.
@@ -137,7 +152,7 @@ void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int s
 
 	// Now that descendants have been fully populated they should be correctly composed
 	for(auto &halo: halos){
-		for(auto &subhalo: halo->all_subhalos()) {
+		for(auto &subhalo: halo->subhalos()) {
 			if (!subhalo->descendant) {
 				continue;
 			}
@@ -145,126 +160,168 @@ void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int s
 		}
 	}
 
-	if (subhalos_without_descendant) {
-		AllBaryons.baryon_total_lost[snapshot] = baryon_mass_loss;
-		LOG(warning) << "Found " << subhalos_without_descendant << " subhalos without descendant while transferring galaxies.";
+	return totals;
+}
+
+}  // anonymous namespace
+
+GalaxyTransfer::GalaxyTransfer(int snapshot, double age, unsigned int threads) :
+	snapshot(snapshot),
+	age(age),
+	partial_totals(std::max(threads, 1u))
+{
+}
+
+void GalaxyTransfer::transfer(span<HaloPtr> tree_halos, int thread_idx)
+{
+	partial_totals[thread_idx] += transfer_tree_galaxies(tree_halos, age);
+}
+
+void GalaxyTransfer::add_losses(TotalBaryon &AllBaryons) const
+{
+	transfer_totals totals;
+	for (auto &partial: partial_totals) {
+		totals += partial;
+	}
+
+	if (totals.subhalos_without_descendant) {
+		AllBaryons.baryon_total_lost[snapshot] = totals.baryon_mass_loss;
+		LOG(warning) << "Found " << totals.subhalos_without_descendant << " subhalos without descendant while transferring galaxies.";
 	}
+}
+
+void transfer_galaxies_to_next_snapshot(const TreeIndex &tree_index, std::size_t n_trees, int snapshot, double age, TotalBaryon &AllBaryons, unsigned int threads)
+{
+	GalaxyTransfer transfer(snapshot, age, threads);
+	omp_static_for(std::size_t(0), n_trees, threads, [&](std::size_t tree, int thread_idx) {
+		transfer.transfer(tree_index.tree_halos(snapshot, tree), thread_idx);
+	});
+	transfer.add_losses(AllBaryons);
+}
 
+BaryonTracker::BaryonTracker(Cosmology &cosmology, const ExecutionParameters &execparams, const SimulationParameters &simulation_params,
+		int snapshot, const molgas_per_galaxy &molgas, double deltat, unsigned int threads) :
+	execparams(execparams),
+	snapshot(snapshot),
+	molgas(molgas),
+	deltat(deltat),
+	partial_totals(std::max(threads, 1u))
+{
+	double z1 = simulation_params.redshifts.at(snapshot);
+	double z2 = simulation_params.redshifts.at(snapshot+1);
+	mean_age = 0.5 * (cosmology.convert_redshift_to_age(z1) + cosmology.convert_redshift_to_age(z2));
 }
 
-void track_total_baryons(StarFormation &starformation, Cosmology &cosmology, ExecutionParameters execparams, SimulationParameters simulation_params, const std::vector<HaloPtr> &halos,
-		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat){
-
-
-	BaryonBase mcold_total;
-	BaryonBase mhothalo_total;
-	BaryonBase mcoldhalo_total;
-	BaryonBase mejectedhalo_total;
-	BaryonBase mstars_total;
-	BaryonBase mstars_bursts_galaxymergers;
-	BaryonBase mstars_bursts_diskinstabilities;
-	BaryonBase MBH_total;
-	BaryonBase mHI_total;
-	BaryonBase mH2_total;
-	BaryonBase mDM_total;
-
-	double SFR_total_disk = 0;
-	double SFR_total_burst = 0;
-
-	int number_major_mergers = 0;
-	int number_minor_mergers = 0;
-	int number_disk_instabil = 0;
-
-	double z1 = simulation_params.redshifts[snapshot];
-	double z2 = simulation_params.redshifts[snapshot+1];
-
-	double mean_age = 0.5 * (cosmology.convert_redshift_to_age(z1) + cosmology.convert_redshift_to_age(z2));
-
-	// Loop over all halos and subhalos to write galaxy properties
-	for (auto &halo: halos){
-
-		// accumulate dark matter mass
-		mDM_total.mass += halo->Mvir;
-        
-		for (auto &subhalo: halo->all_subhalos()){
-        
-			// Accumulate subhalo baryons
-			mhothalo_total.mass += subhalo->hot_halo_gas.mass;
-			mhothalo_total.mass_metals += subhalo->hot_halo_gas.mass_metals;
-        
-			mcoldhalo_total.mass += subhalo->cold_halo_gas.mass;
-			mcoldhalo_total.mass_metals += subhalo->cold_halo_gas.mass_metals;
-        
-			mejectedhalo_total.mass += subhalo->ejected_galaxy_gas.mass;
-			mejectedhalo_total.mass_metals += subhalo->ejected_galaxy_gas.mass_metals;
-        
-			for (auto &galaxy: subhalo->galaxies){
-       
-				number_major_mergers += galaxy->interaction.major_mergers;
- 				number_minor_mergers += galaxy->interaction.minor_mergers;
-				number_disk_instabil += galaxy->interaction.disk_instabilities;
-
-				if(execparams.output_sf_histories){
-        
-					galaxy->mean_stellar_age += (galaxy->sfr_disk + galaxy->sfr_bulge_mergers + galaxy->sfr_bulge_diskins) * deltat * mean_age;
-					galaxy->total_stellar_mass_ever_formed += (galaxy->sfr_disk + galaxy->sfr_bulge_mergers + galaxy->sfr_bulge_diskins) * deltat;
-
-					HistoryItem hist_galaxy;
-					hist_galaxy.sfr_disk            = galaxy->sfr_disk;
-					hist_galaxy.sfr_bulge_mergers   = galaxy->sfr_bulge_mergers;
-					hist_galaxy.sfr_bulge_diskins   = galaxy->sfr_bulge_diskins;
-					hist_galaxy.sfr_z_disk          = galaxy->sfr_z_disk;
-					hist_galaxy.sfr_z_bulge_mergers = galaxy->sfr_z_bulge_mergers;
-					hist_galaxy.sfr_z_bulge_diskins = galaxy->sfr_z_bulge_diskins;
-					hist_galaxy.snapshot            = snapshot;
-					galaxy->history.emplace_back(std::move(hist_galaxy));
-				}
-        
-				//Accumulate galaxy baryons
-				auto &molecular_gas = molgas.at(galaxy);
-        
-				mHI_total.mass += molecular_gas.m_atom + molecular_gas.m_atom_b;
-				mH2_total.mass += molecular_gas.m_mol + molecular_gas.m_mol_b;
-        
-				mcold_total.mass += galaxy->disk_gas.mass + galaxy->bulge_gas.mass;
-				mcold_total.mass_metals += galaxy->disk_gas.mass_metals + galaxy->bulge_gas.mass_metals;
-        
-				mstars_total.mass += galaxy->disk_stars.mass + galaxy->bulge_stars.mass;
-				mstars_total.mass_metals += galaxy->disk_stars.mass_metals + galaxy->bulge_stars.mass_metals;
-        
-				mstars_bursts_galaxymergers.mass += galaxy->galaxymergers_burst_stars.mass;
-				mstars_bursts_galaxymergers.mass_metals += galaxy->galaxymergers_burst_stars.mass_metals;
-				mstars_bursts_diskinstabilities.mass += galaxy->diskinstabilities_burst_stars.mass;
-				mstars_bursts_diskinstabilities.mass_metals += galaxy->diskinstabilities_burst_stars.mass_metals;
-
-				SFR_total_disk  += galaxy->sfr_disk;
-				SFR_total_burst += galaxy->sfr_bulge_mergers + galaxy->sfr_bulge_diskins;
-        
-				MBH_total.mass += galaxy->smbh.mass;
-        
+void BaryonTracker::track(const HaloPtr &halo, int thread_idx)
+{
+	baryon_totals totals;
+
+	// accumulate dark matter mass
+	totals.mDM_total.mass += halo->Mvir;
+
+	for (auto &subhalo: halo->subhalos()){
+
+		// Accumulate subhalo baryons
+		totals.mhothalo_total.mass += subhalo->hot_halo_gas.mass;
+		totals.mhothalo_total.mass_metals += subhalo->hot_halo_gas.mass_metals;
+
+		totals.mcoldhalo_total.mass += subhalo->cold_halo_gas.mass;
+		totals.mcoldhalo_total.mass_metals += subhalo->cold_halo_gas.mass_metals;
+
+		totals.mejectedhalo_total.mass += subhalo->ejected_galaxy_gas.mass;
+		totals.mejectedhalo_total.mass_metals += subhalo->ejected_galaxy_gas.mass_metals;
+
+		for (auto &galaxy: subhalo->galaxies){
+
+			totals.number_major_mergers += galaxy->interaction.major_mergers;
+			totals.number_minor_mergers += galaxy->interaction.minor_mergers;
+			totals.number_disk_instabil += galaxy->interaction.disk_instabilities;
+
+			if(execparams.output_sf_histories){
+
+				galaxy->mean_stellar_age += (galaxy->sfr_disk + galaxy->sfr_bulge_mergers + galaxy->sfr_bulge_diskins) * deltat * mean_age;
+				galaxy->total_stellar_mass_ever_formed += (galaxy->sfr_disk + galaxy->sfr_bulge_mergers + galaxy->sfr_bulge_diskins) * deltat;
+
+				HistoryItem hist_galaxy;
+				hist_galaxy.sfr_disk            = galaxy->sfr_disk;
+				hist_galaxy.sfr_bulge_mergers   = galaxy->sfr_bulge_mergers;
+				hist_galaxy.sfr_bulge_diskins   = galaxy->sfr_bulge_diskins;
+				hist_galaxy.sfr_z_disk          = galaxy->sfr_z_disk;
+				hist_galaxy.sfr_z_bulge_mergers = galaxy->sfr_z_bulge_mergers;
+				hist_galaxy.sfr_z_bulge_diskins = galaxy->sfr_z_bulge_diskins;
+				hist_galaxy.snapshot            = snapshot;
+				galaxy->history.add(hist_galaxy);
 			}
+
+			//Accumulate galaxy baryons
+			auto &molecular_gas = molgas.at(galaxy);
+
+			totals.mHI_total.mass += molecular_gas.m_atom + molecular_gas.m_atom_b;
+			totals.mH2_total.mass += molecular_gas.m_mol + molecular_gas.m_mol_b;
+
+			totals.mcold_total.mass += galaxy->disk_gas.mass + galaxy->bulge_gas.mass;
+			totals.mcold_total.mass_metals += galaxy->disk_gas.mass_metals + galaxy->bulge_gas.mass_metals;
+
+			totals.mstars_total.mass += galaxy->disk_stars.mass + galaxy->bulge_stars.mass;
+			totals.mstars_total.mass_metals += galaxy->disk_stars.mass_metals + galaxy->bulge_stars.mass_metals;
+
+			totals.mstars_bursts_galaxymergers.mass += galaxy->galaxymergers_burst_stars.mass;
+			totals.mstars_bursts_galaxymergers.mass_metals += galaxy->galaxymergers_burst_stars.mass_metals;
+			totals.mstars_bursts_diskinstabilities.mass += galaxy->diskinstabilities_burst_stars.mass;
+			totals.mstars_bursts_diskinstabilities.mass_metals += galaxy->diskinstabilities_burst_stars.mass_metals;
+
+			totals.SFR_total_disk  += galaxy->sfr_disk;
+			totals.SFR_total_burst += galaxy->sfr_bulge_mergers + galaxy->sfr_bulge_diskins;
+
+			totals.MBH_total.mass += galaxy->smbh.mass;
+
 		}
 	}
 
-	AllBaryons.mstars.push_back(mstars_total);
-	AllBaryons.mstars_burst_galaxymergers.push_back(mstars_bursts_galaxymergers);
-	AllBaryons.mstars_burst_diskinstabilities.push_back(mstars_bursts_diskinstabilities);
-	AllBaryons.mcold.push_back(mcold_total);
-	AllBaryons.mHI.push_back(mHI_total);
-	AllBaryons.mH2.push_back(mH2_total);
-	AllBaryons.mBH.push_back(MBH_total);
-	AllBaryons.SFR_disk.push_back(SFR_total_disk);
-	AllBaryons.SFR_bulge.push_back(SFR_total_burst);
-
-	AllBaryons.major_mergers.push_back(number_major_mergers);
-	AllBaryons.minor_mergers.push_back(number_minor_mergers);
-	AllBaryons.disk_instabil.push_back(number_disk_instabil);
-
-	AllBaryons.mhot_halo.push_back(mhothalo_total);
-	AllBaryons.mcold_halo.push_back(mcoldhalo_total);
-	AllBaryons.mejected_halo.push_back(mejectedhalo_total);
-
-	AllBaryons.mDM.push_back(mDM_total);
+	partial_totals[thread_idx].add(totals, tree_weight(*halo));
+}
+
+void BaryonTracker::add_totals(TotalBaryon &AllBaryons) const
+{
+	baryon_totals totals;
+	for (auto &partial: partial_totals) {
+		totals += partial;
+	}
+
+	AllBaryons.mstars.push_back(totals.mstars_total);
+	AllBaryons.mstars_burst_galaxymergers.push_back(totals.mstars_bursts_galaxymergers);
+	AllBaryons.mstars_burst_diskinstabilities.push_back(totals.mstars_bursts_diskinstabilities);
+	AllBaryons.mcold.push_back(totals.mcold_total);
+	AllBaryons.mHI.push_back(totals.mHI_total);
+	AllBaryons.mH2.push_back(totals.mH2_total);
+	AllBaryons.mBH.push_back(totals.MBH_total);
+	AllBaryons.SFR_disk.push_back(totals.SFR_total_disk);
+	AllBaryons.SFR_bulge.push_back(totals.SFR_total_burst);
+
+	AllBaryons.major_mergers.push_back(int(std::lround(totals.number_major_mergers)));
+	AllBaryons.minor_mergers.push_back(int(std::lround(totals.number_minor_mergers)));
+	AllBaryons.disk_instabil.push_back(int(std::lround(totals.number_disk_instabil)));
+
+	AllBaryons.mhot_halo.push_back(totals.mhothalo_total);
+	AllBaryons.mcold_halo.push_back(totals.mcoldhalo_total);
+	AllBaryons.mejected_halo.push_back(totals.mejectedhalo_total);
+
+	AllBaryons.mDM.push_back(totals.mDM_total);
+}
+
+void track_total_baryons(Cosmology &cosmology, const ExecutionParameters &execparams, const SimulationParameters &simulation_params, const std::vector<HaloPtr> &halos,
+		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat, unsigned int threads){
+
+	// Loop over all halos and subhalos to write galaxy properties.
+	// Halos are statically partitioned across threads like merger trees are
+	// during evolution, each thread accumulating its own partial totals,
+	// which are then combined in thread order so results are reproducible.
+	// Each halo contributes with the weight of its merger tree
+	BaryonTracker tracker(cosmology, execparams, simulation_params, snapshot, molgas, deltat, threads);
+	omp_static_for(halos, threads, [&](const HaloPtr &halo, int thread_idx) {
+		tracker.track(halo, thread_idx);
+	});
+	tracker.add_totals(AllBaryons);
 }
 
 }
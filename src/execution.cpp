@@ -27,6 +27,8 @@
 #include <tuple>
 
 #include "execution.h"
+#include "option_dependencies.h"
+#include "utils.h"
 
 namespace shark {
 
@@ -44,9 +46,282 @@ ExecutionParameters::ExecutionParameters(const Options &options)
 	options.load("execution.ode_solver_precision", ode_solver_precision, true);
 	options.load("execution.name_model", name_model, true);
 	options.load("execution.seed", seed);
+	options.load("execution.tree_sampling_rate", tree_sampling_rate);
+	options.load("execution.min_branch_mass", min_branch_mass);
+
+	auto selection_shape = SpatialSelection::NONE;
+	std::vector<double> selection_region;
+	options.load("execution.spatial_selection", selection_shape);
+	options.load("execution.spatial_selection_region", selection_region);
 
 	options.load("execution.output_sf_histories", output_sf_histories);
 	options.load("execution.snapshots_sf_histories", snapshots_sf_histories);
+	options.load("execution.stream_sf_histories", stream_sf_histories);
+	options.load("execution.sf_histories_encoding", sf_histories_encoding);
+
+	options.load("execution.tree_scheduling", tree_scheduling);
+	options.load("execution.ode_solver", ode_solver);
+	options.load("execution.batch_ode_check_tolerance", batch_ode_check_tolerance);
+	options.load("execution.ode_stepper", ode_stepper);
+	ode_starburst_stepper = ode_stepper;
+	options.load("execution.ode_starburst_stepper", ode_starburst_stepper);
+	options.load("execution.warm_start_ode", warm_start_ode);
+	options.load("execution.halo_parallelism", halo_parallelism);
+	options.load("execution.fused_molecular_gas", fused_molecular_gas);
+	options.load("execution.cooling_prepass", cooling_prepass);
+	options.load("execution.pipelined_snapshots", pipelined_snapshots);
+	options.load("execution.tracked_molecular_gas", tracked_molecular_gas);
+	options.load("execution.output_snapshots_in_flight", output_snapshots_in_flight);
+	options.load("execution.output_compression", output_compression);
+	options.load("execution.output_compression_level", output_compression_level);
+	options.load("execution.output_shuffle", output_shuffle);
+	options.load("execution.output_chunk_size", output_chunk_size);
+	options.load("execution.shared_output", shared_output);
+	options.load("execution.output_properties", output_properties);
+	options.load("execution.excluded_output_properties", excluded_output_properties);
+	options.load("execution.summary_statistics", summary_statistics);
+	options.load("execution.summary_only", summary_only);
+	options.load("execution.summary_mass_bins", summary_mass_bins);
+	options.load("execution.reader_batches_in_flight", reader_batches_in_flight);
+	options.load("execution.reader_chunk_size", reader_chunk_size);
+	options.load("execution.tree_cache_directory", tree_cache_directory);
+	options.load("execution.checkpoint_snapshots", checkpoint_snapshots);
+	options.load("execution.restart_file", restart_file);
+	options.load("execution.metrics_file", metrics_file);
+	options.load("execution.ode_costs_file", ode_costs_file);
+	options.load("execution.ode_costs_count", ode_costs_count);
+	options.load("execution.trace_file", trace_file);
+	options.load("execution.status_file", status_file);
+	options.load("execution.tree_costs_count", tree_costs_count);
+	options.load("execution.integration_failure_budget", integration_failure_budget);
+	options.load("execution.batch_group_size", batch_group_size);
+	options.load("execution.prefetch_threads", prefetch_threads);
+	options.load("execution.release_evolved_snapshots", release_evolved_snapshots);
+	options.load("execution.arena_allocation", arena_allocation);
+	options.load("execution.numa_placement", numa_placement);
+	options.load("execution.huge_pages", huge_pages);
+	options.load("execution.memory_budget", memory_budget);
+	options.load("execution.memory_budget_policy", memory_budget_policy);
+	options.load("execution.tree_migration", tree_migration);
+	options.load("execution.tree_migration_imbalance", tree_migration_imbalance);
+
+	if (tree_sampling_rate <= 0 || tree_sampling_rate > 1) {
+		throw invalid_option("execution.tree_sampling_rate must be in (0, 1]");
+	}
+	if (selection_shape == SpatialSelection::BOX && (selection_region.size() != 6 || selection_region[3] <= selection_region[0] ||
+	                                                 selection_region[4] <= selection_region[1] || selection_region[5] <= selection_region[2])) {
+		throw invalid_option("execution.spatial_selection_region must be the minimum x, y and z and a larger maximum x, y and z of the box");
+	}
+	if (selection_shape == SpatialSelection::SPHERE && (selection_region.size() != 4 || selection_region[3] <= 0)) {
+		throw invalid_option("execution.spatial_selection_region must be the x, y and z of the centre and a positive radius of the sphere");
+	}
+	if (selection_shape != SpatialSelection::NONE) {
+		spatial_selection = SpatialSelection(selection_shape, selection_region);
+	}
+	if (min_branch_mass < 0) {
+		throw invalid_option("execution.min_branch_mass must be positive or 0");
+	}
+	if (integration_failure_budget < 0 || integration_failure_budget > 1) {
+		throw invalid_option("execution.integration_failure_budget must be in [0, 1]");
+	}
+	if (memory_budget < 0) {
+		throw invalid_option("execution.memory_budget must be positive or 0");
+	}
+	if (output_compression_level < 1 || output_compression_level > 9) {
+		throw invalid_option("execution.output_compression_level must be between 1 and 9");
+	}
+	if (shared_output && output_format != Options::HDF5) {
+		throw invalid_option("execution.shared_output requires execution.output_format = hdf5");
+	}
+	if (numa_placement && (tree_scheduling != STATIC || halo_parallelism)) {
+		throw invalid_option("execution.numa_placement requires execution.tree_scheduling = static and execution.halo_parallelism = false");
+	}
+	if (pipelined_snapshots && (!fused_molecular_gas || halo_parallelism)) {
+		throw invalid_option("execution.pipelined_snapshots requires execution.fused_molecular_gas = true and execution.halo_parallelism = false");
+	}
+	if (tree_migration_imbalance < 1) {
+		throw invalid_option("execution.tree_migration_imbalance must be 1 or larger");
+	}
+	if (tree_migration && !shared_output) {
+		throw invalid_option("execution.tree_migration requires execution.shared_output = true, so migrated trees are written into the shared outputs");
+	}
+	if (tree_migration && (halo_parallelism || stream_sf_histories)) {
+		throw invalid_option("execution.tree_migration requires execution.halo_parallelism = false and execution.stream_sf_histories = false");
+	}
+	if (tree_migration && (!checkpoint_snapshots.empty() || !restart_file.empty())) {
+		throw invalid_option("execution.tree_migration cannot be used together with execution.checkpoint_snapshots or execution.restart_file");
+	}
+	if (summary_only && !summary_statistics) {
+		throw invalid_option("execution.summary_only requires execution.summary_statistics = true");
+	}
+	if (summary_mass_bins.size() != 3 || summary_mass_bins[1] <= summary_mass_bins[0] || summary_mass_bins[2] <= 0) {
+		throw invalid_option("execution.summary_mass_bins must be a minimum, a larger maximum and a positive bin width");
+	}
+}
+
+void ExecutionParameters::declare_dependencies(OptionDependencies &dependencies)
+{
+	// Outputs, I/O, scheduling and memory management options, which don't
+	// change the evolution of galaxies. Options changing which halos are read
+	// (e.g., execution.output_snapshots) don't belong here
+	for (auto name: {
+	         "execution.output_format", "execution.output_directory", "execution.name_model",
+	         "execution.warn_on_missing_descendants",
+	         "execution.output_sf_histories", "execution.snapshots_sf_histories",
+	         "execution.stream_sf_histories", "execution.sf_histories_encoding",
+	         "execution.tree_scheduling", "execution.halo_parallelism",
+	         "execution.fused_molecular_gas", "execution.pipelined_snapshots",
+	         "execution.tracked_molecular_gas", "execution.batch_ode_check_tolerance",
+	         "execution.output_snapshots_in_flight", "execution.output_compression",
+	         "execution.output_compression_level", "execution.output_shuffle",
+	         "execution.output_chunk_size", "execution.shared_output",
+	         "execution.output_properties", "execution.excluded_output_properties",
+	         "execution.summary_statistics", "execution.summary_only", "execution.summary_mass_bins",
+	         "execution.reader_batches_in_flight", "execution.reader_chunk_size",
+	         "execution.tree_cache_directory", "execution.checkpoint_snapshots",
+	         "execution.restart_file", "execution.metrics_file", "execution.ode_costs_file",
+	         "execution.ode_costs_count", "execution.trace_file", "execution.status_file",
+	         "execution.tree_costs_count", "execution.integration_failure_budget",
+	         "execution.prefetch_threads", "execution.release_evolved_snapshots",
+	         "execution.arena_allocation", "execution.numa_placement", "execution.huge_pages",
+	         "execution.memory_budget", "execution.memory_budget_policy"}) {
+		dependencies.never(name);
+	}
+}
+
+template <>
+ExecutionParameters::tree_scheduling_t
+Options::get<ExecutionParameters::tree_scheduling_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "static") {
+		return ExecutionParameters::STATIC;
+	}
+	else if (lvalue == "dynamic") {
+		return ExecutionParameters::DYNAMIC;
+	}
+	else if (lvalue == "cost_aware") {
+		return ExecutionParameters::COST_AWARE;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are static, dynamic and cost_aware";
+	throw invalid_option(os.str());
+}
+
+template <>
+ExecutionParameters::sf_histories_encoding_t
+Options::get<ExecutionParameters::sf_histories_encoding_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "dense") {
+		return ExecutionParameters::SFH_DENSE;
+	}
+	else if (lvalue == "sparse") {
+		return ExecutionParameters::SFH_SPARSE;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are dense and sparse";
+	throw invalid_option(os.str());
+}
+
+template <>
+ExecutionParameters::ode_solver_t
+Options::get<ExecutionParameters::ode_solver_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "gsl") {
+		return ExecutionParameters::ODE_GSL;
+	}
+	else if (lvalue == "batched") {
+		return ExecutionParameters::ODE_BATCHED;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are gsl and batched";
+	throw invalid_option(os.str());
+}
+
+template <>
+ExecutionParameters::ode_stepper_t
+Options::get<ExecutionParameters::ode_stepper_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "rkck") {
+		return ExecutionParameters::RKCK;
+	}
+	else if (lvalue == "msbdf") {
+		return ExecutionParameters::MSBDF;
+	}
+	else if (lvalue == "bsimp") {
+		return ExecutionParameters::BSIMP;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are rkck, msbdf and bsimp";
+	throw invalid_option(os.str());
+}
+
+template <>
+ExecutionParameters::memory_budget_policy_t
+Options::get<ExecutionParameters::memory_budget_policy_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "abort") {
+		return ExecutionParameters::BUDGET_ABORT;
+	}
+	else if (lvalue == "adapt") {
+		return ExecutionParameters::BUDGET_ADAPT;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are abort and adapt";
+	throw invalid_option(os.str());
+}
+
+template <>
+ExecutionParameters::output_compression_t
+Options::get<ExecutionParameters::output_compression_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "none") {
+		return ExecutionParameters::COMPRESSION_NONE;
+	}
+	else if (lvalue == "deflate") {
+		return ExecutionParameters::COMPRESSION_DEFLATE;
+	}
+	else if (lvalue == "lz4") {
+		return ExecutionParameters::COMPRESSION_LZ4;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are none, deflate and lz4";
+	throw invalid_option(os.str());
+}
+
+template <>
+ExecutionParameters::tracked_molecular_gas_t
+Options::get<ExecutionParameters::tracked_molecular_gas_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "full") {
+		return ExecutionParameters::MOLGAS_FULL;
+	}
+	else if (lvalue == "approximate") {
+		return ExecutionParameters::MOLGAS_APPROXIMATE;
+	}
+	else if (lvalue == "none") {
+		return ExecutionParameters::MOLGAS_NONE;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are full, approximate and none";
+	throw invalid_option(os.str());
+}
+
+template <>
+SpatialSelection::shape_t
+Options::get<SpatialSelection::shape_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "none") {
+		return SpatialSelection::NONE;
+	}
+	else if (lvalue == "box") {
+		return SpatialSelection::BOX;
+	}
+	else if (lvalue == "sphere") {
+		return SpatialSelection::SPHERE;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are none, box and sphere";
+	throw invalid_option(os.str());
 }
 
 bool ExecutionParameters::output_snapshot(int snapshot)
@@ -54,8 +329,27 @@ bool ExecutionParameters::output_snapshot(int snapshot)
 	return output_snapshots.find(snapshot) != output_snapshots.end();
 }
 
-int ExecutionParameters::last_output_snapshot()
+int ExecutionParameters::last_output_snapshot() const
 {
 	return *output_snapshots.rbegin();
 }
+
+static
+bool _matches_property(const std::vector<std::string> &names, const std::string &name)
+{
+	for (auto &selected: names) {
+		if (name == selected || (name.size() > selected.size() && name.compare(0, selected.size(), selected) == 0 && name[selected.size()] == '/')) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ExecutionParameters::output_property(const std::string &name) const
+{
+	if (!output_properties.empty() && !_matches_property(output_properties, name)) {
+		return false;
+	}
+	return !_matches_property(excluded_output_properties, name);
+}
 }
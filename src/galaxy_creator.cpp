@@ -23,46 +23,133 @@
  * Galaxy creator class implementation
  */
 
+#include <exception>
+#include <map>
+#include <vector>
+
 #include "galaxy_creator.h"
 #include "logging.h"
+#include "omp_utils.h"
 #include "timer.h"
+#include "utils.h"
 
 namespace shark {
 
-GalaxyCreator::GalaxyCreator(const CosmologyPtr &cosmology, GasCoolingParameters cool_params, SimulationParameters sim_params) :
+GalaxyCreator::GalaxyCreator(const CosmologyPtr &cosmology, GasCoolingParameters cool_params, SimulationParameters sim_params, bool arena_allocation) :
 	cosmology(cosmology),
 	cool_params(cool_params),
-	sim_params(sim_params)
+	sim_params(sim_params),
+	arena_allocation(arena_allocation)
 {
 	// no-op
 }
 
-void GalaxyCreator::create_galaxies(const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &AllBaryons)
+Galaxy::id_t GalaxyCreator::create_galaxies(const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &AllBaryons)
 {
 	int galaxies_added = 0;
 	double total_baryon = 0.0;
 
 	Galaxy::id_t galaxy_id = 0;
+	std::size_t arena_memory = 0;
 	auto timer = Timer();
 	for(int snapshot = sim_params.min_snapshot; snapshot <= sim_params.max_snapshot - 1; snapshot++) {
 		auto z = sim_params.redshifts[snapshot];
+		ArenaPtr arena;
+		if (arena_allocation) {
+			arena = std::make_shared<Arena>();
+		}
 		for(auto &merger_tree: merger_trees) {
 			for(auto &halo: merger_tree->halos[snapshot]) {
-				if (create_galaxies(halo, z, galaxy_id)) {
+				if (create_galaxies(halo, z, galaxy_id, arena)) {
 					galaxy_id++;
 					galaxies_added++;
-					total_baryon += halo->central_subhalo->hot_halo_gas.mass;
+					total_baryon += halo->central_subhalo->hot_halo_gas.mass * merger_tree->weight;
 				}
 			}
 		}
 		// Keep track of the total amount of baryons integrated from the first snapshot to the current one.
 		AllBaryons.baryon_total_created[snapshot] += total_baryon;
+		if (arena) {
+			arena_memory += arena->reserved();
+		}
 	}
 
 	LOG(info) << "Created " << galaxies_added << " initial galaxies in " << timer;
+	if (arena_allocation) {
+		LOG(info) << "Galaxy arenas reserved " << memory_amount(arena_memory) << " of memory";
+	}
+	return galaxy_id;
+}
+
+Galaxy::id_t GalaxyCreator::create_galaxies(const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &AllBaryons, const TreeAssignment &assignment)
+{
+	auto timer = Timer();
+	std::map<int, double> redshifts;
+	for(int snapshot = sim_params.min_snapshot; snapshot <= sim_params.max_snapshot - 1; snapshot++) {
+		redshifts[snapshot] = sim_params.redshifts[snapshot];
+	}
+
+	// Galaxies are created with a temporary ID by the thread owning their tree
+	auto threads = assignment.threads();
+	std::vector<ArenaSet<int>> t_arenas(arena_allocation ? threads : 0);
+	std::vector<std::exception_ptr> errors(threads);
+	omp_per_thread(threads, [&](unsigned int t, int thread_idx) {
+		try {
+			for (auto tree = assignment.begin(t); tree != assignment.end(t); tree++) {
+				for (auto &snapshot_and_halos: merger_trees[tree]->halos) {
+					auto it = redshifts.find(snapshot_and_halos.first);
+					if (it == redshifts.end()) {
+						continue;
+					}
+					ArenaPtr arena;
+					if (arena_allocation) {
+						arena = t_arenas[thread_idx].get(it->first);
+					}
+					for (auto &halo: snapshot_and_halos.second) {
+						create_galaxies(halo, it->second, 0, arena);
+					}
+				}
+			}
+		} catch (...) {
+			errors[t] = std::current_exception();
+		}
+	});
+	for (auto &error: errors) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	// IDs and baryon totals follow the same order as the sequential creation
+	int galaxies_added = 0;
+	double total_baryon = 0.0;
+	Galaxy::id_t galaxy_id = 0;
+	for (auto &snapshot_and_z: redshifts) {
+		for (auto &merger_tree: merger_trees) {
+			for (auto &halo: merger_tree->halos[snapshot_and_z.first]) {
+				if (halo->central_subhalo->ascendants.empty()) {
+					auto &galaxy = halo->central_subhalo->galaxies.front();
+					galaxy->id = galaxy->random_key = galaxy_id++;
+					galaxies_added++;
+					total_baryon += halo->central_subhalo->hot_halo_gas.mass * merger_tree->weight;
+				}
+			}
+		}
+		AllBaryons.baryon_total_created[snapshot_and_z.first] += total_baryon;
+	}
+
+	LOG(info) << "Created " << galaxies_added << " initial galaxies in " << timer;
+	if (arena_allocation) {
+		std::size_t arena_memory = 0;
+		for (auto &arenas: t_arenas) {
+			arena_memory += arenas.reserved();
+		}
+		LOG(info) << "Galaxy arenas reserved " << memory_amount(arena_memory) << " of memory";
+	}
+	return galaxy_id;
 }
 
-bool GalaxyCreator::create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t galaxy_id)
+bool GalaxyCreator::create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t galaxy_id, const ArenaPtr &arena)
 {
 
 	// Halo has a central subhalo with ascendants so ignore it, as it should already have galaxies in it.
@@ -87,7 +174,7 @@ bool GalaxyCreator::create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t
 		throw invalid_argument(os.str());
 	}
 
-	auto galaxy = std::make_shared<Galaxy>(galaxy_id);
+	auto galaxy = make_shared_in<Galaxy>(arena, galaxy_id);
 	galaxy->galaxy_type = Galaxy::CENTRAL;
 
 	central_subhalo->galaxies.push_back(galaxy);
@@ -0,0 +1,236 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * GalaxyHistory implementation
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "galaxy_history.h"
+
+namespace shark {
+
+void GalaxyHistory::cover(int snapshot)
+{
+	if (present.empty()) {
+		first = snapshot;
+		present.push_back(false);
+		for (auto &col: columns) {
+			col.push_back(0);
+		}
+		return;
+	}
+
+	// Items are normally added in increasing snapshot order; earlier
+	// snapshots only appear when inheriting a merging satellite's history
+	if (snapshot < first) {
+		auto n = std::size_t(first - snapshot);
+		present.insert(present.begin(), n, false);
+		for (auto &col: columns) {
+			col.insert(col.begin(), n, 0);
+		}
+		first = snapshot;
+	}
+	else if (snapshot > last_snapshot()) {
+		auto size = std::size_t(snapshot - first + 1);
+		present.resize(size, false);
+		for (auto &col: columns) {
+			col.resize(size, 0);
+		}
+	}
+}
+
+void GalaxyHistory::add(const HistoryItem &item)
+{
+	cover(item.snapshot);
+	auto idx = item.snapshot - first;
+	if (!present[idx]) {
+		present[idx] = true;
+		n_items++;
+	}
+	columns[SFR_DISK][idx] = item.sfr_disk;
+	columns[SFR_BULGE_MERGERS][idx] = item.sfr_bulge_mergers;
+	columns[SFR_BULGE_DISKINS][idx] = item.sfr_bulge_diskins;
+	columns[SFR_Z_DISK][idx] = item.sfr_z_disk;
+	columns[SFR_Z_BULGE_MERGERS][idx] = item.sfr_z_bulge_mergers;
+	columns[SFR_Z_BULGE_DISKINS][idx] = item.sfr_z_bulge_diskins;
+}
+
+HistoryItem GalaxyHistory::get(int snapshot) const
+{
+	auto idx = snapshot - first;
+	return {
+		columns[SFR_DISK][idx],
+		columns[SFR_BULGE_MERGERS][idx],
+		columns[SFR_BULGE_DISKINS][idx],
+		columns[SFR_Z_DISK][idx],
+		columns[SFR_Z_BULGE_MERGERS][idx],
+		columns[SFR_Z_BULGE_DISKINS][idx],
+		snapshot
+	};
+}
+
+std::vector<int> GalaxyHistory::snapshots() const
+{
+	std::vector<int> snapshots;
+	snapshots.reserve(n_items);
+	for (std::size_t i = 0; i != present.size(); i++) {
+		if (present[i]) {
+			snapshots.push_back(first + int(i));
+		}
+	}
+	return snapshots;
+}
+
+std::vector<HistoryItem> GalaxyHistory::items() const
+{
+	std::vector<HistoryItem> items;
+	items.reserve(n_items);
+	for (auto snapshot: snapshots()) {
+		items.push_back(get(snapshot));
+	}
+	return items;
+}
+
+void GalaxyHistory::clear()
+{
+	first = 0;
+	n_items = 0;
+	present.clear();
+	for (auto &col: columns) {
+		col.clear();
+	}
+}
+
+void GalaxyHistory::transfer_disk_to_bulge_diskins(int from_snapshot, int to_snapshot)
+{
+	if (is_streamed) {
+		events.push_back({HistoryEvent::DISK_TO_BULGE_DISKINS, from_snapshot, to_snapshot, galaxy_id, -1});
+	}
+
+	auto &sfr_disk = columns[SFR_DISK];
+	auto &sfr_z_disk = columns[SFR_Z_DISK];
+	auto &sfr_bulge_diskins = columns[SFR_BULGE_DISKINS];
+	auto &sfr_z_bulge_diskins = columns[SFR_Z_BULGE_DISKINS];
+
+	// Snapshots where the galaxy didn't exist hold zeros, so the whole
+	// range can be transferred without looking at which items exist
+	auto start = std::max(from_snapshot, first) - first;
+	auto end = std::min(to_snapshot, last_snapshot()) - first;
+	for (int i = start; i <= end; i++) {
+
+		//transfer disk information to bulge formed via disk instabilites
+		sfr_bulge_diskins[i]   += sfr_disk[i];
+		sfr_z_bulge_diskins[i] += sfr_z_disk[i];
+
+		//make disk properties = 0;
+		sfr_disk[i]   = 0;
+		sfr_z_disk[i] = 0;
+	}
+}
+
+void GalaxyHistory::transfer_disk_to_bulge_mergers(int from_snapshot, int to_snapshot)
+{
+	if (is_streamed) {
+		events.push_back({HistoryEvent::DISK_TO_BULGE_MERGERS, from_snapshot, to_snapshot, galaxy_id, -1});
+	}
+
+	auto &sfr_disk = columns[SFR_DISK];
+	auto &sfr_z_disk = columns[SFR_Z_DISK];
+	auto &sfr_bulge_mergers = columns[SFR_BULGE_MERGERS];
+	auto &sfr_z_bulge_mergers = columns[SFR_Z_BULGE_MERGERS];
+	auto &sfr_bulge_diskins = columns[SFR_BULGE_DISKINS];
+	auto &sfr_z_bulge_diskins = columns[SFR_Z_BULGE_DISKINS];
+
+	auto start = std::max(from_snapshot, first) - first;
+	auto end = std::min(to_snapshot, last_snapshot()) - first;
+	for (int i = start; i <= end; i++) {
+
+		//transfer disk information to bulge.
+		sfr_bulge_mergers[i]   += sfr_disk[i] + sfr_bulge_diskins[i];
+		sfr_z_bulge_mergers[i] += sfr_z_disk[i] + sfr_z_bulge_diskins[i];
+
+		//make disk properties = 0;
+		sfr_disk[i] = 0;
+		sfr_z_disk[i] = 0;
+
+		//make bulge formed via disk instabilities properties =0.
+		sfr_bulge_diskins[i] = 0;
+		sfr_z_bulge_diskins[i] = 0;
+	}
+}
+
+void GalaxyHistory::transfer_satellite_to_bulge_mergers(GalaxyHistory &satellite, int from_snapshot, int to_snapshot)
+{
+	// The events of a streamed satellite have to be replayed before this
+	// transfer, and from now on this history depends on streamed items too
+	if (satellite.is_streamed) {
+		is_streamed = true;
+		auto satellite_events = satellite.take_events();
+		events.insert(events.end(), satellite_events.begin(), satellite_events.end());
+	}
+	if (is_streamed) {
+		events.push_back({HistoryEvent::SATELLITE_TO_BULGE_MERGERS, from_snapshot, to_snapshot, galaxy_id, satellite.galaxy_id});
+	}
+
+	int start = std::max(from_snapshot, satellite.first_snapshot());
+	int end = std::min(to_snapshot, satellite.last_snapshot());
+	for (int s = start; s <= end; s++) {
+
+		/**There will be four cases:
+			1) that both galaxies existed at snapshot s. In this case transfer history at this snapshot to central.
+			2) that the satellite didn't exist but the central did. In this case do nothing.
+			3) that the central didn't exist but the satellite did. In this create a new entry for the history of the central with the data of the satellite.
+			4) none of the galaxies existed. In this case do nothing.
+		**/
+		if (!satellite.exists(s)) {
+			//no-opt.
+			continue;
+		}
+
+		auto item_sat = satellite.get(s);
+		if (!exists(s)) {
+
+			//transfer all data to the bulge formed via mergers, which is where all of this mass ends up being at.
+			HistoryItem item {};
+			item.sfr_bulge_mergers   = item_sat.sfr_bulge_mergers + (item_sat.sfr_disk + item_sat.sfr_bulge_diskins);
+			item.sfr_z_bulge_mergers = item_sat.sfr_z_bulge_mergers + (item_sat.sfr_z_disk + item_sat.sfr_z_bulge_diskins);
+			item.snapshot = s;
+			add(item);
+		}
+		else {
+			value(SFR_BULGE_MERGERS, s)   += item_sat.sfr_bulge_mergers + item_sat.sfr_bulge_diskins + item_sat.sfr_disk;
+			value(SFR_Z_BULGE_MERGERS, s) += item_sat.sfr_z_bulge_mergers + item_sat.sfr_z_bulge_diskins + item_sat.sfr_z_disk;
+		}
+	}
+}
+
+std::vector<HistoryEvent> GalaxyHistory::take_events()
+{
+	std::vector<HistoryEvent> taken;
+	std::swap(taken, events);
+	return taken;
+}
+
+}  // namespace shark
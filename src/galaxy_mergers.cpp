@@ -21,8 +21,11 @@
  * @file
  */
 
+#include <algorithm>
 #include <cmath>
 #include <random>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <gsl/gsl_errno.h>
@@ -33,7 +36,9 @@
 #include "components.h"
 #include "galaxy_mergers.h"
 #include "numerical_constants.h"
+#include "philox_engine.h"
 #include "physical_model.h"
+#include "profiling.h"
 
 namespace shark {
 
@@ -65,7 +70,7 @@ GalaxyMergers::GalaxyMergers(GalaxyMergerParameters parameters,
 	darkmatterhalo(darkmatterhalo),
 	physicalmodel(physicalmodel),
 	agnfeedback(agnfeedback),
-	generator(execparams.seed),
+	seed(execparams.seed),
 	distribution(-0.14, 0.26)
 {
 	// no-op
@@ -84,7 +89,7 @@ void GalaxyMergers::orbital_parameters(double &vr, double &vt, double f){
 	vt = distribution(generator);
 }
 
-double GalaxyMergers::merging_timescale_orbital(){
+double GalaxyMergers::merging_timescale_orbital(Galaxy::id_t random_key, int snapshot){
 
 	/**
 	 * Uses function calculated in Lacey & Cole (1993), who found that it was best described by a log
@@ -93,7 +98,9 @@ double GalaxyMergers::merging_timescale_orbital(){
 
 	//TODO: add other dynamical friction timescales.
 
-	return distribution(generator);
+	philox_engine engine(seed, philox_engine::MERGING_TIMESCALE, random_key, snapshot);
+	std::lognormal_distribution<double> orbital_distribution(distribution.param());
+	return orbital_distribution(engine);
 
 }
 
@@ -123,19 +130,29 @@ double GalaxyMergers::merging_timescale_mass(double mp, double ms){
 
 void GalaxyMergers::merging_timescale(SubhaloPtr &primary, SubhaloPtr &secondary, double z, bool transfer_types2)
 {
-	auto satellites = secondary->galaxies;
+	std::vector<GalaxyPtr> satellites;
 	if(transfer_types2){
 		satellites = secondary->all_type2_galaxies();
 	}
+	else {
+		satellites.assign(secondary->galaxies.begin(), secondary->galaxies.end());
+	}
 
 	auto halo = primary->host_halo;
 
 	double tau_dyn = darkmatterhalo->halo_dynamical_time(halo, z);
 
+	// Merging timescales of type 2 galaxies are first checked against the
+	// next snapshot. Other galaxies keep their timescale until they become
+	// type 2 (see adjust_main_galaxy), and only then does it start elapsing
+	double age = cosmology->convert_redshift_to_age(simparams.redshifts[secondary->snapshot + 1]);
+
 	double mp = primary->Mvir + primary->central_galaxy()->baryon_mass();
 
 	for (auto &galaxy: satellites){
 
+		double start_age = (galaxy->galaxy_type == Galaxy::TYPE2) ? age : 0;
+
 		// Define merging timescale and redefine type of galaxy.
 		if(parameters.tau_delay > 0){
 			double mgal = galaxy->baryon_mass();
@@ -144,12 +161,12 @@ void GalaxyMergers::merging_timescale(SubhaloPtr &primary, SubhaloPtr &secondary
 				ms = galaxy->msubhalo_type2 + mgal;
 			}
 			double tau_mass = merging_timescale_mass(mp, ms);
-			double tau_orbits = merging_timescale_orbital();
+			double tau_orbits = merging_timescale_orbital(galaxy->random_key, secondary->snapshot);
 
-			galaxy->tmerge = parameters.tau_delay * tau_mass * tau_orbits* tau_dyn;
+			galaxy->merger_age = start_age + parameters.tau_delay * tau_mass * tau_orbits* tau_dyn;
 		}
 		else{
-			galaxy->tmerge = parameters.tau_delay;
+			galaxy->merger_age = start_age + parameters.tau_delay;
 		}
 
 		//Only define the following parameters if the galaxies were not type=2.
@@ -163,8 +180,10 @@ void GalaxyMergers::merging_timescale(SubhaloPtr &primary, SubhaloPtr &secondary
 
 }
 
-void GalaxyMergers::merging_subhalos(HaloPtr &halo, double z)
+void GalaxyMergers::merging_subhalos(const HaloPtr &halo, double z)
 {
+	SHARK_PROFILE(SUBHALO_MERGERS);
+
 	auto central_subhalo = halo->central_subhalo;
 
 	if (!central_subhalo) {
@@ -190,14 +209,15 @@ void GalaxyMergers::merging_subhalos(HaloPtr &halo, double z)
 				           << " because this is its last snapshot";
 			}
 
-			//Calculate dynamical friction timescale for all galaxies in satellite_subhalo.
-			merging_timescale(central_subhalo, satellite_subhalo, z, false);
-
 			// Change type of galaxies to type=2 before transferring them to the central_subhalo.
 			for (auto &galaxy: satellite_subhalo->galaxies){
 				galaxy->galaxy_type = Galaxy::TYPE2;
 			}
 
+			//Calculate dynamical friction timescale for all galaxies in satellite_subhalo, which are all type=2 now.
+			merging_timescale(central_subhalo, satellite_subhalo, z, false);
+			satellite_subhalo->rebuild_merger_queue();
+
 			//transfer all mass from the satellite_subhalo to the central_subhalo. Note that this implies a horizontal transfer of information.
 			transfer_baryon_mass(central_subhalo, satellite_subhalo);
 
@@ -209,6 +229,7 @@ void GalaxyMergers::merging_subhalos(HaloPtr &halo, double z)
 			//recalculating its merging timescale.
 
 			merging_timescale(central_subhalo, satellite_subhalo, z, true);
+			satellite_subhalo->rebuild_merger_queue();
 			//Now transfer the galaxies in this subhalo to the central subhalo. Note that this implies a horizontal transfer of information.
 			satellite_subhalo->transfer_type2galaxies_to(central_subhalo);
 		}
@@ -242,16 +263,17 @@ void GalaxyMergers::merging_subhalos(HaloPtr &halo, double z)
 			os << "Primary subhalo " << primary_subhalo << " (last_snapshot=";
 			os << primary_subhalo->last_snapshot_identified << ") does not have central galaxy - in merging_subhalos. ";
 			os << " Ascendants are: ";
-			auto ascendants = primary_subhalo->ascendants;
+			const auto &ascendants = primary_subhalo->ascendants;
 			std::copy(ascendants.begin(), ascendants.end(), std::ostream_iterator<SubhaloPtr>(os, " "));
 			os << ". Galaxies are: ";
-			auto galaxies = primary_subhalo->galaxies;
+			const auto &galaxies = primary_subhalo->galaxies;
 			std::copy(galaxies.begin(), galaxies.end(), std::ostream_iterator<GalaxyPtr>(os, " "));
 			throw invalid_argument(os.str());
 		}
 
 		//Calculate dynamical friction timescale for all galaxies disappearing in the primary subhalo of the merger in the next snapshot.
 		merging_timescale(primary_subhalo, central_subhalo, z, false);
+		central_subhalo->rebuild_merger_queue();
 
 	}
 
@@ -259,8 +281,10 @@ void GalaxyMergers::merging_subhalos(HaloPtr &halo, double z)
 
 void GalaxyMergers::merging_galaxies(HaloPtr &halo, int snapshot, double delta_t){
 
+	SHARK_PROFILE(GALAXY_MERGERS);
+
 	/**
-	 * This function determines which galaxies are merging in this snapshot by comparing tmerge with the duration of the snapshot.
+	 * This function determines which galaxies are merging in this snapshot by comparing their merger_age with the age at the end of the snapshot.
 	 * Inputs:
 	 * halo: halo in which the two galaxies merging live.
 	 * z: current redshift.
@@ -292,35 +316,22 @@ void GalaxyMergers::merging_galaxies(HaloPtr &halo, int snapshot, double delta_t
 		throw exception(os.str());
 	}
 
-	std::vector<GalaxyPtr> all_sats_to_delete;
-
-	for (auto &galaxy: central_subhalo->galaxies){
-		if(galaxy->galaxy_type == Galaxy::TYPE2){
-			/**
-			 * If merging timescale is less than the duration of this snapshot, then proceed to merge. Otherwise, update merging timescale.
-			 */
-			if(galaxy->tmerge < delta_t){
-				create_merger(central_galaxy, galaxy, halo, snapshot);
-				// Accumulate all satellites that we need to delete at the end.
-				all_sats_to_delete.push_back(galaxy);
-			}
-			else{
-				//check if this galaxy will merge on the next snapshot instead, and if so, redefine their descendant_id.
-				if(snapshot+2 < simparams.max_snapshot){
-					double z1 = simparams.redshifts[snapshot];
-					double z2 = simparams.redshifts[snapshot+2];
-					double delta_t_twosnaps = cosmology->convert_redshift_to_age(z2) - cosmology->convert_redshift_to_age(z1);
-					if(galaxy->tmerge < delta_t_twosnaps){
-						galaxy->descendant_id = central_galaxy->id;
-					}
-				}
-				galaxy->tmerge = galaxy->tmerge - delta_t;
-			}
-		}
+	/**
+	 * Type 2 galaxies are queued by their merger_age, so only those merging during this snapshot,
+	 * or during the next one, are visited. Merging galaxies are removed from the subhalo.
+	 */
+	double age = cosmology->convert_redshift_to_age(z);
+	for (auto &galaxy: central_subhalo->remove_mergers(age + delta_t)){
+		create_merger(central_galaxy, galaxy, halo, snapshot);
 	}
 
-	// Now destroy and remove satellite galaxy.
-	central_subhalo->remove_galaxies(all_sats_to_delete);
+	//check which galaxies will merge on the next snapshot instead, and if so, redefine their descendant_id.
+	if(snapshot+2 < simparams.max_snapshot){
+		double age_twosnaps = cosmology->convert_redshift_to_age(simparams.redshifts[snapshot+2]);
+		central_subhalo->for_each_merger_before(age_twosnaps, [&central_galaxy](const GalaxyPtr &galaxy) {
+			galaxy->descendant_id = central_galaxy->id;
+		});
+	}
 
 	//calculate specific angular momentum of bulge and disk.
 	//darkmatterhalo->disk_sAM(*central_subhalo , *central_galaxy);
@@ -497,7 +508,7 @@ void GalaxyMergers::create_merger(GalaxyPtr &central, GalaxyPtr &satellite, Halo
 
 void GalaxyMergers::create_starbursts(HaloPtr &halo, double z, double delta_t){
 
-	for (auto &subhalo: halo->all_subhalos()){
+	for (auto &subhalo: halo->subhalos()){
 		for (auto &galaxy: subhalo->galaxies){
 			// Trigger starburst only in case there is gas in the bulge.
 			if(galaxy->bulge_gas.mass > parameters.mass_min){
@@ -694,7 +705,7 @@ void GalaxyMergers::transfer_baryon_mass(SubhaloPtr central, SubhaloPtr satellit
 
 }
 
-void GalaxyMergers::transfer_bulge_gas(SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z){
+void GalaxyMergers::transfer_bulge_gas(const SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z){
 
 	galaxy->disk_gas += galaxy->bulge_gas;
 
@@ -718,54 +729,7 @@ void GalaxyMergers::transfer_history_satellite_to_bulge(GalaxyPtr &central, Gala
 	 */
 
 	//Transfer history of stellar mass growth until the previous snapshot.
-	for(int s=simparams.min_snapshot; s <= snapshot-1; s++) {
-
-		auto it_sat = std::find_if(satellite->history.begin(), satellite->history.end(), [s](const HistoryItem &hitem) {
-			return hitem.snapshot == s;
-		});
-
-		auto it_cen = std::find_if(central->history.begin(), central->history.end(), [s](const HistoryItem &hitem) {
-			return hitem.snapshot == s;
-		});
-
-		/**There will be four cases:
-			1) that both galaxies existed at snapshot s. In this case transfer history at this snapshot to central.
-			2) that the satellite didn't exist but the central did. In this case do nothing.
-			3) that the central didn't exist but the satellite did. In this create a new entry for the history of the central with the data of the satellite.
-			4) none of the galaxies existed. In this case do nothing.
-		**/
-		if (it_sat == satellite->history.end() && it_cen == central->history.end()){ //neither satellite or central existed.
-			//no-opt.
-		}
-		else if (it_sat == satellite->history.end() && it_cen != central->history.end()){ // satellite didn't exist but central did.
-			//no-opt.
-		}
-		else if (it_sat != satellite->history.end() && it_cen == central->history.end()){ // central didn't exist but satellite did.
-			auto hist_item = *it_sat;
-
-			//transfer all data to the bulge formed via mergers, which is where all of this mass ends up being at.
-			hist_item.sfr_bulge_mergers   += hist_item.sfr_disk + hist_item.sfr_bulge_diskins;
-			hist_item.sfr_z_bulge_mergers += hist_item.sfr_z_disk + hist_item.sfr_z_bulge_diskins;
-
-			//Make disk properties = 0.
-			hist_item.sfr_disk   = 0;
-			hist_item.sfr_z_disk = 0;
-
-			//Make bulge properties formed via disk instabilities = 0.
-			hist_item.sfr_bulge_diskins = 0;
-			hist_item.sfr_z_bulge_diskins = 0;
-
-			central->history.push_back(hist_item);
-		}
-		else { // both galaxies exist at this snapshot
-			auto hist_sat = *it_sat;
-			auto &hist_cen = *it_cen;
-
-			hist_cen.sfr_bulge_mergers   += hist_sat.sfr_bulge_mergers + hist_sat.sfr_bulge_diskins + hist_sat.sfr_disk;
-			hist_cen.sfr_z_bulge_mergers += hist_sat.sfr_z_bulge_mergers + hist_sat.sfr_z_bulge_diskins + hist_sat.sfr_z_disk;
-
-		}
-	}
+	central->history.transfer_satellite_to_bulge_mergers(satellite->history, simparams.min_snapshot, snapshot - 1);
 
 }
 
@@ -776,32 +740,7 @@ void GalaxyMergers::transfer_history_disk_to_bulge(GalaxyPtr &central, int snaps
 	 */
 
 	//Transfer history of stellar mass growth until the previous snapshot.
-	for(int s=simparams.min_snapshot; s <= snapshot-1; s++) {
-
-		auto it_cen = std::find_if(central->history.begin(), central->history.end(), [s](const HistoryItem &hitem) {
-			return hitem.snapshot == s;
-		});
-
-		if (it_cen == central->history.end()){ //central didn't exist.
-			//no-opt.
-		}
-		else { // both galaxies exist at this snapshot
-			auto &hist_cen = *it_cen;
-
-			//transfer disk information to bulge.
-			hist_cen.sfr_bulge_mergers   += hist_cen.sfr_disk + hist_cen.sfr_bulge_diskins;
-			hist_cen.sfr_z_bulge_mergers += hist_cen.sfr_z_disk + hist_cen.sfr_z_bulge_diskins;
-
-			//make disk properties = 0;
-			hist_cen.sfr_disk = 0;
-			hist_cen.sfr_z_disk = 0;
-
-			//make bulge formed via disk instabilities properties =0.
-			hist_cen.sfr_bulge_diskins = 0;
-			hist_cen.sfr_z_bulge_diskins = 0;
-		}
-	}
-
+	central->history.transfer_disk_to_bulge_mergers(simparams.min_snapshot, snapshot - 1);
 
 }
 
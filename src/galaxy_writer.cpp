@@ -23,7 +23,10 @@
  * Galaxy writer classes implementations
  */
 
+#include <algorithm>
+#include <cstdio>
 #include <ctime>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
@@ -32,28 +35,76 @@
 
 #include <boost/filesystem.hpp>
 
+#include "hdf5/collective_writer.h"
+#include "hdf5/deferred_writer.h"
 #include "hdf5/writer.h"
 #include "components.h"
 #include "config.h"
+#include "columnar_writer.h"
 #include "cosmology.h"
 #include "exceptions.h"
 #include "galaxy_writer.h"
 #include "git_revision.h"
+#include "huge_pages.h"
 #include "logging.h"
+#include "mpi_utils.h"
+#include "omp_utils.h"
 #include "star_formation.h"
+#include "summary_statistics.h"
 #include "timer.h"
 #include "utils.h"
 
 
 namespace shark {
 
-GalaxyWriter::GalaxyWriter(ExecutionParameters exec_params, CosmologicalParameters cosmo_params,  const CosmologyPtr &cosmology, const DarkMatterHalosPtr &darkmatterhalo, SimulationParameters sim_params):
+GalaxyWriter::GalaxyWriter(ExecutionParameters exec_params, CosmologicalParameters cosmo_params,  const CosmologyPtr &cosmology, const DarkMatterHalosPtr &darkmatterhalo, SimulationParameters sim_params, unsigned int threads):
 	exec_params(exec_params),
 	cosmo_params(cosmo_params),
 	cosmology(cosmology),
 	darkmatterhalo(darkmatterhalo),
-	sim_params(sim_params){
-	//no-opt
+	sim_params(sim_params),
+	threads(threads),
+	io_worker(){
+	if (exec_params.shared_output && !hdf5::CollectiveWriter::supported()) {
+		throw invalid_option("execution.shared_output requires shark to be compiled with MPI support against a parallel HDF5 library");
+	}
+	if (exec_params.output_snapshots_in_flight > 0) {
+		io_worker.reset(new BackgroundWorker(exec_params.output_snapshots_in_flight));
+	}
+}
+
+bool GalaxyWriter::asynchronous() const
+{
+	return bool(io_worker);
+}
+
+void GalaxyWriter::submit(BackgroundWorker::job_t &&job)
+{
+	if (io_worker) {
+		io_worker->submit(std::move(job));
+	}
+	else {
+		job();
+	}
+}
+
+void GalaxyWriter::finish()
+{
+	if (io_worker) {
+		Timer t;
+		io_worker->wait();
+		LOG(info) << "Waited " << t << " for pending outputs to be written";
+	}
+}
+
+void GalaxyWriter::write_summary(int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal)
+{
+	Timer t;
+	auto &bins = exec_params.summary_mass_bins;
+	auto stats = SummaryStatistics::collect(halos, molgas_per_gal, bins[0], bins[1], bins[2], threads);
+	hdf5::Writer file(get_output_directory(snapshot) + "/summary.hdf5");
+	stats.write(file, sim_params.redshifts[snapshot], sim_params.volume * exec_params.simulation_batches.size());
+	LOG(info) << "Summary statistics for snapshot " << snapshot << " written in " << t;
 }
 
 std::string GalaxyWriter::get_output_directory(int snapshot)
@@ -61,14 +112,29 @@ std::string GalaxyWriter::get_output_directory(int snapshot)
 	using namespace boost::filesystem;
 	using std::string;
 
-	string batch_dir = "multiple_batches";
+	string batch_dir = "multiple_batches" + exec_params.batch_directory_suffix;
 	if (exec_params.simulation_batches.size() == 1) {
 		batch_dir = std::to_string(exec_params.simulation_batches[0]);
 	}
 
+	string output_dir = get_snapshot_directory(snapshot) + "/" + batch_dir;
+
+	// Make sure the batch directory exists too
+	path dirname(output_dir);
+	if (!exists(dirname)) {
+		create_directories(dirname);
+	}
+
+	return output_dir;
+}
+
+std::string GalaxyWriter::get_snapshot_directory(int snapshot)
+{
+	using namespace boost::filesystem;
+	using std::string;
+
 	string output_dir = exec_params.output_directory + "/" + sim_params.sim_name +
-	                    "/" + exec_params.name_model + "/" + std::to_string(snapshot) +
-	                    "/" + batch_dir;
+	                    "/" + exec_params.name_model + "/" + std::to_string(snapshot);
 
 	// Make sure the directory structure exists
 	path dirname(output_dir);
@@ -81,14 +147,105 @@ std::string GalaxyWriter::get_output_directory(int snapshot)
 
 void HDF5GalaxyWriter::write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal)
 {
-	hdf5::Writer file(get_output_directory(snapshot) + "/galaxies.hdf5");
-	write_header(file, snapshot);
+	// Shared files are written collectively, which only the main thread does
+	if (exec_params.shared_output) {
+		write_shared(snapshot, halos, AllBaryons, molgas_per_gal);
+		write_streamed_histories(snapshot, halos);
+		return;
+	}
+
+	if (!asynchronous()) {
+		write_files<hdf5::Writer>(snapshot, halos, AllBaryons, molgas_per_gal);
+		write_streamed_histories(snapshot, halos);
+		return;
+	}
+
+	// Values are collected now, while the galaxies are still in this state,
+	// but written to disk only by the background worker
+	auto files = write_files<hdf5::DeferredWriter>(snapshot, halos, AllBaryons, molgas_per_gal);
+	submit([files, snapshot]() {
+		Timer t;
+		for (auto &file: files) {
+			file->flush();
+		}
+		LOG(info) << "Output files for snapshot " << snapshot << " written in the background in " << t;
+	});
+	write_streamed_histories(snapshot, halos);
+}
+
+template <typename FileWriter>
+std::vector<std::shared_ptr<FileWriter>> HDF5GalaxyWriter::write_files(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal)
+{
+	auto file = std::make_shared<FileWriter>(get_output_directory(snapshot) + "/galaxies.hdf5");
+	file->set_storage(output_storage());
+	write_header(*file, snapshot, exec_params.simulation_batches.size());
+	write_galaxies(*file, snapshot, halos, molgas_per_gal);
+	write_global_properties(*file, snapshot, AllBaryons);
+
+	std::vector<std::shared_ptr<FileWriter>> files {file};
+	auto file_sfh = write_histories<FileWriter>(snapshot, halos);
+	if (file_sfh) {
+		files.emplace_back(std::move(file_sfh));
+	}
+	return files;
+}
+
+void HDF5GalaxyWriter::write_shared(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal)
+{
+	Timer t;
+
+	// The shared file describes the whole volume handled by all processes
+	TotalBaryon global_baryons = AllBaryons;
+	mpi::sum_all(global_baryons);
+	std::vector<unsigned int> n_batches {static_cast<unsigned int>(exec_params.simulation_batches.size())};
+	auto total_batches = mpi::sum_all(std::size_t(n_batches[0]));
+
+	std::vector<std::int64_t> n_subhalos {0};
+	std::vector<std::int64_t> n_galaxies {0};
+	for (auto &halo: halos) {
+		n_subhalos[0] += halo->subhalos().size();
+		n_galaxies[0] += halo->galaxy_count();
+	}
+
+	// Per-subhalo and per-galaxy values of all processes are concatenated,
+	// everything else is the same for all processes
+	hdf5::CollectiveWriter file(get_snapshot_directory(snapshot) + "/galaxies.hdf5",
+	                            {"galaxies", "subhalo", "run_info/batches", "batch_index"});
+	file.set_storage(output_storage());
+	write_header(file, snapshot, total_batches);
 	write_galaxies(file, snapshot, halos, molgas_per_gal);
+	write_global_properties(file, snapshot, global_baryons);
+
+	// One entry per process, so the values of each group of batches can still be found
+	std::string comment;
+	std::vector<std::int64_t> first_subhalo {std::int64_t(file.global_offset(n_subhalos[0]))};
+	std::vector<std::int64_t> first_galaxy {std::int64_t(file.global_offset(n_galaxies[0]))};
+	comment = "batches handled by each process, in the same order as the entries of this group";
+	file.write_dataset("batch_index/batches", exec_params.simulation_batches, comment);
+	comment = "number of values of batch_index/batches handled by each process";
+	file.write_dataset("batch_index/n_batches", n_batches, comment);
+	comment = "index of the first subhalo/ value written by each process";
+	file.write_dataset("batch_index/first_subhalo", first_subhalo, comment);
+	comment = "number of subhalo/ values written by each process";
+	file.write_dataset("batch_index/n_subhalos", n_subhalos, comment);
+	comment = "index of the first galaxies/ value written by each process";
+	file.write_dataset("batch_index/first_galaxy", first_galaxy, comment);
+	comment = "number of galaxies/ values written by each process";
+	file.write_dataset("batch_index/n_galaxies", n_galaxies, comment);
+	LOG(info) << "Shared output file for snapshot " << snapshot << " written in " << t;
+
+	// Star formation histories are still written by each process separately
+	write_histories<hdf5::Writer>(snapshot, halos);
+}
+
+void HDF5GalaxyWriter::write_global(int snapshot, TotalBaryon &AllBaryons)
+{
+	hdf5::Writer file(get_snapshot_directory(snapshot) + "/global.hdf5");
 	write_global_properties(file, snapshot, AllBaryons);
-	write_histories(snapshot, halos);
 }
 
-void HDF5GalaxyWriter::write_header(hdf5::Writer &file, int snapshot){
+template <typename FileWriter>
+void HDF5GalaxyWriter::write_header(FileWriter &file, int snapshot, std::size_t n_batches){
 
 	std::string comment;
 
@@ -125,7 +282,7 @@ void HDF5GalaxyWriter::write_header(hdf5::Writer &file, int snapshot){
 	file.write_dataset("run_info/seed", exec_params.seed, comment);
 
 	// Calculate effective volume of the run
-	float volume = sim_params.volume * exec_params.simulation_batches.size();
+	float volume = sim_params.volume * n_batches;
 
 	comment = "effective volume of this run [cMpc/h]";
 	file.write_dataset("run_info/effective_volume", volume, comment);
@@ -168,7 +325,40 @@ std::size_t report_vsize(const std::vector<T> &v, std::ostringstream &os, const
 	return amount;
 };
 
-void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal){
+template <typename T>
+static
+void resize_selected(const ExecutionParameters &exec_params, std::size_t size, std::initializer_list<std::pair<const char *, std::vector<T> *>> columns)
+{
+	for (auto &column: columns) {
+		if (exec_params.output_property(column.first)) {
+			// Pages are only given to the column when first written
+			column.second->reserve(size);
+			huge_pages::advise(column.second->data(), size * sizeof(T));
+			column.second->resize(size);
+		}
+	}
+}
+
+template <typename T, typename V>
+static inline
+void set_value(std::vector<T> &column, std::size_t i, V value)
+{
+	// columns of properties that are not written are left empty
+	if (!column.empty()) {
+		column[i] = value;
+	}
+}
+
+template <typename FileWriter, typename T>
+void HDF5GalaxyWriter::write_property(FileWriter &file, const std::string &name, const std::vector<T> &values, const std::string &comment)
+{
+	if (exec_params.output_property(name)) {
+		file.write_dataset(name, values, comment);
+	}
+}
+
+template <typename FileWriter>
+void HDF5GalaxyWriter::write_galaxies(FileWriter &file, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal){
 
 	Timer t;
 
@@ -260,15 +450,116 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 	vector<float> L_y;
 	vector<float> L_z;
 
+	vector<float> weight;
+
 	vector<int> type;
 	vector<Halo::id_t> id_halo;
 	vector<Halo::id_t> id_halo_tree;
 	vector<Subhalo::id_t> id_subhalo;
 	vector<Subhalo::id_t> id_subhalo_tree;
 
-	Halo::id_t j = 1;
+	// Count the subhalos and galaxies of each halo first, so each halo's
+	// values can be written straight into their place in the columns below
+	auto n_halos = halos.size();
+	vector<std::size_t> subhalo_offsets(n_halos + 1, 0);
+	vector<std::size_t> galaxy_offsets(n_halos + 1, 0);
+	omp_static_for(std::size_t(0), n_halos, threads, [&](std::size_t h, int thread_idx) {
+		subhalo_offsets[h + 1] = halos[h]->subhalos().size();
+		galaxy_offsets[h + 1] = halos[h]->galaxy_count();
+	});
+	auto n_subhalos = omp_prefix_sum(subhalo_offsets, threads);
+	auto n_galaxies = omp_prefix_sum(galaxy_offsets, threads);
+	resize_selected<Subhalo::id_t>(exec_params, n_subhalos, {{"subhalo/id", &id}, {"subhalo/descendant_id", &descendant_id}});
+	resize_selected<Halo::id_t>(exec_params, n_subhalos, {{"subhalo/host_id", &host_id}});
+	resize_selected<int>(exec_params, n_subhalos, {{"subhalo/main_progenitor", &main}});
+	resize_selected<int>(exec_params, n_galaxies, {{"galaxies/type", &type}});
+	resize_selected<Halo::id_t>(exec_params, n_galaxies, {{"galaxies/id_halo", &id_halo}, {"galaxies/id_halo_tree", &id_halo_tree}});
+	resize_selected<Subhalo::id_t>(exec_params, n_galaxies, {{"galaxies/id_subhalo", &id_subhalo}, {"galaxies/id_subhalo_tree", &id_subhalo_tree}});
+	resize_selected<Galaxy::id_t>(exec_params, n_galaxies, {{"galaxies/id_galaxy", &id_galaxy}, {"galaxies/descendant_id_galaxy", &descendant_id_galaxy}});
+	resize_selected<float>(exec_params, n_galaxies, {
+		{"galaxies/mstars_disk", &mstars_disk}, {"galaxies/mstars_bulge", &mstars_bulge},
+		{"galaxies/mstars_burst_mergers", &mstars_burst_mergers},
+		{"galaxies/mstars_burst_diskinstabilities", &mstars_burst_diskinstabilities},
+		{"galaxies/mstars_bulge_mergers_assembly", &mstars_bulge_mergers_assembly},
+		{"galaxies/mstars_bulge_diskins_assembly", &mstars_bulge_diskins_assembly},
+		{"galaxies/mgas_disk", &mgas_disk}, {"galaxies/mgas_bulge", &mgas_bulge},
+		{"galaxies/mstars_metals_disk", &mstars_metals_disk},
+		{"galaxies/mstars_metals_bulge", &mstars_metals_bulge},
+		{"galaxies/mstars_metals_burst_mergers", &mstars_metals_burst_mergers},
+		{"galaxies/mstars_metals_burst_diskinstabilities", &mstars_metals_burst_diskinstabilities},
+		{"galaxies/mstars_metals_bulge_mergers_assembly", &mstars_metals_bulge_mergers_assembly},
+		{"galaxies/mstars_metals_bulge_diskins_assembly", &mstars_metals_bulge_diskins_assembly},
+		{"galaxies/mgas_metals_disk", &mgas_metals_disk}, {"galaxies/mgas_metals_bulge", &mgas_metals_bulge},
+		{"galaxies/mmol_disk", &mmol_disk}, {"galaxies/mmol_bulge", &mmol_bulge},
+		{"galaxies/matom_disk", &matom_disk}, {"galaxies/matom_bulge", &matom_bulge},
+		{"galaxies/m_bh", &mBH}, {"galaxies/bh_accretion_rate_hh", &mBH_acc_hh},
+		{"galaxies/bh_accretion_rate_sb", &mBH_acc_sb}, {"galaxies/sfr_disk", &sfr_disk},
+		{"galaxies/sfr_burst", &sfr_burst}, {"galaxies/mean_stellar_age", &mean_stellar_age},
+		{"galaxies/rgas_disk", &rdisk_gas}, {"galaxies/rgas_bulge", &rbulge_gas},
+		{"galaxies/specific_angular_momentum_disk_gas", &sAM_disk_gas},
+		{"galaxies/specific_angular_momentum_disk_gas_atom", &sAM_disk_gas_atom},
+		{"galaxies/specific_angular_momentum_disk_gas_mol", &sAM_disk_gas_mol},
+		{"galaxies/specific_angular_momentum_bulge_gas", &sAM_bulge_gas},
+		{"galaxies/rstar_disk", &rdisk_star}, {"galaxies/rstar_bulge", &rbulge_star},
+		{"galaxies/specific_angular_momentum_disk_star", &sAM_disk_star},
+		{"galaxies/specific_angular_momentum_bulge_star", &sAM_bulge_star},
+		{"galaxies/redshift_merger", &redshift_of_merger}, {"galaxies/mhot", &mhot},
+		{"galaxies/mhot_metals", &mhot_metals}, {"galaxies/mreheated", &mreheated},
+		{"galaxies/mreheated_metals", &mreheated_metals}, {"galaxies/cooling_rate", &cooling_rate},
+		{"galaxies/mvir_hosthalo", &mvir_hosthalo}, {"galaxies/mvir_subhalo", &mvir_subhalo},
+		{"galaxies/vmax_subhalo", &vmax_subhalo}, {"galaxies/vvir_hosthalo", &vvir_hosthalo},
+		{"galaxies/vvir_subhalo", &vvir_subhalo}, {"galaxies/cnfw_subhalo", &cnfw_subhalo},
+		{"galaxies/lambda_subhalo", &lambda_subhalo},
+		{"galaxies/position_x", &position_x}, {"galaxies/position_y", &position_y},
+		{"galaxies/position_z", &position_z}, {"galaxies/velocity_x", &velocity_x},
+		{"galaxies/velocity_y", &velocity_y}, {"galaxies/velocity_z", &velocity_z},
+		{"galaxies/l_x", &L_x}, {"galaxies/l_y", &L_y}, {"galaxies/l_z", &L_z},
+		{"galaxies/weight", &weight}});
+
+	// Random orbits of type 2 galaxies and angular momenta are only
+	// calculated if needed by one of the selected columns
+	bool need_orbits = !position_x.empty() || !position_y.empty() || !position_z.empty() ||
+	                   !velocity_x.empty() || !velocity_y.empty() || !velocity_z.empty() ||
+	                   !L_x.empty() || !L_y.empty() || !L_z.empty();
+	bool need_L = !L_x.empty() || !L_y.empty() || !L_z.empty();
+
+	// The random orbits of the type 2 galaxies of each halo are drawn in a
+	// single batch, using these per-thread buffers
+	struct type2_orbits {
+		std::vector<Galaxy::id_t> random_keys;
+		std::vector<double> angular_momenta;
+		std::vector<xyz<float>> pos, vel, L;
+	};
+	std::vector<type2_orbits> orbits_per_thread(std::max(int(threads), 1));
+
 	// Loop over all halos and subhalos to write galaxy properties
-	for (auto &halo: halos){
+	omp_dynamic_for(std::size_t(0), n_halos, threads, 100, [&](std::size_t h, int thread_idx) {
+
+		auto &halo = halos[h];
+		Halo::id_t j = h + 1;
+		auto s = subhalo_offsets[h];
+		auto g = galaxy_offsets[h];
+
+		auto &orbits = orbits_per_thread[thread_idx];
+		orbits.random_keys.clear();
+		orbits.angular_momenta.clear();
+		if (need_orbits) {
+			for (auto &subhalo: halo->subhalos()) {
+				for (const auto &galaxy: subhalo->galaxies) {
+					if (galaxy->galaxy_type != Galaxy::CENTRAL && galaxy->galaxy_type != Galaxy::TYPE1) {
+						orbits.random_keys.push_back(galaxy->random_key);
+						orbits.angular_momenta.push_back(galaxy->angular_momentum());
+					}
+				}
+			}
+			auto n_type2 = orbits.random_keys.size();
+			orbits.pos.resize(n_type2);
+			orbits.vel.resize(n_type2);
+			orbits.L.resize(n_type2);
+			darkmatterhalo->generate_random_orbits(orbits.pos.data(), orbits.vel.data(), orbits.L.data(),
+			                                       orbits.angular_momenta.data(), halo, orbits.random_keys.data(), n_type2);
+		}
+		std::size_t next_orbit = 0;
 
 		// assign properties of host halo
 		auto mhalo = halo->Mvir;
@@ -276,9 +567,9 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 
 		Subhalo::id_t i = 1;
 
-		for (auto &subhalo: halo->all_subhalos()){
+		for (auto &subhalo: halo->subhalos()){
 
-			host_id.push_back(halo->id);
+			set_value(host_id, s, halo->id);
 
 			// assign properties of host subhalo
 			auto msubhalo = subhalo->Mvir;
@@ -291,75 +582,76 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 			auto cold_subhalo = subhalo->cold_halo_gas;
 			auto reheated_subhalo = subhalo->ejected_galaxy_gas;
 
-			descendant_id.push_back(subhalo->descendant_id);
+			set_value(descendant_id, s, subhalo->descendant_id);
 			int m = 0;
 			if(subhalo->main_progenitor){
 				m = 1;
 			}
-			main.push_back(m);
-			id.push_back(subhalo->id);
+			set_value(main, s, m);
+			set_value(id, s, subhalo->id);
 
 			for (const auto &galaxy: subhalo->galaxies){
 
-				id_halo_tree.push_back(halo->id);
-				id_subhalo_tree.push_back(subhalo->id);
+				set_value(id_halo_tree, g, halo->id);
+				set_value(id_subhalo_tree, g, subhalo->id);
+				set_value(weight, g, halo->merger_tree->weight);
 
 				//Calculate molecular gas mass of disk and bulge, and specific angular momentum in atomic/molecular disk.
 				auto &molecular_gas = molgas_per_gal.at(galaxy);
 				// Gas components separated into HI and H2.
-				mmol_disk.push_back(molecular_gas.m_mol);
-				mmol_bulge.push_back(molecular_gas.m_mol_b);
-				matom_disk.push_back(molecular_gas.m_atom);
-				matom_bulge.push_back(molecular_gas.m_atom_b);
+				set_value(mmol_disk, g, molecular_gas.m_mol);
+				set_value(mmol_bulge, g, molecular_gas.m_mol_b);
+				set_value(matom_disk, g, molecular_gas.m_atom);
+				set_value(matom_bulge, g, molecular_gas.m_atom_b);
 
 				// Stellar components
-				mstars_disk.push_back(galaxy->disk_stars.mass);
-				mstars_bulge.push_back(galaxy->bulge_stars.mass);
-				mstars_burst_mergers.push_back(galaxy->galaxymergers_burst_stars.mass);
-				mstars_bulge_mergers_assembly.push_back(galaxy->galaxymergers_assembly_stars.mass);
-				mstars_burst_diskinstabilities.push_back(galaxy->diskinstabilities_burst_stars.mass);
-				mstars_bulge_diskins_assembly.push_back(galaxy->diskinstabilities_assembly_stars.mass);
+				set_value(mstars_disk, g, galaxy->disk_stars.mass);
+				set_value(mstars_bulge, g, galaxy->bulge_stars.mass);
+				set_value(mstars_burst_mergers, g, galaxy->galaxymergers_burst_stars.mass);
+				set_value(mstars_bulge_mergers_assembly, g, galaxy->galaxymergers_assembly_stars.mass);
+				set_value(mstars_burst_diskinstabilities, g, galaxy->diskinstabilities_burst_stars.mass);
+				set_value(mstars_bulge_diskins_assembly, g, galaxy->diskinstabilities_assembly_stars.mass);
 
-				mean_stellar_age.push_back(galaxy->mean_stellar_age / galaxy->total_stellar_mass_ever_formed);
+				set_value(mean_stellar_age, g, galaxy->mean_stellar_age / galaxy->total_stellar_mass_ever_formed);
 
 				// Gas components
-				mgas_disk.push_back(galaxy->disk_gas.mass);
-				mgas_bulge.push_back(galaxy->bulge_gas.mass);
+				set_value(mgas_disk, g, galaxy->disk_gas.mass);
+				set_value(mgas_bulge, g, galaxy->bulge_gas.mass);
 
 				// Metals of the stellar components.
-				mstars_metals_disk.push_back(galaxy->disk_stars.mass_metals);
-				mstars_metals_bulge.push_back(galaxy->bulge_stars.mass_metals);
-				mstars_metals_burst_mergers.push_back(galaxy->galaxymergers_burst_stars.mass_metals);
-				mstars_metals_bulge_mergers_assembly.push_back(galaxy->galaxymergers_assembly_stars.mass_metals);
-				mstars_metals_burst_diskinstabilities.push_back(galaxy->diskinstabilities_burst_stars.mass);
-				mstars_metals_bulge_diskins_assembly.push_back(galaxy->diskinstabilities_burst_stars.mass_metals);
+				set_value(mstars_metals_disk, g, galaxy->disk_stars.mass_metals);
+				set_value(mstars_metals_bulge, g, galaxy->bulge_stars.mass_metals);
+				set_value(mstars_metals_burst_mergers, g, galaxy->galaxymergers_burst_stars.mass_metals);
+				set_value(mstars_metals_bulge_mergers_assembly, g, galaxy->galaxymergers_assembly_stars.mass_metals);
+				set_value(mstars_metals_burst_diskinstabilities, g, galaxy->diskinstabilities_burst_stars.mass);
+				set_value(mstars_metals_bulge_diskins_assembly, g, galaxy->diskinstabilities_burst_stars.mass_metals);
 
 				// Metals of the gas components.
-				mgas_metals_disk.push_back(galaxy->disk_gas.mass_metals);
-				mgas_metals_bulge.push_back(galaxy->bulge_gas.mass_metals);
+				set_value(mgas_metals_disk, g, galaxy->disk_gas.mass_metals);
+				set_value(mgas_metals_bulge, g, galaxy->bulge_gas.mass_metals);
 
 				// SFRs in disks and bulges.
-				sfr_disk.push_back(galaxy->sfr_disk);
-				sfr_burst.push_back(galaxy->sfr_bulge_mergers + galaxy->sfr_bulge_diskins);
+				set_value(sfr_disk, g, galaxy->sfr_disk);
+				set_value(sfr_burst, g, galaxy->sfr_bulge_mergers + galaxy->sfr_bulge_diskins);
 
 				// Black hole properties.
-				mBH.push_back(galaxy->smbh.mass);
-				mBH_acc_hh.push_back(galaxy->smbh.macc_hh);
-				mBH_acc_sb.push_back(galaxy->smbh.macc_sb);
+				set_value(mBH, g, galaxy->smbh.mass);
+				set_value(mBH_acc_hh, g, galaxy->smbh.macc_hh);
+				set_value(mBH_acc_sb, g, galaxy->smbh.macc_sb);
 
 				// Sizes and specific angular momentum of disks and bulges.
 
-				rdisk_gas.push_back(galaxy->disk_gas.rscale);
-				rbulge_gas.push_back(galaxy->bulge_gas.rscale);
-				sAM_disk_gas.push_back(galaxy->disk_gas.sAM);
-				sAM_disk_gas_atom.push_back(molecular_gas.j_atom);
-				sAM_disk_gas_mol.push_back(molecular_gas.j_mol);
-				sAM_bulge_gas.push_back(galaxy->bulge_gas.sAM);
+				set_value(rdisk_gas, g, galaxy->disk_gas.rscale);
+				set_value(rbulge_gas, g, galaxy->bulge_gas.rscale);
+				set_value(sAM_disk_gas, g, galaxy->disk_gas.sAM);
+				set_value(sAM_disk_gas_atom, g, molecular_gas.j_atom);
+				set_value(sAM_disk_gas_mol, g, molecular_gas.j_mol);
+				set_value(sAM_bulge_gas, g, galaxy->bulge_gas.sAM);
 
-				rdisk_star.push_back(galaxy->disk_stars.rscale);
-				rbulge_star.push_back(galaxy->bulge_stars.rscale);
-				sAM_disk_star.push_back(galaxy->disk_stars.sAM);
-				sAM_bulge_star.push_back(galaxy->bulge_stars.sAM);
+				set_value(rdisk_star, g, galaxy->disk_stars.rscale);
+				set_value(rbulge_star, g, galaxy->bulge_stars.rscale);
+				set_value(sAM_disk_star, g, galaxy->disk_stars.sAM);
+				set_value(sAM_bulge_star, g, galaxy->bulge_stars.sAM);
 
 				// Halo properties below.
 				double mhot_gal = 0;
@@ -376,15 +668,15 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 					rcool = halo->cooling_rate;
 				}
 
-				cooling_rate.push_back(rcool);
+				set_value(cooling_rate, g, rcool);
 
-				mhot.push_back(mhot_gal);
-				mhot_metals.push_back(mzhot_gal);
-				mreheated.push_back(mreheat);
-				mreheated_metals.push_back(mzreheat);
+				set_value(mhot, g, mhot_gal);
+				set_value(mhot_metals, g, mzhot_gal);
+				set_value(mreheated, g, mreheat);
+				set_value(mreheated_metals, g, mzreheat);
 
-				mvir_hosthalo.push_back(mhalo);
-				vvir_hosthalo.push_back(vhalo);
+				set_value(mvir_hosthalo, g, mhalo);
+				set_value(vvir_hosthalo, g, vhalo);
 
 				double mvir_gal = 0 ;
 				double c_sub = 0;
@@ -399,28 +691,38 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 					l_sub    = lambda;
 					pos      = subhalo->position;
 					vel      = subhalo->velocity;
-					L        = subhalo->L.unit() * galaxy->angular_momentum();
-					vvir_subhalo.push_back(vvir_sh);
-					mvir_subhalo.push_back(mvir_gal);
-					cnfw_subhalo.push_back(c_sub);
-					lambda_subhalo.push_back(l_sub);
-					redshift_of_merger.push_back(-1);
+					if (need_L) {
+						L = subhalo->L.unit() * galaxy->angular_momentum();
+					}
+					set_value(vvir_subhalo, g, vvir_sh);
+					set_value(mvir_subhalo, g, mvir_gal);
+					set_value(cnfw_subhalo, g, c_sub);
+					set_value(lambda_subhalo, g, l_sub);
+					set_value(redshift_of_merger, g, -1);
 					if(snapshot < sim_params.max_snapshot){
 						galaxy->descendant_id = galaxy->id;
 					}
 				}
 				else{
 					// In case of type 2 galaxies assign negative positions, velocities and angular momentum.
-					darkmatterhalo->generate_random_orbits(pos, vel, L, galaxy->angular_momentum(), halo);
-					mvir_subhalo.push_back(galaxy->msubhalo_type2);
-					cnfw_subhalo.push_back(galaxy->concentration_type2);
-					lambda_subhalo.push_back(galaxy->lambda_type2);
-					vvir_subhalo.push_back(galaxy->vvir_type2);
+					if (need_orbits) {
+						pos = orbits.pos[next_orbit];
+						vel = orbits.vel[next_orbit];
+						L = orbits.L[next_orbit];
+						next_orbit++;
+					}
+					set_value(mvir_subhalo, g, galaxy->msubhalo_type2);
+					set_value(cnfw_subhalo, g, galaxy->concentration_type2);
+					set_value(lambda_subhalo, g, galaxy->lambda_type2);
+					set_value(vvir_subhalo, g, galaxy->vvir_type2);
 
 					// calculate the age of the universe by the time this galaxy will merge.
-					double tmerge  = cosmology->convert_redshift_to_age(sim_params.redshifts[snapshot-1]) + galaxy->tmerge;
-					double redshift_merger = cosmology->convert_age_to_redshift_lcdm(tmerge);
-					redshift_of_merger.push_back(redshift_merger);
+					if (!redshift_of_merger.empty()) {
+						double tmerge_remaining = galaxy->merger_age - cosmology->convert_redshift_to_age(sim_params.redshifts[snapshot]);
+						double tmerge  = cosmology->convert_redshift_to_age(sim_params.redshifts[snapshot-1]) + tmerge_remaining;
+						double redshift_merger = cosmology->convert_age_to_redshift_lcdm(tmerge);
+						redshift_of_merger[g] = redshift_merger;
+					}
 
 					//Check whether this type 2 galaxy will merge on the next snapshot. this is done by
 					//checking if their descendant_id has been defined (which would happen in galaxy_mergers
@@ -435,34 +737,37 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 					galaxy->descendant_id = -1;
 				}
 
-				id_galaxy.push_back(galaxy->id);
-				descendant_id_galaxy.push_back(galaxy->descendant_id);
+				set_value(id_galaxy, g, galaxy->id);
+				set_value(descendant_id_galaxy, g, galaxy->descendant_id);
 
-				vmax_subhalo.push_back(galaxy->vmax);
+				set_value(vmax_subhalo, g, galaxy->vmax);
 
 				// Galaxy position and velocity.
-				position_x.push_back(pos.x);
-				position_y.push_back(pos.y);
-				position_z.push_back(pos.z);
-
-				velocity_x.push_back(vel.x);
-				velocity_y.push_back(vel.y);
-				velocity_z.push_back(vel.z);
-
-				L_x.push_back(cosmology->comoving_to_physical_angularmomentum(L.x,sim_params.redshifts[snapshot]));
-				L_y.push_back(cosmology->comoving_to_physical_angularmomentum(L.y,sim_params.redshifts[snapshot]));
-				L_z.push_back(cosmology->comoving_to_physical_angularmomentum(L.z,sim_params.redshifts[snapshot]));
+				set_value(position_x, g, pos.x);
+				set_value(position_y, g, pos.y);
+				set_value(position_z, g, pos.z);
+
+				set_value(velocity_x, g, vel.x);
+				set_value(velocity_y, g, vel.y);
+				set_value(velocity_z, g, vel.z);
+
+				if (need_L) {
+					set_value(L_x, g, cosmology->comoving_to_physical_angularmomentum(L.x,sim_params.redshifts[snapshot]));
+					set_value(L_y, g, cosmology->comoving_to_physical_angularmomentum(L.y,sim_params.redshifts[snapshot]));
+					set_value(L_z, g, cosmology->comoving_to_physical_angularmomentum(L.z,sim_params.redshifts[snapshot]));
+				}
 
-				type.push_back(t);
+				set_value(type, g, t);
 
-				id_halo.push_back(j);
-				id_subhalo.push_back(i);
+				set_value(id_halo, g, j);
+				set_value(id_subhalo, g, i);
 
+				g++;
 			}
 			i++;
+			s++;
 		}
-		j++;
-	}
+	});
 
 	std::ostringstream os;
 	std::size_t total = 0;
@@ -530,6 +835,7 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 	REPORT(L_x);
 	REPORT(L_y);
 	REPORT(L_z);
+	REPORT(weight);
 	REPORT(type);
 	REPORT(id_halo);
 	REPORT(id_subhalo);
@@ -543,217 +849,221 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 
 	//Write subhalo properties.
 	comment = "Subhalo id";
-	file.write_dataset("subhalo/id", id, comment);
+	write_property(file, "subhalo/id", id, comment);
 
 	comment = "=1 if subhalo is the main progenitor' =0 otherwise.";
-	file.write_dataset("subhalo/main_progenitor", main, comment);
+	write_property(file, "subhalo/main_progenitor", main, comment);
 
 	comment = "id of the subhalo that is the descendant of this subhalo";
-	file.write_dataset("subhalo/descendant_id", descendant_id, comment);
+	write_property(file, "subhalo/descendant_id", descendant_id, comment);
 
 	comment = "id of the host halo of this subhalo";
-	file.write_dataset("subhalo/host_id", host_id, comment);
+	write_property(file, "subhalo/host_id", host_id, comment);
 
 	//Write galaxy properties.
 	comment = "stellar mass in the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_disk", mstars_disk, comment);
+	write_property(file, "galaxies/mstars_disk", mstars_disk, comment);
 
 	comment = "stellar mass in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mstars_bulge", mstars_bulge, comment);
+	write_property(file, "galaxies/mstars_bulge", mstars_bulge, comment);
 
 	comment = "stellar mass formed via starbursts driven by galaxy mergers [Msun/h]";
-	file.write_dataset("galaxies/mstars_burst_mergers", mstars_burst_mergers, comment);
+	write_property(file, "galaxies/mstars_burst_mergers", mstars_burst_mergers, comment);
 
 	comment = "stellar mass formed via starbursts driven by disk instabilities [Msun/h]";
-	file.write_dataset("galaxies/mstars_burst_diskinstabilities", mstars_burst_diskinstabilities, comment);
+	write_property(file, "galaxies/mstars_burst_diskinstabilities", mstars_burst_diskinstabilities, comment);
 
 	comment = "stellar mass in the bulge brought via galaxy mergers (but that formed in disks) [Msun/h]";
-	file.write_dataset("galaxies/mstars_bulge_mergers_assembly", mstars_bulge_mergers_assembly, comment);
+	write_property(file, "galaxies/mstars_bulge_mergers_assembly", mstars_bulge_mergers_assembly, comment);
 
 	comment = "stellar mass in the bulge brought via disk instabilities from the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_bulge_diskins_assembly", mstars_bulge_diskins_assembly, comment);
+	write_property(file, "galaxies/mstars_bulge_diskins_assembly", mstars_bulge_diskins_assembly, comment);
 
 	comment = "total gas mass in the disk [Msun/h]";
-	file.write_dataset("galaxies/mgas_disk", mgas_disk, comment);
+	write_property(file, "galaxies/mgas_disk", mgas_disk, comment);
 
 	comment = "gas mass in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mgas_bulge", mgas_bulge, comment);
+	write_property(file, "galaxies/mgas_bulge", mgas_bulge, comment);
 
 	comment = "mass of metals locked in stars in the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_disk",mstars_metals_disk, comment);
+	write_property(file, "galaxies/mstars_metals_disk", mstars_metals_disk, comment);
 
 	comment = "mass of metals locked in stars in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_bulge", mstars_metals_bulge, comment);
+	write_property(file, "galaxies/mstars_metals_bulge", mstars_metals_bulge, comment);
 
 	comment = "mass of metals locked in stars that formed via starbursts driven by galaxy mergers [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_burst_mergers", mstars_metals_burst_mergers, comment);
+	write_property(file, "galaxies/mstars_metals_burst_mergers", mstars_metals_burst_mergers, comment);
 
 	comment = "mass of metals locked in stars that formed via starbursts driven by disk instabilities [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_burst_diskinstabilities", mstars_metals_burst_diskinstabilities, comment);
+	write_property(file, "galaxies/mstars_metals_burst_diskinstabilities", mstars_metals_burst_diskinstabilities, comment);
 
 	comment = "mass of metals locked in stars in the bulge that was brought via galaxy mergers (but that formed in disks) [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_bulge_mergers_assembly", mstars_metals_bulge_mergers_assembly, comment);
+	write_property(file, "galaxies/mstars_metals_bulge_mergers_assembly", mstars_metals_bulge_mergers_assembly, comment);
 
 	comment = "mass of metals locked in stars in the bulge that was brought via disk instabilities from the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_bulge_diskins_assembly", mstars_metals_bulge_diskins_assembly, comment);
+	write_property(file, "galaxies/mstars_metals_bulge_diskins_assembly", mstars_metals_bulge_diskins_assembly, comment);
 
 	comment = "stellar mass-weighted stellar age [Gyr]";
-	file.write_dataset("galaxies/mean_stellar_age", mean_stellar_age, comment);
+	write_property(file, "galaxies/mean_stellar_age", mean_stellar_age, comment);
 
 	comment = "mass of metals locked in the gas of the disk [Msun/h]";
-	file.write_dataset("galaxies/mgas_metals_disk", mgas_metals_disk, comment);
+	write_property(file, "galaxies/mgas_metals_disk", mgas_metals_disk, comment);
 
 	comment = "mass of metals locked in the gas of the bulge [Msun/h]";
-	file.write_dataset("galaxies/mgas_metals_bulge", mgas_metals_bulge, comment);
+	write_property(file, "galaxies/mgas_metals_bulge", mgas_metals_bulge, comment);
 
 	comment = "molecular gas mass (helium plus hydrogen) in the disk [Msun/h]";
-	file.write_dataset("galaxies/mmol_disk",mmol_disk, comment);
+	write_property(file, "galaxies/mmol_disk", mmol_disk, comment);
 
 	comment ="molecular gas mass (helium plus hydrogen) in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mmol_bulge",mmol_bulge, comment);
+	write_property(file, "galaxies/mmol_bulge", mmol_bulge, comment);
 
 	comment = "atomic gas mass (helium plus hydrogen) in the disk [Msun/h]";
-	file.write_dataset("galaxies/matom_disk",matom_disk, comment);
+	write_property(file, "galaxies/matom_disk", matom_disk, comment);
 
 	comment ="atomic gas mass (helium plus hydrogen) in the bulge [Msun/h]";
-	file.write_dataset("galaxies/matom_bulge",matom_bulge, comment);
+	write_property(file, "galaxies/matom_bulge", matom_bulge, comment);
 
 	comment = "star formation rate in the disk [Msun/Gyr/h]";
-	file.write_dataset("galaxies/sfr_disk", sfr_disk, comment);
+	write_property(file, "galaxies/sfr_disk", sfr_disk, comment);
 
 	comment = "star formation rate in the bulge [Msun/Gyr/h]";
-	file.write_dataset("galaxies/sfr_burst", sfr_burst, comment);
+	write_property(file, "galaxies/sfr_burst", sfr_burst, comment);
 
 	comment = "black hole mass [Msun/h]";
-	file.write_dataset("galaxies/m_bh", mBH, comment);
+	write_property(file, "galaxies/m_bh", mBH, comment);
 
 	comment = "accretion rate onto the black hole during the hot halo mode [Msun/Gyr/h]";
-	file.write_dataset("galaxies/bh_accretion_rate_hh", mBH_acc_hh, comment);
+	write_property(file, "galaxies/bh_accretion_rate_hh", mBH_acc_hh, comment);
 
 	comment = "accretion rate onto the black hole during the starburst mode [Msun/Gyr/h]";
-	file.write_dataset("galaxies/bh_accretion_rate_sb", mBH_acc_sb, comment);
+	write_property(file, "galaxies/bh_accretion_rate_sb", mBH_acc_sb, comment);
 
 	comment = "half-mass radius of the stellar disk [cMpc/h]";
-	file.write_dataset("galaxies/rstar_disk", rdisk_star, comment);
+	write_property(file, "galaxies/rstar_disk", rdisk_star, comment);
 
 	comment = "half-mass radius of the stellar bulge [cMpc/h]";
-	file.write_dataset("galaxies/rstar_bulge", rbulge_star, comment);
+	write_property(file, "galaxies/rstar_bulge", rbulge_star, comment);
 
 	comment = "specific angular momentum of the stellar disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_star", sAM_disk_star, comment);
+	write_property(file, "galaxies/specific_angular_momentum_disk_star", sAM_disk_star, comment);
 
 	comment = "specific angular momentum of the stellar bulge [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_bulge_star", sAM_bulge_star, comment);
+	write_property(file, "galaxies/specific_angular_momentum_bulge_star", sAM_bulge_star, comment);
 
 	comment = "half-mass radius of the gas disk [cMpc/h]";
-	file.write_dataset("galaxies/rgas_disk", rdisk_gas, comment);
+	write_property(file, "galaxies/rgas_disk", rdisk_gas, comment);
 
 	comment = "half-mass radius of the gas bulge [cMpc/h]";
-	file.write_dataset("galaxies/rgas_bulge", rbulge_gas, comment);
+	write_property(file, "galaxies/rgas_bulge", rbulge_gas, comment);
 
 	comment = "specific angular momentum of the gas disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_gas", sAM_disk_gas, comment);
+	write_property(file, "galaxies/specific_angular_momentum_disk_gas", sAM_disk_gas, comment);
 
 	comment = "specific angular momentum of the atomic gas disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_gas_atom", sAM_disk_gas_atom, comment);
+	write_property(file, "galaxies/specific_angular_momentum_disk_gas_atom", sAM_disk_gas_atom, comment);
 
 	comment = "specific angular momentum of the molecular gas disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_gas_mol", sAM_disk_gas_mol, comment);
+	write_property(file, "galaxies/specific_angular_momentum_disk_gas_mol", sAM_disk_gas_mol, comment);
 
 	comment = "specific angular momentum of the gas bulge [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_bulge_gas", sAM_bulge_gas, comment);
+	write_property(file, "galaxies/specific_angular_momentum_bulge_gas", sAM_bulge_gas, comment);
 
 	comment = "redshift at which this galaxy will merge onto a central galaxy (only relevant for type 2 galaxies)";
-	file.write_dataset("galaxies/redshift_merger", redshift_of_merger, comment);
+	write_property(file, "galaxies/redshift_merger", redshift_of_merger, comment);
 
 	comment = "hot gas mass in the halo [Msun/h]";
-	file.write_dataset("galaxies/mhot", mhot, comment);
+	write_property(file, "galaxies/mhot", mhot, comment);
 
 	comment = "mass of metals locked in the hot halo gas [Msun/h]";
-	file.write_dataset("galaxies/mhot_metals", mhot_metals, comment);
+	write_property(file, "galaxies/mhot_metals", mhot_metals, comment);
 
 	comment = "gas mass in the ejected gas component [Msun/h]";
-	file.write_dataset("galaxies/mreheated", mreheated, comment);
+	write_property(file, "galaxies/mreheated", mreheated, comment);
 
 	comment = "mass of metals locked in the ejected gas component [Msun/h]";
-	file.write_dataset("galaxies/mreheated_metals", mreheated_metals, comment);
+	write_property(file, "galaxies/mreheated_metals", mreheated_metals, comment);
 
 	comment = "cooling rate of the hot halo component [Msun/Gyr/h].";
-	file.write_dataset("galaxies/cooling_rate", cooling_rate, comment);
+	write_property(file, "galaxies/cooling_rate", cooling_rate, comment);
 
 	comment = "Dark matter mass of the host halo in which this galaxy resides [Msun/h]";
-	file.write_dataset("galaxies/mvir_hosthalo", mvir_hosthalo, comment);
+	write_property(file, "galaxies/mvir_hosthalo", mvir_hosthalo, comment);
 
 	comment = "Dark matter mass of the subhalo in which this galaxy resides [Msun/h]. In the case of type 2 satellites, this corresponds to the mass its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/mvir_subhalo", mvir_subhalo, comment);
+	write_property(file, "galaxies/mvir_subhalo", mvir_subhalo, comment);
 
 	comment = "Maximum circular velocity of this galaxy [km/s]";
-	file.write_dataset("galaxies/vmax_subhalo", vmax_subhalo, comment);
+	write_property(file, "galaxies/vmax_subhalo", vmax_subhalo, comment);
 
 	comment = "Virial velocity of the dark matter subhalo in which this galaxy resides [km/s]. In the case of type 2 satellites, this corresponds to the virial velocity its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/vvir_subhalo", vvir_subhalo, comment);
+	write_property(file, "galaxies/vvir_subhalo", vvir_subhalo, comment);
 
 	comment = "Virial velocity of the dark matter host halo in which this galaxy resides [km/s].";
-	file.write_dataset("galaxies/vvir_hosthalo", vvir_hosthalo, comment);
+	write_property(file, "galaxies/vvir_hosthalo", vvir_hosthalo, comment);
 
 	comment = "NFW concentration parameter of the dark matter subhalo in which this galaxy resides [dimensionless]. In the case of type 2 satellites, this corresponds to the concentration its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/cnfw_subhalo", cnfw_subhalo, comment);
+	write_property(file, "galaxies/cnfw_subhalo", cnfw_subhalo, comment);
 
 	comment = "Spin parameter of the dark matter subhalo in which this galaxy resides [dimensionless].  In the case of type 2 satellites, this corresponds to the lambda its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/lambda_subhalo", lambda_subhalo, comment);
+	write_property(file, "galaxies/lambda_subhalo", lambda_subhalo, comment);
 
 	//Galaxy position
 	comment = "position component x of galaxy [cMpc/h]. In the case of type 2 galaxies, the positions are generated to randomly sample an NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/position_x", position_x, comment);
+	write_property(file, "galaxies/position_x", position_x, comment);
 	comment = "position component y of galaxy [cMpc/h]. In the case of type 2 galaxies, the positions are generated to randomly sample an NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/position_y", position_y, comment);
+	write_property(file, "galaxies/position_y", position_y, comment);
 	comment = "position component z of galaxy [cMpc/h]. In the case of type 2 galaxies, the positions are generated to randomly sample an NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/position_z", position_z, comment);
+	write_property(file, "galaxies/position_z", position_z, comment);
 
 	//Galaxy velocity
 	comment = "peculiar velocity component x of galaxy [km/s]. In the case of type 2 galaxies, the velocity is generated to randomly sample the velocity dispersion of a NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/velocity_x", velocity_x, comment);
+	write_property(file, "galaxies/velocity_x", velocity_x, comment);
 	comment = "peculiar velocity component y of galaxy [km/s]. In the case of type 2 galaxies, the velocity is generated to randomly sample the velocity dispersion of a NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/velocity_y", velocity_y, comment);
+	write_property(file, "galaxies/velocity_y", velocity_y, comment);
 	comment = "peculiar velocity component z of galaxy [km/s]. In the case of type 2 galaxies, the velocity is generated to randomly sample the velocity dispersion of a NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/velocity_z", velocity_z, comment);
+	write_property(file, "galaxies/velocity_z", velocity_z, comment);
 
 	//Galaxy AM vector
 	comment = "total angular momentum component x of galaxy [Msun pMpc km/s]. In the case of type 2 galaxies, the AM vector is randomly oriented.";
-	file.write_dataset("galaxies/l_x", L_x,  comment);
+	write_property(file, "galaxies/l_x", L_x,  comment);
 	comment = "total angular momentum component y of galaxy [Msun pMpc km/s]. In the case of type 2 galaxies, the AM vector is randomly oriented.";
-	file.write_dataset("galaxies/l_y", L_y, comment);
+	write_property(file, "galaxies/l_y", L_y, comment);
 	comment = "total angular momentum component z of galaxy [Msun pMpc km/s]. In the case of type 2 galaxies, the AM vector is randomly oriented.";
-	file.write_dataset("galaxies/l_z", L_z, comment);
+	write_property(file, "galaxies/l_z", L_z, comment);
+
+	comment = "number of galaxies this galaxy stands for when only a sample of the merger trees is evolved (see execution.tree_sampling_rate) [dimensionless]. Volume-averaged quantities should be weighted by it.";
+	write_property(file, "galaxies/weight", weight, comment);
 
 	//Galaxy type.
 	comment = "galaxy type; =0 for centrals; =1 for satellites that reside in well identified subhalos; =2 for orphan satellites";
-	file.write_dataset("galaxies/type", type, comment);
+	write_property(file, "galaxies/type", type, comment);
 
 	//Galaxy IDs.
 	comment = "subhalo ID. Unique to this snapshot.";
-	file.write_dataset("galaxies/id_subhalo", id_subhalo, comment);
+	write_property(file, "galaxies/id_subhalo", id_subhalo, comment);
 
 	comment = "halo ID. Unique to this snapshot.";
-	file.write_dataset("galaxies/id_halo", id_halo, comment);
+	write_property(file, "galaxies/id_halo", id_halo, comment);
 
 	comment = "galaxy ID. Unique to this galaxy throughout time. If this galaxy never mergers onto a central, then its ID is always the same.";
-	file.write_dataset("galaxies/id_galaxy", id_galaxy, comment);
+	write_property(file, "galaxies/id_galaxy", id_galaxy, comment);
 
 	comment = "descendant galaxy ID. Different to galaxy id only if galaxy is type 2 and merges on the next snapshot.";
-	file.write_dataset("galaxies/descendant_id_galaxy", descendant_id_galaxy, comment);
+	write_property(file, "galaxies/descendant_id_galaxy", descendant_id_galaxy, comment);
 
 	comment = "subhalo id in the tree (unique to entire halo catalogue).";
-	file.write_dataset("galaxies/id_subhalo_tree", id_subhalo_tree, comment);
+	write_property(file, "galaxies/id_subhalo_tree", id_subhalo_tree, comment);
 
 	comment = "halo id in the tree (unique to entire halo catalogue).";
-	file.write_dataset("galaxies/id_halo_tree", id_halo_tree, comment);
+	write_property(file, "galaxies/id_halo_tree", id_halo_tree, comment);
 
 	LOG(info) << "Galaxies data written in " << t;
 
 }
 
-void HDF5GalaxyWriter::write_global_properties (hdf5::Writer &file, int snapshot, TotalBaryon &AllBaryons){
+template <typename FileWriter>
+void HDF5GalaxyWriter::write_global_properties (FileWriter &file, int snapshot, TotalBaryon &AllBaryons){
 
 	using std::string;
 	using std::vector;
@@ -763,12 +1073,14 @@ void HDF5GalaxyWriter::write_global_properties (hdf5::Writer &file, int snapshot
 	vector<float> redshifts;
 	vector<double> baryons_ever_created;
 	vector<double> baryons_ever_lost;
+	vector<double> baryons_pruned;
 
 	double baryons_lost = 0;
 
 	for (int i=sim_params.min_snapshot+1; i <= snapshot; i++){
 		redshifts.push_back(sim_params.redshifts[i]);
 		baryons_ever_created.push_back(AllBaryons.baryon_total_created[i]);
+		baryons_pruned.push_back(AllBaryons.baryon_total_pruned[i]);
 
 		// Accummulate baryons lost.
 		baryons_lost += AllBaryons.baryon_total_lost[i];
@@ -851,209 +1163,444 @@ void HDF5GalaxyWriter::write_global_properties (hdf5::Writer &file, int snapshot
 
 	comment = "total baryons lost in the simulated box [Msun/h] (ideally this should be =0)";
 	file.write_dataset("global/mbar_lost", baryons_ever_lost, comment);
+
+	comment = "total baryon mass in halos pruned from the merger trees (see execution.min_branch_mass) in the simulated box [Msun/h]";
+	file.write_dataset("global/mbar_pruned", baryons_pruned, comment);
+}
+
+bool HDF5GalaxyWriter::sf_histories_snapshot(int snapshot) const
+{
+	auto &snapshots = exec_params.snapshots_sf_histories;
+	return exec_params.output_sf_histories && std::find(snapshots.begin(), snapshots.end(), snapshot) != snapshots.end();
+}
+
+hdf5::dataset_storage HDF5GalaxyWriter::output_storage() const
+{
+	hdf5::dataset_storage storage;
+	storage.chunk_size = exec_params.output_chunk_size;
+	storage.level = exec_params.output_compression_level;
+	storage.shuffle = exec_params.output_shuffle;
+	storage.threads = threads;
+	if (exec_params.output_compression == ExecutionParameters::COMPRESSION_DEFLATE) {
+		storage.compression = hdf5::dataset_storage::DEFLATE;
+	}
+	else if (exec_params.output_compression == ExecutionParameters::COMPRESSION_LZ4) {
+		storage.compression = hdf5::dataset_storage::LZ4;
+	}
+	return storage;
 }
 
-void HDF5GalaxyWriter::write_histories (int snapshot, const std::vector<HaloPtr> &halos){
+template <typename FileWriter>
+std::shared_ptr<FileWriter> HDF5GalaxyWriter::write_histories (int snapshot, const std::vector<HaloPtr> &halos){
+
+	// Streamed histories are assembled and written separately
+	if (!sf_histories_snapshot(snapshot) || history_stream) {
+		return std::shared_ptr<FileWriter>();
+	}
+
+	// save galaxies only if they have a stellar mass >0 by the output snapshot.
+	galaxy_histories_t histories;
+	for (auto &halo: halos){
+		for (auto &subhalo: halo->subhalos()){
+			for (auto &galaxy: subhalo->galaxies){
+				if(galaxy->stellar_mass() > 0){
+					histories.emplace_back(galaxy->id, &galaxy->history);
+				}
+			}
+		}
+	}
 
+	auto file_sfh_ptr = std::make_shared<FileWriter>(get_output_directory(snapshot) + "/star_formation_histories.hdf5");
+	file_sfh_ptr->set_storage(output_storage());
+	write_histories(*file_sfh_ptr, snapshot, histories);
+	return file_sfh_ptr;
+}
+
+/// The snapshots for which @p history has an item, separated by spaces
+static
+std::string history_snapshots(const GalaxyHistory &history)
+{
+	std::ostringstream os;
+	auto hsnaps = history.snapshots();
+	std::copy(hsnaps.begin(), hsnaps.end(), std::ostream_iterator<int>(os, " "));
+	return os.str();
+}
+
+/**
+ * The star formation and metallicity histories of one component of many
+ * galaxies in compressed sparse row format, keeping only the snapshots where
+ * either is non-zero
+ */
+struct sparse_histories {
+
+	std::vector<std::int64_t> row_offsets {0};
+	std::vector<int> snapshot_index;
+	std::vector<float> sfr;
+	std::vector<float> metallicity;
+
+	void add(const std::vector<float> &sfh, const std::vector<float> &metals)
+	{
+		for (std::size_t i = 0; i != sfh.size(); i++) {
+			if (sfh[i] != 0 || metals[i] != 0) {
+				snapshot_index.push_back(int(i));
+				sfr.push_back(sfh[i]);
+				metallicity.push_back(metals[i]);
+			}
+		}
+		row_offsets.push_back(sfr.size());
+	}
+
+	template <typename FileWriter>
+	void write(FileWriter &file, const std::string &group, const std::string &component) const
+	{
+		std::string comment = "Index of the first value of each galaxy in the values of this group; the values of galaxy i are in [row_offsets[i], row_offsets[i + 1])";
+		file.write_dataset(group + "/row_offsets", row_offsets, comment);
+		comment = "Index into redshifts of the snapshot of each value of this group";
+		file.write_dataset(group + "/snapshot_index", snapshot_index, comment);
+		comment = "Non-zero values of the star formation history of stars formed that by this output time end up in " + component + " [Msun/yr/h]";
+		file.write_dataset(group + "/star_formation_rate_values", sfr, comment);
+		comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in " + component + ", for each value of star_formation_rate_values";
+		file.write_dataset(group + "/metallicity_values", metallicity, comment);
+	}
+};
+
+template <typename FileWriter>
+void HDF5GalaxyWriter::write_histories (FileWriter &file_sfh, int snapshot, const galaxy_histories_t &histories){
 
 	using std::string;
 	using std::vector;
 
 	string comment;
 
-	if(exec_params.output_sf_histories){
-		if(std::find(exec_params.snapshots_sf_histories.begin(), exec_params.snapshots_sf_histories.end(), snapshot) != exec_params.snapshots_sf_histories.end()){
-			hdf5::Writer file_sfh(get_output_directory(snapshot) + "/star_formation_histories.hdf5");
-
-			//Create the vectors that will save the information of the galaxies
-			vector<vector<float>> sfhs_disk;
-			vector<vector<float>> stellar_mass_disk;
-			vector<vector<float>> stellar_metals_disk;
-
-			vector<vector<float>> sfhs_bulge_mergers;
-			vector<vector<float>> stellar_mass_bulge_mergers;
-			vector<vector<float>> stellar_metals_bulge_mergers;
-
-			vector<vector<float>> sfhs_bulge_diskins;
-			vector<vector<float>> stellar_mass_bulge_diskins;
-			vector<vector<float>> stellar_metals_bulge_diskins;
-
-			vector<Galaxy::id_t> id_galaxy;
-
-			float defl_value = 0;
-
-			for (auto &halo: halos){
-				for (auto &subhalo: halo->all_subhalos()){
-					for (auto &galaxy: subhalo->galaxies){
-
-						vector<float> sfh_gal_disk;
-						vector<float> star_metals_gal_disk;
-						vector<float> sfh_gal_bulge_mergers;
-						vector<float> star_metals_gal_bulge_mergers;
-						vector<float> sfh_gal_bulge_diskins;
-						vector<float> star_metals_gal_bulge_diskins;
-
-						bool star_gal_bulge_exists = false;
-						for(int s=sim_params.min_snapshot+1; s <= snapshot; s++) {
-
-							auto it = std::find_if(galaxy->history.begin(), galaxy->history.end(), [s](const HistoryItem &hitem) {
-								//information in snapshot corresponds to the end of it, so effectively, when writing, we need to
-								//compare to s-1.
-								return hitem.snapshot == s-1;
-							});
-
-							if (it == galaxy->history.end()) {
-								if (star_gal_bulge_exists) {
-									std::ostringstream os;
-									os << "The history of the StellarMass of the bulge of " << galaxy << " ceased to exist (temporarily). ";
-									os << "These are the snapshots for which there is a history item: ";
-									vector<int> hsnaps(galaxy->history.size());
-									std::transform(galaxy->history.begin(), galaxy->history.end(), hsnaps.begin(), [](const HistoryItem &hitem) {
-										return hitem.snapshot;
-									});
-									std::copy(hsnaps.begin(), hsnaps.end(), std::ostream_iterator<int>(os, " "));
-									LOG(warning) << os.str();
-									for (auto &item: galaxy->history){
-										std::ostringstream os;
-										os << "snap history: "<< item.snapshot;
-										LOG(warning) << os.str();
-									}
-								}
-								sfh_gal_disk.push_back(defl_value);
-								star_metals_gal_disk.push_back(defl_value);
-
-								sfh_gal_bulge_mergers.push_back(defl_value);
-								star_metals_gal_bulge_mergers.push_back(defl_value);
-
-								sfh_gal_bulge_diskins.push_back(defl_value);
-								star_metals_gal_bulge_diskins.push_back(defl_value);
-							}
-							else {
-								star_gal_bulge_exists = true;
-								auto item = *it;
-								// assign disk properties
-								sfh_gal_disk.push_back(item.sfr_disk/constants::GIGA);
-								if(item.sfr_disk > 0){
-									star_metals_gal_disk.push_back(item.sfr_z_disk/item.sfr_disk);
-								}
-								else{
-									star_metals_gal_disk.push_back(0);
-								}
-
-								// assign bulge properties driven by mergers
-								sfh_gal_bulge_mergers.push_back(item.sfr_bulge_mergers/constants::GIGA);
-								if(item.sfr_bulge_mergers > 0){
-									star_metals_gal_bulge_mergers.push_back(item.sfr_z_bulge_mergers/item.sfr_bulge_mergers);
-								}
-								else{
-									star_metals_gal_bulge_mergers.push_back(0);
-								}
-
-								// assign bulge properties driven by disk instabilities
-								sfh_gal_bulge_diskins.push_back(item.sfr_bulge_diskins/constants::GIGA);
-								if(item.sfr_bulge_diskins > 0){
-									star_metals_gal_bulge_diskins.push_back(item.sfr_z_bulge_diskins/item.sfr_bulge_diskins);
-								}
-								else{
-									star_metals_gal_bulge_diskins.push_back(0);
-								}
-							}
-						}
-
-						// save galaxies only if they have a stellar mass >0 by the output snapshot.
-						if(galaxy->stellar_mass() > 0){
-							sfhs_disk.emplace_back(std::move(sfh_gal_disk));
-							stellar_metals_disk.emplace_back(std::move(star_metals_gal_disk));
-
-							sfhs_bulge_mergers.emplace_back(std::move(sfh_gal_bulge_mergers));
-							stellar_metals_bulge_mergers.emplace_back(std::move(star_metals_gal_bulge_mergers));
-
-							sfhs_bulge_diskins.emplace_back(std::move(sfh_gal_bulge_diskins));
-							stellar_metals_bulge_diskins.emplace_back(std::move(star_metals_gal_bulge_diskins));
-
-							id_galaxy.push_back(galaxy->id);
-						}
-					}
+	//Create the vectors that will save the information of the galaxies
+	vector<vector<float>> sfhs_disk;
+	vector<vector<float>> stellar_metals_disk;
+
+	vector<vector<float>> sfhs_bulge_mergers;
+	vector<vector<float>> stellar_metals_bulge_mergers;
+
+	vector<vector<float>> sfhs_bulge_diskins;
+	vector<vector<float>> stellar_metals_bulge_diskins;
+
+	vector<Galaxy::id_t> id_galaxy;
+
+	// Only the non-zero values of histories are kept when writing them sparsely
+	bool sparse = exec_params.sf_histories_encoding == ExecutionParameters::SFH_SPARSE;
+	sparse_histories sparse_disk;
+	sparse_histories sparse_bulge_mergers;
+	sparse_histories sparse_bulge_diskins;
+
+	float defl_value = 0;
+
+	for (auto &galaxy_and_history: histories){
+
+		auto galaxy_id = galaxy_and_history.first;
+		const auto &history = *galaxy_and_history.second;
+
+		vector<float> sfh_gal_disk;
+		vector<float> star_metals_gal_disk;
+		vector<float> sfh_gal_bulge_mergers;
+		vector<float> star_metals_gal_bulge_mergers;
+		vector<float> sfh_gal_bulge_diskins;
+		vector<float> star_metals_gal_bulge_diskins;
+
+		bool star_gal_bulge_exists = false;
+		for(int s=sim_params.min_snapshot+1; s <= snapshot; s++) {
+
+			//information in snapshot corresponds to the end of it, so effectively, when writing, we need to
+			//compare to s-1.
+			if (!history.exists(s-1)) {
+				if (star_gal_bulge_exists) {
+					LOG_LIMITED(warning) << "The history of the StellarMass of the bulge of galaxy " << galaxy_id << " ceased to exist (temporarily). "
+					                     << "These are the snapshots for which there is a history item: " << history_snapshots(history);
 				}
+				sfh_gal_disk.push_back(defl_value);
+				star_metals_gal_disk.push_back(defl_value);
+
+				sfh_gal_bulge_mergers.push_back(defl_value);
+				star_metals_gal_bulge_mergers.push_back(defl_value);
+
+				sfh_gal_bulge_diskins.push_back(defl_value);
+				star_metals_gal_bulge_diskins.push_back(defl_value);
 			}
+			else {
+				star_gal_bulge_exists = true;
+				auto item = history.get(s-1);
+				// assign disk properties
+				sfh_gal_disk.push_back(item.sfr_disk/constants::GIGA);
+				if(item.sfr_disk > 0){
+					star_metals_gal_disk.push_back(item.sfr_z_disk/item.sfr_disk);
+				}
+				else{
+					star_metals_gal_disk.push_back(0);
+				}
 
-			vector<float> redshifts;
-			vector<float> age_mean;
-			vector<float> delta_t;
-
-			double age_uni = std::abs(cosmology->convert_redshift_to_age(0));
-			for (int i=sim_params.min_snapshot+1; i <= snapshot; i++){
-				redshifts.push_back(sim_params.redshifts[i]);
-				double delta = std::abs(cosmology->convert_redshift_to_age(sim_params.redshifts[i]) - cosmology->convert_redshift_to_age(sim_params.redshifts[i-1]));
-				double age = age_uni - 0.5 * (std::abs(cosmology->convert_redshift_to_age(sim_params.redshifts[i]) + cosmology->convert_redshift_to_age(sim_params.redshifts[i-1])));
-				delta_t.push_back(delta);
-				age_mean.push_back(age);
+				// assign bulge properties driven by mergers
+				sfh_gal_bulge_mergers.push_back(item.sfr_bulge_mergers/constants::GIGA);
+				if(item.sfr_bulge_mergers > 0){
+					star_metals_gal_bulge_mergers.push_back(item.sfr_z_bulge_mergers/item.sfr_bulge_mergers);
+				}
+				else{
+					star_metals_gal_bulge_mergers.push_back(0);
+				}
+
+				// assign bulge properties driven by disk instabilities
+				sfh_gal_bulge_diskins.push_back(item.sfr_bulge_diskins/constants::GIGA);
+				if(item.sfr_bulge_diskins > 0){
+					star_metals_gal_bulge_diskins.push_back(item.sfr_z_bulge_diskins/item.sfr_bulge_diskins);
+				}
+				else{
+					star_metals_gal_bulge_diskins.push_back(0);
+				}
 			}
+		}
+
+		if (sparse) {
+			sparse_disk.add(sfh_gal_disk, star_metals_gal_disk);
+			sparse_bulge_mergers.add(sfh_gal_bulge_mergers, star_metals_gal_bulge_mergers);
+			sparse_bulge_diskins.add(sfh_gal_bulge_diskins, star_metals_gal_bulge_diskins);
+		}
+		else {
+			sfhs_disk.emplace_back(std::move(sfh_gal_disk));
+			stellar_metals_disk.emplace_back(std::move(star_metals_gal_disk));
+
+			sfhs_bulge_mergers.emplace_back(std::move(sfh_gal_bulge_mergers));
+			stellar_metals_bulge_mergers.emplace_back(std::move(star_metals_gal_bulge_mergers));
+
+			sfhs_bulge_diskins.emplace_back(std::move(sfh_gal_bulge_diskins));
+			stellar_metals_bulge_diskins.emplace_back(std::move(star_metals_gal_bulge_diskins));
+		}
+
+		id_galaxy.push_back(galaxy_id);
+	}
+
+	//Write header
+	write_header(file_sfh, snapshot, exec_params.simulation_batches.size());
+
+	comment = "galaxy ID. Unique to this galaxy throughout time. If this galaxy never mergers onto a central, then its ID is always the same.";
+	file_sfh.write_dataset("galaxies/id_galaxy", id_galaxy, comment);
+
+	if (sparse) {
+		comment = "how histories are encoded: dense or sparse";
+		file_sfh.write_dataset("histories_encoding", std::string("sparse"), comment);
+		sparse_disk.write(file_sfh, "disks", "the disk");
+		sparse_bulge_mergers.write(file_sfh, "bulges_mergers", "the bulge formed via galaxy mergers");
+		sparse_bulge_diskins.write(file_sfh, "bulges_diskins", "the bulge formed via disk instabilities");
+		write_history_times(file_sfh, snapshot);
+		return;
+	}
 
-			//Write header
-			write_header(file_sfh, snapshot);
+	//Write disk component history.
+	comment = "Star formation history of stars formed that by this output time end up in the disk [Msun/yr/h]";
+	file_sfh.write_dataset("disks/star_formation_rate_histories", sfhs_disk, comment);
 
-			comment = "galaxy ID. Unique to this galaxy throughout time. If this galaxy never mergers onto a central, then its ID is always the same.";
-			file_sfh.write_dataset("galaxies/id_galaxy", id_galaxy, comment);
+	comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in the disk";
+	file_sfh.write_dataset("disks/metallicity_histories", stellar_metals_disk, comment);
 
-			//Write disk component history.
-			comment = "Star formation history of stars formed that by this output time end up in the disk [Msun/yr/h]";
-			file_sfh.write_dataset("disks/star_formation_rate_histories", sfhs_disk, comment);
+	//Write bulge component history, for the mass build up due to galaxy mergers.
+	comment = "Star formation history of stars formed that by this output time end up in the bulge formed via galaxy mergers [Msun/yr/h]";
+	file_sfh.write_dataset("bulges_mergers/star_formation_rate_histories", sfhs_bulge_mergers, comment);
 
-			comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in the disk";
-			file_sfh.write_dataset("disks/metallicity_histories", stellar_metals_disk, comment);
+	comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in the bulge formed via galaxy mergers";
+	file_sfh.write_dataset("bulges_mergers/metallicity_histories", stellar_metals_bulge_mergers, comment);
 
-			//Write bulge component history, for the mass build up due to galaxy mergers.
-			comment = "Star formation history of stars formed that by this output time end up in the bulge formed via galaxy mergers [Msun/yr/h]";
-			file_sfh.write_dataset("bulges_mergers/star_formation_rate_histories", sfhs_bulge_mergers, comment);
+	//Write bulge component history.
+	comment = "Star formation history of stars formed that by this output time end up in the bulge formed via disk instabilities [Msun/yr/h]";
+	file_sfh.write_dataset("bulges_diskins/star_formation_rate_histories", sfhs_bulge_diskins, comment);
 
-			comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in the bulge formed via galaxy mergers";
-			file_sfh.write_dataset("bulges_mergers/metallicity_histories", stellar_metals_bulge_mergers, comment);
+	comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in the bulge formed via disk instabilities";
+	file_sfh.write_dataset("bulges_diskins/metallicity_histories", stellar_metals_bulge_diskins, comment);
 
-			//Write bulge component history.
-			comment = "Star formation history of stars formed that by this output time end up in the bulge formed via disk instabilities [Msun/yr/h]";
-			file_sfh.write_dataset("bulges_diskins/star_formation_rate_histories", sfhs_bulge_diskins, comment);
+	write_history_times(file_sfh, snapshot);
+}
 
-			comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in the bulge formed via disk instabilities";
-			file_sfh.write_dataset("bulges_diskins/metallicity_histories", stellar_metals_bulge_diskins, comment);
+template <typename FileWriter>
+void HDF5GalaxyWriter::write_history_times (FileWriter &file_sfh, int snapshot){
 
-			comment = "Redshifts of the history outputs";
-			file_sfh.write_dataset("redshifts", redshifts, comment);
+	using std::vector;
 
-			comment = "Look back time to mean time between snapshots [Gyr]";
-			file_sfh.write_dataset("lbt_mean", age_mean, comment);
+	vector<float> redshifts;
+	vector<float> age_mean;
+	vector<float> delta_t;
 
-			comment = "Time interval covered between snapshots [Gyr]";
-			file_sfh.write_dataset("delta_t", delta_t, comment);
+	double age_uni = std::abs(cosmology->convert_redshift_to_age(0));
+	for (int i=sim_params.min_snapshot+1; i <= snapshot; i++){
+		redshifts.push_back(sim_params.redshifts[i]);
+		double delta = std::abs(cosmology->convert_redshift_to_age(sim_params.redshifts[i]) - cosmology->convert_redshift_to_age(sim_params.redshifts[i-1]));
+		double age = age_uni - 0.5 * (std::abs(cosmology->convert_redshift_to_age(sim_params.redshifts[i]) + cosmology->convert_redshift_to_age(sim_params.redshifts[i-1])));
+		delta_t.push_back(delta);
+		age_mean.push_back(age);
+	}
 
+	std::string comment = "Redshifts of the history outputs";
+	file_sfh.write_dataset("redshifts", redshifts, comment);
+
+	comment = "Look back time to mean time between snapshots [Gyr]";
+	file_sfh.write_dataset("lbt_mean", age_mean, comment);
+
+	comment = "Time interval covered between snapshots [Gyr]";
+	file_sfh.write_dataset("delta_t", delta_t, comment);
+}
+
+void HDF5GalaxyWriter::stream_histories(int snapshot, const std::vector<HaloPtr> &halos)
+{
+	// Items recorded at this snapshot are output from the next one onwards
+	auto &sfh_snapshots = exec_params.snapshots_sf_histories;
+	if (!exec_params.output_sf_histories || !exec_params.stream_sf_histories || sfh_snapshots.empty()) {
+		return;
+	}
+	auto last_sfh_snapshot = *std::max_element(sfh_snapshots.begin(), sfh_snapshots.end());
+	if (snapshot >= last_sfh_snapshot) {
+		return;
+	}
+
+	if (!history_stream) {
+		auto filename = get_output_directory(last_sfh_snapshot) + "/star_formation_histories_stream.hdf5";
+		history_stream = std::make_shared<HistoryStream>(filename);
+		LOG(info) << "Streaming star formation histories into " << filename;
+	}
+
+	// Items are taken out of the galaxies now, but written to disk
+	// only by the background worker, if any
+	auto block = std::make_shared<HistoryStream::snapshot_block>(HistoryStream::collect(snapshot, halos));
+	auto stream = history_stream;
+	submit([stream, block]() {
+		stream->append(*block);
+	});
+}
+
+void HDF5GalaxyWriter::write_streamed_histories(int snapshot, const std::vector<HaloPtr> &halos)
+{
+	if (!sf_histories_snapshot(snapshot) || !history_stream) {
+		return;
+	}
+
+	// save galaxies only if they have a stellar mass >0 by the output snapshot.
+	std::vector<std::int64_t> galaxy_ids;
+	for (auto &halo: halos){
+		for (auto &subhalo: halo->subhalos()){
+			for (auto &galaxy: subhalo->galaxies){
+				if(galaxy->stellar_mass() > 0){
+					galaxy_ids.push_back(galaxy->id);
+				}
+			}
 		}
+	}
+
+	auto stream = history_stream;
+	auto filename = get_output_directory(snapshot) + "/star_formation_histories.hdf5";
+	submit([this, stream, snapshot, galaxy_ids, filename]() {
+		Timer t;
+		auto streamed_histories = stream->assemble(galaxy_ids);
+		galaxy_histories_t histories;
+		for (auto galaxy_id: galaxy_ids) {
+			histories.emplace_back(Galaxy::id_t(galaxy_id), &streamed_histories.at(galaxy_id));
+		}
+		hdf5::Writer file_sfh(filename);
+		file_sfh.set_storage(output_storage());
+		write_histories(file_sfh, snapshot, histories);
+		LOG(info) << "Star formation histories for snapshot " << snapshot << " assembled from " << stream->get_filename() << " in " << t;
+	});
+}
+
+void ColumnarGalaxyWriter::write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal)
+{
+	// Values are collected now, and written to disk (maybe in the background) later
+	auto file = std::make_shared<ColumnarWriter>(get_output_directory(snapshot) + "/galaxies");
+	write_header(*file, snapshot, exec_params.simulation_batches.size());
+	write_galaxies(*file, snapshot, halos, molgas_per_gal);
+	write_global_properties(*file, snapshot, AllBaryons);
+	write_galaxy_index(*file, halos);
+	auto file_sfh = write_histories<hdf5::DeferredWriter>(snapshot, halos);
+
+	submit([file, file_sfh, snapshot]() {
+		Timer t;
+		file->flush();
+		if (file_sfh) {
+			file_sfh->flush();
+		}
+		LOG(info) << "Output files for snapshot " << snapshot << " written in " << t;
+	});
+	write_streamed_histories(snapshot, halos);
+}
+
+void ColumnarGalaxyWriter::write_global(int snapshot, TotalBaryon &AllBaryons)
+{
+	ColumnarWriter file(get_snapshot_directory(snapshot) + "/global");
+	write_global_properties(file, snapshot, AllBaryons);
+	file.flush();
+}
 
+template <typename FileWriter>
+void ColumnarGalaxyWriter::write_galaxy_index(FileWriter &file, const std::vector<HaloPtr> &halos)
+{
+	// Galaxies are visited in the same order as in write_galaxies
+	std::vector<Galaxy::id_t> ids;
+	for (auto &halo: halos) {
+		for (auto &subhalo: halo->subhalos()) {
+			for (auto &galaxy: subhalo->galaxies) {
+				ids.push_back(galaxy->id);
+			}
+		}
 	}
+
+	std::vector<std::int64_t> rows(ids.size());
+	std::iota(rows.begin(), rows.end(), 0);
+	std::sort(rows.begin(), rows.end(), [&ids](std::int64_t a, std::int64_t b) {
+		return ids[a] < ids[b];
+	});
+	std::vector<Galaxy::id_t> sorted_ids(ids.size());
+	std::transform(rows.begin(), rows.end(), sorted_ids.begin(), [&ids](std::int64_t row) {
+		return ids[row];
+	});
+
+	std::string comment = "galaxy IDs, in increasing order";
+	file.write_dataset("index/id_galaxy", sorted_ids, comment);
+	comment = "row of the galaxies/ columns holding the values of each galaxy of index/id_galaxy";
+	file.write_dataset("index/row", rows, comment);
 }
 
 void ASCIIGalaxyWriter::write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal)
 {
 
-	using std::vector;
-	using std::string;
-
-	std::ofstream output(get_output_directory(snapshot) + "/galaxies.dat");
+	auto fname = get_output_directory(snapshot) + "/galaxies.dat";
 
 	// TODO: Write a header?
 
-	// Each galaxy corresponds to one line
-	for (const auto &halo: halos) {
-		for(const auto &subhalo: halo->all_subhalos()) {
-			for(const auto &galaxy: subhalo->galaxies) {
-				write_galaxy(galaxy, subhalo, snapshot, output, molgas_per_gal);
+	// Each galaxy corresponds to one line. The lines of consecutive blocks of
+	// halos are formatted in parallel into one buffer per block, and buffers
+	// are then written in order, each with a single call
+	auto n_halos = halos.size();
+	auto n_blocks = (n_halos + ascii_halos_per_block - 1) / ascii_halos_per_block;
+	auto blocks = std::make_shared<std::vector<std::string>>(n_blocks);
+	omp_dynamic_for(std::size_t(0), n_blocks, threads, 1, [&](std::size_t block, int thread_idx) {
+		auto &buffer = (*blocks)[block];
+		auto last = std::min(n_halos, (block + 1) * ascii_halos_per_block);
+		for (auto h = block * ascii_halos_per_block; h != last; h++) {
+			for (const auto &subhalo: halos[h]->subhalos()) {
+				for (const auto &galaxy: subhalo->galaxies) {
+					write_galaxy(galaxy, subhalo, snapshot, buffer, molgas_per_gal);
+				}
 			}
 		}
-	}
+	});
 
-	output.close();
+	auto write_blocks = [fname, blocks]() {
+		std::ofstream output(fname, std::ios::binary);
+		for (const auto &block: *blocks) {
+			output.write(block.data(), block.size());
+		}
+		output.close();
+	};
+
+	if (!asynchronous()) {
+		write_blocks();
+		return;
+	}
+	submit(write_blocks);
 }
 
-void ASCIIGalaxyWriter::write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &subhalo, int snapshot, std::ofstream &f, const molgas_per_galaxy &molgas_per_gal)
+void ASCIIGalaxyWriter::write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &subhalo, int snapshot, std::string &buffer, const molgas_per_galaxy &molgas_per_gal)
 {
 	auto mstars_disk = galaxy->disk_stars.mass;
 	auto mstars_bulge = galaxy->bulge_stars.mass;
@@ -1064,10 +1611,14 @@ void ASCIIGalaxyWriter::write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &
 	auto rbulge = galaxy->bulge_stars.rscale;
 	auto &molecular_gas = molgas_per_gal.at(galaxy);
 
-	f << mstars_disk << " " << mstars_bulge << " " <<  molecular_gas.m_atom + molecular_gas.m_atom_b
-	  << " " << mBH << " " << mgas_metals_disk / mgas_disk << " "
-	  << mstars_disk + mstars_bulge << " " << rdisk << " " << rbulge << " "
-	  << subhalo->id << " " << subhalo->host_halo->id << "\n";
+	// %g formats values exactly like std::ostream does by default
+	char line[256];
+	auto length = std::snprintf(line, sizeof(line), "%g %g %g %g %g %g %g %g %lld %lld\n",
+	                            double(mstars_disk), double(mstars_bulge), double(molecular_gas.m_atom + molecular_gas.m_atom_b),
+	                            double(mBH), double(mgas_metals_disk / mgas_disk),
+	                            double(mstars_disk + mstars_bulge), double(rdisk), double(rbulge),
+	                            static_cast<long long>(subhalo->id), static_cast<long long>(subhalo->host_halo->id));
+	buffer.append(line, std::min(std::size_t(length), sizeof(line) - 1));
 
 }
 
@@ -34,6 +34,7 @@
 #include "gas_cooling.h"
 #include "logging.h"
 #include "numerical_constants.h"
+#include "profiling.h"
 #include "reincorporation.h"
 #include "utils.h"
 
@@ -48,10 +49,10 @@ void CoolingTable::add_metallicity_measurements(double zmetal, const std::map<do
 	// In other words, make sure that for all metallicities we have measurements
 	// at the same temperatures, which gives us a nicely populated grid
 	// over which we can interpolate later
-	if (!_table.empty()) {
+	if (!_table->empty()) {
 
-		auto first_metallicity = std::begin(_table)->first;
-		auto &first_measurement = std::begin(_table)->second;
+		auto first_metallicity = std::begin(*_table)->first;
+		auto &first_measurement = std::begin(*_table)->second;
 		vector<double> first_keys = get_keys(first_measurement);
 		vector<double> these_keys = get_keys(first_measurement);
 
@@ -63,23 +64,26 @@ void CoolingTable::add_metallicity_measurements(double zmetal, const std::map<do
 		}
 	}
 
-	_table[zmetal] = records;
+	if (_table.use_count() > 1) {
+		_table = std::make_shared<table_t>(*_table);
+	}
+	(*_table)[zmetal] = records;
 }
 
 std::vector<double> CoolingTable::get_metallicities()
 {
-	return get_keys(_table);
+	return get_keys(*_table);
 }
 
 std::vector<double> CoolingTable::get_temperatures()
 {
-	return get_keys(std::begin(_table)->second);
+	return get_keys(std::begin(*_table)->second);
 }
 
 std::vector<double> CoolingTable::get_lambda()
 {
 	std::vector<double> lambda_values;
-	for(auto &metallicity_measurement: _table) {
+	for(auto &metallicity_measurement: *_table) {
 		for(auto &t_record: metallicity_measurement.second) {
 			lambda_values.push_back(t_record.second);
 		}
@@ -94,7 +98,7 @@ GasCoolingParameters::GasCoolingParameters(const Options &options)
 	options.load("gas_cooling.pre_enrich_z", pre_enrich_z);
 	options.load("gas_cooling.tau_cooling", tau_cooling);
 
-	auto cooling_tables_dir = get_static_data_filepath("cooling");
+	std::string cooling_tables_dir = "cooling";
 	tables_idx metallicity_tables = find_tables(cooling_tables_dir);
 	load_tables(cooling_tables_dir, metallicity_tables);
 
@@ -121,8 +125,8 @@ GasCoolingParameters::tables_idx GasCoolingParameters::find_tables(
 	LOG(debug) << "Reading metallicity table index" << tables;
 	string line;
 	map<double, string> metallicity_tables;
-	ifstream f = open_file(tables);
-	while ( getline(f, line) ) {
+	auto f = open_static_data(tables);
+	while ( getline(*f, line) ) {
 
 		trim(line);
 		if (empty_or_comment(line)) {
@@ -137,7 +141,6 @@ GasCoolingParameters::tables_idx GasCoolingParameters::find_tables(
 
 		metallicity_tables[metallicity] = table_fname;
 	}
-	f.close();
 
 	return metallicity_tables;
 }
@@ -155,11 +158,11 @@ void GasCoolingParameters::load_tables(
 
 		LOG(debug) << "Reading table " << fname << " for metallicity " << metallicity;
 
-		ifstream f = open_file(fname);
+		auto f = open_static_data(fname);
 		string line;
 
 		std::map<double, double> measurements;
-		while ( getline(f, line) ) {
+		while ( getline(*f, line) ) {
 
 			trim(line);
 			if (empty_or_comment(line)) {
@@ -172,7 +175,6 @@ void GasCoolingParameters::load_tables(
 
 			measurements[t] = logl;
 		}
-		f.close();
 
 		cooling_table.add_metallicity_measurements(metallicity, measurements);
 	}
@@ -226,16 +228,59 @@ GasCooling::GasCooling(GasCoolingParameters parameters,
 	darkmatterhalos(darkmatterhalos),
 	reincorporation(reincorporation),
 	environment(environment),
-	cooling_lambda_interpolator(parameters.cooling_table.get_temperatures(), parameters.cooling_table.get_metallicities(), parameters.cooling_table.get_lambda())
+	cooling_lambda_interpolator(std::make_shared<GridInterpolator>(parameters.cooling_table.get_temperatures(), parameters.cooling_table.get_metallicities(), parameters.cooling_table.get_lambda()))
 {
 	//no-opt
 }
 
 double GasCooling::cooling_rate(Subhalo &subhalo, Galaxy &galaxy, double z, double deltat) {
 
-	using namespace constants;
+	SHARK_PROFILE(GAS_COOLING);
+	cooling_inputs inputs;
+	if (!prepare_cooling(subhalo, galaxy, z, deltat, reionisation_threshold(z), inputs)) {
+		return 0;
+	}
+	cooling_functions(&inputs, 1);
+	return finish_cooling(subhalo, galaxy, z, deltat, inputs);
+}
 
-    double coolingrate = 0;
+void GasCooling::cooling_rates(const std::vector<std::pair<Subhalo *, Galaxy *>> &galaxies, double z, double deltat, double rates[]) {
+
+	SHARK_PROFILE(GAS_COOLING);
+
+	// Each subhalo's cooling only modifies the subhalo itself and its host
+	// halo, so each stage can run for all subhalos before the next one
+	auto vthresh = reionisation_threshold(z);
+	batch_inputs.clear();
+	batch_indices.clear();
+	for (std::size_t k = 0; k != galaxies.size(); k++) {
+		rates[k] = 0;
+		cooling_inputs inputs;
+		if (prepare_cooling(*galaxies[k].first, *galaxies[k].second, z, deltat, vthresh, inputs)) {
+			batch_inputs.push_back(inputs);
+			batch_indices.push_back(k);
+		}
+	}
+
+	cooling_functions(batch_inputs.data(), batch_inputs.size());
+
+	for (std::size_t i = 0; i != batch_inputs.size(); i++) {
+		auto k = batch_indices[i];
+		rates[k] = finish_cooling(*galaxies[k].first, *galaxies[k].second, z, deltat, batch_inputs[i]);
+	}
+}
+
+double GasCooling::reionisation_threshold(double z) {
+	if (z != reionisation_z) {
+		reionisation_vthresh = reionisation->velocity_threshold(z);
+		reionisation_z = z;
+	}
+	return reionisation_vthresh;
+}
+
+bool GasCooling::prepare_cooling(Subhalo &subhalo, Galaxy &galaxy, double z, double deltat, double vthresh, cooling_inputs &inputs) {
+
+	using namespace constants;
 
     //Define host halo
     auto halo = subhalo.host_halo;
@@ -253,7 +298,7 @@ double GasCooling::cooling_rate(Subhalo &subhalo, Galaxy &galaxy, double z, doub
 
     // If galaxy is type 2, then they don't have a hot halo.
     if ( galaxy.galaxy_type == Galaxy::TYPE2) {
-    	return 0;
+    	return false;
     }
 
     // Define main galaxy, which would accrete the cooled gas if any.
@@ -261,7 +306,7 @@ double GasCooling::cooling_rate(Subhalo &subhalo, Galaxy &galaxy, double z, doub
 
     // If subhalo does not have a main galaxy (which could happen in satellite subhalos), or subhalo does not have a hot halo, return 0.
     if(subhalo.hot_halo_gas.mass <= 0){
-    	return 0;
+    	return false;
     }
 
     // Include accreted gas only if the subhalo is central.
@@ -289,10 +334,10 @@ double GasCooling::cooling_rate(Subhalo &subhalo, Galaxy &galaxy, double z, doub
     /**
      * Test for subhalos that are affected by reionisation
      */
-    auto reionised_halo = reionisation->reionised_halo(subhalo.Vvir, z);
+    auto reionised_halo = subhalo.Vvir < vthresh;
 
     if(reionised_halo){
-    	return 0;
+    	return false;
     }
 
     // Calculate reincorporated mass and metals.
@@ -351,18 +396,58 @@ double GasCooling::cooling_rate(Subhalo &subhalo, Galaxy &galaxy, double z, doub
 	}
 
    	double Tvir   = 97.48*std::pow(vvir,2.0); //in K.
-   	double lgTvir = log10(Tvir); //in K.
+   	double lgTvir = darkmatterhalos->log_virial_temperature(subhalo); //in K.
 	double Rvir   = cosmology->comoving_to_physical_size(darkmatterhalos->halo_virial_radius(subhalo), z);//physical Mpc
+	inputs = cooling_inputs {mhot, mhot_ejec, mzhot, zhot, vvir, Tvir, lgTvir, Rvir, Ledd, 0, 0, 0};
+	return true;
+}
+
+void GasCooling::cooling_functions(cooling_inputs inputs[], std::size_t n) {
+
+	// Gathered into contiguous arrays for the batch interpolation
+	lgTvir_values.resize(n);
+	zhot_values.resize(n);
+	logl_values.resize(n);
+	for (std::size_t k = 0; k != n; k++) {
+		lgTvir_values[k] = inputs[k].lgTvir;
+		zhot_values[k] = inputs[k].zhot;
+	}
 
    	/**
-   	 * Calculates the cooling Lambda function for the metallicity and temperature of this halo.
+   	 * Calculates the cooling Lambda function for the metallicity and temperature of each halo.
    	 */
-   	double logl = cooling_lambda_interpolator.get(lgTvir, zhot); //in cgs
+	cooling_lambda_interpolator->get(lgTvir_values.data(), zhot_values.data(), logl_values.data(), n); //in cgs
 
-	/**
-	 * Calculate mean density for notional cooling profile.
-	 */
-	double nh_density  = mean_density(mhot, Rvir); //in units of cm^-3.
+	for (std::size_t k = 0; k != n; k++) {
+		auto &in = inputs[k];
+		in.logl = logl_values[k];
+
+		/**
+		 * Calculate mean density for notional cooling profile.
+		 */
+		in.nh_density = mean_density(in.mhot, in.Rvir); //in units of cm^-3.
+
+		// Only used by the BENSON10 model
+		in.tcool = cooling_time(in.Tvir, in.logl, in.nh_density); //cooling time at notional density in Gyr.
+	}
+}
+
+double GasCooling::finish_cooling(Subhalo &subhalo, Galaxy &galaxy, double z, double deltat, const cooling_inputs &inputs) {
+
+	using namespace constants;
+
+	auto halo = subhalo.host_halo;
+	Galaxy *central_galaxy = &galaxy;
+	double coolingrate = 0;
+
+	double mhot = inputs.mhot;
+	double mhot_ejec = inputs.mhot_ejec;
+	double mzhot = inputs.mzhot;
+	double vvir = inputs.vvir;
+	double Tvir = inputs.Tvir;
+	double Rvir = inputs.Rvir;
+	double Ledd = inputs.Ledd;
+	double logl = inputs.logl;
 
    	double tcool = 0;
    	double tcharac = 0;
@@ -385,22 +470,15 @@ double GasCooling::cooling_rate(Subhalo &subhalo, Galaxy &galaxy, double z, doub
    	 */
 
    	if(parameters.model == GasCoolingParameters::BENSON10){
-   		tcool = cooling_time(Tvir, logl,nh_density); //cooling time at notional density in Gyr.
+   		tcool = inputs.tcool; //cooling time at notional density in Gyr.
 
    		/**
-		 * Push back the cooling properties at this timestep.
+		 * Add the cooling properties at this timestep.
+		 * In the case of mass we convert back to comoving units.
 		 */
-   		subhalo.cooling_subhalo_tracking.tcooling.push_back(tcool);
-   		subhalo.cooling_subhalo_tracking.temp.push_back(Tvir);
-   		subhalo.cooling_subhalo_tracking.deltat.push_back(deltat);
-   		//In the case of mass we convert back to comoving units.
-   		subhalo.cooling_subhalo_tracking.mass.push_back(cosmology->physical_to_comoving_mass(mhot));
-
-   		double integral = 0.0;//will save integral(T*M/tcool)
+   		subhalo.cooling_subhalo_tracking.add(deltat, Tvir, cosmology->physical_to_comoving_mass(mhot), tcool);
 
-   		for(unsigned i=0;i<subhalo.cooling_subhalo_tracking.deltat.size();++i){
-   			integral += subhalo.cooling_subhalo_tracking.temp[i]*subhalo.cooling_subhalo_tracking.mass[i]/subhalo.cooling_subhalo_tracking.tcooling[i]*subhalo.cooling_subhalo_tracking.deltat[i];
-   		}
+   		double integral = subhalo.cooling_subhalo_tracking.integral;//integral(T*M/tcool)
    		tcharac = integral/(Tvir*mhot/tcool) *constants::GYR2S; //available time for cooling in seconds.
    	}
 
@@ -574,6 +652,7 @@ double GasCooling::cooling_rate(Subhalo &subhalo, Galaxy &galaxy, double z, doub
 	}
 
    	return coolingrate;
+   	return coolingrate;
 
 }
 
@@ -0,0 +1,166 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Implementation of CollectiveWriter class methods
+ */
+
+#include "config.h"
+#ifdef SHARK_MPI
+#include <mpi.h>
+#endif // SHARK_MPI
+
+#include "hdf5/collective_writer.h"
+#include "exceptions.h"
+#include "mpi_utils.h"
+
+// H5_HAVE_PARALLEL comes from the HDF5 headers
+#if defined(SHARK_MPI) && defined(H5_HAVE_PARALLEL)
+#define SHARK_HDF5_COLLECTIVE
+#endif
+
+
+namespace shark {
+
+namespace hdf5 {
+
+static
+H5::FileAccPropList _mpio_access()
+{
+	H5::FileAccPropList access_plist;
+#ifdef SHARK_HDF5_COLLECTIVE
+	H5Pset_fapl_mpio(access_plist.getId(), MPI_COMM_WORLD, MPI_INFO_NULL);
+#else
+	throw exception("shark was not compiled with MPI support against a parallel HDF5 library, cannot write files collectively");
+#endif // SHARK_HDF5_COLLECTIVE
+	return access_plist;
+}
+
+// The access properties are created once and never destroyed, so they are not
+// copied or released outside of a library_lock by the constructor below
+static
+const H5::FileAccPropList &_collective_access()
+{
+	library_lock lock;
+	static H5::FileAccPropList access_plist = _mpio_access();
+	return access_plist;
+}
+
+CollectiveWriter::CollectiveWriter(const std::string &filename, const std::vector<std::string> &distributed_paths) :
+	Writer(filename, _collective_access()),
+	distributed_paths(distributed_paths),
+	rank(mpi::rank())
+{
+}
+
+bool CollectiveWriter::supported()
+{
+#ifdef SHARK_HDF5_COLLECTIVE
+	return true;
+#else
+	return false;
+#endif // SHARK_HDF5_COLLECTIVE
+}
+
+bool CollectiveWriter::is_distributed(const std::string &name) const
+{
+	for (auto &path: distributed_paths) {
+		if (name == path || (name.size() > path.size() && name.compare(0, path.size(), path) == 0 && name[path.size()] == '/')) {
+			return true;
+		}
+	}
+	return false;
+}
+
+hsize_t CollectiveWriter::global_offset(hsize_t count) const
+{
+#ifdef SHARK_HDF5_COLLECTIVE
+	unsigned long long local = count, offset = 0;
+	MPI_Exscan(&local, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	return rank == 0 ? 0 : offset;
+#else
+	return 0;
+#endif // SHARK_HDF5_COLLECTIVE
+}
+
+hsize_t CollectiveWriter::replicated_size(hsize_t size) const
+{
+#ifdef SHARK_HDF5_COLLECTIVE
+	unsigned long long value = size;
+	MPI_Bcast(&value, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+	return value;
+#else
+	return size;
+#endif // SHARK_HDF5_COLLECTIVE
+}
+
+hsize_t CollectiveWriter::max_size(hsize_t size) const
+{
+#ifdef SHARK_HDF5_COLLECTIVE
+	unsigned long long value = size;
+	MPI_Allreduce(MPI_IN_PLACE, &value, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+	return value;
+#else
+	return size;
+#endif // SHARK_HDF5_COLLECTIVE
+}
+
+void CollectiveWriter::write_slice(const std::string &name, const H5::DataType &dataType, const H5::DataType &mem_dataType,
+	const void *values, int ndims, hsize_t rows, hsize_t width, const std::string &comment)
+{
+#ifdef SHARK_HDF5_COLLECTIVE
+	unsigned long long total = rows;
+	MPI_Allreduce(MPI_IN_PLACE, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	hsize_t offset = global_offset(rows);
+
+	// Like Writer, empty two-dimensional datasets are not written at all
+	if (ndims == 2 && total == 0) {
+		return;
+	}
+
+	const hsize_t dims[] = {total, width};
+	H5::DataSpace dataSpace(ndims, dims);
+	auto dataset = ensure_dataset(tokenize(name, "/"), dataType, dataSpace);
+	set_comment(dataset, comment);
+
+	// Processes without values still take part in the collective write
+	const hsize_t start[] = {offset, 0};
+	const hsize_t count[] = {rows, width};
+	H5::DataSpace memSpace(ndims, count);
+	if (rows == 0) {
+		static const char nothing = 0;
+		values = &nothing;
+		dataSpace.selectNone();
+		memSpace.selectNone();
+	}
+	else {
+		dataSpace.selectHyperslab(H5S_SELECT_SET, count, start);
+	}
+
+	H5::DSetMemXferPropList transfer_plist;
+	H5Pset_dxpl_mpio(transfer_plist.getId(), H5FD_MPIO_COLLECTIVE);
+	dataset.write(values, mem_dataType, memSpace, dataSpace, transfer_plist);
+#endif // SHARK_HDF5_COLLECTIVE
+}
+
+}  // namespace hdf5
+
+}  // namespace shark
@@ -37,11 +37,37 @@ namespace shark {
 
 namespace hdf5 {
 
+namespace {
+
+std::recursive_mutex &library_mutex()
+{
+	static std::recursive_mutex mutex;
+	return mutex;
+}
+
+}  // anonymous namespace
+
+library_lock::library_lock() :
+	lock(library_mutex())
+{
+	// no-op
+}
+
+// Files are opened in the constructors' body so the library is locked
 IOBase::IOBase(const string &filename, unsigned int flags) :
-	hdf5_file(filename, flags),
+	hdf5_file(),
 	opened(true)
 {
-	// no-op
+	library_lock lock;
+	hdf5_file = H5::H5File(filename, flags);
+}
+
+IOBase::IOBase(const string &filename, unsigned int flags, const H5::FileAccPropList &access_plist) :
+	hdf5_file(),
+	opened(true)
+{
+	library_lock lock;
+	hdf5_file = H5::H5File(filename, flags, H5::FileCreatPropList::DEFAULT, access_plist);
 }
 
 IOBase::IOBase() :
@@ -53,6 +79,7 @@ IOBase::IOBase() :
 
 IOBase::~IOBase()
 {
+	library_lock lock;
 	close();
 }
 
@@ -62,17 +89,20 @@ void IOBase::close()
 		return;
 	}
 
+	library_lock lock;
 	hdf5_file.close();
 	opened = false;
 }
 
 void IOBase::open_file(const std::string &filename, unsigned int flags)
 {
+	library_lock lock;
 	hdf5_file = H5::H5File(filename, flags);
 }
 
 const string IOBase::get_filename() const
 {
+	library_lock lock;
 	return hdf5_file.getFileName();
 }
 
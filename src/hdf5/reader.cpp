@@ -32,6 +32,7 @@
 
 #include "exceptions.h"
 #include "logging.h"
+#include "utils.h"
 #include "hdf5/reader.h"
 
 using namespace std;
@@ -115,6 +116,115 @@ H5::Attribute Reader::get_attribute(const string &name) const
 	}
 }
 
+bool Reader::exists(const std::string &name) const
+{
+	library_lock lock;
+	// Each part of the path needs to be checked in turn,
+	// as H5Lexists fails when intermediate links don't exist
+	std::string path;
+	for (auto &part: tokenize(name, "/")) {
+		path += "/" + part;
+		if (H5Lexists(hdf5_file.getId(), path.c_str(), H5P_DEFAULT) <= 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+hsize_t Reader::get_dataset_rows(const std::string &name) const
+{
+	library_lock lock;
+	H5::DataSpace space = get_dataset(name).getSpace();
+	if (space.getSimpleExtentNdims() < 1) {
+		std::ostringstream os;
+		os << "Dataset " << name << " in " << get_filename() << " has no rows";
+		throw invalid_data(os.str());
+	}
+	std::vector<hsize_t> dim_sizes(space.getSimpleExtentNdims());
+	space.getSimpleExtentDims(dim_sizes.data(), NULL);
+	return dim_sizes[0];
+}
+
+std::vector<hsize_t> Reader::get_dataset_dimensions(const std::string &name) const
+{
+	library_lock lock;
+	H5::DataSpace space = get_dataset(name).getSpace();
+	std::vector<hsize_t> dim_sizes(space.getSimpleExtentNdims());
+	space.getSimpleExtentDims(dim_sizes.data(), NULL);
+	return dim_sizes;
+}
+
+bool Reader::is_numeric_dataset(const std::string &name) const
+{
+	library_lock lock;
+	auto type_class = get_dataset(name).getTypeClass();
+	return type_class == H5T_INTEGER || type_class == H5T_FLOAT;
+}
+
+static void _get_dataset_names(const CommonFG &file_or_group, const std::string &prefix, std::vector<std::string> &names)
+{
+	auto n_objs = file_or_group.getNumObjs();
+	for (hsize_t i = 0; i < n_objs; i++) {
+		auto objname = file_or_group.getObjnameByIdx(i);
+		auto objtype = file_or_group.getObjTypeByIdx(i);
+		if (objtype == H5G_GROUP) {
+			_get_dataset_names(file_or_group.openGroup(objname), prefix + objname + "/", names);
+		}
+		else if (objtype == H5G_DATASET) {
+			names.push_back(prefix + objname);
+		}
+	}
+}
+
+std::vector<std::string> Reader::get_dataset_names() const
+{
+	library_lock lock;
+	std::vector<std::string> names;
+	_get_dataset_names(hdf5_file, "", names);
+	return names;
+}
+
+hsize_t Reader::select_rows(H5::DataSpace &space, const std::vector<row_range> &rows, int column) const
+{
+	// Selections span all columns of the selected rows, unless a single
+	// column is requested
+	auto ndims = space.getSimpleExtentNdims();
+	std::vector<hsize_t> dim_sizes(ndims);
+	space.getSimpleExtentDims(dim_sizes.data(), NULL);
+	std::vector<hsize_t> offsets(ndims, 0);
+	std::vector<hsize_t> counts(dim_sizes);
+	if (column >= 0) {
+		if (ndims != 2 || hsize_t(column) >= dim_sizes[1]) {
+			std::ostringstream os;
+			os << "Column " << column << " doesn't exist in a dataset of " << get_filename();
+			throw invalid_argument(os.str());
+		}
+		offsets[1] = column;
+		counts[1] = 1;
+	}
+
+	space.selectNone();
+	hsize_t selected = 0;
+	hsize_t end = 0;
+	for (auto &range: rows) {
+		if (range.first < end || range.first > dim_sizes[0] || range.count > dim_sizes[0] - range.first) {
+			std::ostringstream os;
+			os << "Rows [" << range.first << ", " << range.first + range.count << ") are out of the bounds of a dataset in ";
+			os << get_filename() << ", which has " << dim_sizes[0] << " rows, or overlap with previous rows";
+			throw invalid_argument(os.str());
+		}
+		end = range.first + range.count;
+		if (range.count == 0) {
+			continue;
+		}
+		offsets[0] = range.first;
+		counts[0] = range.count;
+		space.selectHyperslab(selected == 0 ? H5S_SELECT_SET : H5S_SELECT_OR, counts.data(), offsets.data());
+		selected += range.count;
+	}
+	return selected;
+}
+
 }  // namespace hdf5
 
 }  // namespace shark
\ No newline at end of file
@@ -23,12 +23,28 @@
  * Implementation of Writer class methods
  */
 
+#include <algorithm>
 #include <sstream>
 #include <utility>
 
+#include "config.h"
+
+#ifdef SHARK_ZLIB
+#include <zlib.h>
+#endif // SHARK_ZLIB
+
 #include "hdf5/writer.h"
 #include "exceptions.h"
 #include "logging.h"
+#include "omp_utils.h"
+
+// H5Dwrite_chunk, which we use to write chunks compressed by ourselves,
+// was introduced in 1.10.3
+#if defined(SHARK_ZLIB) && HDF5_VERSION_MAJOR == 1 && \
+     (HDF5_VERSION_MINOR > 10 || \
+      (HDF5_VERSION_MINOR == 10 && HDF5_VERSION_PATCH >= 3))
+#define SHARK_HDF5_WRITE_CHUNKS
+#endif
 
 
 namespace shark {
@@ -47,6 +63,34 @@ Writer::Writer(const std::string &filename, bool overwrite,
 {
 }
 
+Writer::Writer(const std::string &filename, const H5::FileAccPropList &access_plist) :
+	IOBase(filename, H5F_ACC_TRUNC, access_plist),
+	group_naming_convention(naming_convention::SNAKE_CASE),
+	dataset_naming_convention(naming_convention::SNAKE_CASE),
+	attr_naming_convention(naming_convention::SNAKE_CASE)
+{
+}
+
+// The registered identifier of the HDF5 LZ4 filter plugin
+static const H5Z_filter_t H5Z_FILTER_LZ4 = 32004;
+
+// Chunk size used when compressing datasets without an explicit chunk size
+static const unsigned int DEFAULT_CHUNK_SIZE = 65536;
+
+void Writer::set_storage(const dataset_storage &storage)
+{
+	library_lock lock;
+	this->storage = storage;
+	if (storage.compression == dataset_storage::LZ4 && H5Zfilter_avail(H5Z_FILTER_LZ4) <= 0) {
+		static bool warned = false;
+		if (!warned) {
+			LOG(warning) << "HDF5 LZ4 filter is not available, datasets will be compressed with DEFLATE instead";
+			warned = true;
+		}
+		this->storage.compression = dataset_storage::DEFLATE;
+	}
+}
+
 static
 void _check_entity_name(const std::string &name, const char *entity_type, naming_convention convention)
 {
@@ -108,9 +152,9 @@ H5::Group create_entity<H5G_GROUP>(const HDF5_FILE_GROUP_COMMON_BASE &file_or_gr
 }
 
 template <> inline
-H5::DataSet create_entity<H5G_DATASET>(const HDF5_FILE_GROUP_COMMON_BASE &file_or_group, const std::string &name, const H5::DataType &dataType, const H5::DataSpace &dataSpace)
+H5::DataSet create_entity<H5G_DATASET>(const HDF5_FILE_GROUP_COMMON_BASE &file_or_group, const std::string &name, const H5::DataType &dataType, const H5::DataSpace &dataSpace, const H5::DSetCreatPropList &plist)
 {
-	return file_or_group.createDataSet(name, dataType, dataSpace);
+	return file_or_group.createDataSet(name, dataType, dataSpace, plist);
 }
 
 template <H5G_obj_t E, typename ... Ts>
@@ -158,16 +202,159 @@ H5::Group Writer::ensure_group(const std::vector<std::string> &path) const
 
 H5::DataSet Writer::ensure_dataset(const std::vector<std::string> &path, const H5::DataType &dataType, const H5::DataSpace &dataSpace) const
 {
+	const H5::DSetCreatPropList plist = creation_properties(dataType, dataSpace);
 	if (path.size() == 1) {
 		check_dataset_name(path[0]);
-		return ensure_entity<H5G_DATASET>(hdf5_file, path[0], dataType, dataSpace);
+		return ensure_entity<H5G_DATASET>(hdf5_file, path[0], dataType, dataSpace, plist);
 	}
 
 	std::vector<std::string> group_paths(path.begin(), path.end() - 1);
 	auto &dataset_name = path.back();
 	check_dataset_name(dataset_name);
 	H5::Group group = ensure_group(group_paths);
-	return ensure_entity<H5G_DATASET>(group, dataset_name, dataType, dataSpace);
+	return ensure_entity<H5G_DATASET>(group, dataset_name, dataType, dataSpace, plist);
+}
+
+H5::DSetCreatPropList Writer::creation_properties(const H5::DataType &dataType, const H5::DataSpace &dataSpace) const
+{
+	H5::DSetCreatPropList plist;
+	if (storage.chunk_size == 0 && storage.compression == dataset_storage::NONE) {
+		return plist;
+	}
+
+	// Scalars, strings and empty datasets are left contiguous
+	if (dataSpace.getSimpleExtentType() != H5S_SIMPLE || dataType.getClass() == H5T_STRING) {
+		return plist;
+	}
+	int rank = dataSpace.getSimpleExtentNdims();
+	std::vector<hsize_t> dims(rank);
+	dataSpace.getSimpleExtentDims(dims.data());
+	if (rank == 0 || std::find(dims.begin(), dims.end(), hsize_t(0)) != dims.end()) {
+		return plist;
+	}
+
+	// Chunks span whole rows, and as many of them as fit in the chunk size
+	hsize_t chunk_size = storage.chunk_size == 0 ? DEFAULT_CHUNK_SIZE : storage.chunk_size;
+	hsize_t row_size = 1;
+	for (int i = 1; i < rank; i++) {
+		row_size *= dims[i];
+	}
+	std::vector<hsize_t> chunk_dims(dims);
+	chunk_dims[0] = std::max(hsize_t(1), std::min(dims[0], chunk_size / row_size));
+	plist.setChunk(rank, chunk_dims.data());
+
+	if (storage.compression == dataset_storage::NONE) {
+		return plist;
+	}
+	if (storage.shuffle) {
+		plist.setShuffle();
+	}
+	if (storage.compression == dataset_storage::LZ4) {
+		plist.setFilter(H5Z_FILTER_LZ4, H5Z_FLAG_MANDATORY);
+	}
+	else {
+		plist.setDeflate(storage.level);
+	}
+	return plist;
+}
+
+#ifdef SHARK_HDF5_WRITE_CHUNKS
+
+// Whether the filter pipeline of a dataset is exactly the one we apply
+// ourselves when compressing its chunks
+static
+bool _has_own_pipeline(const H5::DSetCreatPropList &plist, bool shuffle)
+{
+	std::vector<H5Z_filter_t> expected;
+	if (shuffle) {
+		expected.push_back(H5Z_FILTER_SHUFFLE);
+	}
+	expected.push_back(H5Z_FILTER_DEFLATE);
+
+	if (plist.getNfilters() != int(expected.size())) {
+		return false;
+	}
+	for (unsigned int i = 0; i < expected.size(); i++) {
+		unsigned int flags, config;
+		std::size_t n_values = 0;
+		if (H5Pget_filter2(plist.getId(), i, &flags, &n_values, nullptr, 0, nullptr, &config) != expected[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#endif // SHARK_HDF5_WRITE_CHUNKS
+
+bool Writer::write_chunks(const H5::DataSet &dataset, const H5::DataType &mem_dataType, const void *values, std::size_t value_size, hsize_t n_values) const
+{
+#ifndef SHARK_HDF5_WRITE_CHUNKS
+	return false;
+#else
+	if (storage.compression != dataset_storage::DEFLATE || storage.threads <= 1 || n_values == 0) {
+		return false;
+	}
+
+	// Only datasets we created ourselves, in the same type as the values
+	auto plist = dataset.getCreatePlist();
+	auto dataSpace = dataset.getSpace();
+	hsize_t dims, chunk_rows;
+	if (plist.getLayout() != H5D_CHUNKED || dataSpace.getSimpleExtentNdims() != 1 ||
+	    !_has_own_pipeline(plist, storage.shuffle) || !(dataset.getDataType() == mem_dataType)) {
+		return false;
+	}
+	dataSpace.getSimpleExtentDims(&dims);
+	plist.getChunk(1, &chunk_rows);
+	if (dims != n_values) {
+		return false;
+	}
+
+	// Chunks are shuffled and compressed in parallel, including the padding
+	// of the last one, and written in order afterwards, since HDF5 is serial
+	auto n_chunks = (n_values + chunk_rows - 1) / chunk_rows;
+	std::size_t chunk_bytes = chunk_rows * value_size;
+	std::vector<std::vector<Bytef>> chunks(n_chunks);
+	std::vector<int> errors(n_chunks, Z_OK);
+	const auto *bytes = static_cast<const Bytef *>(values);
+	omp_static_for(hsize_t(0), n_chunks, storage.threads, [&](hsize_t c, int thread_idx) {
+		auto first = c * chunk_rows;
+		auto rows = std::min(chunk_rows, n_values - first);
+		const Bytef *src = bytes + first * value_size;
+
+		std::vector<Bytef> raw(chunk_bytes, 0);
+		if (storage.shuffle) {
+			for (std::size_t i = 0; i < rows; i++) {
+				for (std::size_t b = 0; b < value_size; b++) {
+					raw[b * chunk_rows + i] = src[i * value_size + b];
+				}
+			}
+		}
+		else {
+			std::copy(src, src + rows * value_size, raw.begin());
+		}
+
+		auto &chunk = chunks[c];
+		uLongf compressed_size = compressBound(chunk_bytes);
+		chunk.resize(compressed_size);
+		errors[c] = compress2(chunk.data(), &compressed_size, raw.data(), chunk_bytes, storage.level);
+		chunk.resize(compressed_size);
+	});
+
+	for (hsize_t c = 0; c < n_chunks; c++) {
+		if (errors[c] != Z_OK) {
+			std::ostringstream os;
+			os << "Error while compressing chunk " << c << " of dataset " << dataset.getObjName() << ": zlib error " << errors[c];
+			throw exception(os.str());
+		}
+		hsize_t offset = c * chunk_rows;
+		if (H5Dwrite_chunk(dataset.getId(), H5P_DEFAULT, 0, &offset, chunks[c].size(), chunks[c].data()) < 0) {
+			std::ostringstream os;
+			os << "Error while writing chunk " << c << " of dataset " << dataset.getObjName();
+			throw exception(os.str());
+		}
+	}
+	return true;
+#endif // SHARK_HDF5_WRITE_CHUNKS
 }
 
 }  // namespace hdf5
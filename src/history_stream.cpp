@@ -0,0 +1,273 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * HistoryStream implementation
+ */
+
+#include <H5Cpp.h>
+
+#include "hdf5/iobase.h"
+#include "hdf5/traits.h"
+#include "history_stream.h"
+
+namespace shark {
+
+namespace {
+
+/// Chunk size of the streamed datasets, in number of elements
+const hsize_t CHUNK_SIZE = 1 << 16;
+
+const char *ROW_COLUMNS[] = {
+	"rows/sfr_disk",
+	"rows/sfr_bulge_mergers",
+	"rows/sfr_bulge_diskins",
+	"rows/sfr_z_disk",
+	"rows/sfr_z_bulge_mergers",
+	"rows/sfr_z_bulge_diskins"
+};
+
+template <typename T>
+void create_dataset(H5::H5File &file, const std::string &name)
+{
+	hsize_t size = 0;
+	hsize_t max_size = H5S_UNLIMITED;
+	H5::DataSpace space(1, &size, &max_size);
+	H5::DSetCreatPropList properties;
+	properties.setChunk(1, &CHUNK_SIZE);
+	file.createDataSet(name, hdf5::datatype_traits<T>::write_type, space, properties);
+}
+
+template <typename T>
+void append_dataset(H5::H5File &file, const std::string &name, const std::vector<T> &values)
+{
+	if (values.empty()) {
+		return;
+	}
+
+	auto dataset = file.openDataSet(name);
+	hsize_t offset;
+	dataset.getSpace().getSimpleExtentDims(&offset);
+	hsize_t count = values.size();
+	hsize_t new_size = offset + count;
+	dataset.extend(&new_size);
+
+	auto file_space = dataset.getSpace();
+	file_space.selectHyperslab(H5S_SELECT_SET, &count, &offset);
+	H5::DataSpace mem_space(1, &count);
+	dataset.write(values.data(), hdf5::datatype_traits<T>::native_type, mem_space, file_space);
+}
+
+template <typename T>
+std::vector<T> read_dataset(H5::H5File &file, const std::string &name)
+{
+	auto dataset = file.openDataSet(name);
+	auto space = dataset.getSpace();
+	hsize_t size;
+	space.getSimpleExtentDims(&size);
+	std::vector<T> values(size);
+	if (size > 0) {
+		dataset.read(values.data(), hdf5::datatype_traits<T>::native_type, space, space);
+	}
+	return values;
+}
+
+template <typename T, typename F>
+std::vector<T> column(const std::vector<HistoryEvent> &events, F &&f)
+{
+	std::vector<T> values;
+	values.reserve(events.size());
+	for (auto &event: events) {
+		values.push_back(f(event));
+	}
+	return values;
+}
+
+GalaxyHistory &history_of(HistoryStream::histories_t &histories, std::int64_t galaxy_id)
+{
+	auto it = histories.find(galaxy_id);
+	if (it == histories.end()) {
+		it = histories.emplace(galaxy_id, GalaxyHistory(galaxy_id)).first;
+	}
+	return it->second;
+}
+
+void replay(HistoryStream::histories_t &histories, const HistoryEvent &event)
+{
+	auto &history = history_of(histories, event.galaxy_id);
+	switch (event.type) {
+	case HistoryEvent::DISK_TO_BULGE_DISKINS:
+		history.transfer_disk_to_bulge_diskins(event.first_snapshot, event.last_snapshot);
+		break;
+	case HistoryEvent::DISK_TO_BULGE_MERGERS:
+		history.transfer_disk_to_bulge_mergers(event.first_snapshot, event.last_snapshot);
+		break;
+	case HistoryEvent::SATELLITE_TO_BULGE_MERGERS:
+		history.transfer_satellite_to_bulge_mergers(history_of(histories, event.satellite_id), event.first_snapshot, event.last_snapshot);
+		break;
+	}
+}
+
+}  // namespace
+
+HistoryStream::HistoryStream(const std::string &filename) :
+	filename(filename)
+{
+	// no-op
+}
+
+HistoryStream::~HistoryStream()
+{
+	hdf5::library_lock lock;
+	file.reset();
+}
+
+HistoryStream::snapshot_block HistoryStream::collect(int snapshot, const std::vector<HaloPtr> &halos)
+{
+	snapshot_block block;
+	block.snapshot = snapshot;
+	for (auto &halo: halos) {
+		for (auto &subhalo: halo->subhalos()) {
+			for (auto &galaxy: subhalo->galaxies) {
+				auto &history = galaxy->history;
+				history.set_streamed();
+				for (auto &item: history.items()) {
+					block.galaxy_ids.push_back(galaxy->id);
+					block.items.push_back(item);
+				}
+				auto events = history.take_events();
+				block.events.insert(block.events.end(), events.begin(), events.end());
+				history.clear();
+			}
+		}
+	}
+	return block;
+}
+
+void HistoryStream::append(const snapshot_block &block)
+{
+	hdf5::library_lock lock;
+	if (!file) {
+		file.reset(new H5::H5File(filename, H5F_ACC_TRUNC));
+		file->createGroup("rows");
+		file->createGroup("events");
+		file->createGroup("index");
+		create_dataset<std::int64_t>(*file, "rows/galaxy_id");
+		create_dataset<int>(*file, "rows/snapshot");
+		for (auto name: ROW_COLUMNS) {
+			create_dataset<float>(*file, name);
+		}
+		create_dataset<int>(*file, "events/type");
+		create_dataset<int>(*file, "events/first_snapshot");
+		create_dataset<int>(*file, "events/last_snapshot");
+		create_dataset<std::int64_t>(*file, "events/galaxy_id");
+		create_dataset<std::int64_t>(*file, "events/satellite_id");
+		create_dataset<int>(*file, "index/snapshot");
+		create_dataset<std::int64_t>(*file, "index/row_offset");
+		create_dataset<std::int64_t>(*file, "index/event_offset");
+	}
+
+	append_dataset(*file, "index/snapshot", std::vector<int>{block.snapshot});
+	append_dataset(*file, "index/row_offset", std::vector<std::int64_t>{n_rows});
+	append_dataset(*file, "index/event_offset", std::vector<std::int64_t>{n_events});
+
+	append_dataset(*file, "rows/galaxy_id", block.galaxy_ids);
+	std::vector<int> snapshots;
+	std::vector<float> columns[GalaxyHistory::N_COLUMNS];
+	for (auto &item: block.items) {
+		snapshots.push_back(item.snapshot);
+		columns[GalaxyHistory::SFR_DISK].push_back(item.sfr_disk);
+		columns[GalaxyHistory::SFR_BULGE_MERGERS].push_back(item.sfr_bulge_mergers);
+		columns[GalaxyHistory::SFR_BULGE_DISKINS].push_back(item.sfr_bulge_diskins);
+		columns[GalaxyHistory::SFR_Z_DISK].push_back(item.sfr_z_disk);
+		columns[GalaxyHistory::SFR_Z_BULGE_MERGERS].push_back(item.sfr_z_bulge_mergers);
+		columns[GalaxyHistory::SFR_Z_BULGE_DISKINS].push_back(item.sfr_z_bulge_diskins);
+	}
+	append_dataset(*file, "rows/snapshot", snapshots);
+	for (int col = 0; col != GalaxyHistory::N_COLUMNS; col++) {
+		append_dataset(*file, ROW_COLUMNS[col], columns[col]);
+	}
+
+	auto &events = block.events;
+	append_dataset(*file, "events/type", column<int>(events, [](const HistoryEvent &e) { return e.type; }));
+	append_dataset(*file, "events/first_snapshot", column<int>(events, [](const HistoryEvent &e) { return e.first_snapshot; }));
+	append_dataset(*file, "events/last_snapshot", column<int>(events, [](const HistoryEvent &e) { return e.last_snapshot; }));
+	append_dataset(*file, "events/galaxy_id", column<std::int64_t>(events, [](const HistoryEvent &e) { return e.galaxy_id; }));
+	append_dataset(*file, "events/satellite_id", column<std::int64_t>(events, [](const HistoryEvent &e) { return e.satellite_id; }));
+
+	n_rows += block.items.size();
+	n_events += events.size();
+	file->flush(H5F_SCOPE_LOCAL);
+}
+
+HistoryStream::histories_t HistoryStream::assemble(const std::vector<std::int64_t> &galaxy_ids)
+{
+	histories_t histories;
+
+	hdf5::library_lock lock;
+	if (file) {
+		auto row_offsets = read_dataset<std::int64_t>(*file, "index/row_offset");
+		auto event_offsets = read_dataset<std::int64_t>(*file, "index/event_offset");
+		row_offsets.push_back(n_rows);
+		event_offsets.push_back(n_events);
+
+		auto ids = read_dataset<std::int64_t>(*file, "rows/galaxy_id");
+		auto snapshots = read_dataset<int>(*file, "rows/snapshot");
+		std::vector<float> columns[GalaxyHistory::N_COLUMNS];
+		for (int col = 0; col != GalaxyHistory::N_COLUMNS; col++) {
+			columns[col] = read_dataset<float>(*file, ROW_COLUMNS[col]);
+		}
+
+		auto types = read_dataset<int>(*file, "events/type");
+		auto first_snapshots = read_dataset<int>(*file, "events/first_snapshot");
+		auto last_snapshots = read_dataset<int>(*file, "events/last_snapshot");
+		auto event_galaxy_ids = read_dataset<std::int64_t>(*file, "events/galaxy_id");
+		auto satellite_ids = read_dataset<std::int64_t>(*file, "events/satellite_id");
+
+		// Transfers recorded during a snapshot act on the items of previous
+		// snapshots, so they are replayed before the snapshot's own items
+		for (std::size_t block = 0; block + 1 < row_offsets.size(); block++) {
+			for (auto i = event_offsets[block]; i != event_offsets[block + 1]; i++) {
+				replay(histories, {types[i], first_snapshots[i], last_snapshots[i], event_galaxy_ids[i], satellite_ids[i]});
+			}
+			for (auto i = row_offsets[block]; i != row_offsets[block + 1]; i++) {
+				history_of(histories, ids[i]).add({
+					columns[GalaxyHistory::SFR_DISK][i],
+					columns[GalaxyHistory::SFR_BULGE_MERGERS][i],
+					columns[GalaxyHistory::SFR_BULGE_DISKINS][i],
+					columns[GalaxyHistory::SFR_Z_DISK][i],
+					columns[GalaxyHistory::SFR_Z_BULGE_MERGERS][i],
+					columns[GalaxyHistory::SFR_Z_BULGE_DISKINS][i],
+					snapshots[i]
+				});
+			}
+		}
+	}
+
+	histories_t result;
+	for (auto galaxy_id: galaxy_ids) {
+		result.emplace(galaxy_id, std::move(history_of(histories, galaxy_id)));
+	}
+	return result;
+}
+
+}  // namespace shark
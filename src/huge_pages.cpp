@@ -0,0 +1,171 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Implementation of huge page allocations
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+# include <sys/mman.h>
+#endif // __linux__
+
+#include "huge_pages.h"
+
+namespace shark {
+namespace huge_pages {
+
+namespace {
+
+std::atomic<bool> huge_pages_enabled {false};
+std::atomic<std::size_t> explicit_huge_bytes {0};
+
+std::size_t round_up(std::size_t size)
+{
+	return (size + page_size - 1) / page_size * page_size;
+}
+
+#ifdef __linux__
+char *map_anonymous(std::size_t size, int flags)
+{
+	void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+	return addr == MAP_FAILED ? nullptr : static_cast<char *>(addr);
+}
+
+/// Maps @p size bytes aligned to huge pages, so that all of them can be
+/// backed by transparent huge pages
+char *map_aligned(std::size_t size)
+{
+	auto mapped = map_anonymous(size + page_size, 0);
+	if (!mapped) {
+		return nullptr;
+	}
+	auto address = reinterpret_cast<std::uintptr_t>(mapped);
+	auto head = (page_size - address % page_size) % page_size;
+	auto tail = page_size - head;
+	if (head) {
+		munmap(mapped, head);
+	}
+	if (tail) {
+		munmap(mapped + head + size, tail);
+	}
+	return mapped + head;
+}
+#endif // __linux__
+
+}  // anonymous namespace
+
+void enable(bool enabled)
+{
+	huge_pages_enabled = enabled;
+}
+
+bool enabled()
+{
+	return huge_pages_enabled;
+}
+
+block allocate(std::size_t size)
+{
+#ifdef __linux__
+	if (enabled()) {
+		size = round_up(size);
+# ifdef MAP_HUGETLB
+		// Fails unless enough huge pages are reserved
+		if (auto data = map_anonymous(size, MAP_HUGETLB)) {
+			explicit_huge_bytes += size;
+			return {data, size, EXPLICIT};
+		}
+# endif // MAP_HUGETLB
+		if (auto data = map_aligned(size)) {
+# ifdef MADV_HUGEPAGE
+			madvise(data, size, MADV_HUGEPAGE);
+# endif // MADV_HUGEPAGE
+			return {data, size, TRANSPARENT};
+		}
+		throw std::bad_alloc();
+	}
+#endif // __linux__
+	return {new char[size], size, REGULAR};
+}
+
+void deallocate(const block &b)
+{
+	if (b.backed_by == REGULAR) {
+		delete[] b.data;
+		return;
+	}
+#ifdef __linux__
+	munmap(b.data, b.size);
+	if (b.backed_by == EXPLICIT) {
+		explicit_huge_bytes -= b.size;
+	}
+#endif // __linux__
+}
+
+void advise(void *ptr, std::size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	if (!enabled() || size < page_size) {
+		return;
+	}
+	auto address = reinterpret_cast<std::uintptr_t>(ptr);
+	auto start = (address + page_size - 1) / page_size * page_size;
+	auto end = (address + size) / page_size * page_size;
+	if (end > start) {
+		madvise(reinterpret_cast<void *>(start), end - start, MADV_HUGEPAGE);
+	}
+#endif // __linux__ && MADV_HUGEPAGE
+}
+
+std::size_t explicit_bytes()
+{
+	return explicit_huge_bytes;
+}
+
+std::size_t transparent_bytes()
+{
+#ifdef __linux__
+	// Sum of the AnonHugePages of all mappings, in [kB]
+	std::ifstream smaps("/proc/self/smaps_rollup");
+	std::string line;
+	while (std::getline(smaps, line)) {
+		if (line.compare(0, 14, "AnonHugePages:") == 0) {
+			std::istringstream is(line.substr(14));
+			std::size_t kilobytes;
+			if (is >> kilobytes) {
+				return kilobytes * 1024;
+			}
+		}
+	}
+#endif // __linux__
+	return 0;
+}
+
+}  // namespace huge_pages
+}  // namespace shark
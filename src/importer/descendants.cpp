@@ -23,7 +23,13 @@
  * Descendants-related class implementations
  */
 
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
 #include "exceptions.h"
+#include "mapped_file.h"
+#include "omp_utils.h"
 #include "utils.h"
 #include "hdf5/reader.h"
 #include "importer/descendants.h"
@@ -34,6 +40,14 @@ namespace shark {
 
 namespace importer {
 
+void descendants_columns::resize(size_t n)
+{
+	halo_id.resize(n);
+	halo_snapshot.resize(n);
+	descendant_id.resize(n);
+	descendant_snapshot.resize(n);
+}
+
 //
 // BaseDescendantReader methods follow
 //
@@ -50,37 +64,163 @@ DescendantReader::~DescendantReader()
 	// no-op
 }
 
+vector<descendants_data_t> DescendantReader::read_whole()
+{
+	auto columns = read_columns();
+	auto size = columns.size();
+
+	vector<descendants_data_t> descendants;
+	descendants.reserve(size);
+	for(size_t i = 0; i != size; i++) {
+		descendants_data_t desc = {
+			columns.halo_id[i],
+			columns.halo_snapshot[i],
+			columns.descendant_id[i],
+			columns.descendant_snapshot[i]
+		};
+		descendants.push_back(move(desc));
+	}
+
+	return descendants;
+}
+
 //
 // AsciiDescendantReader methods follow
 //
-AsciiDescendantReader::AsciiDescendantReader(const string &filename) :
-	DescendantReader(filename)
+namespace {
+
+// The beginning of the line following the one @p p is in
+const char *next_line(const char *p, const char *end)
+{
+	auto eol = static_cast<const char *>(memchr(p, '\n', end - p));
+	return eol ? eol + 1 : end;
+}
+
+bool is_blank(const char *p, const char *end)
+{
+	return all_of(p, end, [](char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	});
+}
+
+// Parses the integer starting at @p p (after any leading blanks),
+// leaving @p p just after it
+template <typename T>
+bool parse_integer(const char *&p, const char *end, T &value)
+{
+	while (p != end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+
+	bool negative = false;
+	if (p != end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+	if (p == end || *p < '0' || *p > '9') {
+		return false;
+	}
+
+	T v = 0;
+	for (; p != end && *p >= '0' && *p <= '9'; p++) {
+		v = v * 10 + (*p - '0');
+	}
+	value = negative ? -v : v;
+	return true;
+}
+
+}  // anonymous namespace
+
+AsciiDescendantReader::AsciiDescendantReader(const string &filename, unsigned int threads) :
+	DescendantReader(filename),
+	threads(threads)
 {
 	// no-op
 }
 
-vector<descendants_data_t> AsciiDescendantReader::read_whole()
+descendants_columns AsciiDescendantReader::read_columns()
 {
-	string line;
-	ifstream descendants_f = open_file(filename);
+	MappedFile file(filename);
+	const char *begin = file.data();
+	const char *end = begin + file.size();
 
-	// The first line tells us how many descendants there are
-	unsigned int nhalos;
-	getline(descendants_f, line);
-	istringstream linestream(line);
-	linestream >> nhalos;
+	// The first line tells us how many descendants there are, although we
+	// count them ourselves anyway to split the work
+	long nhalos;
+	const char *body = next_line(begin, end);
+	const char *p = begin;
+	if ( !parse_integer(p, body, nhalos) ) {
+		throw invalid_data("First line of " + filename + " doesn't contain the number of descendants");
+	}
 
-	// continue reading the rest and check if we'll need a final sorting
-	vector<descendants_data_t> descendants;
-	descendants.reserve(nhalos);
-	while ( getline(descendants_f, line) ) {
-		descendants_data_t desc;
-		istringstream linestream(line);
-		linestream >> desc.halo_id >> desc.halo_snapshot >> desc.descendant_id >> desc.descendant_snapshot;
-		descendants.push_back(move(desc));
+	// Split the rest in blocks of whole lines, one per thread
+	unsigned int n_blocks = max(threads, 1u);
+	vector<const char *> bounds(n_blocks + 1, end);
+	bounds[0] = body;
+	for(unsigned int block = 1; block < n_blocks; block++) {
+		const char *pos = body + (end - body) * block / n_blocks;
+		bounds[block] = max(bounds[block - 1], next_line(pos - 1, end));
 	}
 
-	return descendants;
+	// First count the descendants in each block so the columns can be
+	// preallocated, and each block knows where to write its own
+	vector<size_t> n_lines(n_blocks, 0);
+	vector<size_t> n_descendants(n_blocks, 0);
+	omp_static_for(0u, n_blocks, threads, [&](unsigned int block, int thread_idx) {
+		for(auto line = bounds[block]; line != bounds[block + 1];) {
+			auto next = next_line(line, bounds[block + 1]);
+			n_lines[block]++;
+			if ( !is_blank(line, next) ) {
+				n_descendants[block]++;
+			}
+			line = next;
+		}
+	});
+
+	vector<size_t> first_descendant(n_blocks + 1, 0);
+	for(unsigned int block = 0; block != n_blocks; block++) {
+		first_descendant[block + 1] = first_descendant[block] + n_descendants[block];
+	}
+
+	descendants_columns columns;
+	columns.resize(first_descendant[n_blocks]);
+
+	// Now parse them; errors are recorded as the line (within its block)
+	// they happened, and reported afterwards
+	vector<size_t> bad_line(n_blocks, string::npos);
+	omp_static_for(0u, n_blocks, threads, [&](unsigned int block, int thread_idx) {
+		auto i = first_descendant[block];
+		size_t line_idx = 0;
+		for(auto line = bounds[block]; line != bounds[block + 1]; line_idx++) {
+			auto next = next_line(line, bounds[block + 1]);
+			if ( is_blank(line, next) ) {
+				line = next;
+				continue;
+			}
+			if ( !parse_integer(line, next, columns.halo_id[i]) ||
+			     !parse_integer(line, next, columns.halo_snapshot[i]) ||
+			     !parse_integer(line, next, columns.descendant_id[i]) ||
+			     !parse_integer(line, next, columns.descendant_snapshot[i]) ) {
+				bad_line[block] = line_idx;
+				return;
+			}
+			i++;
+			line = next;
+		}
+	});
+
+	size_t line_number = 2;
+	for(unsigned int block = 0; block != n_blocks; block++) {
+		if ( bad_line[block] != string::npos ) {
+			ostringstream os;
+			os << "Line " << line_number + bad_line[block] << " of " << filename;
+			os << " doesn't contain a halo ID, halo snapshot, descendant ID and descendant snapshot";
+			throw invalid_data(os.str());
+		}
+		line_number += n_lines[block];
+	}
+
+	return columns;
 }
 
 //
@@ -93,46 +233,35 @@ HDF5DescendantReader::HDF5DescendantReader(const string &filename) :
 	// no-op
 }
 
-vector<descendants_data_t> HDF5DescendantReader::read_whole()
+descendants_columns HDF5DescendantReader::read_columns()
 {
 	hdf5::Reader reader(filename);
 
-	vector<long> halo_ids = reader.read_dataset_v<long>("Halo_IDs");
-	vector<int> halo_snaps = reader.read_dataset_v<int>("Halo_Snapshots");
-	vector<long> desc_ids = reader.read_dataset_v<long>("Descendant_IDs");
-	vector<int> desc_snaps = reader.read_dataset_v<int>("Descendant_Snapshots");
+	descendants_columns columns;
+	columns.halo_id = reader.read_dataset_v<long>("Halo_IDs");
+	columns.halo_snapshot = reader.read_dataset_v<int>("Halo_Snapshots");
+	columns.descendant_id = reader.read_dataset_v<long>("Descendant_IDs");
+	columns.descendant_snapshot = reader.read_dataset_v<int>("Descendant_Snapshots");
 
 	// Check that all sizes are the same
-	auto size = halo_ids.size();
-	if ( halo_snaps.size() != size ) {
+	auto size = columns.halo_id.size();
+	if ( columns.halo_snapshot.size() != size ) {
 		ostringstream os;
-		os << "Halo_Snapshots length != Halo_IDs length: " << size << " != " << halo_snaps.size();
+		os << "Halo_Snapshots length != Halo_IDs length: " << size << " != " << columns.halo_snapshot.size();
 		throw invalid_data(os.str());
 	}
-	if ( desc_ids.size() != size ) {
+	if ( columns.descendant_id.size() != size ) {
 		ostringstream os;
-		os << "Descendant_IDs length != Halo_IDs length: " << size << " != " << desc_ids.size();
+		os << "Descendant_IDs length != Halo_IDs length: " << size << " != " << columns.descendant_id.size();
 		throw invalid_data(os.str());
 	}
-	if ( desc_snaps.size() != size ) {
+	if ( columns.descendant_snapshot.size() != size ) {
 		ostringstream os;
-		os << "Descendant_Snapshots length != Halo_IDs length: " << size << " != " << desc_snaps.size();
+		os << "Descendant_Snapshots length != Halo_IDs length: " << size << " != " << columns.descendant_snapshot.size();
 		throw invalid_data(os.str());
 	}
 
-	vector<descendants_data_t> descendants;
-	descendants.reserve(size);
-	for(unsigned int i=0; i!=size; i++) {
-		descendants_data_t desc = {
-			halo_ids[i],
-			halo_snaps[i],
-			desc_ids[i],
-			desc_snaps[i]
-		};
-		descendants.push_back(move(desc));
-	}
-
-	return descendants;
+	return columns;
 }
 
 }  // namespace trees
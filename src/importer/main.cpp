@@ -22,13 +22,16 @@
 // MA 02111-1307  USA
 //
 
+#include <future>
 #include <iostream>
 #include <vector>
 #include <memory>
 
+#include "background_worker.h"
 #include "timer.h"
 #include "options.h"
 #include "importer/descendants.h"
+#include "importer/surfs.h"
 #include "importer/velociraptor.h"
 
 using namespace std;
@@ -49,7 +52,10 @@ public:
 		tree_format(TREES_VELOCIRAPTOR),
 		tree_dir("."),
 		first_snapshot(0),
-		last_snapshot(0)
+		last_snapshot(0),
+		tree_files_prefix("tree"),
+		chunk_size(65536),
+		threads(1)
 	{
 		options.load("input.tree_dir", tree_dir);
 		options.load("input.tree_format", tree_format);
@@ -57,6 +63,9 @@ public:
 		options.load("input.descendants", descendants_file);
 		options.load("input.first_snapshot", first_snapshot);
 		options.load("input.last_snapshot", last_snapshot);
+		options.load("output.tree_files_prefix", tree_files_prefix);
+		options.load("output.chunk_size", chunk_size);
+		options.load("execution.threads", threads);
 	}
 
 	enum tree_format_t {
@@ -70,6 +79,9 @@ public:
 	std::string tree_dir;
 	int first_snapshot;
 	int last_snapshot;
+	std::string tree_files_prefix;
+	unsigned int chunk_size;
+	unsigned int threads;
 };
 
 } // namespace importer
@@ -108,7 +120,7 @@ int run(int argc, char **argv)
 		descendants_reader = make_shared<HDF5DescendantReader>(importer_params.descendants_file);
 	}
 	else if ( importer_params.descendants_format == shark::Options::ASCII ) {
-		descendants_reader = make_shared<AsciiDescendantReader>(importer_params.descendants_file);
+		descendants_reader = make_shared<AsciiDescendantReader>(importer_params.descendants_file, importer_params.threads);
 	}
 
 	//
@@ -117,16 +129,46 @@ int run(int argc, char **argv)
 	if ( importer_params.tree_format != ImporterParameters::TREES_VELOCIRAPTOR ) {
 		throw invalid_option("Only tree format currently supported is VELOCIraptor");
 	}
-	unique_ptr<Reader> reader(new VELOCIraptorReader(descendants_reader, importer_params.tree_dir));
+	unique_ptr<Reader> reader(new VELOCIraptorReader(descendants_reader, importer_params.tree_dir, importer_params.threads));
 
 	//
-	// Go ahead and read all required snapshots
+	// HDF5 is not thread-safe, so all reading and writing happens in order
+	// in a single background thread, while the main thread converts the
+	// snapshot that was previously read. Snapshots go from last to first, as
+	// converting a snapshot requires information from its descendants.
 	//
+	SURFSWriter writer(importer_params.tree_files_prefix + ".0.hdf5", importer_params.chunk_size);
+	BackgroundWorker io_worker(3);
+
+	auto submit_read = [&](int snapshot) {
+		auto raw = make_shared<promise<unique_ptr<raw_snapshot>>>();
+		io_worker.submit([&reader, raw, snapshot]() {
+			try {
+				raw->set_value(reader->read_raw(snapshot));
+			}
+			catch (...) {
+				raw->set_exception(current_exception());
+			}
+		});
+		return raw->get_future();
+	};
+
+	auto next_raw = submit_read(importer_params.last_snapshot);
 	for(int snapshot=importer_params.last_snapshot; snapshot >= importer_params.first_snapshot; snapshot--) {
 		Timer timer;
-		auto subhalos = reader->read_subhalos(snapshot);
-		cout << "Snapshot " << snapshot << " read and processed in " << timer.get() << " [ms]" << endl;
+		auto raw = next_raw.get();
+		if ( snapshot > importer_params.first_snapshot ) {
+			next_raw = submit_read(snapshot - 1);
+		}
+
+		auto rows = make_shared<surfs_rows>(reader->convert(*raw));
+		auto n_subhalos = rows->size();
+		io_worker.submit([&writer, rows, snapshot]() {
+			writer.append(snapshot, *rows);
+		});
+		cout << "Snapshot " << snapshot << " with " << n_subhalos << " subhalos read and converted in " << timer.get() << " [ms]" << endl;
 	}
+	io_worker.wait();
 
 	return 0;
 }
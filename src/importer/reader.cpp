@@ -29,10 +29,20 @@ namespace shark {
 
 namespace importer {
 
+raw_snapshot::~raw_snapshot() {
+	// no-op
+}
+
 Reader::~Reader() {
 	// no-op
 }
 
+surfs_rows Reader::read_subhalos(int snapshot)
+{
+	auto raw = read_raw(snapshot);
+	return convert(*raw);
+}
+
 }  // namespace trees
 
 }  // namespace shark
\ No newline at end of file
@@ -0,0 +1,154 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * SURFS-layout rows and writer implementation
+ */
+
+#include <H5Cpp.h>
+
+#include "hdf5/iobase.h"
+#include "hdf5/traits.h"
+#include "importer/surfs.h"
+
+namespace shark {
+
+namespace importer {
+
+namespace {
+
+template <typename T>
+void create_dataset(H5::H5File &file, const std::string &name, hsize_t columns, hsize_t chunk_size)
+{
+	hsize_t size[2] = {0, columns};
+	hsize_t max_size[2] = {H5S_UNLIMITED, columns};
+	hsize_t chunk[2] = {chunk_size, columns};
+	int ndims = columns > 1 ? 2 : 1;
+	H5::DataSpace space(ndims, size, max_size);
+	H5::DSetCreatPropList properties;
+	properties.setChunk(ndims, chunk);
+	file.createDataSet(name, hdf5::datatype_traits<T>::write_type, space, properties);
+}
+
+template <typename T>
+void append_dataset(H5::H5File &file, const std::string &name, const std::vector<T> &values, hsize_t columns = 1)
+{
+	if (values.empty()) {
+		return;
+	}
+
+	auto dataset = file.openDataSet(name);
+	int ndims = columns > 1 ? 2 : 1;
+	hsize_t offset[2] = {0, 0};
+	dataset.getSpace().getSimpleExtentDims(offset);
+	hsize_t count[2] = {values.size() / columns, columns};
+	hsize_t new_size[2] = {offset[0] + count[0], columns};
+	dataset.extend(new_size);
+
+	hsize_t start[2] = {offset[0], 0};
+	auto file_space = dataset.getSpace();
+	file_space.selectHyperslab(H5S_SELECT_SET, count, start);
+	H5::DataSpace mem_space(ndims, count);
+	dataset.write(values.data(), hdf5::datatype_traits<T>::native_type, mem_space, file_space);
+}
+
+}  // anonymous namespace
+
+void surfs_rows::resize(std::size_t n)
+{
+	nodeIndex.resize(n);
+	descendantIndex.resize(n);
+	hostIndex.resize(n);
+	descendantHost.resize(n);
+	snapshotNumber.resize(n);
+	nodeMass.resize(n);
+	maximumCircularVelocity.resize(n);
+	position.resize(3 * n);
+	velocity.resize(3 * n);
+	angularMomentum.resize(3 * n);
+	isMainProgenitor.resize(n);
+	isDHaloCentre.resize(n);
+	isInterpolated.resize(n);
+}
+
+SURFSWriter::SURFSWriter(const std::string &filename, unsigned long chunk_size, unsigned int n_files)
+{
+	hdf5::library_lock lock;
+	file.reset(new H5::H5File(filename, H5F_ACC_TRUNC));
+	auto file_info = file->createGroup("fileInfo");
+	auto attribute = file_info.createAttribute("numberOfFiles", hdf5::datatype_traits<unsigned int>::write_type, H5::DataSpace(H5S_SCALAR));
+	attribute.write(hdf5::datatype_traits<unsigned int>::native_type, &n_files);
+
+	file->createGroup("haloTrees");
+	create_dataset<Subhalo::id_t>(*file, "haloTrees/nodeIndex", 1, chunk_size);
+	create_dataset<Subhalo::id_t>(*file, "haloTrees/descendantIndex", 1, chunk_size);
+	create_dataset<Halo::id_t>(*file, "haloTrees/hostIndex", 1, chunk_size);
+	create_dataset<Halo::id_t>(*file, "haloTrees/descendantHost", 1, chunk_size);
+	create_dataset<int>(*file, "haloTrees/snapshotNumber", 1, chunk_size);
+	create_dataset<float>(*file, "haloTrees/nodeMass", 1, chunk_size);
+	create_dataset<float>(*file, "haloTrees/maximumCircularVelocity", 1, chunk_size);
+	create_dataset<float>(*file, "haloTrees/position", 3, chunk_size);
+	create_dataset<float>(*file, "haloTrees/velocity", 3, chunk_size);
+	create_dataset<float>(*file, "haloTrees/angularMomentum", 3, chunk_size);
+	create_dataset<int>(*file, "haloTrees/isMainProgenitor", 1, chunk_size);
+	create_dataset<int>(*file, "haloTrees/isDHaloCentre", 1, chunk_size);
+	create_dataset<int>(*file, "haloTrees/isInterpolated", 1, chunk_size);
+
+	// The index has one entry per snapshot, so it needs only small chunks
+	file->createGroup("treeIndex");
+	create_dataset<int>(*file, "treeIndex/snapshotNumber", 1, 1024);
+	create_dataset<std::int64_t>(*file, "treeIndex/firstRow", 1, 1024);
+	create_dataset<std::int64_t>(*file, "treeIndex/numberOfRows", 1, 1024);
+}
+
+SURFSWriter::~SURFSWriter()
+{
+	hdf5::library_lock lock;
+	file.reset();
+}
+
+void SURFSWriter::append(int snapshot, const surfs_rows &rows)
+{
+	hdf5::library_lock lock;
+	append_dataset(*file, "haloTrees/nodeIndex", rows.nodeIndex);
+	append_dataset(*file, "haloTrees/descendantIndex", rows.descendantIndex);
+	append_dataset(*file, "haloTrees/hostIndex", rows.hostIndex);
+	append_dataset(*file, "haloTrees/descendantHost", rows.descendantHost);
+	append_dataset(*file, "haloTrees/snapshotNumber", rows.snapshotNumber);
+	append_dataset(*file, "haloTrees/nodeMass", rows.nodeMass);
+	append_dataset(*file, "haloTrees/maximumCircularVelocity", rows.maximumCircularVelocity);
+	append_dataset(*file, "haloTrees/position", rows.position, 3);
+	append_dataset(*file, "haloTrees/velocity", rows.velocity, 3);
+	append_dataset(*file, "haloTrees/angularMomentum", rows.angularMomentum, 3);
+	append_dataset(*file, "haloTrees/isMainProgenitor", rows.isMainProgenitor);
+	append_dataset(*file, "haloTrees/isDHaloCentre", rows.isDHaloCentre);
+	append_dataset(*file, "haloTrees/isInterpolated", rows.isInterpolated);
+
+	append_dataset(*file, "treeIndex/snapshotNumber", std::vector<int>{snapshot});
+	append_dataset(*file, "treeIndex/firstRow", std::vector<std::int64_t>{n_rows});
+	append_dataset(*file, "treeIndex/numberOfRows", std::vector<std::int64_t>{std::int64_t(rows.size())});
+	n_rows += rows.size();
+}
+
+}  // namespace importer
+
+}  // namespace shark
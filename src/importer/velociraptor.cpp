@@ -25,15 +25,15 @@
 
 #include <importer/velociraptor.h>
 #include <algorithm>
-#include <fstream>
-#include <iostream>
+#include <cstdint>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "exceptions.h"
-#include "utils.h"
+#include "omp_utils.h"
+#include "radix_sort.h"
 #include "hdf5/reader.h"
 
 using namespace std;
@@ -42,9 +42,32 @@ namespace shark {
 
 namespace importer {
 
-VELOCIraptorReader::VELOCIraptorReader(shared_ptr<DescendantReader> &reader, const string &trees_dir) :
+namespace {
+
+/// The VELOCIraptor columns of all the batches of a snapshot
+struct velociraptor_snapshot : public raw_snapshot {
+	vector<double> x, y, z;
+	vector<double> vx, vy, vz;
+	vector<double> mass;
+	vector<Subhalo::id_t> id;
+	vector<Subhalo::id_t> host_id;
+	vector<double> vmax;
+	vector<double> lx, ly, lz;
+};
+
+template <typename T>
+void append_column(vector<T> &column, hdf5::Reader &batch_file, const string &name)
+{
+	auto values = batch_file.read_dataset_v<T>(name);
+	column.insert(column.end(), values.begin(), values.end());
+}
+
+}  // anonymous namespace
+
+VELOCIraptorReader::VELOCIraptorReader(shared_ptr<DescendantReader> &reader, const string &trees_dir, unsigned int threads) :
 	Reader(),
-	trees_dir(trees_dir)
+	trees_dir(trees_dir),
+	threads(threads)
 {
 	if ( trees_dir.size() == 0 ) {
 		throw invalid_argument("Trees dir has no value");
@@ -52,10 +75,16 @@ VELOCIraptorReader::VELOCIraptorReader(shared_ptr<DescendantReader> &reader, con
 
 	// read all descendants info and put them into our internal map
 	// for quick lookup
-	auto descendants = reader->read_whole();
-
-	for(auto &&descendant: descendants) {
-		descendants_data[descendant.halo_id] = move(descendant);
+	auto descendants = reader->read_columns();
+
+	descendants_data.reserve(descendants.size());
+	for(size_t i = 0; i != descendants.size(); i++) {
+		descendants_data[descendants.halo_id[i]] = {
+			descendants.halo_id[i],
+			descendants.halo_snapshot[i],
+			descendants.descendant_id[i],
+			descendants.descendant_snapshot[i]
+		};
 	}
 }
 
@@ -66,7 +95,7 @@ const string VELOCIraptorReader::get_filename(int snapshot, int batch)
 	return os.str();
 }
 
-const vector<Subhalo> VELOCIraptorReader::read_subhalos(int snapshot)
+unique_ptr<raw_snapshot> VELOCIraptorReader::read_raw(int snapshot)
 {
 	unsigned int nbatches;
 
@@ -76,71 +105,123 @@ const vector<Subhalo> VELOCIraptorReader::read_subhalos(int snapshot)
 		nbatches = batchfile_0.read_dataset<unsigned int>("Num_of_files");
 	}
 
-	// read all batches and add them up to a single vector,
-	// which we then return
-	vector<Subhalo> subhalos;
+	// read all batches and add them up to a single set of columns
+	unique_ptr<velociraptor_snapshot> raw(new velociraptor_snapshot());
+	raw->snapshot = snapshot;
 	for(unsigned int batch=0; batch != nbatches; batch++) {
-		auto batch_subhalos = read_subhalos_batch(snapshot, batch);
-		subhalos.insert(subhalos.end(), batch_subhalos.begin(), batch_subhalos.end());
+
+		hdf5::Reader batch_file(get_filename(snapshot, batch));
+		auto n_subhalos = batch_file.read_dataset<unsigned int>("Num_of_groups");
+		if ( !n_subhalos ) {
+			continue;
+		}
+
+		append_column(raw->x, batch_file, "Xc");
+		append_column(raw->y, batch_file, "Yc");
+		append_column(raw->z, batch_file, "Zc");
+		append_column(raw->vx, batch_file, "VXc");
+		append_column(raw->vy, batch_file, "VYc");
+		append_column(raw->vz, batch_file, "VZc");
+		append_column(raw->mass, batch_file, "Mass_tot");
+		append_column(raw->id, batch_file, "ID");
+		append_column(raw->host_id, batch_file, "hostHaloID");
+		append_column(raw->vmax, batch_file, "Vmax");
+		append_column(raw->lx, batch_file, "Lx");
+		append_column(raw->ly, batch_file, "Ly");
+		append_column(raw->lz, batch_file, "Lz");
 	}
-	return subhalos;
+
+	return raw;
 }
 
-const vector<Subhalo> VELOCIraptorReader::read_subhalos_batch(int snapshot, int batch)
+surfs_rows VELOCIraptorReader::convert(raw_snapshot &raw_base)
 {
-	hdf5::Reader batch_file(get_filename(snapshot, batch));
-	auto n_subhalos = batch_file.read_dataset<unsigned int>("Num_of_groups");
-	if ( !n_subhalos ) {
-		return {};
-	}
-
-	vector<double> inx = batch_file.read_dataset_v<double>("Xc");
-	vector<double> iny = batch_file.read_dataset_v<double>("Yc");
-	vector<double> inz = batch_file.read_dataset_v<double>("Zc");
-	vector<double> invx = batch_file.read_dataset_v<double>("VXc");
-	vector<double> invy = batch_file.read_dataset_v<double>("VYc");
-	vector<double> invz = batch_file.read_dataset_v<double>("VZc");
-	vector<double> inbmass = batch_file.read_dataset_v<double>("Mass_tot");
-	vector<Subhalo::id_t> inhalo = batch_file.read_dataset_v<Subhalo::id_t>("ID");
-	vector<Subhalo::id_t> hhalo = batch_file.read_dataset_v<Subhalo::id_t>("hostHaloID");
-	vector<Subhalo::id_t> ID_mbp = batch_file.read_dataset_v<Subhalo::id_t>("ID_mbp");
-	vector<double> invmax = batch_file.read_dataset_v<double>("Vmax");
-	vector<double> r2 = batch_file.read_dataset_v<double>("R_HalfMass");
-	vector<double> v_dispersion = batch_file.read_dataset_v<double>("sigV");
-	vector<double> Lx = batch_file.read_dataset_v<double>("Lx");
-	vector<double> Ly = batch_file.read_dataset_v<double>("Ly");
-	vector<double> Lz = batch_file.read_dataset_v<double>("Lz");
-
-	vector<Subhalo> subhalos;
-	for(unsigned int i=0; i!=n_subhalos; i++) {
-
-		Subhalo subhalo(inhalo[i], snapshot);
-
-		//
-		// TODO: here we assign properties, etc
-		//
-
-		// Find the corresponding descendant information
-		auto it = descendants_data.find(subhalo.id);
+	auto &raw = dynamic_cast<velociraptor_snapshot &>(raw_base);
+	auto n_subhalos = raw.id.size();
+
+	surfs_rows rows;
+	rows.resize(n_subhalos);
+
+	// Look up the descendant of each subhalo and fill the plain columns;
+	// missing descendants are reported afterwards from a single thread
+	vector<char> missing(n_subhalos, 0);
+	omp_static_for(size_t(0), n_subhalos, threads, [&](size_t i, int thread_idx) {
+
+		auto id = raw.id[i];
+		auto host_id = raw.host_id[i];
+		rows.nodeIndex[i] = id;
+		rows.hostIndex[i] = (host_id == -1) ? id : host_id;
+		rows.isDHaloCentre[i] = (host_id == -1);
+		rows.isInterpolated[i] = 0;
+		rows.snapshotNumber[i] = raw.snapshot;
+		rows.nodeMass[i] = float(raw.mass[i]);
+		rows.maximumCircularVelocity[i] = float(raw.vmax[i]);
+		rows.position[3 * i] = float(raw.x[i]);
+		rows.position[3 * i + 1] = float(raw.y[i]);
+		rows.position[3 * i + 2] = float(raw.z[i]);
+		rows.velocity[3 * i] = float(raw.vx[i]);
+		rows.velocity[3 * i + 1] = float(raw.vy[i]);
+		rows.velocity[3 * i + 2] = float(raw.vz[i]);
+		rows.angularMomentum[3 * i] = float(raw.lx[i]);
+		rows.angularMomentum[3 * i + 1] = float(raw.ly[i]);
+		rows.angularMomentum[3 * i + 2] = float(raw.lz[i]);
+
+		auto it = descendants_data.find(id);
 		if( it == descendants_data.end() ) {
-			ostringstream os;
-			os << "No data could be found in the descendants file for subhalo id=" << subhalo.id;
-			throw invalid_data(os.str());
+			missing[i] = 1;
+			return;
 		}
+		rows.descendantIndex[i] = it->second.descendant_id;
+
+		// Descendants live in the previously converted (later) snapshot
+		auto host_it = hosts.find(it->second.descendant_id);
+		rows.descendantHost[i] = (host_it == hosts.end()) ? -1 : host_it->second;
+	});
+
+	auto missing_it = find(missing.begin(), missing.end(), 1);
+	if ( missing_it != missing.end() ) {
+		ostringstream os;
+		os << "No data could be found in the descendants file for subhalo id=" << raw.id[missing_it - missing.begin()];
+		throw invalid_data(os.str());
+	}
 
-		// Fill the missing bits
-		auto desc = it->second;
-		subhalo.descendant_id = desc.descendant_id;
-		subhalo.descendant_snapshot = desc.descendant_snapshot;
+	// The main progenitor of a descendant is its most massive progenitor.
+	// Grouping subhalos by descendant lets each group be scanned independently
+	vector<int64_t> keys(rows.descendantIndex.begin(), rows.descendantIndex.end());
+	auto order = radix_sort(keys, threads);
+	vector<size_t> group_starts;
+	for(size_t i = 0; i != n_subhalos; i++) {
+		if ( i == 0 || keys[i] != keys[i - 1] ) {
+			group_starts.push_back(i);
+		}
+	}
+	group_starts.push_back(n_subhalos);
+
+	omp_static_for(size_t(0), group_starts.size() - 1, threads, [&](size_t group, int thread_idx) {
+		auto main_progenitor = order[group_starts[group]];
+		for(auto i = group_starts[group]; i != group_starts[group + 1]; i++) {
+			auto idx = order[i];
+			rows.isMainProgenitor[idx] = 0;
+			if ( rows.nodeMass[idx] > rows.nodeMass[main_progenitor] ) {
+				main_progenitor = idx;
+			}
+		}
+		// Subhalos without a descendant are nobody's progenitor
+		if ( keys[group_starts[group]] >= 0 ) {
+			rows.isMainProgenitor[main_progenitor] = 1;
+		}
+	});
 
-		// Done, save it now
-		subhalos.push_back(move(subhalo));
+	// Remember the hosts of this snapshot for the next (earlier) one
+	hosts.clear();
+	hosts.reserve(n_subhalos);
+	for(size_t i = 0; i != n_subhalos; i++) {
+		hosts[rows.nodeIndex[i]] = rows.hostIndex[i];
 	}
 
-	return subhalos;
+	return rows;
 }
 
-
-}  // namespace trees
+}  // namespace importer
 
 }  // namespace shark
@@ -23,6 +23,13 @@
  * Integrator class implementation
  */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <gsl/gsl_errno.h>
+
+#include "exceptions.h"
 #include "integrator.h"
 
 
@@ -79,6 +86,228 @@ double Integrator::integrate(func_t f, void *params, double from, double to, dou
 	return result;
 }
 
+int Integrator::try_integrate(func_t f, void *params, double from, double to, double epsabs, double epsrel, double &result)
+{
+	gsl_function F;
+	F.function = f;
+	F.params = params;
+
+	scoped_gsl_error_suppression suppression;
+	double abserr;
+	int status = gsl_integration_qag(&F, from, to, epsabs, epsrel, max_intervals, GSL_INTEG_GAUSS15, workspace.get(), &result, &abserr);
+
+	num_intervals += workspace->size;
+	return status;
+}
+
+namespace {
+
+// Nodes and weights of the 15-point Kronrod rule and its embedded 7-point
+// Gauss rule, as used by GSL_INTEG_GAUSS15
+const double xgk[8] = {
+	0.991455371120812639206854697526329,
+	0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926,
+	0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013,
+	0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245,
+	0.000000000000000000000000000000000
+};
+
+const double wg[4] = {
+	0.129484966168869693270611432679082,
+	0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975,
+	0.417959183673469387755102040816327
+};
+
+const double wgk[8] = {
+	0.022935322010529224963732008058970,
+	0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518,
+	0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550,
+	0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649,
+	0.209482141084727828012999174891714
+};
+
+}  // namespace
+
+namespace detail {
+
+constexpr std::size_t gauss_kronrod21::n_points;
+
+const double gauss_kronrod21::xgk[11] = {
+	0.995657163025808080735527280689003,
+	0.973906528517171720077964012084452,
+	0.930157491355708226001207180059508,
+	0.865063366688984510732096688423493,
+	0.780817726586416897063717578345042,
+	0.679409568299024406234327365114874,
+	0.562757134668604683339000099272694,
+	0.433395394129247190799265943165784,
+	0.294392862701460198131126603103866,
+	0.148874338981631210884826001129720,
+	0.000000000000000000000000000000000
+};
+
+const double gauss_kronrod21::wg[5] = {
+	0.066671344308688137593568809893332,
+	0.149451349150580593145776339657697,
+	0.219086362515982043995534934228163,
+	0.269266719309996355091226921569469,
+	0.295524224714752870173892994651338
+};
+
+const double gauss_kronrod21::wgk[11] = {
+	0.011694638867371874278064396062192,
+	0.032558162307964727478818972459390,
+	0.054755896574351996031381300244580,
+	0.075039674810919952767043140916190,
+	0.093125454583697605535065465083366,
+	0.109387158802297641899210590325805,
+	0.123491976262065851077600525000668,
+	0.134709217311473325928054001771707,
+	0.142775938577060080797094273138717,
+	0.147739104901338491374841515972068,
+	0.149445554002916905664936468389821
+};
+
+// Same error estimation as GSL's
+double rescale_error(double err, double result_abs, double result_asc)
+{
+	err = std::abs(err);
+	if (result_asc != 0 && err != 0) {
+		double scale = std::pow(200 * err / result_asc, 1.5);
+		err = (scale < 1) ? result_asc * scale : result_asc;
+	}
+	constexpr auto eps = std::numeric_limits<double>::epsilon();
+	if (result_abs > std::numeric_limits<double>::min() / (50 * eps)) {
+		err = std::max(err, 50 * eps * result_abs);
+	}
+	return err;
+}
+
+}  // namespace detail
+
+void Integrator::gauss_kronrod(vector_func_t f, void *params, std::size_t n, double a, double b, double result[], double error[])
+{
+	// f_values holds the values at the center, and then at each point
+	// pair (x_i, -x_i) of the rule
+	const double center = (a + b) / 2;
+	const double half_length = (b - a) / 2;
+	f_values.resize(15 * n);
+	f(center, params, &f_values[0]);
+	for (std::size_t j = 0; j != 7; j++) {
+		double dx = half_length * xgk[j];
+		f(center - dx, params, &f_values[(1 + 2 * j) * n]);
+		f(center + dx, params, &f_values[(2 + 2 * j) * n]);
+	}
+
+	for (std::size_t c = 0; c != n; c++) {
+		double fc = f_values[c];
+		double result_gauss = fc * wg[3];
+		double result_kronrod = fc * wgk[7];
+		double result_abs = std::abs(result_kronrod);
+		for (std::size_t j = 0; j != 7; j++) {
+			double f1 = f_values[(1 + 2 * j) * n + c];
+			double f2 = f_values[(2 + 2 * j) * n + c];
+			if (j % 2 == 1) {
+				result_gauss += wg[j / 2] * (f1 + f2);
+			}
+			result_kronrod += wgk[j] * (f1 + f2);
+			result_abs += wgk[j] * (std::abs(f1) + std::abs(f2));
+		}
+
+		double mean = result_kronrod / 2;
+		double result_asc = wgk[7] * std::abs(fc - mean);
+		for (std::size_t j = 0; j != 7; j++) {
+			double f1 = f_values[(1 + 2 * j) * n + c];
+			double f2 = f_values[(2 + 2 * j) * n + c];
+			result_asc += wgk[j] * (std::abs(f1 - mean) + std::abs(f2 - mean));
+		}
+
+		result[c] = result_kronrod * half_length;
+		error[c] = detail::rescale_error((result_kronrod - result_gauss) * half_length,
+		                         result_abs * std::abs(half_length),
+		                         result_asc * std::abs(half_length));
+	}
+}
+
+void Integrator::integrate(vector_func_t f, void *params, std::size_t n, double from, double to, double epsabs, double epsrel, double result[])
+{
+	int status = try_integrate(f, params, n, from, to, epsabs, epsrel, result);
+	if (status != GSL_SUCCESS) {
+		throw gsl_error("maximum number of subdivisions reached", __FILE__, __LINE__, status, gsl_strerror(status));
+	}
+}
+
+int Integrator::try_integrate(vector_func_t f, void *params, std::size_t n, double from, double to, double epsabs, double epsrel, double result[])
+{
+	lower_bounds.assign(1, from);
+	upper_bounds.assign(1, to);
+	interval_results.resize(n);
+	interval_errors.resize(n);
+	gauss_kronrod(f, params, n, from, to, &interval_results[0], &interval_errors[0]);
+
+	std::vector<double> tolerances(n);
+	while (true) {
+
+		// Totals, and whether all components have converged
+		bool converged = true;
+		for (std::size_t c = 0; c != n; c++) {
+			double total = 0, total_error = 0;
+			for (std::size_t i = 0; i != lower_bounds.size(); i++) {
+				total += interval_results[i * n + c];
+				total_error += interval_errors[i * n + c];
+			}
+			result[c] = total;
+			tolerances[c] = std::max(epsabs, epsrel * std::abs(total));
+			converged = converged && total_error <= tolerances[c];
+		}
+
+		if (converged) {
+			break;
+		}
+		if (lower_bounds.size() >= max_intervals) {
+			num_intervals += lower_bounds.size();
+			return GSL_EMAXITER;
+		}
+
+		// Bisect the interval contributing the largest error relative to
+		// the tolerance of any of its components
+		std::size_t worst = 0;
+		double worst_error = -1;
+		for (std::size_t i = 0; i != lower_bounds.size(); i++) {
+			for (std::size_t c = 0; c != n; c++) {
+				double error = interval_errors[i * n + c];
+				double relative_error = tolerances[c] > 0 ? error / tolerances[c] : error;
+				if (relative_error > worst_error) {
+					worst_error = relative_error;
+					worst = i;
+				}
+			}
+		}
+
+		double a = lower_bounds[worst];
+		double b = upper_bounds[worst];
+		double mid = (a + b) / 2;
+		upper_bounds[worst] = mid;
+		lower_bounds.push_back(mid);
+		upper_bounds.push_back(b);
+		interval_results.resize(lower_bounds.size() * n);
+		interval_errors.resize(lower_bounds.size() * n);
+		gauss_kronrod(f, params, n, a, mid, &interval_results[worst * n], &interval_errors[worst * n]);
+		auto last = lower_bounds.size() - 1;
+		gauss_kronrod(f, params, n, mid, b, &interval_results[last * n], &interval_errors[last * n]);
+	}
+
+	num_intervals += lower_bounds.size();
+	return GSL_SUCCESS;
+}
+
 unsigned long int Integrator::get_num_intervals()
 {
 	return num_intervals;
@@ -89,4 +318,17 @@ void Integrator::reset_num_intervals()
 	num_intervals = 0;
 }
 
+Integrator &thread_integrator(std::size_t max_intervals)
+{
+	// Only a handful of different sizes are ever used
+	static thread_local std::vector<std::unique_ptr<Integrator>> integrators;
+	for (auto &integrator: integrators) {
+		if (integrator->get_max_intervals() == max_intervals) {
+			return *integrator;
+		}
+	}
+	integrators.emplace_back(new Integrator(max_intervals));
+	return *integrators.back();
+}
+
 }  // namespace shark
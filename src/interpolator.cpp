@@ -102,6 +102,82 @@ double Interpolator::get(double x, double y) const
 			x, y, xacc.get(), yacc.get());
 }
 
+GridInterpolator::axis::axis(std::vector<double> values_) :
+	values(std::move(values_)),
+	inv_bucket_width(0),
+	buckets()
+{
+	if (values.size() < 2) {
+		std::ostringstream os;
+		os << "Grid axis needs at least two values, got " << values.size();
+		throw invalid_argument(os.str());
+	}
+	if (!std::is_sorted(values.begin(), values.end()) ||
+	    std::adjacent_find(values.begin(), values.end()) != values.end()) {
+		throw invalid_argument("Grid axis values must be strictly increasing");
+	}
+
+	// A few buckets per cell keep the linear scan in cell() short even for
+	// unevenly spaced axes; for uniform ones it is at most one step
+	auto n_cells = values.size() - 1;
+	auto n_buckets = 4 * n_cells;
+	inv_bucket_width = n_buckets / (values.back() - values.front());
+	buckets.resize(n_buckets + 1);
+	std::size_t i = 0;
+	for (std::size_t bucket = 0; bucket != buckets.size(); bucket++) {
+		double v = values.front() + bucket / inv_bucket_width;
+		while (i + 1 < n_cells && values[i + 1] <= v) {
+			i++;
+		}
+		buckets[bucket] = i;
+	}
+}
+
+std::size_t GridInterpolator::axis::cell(double v, double &t) const
+{
+	v = std::min(std::max(v, values.front()), values.back());
+	auto bucket = static_cast<std::size_t>((v - values.front()) * inv_bucket_width);
+	auto i = buckets[std::min(bucket, buckets.size() - 1)];
+	// Rounding can put v in the bucket after its own
+	while (i > 0 && values[i] > v) {
+		i--;
+	}
+	while (i + 2 < values.size() && values[i + 1] <= v) {
+		i++;
+	}
+	t = (v - values[i]) / (values[i + 1] - values[i]);
+	return i;
+}
+
+GridInterpolator::GridInterpolator(std::vector<double> xvals, std::vector<double> yvals, std::vector<double> zvals) :
+	x(std::move(xvals)), y(std::move(yvals)), z(std::move(zvals))
+{
+	if (x.size() * y.size() != z.size()) {
+		std::ostringstream os;
+		os << "Grid size (" << x.size() << "x" << y.size() << " = " << x.size() * y.size();
+		os << ") does not correspond with values size (" << z.size() << ")";
+		throw invalid_argument(os.str());
+	}
+}
+
+double GridInterpolator::get(double x, double y) const
+{
+	double t, u;
+	auto i = this->x.cell(x, t);
+	auto j = this->y.cell(y, u);
+	auto nx = this->x.size();
+	const double *z0 = &z[j * nx + i];
+	const double *z1 = z0 + nx;
+	return (1 - t) * (1 - u) * z0[0] + t * (1 - u) * z0[1] + (1 - t) * u * z1[0] + t * u * z1[1];
+}
+
+void GridInterpolator::get(const double *x, const double *y, double *out, std::size_t n) const
+{
+	for (std::size_t k = 0; k != n; k++) {
+		out[k] = get(x[k], y[k]);
+	}
+}
+
 const gsl_interp2d_type *Interpolator::to_gsl(InterpolatorType type) const
 {
 	if (type == BILINEAR) {
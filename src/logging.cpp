@@ -23,6 +23,101 @@
  * Logging for shark
  */
 
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <boost/core/null_deleter.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/log/support/date_time.hpp>
+#include <boost/log/utility/setup/common_attributes.hpp>
+#include <boost/make_shared.hpp>
+
 #include "logging.h"
 
-::boost::log::trivial::severity_level logging_level;
\ No newline at end of file
+::boost::log::trivial::severity_level logging_level;
+
+namespace shark {
+
+static std::mutex log_sites_mutex;
+
+static std::vector<LogSite *> &log_sites()
+{
+	static std::vector<LogSite *> sites;
+	return sites;
+}
+
+LogSite::LogSite(const char *file, int line) :
+	file(file), line(line)
+{
+	std::lock_guard<std::mutex> lock(log_sites_mutex);
+	log_sites().push_back(this);
+}
+
+unsigned long LogSite::take_suppressed()
+{
+	auto n = messages.exchange(0, std::memory_order_relaxed);
+	return n > max_messages ? n - max_messages : 0;
+}
+
+void report_suppressed_log_messages(const std::string &period)
+{
+	std::lock_guard<std::mutex> lock(log_sites_mutex);
+	for (auto site: log_sites()) {
+		auto suppressed = site->take_suppressed();
+		if (suppressed == 0) {
+			continue;
+		}
+		auto basename = std::strrchr(site->file, '/');
+		LOG(warning) << suppressed << " more messages logged from " << (basename ? basename + 1 : site->file)
+		             << ":" << site->line << " " << period << " were not shown";
+	}
+}
+
+namespace sinks = ::boost::log::sinks;
+typedef sinks::asynchronous_sink<sinks::text_ostream_backend> async_sink;
+
+class AsyncLogging::impl {
+public:
+	boost::shared_ptr<async_sink> sink;
+};
+
+AsyncLogging::AsyncLogging() :
+	pimpl(new impl())
+{
+	namespace log = ::boost::log;
+	namespace expr = ::boost::log::expressions;
+
+	// Same format of the default sink, which stops being used
+	log::add_common_attributes();
+	auto backend = boost::make_shared<sinks::text_ostream_backend>();
+	backend->add_stream(boost::shared_ptr<std::ostream>(&std::clog, boost::null_deleter()));
+	backend->auto_flush(true);
+	auto &sink = pimpl->sink;
+	sink = boost::make_shared<async_sink>(backend);
+	sink->set_formatter(expr::stream
+		<< "[" << expr::format_date_time<boost::posix_time::ptime>("TimeStamp", "%Y-%m-%d %H:%M:%S.%f") << "] "
+		<< "[" << expr::attr<log::attributes::current_thread_id::value_type>("ThreadID") << "] "
+		<< "[" << log::trivial::severity << "]   " << expr::smessage);
+	log::core::get()->add_sink(sink);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+	auto &sink = pimpl->sink;
+	::boost::log::core::get()->remove_sink(sink);
+	sink->stop();
+	sink->flush();
+}
+
+void AsyncLogging::flush()
+{
+	pimpl->sink->flush();
+}
+
+}  // namespace shark
\ No newline at end of file
@@ -24,8 +24,10 @@
  */
 
 #include <algorithm>
+#include <fstream>
 #include <ios>
 #include <iostream>
+#include <type_traits>
 #include <vector>
 
 #include "config.h"
@@ -39,10 +41,14 @@
 
 #include "components.h"
 #include "logging.h"
+#include "mpi_utils.h"
 #include "options.h"
+#include "resource_estimator.h"
 #include "shark_runner.h"
 #include "git_revision.h"
+#include "star_formation.h"
 #include "timer.h"
+#include "tolerance_tuner.h"
 
 namespace shark {
 
@@ -57,6 +63,11 @@ void show_help(const char *prog, const boost::program_options::options_descripti
 	out << "is present in more than one configuration file, the last one takes precedence." << endl;
 	out << "Options specified via -o take precedence, in order." << endl;
 	out << endl;
+	out << "Several models can be evolved over the same merger trees, which are then" << endl;
+	out << "imported only once, by giving a model file via -m for each of them. Each" << endl;
+	out << "model file is loaded after all configuration files and before any -o option," << endl;
+	out << "and should at least give a different execution.name_model." << endl;
+	out << endl;
 	out << desc << endl;
 	out << "Example:" << endl;
 	out << endl;
@@ -66,6 +77,22 @@ void show_help(const char *prog, const boost::program_options::options_descripti
 	out << " It loads options from config_file1.txt first and then from config_file2.txt. On top of that" << endl;;
 	out << " it also loads options 'group1.option1' and 'group1.option2' from the command-line." << endl;;
 	out << endl;
+	out << " $> " << prog << " -m model1.txt -m model2.txt config_file.txt" << endl;
+	out << endl;
+	out << " It evolves two models, with the options of config_file.txt overridden by those" << endl;
+	out << " in model1.txt and model2.txt respectively." << endl;
+	out << endl;
+	out << " $> " << prog << " -e -t 16 --calibration metrics.csv config_file.txt" << endl;
+	out << endl;
+	out << " It estimates the memory and time needed to evolve each simulation batch with" << endl;
+	out << " 16 threads, with costs measured in a previous execution, without evolving them." << endl;
+	out << endl;
+	out << " $> " << prog << " --tune-tolerances 0.01 -t 16 config_file.txt" << endl;
+	out << endl;
+	out << " It evolves 10% of the merger trees with several ODE and star formation tolerances," << endl;
+	out << " prints their cost and accuracy as CSV, and recommends the fastest ones whose" << endl;
+	out << " summary statistics deviate at most 1% from those of the tightest tolerances." << endl;
+	out << endl;
 }
 
 static
@@ -87,6 +114,9 @@ void setup_logging(const boost::program_options::variables_map &vm) {
 
 void throw_exception_gsl_handler(const char *reason, const char *file, int line, int gsl_errno)
 {
+	if (scoped_gsl_error_suppression::active()) {
+		return;
+	}
 	throw gsl_error(reason, file, line, gsl_errno, gsl_strerror(gsl_errno));
 }
 
@@ -112,6 +142,11 @@ void log_startup_information(int argc, char **argv)
 	os << "Main structure/class sizes follow. ";
 	os << "Baryon: " << memory_amount(sizeof(Baryon)) << ", Subhalo: " << memory_amount(sizeof(Subhalo)) << ", Halo: " << memory_amount(sizeof(Halo));
 	os << ", Galaxy: " << memory_amount(sizeof(Galaxy)) << ", MergerTree: " << memory_amount(sizeof(MergerTree));
+	os << ", CoolingSubhaloTracking: " << memory_amount(sizeof(CoolingSubhaloTracking));
+	os << (std::is_trivially_copyable<CoolingSubhaloTracking>::value ? " (trivially copyable)" : "");
+	os << ", Subhalo::galaxies: " << memory_amount(sizeof(galaxies_t)) << " (" << galaxies_t::inline_capacity << " inline)";
+	os << ", Subhalo::ascendants: " << memory_amount(sizeof(Subhalo::ascendants)) << " (" << decltype(Subhalo::ascendants)::inline_capacity << " inline)";
+	os << ", Halo::ascendants: " << memory_amount(sizeof(Halo::ascendants)) << " (" << decltype(Halo::ascendants)::inline_capacity << " inline)";
 	LOG(info) << os.str();
 }
 
@@ -131,7 +166,21 @@ boost::program_options::variables_map parse_cmdline(int argc, char **argv) {
 		("threads,t",   po::value<unsigned int>()->default_value(1), "OpenMP threads, defaults to 1. 0 means use OpenMP default number of threads")
 #endif // SHARK_OPENMP
 		("options,o",   po::value<vector<string>>()->multitoken()->default_value({}, ""),
-		                "Space-separated additional options to override config file");
+		                "Space-separated additional options to override config file")
+		("restart,r",   po::value<string>(), "Checkpoint file to restart the evolution from. Same as -o execution.restart_file=<file>")
+		("model,m",     po::value<vector<string>>()->composing()->default_value({}, ""),
+		                "File with the options of one of several models evolved over the same merger trees. Can be given many times")
+		("estimate,e",  "Estimate the memory and time needed by each simulation batch, print them as CSV and exit, without evolving anything")
+		("calibration", po::value<string>(), "Metrics file (see execution.metrics_file) of a previous execution of the model to calibrate estimates with")
+		("tune-tolerances",      po::value<double>(),
+		                         "Evolve a sample of merger trees with several ODE and star formation tolerances, print their cost and "
+		                         "accuracy as CSV, recommend the fastest ones whose summary statistics deviate at most this much from "
+		                         "those of the tightest tolerances, and exit")
+		("tuning-sample",        po::value<double>()->default_value(0.1), "Fraction of merger trees evolved when tuning tolerances")
+		("tuning-precisions",    po::value<vector<double>>()->multitoken(),
+		                         "Values of execution.ode_solver_precision tried when tuning tolerances. Defaults to 0.1, 0.3, 1 and 3 times the configured one")
+		("tuning-sf-accuracies", po::value<vector<double>>()->multitoken(),
+		                         "Values of star_formation.accuracy_sf_eqs tried when tuning tolerances. Defaults to 0.1, 0.3, 1 and 3 times the configured one");
 
 	po::positional_options_description pdesc;
 	pdesc.add("config-file", -1);
@@ -162,6 +211,12 @@ boost::program_options::variables_map parse_cmdline(int argc, char **argv) {
 		std::cout << "Yes" << std::endl;
 #else
 		std::cout << "No" << std::endl;
+#endif
+		std::cout << "MPI support: ";
+#ifdef SHARK_MPI
+		std::cout << "Yes" << std::endl;
+#else
+		std::cout << "No" << std::endl;
 #endif
 	}
 	else if (vm.count("config-file") == 0 ) {
@@ -171,8 +226,9 @@ boost::program_options::variables_map parse_cmdline(int argc, char **argv) {
 	return vm;
 }
 
-Options read_options(const boost::program_options::variables_map &vm, unsigned int &threads) {
+unsigned int read_threads(const boost::program_options::variables_map &vm) {
 
+	unsigned int threads;
 #ifdef SHARK_OPENMP
 	threads = vm["threads"].as<unsigned int>();
 	if (threads == 0) {
@@ -182,22 +238,123 @@ Options read_options(const boost::program_options::variables_map &vm, unsigned i
 	threads = 1;
 #endif // SHARK_OPENMP
 	LOG(info) << "shark using " << threads << " thread(s)";
+	return threads;
+}
 
-	// Read the configuration file, and override options with any given
-	// on the command-line
+Options read_options(const boost::program_options::variables_map &vm, const std::string &model_file) {
+
+	// Read the configuration file, and override options with those of the
+	// model and any given on the command-line
 	Options options;
 	for (auto &config_file: vm["config-file"].as<std::vector<std::string>>()) {
 		options.add_file(config_file);
 	}
+	if (!model_file.empty()) {
+		options.add_file(model_file);
+	}
 	for(auto &opt_spec: vm["options"].as<std::vector<std::string>>()) {
 		options.add(opt_spec);
 	}
+	if (vm.count("restart")) {
+		options.add("execution.restart_file=" + vm["restart"].as<std::string>());
+	}
 
 	return options;
 }
 
-int main(int argc, char **argv) {
+/// Assigns a disjoint subset of the simulation batches to this process
+void distribute_batches(Options &options)
+{
+	auto rank = mpi::rank();
+	auto size = mpi::size();
+	if (size == 1) {
+		return;
+	}
+
+	std::vector<unsigned int> batches;
+	options.load("execution.simulation_batches", batches, true);
+	auto assigned_batches = mpi::distribute_batches(batches, rank, size);
+	if (assigned_batches.empty()) {
+		std::ostringstream os;
+		os << "Process " << rank << " has no simulation batches to process: ";
+		os << batches.size() << " batches were given for " << size << " processes";
+		throw invalid_option(os.str());
+	}
+
+	std::ostringstream os;
+	std::copy(assigned_batches.begin(), assigned_batches.end(), std::ostream_iterator<unsigned int>(os, " "));
+	LOG(info) << "Process " << rank << " of " << size << " handles simulation batches " << os.str();
+	options.add("execution.simulation_batches=" + os.str());
+
+	// Processes must not write over each other's metrics
+	for (std::string option: {"execution.metrics_file", "execution.ode_costs_file", "execution.trace_file", "execution.status_file"}) {
+		std::string filename;
+		options.load(option, filename);
+		if (!filename.empty()) {
+			options.add(option + "=" + filename + "." + std::to_string(rank));
+		}
+	}
+}
 
+/// Writes the estimated resources of all simulation batches of the first model
+void estimate_resources(const boost::program_options::variables_map &vm, unsigned int threads)
+{
+	auto model_files = vm["model"].as<std::vector<std::string>>();
+	auto options = read_options(vm, model_files.empty() ? std::string() : model_files.front());
+
+	ResourceCosts costs;
+	if (vm.count("calibration")) {
+		auto metrics_file = vm["calibration"].as<std::string>();
+		std::ifstream metrics(metrics_file);
+		if (!metrics) {
+			throw invalid_option("cannot open calibration file " + metrics_file);
+		}
+		costs = ResourceCosts::calibrate(metrics);
+	}
+
+	SimulationParameters simulation_params(options);
+	ExecutionParameters exec_params(options);
+	ResourceEstimator estimator(simulation_params, exec_params, threads, costs);
+	ResourceEstimator::write_csv(std::cout, estimator.estimate());
+}
+
+/// The values of a tolerance tried when tuning, around its configured @p value
+std::vector<double> tuning_values(const boost::program_options::variables_map &vm, const std::string &option, double value)
+{
+	if (vm.count(option)) {
+		return vm[option].as<std::vector<double>>();
+	}
+	return {0.1 * value, 0.3 * value, value, 3 * value};
+}
+
+/// Evolves a sample of the merger trees of the first model with several
+/// tolerances, and writes their cost and accuracy
+void tune_tolerances(const boost::program_options::variables_map &vm, unsigned int threads)
+{
+	auto model_files = vm["model"].as<std::vector<std::string>>();
+	auto options = read_options(vm, model_files.empty() ? std::string() : model_files.front());
+	options.add("execution.tree_sampling_rate=" + std::to_string(vm["tuning-sample"].as<double>()));
+
+	ExecutionParameters exec_params(options);
+	StarFormationParameters star_formation_params(options);
+	ToleranceTuner tuner(options, threads,
+	                     tuning_values(vm, "tuning-precisions", exec_params.ode_solver_precision),
+	                     tuning_values(vm, "tuning-sf-accuracies", star_formation_params.Accuracy_SFeqs));
+	auto trials = tuner.run();
+
+	auto max_deviation = vm["tune-tolerances"].as<double>();
+	auto recommended = ToleranceTuner::recommend(trials, max_deviation);
+	ToleranceTuner::write_csv(std::cout, trials, recommended);
+	auto &settings = trials[recommended].settings;
+	LOG(info) << "Fastest tolerances deviating at most " << max_deviation << " from the tightest ones: "
+	          << "execution.ode_solver_precision=" << settings.ode_solver_precision
+	          << " star_formation.accuracy_sf_eqs=" << settings.accuracy_sf_eqs
+	          << " (" << trials[recommended].millis << " [ms] vs " << trials[0].millis << " [ms])";
+}
+
+int run(int argc, char **argv) {
+
+	AsyncLogging async_logging;
 	try {
 		boost::program_options::variables_map vm = parse_cmdline(argc, argv);
 		if (vm.empty()) {
@@ -209,29 +366,62 @@ int main(int argc, char **argv) {
 		install_gsl_error_handler();
 
 		Timer timer;
-		unsigned int threads;
-		auto options = read_options(vm, threads);
-		SharkRunner(options, threads).run();
+		auto threads = read_threads(vm);
+		if (vm.count("estimate")) {
+			estimate_resources(vm, threads);
+			return 0;
+		}
+		if (vm.count("tune-tolerances")) {
+			tune_tolerances(vm, threads);
+			return 0;
+		}
+		auto model_files = vm["model"].as<std::vector<std::string>>();
+		if (model_files.empty()) {
+			model_files.emplace_back();
+		}
+		std::vector<Options> models;
+		for (auto &model_file: model_files) {
+			auto options = read_options(vm, model_file);
+			distribute_batches(options);
+			models.emplace_back(std::move(options));
+		}
+		SharkRunner(models, threads).run();
 		LOG(info) << "Successfully finished in " << timer;
 
 		return 0;
 	} catch (const shark::missing_option &e) {
+		async_logging.flush();
 		std::cerr << "Missing option: " << e.what() << std::endl;
 		return 1;
 	} catch (const shark::exception &e) {
+		async_logging.flush();
 		std::cerr << "Unexpected shark exception found while running:" << std::endl << std::endl;
 		std::cerr << e.what() << std::endl;
 		return 1;
 	} catch (const boost::program_options::error &e) {
+		async_logging.flush();
 		std::cerr << "Error while parsing command-line: " << e.what() << std::endl;
 		return 1;
 	} catch (const std::exception &e) {
+		async_logging.flush();
 		std::cerr << "Unexpected exception while running" << std::endl << std::endl;
 		std::cerr << e.what() << std::endl;
 		return 1;
 	}
 }
 
+int main(int argc, char **argv) {
+
+	mpi::Environment mpi_environment(argc, argv);
+	auto result = run(argc, argv);
+
+	// Don't leave other processes waiting for this one
+	if (result != 0 && mpi::size() > 1) {
+		mpi::abort(result);
+	}
+	return result;
+}
+
 } // namespace shark
 
 int main(int argc, char **argv) {
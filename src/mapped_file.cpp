@@ -0,0 +1,107 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * MappedFile implementation
+ */
+
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include <errno.h>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif // _WIN32
+
+#include "mapped_file.h"
+#include "utils.h"
+
+namespace shark {
+
+namespace {
+
+std::runtime_error file_error(const std::string &action, const std::string &filename)
+{
+	std::ostringstream os;
+	os << "Error when " << action << " file '" << filename << "': " << strerror(errno);
+	return std::runtime_error(os.str());
+}
+
+}  // anonymous namespace
+
+MappedFile::MappedFile(const std::string &filename) :
+	_data(nullptr),
+	_size(0),
+	buffer()
+{
+#ifdef _WIN32
+	auto f = open_file(filename);
+	buffer.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	_data = buffer.data();
+	_size = buffer.size();
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw file_error("opening", filename);
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		auto error = file_error("inspecting", filename);
+		close(fd);
+		throw error;
+	}
+
+	// Empty files cannot be mapped, but there's nothing to map anyway
+	_size = st.st_size;
+	if (_size > 0) {
+		void *addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED) {
+			auto error = file_error("mapping", filename);
+			close(fd);
+			throw error;
+		}
+		_data = static_cast<const char *>(addr);
+		madvise(addr, _size, MADV_SEQUENTIAL);
+	}
+
+	// The mapping stays valid after closing the file descriptor
+	close(fd);
+#endif // _WIN32
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+	if (_data) {
+		munmap(const_cast<char *>(_data), _size);
+	}
+#endif // _WIN32
+}
+
+}  // namespace shark
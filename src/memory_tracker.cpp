@@ -0,0 +1,100 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * MemoryTracker implementation
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "exceptions.h"
+#include "huge_pages.h"
+#include "logging.h"
+#include "memory_tracker.h"
+#include "utils.h"
+
+namespace shark {
+
+MemoryTracker::MemoryTracker(std::size_t budget) :
+	budget(budget)
+{
+	// no-op
+}
+
+std::size_t MemoryTracker::projected_peak_rss(int remaining_snapshots) const
+{
+	std::size_t peak = phases.empty() ? peak_rss() : phases.back().peak_rss;
+	if (n_snapshots < 2 || remaining_snapshots <= 0 || last_snapshot_rss <= first_snapshot_rss) {
+		return peak;
+	}
+	auto growth_per_snapshot = double(last_snapshot_rss - first_snapshot_rss) / (n_snapshots - 1);
+	auto projected = last_snapshot_rss + std::size_t(growth_per_snapshot * remaining_snapshots);
+	return std::max(peak, projected);
+}
+
+const MemoryUsage &MemoryTracker::record(const std::string &phase, int remaining_snapshots)
+{
+	// The kernel updates the peak lazily, so it can lag behind the current RSS
+	auto rss = current_rss();
+	// Finding transparent huge pages means walking all mappings
+	std::size_t huge_page_bytes = 0;
+	if (huge_pages::enabled()) {
+		huge_page_bytes = huge_pages::explicit_bytes() + huge_pages::transparent_bytes();
+	}
+	MemoryUsage usage {phase, rss, std::max(rss, peak_rss()), huge_page_bytes};
+	if (remaining_snapshots >= 0) {
+		if (n_snapshots == 0) {
+			first_snapshot_rss = usage.rss;
+		}
+		last_snapshot_rss = usage.rss;
+		n_snapshots++;
+	}
+	phases.emplace_back(std::move(usage));
+	const auto &recorded = phases.back();
+
+	LOG(debug) << "Memory after " << phase << ": " << memory_amount(recorded.rss) << " (peak: " << memory_amount(recorded.peak_rss)
+	           << ", huge pages: " << memory_amount(recorded.huge_pages) << ")";
+	if (budget == 0) {
+		return recorded;
+	}
+
+	auto projected = projected_peak_rss(remaining_snapshots);
+	if (!within_budget(recorded.peak_rss)) {
+		std::ostringstream os;
+		os << "Memory budget of " << memory_amount(budget) << " exceeded after " << phase;
+		os << ": currently using " << memory_amount(recorded.rss) << ", with a peak of " << memory_amount(recorded.peak_rss) << ". ";
+		os << "Finishing the execution would need at least ~" << memory_amount(projected) << ". ";
+		os << "Consider increasing the budget, using execution.batch_group_size, ";
+		os << "or enabling execution.release_evolved_snapshots and execution.stream_sf_histories";
+		throw memory_budget_exceeded(os.str());
+	}
+
+	if (!projection_warned && !within_budget(projected)) {
+		LOG(warning) << "Memory usage is growing by snapshot, and is projected to reach ~" << memory_amount(projected)
+		             << " by the end of the evolution, going over the memory budget of " << memory_amount(budget);
+		projection_warned = true;
+	}
+	return recorded;
+}
+
+}  // namespace shark
@@ -22,8 +22,10 @@
  */
 
 #include <array>
+#include <cstdint>
 #include <algorithm>
 #include <fstream>
+#include <iterator>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -31,11 +33,14 @@
 #include <vector>
 #include <tuple>
 
+#include "arena.h"
+#include "background_worker.h"
 #include "dark_matter_halos.h"
 #include "exceptions.h"
 #include "logging.h"
 #include "merger_tree_reader.h"
 #include "omp_utils.h"
+#include "radix_sort.h"
 #include "simulation.h"
 #include "timer.h"
 #include "utils.h"
@@ -46,8 +51,161 @@ using namespace std;
 
 namespace shark {
 
-SURFSReader::SURFSReader(const std::string &prefix, const DarkMatterHalosPtr &dark_matter_halos, const SimulationParameters &simulation_params, unsigned int threads) :
-	prefix(prefix), dark_matter_halos(dark_matter_halos), simulation_params(simulation_params), threads(threads)
+namespace {
+
+/// Number of halos whose derived properties are calculated in one go
+constexpr unsigned long derived_properties_chunk = 4096;
+
+/**
+ * Calls @p f(first, count) over consecutive chunks of [0, n) in parallel, so
+ * the array versions of the DarkMatterHalos functions can work on contiguous
+ * blocks of input.
+ */
+template <typename Callable>
+void for_each_chunk(unsigned long n, unsigned int threads, Callable &&f)
+{
+	auto n_chunks = (n + derived_properties_chunk - 1) / derived_properties_chunk;
+	omp_static_for(0ul, n_chunks, threads, [&](unsigned long chunk, int thread_idx) {
+		auto first = chunk * derived_properties_chunk;
+		f(first, std::min(derived_properties_chunk, n - first));
+	});
+}
+
+/**
+ * Returns the ranges of consecutive rows whose snapshot lies within
+ * [first_snapshot, last_snapshot]
+ */
+std::vector<hdf5::row_range> rows_within(const std::vector<int> &snap, int first_snapshot, int last_snapshot)
+{
+	std::vector<hdf5::row_range> rows;
+	for (hsize_t i = 0; i != snap.size(); i++) {
+		if (snap[i] < first_snapshot || snap[i] > last_snapshot) {
+			continue;
+		}
+		if (!rows.empty() && rows.back().first + rows.back().count == i) {
+			rows.back().count++;
+		}
+		else {
+			rows.push_back({i, 1});
+		}
+	}
+	return rows;
+}
+
+/**
+ * Like rows_within, but finds the rows from a per-snapshot row index instead
+ * of from the snapshot numbers of all rows. The index, as written by
+ * shark-importer, contains the first row and the number of (contiguous) rows
+ * of each snapshot in the file.
+ */
+std::vector<hdf5::row_range> indexed_rows_within(const std::vector<int> &snapshots, const std::vector<std::int64_t> &first_rows, const std::vector<std::int64_t> &n_rows, int first_snapshot, int last_snapshot)
+{
+	if (first_rows.size() != snapshots.size() || n_rows.size() != snapshots.size()) {
+		throw invalid_data("The per-snapshot row index datasets have different lengths");
+	}
+
+	std::vector<hdf5::row_range> rows;
+	for (std::size_t i = 0; i != snapshots.size(); i++) {
+		if (snapshots[i] < first_snapshot || snapshots[i] > last_snapshot || n_rows[i] == 0) {
+			continue;
+		}
+		rows.push_back({hsize_t(first_rows[i]), hsize_t(n_rows[i])});
+	}
+
+	// Ranges must be increasing and not overlapping, merge contiguous ones
+	std::sort(rows.begin(), rows.end(), [](const hdf5::row_range &a, const hdf5::row_range &b) {
+		return a.first < b.first;
+	});
+	std::vector<hdf5::row_range> merged;
+	for (auto &range: rows) {
+		if (!merged.empty() && merged.back().first + merged.back().count == range.first) {
+			merged.back().count += range.count;
+		}
+		else {
+			merged.push_back(range);
+		}
+	}
+	return merged;
+}
+
+/// @return The number of rows in the given ranges
+hsize_t count_rows(const std::vector<hdf5::row_range> &rows)
+{
+	hsize_t count = 0;
+	for (const auto &range: rows) {
+		count += range.count;
+	}
+	return count;
+}
+
+/**
+ * Returns the ranges of rows of a file holding the given elements, in
+ * increasing order, of a selection of its @p rows
+ */
+std::vector<hdf5::row_range> rows_at(const std::vector<hdf5::row_range> &rows, const std::vector<std::size_t> &indices)
+{
+	std::vector<hdf5::row_range> selected;
+	auto range = rows.begin();
+	std::size_t range_start = 0;
+	for (auto index: indices) {
+		while (index >= range_start + range->count) {
+			range_start += range->count;
+			range++;
+		}
+		hsize_t row = range->first + (index - range_start);
+		if (!selected.empty() && selected.back().first + selected.back().count == row) {
+			selected.back().count++;
+		}
+		else {
+			selected.push_back({row, 1});
+		}
+	}
+	return selected;
+}
+
+/**
+ * Splits the given rows into groups of at most @p rows_per_chunk rows, or
+ * returns them as a single group if @p rows_per_chunk is 0. At least one
+ * (possibly empty) group is always returned.
+ */
+std::vector<std::vector<hdf5::row_range>> split_rows(const std::vector<hdf5::row_range> &rows, unsigned long rows_per_chunk)
+{
+	std::vector<std::vector<hdf5::row_range>> chunks(1);
+	hsize_t in_chunk = 0;
+	for (auto range: rows) {
+		while (range.count > 0) {
+			if (rows_per_chunk && in_chunk == rows_per_chunk) {
+				chunks.emplace_back();
+				in_chunk = 0;
+			}
+			auto count = rows_per_chunk ? std::min<hsize_t>(range.count, rows_per_chunk - in_chunk) : range.count;
+			chunks.back().push_back({range.first, count});
+			range.first += count;
+			range.count -= count;
+			in_chunk += count;
+		}
+	}
+	return chunks;
+}
+
+/**
+ * Reads the given rows of a dataset straight into @p column, which is sized
+ * to hold @p width values per row. HDF5 converts the values from their type
+ * in the file.
+ */
+template <typename T>
+void read_rows(const hdf5::Reader &file, const std::string &name, const std::vector<hdf5::row_range> &rows, std::vector<T> &column, unsigned int width)
+{
+	column.resize(count_rows(rows) * width);
+	file.read_dataset_into<T>(name, rows, column);
+}
+
+} // anonymous namespace
+
+SURFSReader::SURFSReader(const std::string &prefix, const DarkMatterHalosPtr &dark_matter_halos, const SimulationParameters &simulation_params, unsigned int threads, bool arena_allocation, MemoryTracker *memory_tracker, unsigned int batches_in_flight, unsigned long chunk_size, const SpatialSelection &spatial_selection) :
+	prefix(prefix), dark_matter_halos(dark_matter_halos), simulation_params(simulation_params), threads(threads), arena_allocation(arena_allocation),
+	memory_tracker(memory_tracker), batches_in_flight(batches_in_flight), chunk_size(chunk_size),
+	spatial_selection(spatial_selection)
 {
 	if ( prefix.size() == 0 ) {
 		throw invalid_argument("Trees dir has no value");
@@ -55,14 +213,74 @@ SURFSReader::SURFSReader(const std::string &prefix, const DarkMatterHalosPtr &da
 
 }
 
+void SURFSReader::record_memory(const std::string &phase, unsigned int batch)
+{
+	if (memory_tracker) {
+		memory_tracker->record(phase + " (batch " + std::to_string(batch) + ")");
+	}
+}
+
 const string SURFSReader::get_filename(int batch)
+{
+	return get_filename(prefix, batch);
+}
+
+string SURFSReader::get_filename(const string &prefix, int batch)
 {
 	ostringstream os;
 	os << prefix << "." << batch << ".hdf5";
 	return os.str();
 }
 
-const std::vector<HaloPtr> SURFSReader::read_halos(std::vector<unsigned int> batches)
+std::vector<hdf5::row_range> SURFSReader::select_tree_rows(const hdf5::Reader &batch_file, const std::vector<hdf5::row_range> &rows, int root_snapshot)
+{
+	// Which trees each row belongs to is found by following the links
+	// between host halos, so only these columns are read for all rows
+	Timer t;
+	std::vector<int> snap;
+	std::vector<Halo::id_t> hostIndex;
+	std::vector<Halo::id_t> descHost;
+	read_rows(batch_file, "haloTrees/snapshotNumber", rows, snap, 1);
+	read_rows(batch_file, "haloTrees/hostIndex", rows, hostIndex, 1);
+	read_rows(batch_file, "haloTrees/descendantHost", rows, descHost, 1);
+
+	std::vector<std::size_t> root_rows;
+	for (std::size_t i = 0; i != snap.size(); i++) {
+		if (snap[i] == root_snapshot) {
+			root_rows.push_back(i);
+		}
+	}
+	std::vector<float> root_positions;
+	read_rows(batch_file, "haloTrees/position", rows_at(rows, root_rows), root_positions, 3);
+	auto selected = spatial_selection.tree_rows(snap, hostIndex, descHost, root_positions, root_snapshot);
+
+	// The Halo with the largest id is never returned (see read_halos), so its
+	// rows are still read to not lose a different Halo instead
+	Halo::id_t last_halo = std::numeric_limits<Halo::id_t>::min();
+	for (std::size_t i = 0; i != snap.size(); i++) {
+		if (snap[i] >= simulation_params.min_snapshot) {
+			last_halo = std::max(last_halo, hostIndex[i]);
+		}
+	}
+	std::vector<std::size_t> last_halo_rows;
+	for (std::size_t i = 0; i != snap.size(); i++) {
+		if (hostIndex[i] == last_halo && !std::binary_search(selected.begin(), selected.end(), i)) {
+			last_halo_rows.push_back(i);
+		}
+	}
+	if (!last_halo_rows.empty()) {
+		std::vector<std::size_t> all_selected;
+		std::merge(selected.begin(), selected.end(), last_halo_rows.begin(), last_halo_rows.end(), std::back_inserter(all_selected));
+		selected = std::move(all_selected);
+	}
+
+	LOG(info) << selected.size() << " out of " << snap.size() << " rows of " << batch_file.get_filename()
+	          << " belong to merger trees whose root halos lie within the " << spatial_selection
+	          << ", reading only those. Rows selected in " << t;
+	return rows_at(rows, selected);
+}
+
+const std::vector<HaloPtr> SURFSReader::read_halos(std::vector<unsigned int> batches, int last_snapshot, int root_snapshot)
 {
 
 	// Check that batch numbers are within boundaries
@@ -84,11 +302,87 @@ const std::vector<HaloPtr> SURFSReader::read_halos(std::vector<unsigned int> bat
 		}
 	}
 
+	// Plan which rows of each batch file are read at a time. If the needed
+	// snapshots don't cover the whole simulation only their rows are read,
+	// which requires reading the snapshot numbers of all rows first.
+	// By default files are read as a whole
+	auto first_snapshot = simulation_params.min_snapshot;
+	const auto &redshifts = simulation_params.redshifts;
+	bool select_snapshots = !redshifts.empty() && (first_snapshot > redshifts.begin()->first || last_snapshot < redshifts.rbegin()->first);
+	if (root_snapshot < 0) {
+		root_snapshot = redshifts.empty() ? last_snapshot : std::min(last_snapshot, redshifts.rbegin()->first);
+	}
+	std::vector<std::shared_ptr<raw_chunk>> chunks;
+	std::vector<unsigned long> batch_rows;
+	std::vector<unsigned int> batch_chunks;
+	for (auto batch: batches) {
+		auto fname = get_filename(batch);
+		hdf5::Reader batch_file(fname);
+		hsize_t n_rows = batch_file.get_dataset_rows("haloTrees/nodeMass");
+		std::vector<hdf5::row_range> rows {{0, n_rows}};
+		if (select_snapshots && batch_file.exists("treeIndex")) {
+			rows = indexed_rows_within(batch_file.read_dataset_v<int>("treeIndex/snapshotNumber"),
+			                           batch_file.read_dataset_v<std::int64_t>("treeIndex/firstRow"),
+			                           batch_file.read_dataset_v<std::int64_t>("treeIndex/numberOfRows"),
+			                           first_snapshot, last_snapshot);
+		}
+		else if (select_snapshots) {
+			rows = rows_within(batch_file.read_dataset_v<int>("haloTrees/snapshotNumber"), first_snapshot, last_snapshot);
+		}
+		if (select_snapshots) {
+			LOG(info) << count_rows(rows) << " out of " << n_rows << " rows of " << fname << " lie within snapshots "
+			          << first_snapshot << " and " << last_snapshot << ", reading only those";
+		}
+		if (spatial_selection.enabled()) {
+			rows = select_tree_rows(batch_file, rows, root_snapshot);
+		}
+
+		unsigned long n_selected = 0;
+		unsigned int n_chunks = 0;
+		for (auto &chunk_rows: split_rows(rows, chunk_size)) {
+			unsigned long count = 0;
+			for (const auto &range: chunk_rows) {
+				count += range.count;
+			}
+			chunks.emplace_back(std::make_shared<raw_chunk>(batch, fname, std::move(chunk_rows), count));
+			n_selected += count;
+			n_chunks++;
+		}
+		batch_rows.push_back(n_selected);
+		batch_chunks.push_back(n_chunks);
+	}
+
+	// If requested, the next chunks are read in the background while
+	// the subhalos of the current one are created. Other threads might be
+	// writing outputs at the same time (e.g., those of the previous batch
+	// group still in flight), but hdf5::Reader holds the HDF5 library lock
+	// during each call, so the two never call into HDF5 concurrently
+	std::unique_ptr<BackgroundWorker> io_worker;
+	if (batches_in_flight > 0) {
+		io_worker.reset(new BackgroundWorker(batches_in_flight + 1));
+	}
+	std::size_t next_read = 0, next_taken = 0;
+	auto next_chunk = [&]() {
+		if (io_worker) {
+			for (; next_read < chunks.size() && next_read <= next_taken + batches_in_flight; next_read++) {
+				auto chunk = chunks[next_read];
+				io_worker->submit([chunk]() {
+					read_raw_chunk(*chunk);
+				});
+			}
+		}
+		auto chunk = std::move(chunks[next_taken++]);
+		if (!io_worker) {
+			read_raw_chunk(*chunk);
+		}
+		return chunk;
+	};
+
 	// Read halos for each batch, accumulate and return
 	std::vector<HaloPtr> all_halos;
-	for(auto batch: batches) {
-		LOG(info) << "Reading file for batch " << batch;
-		auto halos_batch = read_halos(batch);
+	for (std::size_t i = 0; i != batches.size(); i++) {
+		LOG(info) << "Reading file for batch " << batches[i];
+		auto halos_batch = read_halos(batches[i], batch_rows[i], batch_chunks[i], next_chunk);
 		all_halos.reserve(all_halos.size() + halos_batch.size());
 		all_halos.insert(all_halos.end(), halos_batch.begin(), halos_batch.end());
 	}
@@ -96,48 +390,84 @@ const std::vector<HaloPtr> SURFSReader::read_halos(std::vector<unsigned int> bat
 	return all_halos;
 }
 
-const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
+void SURFSReader::read_raw_chunk(raw_chunk &raw)
 {
-	Timer t;
-	const auto fname = get_filename(batch);
-	hdf5::Reader batch_file(fname);
-
-	//Read position and velocities first.
-	vector<float> position = batch_file.read_dataset_v_2<float>("haloTrees/position");
-	vector<float> velocity = batch_file.read_dataset_v_2<float>("haloTrees/velocity");
-
-	//Read mass, circular velocity and angular momentum.
-	vector<float> Mvir = batch_file.read_dataset_v<float>("haloTrees/nodeMass");
-	vector<float> Vcirc = batch_file.read_dataset_v<float>("haloTrees/maximumCircularVelocity");
-	vector<float> L = batch_file.read_dataset_v_2<float>("haloTrees/angularMomentum");
-
-	//Read indices and the snapshot number at which the subhalo lives.
-	vector<int> snap = batch_file.read_dataset_v<int>("haloTrees/snapshotNumber");
-	vector<Subhalo::id_t> nodeIndex = batch_file.read_dataset_v<Subhalo::id_t>("haloTrees/nodeIndex");
-	vector<Subhalo::id_t> descIndex = batch_file.read_dataset_v<Subhalo::id_t>("haloTrees/descendantIndex");
-	vector<Halo::id_t> hostIndex = batch_file.read_dataset_v<Halo::id_t>("haloTrees/hostIndex");
-	vector<Halo::id_t> descHost = batch_file.read_dataset_v<Halo::id_t>("haloTrees/descendantHost");
-
-	//Read properties that characterise the position of the subhalo inside the halo.descendantIndex
-	vector<int> IsMain = batch_file.read_dataset_v<int>("haloTrees/isMainProgenitor");
-	vector<int> IsCentre = batch_file.read_dataset_v<int>("haloTrees/isDHaloCentre");
-	vector<int> IsInterpolated = batch_file.read_dataset_v<int>("haloTrees/isInterpolated");
-
-	unsigned long n_subhalos = Mvir.size();
-	LOG(info) << "Read raw data of " << n_subhalos << " subhalos from " << fname << " in " << t;
-	if ( !n_subhalos ) {
-		return {};
+	bool derived_inputs_read = false;
+	try {
+		Timer t;
+		hdf5::Reader batch_file(raw.filename);
+		const auto &rows = raw.rows;
+
+		//Read mass, snapshot number and angular momentum first, which are
+		//needed to calculate derived properties.
+		read_rows(batch_file, "haloTrees/nodeMass", rows, raw.Mvir, 1);
+		read_rows(batch_file, "haloTrees/snapshotNumber", rows, raw.snap, 1);
+		read_rows(batch_file, "haloTrees/angularMomentum", rows, raw.L, 3);
+		raw.derived_inputs_read.set_value();
+		derived_inputs_read = true;
+
+		//Read position, velocities and circular velocity.
+		read_rows(batch_file, "haloTrees/position", rows, raw.position, 3);
+		read_rows(batch_file, "haloTrees/velocity", rows, raw.velocity, 3);
+		read_rows(batch_file, "haloTrees/maximumCircularVelocity", rows, raw.Vcirc, 1);
+
+		//Read indices.
+		read_rows(batch_file, "haloTrees/nodeIndex", rows, raw.nodeIndex, 1);
+		read_rows(batch_file, "haloTrees/descendantIndex", rows, raw.descIndex, 1);
+		read_rows(batch_file, "haloTrees/hostIndex", rows, raw.hostIndex, 1);
+		read_rows(batch_file, "haloTrees/descendantHost", rows, raw.descHost, 1);
+
+		//Read properties that characterise the position of the subhalo inside the halo.descendantIndex
+		read_rows(batch_file, "haloTrees/isMainProgenitor", rows, raw.IsMain, 1);
+		read_rows(batch_file, "haloTrees/isDHaloCentre", rows, raw.IsCentre, 1);
+		read_rows(batch_file, "haloTrees/isInterpolated", rows, raw.IsInterpolated, 1);
+
+		LOG(info) << "Read raw data of " << raw.count << " subhalos from " << raw.filename << " in " << t;
+		raw.all_read.set_value();
+	} catch (...) {
+		if (!derived_inputs_read) {
+			raw.derived_inputs_read.set_exception(std::current_exception());
+		}
+		raw.all_read.set_exception(std::current_exception());
 	}
+}
 
-	std::ostringstream os;
-	os << "File " << fname << " has " << n_subhalos << " subhalos. ";
-	os << "After reading we should be using ~" << memory_amount(n_subhalos * sizeof(Subhalo)) << " of memory";
-	LOG(info) << os.str();
-
-	t = Timer();
-	vector<vector<SubhaloPtr>> t_subhalos(threads);
+void SURFSReader::create_subhalos(raw_chunk &raw, std::vector<SubhaloPtr> &subhalos, std::vector<ArenaSet<int>> &t_arenas)
+{
+	raw.derived_inputs_ready.get();
+	const auto &Mvir = raw.Mvir;
+	const auto &snap = raw.snap;
+	const auto &L = raw.L;
+	unsigned long n_subhalos = raw.count;
+
+	// Calculate the derived properties of all subhalos, while the rest of
+	// the datasets are possibly still being read
+	Timer t;
+	vector<double> concentration(n_subhalos);
+	vector<double> Vvir(n_subhalos);
+	vector<float> lambda(n_subhalos);
+	for_each_chunk(n_subhalos, threads, [&](unsigned long first, unsigned long count) {
+		dark_matter_halos->nfw_concentration(&Mvir[first], &snap[first], count, &concentration[first]);
+		dark_matter_halos->halo_virial_velocity(&Mvir[first], &snap[first], count, &Vvir[first]);
+		dark_matter_halos->halo_lambda(&L[3 * first], &Mvir[first], &snap[first], count, &lambda[first]);
+	});
+	LOG(info) << "Calculated concentration, Vvir and lambda of " << n_subhalos << " subhalos in " << t;
+
+	raw.all_ready.get();
+	record_memory("raw data reading", raw.batch);
+	const auto &position = raw.position;
+	const auto &velocity = raw.velocity;
+	const auto &Vcirc = raw.Vcirc;
+	const auto &nodeIndex = raw.nodeIndex;
+	const auto &descIndex = raw.descIndex;
+	const auto &hostIndex = raw.hostIndex;
+	const auto &descHost = raw.descHost;
+	const auto &IsMain = raw.IsMain;
+	const auto &IsInterpolated = raw.IsInterpolated;
+
+	vector<vector<SubhaloPtr>> t_subhalos(std::max(threads, 1u));
 	for (auto &subhalos: t_subhalos) {
-		subhalos.reserve(n_subhalos / threads);
+		subhalos.reserve(n_subhalos / t_subhalos.size());
 	}
 
 	omp_static_for(0ul, n_subhalos, threads, [&](unsigned long i, int thread_idx) {
@@ -146,7 +476,11 @@ const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 			return;
 		}
 
-		auto subhalo = std::make_shared<Subhalo>(nodeIndex[i], snap[i]);
+		ArenaPtr arena;
+		if (arena_allocation) {
+			arena = t_arenas[thread_idx].get(snap[i]);
+		}
+		auto subhalo = make_shared_in<Subhalo>(arena, nodeIndex[i], snap[i]);
 
 		// Subhalo and Halo index, snapshot
 		subhalo->haloID = hostIndex[i];
@@ -195,8 +529,7 @@ const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 
 		subhalo->Vcirc = Vcirc[i];
 
-		auto z = simulation_params.redshifts[subhalo->snapshot];
-		subhalo->concentration = dark_matter_halos->nfw_concentration(subhalo->Mvir, z);
+		subhalo->concentration = concentration[i];
 
 		if (subhalo->concentration < 1) {
 			throw invalid_argument("concentration is <1, cannot continue. Please check input catalogue");
@@ -204,79 +537,145 @@ const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 
 		double npart = Mvir[i]/simulation_params.particle_mass;
 
-		subhalo->lambda = dark_matter_halos->halo_lambda(subhalo->L, Mvir[i], z, npart);
+		subhalo->lambda = dark_matter_halos->halo_lambda(lambda[i], npart, nodeIndex[i], snap[i]);
 
-		// Calculate virial velocity from the virial mass and redshift.
-		subhalo->Vvir = dark_matter_halos->halo_virial_velocity(subhalo->Mvir, z);
+		subhalo->Vvir = Vvir[i];
 
 		// Done, save it now
 		t_subhalos[thread_idx].emplace_back(std::move(subhalo));
 	});
 
-	vector<SubhaloPtr> subhalos;
-	if (threads == 0) {
-		subhalos = std::move(t_subhalos[0]);
+	// Keep the order of the rows in the file
+	for (auto &thread_subhalos: t_subhalos) {
+		subhalos.insert(subhalos.end(), std::make_move_iterator(thread_subhalos.begin()), std::make_move_iterator(thread_subhalos.end()));
 	}
-	else {
-		subhalos.reserve(n_subhalos);
-		for (auto i = 0u; i != threads; i++) {
-			subhalos.insert(subhalos.end(), t_subhalos[i].begin(), t_subhalos[i].end());
-		}
+}
+
+const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch, unsigned long n_subhalos, unsigned int n_chunks, const chunk_source &next_chunk)
+{
+	auto fname = get_filename(batch);
+	std::ostringstream os;
+	os << "File " << fname << " has " << n_subhalos << " subhalos";
+	if (n_chunks > 1) {
+		os << ", read in " << n_chunks << " chunks";
+	}
+	os << ". After reading we should be using ~" << memory_amount(n_subhalos * sizeof(Subhalo)) << " of memory";
+	LOG(info) << os.str();
+
+	Timer t;
+	vector<SubhaloPtr> subhalos;
+	subhalos.reserve(n_subhalos);
+	vector<ArenaSet<int>> t_arenas(arena_allocation ? std::max(threads, 1u) : 0);
+	for (unsigned int i = 0; i != n_chunks; i++) {
+		// The raw data of each chunk is released as soon as its subhalos exist
+		auto chunk = next_chunk();
+		create_subhalos(*chunk, subhalos, t_arenas);
 	}
 
 	LOG(info) << "Created " << subhalos.size() << " Subhalos from " << fname << " in " << t;
+	if (arena_allocation) {
+		std::size_t reserved = 0, used = 0;
+		for (auto &arenas: t_arenas) {
+			reserved += arenas.reserved();
+			used += arenas.used();
+		}
+		LOG(info) << "Subhalo arenas hold " << memory_amount(used) << " in " << memory_amount(reserved) << " of reserved memory";
+	}
+	record_memory("subhalo creation", batch);
 	return subhalos;
 }
 
-const std::vector<HaloPtr> SURFSReader::read_halos(unsigned int batch)
+const std::vector<HaloPtr> SURFSReader::read_halos(unsigned int batch, unsigned long n_subhalos, unsigned int n_chunks, const chunk_source &next_chunk)
 {
 
-	std::vector<SubhaloPtr> subhalos = read_subhalos(batch);
+	std::vector<SubhaloPtr> subhalos = read_subhalos(batch, n_subhalos, n_chunks, next_chunk);
 
 	// Sort subhalos by host index (which intrinsically sorts them by snapshot
-	// since host indices numbers are prefixed with the snapshot number)
-	std::sort(subhalos.begin(), subhalos.end(), [](const SubhaloPtr &lhs, const SubhaloPtr &rhs) {
-		return lhs->haloID < rhs->haloID;
-	});
-	LOG(info) << "Sorted subhalos by haloID, creating Halos now";
-
-	// Create and assign Halos
-	HaloPtr halo;
-	std::vector<HaloPtr> halos;
-	Halo::id_t last_halo_id = -1;
+	// since host indices numbers are prefixed with the snapshot number).
+	// Only the keys are sorted, yielding the order in which to visit subhalos
 	Timer t;
-	for(const auto &subhalo: subhalos) {
+	auto n_subhalos_read = subhalos.size();
+	std::vector<Halo::id_t> halo_ids(n_subhalos_read);
+	omp_static_for(0ul, n_subhalos_read, threads, [&](unsigned long i, int thread_idx) {
+		halo_ids[i] = subhalos[i]->haloID;
+	});
+	auto order = radix_sort(halo_ids, threads);
+	LOG(info) << "Sorted subhalos by haloID in " << t << ", creating Halos now";
 
-		auto halo_id = subhalo->haloID;
-		if (halo_id != last_halo_id) {
-			if (halo) {
-				halos.emplace_back(std::move(halo));
-			}
-			last_halo_id = halo_id;
-			halo = std::make_shared<Halo>(halo_id, subhalo->snapshot);
+	// Find where the subhalos of each halo start in the sorted order
+	t = Timer();
+	std::vector<unsigned long> halo_starts;
+	for (unsigned long i = 0; i != n_subhalos_read; i++) {
+		if (i == 0 || halo_ids[i] != halo_ids[i - 1]) {
+			halo_starts.push_back(i);
 		}
+	}
+	halo_starts.push_back(n_subhalos_read);
 
-		if (LOG_ENABLED(trace)) {
-			LOG(trace) << "Adding " << subhalo << " to " << halo;
+	// Create and assign Halos
+	auto n_groups = halo_starts.size() - 1;
+	std::vector<HaloPtr> halos(n_groups);
+	vector<ArenaSet<int>> t_arenas(arena_allocation ? std::max(threads, 1u) : 0);
+	omp_static_for(0ul, n_groups, threads, [&](unsigned long group, int thread_idx) {
+		auto first = halo_starts[group];
+		auto last = halo_starts[group + 1];
+		auto halo_snapshot = subhalos[order[first]]->snapshot;
+		ArenaPtr arena;
+		if (arena_allocation) {
+			arena = t_arenas[thread_idx].get(halo_snapshot);
+		}
+		auto halo = make_shared_in<Halo>(arena, halo_ids[first], halo_snapshot);
+		for (auto i = first; i != last; i++) {
+			auto &subhalo = subhalos[order[i]];
+			if (LOG_ENABLED(trace)) {
+				LOG(trace) << "Adding " << subhalo << " to " << halo;
+			}
+			subhalo->host_halo = halo;
+			halo->add_subhalo(std::move(subhalo));
 		}
-		subhalo->host_halo = halo;
-		halo->add_subhalo(std::move(subhalo));
+		halos[group] = std::move(halo);
+	});
+	// Keep the long-standing behaviour of not returning the Halo with the
+	// largest id (its Subhalos still point to it)
+	if (!halos.empty()) {
+		halos.pop_back();
 	}
 	subhalos.clear();
 
 	std::ostringstream os;
 	os << "Created " << halos.size() << " Halos from these Subhalos in " << t << ". ";
 	os << "This should take another ~" << memory_amount(halos.size() * sizeof(Halo)) << " of memory";
+	if (arena_allocation) {
+		std::size_t reserved = 0, used = 0;
+		for (auto &arenas: t_arenas) {
+			reserved += arenas.reserved();
+			used += arenas.used();
+		}
+		os << ", Halo arenas hold " << memory_amount(used) << " in " << memory_amount(reserved) << " of reserved memory";
+	}
 	LOG(info) << os.str();
 
 	// Calculate halos' vvir and concentration
 	t = Timer();
-	omp_dynamic_for(halos, threads, 10000, [&](const HaloPtr &halo, int thread_idx) {
-		auto z = simulation_params.redshifts[halo->snapshot];
-		halo->Vvir = dark_matter_halos->halo_virial_velocity(halo->Mvir, z);
-		halo->concentration = dark_matter_halos->nfw_concentration(halo->Mvir,z);
+	auto n_halos = halos.size();
+	vector<float> Mvir(n_halos);
+	vector<int> snap(n_halos);
+	omp_static_for(0ul, n_halos, threads, [&](unsigned long i, int thread_idx) {
+		Mvir[i] = halos[i]->Mvir;
+		snap[i] = halos[i]->snapshot;
+	});
+	for_each_chunk(n_halos, threads, [&](unsigned long first, unsigned long count) {
+		double Vvir[derived_properties_chunk];
+		double concentration[derived_properties_chunk];
+		dark_matter_halos->halo_virial_velocity(&Mvir[first], &snap[first], count, Vvir);
+		dark_matter_halos->nfw_concentration(&Mvir[first], &snap[first], count, concentration);
+		for (unsigned long i = 0; i != count; i++) {
+			halos[first + i]->Vvir = Vvir[i];
+			halos[first + i]->concentration = concentration[i];
+		}
 	});
 	LOG(info) << "Calculated Vvir and concentration for new Halos in " << t;
+	record_memory("halo creation", batch);
 
 	return halos;
 }
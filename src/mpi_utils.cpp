@@ -0,0 +1,310 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * MPI-related utilities implementation
+ */
+
+#include <algorithm>
+#include <string>
+
+#include "config.h"
+#ifdef SHARK_MPI
+#include <mpi.h>
+#endif // SHARK_MPI
+
+#include "exceptions.h"
+#include "mpi_utils.h"
+
+namespace shark {
+
+namespace mpi {
+
+#ifdef SHARK_MPI
+
+Environment::Environment(int &argc, char **&argv)
+{
+	// Only the main thread communicates; OpenMP and I/O threads never do
+	int provided;
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+}
+
+Environment::~Environment()
+{
+	MPI_Finalize();
+}
+
+int rank()
+{
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	return rank;
+}
+
+int size()
+{
+	int size;
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	return size;
+}
+
+void abort(int error_code)
+{
+	MPI_Abort(MPI_COMM_WORLD, error_code);
+}
+
+namespace detail {
+
+template <typename T>
+void flatten(std::vector<double> &values, const std::vector<T> &v)
+{
+	values.insert(values.end(), v.begin(), v.end());
+}
+
+void flatten(std::vector<double> &values, const std::vector<BaryonBase> &v)
+{
+	for (auto &baryon: v) {
+		values.push_back(baryon.mass);
+		values.push_back(baryon.mass_metals);
+	}
+}
+
+// Maps are keyed by snapshot, but not all processes necessarily have
+// entries for the same snapshots, so they are flattened over all keys
+// up to the largest one across all processes
+void flatten(std::vector<double> &values, const std::map<int, double> &m, int n_keys)
+{
+	for (int key = 0; key != n_keys; key++) {
+		auto it = m.find(key);
+		values.push_back(it == m.end() ? 0 : it->second);
+	}
+}
+
+template <typename T>
+void unflatten(std::vector<double>::const_iterator &it, std::vector<T> &v)
+{
+	for (auto &x: v) {
+		x = T(*it++);
+	}
+}
+
+void unflatten(std::vector<double>::const_iterator &it, std::vector<BaryonBase> &v)
+{
+	for (auto &baryon: v) {
+		baryon.mass = float(*it++);
+		baryon.mass_metals = float(*it++);
+	}
+}
+
+void unflatten(std::vector<double>::const_iterator &it, std::map<int, double> &m, int n_keys)
+{
+	m.clear();
+	for (int key = 0; key != n_keys; key++) {
+		auto value = *it++;
+		if (value != 0) {
+			m[key] = value;
+		}
+	}
+}
+
+}  // namespace detail
+
+void sum_all(TotalBaryon &all_baryons)
+{
+	int n_keys = 0;
+	for (auto *m: {&all_baryons.baryon_total_created, &all_baryons.baryon_total_lost, &all_baryons.baryon_total_pruned}) {
+		if (!m->empty()) {
+			n_keys = std::max(n_keys, m->rbegin()->first + 1);
+		}
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &n_keys, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+	// All quantities are sent in a single reduction. All processes evolve the
+	// same snapshots, so all per-snapshot vectors have the same size everywhere
+	std::vector<std::vector<BaryonBase> *> baryons {
+		&all_baryons.mcold, &all_baryons.mstars, &all_baryons.mstars_burst_galaxymergers,
+		&all_baryons.mstars_burst_diskinstabilities, &all_baryons.mhot_halo, &all_baryons.mcold_halo,
+		&all_baryons.mejected_halo, &all_baryons.mBH, &all_baryons.mHI, &all_baryons.mH2, &all_baryons.mDM
+	};
+	std::vector<std::vector<int> *> counts {&all_baryons.major_mergers, &all_baryons.minor_mergers, &all_baryons.disk_instabil};
+
+	std::vector<double> values;
+	for (auto *v: baryons) {
+		detail::flatten(values, *v);
+	}
+	detail::flatten(values, all_baryons.SFR_disk);
+	detail::flatten(values, all_baryons.SFR_bulge);
+	for (auto *v: counts) {
+		detail::flatten(values, *v);
+	}
+	detail::flatten(values, all_baryons.baryon_total_created, n_keys);
+	detail::flatten(values, all_baryons.baryon_total_lost, n_keys);
+	detail::flatten(values, all_baryons.baryon_total_pruned, n_keys);
+
+	int n_values = int(values.size());
+	int max_values = n_values;
+	MPI_Allreduce(MPI_IN_PLACE, &max_values, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	if (max_values != n_values) {
+		throw exception("Baryon amounts tracked by different processes have different sizes");
+	}
+	MPI_Allreduce(MPI_IN_PLACE, values.data(), n_values, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+	std::vector<double>::const_iterator it = values.begin();
+	for (auto *v: baryons) {
+		detail::unflatten(it, *v);
+	}
+	detail::unflatten(it, all_baryons.SFR_disk);
+	detail::unflatten(it, all_baryons.SFR_bulge);
+	for (auto *v: counts) {
+		detail::unflatten(it, *v);
+	}
+	detail::unflatten(it, all_baryons.baryon_total_created, n_keys);
+	detail::unflatten(it, all_baryons.baryon_total_lost, n_keys);
+	detail::unflatten(it, all_baryons.baryon_total_pruned, n_keys);
+}
+
+std::size_t sum_all(std::size_t value)
+{
+	unsigned long long sum = value;
+	MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	return sum;
+}
+
+std::vector<double> gather_all(double value)
+{
+	std::vector<double> values(size());
+	MPI_Allgather(&value, 1, MPI_DOUBLE, values.data(), 1, MPI_DOUBLE, MPI_COMM_WORLD);
+	return values;
+}
+
+std::vector<std::string> exchange(const std::vector<std::string> &outgoing)
+{
+	auto n_procs = size();
+	auto this_rank = rank();
+	if (outgoing.size() != std::size_t(n_procs)) {
+		throw invalid_argument("one buffer must be given for each of the " + std::to_string(n_procs) + " processes");
+	}
+
+	std::vector<unsigned long long> send_sizes(n_procs), recv_sizes(n_procs);
+	for (int i = 0; i != n_procs; i++) {
+		send_sizes[i] = outgoing[i].size();
+	}
+	MPI_Alltoall(send_sizes.data(), 1, MPI_UNSIGNED_LONG_LONG, recv_sizes.data(), 1, MPI_UNSIGNED_LONG_LONG, MPI_COMM_WORLD);
+
+	// MPI counts are ints, so large buffers go in several messages,
+	// which arrive in the order they were sent
+	const unsigned long long max_message = 1ull << 30;
+	std::vector<std::string> incoming(n_procs);
+	std::vector<MPI_Request> requests;
+	for (int i = 0; i != n_procs; i++) {
+		if (i == this_rank) {
+			incoming[i] = outgoing[i];
+			continue;
+		}
+		incoming[i].resize(recv_sizes[i]);
+		for (unsigned long long offset = 0; offset < recv_sizes[i]; offset += max_message) {
+			MPI_Request request;
+			MPI_Irecv(&incoming[i][offset], int(std::min(max_message, recv_sizes[i] - offset)), MPI_BYTE, i, 0, MPI_COMM_WORLD, &request);
+			requests.push_back(request);
+		}
+	}
+	for (int i = 0; i != n_procs; i++) {
+		if (i == this_rank) {
+			continue;
+		}
+		for (unsigned long long offset = 0; offset < send_sizes[i]; offset += max_message) {
+			MPI_Request request;
+			MPI_Isend(const_cast<char *>(outgoing[i].data()) + offset, int(std::min(max_message, send_sizes[i] - offset)), MPI_BYTE, i, 0, MPI_COMM_WORLD, &request);
+			requests.push_back(request);
+		}
+	}
+	MPI_Waitall(int(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+	return incoming;
+}
+
+#else
+
+Environment::Environment(int &argc, char **&argv)
+{
+	// no-op
+}
+
+Environment::~Environment()
+{
+	// no-op
+}
+
+int rank()
+{
+	return 0;
+}
+
+int size()
+{
+	return 1;
+}
+
+void abort(int error_code)
+{
+	// no-op, the caller will exit with error_code anyway
+}
+
+void sum_all(TotalBaryon &all_baryons)
+{
+	// no-op, this is the only process
+}
+
+std::size_t sum_all(std::size_t value)
+{
+	return value;
+}
+
+std::vector<double> gather_all(double value)
+{
+	return {value};
+}
+
+std::vector<std::string> exchange(const std::vector<std::string> &outgoing)
+{
+	if (outgoing.size() != 1) {
+		throw invalid_argument("one buffer must be given for each of the 1 processes");
+	}
+	return outgoing;
+}
+
+#endif // SHARK_MPI
+
+std::vector<unsigned int> distribute_batches(const std::vector<unsigned int> &batches, int rank, int size)
+{
+	if (size <= 0 || rank < 0 || rank >= size) {
+		throw invalid_argument("invalid rank/size combination: " + std::to_string(rank) + "/" + std::to_string(size));
+	}
+
+	std::vector<unsigned int> assigned;
+	for (std::size_t i = rank; i < batches.size(); i += size) {
+		assigned.push_back(batches[i]);
+	}
+	return assigned;
+}
+
+}  // namespace mpi
+
+}  // namespace shark
@@ -0,0 +1,171 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Thread pinning and merger tree assignment implementation
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <sched.h>
+#endif // __linux__
+
+#include <boost/filesystem.hpp>
+
+#include "logging.h"
+#include "numa.h"
+#include "omp_utils.h"
+
+namespace shark {
+
+#ifdef __linux__
+
+/// @return The NUMA node of @p cpu, as seen in sysfs, or 0 if unknown
+static
+int numa_node(int cpu)
+{
+	namespace fs = boost::filesystem;
+	boost::system::error_code ec;
+	fs::directory_iterator it(fs::path("/sys/devices/system/cpu/cpu" + std::to_string(cpu)), ec);
+	for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+		auto name = it->path().filename().string();
+		if (name.compare(0, 4, "node") == 0 && name.size() > 4) {
+			return std::atoi(name.c_str() + 4);
+		}
+	}
+	return 0;
+}
+
+std::vector<ThreadPlacement> pin_threads(unsigned int threads)
+{
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		LOG(warning) << "Cannot find the CPUs this process can run on, threads are left unbound";
+		return {};
+	}
+
+	// CPUs sorted by NUMA node, so threads spread evenly over them are
+	// spread over nodes in proportion to their CPUs
+	std::vector<ThreadPlacement> cpus;
+	std::set<int> all_nodes;
+	for (int cpu = 0; cpu != CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &allowed)) {
+			cpus.push_back(ThreadPlacement {cpu, numa_node(cpu)});
+			all_nodes.insert(cpus.back().node);
+		}
+	}
+	std::stable_sort(cpus.begin(), cpus.end(), [](const ThreadPlacement &a, const ThreadPlacement &b) {
+		return a.node < b.node;
+	});
+
+	// If the OpenMP runtime binds threads itself we leave it do so.
+	// Otherwise threads are bound to all CPUs of their node, which keeps
+	// them close to their memory while letting the operating system balance
+	// them (and any thread they start) within the node
+	bool bind = std::getenv("OMP_PROC_BIND") == nullptr;
+	std::vector<ThreadPlacement> placements(threads, ThreadPlacement {-1, 0});
+	omp_per_thread(threads, [&](unsigned int t, int thread_idx) {
+		if (bind && t == static_cast<unsigned int>(thread_idx)) {
+			auto node = cpus[std::size_t(t) * cpus.size() / threads].node;
+			cpu_set_t node_cpus;
+			CPU_ZERO(&node_cpus);
+			for (auto &cpu: cpus) {
+				if (cpu.node == node) {
+					CPU_SET(cpu.cpu, &node_cpus);
+				}
+			}
+			if (sched_setaffinity(0, sizeof(node_cpus), &node_cpus) != 0) {
+				return;
+			}
+		}
+		placements[t].cpu = sched_getcpu();
+	});
+
+	std::set<int> nodes;
+	for (auto &placement: placements) {
+		if (placement.cpu < 0) {
+			LOG(warning) << "Threads could not be bound to CPUs, they are left unbound";
+			return {};
+		}
+		placement.node = numa_node(placement.cpu);
+		nodes.insert(placement.node);
+	}
+
+	std::ostringstream os;
+	os << (bind ? "Bound " : "OpenMP runtime binds ") << threads << " thread(s) to NUMA nodes";
+	for (auto &placement: placements) {
+		os << " " << placement.node;
+	}
+	os << " (" << nodes.size() << " out of " << all_nodes.size() << " node(s) used)";
+	LOG(info) << os.str();
+	return placements;
+}
+
+#else
+
+std::vector<ThreadPlacement> pin_threads(unsigned int threads)
+{
+	LOG(warning) << "Binding threads to CPUs is only supported on Linux, threads are left unbound";
+	return {};
+}
+
+#endif // __linux__
+
+TreeAssignment::TreeAssignment(const std::vector<std::size_t> &costs, unsigned int threads) :
+	offsets(std::max(threads, 1u) + 1, costs.size())
+{
+	// Each thread starts with the tree whose preceding trees add up to its
+	// share of the total cost
+	auto total = std::accumulate(costs.begin(), costs.end(), std::size_t(0));
+	std::size_t tree = 0, cost = 0;
+	offsets[0] = 0;
+	for (unsigned int thread = 1; thread != offsets.size() - 1; thread++) {
+		auto share = double(total) * thread / (offsets.size() - 1);
+		while (tree != costs.size() && cost + costs[tree] / 2. < share) {
+			cost += costs[tree++];
+		}
+		offsets[thread] = tree;
+	}
+}
+
+std::vector<std::size_t> TreeAssignment::tree_costs(const std::vector<MergerTreePtr> &merger_trees)
+{
+	std::vector<std::size_t> costs;
+	costs.reserve(merger_trees.size());
+	for (auto &tree: merger_trees) {
+		std::size_t n_halos = 0;
+		for (auto &snapshot_and_halos: tree->halos) {
+			n_halos += snapshot_and_halos.second.size();
+		}
+		costs.push_back(n_halos);
+	}
+	return costs;
+}
+
+}  // namespace shark
@@ -0,0 +1,165 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Per-galaxy ODE cost statistics implementation
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include "ode_costs.h"
+
+namespace shark {
+
+constexpr std::size_t ODECostHistogram::n_bins;
+
+std::size_t ODECostHistogram::bin(unsigned long int evaluations)
+{
+	std::size_t i = 0;
+	while (evaluations != 0 && i != n_bins - 1) {
+		evaluations >>= 1;
+		i++;
+	}
+	return i;
+}
+
+void ODECostHistogram::add(unsigned long int evaluations)
+{
+	bins[bin(evaluations)]++;
+}
+
+ODECostHistogram &ODECostHistogram::operator+=(const ODECostHistogram &other)
+{
+	for (std::size_t i = 0; i != n_bins; i++) {
+		bins[i] += other.bins[i];
+	}
+	return *this;
+}
+
+void ODECostHistogram::reset()
+{
+	bins.fill(0);
+}
+
+std::ostream &operator<<(std::ostream &os, const ODECostHistogram &histogram)
+{
+	bool first = true;
+	for (std::size_t i = 0; i != ODECostHistogram::n_bins; i++) {
+		if (histogram[i] == 0) {
+			continue;
+		}
+		if (!first) {
+			os << " ";
+		}
+		first = false;
+		if (i == 0) {
+			os << "[0]";
+		}
+		else if (i == 1) {
+			os << "[1]";
+		}
+		else {
+			os << "[" << (1UL << (i - 1)) << "-" << (1UL << i) - 1 << "]";
+		}
+		os << ":" << histogram[i];
+	}
+	if (first) {
+		os << "-";
+	}
+	return os;
+}
+
+static
+bool more_expensive(const ODECostRecord &a, const ODECostRecord &b)
+{
+	return a.evaluations > b.evaluations;
+}
+
+bool ODECostRanking::accepts(unsigned long int evaluations) const
+{
+	if (capacity == 0) {
+		return false;
+	}
+	return records.size() < capacity || evaluations > records.front().evaluations;
+}
+
+void ODECostRanking::add(ODECostRecord record)
+{
+	if (!accepts(record.evaluations)) {
+		return;
+	}
+	if (records.size() == capacity) {
+		std::pop_heap(records.begin(), records.end(), more_expensive);
+		records.pop_back();
+	}
+	records.emplace_back(std::move(record));
+	std::push_heap(records.begin(), records.end(), more_expensive);
+}
+
+ODECostRanking &ODECostRanking::operator+=(const ODECostRanking &other)
+{
+	for (auto &record: other.records) {
+		add(record);
+	}
+	return *this;
+}
+
+void ODECostRanking::reset()
+{
+	records.clear();
+}
+
+std::vector<ODECostRecord> ODECostRanking::sorted() const
+{
+	auto sorted_records = records;
+	std::sort(sorted_records.begin(), sorted_records.end(), more_expensive);
+	return sorted_records;
+}
+
+void ODECostRanking::write_csv_header(std::ostream &os, std::size_t dimension)
+{
+	os << "snapshot,galaxy_id,starburst,evaluations,"
+	   << "rgas,rstar,mcoolrate,jcold_halo,delta_t,redshift,vsubh,vgal";
+	for (std::size_t i = 0; i != dimension; i++) {
+		os << ",y" << i;
+	}
+	os << "\n";
+}
+
+void ODECostRanking::write_csv(std::ostream &os, int snapshot) const
+{
+	auto precision = os.precision(std::numeric_limits<double>::max_digits10);
+	for (auto &record: sorted()) {
+		os << snapshot << "," << record.galaxy_id << "," << record.starburst << "," << record.evaluations;
+		for (auto param: record.params) {
+			os << "," << param;
+		}
+		for (auto y: record.y0) {
+			os << "," << y;
+		}
+		os << "\n";
+	}
+	os.precision(precision);
+}
+
+}  // namespace shark
@@ -29,6 +29,7 @@
 #include "exceptions.h"
 #include "logging.h"
 #include "ode_solver.h"
+#include "profiling.h"
 
 #include <gsl/gsl_errno.h>
 
@@ -61,6 +62,26 @@ ODESolver::ODESolver(const std::vector<double> &y0, double t0, double delta_t, d
 	driver.reset(gsl_odeiv2_driver_alloc_y_new(ode_system.get(), gsl_odeiv2_step_rkck, delta_t, 0.0, precision));
 }
 
+ODESolver::ODESolver(std::size_t dimension, double precision, ode_evaluator evaluator) :
+	ODESolver(dimension, precision, evaluator, NULL, gsl_odeiv2_step_rkck)
+{
+	// no-op
+}
+
+ODESolver::ODESolver(std::size_t dimension, double precision, ode_evaluator evaluator, ode_jacobian jacobian, const gsl_odeiv2_step_type *stepper) :
+	y(),
+	t(0),
+	t0(0),
+	delta_t(0),
+	step(0),
+	ode_system(),
+	driver()
+{
+	// The initial step size is reset on each evolution
+	ode_system = std::shared_ptr<gsl_odeiv2_system>(new gsl_odeiv2_system{evaluator, jacobian, dimension, NULL});
+	driver.reset(gsl_odeiv2_driver_alloc_y_new(ode_system.get(), stepper, 1, 0.0, precision));
+}
+
 ODESolver::ODESolver(ODESolver &&odeSolver) :
 	y(odeSolver.y),
 	t(odeSolver.t),
@@ -84,10 +105,32 @@ std::vector<double> ODESolver::evolve() {
 	step++;
 	double t_i = t0 + step*delta_t;
 	int status = gsl_odeiv2_driver_apply(driver.get(), &t, t_i, y.data());
+	check_status(status);
+	return y;
+}
+
+void ODESolver::evolve(double y[], double delta_t, void *params, double h_start) {
+
+	SHARK_PROFILE(ODE_SOLVER);
+
+	if (h_start <= 0 || h_start > delta_t) {
+		h_start = delta_t;
+	}
+
+	// Resetting the driver leaves it in the same state as a newly allocated
+	// one with an initial step of h_start
+	ode_system->params = params;
+	gsl_odeiv2_driver_reset_hstart(driver.get(), h_start);
+	t = 0;
+	int status = gsl_odeiv2_driver_apply(driver.get(), &t, delta_t, y);
+	check_status(status);
+}
+
+void ODESolver::check_status(int status) {
 
 	// TODO: add compiler-dependent likelihood macro
 	if (status == GSL_SUCCESS) {
-		return y;
+		return;
 	}
 
 	//TEST: forcing integration to finish regardless of accuracy issue in three cases.
@@ -96,15 +139,13 @@ std::vector<double> ODESolver::evolve() {
 	os << "Error while solving ODE system: ";
 	if (status == GSL_FAILURE) {
 		os << "step size decreases below machine precision ";
-		LOG(warning) << "ODE: step size decreases below machine precision. Will force integration to finish regardless of desired accuracy not reached.";
-		status = GSL_SUCCESS;
-		return y;
+		LOG_LIMITED(warning) << "ODE: step size decreases below machine precision. Will force integration to finish regardless of desired accuracy not reached.";
+		return;
 	}
 	if (status == GSL_ENOPROG) {
 		os << "step size dropped below minimum value";
-		LOG(warning) << "ODE:step size dropped below minimum value. Will force integration to finish regardless of desired accuracy not reached.";
-		status = GSL_SUCCESS;
-		return y;
+		LOG_LIMITED(warning) << "ODE:step size dropped below minimum value. Will force integration to finish regardless of desired accuracy not reached.";
+		return;
 	}
 	else if (status == GSL_EBADFUNC) {
 		os << "user function signaled an error";
@@ -112,9 +153,8 @@ std::vector<double> ODESolver::evolve() {
 	}
 	else if (status == GSL_EMAXITER) {
 		os << "maximum number of steps reached";
-		LOG(warning) << "ODE:maximum number of steps reached. Will force integration to finish regardless of desired accuracy not reached.";
-		status = GSL_SUCCESS;
-		return y;
+		LOG_LIMITED(warning) << "ODE:maximum number of steps reached. Will force integration to finish regardless of desired accuracy not reached.";
+		return;
 	}
 	else {
 		os << "unexpected GSL error: " << gsl_strerror(status);
@@ -128,6 +168,14 @@ unsigned long int ODESolver::num_evaluations()
 	return driver->n;
 }
 
+double ODESolver::mean_step() const
+{
+	if (driver->n == 0) {
+		return 0;
+	}
+	return t / driver->n;
+}
+
 ODESolver &ODESolver::operator=(ODESolver &&other) {
 
 	// Normal moving of values
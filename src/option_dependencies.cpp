@@ -0,0 +1,97 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Implementation of OptionDependencies class methods
+ */
+
+#include <algorithm>
+#include <limits>
+#include <set>
+
+#include "execution.h"
+#include "option_dependencies.h"
+#include "reionisation.h"
+#include "simulation.h"
+
+namespace shark {
+
+void OptionDependencies::never(const std::string &name)
+{
+	declarations[name] = [](const Options &) {
+		return -std::numeric_limits<double>::infinity();
+	};
+}
+
+void OptionDependencies::acts_below(const std::string &name, redshift_function redshift)
+{
+	declarations[name] = std::move(redshift);
+}
+
+std::map<std::string, double> OptionDependencies::changes(const Options &before, const Options &after) const
+{
+	auto &values_before = before.values();
+	auto &values_after = after.values();
+	std::set<std::string> names;
+	for (auto &option: values_before) {
+		names.insert(option.first);
+	}
+	for (auto &option: values_after) {
+		names.insert(option.first);
+	}
+
+	std::map<std::string, double> changed;
+	for (auto &name: names) {
+		auto it_before = values_before.find(name);
+		auto it_after = values_after.find(name);
+		if (it_before != values_before.end() && it_after != values_after.end() && it_before->second == it_after->second) {
+			continue;
+		}
+
+		auto declaration = declarations.find(name);
+		if (declaration == declarations.end()) {
+			changed[name] = std::numeric_limits<double>::infinity();
+		}
+		else {
+			changed[name] = std::max(declaration->second(before), declaration->second(after));
+		}
+	}
+	return changed;
+}
+
+static
+OptionDependencies _shark_options()
+{
+	OptionDependencies dependencies;
+	ExecutionParameters::declare_dependencies(dependencies);
+	ReionisationParameters::declare_dependencies(dependencies);
+	SimulationParameters::declare_dependencies(dependencies);
+	return dependencies;
+}
+
+const OptionDependencies &OptionDependencies::shark_options()
+{
+	static const OptionDependencies dependencies = _shark_options();
+	return dependencies;
+}
+
+}  // namespace shark
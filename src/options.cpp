@@ -52,6 +52,17 @@ Options::Options(const string &fname) :
 	add_file(fname);
 }
 
+Options::Options(const options_t &options) :
+	options(options)
+{
+	// no-op
+}
+
+const Options::options_t &Options::values() const
+{
+	return options;
+}
+
 void Options::add_file(const string &fname) {
 
 	LOG(info) << "Loading options from " << fname;
@@ -268,9 +279,12 @@ Options::file_format_t Options::get<Options::file_format_t>(const std::string &n
 	else if ( lowered == "ascii" ) {
 		return Options::ASCII;
 	}
+	else if ( lowered == "columnar" ) {
+		return Options::COLUMNAR;
+	}
 
 	std::ostringstream os;
-	os << name << " option value invalid: " << value << ". Either hdf5 or ascii was expected";
+	os << name << " option value invalid: " << value << ". Supported values are hdf5, ascii and columnar";
 	throw invalid_option(os.str());
 }
 
@@ -320,6 +334,11 @@ std::vector<double> Options::get<std::vector<double>>(const std::string &name, c
 	return values;
 }
 
+template<>
+std::vector<std::string> Options::get<std::vector<std::string>>(const std::string &name, const std::string &value) const {
+	return tokenize(value, " ,");
+}
+
 template<>
 std::set<int> Options::get<std::set<int>>(const std::string &name, const std::string &value) const {
 	return _read_ranges<std::set<int>>(name, value);
@@ -0,0 +1,405 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Implementation of the OutputComparison class
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <regex>
+#include <set>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "omp_utils.h"
+#include "output_comparison.h"
+#include "hdf5/reader.h"
+
+namespace shark {
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+/// The HDF5 files under @p root, relative to it, or "" if @p root is a file
+std::vector<std::string> hdf5_files(const fs::path &root)
+{
+	if (fs::is_regular_file(root)) {
+		return {""};
+	}
+	if (!fs::is_directory(root)) {
+		throw invalid_argument(root.string() + " is neither a directory nor a file");
+	}
+
+	auto prefix_length = root.generic_string().size() + 1;
+	std::vector<std::string> files;
+	for (fs::recursive_directory_iterator it(root), end; it != end; ++it) {
+		if (fs::is_regular_file(it->status()) && it->path().extension() == ".hdf5") {
+			files.push_back(it->path().generic_string().substr(prefix_length));
+		}
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+std::string file_path(const std::string &root, const std::string &file)
+{
+	return file.empty() ? root : (fs::path(root) / file).string();
+}
+
+struct tolerance {
+	double absolute;
+	double relative;
+};
+
+/// Compiled patterns of the comparison parameters
+class dataset_matcher {
+
+public:
+	explicit dataset_matcher(const OutputComparisonParameters &params) :
+		default_tolerance {params.absolute_tolerance, params.relative_tolerance}
+	{
+		for (auto &t: params.tolerances) {
+			tolerances.emplace_back(std::regex(t.datasets), tolerance {t.absolute, t.relative});
+		}
+		for (auto &pattern: params.excluded_datasets) {
+			excluded.emplace_back(pattern);
+		}
+	}
+
+	bool is_excluded(const std::string &dataset) const
+	{
+		return std::any_of(excluded.begin(), excluded.end(), [&dataset](const std::regex &pattern) {
+			return std::regex_match(dataset, pattern);
+		});
+	}
+
+	tolerance get_tolerance(const std::string &dataset) const
+	{
+		for (auto &t: tolerances) {
+			if (std::regex_match(dataset, t.first)) {
+				return t.second;
+			}
+		}
+		return default_tolerance;
+	}
+
+private:
+	tolerance default_tolerance;
+	std::vector<std::pair<std::regex, tolerance>> tolerances;
+	std::vector<std::regex> excluded;
+};
+
+/// The outcome of comparing a pair of files
+struct file_comparison {
+	std::vector<std::string> missing;
+	std::vector<std::string> mismatched_shapes;
+	std::vector<PropertyDifferences> properties;
+	std::vector<GalaxyDifferences> galaxies;
+};
+
+/// Opens and closes both files while holding the HDF5 library lock
+struct file_pair {
+
+	file_pair(const std::string &reference, const std::string &other)
+	{
+		hdf5::library_lock lock;
+		readers[0].reset(new hdf5::Reader(reference));
+		readers[1].reset(new hdf5::Reader(other));
+	}
+
+	~file_pair()
+	{
+		hdf5::library_lock lock;
+		readers[0].reset();
+		readers[1].reset();
+	}
+
+	std::unique_ptr<hdf5::Reader> readers[2];
+};
+
+std::set<std::string> included_datasets(const hdf5::Reader &reader, const dataset_matcher &matcher)
+{
+	std::set<std::string> names;
+	for (auto &name: reader.get_dataset_names()) {
+		if (!matcher.is_excluded(name)) {
+			names.insert(name);
+		}
+	}
+	return names;
+}
+
+std::vector<double> read_values(const hdf5::Reader &reader, const std::string &name, std::size_t size)
+{
+	std::vector<double> values(size);
+	reader.read_dataset_into(name, mutable_span<double>(values));
+	return values;
+}
+
+const std::string galaxy_ids = "galaxies/id_galaxy";
+const std::string galaxies_group = "galaxies/";
+
+file_comparison compare_files(const std::string &file, const std::string &reference, const std::string &other,
+                              const dataset_matcher &matcher, std::size_t max_galaxies)
+{
+	file_comparison comparison;
+	file_pair files(file_path(reference, file), file_path(other, file));
+	auto &reference_reader = *files.readers[0];
+	auto &other_reader = *files.readers[1];
+
+	// Only one thread reads at a time while the others compare the values
+	// they already read
+	std::set<std::string> reference_datasets, other_datasets;
+	std::vector<std::int64_t> ids;
+	{
+		hdf5::library_lock lock;
+		reference_datasets = included_datasets(reference_reader, matcher);
+		other_datasets = included_datasets(other_reader, matcher);
+		if (reference_reader.exists(galaxy_ids) && reference_reader.is_numeric_dataset(galaxy_ids)) {
+			ids.resize(reference_reader.get_dataset_rows(galaxy_ids));
+			reference_reader.read_dataset_into(galaxy_ids, mutable_span<std::int64_t>(ids));
+		}
+	}
+
+	std::vector<std::string> common;
+	for (auto &name: reference_datasets) {
+		if (other_datasets.find(name) == other_datasets.end()) {
+			comparison.missing.push_back(file + ":" + name);
+		}
+		else {
+			common.push_back(name);
+		}
+	}
+	for (auto &name: other_datasets) {
+		if (reference_datasets.find(name) == reference_datasets.end()) {
+			comparison.missing.push_back(file + ":" + name);
+		}
+	}
+
+	// Properties differing in each row of the galaxies group
+	std::vector<std::size_t> galaxy_differences(ids.size(), 0);
+	std::vector<char> differing_rows(ids.size());
+
+	for (auto &name: common) {
+
+		std::vector<double> reference_values, other_values;
+		std::size_t rows = 0;
+		{
+			hdf5::library_lock lock;
+			if (!reference_reader.is_numeric_dataset(name) || !other_reader.is_numeric_dataset(name)) {
+				continue;
+			}
+			auto dimensions = reference_reader.get_dataset_dimensions(name);
+			if (dimensions != other_reader.get_dataset_dimensions(name)) {
+				comparison.mismatched_shapes.push_back(file + ":" + name);
+				continue;
+			}
+			std::size_t size = 1;
+			for (auto dimension: dimensions) {
+				size *= dimension;
+			}
+			rows = dimensions.empty() ? 0 : dimensions[0];
+			reference_values = read_values(reference_reader, name, size);
+			other_values = read_values(other_reader, name, size);
+		}
+
+		PropertyDifferences property;
+		property.name = name;
+		property.files = 1;
+		property.values = reference_values.size();
+
+		bool per_galaxy = !ids.empty() && rows == ids.size() && name.compare(0, galaxies_group.size(), galaxies_group) == 0;
+		std::size_t columns = (rows == 0) ? 1 : reference_values.size() / rows;
+		if (per_galaxy) {
+			std::fill(differing_rows.begin(), differing_rows.end(), 0);
+		}
+
+		auto tol = matcher.get_tolerance(name);
+		for (std::size_t i = 0; i != reference_values.size(); i++) {
+			double a = reference_values[i];
+			double b = other_values[i];
+			if (a == b || (std::isnan(a) && std::isnan(b))) {
+				continue;
+			}
+			double difference = std::abs(a - b);
+			double magnitude = std::max(std::abs(a), std::abs(b));
+			if (difference <= tol.absolute + tol.relative * magnitude) {
+				continue;
+			}
+			property.differing_values++;
+			property.max_absolute_difference = std::max(property.max_absolute_difference, difference);
+			property.max_relative_difference = std::max(property.max_relative_difference, difference / magnitude);
+			if (per_galaxy) {
+				differing_rows[i / columns] = 1;
+			}
+		}
+
+		if (per_galaxy) {
+			for (std::size_t row = 0; row != ids.size(); row++) {
+				galaxy_differences[row] += differing_rows[row];
+			}
+		}
+		comparison.properties.push_back(std::move(property));
+	}
+
+	for (std::size_t row = 0; row != ids.size(); row++) {
+		if (galaxy_differences[row] > 0) {
+			comparison.galaxies.push_back(GalaxyDifferences {file, ids[row], galaxy_differences[row]});
+		}
+	}
+	auto most_different = [](const GalaxyDifferences &a, const GalaxyDifferences &b) {
+		return a.differing_properties > b.differing_properties;
+	};
+	std::stable_sort(comparison.galaxies.begin(), comparison.galaxies.end(), most_different);
+	if (comparison.galaxies.size() > max_galaxies) {
+		comparison.galaxies.resize(max_galaxies);
+	}
+
+	return comparison;
+}
+
+void add(PropertyDifferences &total, const PropertyDifferences &other)
+{
+	total.files += other.files;
+	total.values += other.values;
+	total.differing_values += other.differing_values;
+	total.max_absolute_difference = std::max(total.max_absolute_difference, other.max_absolute_difference);
+	total.max_relative_difference = std::max(total.max_relative_difference, other.max_relative_difference);
+}
+
+}  // anonymous namespace
+
+OutputComparison::OutputComparison(const std::string &reference, const std::string &other, const OutputComparisonParameters &params)
+{
+	dataset_matcher matcher(params);
+
+	auto reference_files = hdf5_files(reference);
+	auto other_files = hdf5_files(other);
+	std::vector<std::string> common;
+	std::set_intersection(reference_files.begin(), reference_files.end(), other_files.begin(), other_files.end(),
+	                      std::back_inserter(common));
+	std::set_symmetric_difference(reference_files.begin(), reference_files.end(), other_files.begin(), other_files.end(),
+	                              std::back_inserter(missing));
+
+	// Files are combined in order, so results don't depend on scheduling
+	std::vector<file_comparison> comparisons(common.size());
+	std::vector<std::exception_ptr> errors(common.size());
+	omp_dynamic_for(std::size_t(0), common.size(), std::max(params.threads, 1u), 1, [&](std::size_t i, int thread_idx) {
+		try {
+			comparisons[i] = compare_files(common[i], reference, other, matcher, params.max_galaxies);
+		} catch (...) {
+			errors[i] = std::current_exception();
+		}
+	});
+	for (auto &error: errors) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	compared_files = common.size();
+	std::map<std::string, PropertyDifferences> properties_by_name;
+	for (auto &comparison: comparisons) {
+		missing.insert(missing.end(), comparison.missing.begin(), comparison.missing.end());
+		mismatched_shapes.insert(mismatched_shapes.end(), comparison.mismatched_shapes.begin(), comparison.mismatched_shapes.end());
+		galaxies.insert(galaxies.end(), comparison.galaxies.begin(), comparison.galaxies.end());
+		for (auto &property: comparison.properties) {
+			auto &total = properties_by_name[property.name];
+			total.name = property.name;
+			add(total, property);
+		}
+	}
+	for (auto &property: properties_by_name) {
+		properties.push_back(std::move(property.second));
+	}
+
+	std::stable_sort(galaxies.begin(), galaxies.end(), [](const GalaxyDifferences &a, const GalaxyDifferences &b) {
+		return a.differing_properties > b.differing_properties;
+	});
+	if (galaxies.size() > params.max_galaxies) {
+		galaxies.resize(params.max_galaxies);
+	}
+}
+
+bool OutputComparison::equal() const
+{
+	return missing.empty() && mismatched_shapes.empty() &&
+	       std::none_of(properties.begin(), properties.end(), [](const PropertyDifferences &property) {
+		return property.differing_values > 0;
+	});
+}
+
+void OutputComparison::write(std::ostream &os) const
+{
+	std::size_t values = 0, differing_values = 0, differing_properties = 0;
+	for (auto &property: properties) {
+		values += property.values;
+		differing_values += property.differing_values;
+		differing_properties += (property.differing_values > 0);
+	}
+	os << "Compared " << values << " values of " << properties.size() << " properties in "
+	   << compared_files << " files: " << differing_values << " values of "
+	   << differing_properties << " properties differ" << std::endl;
+
+	for (auto &name: missing) {
+		os << "Only in one of the outputs: " << name << std::endl;
+	}
+	for (auto &name: mismatched_shapes) {
+		os << "Different shapes: " << name << std::endl;
+	}
+
+	if (differing_properties > 0) {
+		os << std::endl << "Differing properties:" << std::endl;
+		os << std::setw(50) << std::left << "property" << std::right
+		   << std::setw(8) << "files" << std::setw(14) << "values" << std::setw(14) << "differing"
+		   << std::setw(14) << "max abs" << std::setw(14) << "max rel" << std::endl;
+		for (auto &property: properties) {
+			if (property.differing_values == 0) {
+				continue;
+			}
+			os << std::setw(50) << std::left << property.name << std::right
+			   << std::setw(8) << property.files << std::setw(14) << property.values
+			   << std::setw(14) << property.differing_values
+			   << std::setw(14) << std::setprecision(4) << property.max_absolute_difference
+			   << std::setw(14) << std::setprecision(4) << property.max_relative_difference << std::endl;
+		}
+	}
+
+	if (!galaxies.empty()) {
+		os << std::endl << "Galaxies with most differing properties:" << std::endl;
+		os << std::setw(50) << std::left << "file" << std::right
+		   << std::setw(22) << "id_galaxy" << std::setw(12) << "properties" << std::endl;
+		for (auto &galaxy: galaxies) {
+			os << std::setw(50) << std::left << galaxy.file << std::right
+			   << std::setw(22) << galaxy.id_galaxy << std::setw(12) << galaxy.differing_properties << std::endl;
+		}
+	}
+}
+
+}  // namespace shark
@@ -23,7 +23,10 @@
  * Physical model classes implementation
  */
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -33,7 +36,30 @@
 
 namespace shark {
 
+/**
+ * Calculates the star formation rate of the system in state @p y, together
+ * with the cold gas metallicity and the angular momentum transfer rate it
+ * uses.
+ */
 static
+double star_formation_rate(BasicPhysicalModel &model, const BasicPhysicalModel::solver_params &params, const double y[], double &zcold, double &jrate)
+{
+	auto &invariants = params.invariants;
+
+	// Define angular momentum parameters.
+	double jgas = invariants.jgas; /*current sAM of the cold gas*/
+	jrate = 0;
+
+	// Define current gas metallicity and angular momentum.
+	zcold = invariants.zmin; /*cold gas minimum metallicity*/
+	if(y[1] > 0 && y[6] > 0) {
+		zcold = y[6] / y[1];
+		jgas  = y[13] / y[1];
+	}
+
+	return model.star_formation.star_formation_rate(y[1], y[0], invariants.disk, zcold, params.burst, params.vgal, jrate, jgas);
+}
+
 int basic_physicalmodel_evaluator(double t, const double y[], double f[], void *data) {
 
 	/** Functions describing the time derivatives of:
@@ -54,46 +80,38 @@ int basic_physicalmodel_evaluator(double t, const double y[], double f[], void *
 	 * f[14]: total angular momentum of the ejected gas component.
 	 */
 
+	// Only BasicPhysicalModel solves this system, so there's no need to check
+	// the type of the model on every evaluation
 	auto params= reinterpret_cast<BasicPhysicalModel::solver_params *>(data);
-	BasicPhysicalModel &model = dynamic_cast<BasicPhysicalModel &>(params->model);
+	BasicPhysicalModel &model = static_cast<BasicPhysicalModel &>(params->model);
+	auto &invariants = params->invariants;
 
-	double R = model.recycling_parameters.recycle; /*recycling fraction of newly formed stars*/
-
-	double yield = model.recycling_parameters.yield; /*yield of newly formed stars*/
+	double yield = invariants.yield; /*yield of newly formed stars*/
 
 	double mcoolrate = params->mcoolrate; /*cooling rate in units of Msun/Gyr*/
 
-	// Define minimum gas metallicities.
-	double zcold = model.gas_cooling_parameters.pre_enrich_z; /*cold gas minimum metallicity*/
-	double zhot = model.gas_cooling_parameters.pre_enrich_z; /*hot gas minimum metallicity*/
-
-	// Define angular momentum parameters.
-	double jgas = 2.0 * params->vgal * params->rgas / constants::RDISK_HALF_SCALE; /*current sAM of the cold gas*/
-	double jrate = 0; /*variable that saves the angular momentum transfer rate from gas to stars*/
-
-	// Define current gas metallicity and angular momentum.
-	if(y[1] > 0 && y[6] > 0) {
-		zcold = y[6] / y[1];
-		jgas  = y[13] / y[1];
-	}
+	// Define minimum hot gas metallicity.
+	double zhot = invariants.zmin; /*hot gas minimum metallicity*/
 
 	// Define current hot gas metallicity.
 	if(y[2] > 0 && y[7] > 0) {
 		zhot = y[7] / y[2];
 	}
 
-	// Calculate SFR.
-	double SFR   = model.star_formation.star_formation_rate(y[1], y[0], params->rgas, params->rstar, zcold, params->redshift, params->burst, params->vgal, jrate, jgas);
+	// Calculate SFR, current cold gas metallicity, and the angular momentum
+	// transfer rate from gas to stars.
+	double zcold, jrate;
+	double SFR = star_formation_rate(model, *params, y, zcold, jrate);
 
 	// Initialize mass loading and angular momentum loading parameters.
 	double beta1 = 0, beta2 = 0;
 	double betaj_1 = 0, betaj_2 = 0;
 
 	// Calculate mass and angular momentum loading from stellar feedback process.
-	model.stellar_feedback.outflow_rate(SFR, params->vsubh, params->vgal, params->redshift, beta1, beta2, betaj_1, betaj_2); /*mass loading parameter*/
+	model.stellar_feedback.outflow_rate(SFR, invariants.outflows, beta1, beta2, betaj_1, betaj_2); /*mass loading parameter*/
 
 	// Retained fraction.
-	double rsub = 1.0-R;
+	double rsub = invariants.rsub;
 
 	// Mass transfer equations.
 	f[0] = SFR * rsub;
@@ -123,14 +141,111 @@ int basic_physicalmodel_evaluator(double t, const double y[], double f[], void *
 	return 0;
 }
 
+static
+int basic_physicalmodel_jacobian(double t, const double y[], double *dfdy, double dfdt[], void *data) {
+
+	/**
+	 * The Jacobian of the system defined by basic_physicalmodel_evaluator.
+	 * All equations are linear in the SFR and in the angular momentum
+	 * transfer rate, with coefficients depending on the gas metallicities
+	 * and the mass loading factors. Those are differentiated analytically,
+	 * while the derivatives of the SFR and the angular momentum transfer rate
+	 * (only dependent on y[0], y[1], y[6] and y[13]) are calculated with
+	 * finite differences, as they involve an integral over the disk.
+	 * Mass loading factors don't depend on the SFR other than through its
+	 * sign, and are therefore considered constant.
+	 */
+
+	constexpr std::size_t NC = std::tuple_size<BasicPhysicalModel::state_t>::value;
+
+	auto params= reinterpret_cast<BasicPhysicalModel::solver_params *>(data);
+	BasicPhysicalModel &model = static_cast<BasicPhysicalModel &>(params->model);
+
+	auto &invariants = params->invariants;
+	double yield = invariants.yield;
+	double mcoolrate = params->mcoolrate;
+	double rsub = invariants.rsub;
+
+	double zcold, jrate;
+	double SFR = star_formation_rate(model, *params, y, zcold, jrate);
+
+	double beta1 = 0, beta2 = 0;
+	double betaj_1 = 0, betaj_2 = 0;
+	model.stellar_feedback.outflow_rate(SFR, invariants.outflows, beta1, beta2, betaj_1, betaj_2);
+
+	// Derivatives of the SFR and angular momentum transfer rate
+	std::array<double, NC> dSFR {};
+	std::array<double, NC> djrate {};
+	std::array<double, NC> y_h;
+	std::copy(y, y + NC, y_h.begin());
+	for (auto k: {0, 1, 6, 13}) {
+		double h = std::sqrt(std::numeric_limits<double>::epsilon()) * std::max(std::abs(y[k]), 1.);
+		y_h[k] = y[k] + h;
+		h = y_h[k] - y[k];
+		double zcold_h, jrate_h;
+		double SFR_h = star_formation_rate(model, *params, y_h.data(), zcold_h, jrate_h);
+		dSFR[k] = (SFR_h - SFR) / h;
+		djrate[k] = (jrate_h - jrate) / h;
+		y_h[k] = y[k];
+	}
+
+	// Derivatives of the metallicities
+	std::array<double, NC> dzcold {};
+	std::array<double, NC> dzhot {};
+	if(y[1] > 0 && y[6] > 0) {
+		dzcold[1] = -y[6] / (y[1] * y[1]);
+		dzcold[6] = 1 / y[1];
+	}
+	if(y[2] > 0 && y[7] > 0) {
+		dzhot[2] = -y[7] / (y[2] * y[2]);
+		dzhot[7] = 1 / y[2];
+	}
+
+	std::fill(dfdy, dfdy + NC * NC, 0.);
+	std::fill(dfdt, dfdt + NC, 0.);
+	for (std::size_t k = 0; k != NC; k++) {
+
+		auto df = [&](std::size_t i) -> double & {
+			return dfdy[i * NC + k];
+		};
+
+		// d(zcold * SFR) / dy[k]
+		double dzSFR = dzcold[k] * SFR + zcold * dSFR[k];
+
+		df(0) = rsub * dSFR[k];
+		df(1) = -(rsub + beta1) * dSFR[k];
+		df(3) = (beta1 - beta2) * dSFR[k];
+		df(4) = beta2 * dSFR[k];
+
+		df(5) = rsub * dzSFR;
+		df(6) = mcoolrate * dzhot[k] + dSFR[k] * (yield - (rsub + beta1) * zcold) - SFR * (rsub + beta1) * dzcold[k];
+		df(7) = - mcoolrate * dzhot[k];
+		df(8) = (beta1 - beta2) * dzSFR;
+		df(9) = beta2 * dzSFR;
+
+		df(10) = dSFR[k];
+		df(11) = dzSFR;
+
+		df(12) = rsub * djrate[k];
+		df(13) = -(rsub + betaj_1) * djrate[k];
+		df(15) = (betaj_1 - betaj_2) * djrate[k];
+		df(16) = betaj_2 * djrate[k];
+	}
+
+	return 0;
+}
+
 BasicPhysicalModel::BasicPhysicalModel(
 		double ode_solver_precision,
+		const gsl_odeiv2_step_type *stepper,
+		const gsl_odeiv2_step_type *starburst_stepper,
+		bool warm_start_ode,
 		GasCooling gas_cooling,
 		StellarFeedback stellar_feedback,
 		StarFormation star_formation,
 		RecyclingParameters recycling_parameters,
 		GasCoolingParameters gas_cooling_parameters) :
-	PhysicalModel(ode_solver_precision, basic_physicalmodel_evaluator, gas_cooling),
+	PhysicalModel(ode_solver_precision, basic_physicalmodel_evaluator, basic_physicalmodel_jacobian, stepper, starburst_stepper, warm_start_ode, gas_cooling),
 	stellar_feedback(stellar_feedback),
 	star_formation(star_formation),
 	recycling_parameters(recycling_parameters),
@@ -139,7 +254,21 @@ BasicPhysicalModel::BasicPhysicalModel(
 	// no-op
 }
 
-std::vector<double> BasicPhysicalModel::from_galaxy(const Subhalo &subhalo, const Galaxy &galaxy)
+void BasicPhysicalModel::prepare_solver_params(solver_params &params)
+{
+	// The velocities, sizes and redshift are fixed during the evolution, so
+	// are the mass loading factors (save for their dependency on the SFR)
+	// and the physical sizes of the disk
+	auto &invariants = params.invariants;
+	invariants.outflows = stellar_feedback.get_outflow_factors(params.vsubh, params.vgal, params.redshift);
+	invariants.disk = star_formation.get_disk_properties(params.rgas, params.rstar, params.redshift);
+	invariants.jgas = 2.0 * params.vgal * params.rgas / constants::RDISK_HALF_SCALE;
+	invariants.rsub = 1.0 - recycling_parameters.recycle;
+	invariants.yield = recycling_parameters.yield;
+	invariants.zmin = gas_cooling_parameters.pre_enrich_z;
+}
+
+BasicPhysicalModel::state_t BasicPhysicalModel::from_galaxy(const Subhalo &subhalo, const Galaxy &galaxy)
 {
 
 	/** Variables introduced to solve ODE equations.
@@ -165,7 +294,7 @@ std::vector<double> BasicPhysicalModel::from_galaxy(const Subhalo &subhalo, cons
 	 *
 	 */
 
-	std::vector<double> y(17);
+	state_t y {};
 
 	// Define mass inputs.
 	y[0] = galaxy.disk_stars.mass;
@@ -195,7 +324,7 @@ std::vector<double> BasicPhysicalModel::from_galaxy(const Subhalo &subhalo, cons
 	return y;
 }
 
-void BasicPhysicalModel::to_galaxy(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t)
+void BasicPhysicalModel::to_galaxy(const state_t &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t)
 {
 	using namespace constants;
 
@@ -300,7 +429,7 @@ void BasicPhysicalModel::to_galaxy(const std::vector<double> &y, Subhalo &subhal
 }
 
 
-std::vector<double> BasicPhysicalModel::from_galaxy_starburst(const Subhalo &subhalo, const Galaxy &galaxy)
+BasicPhysicalModel::state_t BasicPhysicalModel::from_galaxy_starburst(const Subhalo &subhalo, const Galaxy &galaxy)
 {
 	/** Variables introduced to solve ODE equations.
 	 * y[0]: stellar mass of galaxy.
@@ -325,7 +454,7 @@ std::vector<double> BasicPhysicalModel::from_galaxy_starburst(const Subhalo &sub
 	 *
 	 */
 
-	std::vector<double> y(17);
+	state_t y {};
 
 	// Define mass inputs.
 	y[0] = galaxy.bulge_stars.mass;
@@ -350,7 +479,7 @@ std::vector<double> BasicPhysicalModel::from_galaxy_starburst(const Subhalo &sub
 	return y;
 }
 
-void BasicPhysicalModel::to_galaxy_starburst(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger)
+void BasicPhysicalModel::to_galaxy_starburst(const state_t &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger)
 {
 	using namespace constants;
 
@@ -0,0 +1,151 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Low-overhead, per-thread timing of the main physics modules
+ */
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+#include "profiling.h"
+#include "utils.h"
+
+namespace shark {
+
+namespace profiling {
+
+namespace {
+
+/**
+ * The counters of all threads that have measured something. Threads register
+ * their counters once, the only time a lock is needed while measuring.
+ */
+struct counters_registry {
+
+	std::mutex mutex;
+	std::vector<std::unique_ptr<thread_counters>> counters;
+
+	// Ticks are converted into time using the ticks and time elapsed since
+	// the registry was created
+	std::uint64_t ticks0 = ticks();
+	std::chrono::steady_clock::time_point time0 = std::chrono::steady_clock::now();
+
+	thread_counters *add()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		counters.emplace_back(new thread_counters());
+		return counters.back().get();
+	}
+
+	double millis_per_tick()
+	{
+		auto elapsed_ticks = ticks() - ticks0;
+		auto elapsed = std::chrono::steady_clock::now() - time0;
+		if (elapsed_ticks == 0) {
+			return 0;
+		}
+		return std::chrono::duration<double, std::milli>(elapsed).count() / elapsed_ticks;
+	}
+};
+
+counters_registry &registry()
+{
+	static counters_registry the_registry;
+	return the_registry;
+}
+
+}  // anonymous namespace
+
+const char *region_name(region_t region)
+{
+	switch (region) {
+	case GAS_COOLING:
+		return "gas_cooling";
+	case STAR_FORMATION:
+		return "star_formation";
+	case MOLECULAR_GAS:
+		return "molecular_gas";
+	case ODE_SOLVER:
+		return "ode_solver";
+	case GALAXY_MERGERS:
+		return "galaxy_mergers";
+	case SUBHALO_MERGERS:
+		return "subhalo_mergers";
+	case DISK_INSTABILITY:
+		return "disk_instability";
+	default:
+		return "unknown";
+	}
+}
+
+thread_counters &local_counters()
+{
+	thread_local thread_counters *counters = registry().add();
+	return *counters;
+}
+
+std::vector<region_totals> collect()
+{
+	auto &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	auto millis_per_tick = reg.millis_per_tick();
+
+	std::vector<region_totals> totals;
+	for (int region = 0; region != N_REGIONS; region++) {
+		region_totals total {region_t(region), 0, 0};
+		for (auto &counters: reg.counters) {
+			total.calls += counters->calls[region];
+			total.millis += counters->ticks[region] * millis_per_tick;
+		}
+		totals.push_back(total);
+	}
+	return totals;
+}
+
+void reset()
+{
+	auto &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	for (auto &counters: reg.counters) {
+		*counters = thread_counters();
+	}
+}
+
+void write_table(std::ostream &os, const std::vector<region_totals> &totals, double thread_millis)
+{
+	os << "  " << std::left << std::setw(18) << "Region" << std::right
+	   << std::setw(14) << "Calls" << std::setw(14) << "Time [ms]"
+	   << std::setw(12) << "Mean [us]" << std::setw(11) << "Share [%]";
+	for (auto &total: totals) {
+		double mean_micros = (total.calls == 0) ? 0 : total.millis * 1000 / total.calls;
+		double share = (thread_millis <= 0) ? 0 : total.millis * 100 / thread_millis;
+		os << "\n  " << std::left << std::setw(18) << region_name(total.region) << std::right
+		   << std::setw(14) << total.calls << std::setw(14) << fixed<3>(total.millis)
+		   << std::setw(12) << fixed<3>(mean_micros) << std::setw(11) << fixed<1>(share);
+	}
+}
+
+}  // namespace profiling
+
+}  // namespace shark
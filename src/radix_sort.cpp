@@ -0,0 +1,137 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Radix sort implementation
+ */
+
+#include <algorithm>
+
+#include "omp_utils.h"
+#include "radix_sort.h"
+
+namespace shark {
+
+namespace {
+
+constexpr unsigned int digit_bits = 8;
+constexpr std::size_t n_digit_values = std::size_t(1) << digit_bits;
+constexpr unsigned int n_passes = 64 / digit_bits;
+
+// Flipping the sign bit makes unsigned comparisons order signed keys correctly
+inline std::uint64_t to_unsigned(std::int64_t key)
+{
+	return std::uint64_t(key) ^ (std::uint64_t(1) << 63);
+}
+
+inline std::int64_t to_signed(std::uint64_t key)
+{
+	return std::int64_t(key ^ (std::uint64_t(1) << 63));
+}
+
+inline std::size_t digit(std::uint64_t key, unsigned int pass)
+{
+	return (key >> (pass * digit_bits)) & (n_digit_values - 1);
+}
+
+}  // anonymous namespace
+
+std::vector<std::size_t> radix_sort(std::vector<std::int64_t> &keys, unsigned int threads)
+{
+	auto n = keys.size();
+	unsigned int n_blocks = std::max(threads, 1u);
+	auto block_size = (n + n_blocks - 1) / n_blocks;
+	auto block_range = [&](unsigned int block) {
+		auto first = std::min(n, block * block_size);
+		return std::make_pair(first, std::min(n, first + block_size));
+	};
+
+	// Keys and indices are moved back and forth between these on each pass.
+	// Bits that change between keys tell which passes are actually needed
+	std::vector<std::uint64_t> ukeys(n), ukeys_out(n);
+	std::vector<std::size_t> indices(n), indices_out(n);
+	std::vector<std::uint64_t> block_or(n_blocks, 0), block_and(n_blocks, ~std::uint64_t(0));
+	omp_static_for(0u, n_blocks, threads, [&](unsigned int block, int thread_idx) {
+		auto range = block_range(block);
+		for (auto i = range.first; i != range.second; i++) {
+			auto key = to_unsigned(keys[i]);
+			ukeys[i] = key;
+			indices[i] = i;
+			block_or[block] |= key;
+			block_and[block] &= key;
+		}
+	});
+	std::uint64_t all_or = 0, all_and = ~std::uint64_t(0);
+	for (unsigned int block = 0; block != n_blocks; block++) {
+		all_or |= block_or[block];
+		all_and &= block_and[block];
+	}
+	auto changing_bits = all_or ^ all_and;
+
+	std::vector<std::size_t> offsets(n_blocks * n_digit_values);
+	for (unsigned int pass = 0; pass != n_passes; pass++) {
+
+		if (digit(changing_bits, pass) == 0) {
+			continue;
+		}
+
+		// Count digit values per block, then turn them into the position
+		// where each block writes its first key with each digit value
+		omp_static_for(0u, n_blocks, threads, [&](unsigned int block, int thread_idx) {
+			auto block_offsets = &offsets[block * n_digit_values];
+			std::fill(block_offsets, block_offsets + n_digit_values, 0);
+			auto range = block_range(block);
+			for (auto i = range.first; i != range.second; i++) {
+				block_offsets[digit(ukeys[i], pass)]++;
+			}
+		});
+		std::size_t position = 0;
+		for (std::size_t value = 0; value != n_digit_values; value++) {
+			for (unsigned int block = 0; block != n_blocks; block++) {
+				auto &offset = offsets[block * n_digit_values + value];
+				auto count = offset;
+				offset = position;
+				position += count;
+			}
+		}
+
+		omp_static_for(0u, n_blocks, threads, [&](unsigned int block, int thread_idx) {
+			auto block_offsets = &offsets[block * n_digit_values];
+			auto range = block_range(block);
+			for (auto i = range.first; i != range.second; i++) {
+				auto &offset = block_offsets[digit(ukeys[i], pass)];
+				ukeys_out[offset] = ukeys[i];
+				indices_out[offset] = indices[i];
+				offset++;
+			}
+		});
+		std::swap(ukeys, ukeys_out);
+		std::swap(indices, indices_out);
+	}
+
+	omp_static_for(std::size_t(0), n, threads, [&](std::size_t i, int thread_idx) {
+		keys[i] = to_signed(ukeys[i]);
+	});
+	return indices;
+}
+
+}  // namespace shark
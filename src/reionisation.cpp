@@ -23,10 +23,12 @@
 
 #include <cmath>
 #include <fstream>
+#include <limits>
 #include <map>
 #include <tuple>
 
 #include "logging.h"
+#include "option_dependencies.h"
 #include "reionisation.h"
 #include "utils.h"
 
@@ -41,6 +43,19 @@ ReionisationParameters::ReionisationParameters(const Options &options)
 
 }
 
+void ReionisationParameters::declare_dependencies(OptionDependencies &dependencies)
+{
+	// Both models reionise halos only below zcut
+	auto zcut = [](const Options &options) {
+		double zcut = 0;
+		options.load("reionisation.zcut", zcut, true);
+		return zcut;
+	};
+	for (auto name: {"reionisation.vcut", "reionisation.zcut", "reionisation.alpha_v", "reionisation.model"}) {
+		dependencies.acts_below(name, zcut);
+	}
+}
+
 template <>
 ReionisationParameters::ReionisationModel
 Options::get<ReionisationParameters::ReionisationModel>(const std::string &name, const std::string &value) const {
@@ -67,18 +82,21 @@ Reionisation::~Reionisation()
 {
 }
 
-bool Lacey16Reionisation::reionised_halo(double v, double z) const
+double Lacey16Reionisation::velocity_threshold(double z) const
 {
 	auto &params = get_reionisation_params();
-	return (v < params.vcut && z < params.zcut);
+	if (z < params.zcut) {
+		return params.vcut;
+	}
+	return -std::numeric_limits<double>::infinity();
 }
 
-bool Sobacchi13Reionisation::reionised_halo(double v, double z) const
+double Sobacchi13Reionisation::velocity_threshold(double z) const
 {
 	using std::pow;
 	auto &params = get_reionisation_params();
-	double vthresh = params.vcut * pow(1.0 + z, params.alpha_v) * pow((1.0 - pow((1.0 + z) /(1.0 + params.zcut), 2.0)), 0.833);
-	return v < vthresh;
+	// NaN for redshifts above zcut, which no velocity is smaller than
+	return params.vcut * pow(1.0 + z, params.alpha_v) * pow((1.0 - pow((1.0 + z) /(1.0 + params.zcut), 2.0)), 0.833);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Estimation of the resources needed to evolve simulation batches
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include "components.h"
+#include "exceptions.h"
+#include "logging.h"
+#include "merger_tree_reader.h"
+#include "resource_estimator.h"
+#include "utils.h"
+#include "hdf5/reader.h"
+
+namespace shark {
+
+ResourceCosts::ResourceCosts() :
+	// Structures take about twice their size once allocator overheads,
+	// indices and per-thread buffers are accounted for
+	bytes_per_subhalo(2. * (sizeof(Subhalo) + sizeof(Halo) + sizeof(Galaxy))),
+	base_bytes(256. * 1024 * 1024),
+	import_micros_per_subhalo(2),
+	galaxies_per_subhalo(1),
+	evolution_micros_per_galaxy(50)
+{
+	// no-op
+}
+
+static
+std::vector<std::string> split_csv_line(const std::string &line)
+{
+	std::vector<std::string> fields;
+	std::istringstream is(line);
+	std::string field;
+	while (std::getline(is, field, ',')) {
+		fields.push_back(field);
+	}
+	return fields;
+}
+
+ResourceCosts ResourceCosts::calibrate(std::istream &metrics)
+{
+	std::string line;
+	std::getline(metrics, line);
+	auto header = split_csv_line(line);
+	auto column = [&header](const std::string &name) {
+		auto it = std::find(header.begin(), header.end(), name);
+		if (it == header.end()) {
+			throw invalid_data("metrics file has no " + name + " column");
+		}
+		return std::size_t(it - header.begin());
+	};
+	auto subhalos_column = column("n_subhalos");
+	auto galaxies_column = column("n_galaxies");
+	auto time_column = column("total_time");
+	auto peak_rss_column = column("peak_rss");
+	auto threads = std::count_if(header.begin(), header.end(), [](const std::string &name) {
+		return name.compare(0, 17, "busy_time_thread_") == 0;
+	});
+
+	// Each subhalo of the merger trees is part of a single snapshot, so the
+	// subhalos of all snapshots are all subhalos in memory
+	double subhalos = 0, galaxies = 0, thread_millis = 0, peak_rss = 0;
+	while (std::getline(metrics, line)) {
+		auto fields = split_csv_line(line);
+		if (fields.size() != header.size()) {
+			continue;
+		}
+		subhalos += std::stod(fields[subhalos_column]);
+		galaxies += std::stod(fields[galaxies_column]);
+		thread_millis += std::stod(fields[time_column]) * std::max(threads, decltype(threads)(1));
+		peak_rss = std::max(peak_rss, std::stod(fields[peak_rss_column]));
+	}
+	if (subhalos == 0 || galaxies == 0) {
+		throw invalid_data("metrics file has no evolved galaxies to calibrate costs with");
+	}
+
+	// The base memory of the calibrating execution is spread across its
+	// subhalos, which are the best guide for similar batches
+	ResourceCosts costs;
+	costs.bytes_per_subhalo = peak_rss / subhalos;
+	costs.base_bytes = 0;
+	costs.galaxies_per_subhalo = galaxies / subhalos;
+	costs.evolution_micros_per_galaxy = thread_millis * 1000 / galaxies;
+	return costs;
+}
+
+ResourceEstimator::ResourceEstimator(const SimulationParameters &simulation_params, const ExecutionParameters &exec_params,
+                                     unsigned int threads, const ResourceCosts &costs) :
+	simulation_params(simulation_params),
+	exec_params(exec_params),
+	threads(std::max(threads, 1u)),
+	costs(costs)
+{
+	// no-op
+}
+
+std::vector<BatchEstimate> ResourceEstimator::estimate() const
+{
+	std::vector<BatchEstimate> estimates;
+	for (auto batch: exec_params.simulation_batches) {
+		estimates.push_back(estimate(batch));
+	}
+	return estimates;
+}
+
+BatchEstimate ResourceEstimator::estimate(unsigned int batch) const
+{
+	auto fname = SURFSReader::get_filename(simulation_params.tree_files_prefix, batch);
+	hdf5::Reader batch_file(fname);
+	auto n_batches = batch_file.read_attribute<unsigned int>("fileInfo/numberOfFiles");
+	if (batch >= n_batches) {
+		std::ostringstream os;
+		os << "Batch " << batch << " is not within [0, " << n_batches << ")";
+		throw invalid_option(os.str());
+	}
+
+	// Only the snapshots needed by the evolution are read, which the
+	// snapshot index of the file (if any) tells without reading any rows
+	unsigned long subhalos = 0;
+	if (batch_file.exists("treeIndex")) {
+		auto first_snapshot = simulation_params.min_snapshot;
+		auto last_snapshot = exec_params.last_output_snapshot() + 1;
+		auto snapshots = batch_file.read_dataset_v<int>("treeIndex/snapshotNumber");
+		auto n_rows = batch_file.read_dataset_v<std::int64_t>("treeIndex/numberOfRows");
+		for (std::size_t i = 0; i != snapshots.size(); i++) {
+			if (snapshots[i] >= first_snapshot && snapshots[i] <= last_snapshot) {
+				subhalos += n_rows[i];
+			}
+		}
+	}
+	else {
+		subhalos = batch_file.get_dataset_rows("haloTrees/nodeMass");
+	}
+
+	auto galaxies = subhalos * costs.galaxies_per_subhalo;
+	BatchEstimate estimate {batch, subhalos,
+	                        std::size_t(costs.base_bytes + subhalos * costs.bytes_per_subhalo),
+	                        subhalos * costs.import_micros_per_subhalo / 1e6,
+	                        galaxies * costs.evolution_micros_per_galaxy / threads / 1e6};
+	LOG(info) << "Batch " << batch << " has " << subhalos << " subhalos, needing an estimated "
+	          << memory_amount(estimate.peak_memory) << " of memory, " << fixed<1>(estimate.import_seconds)
+	          << " [s] to import and " << fixed<1>(estimate.evolution_seconds) << " [s] to evolve with "
+	          << threads << " thread(s)";
+	return estimate;
+}
+
+void ResourceEstimator::write_csv(std::ostream &os, const std::vector<BatchEstimate> &estimates)
+{
+	os << "batch,subhalos,peak_memory,import_time,evolution_time\n";
+	for (auto &estimate: estimates) {
+		os << estimate.batch << "," << estimate.subhalos << "," << estimate.peak_memory << ","
+		   << fixed<1>(estimate.import_seconds) << "," << fixed<1>(estimate.evolution_seconds) << "\n";
+	}
+}
+
+}  // namespace shark
@@ -0,0 +1,129 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Implementation of the plain C interface
+ */
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include "exceptions.h"
+#include "options.h"
+#include "shark_c.h"
+#include "shark_session.h"
+
+struct shark_session {
+	std::unique_ptr<shark::SharkSession> session;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+// Runs @p f, translating exceptions into -1 return codes
+template <typename F>
+int translate_exceptions(F &&f)
+{
+	try {
+		last_error.clear();
+		f();
+		return 0;
+	} catch (const std::exception &e) {
+		last_error = e.what();
+	} catch (...) {
+		last_error = "unknown error";
+	}
+	return -1;
+}
+
+void check_session(const shark_session *session)
+{
+	if (!session) {
+		throw shark::invalid_argument("session is NULL");
+	}
+}
+
+}  // anonymous namespace
+
+shark_session *shark_session_create(const char *const *config_files, size_t n_config_files, unsigned int threads)
+{
+	std::unique_ptr<shark_session> session(new shark_session());
+	auto result = translate_exceptions([&]() {
+		shark::Options options;
+		for (size_t i = 0; i != n_config_files; i++) {
+			options.add_file(config_files[i]);
+		}
+		session->session.reset(new shark::SharkSession(options, std::max(threads, 1u)));
+	});
+	return result == 0 ? session.release() : nullptr;
+}
+
+void shark_session_destroy(shark_session *session)
+{
+	delete session;
+}
+
+int shark_session_set_option(shark_session *session, const char *optspec)
+{
+	return translate_exceptions([&]() {
+		check_session(session);
+		session->session->set(optspec);
+	});
+}
+
+int shark_session_reset_options(shark_session *session)
+{
+	return translate_exceptions([&]() {
+		check_session(session);
+		session->session->reset();
+	});
+}
+
+int shark_session_run(shark_session *session)
+{
+	return translate_exceptions([&]() {
+		check_session(session);
+		session->session->run();
+	});
+}
+
+int shark_session_get_statistic(shark_session *session, int snapshot, const char *name, double *values, size_t n_values, size_t *n_total)
+{
+	return translate_exceptions([&]() {
+		check_session(session);
+		auto stat = session->session->get(snapshot, name);
+		if (values) {
+			std::copy_n(stat.begin(), std::min(n_values, stat.size()), values);
+		}
+		if (n_total) {
+			*n_total = stat.size();
+		}
+	});
+}
+
+const char *shark_last_error(void)
+{
+	return last_error.c_str();
+}
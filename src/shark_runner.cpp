@@ -23,27 +23,50 @@
  * Main shark runner class
  */
 
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
 #include <memory>
 #include <numeric>
 #include <ostream>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include <boost/filesystem.hpp>
+
+#include "background_worker.h"
+#include "checkpoint.h"
 #include "components.h"
 #include "evolve_halos.h"
+#include "exceptions.h"
 #include "execution.h"
 #include "disk_instability.h"
 #include "environment.h"
 #include "galaxy_creator.h"
 #include "galaxy_mergers.h"
 #include "galaxy_writer.h"
+#include "huge_pages.h"
 #include "logging.h"
+#include "memory_tracker.h"
 #include "merger_tree_reader.h"
+#include "mpi_utils.h"
+#include "numa.h"
 #include "omp_utils.h"
+#include "option_dependencies.h"
 #include "options.h"
 #include "physical_model.h"
+#include "profiling.h"
 #include "shark_runner.h"
+#include "status_file.h"
+#include "summary_statistics.h"
 #include "timer.h"
+#include "tracing.h"
 #include "tree_builder.h"
+#include "tree_cache.h"
+#include "tree_index.h"
+#include "tree_migration.h"
+#include "utils.h"
 
 namespace shark {
 
@@ -57,10 +80,15 @@ namespace shark {
 struct PerThreadObjects
 {
 	PerThreadObjects(std::shared_ptr<BasicPhysicalModel> &&physical_model, GalaxyMergers &&galaxy_megers, DiskInstability &&disk_instability):
-		physical_model(std::move(physical_model)), galaxy_mergers(std::move(galaxy_megers)), disk_instability(std::move(disk_instability)) {}
+		physical_model(std::move(physical_model)), galaxy_mergers(std::move(galaxy_megers)), disk_instability(std::move(disk_instability)),
+		star_formation(this->physical_model->star_formation) {}
 	std::shared_ptr<BasicPhysicalModel> physical_model;
 	GalaxyMergers galaxy_mergers;
 	DiskInstability disk_instability;
+	/// The physical model's, also used to calculate molecular gas
+	StarFormation &star_formation;
+	/// Time spent by this thread evolving galaxies in the current snapshot
+	Timer::duration busy_micros = 0;
 };
 
 /// impl class definition
@@ -74,11 +102,11 @@ public:
 	    environment_params(options), exec_params(options),
 	    gas_cooling_params(options),recycling_params(options), reincorporation_params(options),
 	    simulation_params(options), star_formation_params(options),
-	    cosmology(make_cosmology(cosmo_params)),
+	    cosmology(make_cosmology(cosmo_params, simulation_params.redshifts)),
 	    dark_matter_halos(make_dark_matter_halos(dark_matter_halo_params, cosmology, simulation_params, exec_params)),
-	    writer(make_galaxy_writer(exec_params, cosmo_params, cosmology, dark_matter_halos, simulation_params)),
 	    simulation(simulation_params, cosmology),
-	    star_formation(star_formation_params, recycling_params, cosmology)
+	    star_formation(star_formation_params, recycling_params, cosmology),
+	    memory_tracker(std::size_t(double(exec_params.memory_budget) * 1024 * 1024 * 1024))
 	{
 		create_per_thread_objects();
 	}
@@ -86,6 +114,26 @@ public:
 	/// @see SharkRunner::run
 	void run();
 
+	/// @see SharkRunner::run(std::map<int, SummaryStatistics> &)
+	void run(std::map<int, SummaryStatistics> &summaries);
+
+	/// The output directory of this model, without the snapshot
+	std::string model_directory() const;
+
+	/// Throws an invalid_option exception if this model and @p other cannot
+	/// be evolved over the same merger trees
+	void check_can_share_trees(const impl &other) const;
+
+	/// Merger trees built by the first model importing them are kept in
+	/// @p trees, and later models load them from there
+	void share_trees(const std::shared_ptr<std::stringstream> &trees);
+
+	/// @see SharkRunner::import_trees
+	void import_shared_trees();
+
+	/// The galaxy and starburst ODE evaluations of all evolved snapshots
+	unsigned long get_ode_evaluations() const { return ode_evaluations; }
+
 private:
 	Options options;
 	unsigned int threads;
@@ -100,42 +148,258 @@ private:
 	StarFormationParameters star_formation_params;
 	CosmologyPtr cosmology;
 	DarkMatterHalosPtr dark_matter_halos;
-	GalaxyWriterPtr writer;
+	GalaxyWriterPtr writer {};
 	Simulation simulation;
 	StarFormation star_formation;
 	std::vector<PerThreadObjects> thread_objects {};
 	TotalBaryon all_baryons {};
 
+	/// ODE evaluations per galaxy measured for each merger tree on the last
+	/// evolved snapshot, used to estimate tree costs when scheduling
+	std::vector<double> tree_costs {};
+
+	/// Wall time and ODE evaluations spent on each merger tree during the
+	/// snapshot being evolved
+	std::vector<Timer::duration> tree_micros {};
+	std::vector<unsigned long> tree_evaluations {};
+
+	/// Wall time spent on each merger tree over all evolved snapshots
+	std::vector<Timer::duration> tree_total_micros {};
+
+	/// The thread creating and evolving each merger tree, if
+	/// execution.numa_placement is on
+	TreeAssignment tree_assignment {};
+
+	/// Distribution of the total wall time, in [us], of all evolved merger trees
+	ODECostHistogram tree_time_histogram {};
+
+	/// The number of galaxy IDs handed out by the GalaxyCreator
+	Galaxy::id_t n_galaxy_ids = 0;
+
+	/// The galaxy and starburst ODE evaluations of all evolved snapshots
+	unsigned long ode_evaluations = 0;
+
+	/// Flat view over the merger trees being evolved
+	std::unique_ptr<TreeIndex> tree_index {};
+
+	/// Molecular gas of the galaxies of the snapshot being evolved, filled
+	/// during the galaxy evolution itself if execution.fused_molecular_gas is on,
+	/// and how it is calculated
+	molgas_per_galaxy molgas_per_gal {};
+	bool molgas_calc_j = false;
+	ExecutionParameters::tracked_molecular_gas_t molgas_mode = ExecutionParameters::MOLGAS_FULL;
+
+	/// Phases each merger tree goes through right after it is evolved, if
+	/// execution.pipelined_snapshots is on
+	struct TreePipeline {
+		BaryonTracker tracker;
+		/// Null if this snapshot is output or streamed, which needs all
+		/// galaxies still in place
+		std::unique_ptr<GalaxyTransfer> transfer;
+		/// Galaxies seen by each thread before being transferred
+		std::vector<std::size_t> galaxies;
+	};
+	std::unique_ptr<TreePipeline> tree_pipeline {};
+
+	/// Per-snapshot performance metrics, if execution.metrics_file is given
+	std::unique_ptr<std::ofstream> metrics_stream {};
+
+	/// Per-snapshot most expensive ODE systems, if execution.ode_costs_file is given
+	std::unique_ptr<std::ofstream> ode_costs_stream {};
+
+	/// Progress of the execution, if execution.status_file is given
+	std::unique_ptr<StatusFile> status_file {};
+
+	/// Memory used after each phase, checked against execution.memory_budget
+	MemoryTracker memory_tracker;
+
+	/// Merger trees shared with other models evolved by the same runner
+	std::shared_ptr<std::stringstream> shared_trees {};
+
+	/// Summary statistics of each output snapshot, if kept in memory
+	/// instead of writing outputs
+	std::map<int, SummaryStatistics> *summaries = nullptr;
+
+	/// Merger trees of the next batch group, and the baryons created with
+	/// them, imported in the background if execution.prefetch_threads > 0
+	std::vector<MergerTreePtr> prefetched_trees {};
+	TotalBaryon prefetched_baryons {};
+	bool prefetching = false;
+
+	/// Imports the prefetched merger trees. Destroyed first, as its job
+	/// uses the members above
+	std::unique_ptr<BackgroundWorker> prefetcher {};
+
 	void create_per_thread_objects();
+	void open_metrics_file();
+	void report_phase(const std::string &phase, int snapshot = -1);
+	std::vector<std::vector<unsigned int>> group_batches();
+	void run_batches(const std::vector<unsigned int> &batches, const std::string &directory_suffix, const std::vector<unsigned int> *next_batches);
+	void write_global_properties(TotalBaryon &global_baryons);
+	void release_snapshot(const std::vector<MergerTreePtr> &merger_trees, int snapshot);
+	void migrate_trees(std::vector<MergerTreePtr> &merger_trees, int snapshot);
 	std::vector<MergerTreePtr> import_trees();
+	std::vector<MergerTreePtr> build_trees();
+	std::vector<MergerTreePtr> build_trees(const ExecutionParameters &params, unsigned int build_threads, TotalBaryon &baryons, MemoryTracker *tracker);
+	void prefetch_trees(const std::vector<unsigned int> &batches);
+	std::vector<MergerTreePtr> take_prefetched_trees();
+	std::vector<MergerTreePtr> place_trees(std::vector<MergerTreePtr> &&trees);
 	void evolve_merger_trees(const std::vector<MergerTreePtr> &merger_trees, int snapshot);
-	void evolve_merger_tree(const MergerTreePtr &tree, int thread_idx, int snapshot, double z, double delta_t);
-	molgas_per_galaxy get_molecular_gas(const std::vector<HaloPtr> &halos, double x, bool calc_j);
+	void evolve_merger_tree(std::size_t tree_idx, int thread_idx, int snapshot, double z, double delta_t);
+	void evolve_and_measure_merger_tree(std::size_t tree_idx, int thread_idx, int snapshot, double z, double delta_t);
+	void finish_merger_tree(std::size_t tree_idx, int thread_idx, int snapshot);
+	void evolve_halo(const HaloPtr &halo, int thread_idx, int snapshot, double z, double delta_t);
+	void merge_galaxies(const HaloPtr &halo, int thread_idx, int snapshot, double delta_t);
+	void evolve_galaxies(span<SubhaloPtr> subhalos, int thread_idx, double z, double delta_t);
+	void merge_subhalos(std::size_t tree_idx, int thread_idx, int snapshot, double z);
+	void evolve_halos_in_parallel(const std::vector<MergerTreePtr> &merger_trees, const std::vector<HaloPtr> &halos, int snapshot, double z, double delta_t);
+	void evolve_merger_trees_dynamically(const std::vector<MergerTreePtr> &merger_trees, int snapshot, double z, double delta_t);
+	std::vector<std::size_t> schedule_merger_trees(const std::vector<std::size_t> &n_galaxies);
+	molgas_per_galaxy get_molecular_gas(const std::vector<HaloPtr> &halos, double x, bool calc_j, bool approximate);
+	void write_checkpoint(const std::vector<MergerTreePtr> &merger_trees, int snapshot);
+	int restore_checkpoint(const std::vector<MergerTreePtr> &merger_trees);
+	void check_branch(const Checkpoint &checkpoint);
+	void adapt_to_memory_budget(const MemoryUsage &usage);
 };
 
 // Wiring pimpl to the original class
 SharkRunner::SharkRunner(const Options &options, unsigned int threads) :
-    pimpl(std::unique_ptr<impl>(new impl(options, threads)))
+    SharkRunner(std::vector<Options> {options}, threads)
 {
 }
 
+SharkRunner::SharkRunner(const std::vector<Options> &models, unsigned int threads)
+{
+	if (models.empty()) {
+		throw invalid_argument("SharkRunner needs the options of at least one model");
+	}
+	for (auto &options: models) {
+		pimpls.emplace_back(new impl(options, threads));
+	}
+	if (pimpls.size() == 1) {
+		return;
+	}
+
+	auto trees = std::make_shared<std::stringstream>();
+	for (std::size_t i = 0; i != pimpls.size(); i++) {
+		for (std::size_t j = i + 1; j != pimpls.size(); j++) {
+			pimpls[i]->check_can_share_trees(*pimpls[j]);
+		}
+		pimpls[i]->share_trees(trees);
+	}
+}
+
+SharkRunner::SharkRunner(const Options &options, unsigned int threads, const std::shared_ptr<std::stringstream> &trees)
+{
+	pimpls.emplace_back(new impl(options, threads));
+	pimpls[0]->share_trees(trees);
+}
+
 SharkRunner::~SharkRunner() = default;
 
 void SharkRunner::run()
 {
-	pimpl->run();
+	auto n_models = pimpls.size();
+	for (std::size_t i = 0; i != n_models; i++) {
+		if (n_models > 1) {
+			LOG(info) << "Evolving model " << i + 1 << "/" << n_models << " into " << pimpls[i]->model_directory();
+		}
+		pimpls[i]->run();
+		ode_evaluations += pimpls[i]->get_ode_evaluations();
+
+		// Only the galaxies of one model are kept in memory at a time
+		pimpls[i].reset();
+	}
+}
+
+void SharkRunner::import_trees()
+{
+	for (auto &pimpl: pimpls) {
+		pimpl->import_shared_trees();
+	}
+}
+
+void SharkRunner::run(std::map<int, SummaryStatistics> &summaries)
+{
+	if (pimpls.size() != 1) {
+		throw invalid_argument("summary statistics can be kept in memory only when running a single model");
+	}
+	pimpls[0]->run(summaries);
+	ode_evaluations += pimpls[0]->get_ode_evaluations();
+	pimpls[0].reset();
+}
+
+/// The wall time and ODE evaluations spent on a merger tree during a snapshot
+struct TreeCost {
+	long tree_id;
+	double millis;
+	unsigned long evaluations;
+};
+
+template <typename T>
+std::basic_ostream<T> &operator<<(std::basic_ostream<T> &os, const std::vector<TreeCost> &costs)
+{
+	if (costs.empty()) {
+		os << "-";
+	}
+	for (std::size_t i = 0; i != costs.size(); i++) {
+		os << (i == 0 ? "" : ", ") << costs[i].tree_id << " (" << fixed<3>(costs[i].millis)
+		   << " [ms], " << costs[i].evaluations << " evals)";
+	}
+	return os;
 }
 
 struct SnapshotStatistics {
 
 	int snapshot;
 	unsigned long starform_integration_intervals;
+	unsigned long starform_integrations;
+	unsigned long starform_integration_failures;
 	unsigned long galaxy_ode_evaluations;
 	unsigned long starburst_ode_evaluations;
+	unsigned long fast_path_hits;
 	std::size_t n_halos;
 	std::size_t n_subhalos;
 	std::size_t n_galaxies;
-	Timer::duration duration_millis;
+	double duration_millis;
+	double evolution_millis;
+	double molgas_millis;
+	double tracking_millis;
+	double output_millis;
+	double transfer_millis;
+	std::vector<double> thread_busy_millis;
+	std::size_t peak_rss;
+	double cooling_millis;
+	std::size_t rss;
+	std::size_t huge_pages;
+	ODECostHistogram galaxy_ode_histogram;
+	ODECostHistogram starburst_ode_histogram;
+	std::vector<TreeCost> slowest_trees;
+	std::vector<TreeCost> most_evaluated_trees;
+
+	double mean_thread_busy_millis() const {
+		if (thread_busy_millis.empty()) {
+			return 0;
+		}
+		return std::accumulate(thread_busy_millis.begin(), thread_busy_millis.end(), 0.) / thread_busy_millis.size();
+	}
+
+	double max_thread_busy_millis() const {
+		if (thread_busy_millis.empty()) {
+			return 0;
+		}
+		return *std::max_element(thread_busy_millis.begin(), thread_busy_millis.end());
+	}
+
+	/// The ratio between the busy time of the busiest thread and the mean
+	/// busy time of all threads; 1 means a perfectly balanced evolution
+	double load_imbalance() const {
+		auto mean_millis = mean_thread_busy_millis();
+		if (mean_millis == 0) {
+			return 0;
+		}
+		return max_thread_busy_millis() / mean_millis;
+	}
 
 	double galaxy_ode_evaluations_per_galaxy() const {
 		if (n_galaxies == 0) {
@@ -157,6 +421,41 @@ struct SnapshotStatistics {
 		}
 		return static_cast<double>(starform_integration_intervals) / galaxy_ode_evaluations;
 	}
+
+	double starform_integration_failure_rate() const {
+		if (starform_integrations == 0) {
+			return 0;
+		}
+		return static_cast<double>(starform_integration_failures) / starform_integrations;
+	}
+
+	/// Writes the header of the CSV-formatted metrics for @p threads threads
+	static void write_csv_header(std::ostream &os, unsigned int threads)
+	{
+		os << "snapshot,n_halos,n_subhalos,n_galaxies,"
+		   << "galaxy_ode_evaluations,starburst_ode_evaluations,fast_path_hits,starform_integration_intervals,"
+		   << "starform_integrations,starform_integration_failures,"
+		   << "evolution_time,molgas_time,tracking_time,output_time,transfer_time,total_time,peak_rss,cooling_time,rss,huge_pages,load_imbalance";
+		for (unsigned int i = 0; i != threads; i++) {
+			os << ",busy_time_thread_" << i;
+		}
+		os << "\n";
+	}
+
+	/// Writes these statistics as a CSV-formatted line; times are in [ms],
+	/// memory in [bytes]
+	void write_csv(std::ostream &os) const
+	{
+		os << snapshot << "," << n_halos << "," << n_subhalos << "," << n_galaxies << ","
+		   << galaxy_ode_evaluations << "," << starburst_ode_evaluations << "," << fast_path_hits << "," << starform_integration_intervals << ","
+		   << starform_integrations << "," << starform_integration_failures << ","
+		   << fixed<3>(evolution_millis) << "," << fixed<3>(molgas_millis) << "," << fixed<3>(tracking_millis) << ","
+		   << fixed<3>(output_millis) << "," << fixed<3>(transfer_millis) << "," << fixed<3>(duration_millis) << "," << peak_rss << "," << fixed<3>(cooling_millis) << "," << rss << "," << huge_pages << "," << fixed<3>(load_imbalance());
+		for (auto busy_millis: thread_busy_millis) {
+			os << "," << fixed<3>(busy_millis);
+		}
+		os << "\n";
+	}
 };
 
 template <typename T>
@@ -170,13 +469,38 @@ std::basic_ostream<T> &operator<<(std::basic_ostream<T> &os, const SnapshotStati
 	   << " (" << fixed<3>(stats.galaxy_ode_evaluations_per_galaxy()) << " [evals/gal])" << "\n"
 	   << "  Starburst ODE evaluations:            " << stats.starburst_ode_evaluations
 	   << " (" << fixed<3>(stats.starburst_ode_evaluations_per_galaxy()) << " [evals/gal])" << "\n"
+	   << "  Stationary ODE systems not solved:    " << stats.fast_path_hits << "\n"
+	   << "  Galaxy ODE evaluations histogram:     " << stats.galaxy_ode_histogram << "\n"
+	   << "  Starburst ODE evaluations histogram:  " << stats.starburst_ode_histogram << "\n"
 	   << "  Star formation integration intervals: " << stats.starform_integration_intervals
 	   << " (" << fixed<3>(stats.starform_integration_intervals_per_galaxy_ode_evaluations()) << " [ints/eval])\n"
+	   << "  Failed star formation integrations:   " << stats.starform_integration_failures
+	   << " (" << fixed<3>(stats.starform_integration_failure_rate() * 100) << "% of " << stats.starform_integrations << ")\n"
+	   << "  Gas cooling calculation time:         " << fixed<3>(stats.cooling_millis / 1000.) << " [s] (all threads)\n"
+	   << "  Memory usage:                         " << memory_amount(stats.rss) << "\n"
+	   << "  Peak memory usage:                    " << memory_amount(stats.peak_rss) << "\n"
+	   << "  Memory backed by huge pages:          " << memory_amount(stats.huge_pages) << "\n"
+	   << "  Load imbalance (max/mean busy time):  " << fixed<3>(stats.load_imbalance())
+	   << " (" << fixed<3>((stats.max_thread_busy_millis() - stats.mean_thread_busy_millis()) / 1000.) << " [s] recoverable)\n"
+	   << "  Slowest merger trees:                 " << stats.slowest_trees << "\n"
+	   << "  Most ODE evaluations in merger trees: " << stats.most_evaluated_trees << "\n"
 	   << "  Time:                                 " << fixed<3>(stats.duration_millis / 1000.) << " [s]";
 	return os;
 }
 
 
+static
+const gsl_odeiv2_step_type *gsl_stepper(ExecutionParameters::ode_stepper_t stepper)
+{
+	if (stepper == ExecutionParameters::MSBDF) {
+		return gsl_odeiv2_step_msbdf;
+	}
+	else if (stepper == ExecutionParameters::BSIMP) {
+		return gsl_odeiv2_step_bsimp;
+	}
+	return gsl_odeiv2_step_rkck;
+}
+
 void SharkRunner::impl::create_per_thread_objects()
 {
 	AGNFeedbackParameters agn_params(options);
@@ -195,86 +519,340 @@ void SharkRunner::impl::create_per_thread_objects()
 	GasCooling gas_cooling {gas_cooling_params, star_formation_params, reionisation, cosmology, agnfeedback, dark_matter_halos, reincorporation, environment};
 
 	for(unsigned int i = 0; i != threads; i++) {
-		auto physical_model = std::make_shared<BasicPhysicalModel>(exec_params.ode_solver_precision, gas_cooling, stellar_feedback, star_formation, recycling_params, gas_cooling_params);
+		auto physical_model = std::make_shared<BasicPhysicalModel>(exec_params.ode_solver_precision, gsl_stepper(exec_params.ode_stepper), gsl_stepper(exec_params.ode_starburst_stepper), exec_params.warm_start_ode, gas_cooling, stellar_feedback, star_formation, recycling_params, gas_cooling_params);
 		GalaxyMergers galaxy_mergers(merger_parameters, cosmology, exec_params, simulation_params, dark_matter_halos, physical_model, agnfeedback);
 		DiskInstability disk_instability(disk_instability_params, merger_parameters, simulation_params, dark_matter_halos, physical_model, agnfeedback);
+		if (!exec_params.ode_costs_file.empty()) {
+			physical_model->track_most_expensive_odes(exec_params.ode_costs_count);
+		}
+		if (exec_params.ode_solver == ExecutionParameters::ODE_BATCHED) {
+			physical_model->check_batched_odes(exec_params.batch_ode_check_tolerance);
+		}
 		thread_objects.emplace_back(std::move(physical_model), std::move(galaxy_mergers), std::move(disk_instability));
 	}
 }
 
+// Halos and subhalos reference each other, so they need to be explicitly
+// released before moving on to other batches
+static
+void release_trees(const std::vector<MergerTreePtr> &merger_trees)
+{
+	for (auto &tree: merger_trees) {
+		while (!tree->halos.empty()) {
+			tree->release_snapshot(tree->halos.begin()->first);
+		}
+	}
+}
+
+std::string SharkRunner::impl::model_directory() const
+{
+	return exec_params.output_directory + "/" + simulation_params.sim_name + "/" + exec_params.name_model;
+}
+
+void SharkRunner::impl::check_can_share_trees(const impl &other) const
+{
+	auto name = model_directory();
+	auto other_name = other.model_directory();
+	if (name == other_name) {
+		throw invalid_option("Two models write their outputs into " + name + ", use a different execution.name_model for each");
+	}
+	// Models can branch off from the same checkpoint
+	if (exec_params.restart_file != other.exec_params.restart_file) {
+		throw invalid_option("Models " + name + " and " + other_name + " must use the same execution.restart_file");
+	}
+	for (auto model: {this, &other}) {
+		auto &batches = model->exec_params.simulation_batches;
+		auto group_size = model->exec_params.batch_group_size;
+		if (group_size != 0 && group_size < batches.size()) {
+			throw invalid_option("execution.batch_group_size cannot be used when evolving several models");
+		}
+	}
+	for (auto file: {&ExecutionParameters::metrics_file, &ExecutionParameters::ode_costs_file, &ExecutionParameters::trace_file, &ExecutionParameters::status_file}) {
+		if (!(exec_params.*file).empty() && exec_params.*file == other.exec_params.*file) {
+			throw invalid_option("Models " + name + " and " + other_name + " write their metrics into the same file " + exec_params.*file);
+		}
+	}
+
+	auto tree_key = [](const impl &model) {
+		return TreeCache::make_key({}, model.exec_params, model.simulation_params, model.dark_matter_halo_params, model.cosmo_params);
+	};
+	if (simulation_params.tree_files_prefix != other.simulation_params.tree_files_prefix ||
+	    exec_params.simulation_batches != other.exec_params.simulation_batches ||
+	    tree_key(*this) != tree_key(other)) {
+		throw invalid_option("Models " + name + " and " + other_name + " cannot share their merger trees: "
+		                     "they must use the same inputs and options to build them");
+	}
+}
+
+void SharkRunner::impl::share_trees(const std::shared_ptr<std::stringstream> &trees)
+{
+	shared_trees = trees;
+}
+
+void SharkRunner::impl::import_shared_trees()
+{
+	if (!shared_trees || shared_trees->tellp() > 0) {
+		return;
+	}
+	huge_pages::enable(exec_params.huge_pages);
+	release_trees(import_trees());
+}
+
 std::vector<MergerTreePtr> SharkRunner::impl::import_trees()
 {
 	Timer t;
-	SURFSReader reader(simulation_params.tree_files_prefix, dark_matter_halos, simulation_params, threads);
-	HaloBasedTreeBuilder tree_builder(exec_params, threads);
-	auto halos = reader.read_halos(exec_params.simulation_batches);
-	auto trees = tree_builder.build_trees(halos, simulation_params, gas_cooling_params, cosmology, all_baryons);
+	tracing::scoped_event trace_import("import trees", "stage");
+
+	// Trees might have been already built for a previous model
+	std::vector<MergerTreePtr> trees;
+	if (shared_trees && shared_trees->tellp() > 0) {
+		shared_trees->clear();
+		shared_trees->seekg(0);
+		tracing::scoped_event trace_read("read shared trees", "stage");
+		TreeCache().read(*shared_trees, "memory", trees, all_baryons, threads, exec_params.arena_allocation, exec_params.numa_placement);
+		LOG(info) << "Merger trees imported in " << t;
+		memory_tracker.record("tree building");
+		return trees;
+	}
+
+	trees = build_trees();
+	if (shared_trees) {
+		tracing::scoped_event trace_write("write shared trees", "stage");
+		TreeCache().write(*shared_trees, "memory", trees, all_baryons);
+	}
+	memory_tracker.record("tree building");
+	return trees;
+}
+
+std::vector<MergerTreePtr> SharkRunner::impl::place_trees(std::vector<MergerTreePtr> &&trees)
+{
+	// Halos and subhalos were created by whichever thread read them, so
+	// trees are created again from an in-memory copy, this time by the
+	// threads that will evolve them
+	Timer t;
+	tracing::scoped_event trace_place("place trees", "stage");
+	std::stringstream copy;
+	TreeCache().write(copy, "memory", trees, all_baryons);
+	release_trees(trees);
+	trees.clear();
+	std::vector<MergerTreePtr> placed_trees;
+	TreeCache().read(copy, "memory", placed_trees, all_baryons, threads, exec_params.arena_allocation, true);
+	LOG(info) << "Placed merger trees in the memory of the threads evolving them in " << t;
+	return placed_trees;
+}
+
+std::vector<MergerTreePtr> SharkRunner::impl::build_trees()
+{
+	return build_trees(exec_params, threads, all_baryons, &memory_tracker);
+}
+
+std::vector<MergerTreePtr> SharkRunner::impl::build_trees(const ExecutionParameters &params, unsigned int build_threads, TotalBaryon &baryons, MemoryTracker *tracker)
+{
+	Timer t;
+	SURFSReader reader(simulation_params.tree_files_prefix, dark_matter_halos, simulation_params, build_threads, params.arena_allocation, tracker, params.reader_batches_in_flight, params.reader_chunk_size, params.spatial_selection);
+
+	// Trees might have been already built and cached by a previous execution
+	TreeCache tree_cache;
+	std::string tree_cache_file;
+	if (!params.tree_cache_directory.empty()) {
+		std::vector<std::string> tree_files;
+		for (auto batch: params.simulation_batches) {
+			tree_files.push_back(reader.get_filename(batch));
+		}
+		tree_cache.key = TreeCache::make_key(tree_files, params, simulation_params, dark_matter_halo_params, cosmo_params);
+		std::ostringstream os;
+		os << params.tree_cache_directory << "/trees_" << std::hex << std::setw(16) << std::setfill('0') << tree_cache.key << ".bin";
+		tree_cache_file = os.str();
+
+		std::vector<MergerTreePtr> trees;
+		tracing::scoped_event trace_read("read tree cache", "stage");
+		if (tree_cache.read(tree_cache_file, trees, baryons, build_threads, params.arena_allocation, params.numa_placement)) {
+			LOG(info) << "Merger trees imported in " << t;
+			return trees;
+		}
+	}
+
+	HaloBasedTreeBuilder tree_builder(params, build_threads);
+	// Halos right after the last output snapshot are still the descendants
+	// of those in the merger trees, but later ones are never used
+	tracing::scoped_event trace_read("read halos", "stage");
+	auto halos = reader.read_halos(params.simulation_batches, params.last_output_snapshot() + 1, params.last_output_snapshot());
+	trace_read.finish();
+	tracing::scoped_event trace_build("build trees", "stage");
+	auto trees = tree_builder.build_trees(halos, simulation_params, gas_cooling_params, cosmology, baryons);
+	trace_build.finish();
+	if (params.numa_placement) {
+		trees = place_trees(std::move(trees));
+	}
 	LOG(info) << "Merger trees imported in " << t;
+
+	if (!tree_cache_file.empty()) {
+		boost::filesystem::path cache_dir(params.tree_cache_directory);
+		if (!boost::filesystem::exists(cache_dir)) {
+			boost::filesystem::create_directories(cache_dir);
+		}
+		tracing::scoped_event trace_write("write tree cache", "stage");
+		tree_cache.write(tree_cache_file, trees, baryons);
+	}
 	return trees;
 }
 
-void _get_molecular_gas(const HaloPtr &halo, molgas_per_galaxy &molgas, StarFormation &star_formation, double z, bool calc_j)
+void SharkRunner::impl::prefetch_trees(const std::vector<unsigned int> &batches)
 {
-	for (auto &subhalo: halo->all_subhalos()) {
+	// Execution parameters change while the current batch group is evolved,
+	// so the job gets its own copy. Trees are placed in the memory of the
+	// threads evolving them only once taken over
+	auto params = exec_params;
+	params.simulation_batches = batches;
+	params.numa_placement = false;
+	prefetched_trees.clear();
+	prefetched_baryons = TotalBaryon();
+	prefetching = true;
+	prefetcher->submit([this, params]() {
+		tracing::scoped_event trace_prefetch("prefetch trees", "stage");
+		prefetched_trees = build_trees(params, params.prefetch_threads, prefetched_baryons, nullptr);
+	});
+}
+
+std::vector<MergerTreePtr> SharkRunner::impl::take_prefetched_trees()
+{
+	Timer t;
+	tracing::scoped_event trace_wait("wait for prefetched trees", "stage");
+	prefetching = false;
+	prefetcher->wait();
+	trace_wait.finish();
+	LOG(info) << "Waited " << t << " for the prefetched merger trees";
+
+	auto trees = std::move(prefetched_trees);
+	prefetched_trees.clear();
+	all_baryons = std::move(prefetched_baryons);
+	if (exec_params.numa_placement) {
+		trees = place_trees(std::move(trees));
+	}
+	memory_tracker.record("tree building");
+	return trees;
+}
+
+void _get_molecular_gas(const HaloPtr &halo, molgas_per_galaxy &molgas, StarFormation &star_formation, double z, bool calc_j, bool approximate)
+{
+	for (auto &subhalo: halo->subhalos()) {
 		for (auto &galaxy: subhalo->galaxies) {
-			molgas[galaxy] = star_formation.get_molecular_gas(galaxy, z, calc_j);
+			molgas[galaxy] = star_formation.get_molecular_gas(galaxy, z, calc_j, approximate);
 		}
 	}
 }
 
-molgas_per_galaxy SharkRunner::impl::get_molecular_gas(const std::vector<HaloPtr> &halos, double z, bool calc_j)
+molgas_per_galaxy SharkRunner::impl::get_molecular_gas(const std::vector<HaloPtr> &halos, double z, bool calc_j, bool approximate)
 {
 
-	std::vector<StarFormation> star_formations(threads, star_formation);
-	std::vector<molgas_per_galaxy> local_molgas(threads);
+	molgas_per_galaxy molgas(n_galaxy_ids);
 
 	omp_static_for(halos, threads, [&](const HaloPtr &halo, int idx){
-		_get_molecular_gas(halo, local_molgas[idx], star_formations[idx], z, calc_j);
+		_get_molecular_gas(halo, molgas, thread_objects[idx].star_formation, z, calc_j, approximate);
 	});
 
-	if (threads == 1) {
-		return local_molgas[0];
-	}
-
-	return std::accumulate(local_molgas.begin(), local_molgas.end(), molgas_per_galaxy(), [](molgas_per_galaxy &mg1, molgas_per_galaxy &mg2) {
-		mg1.insert(mg2.begin(), mg2.end());
-		return mg1;
-	});
+	return molgas;
 
 }
 
-void SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree, int thread_idx, int snapshot, double z, double delta_t)
+void SharkRunner::impl::merge_galaxies(const HaloPtr &halo, int thread_idx, int snapshot, double delta_t)
 {
 	// Get the thread-specific objects needed to run the evolution
 	// In the non-OpenMP case we simply have one
 	auto &objs = thread_objects[thread_idx];
-	auto &physical_model = objs.physical_model;
 	auto &galaxy_mergers = objs.galaxy_mergers;
 	auto &disk_instability = objs.disk_instability;
 
-	/*here loop over the halos this merger tree has at this time.*/
-	for(auto &halo: tree->halos[snapshot]) {
+	// galaxy_mergers and disk_instability take a non-const reference
+	HaloPtr halo_ptr = halo;
 
-		/*Evaluate which galaxies are merging in this halo.*/
-		if (LOG_ENABLED(debug)) {
-			LOG(debug) << "Merging galaxies in halo " << halo;
-		}
-		galaxy_mergers.merging_galaxies(halo, snapshot, delta_t);
+	/*Evaluate which galaxies are merging in this halo.*/
+	if (LOG_ENABLED(debug)) {
+		LOG(debug) << "Merging galaxies in halo " << halo;
+	}
+	galaxy_mergers.merging_galaxies(halo_ptr, snapshot, delta_t);
 
-		/*Evaluate disk instabilities.*/
-		if (LOG_ENABLED(debug)) {
-			LOG(debug) << "Evaluating disk instability in halo " << halo;
+	/*Evaluate disk instabilities.*/
+	if (LOG_ENABLED(debug)) {
+		LOG(debug) << "Evaluating disk instability in halo " << halo;
+	}
+	disk_instability.evaluate_disk_instability(halo_ptr, snapshot, delta_t);
+}
+
+void SharkRunner::impl::evolve_galaxies(span<SubhaloPtr> subhalos, int thread_idx, double z, double delta_t)
+{
+	auto &objs = thread_objects[thread_idx];
+	auto &physical_model = objs.physical_model;
+
+	// The molecular gas content depends only on the galaxy's own
+	// properties, which don't change any further during this snapshot
+	auto calculate_molecular_gas = [&](const GalaxyPtr &galaxy) {
+		if (exec_params.fused_molecular_gas && molgas_mode != ExecutionParameters::MOLGAS_NONE) {
+			molgas_per_gal[galaxy] = objs.star_formation.get_molecular_gas(galaxy, z, molgas_calc_j, molgas_mode == ExecutionParameters::MOLGAS_APPROXIMATE);
 		}
-		disk_instability.evaluate_disk_instability(halo, snapshot, delta_t);
+	};
 
-		if (LOG_ENABLED(debug)) {
-			LOG(debug) << "Evolving content in halo " << halo;
+	// Only central galaxies cool, and there is one per halo
+	if (exec_params.cooling_prepass) {
+		std::vector<std::pair<Subhalo *, Galaxy *>> central_galaxies;
+		for (auto &subhalo: subhalos) {
+			for (auto &galaxy: subhalo->galaxies) {
+				if (galaxy->galaxy_type == Galaxy::CENTRAL) {
+					central_galaxies.emplace_back(subhalo.get(), galaxy.get());
+				}
+			}
 		}
-		for(auto &subhalo: halo->all_subhalos()) {
+		physical_model->calculate_cooling_rates(central_galaxies, z, delta_t);
+	}
+
+	if (exec_params.ode_solver == ExecutionParameters::ODE_GSL) {
+		for(auto &subhalo: subhalos) {
 			for(auto &galaxy: subhalo->galaxies) {
 				physical_model->evolve_galaxy(*subhalo, *galaxy, z, delta_t);
+				calculate_molecular_gas(galaxy);
 			}
 		}
+		return;
+	}
+
+	// Galaxies exchange mass with their subhalo, so each batch takes at most
+	// one galaxy from each subhalo, evolving them in their original order
+	std::vector<std::pair<Subhalo *, Galaxy *>> batch;
+	std::vector<GalaxyPtr> batch_galaxies;
+	for (std::size_t round = 0; ; round++) {
+		batch.clear();
+		batch_galaxies.clear();
+		for (auto &subhalo: subhalos) {
+			if (subhalo->galaxies.size() > round) {
+				auto &galaxy = subhalo->galaxies[round];
+				batch.emplace_back(subhalo.get(), galaxy.get());
+				batch_galaxies.push_back(galaxy);
+			}
+		}
+		if (batch.empty()) {
+			break;
+		}
+		physical_model->evolve_galaxies(batch, z, delta_t);
+		for (auto &galaxy: batch_galaxies) {
+			calculate_molecular_gas(galaxy);
+		}
+	}
+}
+
+void SharkRunner::impl::evolve_halo(const HaloPtr &halo, int thread_idx, int snapshot, double z, double delta_t)
+{
+	merge_galaxies(halo, thread_idx, snapshot, delta_t);
+
+	if (LOG_ENABLED(debug)) {
+		LOG(debug) << "Evolving content in halo " << halo;
+	}
+	evolve_galaxies(halo->subhalos(), thread_idx, z, delta_t);
+}
+
+void SharkRunner::impl::merge_subhalos(std::size_t tree_idx, int thread_idx, int snapshot, double z)
+{
+	auto &galaxy_mergers = thread_objects[thread_idx].galaxy_mergers;
+	for(auto &halo: tree_index->tree_halos(snapshot, tree_idx)) {
 
 		/*Determine which subhalos are disappearing in this snapshot and calculate dynamical friction timescale and change galaxy types accordingly.*/
 		if (LOG_ENABLED(debug)) {
@@ -282,16 +860,192 @@ void SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree, int thread
 		}
 		galaxy_mergers.merging_subhalos(halo, z);
 	}
+}
+
+void SharkRunner::impl::evolve_merger_tree(std::size_t tree_idx, int thread_idx, int snapshot, double z, double delta_t)
+{
+	auto &galaxy_mergers = thread_objects[thread_idx].galaxy_mergers;
+	auto tree_halos = tree_index->tree_halos(snapshot, tree_idx);
+
+	// Halos evolve independently of each other, so the galaxies of all of
+	// them can be put together into bigger batches
+	if (exec_params.ode_solver == ExecutionParameters::ODE_BATCHED) {
+		std::vector<SubhaloPtr> subhalos;
+		for(auto &halo: tree_halos) {
+			merge_galaxies(halo, thread_idx, snapshot, delta_t);
+			auto halo_subhalos = halo->subhalos();
+			subhalos.insert(subhalos.end(), halo_subhalos.begin(), halo_subhalos.end());
+		}
+		evolve_galaxies(subhalos, thread_idx, z, delta_t);
+		merge_subhalos(tree_idx, thread_idx, snapshot, z);
+		return;
+	}
+
+	/*here loop over the halos this merger tree has at this time.*/
+	for(auto &halo: tree_halos) {
+
+		evolve_halo(halo, thread_idx, snapshot, z, delta_t);
+
+		/*Determine which subhalos are disappearing in this snapshot and calculate dynamical friction timescale and change galaxy types accordingly.*/
+		if (LOG_ENABLED(debug)) {
+			LOG(debug) << "Merging subhalos in halo " << halo;
+		}
+		galaxy_mergers.merging_subhalos(halo, z);
+	}
+
+}
+
+void SharkRunner::impl::evolve_and_measure_merger_tree(std::size_t tree_idx, int thread_idx, int snapshot, double z, double delta_t)
+{
+	// ODE counters are per-thread, so their difference before and after
+	// evolving the tree is the work that went into this tree alone
+	Timer busy_t;
+	tracing::scoped_event trace_tree("evolve tree", "task", "tree", tree_idx);
+	auto &physical_model = thread_objects[thread_idx].physical_model;
+	auto evaluations_before = physical_model->get_galaxy_ode_evaluations() + physical_model->get_galaxy_starburst_ode_evaluations();
+	evolve_merger_tree(tree_idx, thread_idx, snapshot, z, delta_t);
+	tree_evaluations[tree_idx] = physical_model->get_galaxy_ode_evaluations() + physical_model->get_galaxy_starburst_ode_evaluations() - evaluations_before;
+	tree_micros[tree_idx] = busy_t.get_micros();
+	if (tree_pipeline) {
+		finish_merger_tree(tree_idx, thread_idx, snapshot);
+	}
+	thread_objects[thread_idx].busy_micros += busy_t.get_micros();
+}
+
+void SharkRunner::impl::finish_merger_tree(std::size_t tree_idx, int thread_idx, int snapshot)
+{
+	// Merger trees don't interact with each other, so the remaining phases
+	// of a tree don't need to wait for the evolution of the rest
+	tracing::scoped_event trace_tree("finish tree", "task", "tree", tree_idx);
+	auto tree_halos = tree_index->tree_halos(snapshot, tree_idx);
+	for (auto &halo: tree_halos) {
+		tree_pipeline->tracker.track(halo, thread_idx);
+		tree_pipeline->galaxies[thread_idx] += halo->galaxy_count();
+	}
+	if (tree_pipeline->transfer) {
+		tree_pipeline->transfer->transfer(tree_halos, thread_idx);
+	}
+}
+
+void SharkRunner::impl::evolve_halos_in_parallel(const std::vector<MergerTreePtr> &merger_trees, const std::vector<HaloPtr> &halos, int snapshot, double z, double delta_t)
+{
+	// Halos of the same snapshot evolve independently of each other, so
+	// they can all be distributed across threads regardless of the tree
+	// they belong to
+	omp_dynamic_for(halos, threads, 1, [&](const HaloPtr &halo, int thread_idx) {
+		Timer busy_t;
+		tracing::scoped_event trace_halo("evolve halo", "task", "halo", halo->id);
+		evolve_halo(halo, thread_idx, snapshot, z, delta_t);
+		thread_objects[thread_idx].busy_micros += busy_t.get_micros();
+	});
+
+	// Subhalo mergers do cross halo boundaries (the main progenitor of the
+	// descendant of a central subhalo is read), although never tree
+	// boundaries, so this last step is parallelised across trees only
+	omp_dynamic_for(std::size_t(0), merger_trees.size(), threads, 1, [&](std::size_t tree_idx, int thread_idx) {
+		Timer busy_t;
+		tracing::scoped_event trace_tree("merge subhalos", "task", "tree", tree_idx);
+		merge_subhalos(tree_idx, thread_idx, snapshot, z);
+		thread_objects[thread_idx].busy_micros += busy_t.get_micros();
+	});
+}
+
+std::vector<std::size_t> SharkRunner::impl::schedule_merger_trees(const std::vector<std::size_t> &n_galaxies)
+{
+	auto n_trees = n_galaxies.size();
+	std::vector<std::size_t> tree_order(n_trees);
+	std::iota(tree_order.begin(), tree_order.end(), 0);
+	if (exec_params.tree_scheduling != ExecutionParameters::COST_AWARE) {
+		return tree_order;
+	}
+
+	// Trees without a measurement from the previous snapshot (e.g., on the
+	// first snapshot, or trees that had no galaxies) are given the mean
+	// per-galaxy cost of all measured trees
+	double total_cost = 0;
+	std::size_t n_measured = 0;
+	for (auto cost: tree_costs) {
+		if (cost > 0) {
+			total_cost += cost;
+			n_measured++;
+		}
+	}
+	double mean_cost = (n_measured == 0) ? 1 : total_cost / n_measured;
+
+	std::vector<double> estimated_costs(n_trees);
+	for (std::size_t i = 0; i != n_trees; i++) {
+		auto cost_per_galaxy = (tree_costs[i] > 0) ? tree_costs[i] : mean_cost;
+		estimated_costs[i] = (1 + n_galaxies[i]) * cost_per_galaxy;
+	}
 
+	// Most expensive trees go first so the cheap ones fill the gaps at the end
+	std::stable_sort(tree_order.begin(), tree_order.end(), [&](std::size_t i, std::size_t j) {
+		return estimated_costs[i] > estimated_costs[j];
+	});
+	return tree_order;
+}
+
+void SharkRunner::impl::evolve_merger_trees_dynamically(const std::vector<MergerTreePtr> &merger_trees, int snapshot, double z, double delta_t)
+{
+	auto n_trees = merger_trees.size();
+	tree_costs.resize(n_trees, 0);
+
+	std::vector<std::size_t> n_galaxies(n_trees, 0);
+	for (std::size_t i = 0; i != n_trees; i++) {
+		for (auto &halo: tree_index->tree_halos(snapshot, i)) {
+			n_galaxies[i] += halo->galaxy_count();
+		}
+	}
+
+	auto tree_order = schedule_merger_trees(n_galaxies);
+	omp_dynamic_for(tree_order, threads, 1, [&](std::size_t tree_idx, int thread_idx) {
+		evolve_and_measure_merger_tree(tree_idx, thread_idx, snapshot, z, delta_t);
+	});
+
+	for (std::size_t i = 0; i != n_trees; i++) {
+		tree_costs[i] = (n_galaxies[i] == 0) ? 0 : double(tree_evaluations[i]) / n_galaxies[i];
+	}
+}
+
+/// @return The @p n merger trees that took the most wall time, or ODE
+/// evaluations if @p by_evaluations, the most expensive first
+static
+std::vector<TreeCost> most_expensive_trees(const std::vector<MergerTreePtr> &merger_trees, const std::vector<Timer::duration> &tree_micros,
+                                           const std::vector<unsigned long> &tree_evaluations, std::size_t n, bool by_evaluations)
+{
+	std::vector<std::size_t> order(merger_trees.size());
+	std::iota(order.begin(), order.end(), 0);
+	n = std::min(n, order.size());
+	std::partial_sort(order.begin(), order.begin() + n, order.end(), [&](std::size_t i, std::size_t j) {
+		if (by_evaluations) {
+			return tree_evaluations[i] > tree_evaluations[j];
+		}
+		return tree_micros[i] > tree_micros[j];
+	});
+
+	std::vector<TreeCost> costs;
+	for (std::size_t i = 0; i != n; i++) {
+		auto tree_idx = order[i];
+		if (tree_micros[tree_idx] == 0) {
+			break;
+		}
+		costs.push_back(TreeCost {merger_trees[tree_idx]->id, tree_micros[tree_idx] / 1000., tree_evaluations[tree_idx]});
+	}
+	return costs;
 }
 
 void SharkRunner::impl::evolve_merger_trees(const std::vector<MergerTreePtr> &merger_trees, int snapshot)
 {
 	Timer t;
+	tracing::scoped_event trace_snapshot("snapshot", "phase", "snapshot", snapshot);
 
 	for(auto &o: thread_objects) {
 		o.physical_model->reset_ode_evaluations();
+		o.busy_micros = 0;
 	}
+#ifdef SHARK_PROFILING
+	profiling::reset();
+#endif
 
 	// Calculate the initial and final time for the evolution start at this snapshot.
 	auto z = simulation_params.redshifts[snapshot];
@@ -305,88 +1059,713 @@ void SharkRunner::impl::evolve_merger_trees(const std::vector<MergerTreePtr> &me
 	os << ". Redshift: " << z << " -> " << z_end << ", time: " << ti << " -> " << tf;
 	LOG(info) << os.str();
 
-	Timer evolution_t;
-	omp_static_for(merger_trees, threads, [&](const MergerTreePtr &merger_tree, int thread_idx) {
-		evolve_merger_tree(merger_tree, thread_idx, snapshot, simulation_params.redshifts[snapshot], delta_t);
-	});
-	LOG(info) << "Evolved galaxies in " << evolution_t;
+	const auto &all_halos_this_snapshot = tree_index->halos(snapshot);
 
-	std::vector<HaloPtr> all_halos_this_snapshot;
-	for (auto &tree: merger_trees) {
-		all_halos_this_snapshot.insert(all_halos_this_snapshot.end(), tree->halos[snapshot].begin(), tree->halos[snapshot].end());
+	bool write_galaxies = exec_params.output_snapshot(snapshot + 1);
+
+	// The specific angular momentum of the atomic and molecular gas is only
+	// needed if written; the gas masses are always needed for tracking totals
+	bool calc_j = write_galaxies && !summaries && !exec_params.summary_only && (exec_params.output_format == Options::ASCII ||
+	              exec_params.output_property("galaxies/specific_angular_momentum_disk_gas_atom") ||
+	              exec_params.output_property("galaxies/specific_angular_momentum_disk_gas_mol"));
+
+	// Snapshots that are not written only need the molecular gas for the
+	// global HI and H2 masses, which can be calculated more cheaply
+	molgas_mode = write_galaxies ? ExecutionParameters::MOLGAS_FULL : exec_params.tracked_molecular_gas;
+	if (exec_params.fused_molecular_gas) {
+		molgas_per_gal = molgas_per_galaxy(n_galaxy_ids);
+		molgas_calc_j = calc_j;
 	}
 
-	bool write_galaxies = exec_params.output_snapshot(snapshot + 1);
+	// Galaxies are transferred while other trees are still evolving only if
+	// they are not needed afterwards by the outputs of this snapshot
+	if (exec_params.pipelined_snapshots) {
+		bool stream_histories = exec_params.output_sf_histories && exec_params.stream_sf_histories;
+		std::unique_ptr<GalaxyTransfer> transfer;
+		if (!write_galaxies && !stream_histories) {
+			transfer.reset(new GalaxyTransfer(snapshot, tf, threads));
+		}
+		tree_pipeline.reset(new TreePipeline {
+			BaryonTracker(*cosmology, exec_params, simulation_params, snapshot, molgas_per_gal, delta_t, threads),
+			std::move(transfer), std::vector<std::size_t>(std::max(threads, 1u), 0)
+		});
+	}
 
-	Timer molgas_t;
-	auto molgas_per_gal = get_molecular_gas(all_halos_this_snapshot, z, write_galaxies);
-	LOG(info) << "Calculated molecular gas in " << molgas_t;
+	// Trees evolved together with others (with execution.halo_parallelism)
+	// are left without measurements
+	tree_micros.assign(merger_trees.size(), 0);
+	tree_evaluations.assign(merger_trees.size(), 0);
+
+	Timer evolution_t;
+	tracing::scoped_event trace_evolution("evolve", "phase", "snapshot", snapshot);
+	report_phase("evolve", snapshot);
+	if (exec_params.halo_parallelism) {
+		evolve_halos_in_parallel(merger_trees, all_halos_this_snapshot, snapshot, z, delta_t);
+	}
+	else if (!tree_assignment.empty()) {
+		omp_per_thread(threads, [&](unsigned int t, int thread_idx) {
+			for (auto tree_idx = tree_assignment.begin(t); tree_idx != tree_assignment.end(t); tree_idx++) {
+				evolve_and_measure_merger_tree(tree_idx, thread_idx, snapshot, z, delta_t);
+			}
+		});
+	}
+	else if (exec_params.tree_scheduling == ExecutionParameters::STATIC) {
+		omp_static_for(std::size_t(0), merger_trees.size(), threads, [&](std::size_t tree_idx, int thread_idx) {
+			evolve_and_measure_merger_tree(tree_idx, thread_idx, snapshot, z, delta_t);
+		});
+	}
+	else {
+		evolve_merger_trees_dynamically(merger_trees, snapshot, z, delta_t);
+	}
+	auto evolution_micros = evolution_t.get_micros();
+	trace_evolution.finish();
+	for (std::size_t i = 0; i != merger_trees.size(); i++) {
+		tree_total_micros[i] += tree_micros[i];
+	}
+	LOG(info) << "Evolved galaxies in " << evolution_t;
+	if (exec_params.ode_solver == ExecutionParameters::ODE_BATCHED && exec_params.batch_ode_check_tolerance > 0) {
+		auto mismatches = std::accumulate(thread_objects.begin(), thread_objects.end(), 0UL, [](unsigned long x, const PerThreadObjects &o) {
+			return x + o.physical_model->get_batch_ode_mismatches();
+		});
+		LOG(info) << mismatches << " batched ODE solutions differed from the GSL reference by more than "
+		          << exec_params.batch_ode_check_tolerance;
+	}
+	memory_tracker.record("evolution of snapshot " + std::to_string(snapshot));
+
+	Timer::duration molgas_micros = 0;
+	if (!exec_params.fused_molecular_gas) {
+		Timer molgas_t;
+		tracing::scoped_event trace_molgas("molgas", "phase", "snapshot", snapshot);
+		report_phase("molgas", snapshot);
+		if (molgas_mode == ExecutionParameters::MOLGAS_NONE) {
+			molgas_per_gal = molgas_per_galaxy(n_galaxy_ids);
+		}
+		else {
+			molgas_per_gal = get_molecular_gas(all_halos_this_snapshot, z, calc_j, molgas_mode == ExecutionParameters::MOLGAS_APPROXIMATE);
+		}
+		molgas_micros = molgas_t.get_micros();
+		LOG(info) << "Calculated molecular gas in " << molgas_t;
+	}
 
 	/*track all baryons of this snapshot*/
 	Timer tracking_t;
-	track_total_baryons(star_formation, *cosmology, exec_params, simulation_params, all_halos_this_snapshot, all_baryons, snapshot, molgas_per_gal, delta_t);
+	tracing::scoped_event trace_tracking("tracking", "phase", "snapshot", snapshot);
+	report_phase("tracking", snapshot);
+	if (tree_pipeline) {
+		tree_pipeline->tracker.add_totals(all_baryons);
+	}
+	else {
+		track_total_baryons(*cosmology, exec_params, simulation_params, all_halos_this_snapshot, all_baryons, snapshot, molgas_per_gal, delta_t, threads);
+	}
+	auto tracking_micros = tracking_t.get_micros();
+	trace_tracking.finish();
 	LOG(info) << "Total baryon amounts tracked in " << tracking_t;
 
 	/*Here you could include the physics that allow halos to speak to each other. This could be useful e.g. during reionisation.*/
 	//do_stuff_at_halo_level(all_halos_this_snapshot);
 
-	if (write_galaxies)
+	Timer output_t;
+	tracing::scoped_event trace_output("output", "phase", "snapshot", snapshot);
+	report_phase("output", snapshot);
+	writer->stream_histories(snapshot, all_halos_this_snapshot);
+	if (write_galaxies && summaries) {
+		auto &bins = exec_params.summary_mass_bins;
+		auto stats = SummaryStatistics::collect(all_halos_this_snapshot, molgas_per_gal, bins[0], bins[1], bins[2], threads);
+		auto it = summaries->find(snapshot + 1);
+		if (it == summaries->end()) {
+			summaries->emplace(snapshot + 1, std::move(stats));
+		}
+		else {
+			it->second.merge(stats);
+		}
+	}
+	else if (write_galaxies)
 	{
 		// Note that the output is being done at "snapshot + 1". This is because
 		// we don't evolve galaxies AT snapshot "i" but FROM snapshot "i" TO
 		// snapshot "i+1", and therefore at this point in time (after the actual
 		// evolution) we consider our galaxies to be at snapshot "i+1"
 		LOG(info) << "Write output files for evolution from snapshot " << snapshot << " to " << snapshot + 1;
-		writer->write(snapshot + 1, all_halos_this_snapshot, all_baryons, molgas_per_gal);
+		if (exec_params.summary_statistics) {
+			writer->write_summary(snapshot + 1, all_halos_this_snapshot, molgas_per_gal);
+		}
+		if (!exec_params.summary_only) {
+			writer->write(snapshot + 1, all_halos_this_snapshot, all_baryons, molgas_per_gal);
+		}
 	}
+	auto output_micros = output_t.get_micros();
+	trace_output.finish();
 
-	auto duration_millis = t.get();
+	auto duration_micros = t.get_micros();
+	auto duration_millis = duration_micros / 1000.;
 
 	// Some high-level ODE and integration iteration count statistics
 	auto starform_integration_intervals = std::accumulate(thread_objects.begin(), thread_objects.end(), 0UL, [](unsigned long x, const PerThreadObjects &o) {
 		return x + o.physical_model->get_star_formation_integration_intervals();
 	});
+	auto starform_integrations = std::accumulate(thread_objects.begin(), thread_objects.end(), 0UL, [](unsigned long x, const PerThreadObjects &o) {
+		return x + o.physical_model->get_star_formation_integrations();
+	});
+	auto starform_integration_failures = std::accumulate(thread_objects.begin(), thread_objects.end(), 0UL, [](unsigned long x, const PerThreadObjects &o) {
+		return x + o.physical_model->get_star_formation_integration_failures();
+	});
 	auto galaxy_ode_evaluations = std::accumulate(thread_objects.begin(), thread_objects.end(), 0UL, [](unsigned long x, const PerThreadObjects &o) {
 		return x + o.physical_model->get_galaxy_ode_evaluations();
 	});
 	auto starburst_ode_evaluations = std::accumulate(thread_objects.begin(), thread_objects.end(), 0UL, [](unsigned long x, const PerThreadObjects &o) {
 		return x + o.physical_model->get_galaxy_starburst_ode_evaluations();
 	});
-	auto n_halos = all_halos_this_snapshot.size();
-	auto n_subhalos = std::accumulate(all_halos_this_snapshot.begin(), all_halos_this_snapshot.end(), std::size_t(0), [](std::size_t n_subhalos, const HaloPtr &halo) {
-		return n_subhalos + halo->subhalo_count();
-	});
-	auto n_galaxies = std::accumulate(all_halos_this_snapshot.begin(), all_halos_this_snapshot.end(), std::size_t(0), [](std::size_t n_galaxies, const HaloPtr &halo) {
-		return n_galaxies + halo->galaxy_count();
+	auto fast_path_hits = std::accumulate(thread_objects.begin(), thread_objects.end(), 0UL, [](unsigned long x, const PerThreadObjects &o) {
+		return x + o.physical_model->get_galaxy_fast_path_hits();
 	});
+	ode_evaluations += galaxy_ode_evaluations + starburst_ode_evaluations;
+	auto n_halos = all_halos_this_snapshot.size();
+	auto n_subhalos = tree_index->subhalos(snapshot).size();
+	// Pipelined trees may have been transferred already, so they were counted
+	std::size_t n_galaxies;
+	if (tree_pipeline) {
+		n_galaxies = std::accumulate(tree_pipeline->galaxies.begin(), tree_pipeline->galaxies.end(), std::size_t(0));
+	}
+	else {
+		n_galaxies = std::accumulate(all_halos_this_snapshot.begin(), all_halos_this_snapshot.end(), std::size_t(0), [](std::size_t n_galaxies, const HaloPtr &halo) {
+			return n_galaxies + halo->galaxy_count();
+		});
+	}
 
-	SnapshotStatistics stats {snapshot, starform_integration_intervals, galaxy_ode_evaluations, starburst_ode_evaluations,
-							  n_halos, n_subhalos, n_galaxies, duration_millis};
-	LOG(info) << "Statistics for snapshot " << snapshot << std::endl << stats;
-
+	std::vector<double> thread_busy_millis;
+	ODECostHistogram galaxy_ode_histogram, starburst_ode_histogram;
+	double cooling_millis = 0;
+	for (auto &o: thread_objects) {
+		thread_busy_millis.push_back(o.busy_micros / 1000.);
+		cooling_millis += o.physical_model->get_cooling_micros() / 1000.;
+		galaxy_ode_histogram += o.physical_model->get_galaxy_ode_histogram();
+		starburst_ode_histogram += o.physical_model->get_starburst_ode_histogram();
+	}
 
 	/*transfer galaxies from this halo->subhalos to the next snapshot's halo->subhalos*/
 	LOG(debug) << "Transferring all galaxies for snapshot " << snapshot << " into next snapshot";
-	transfer_galaxies_to_next_snapshot(all_halos_this_snapshot, snapshot, all_baryons);
+	Timer transfer_t;
+	tracing::scoped_event trace_transfer("transfer", "phase", "snapshot", snapshot);
+	report_phase("transfer", snapshot);
+	if (tree_pipeline && tree_pipeline->transfer) {
+		tree_pipeline->transfer->add_losses(all_baryons);
+	}
+	else {
+		transfer_galaxies_to_next_snapshot(*tree_index, merger_trees.size(), snapshot, tf, all_baryons, threads);
+	}
+	tree_pipeline.reset();
+	auto transfer_micros = transfer_t.get_micros();
+	trace_transfer.finish();
 
+	auto remaining_snapshots = simulation_params.max_snapshot - 1 - snapshot;
+	const auto &memory_usage = memory_tracker.record("outputs and transfer of snapshot " + std::to_string(snapshot), remaining_snapshots);
+
+	SnapshotStatistics stats {snapshot, starform_integration_intervals, starform_integrations, starform_integration_failures, galaxy_ode_evaluations, starburst_ode_evaluations, fast_path_hits,
+							  n_halos, n_subhalos, n_galaxies, duration_millis,
+							  evolution_micros / 1000., molgas_micros / 1000., tracking_micros / 1000.,
+							  output_micros / 1000., transfer_micros / 1000., std::move(thread_busy_millis), memory_usage.peak_rss,
+							  cooling_millis, memory_usage.rss, memory_usage.huge_pages, galaxy_ode_histogram, starburst_ode_histogram,
+							  most_expensive_trees(merger_trees, tree_micros, tree_evaluations, exec_params.tree_costs_count, false),
+							  most_expensive_trees(merger_trees, tree_micros, tree_evaluations, exec_params.tree_costs_count, true)};
+	LOG(info) << "Statistics for snapshot " << snapshot << std::endl << stats;
+	report_suppressed_log_messages("during snapshot " + std::to_string(snapshot));
+
+#ifdef SHARK_PROFILING
+	std::ostringstream profile;
+	profiling::write_table(profile, profiling::collect(), duration_millis * threads);
+	LOG(info) << "Time spent in physics modules during snapshot " << snapshot
+	          << " (all threads; nested modules are also counted in their callers)" << std::endl << profile.str();
+#endif
+
+	if (metrics_stream) {
+		stats.write_csv(*metrics_stream);
+		metrics_stream->flush();
+	}
+
+	if (status_file) {
+		status_file->snapshot_evolved(snapshot, n_galaxies, duration_micros / 1000, ode_evaluations, memory_usage.rss, memory_usage.peak_rss);
+	}
+
+	if (ode_costs_stream) {
+		ODECostRanking most_expensive_odes(exec_params.ode_costs_count);
+		for (auto &o: thread_objects) {
+			most_expensive_odes += o.physical_model->get_most_expensive_odes();
+		}
+		most_expensive_odes.write_csv(*ode_costs_stream, snapshot);
+		ode_costs_stream->flush();
+	}
+
+	if (stats.starform_integration_failure_rate() > exec_params.integration_failure_budget) {
+		std::ostringstream os;
+		os << stats.starform_integration_failures << " of " << stats.starform_integrations
+		   << " star formation integrations failed during snapshot " << snapshot
+		   << ", more than allowed by execution.integration_failure_budget = " << exec_params.integration_failure_budget;
+		throw math_error(os.str());
+	}
 }
 
-void SharkRunner::impl::run() {
+static
+std::unique_ptr<std::ofstream> open_csv_file(const std::string &filename, const ExecutionParameters &exec_params)
+{
+	// Restarted executions continue the files of the original one
+	auto mode = std::ios::out;
+	if (!exec_params.restart_file.empty()) {
+		mode |= std::ios::app | std::ios::ate;
+	}
+	std::unique_ptr<std::ofstream> stream(new std::ofstream(filename, mode));
+	if (!*stream) {
+		throw exception("cannot open " + filename + " for writing");
+	}
+	return stream;
+}
+
+void SharkRunner::impl::open_metrics_file()
+{
+	if (!exec_params.metrics_file.empty()) {
+		metrics_stream = open_csv_file(exec_params.metrics_file, exec_params);
+		if (metrics_stream->tellp() == 0) {
+			SnapshotStatistics::write_csv_header(*metrics_stream, threads);
+		}
+	}
+
+	if (!exec_params.ode_costs_file.empty()) {
+		ode_costs_stream = open_csv_file(exec_params.ode_costs_file, exec_params);
+		if (ode_costs_stream->tellp() == 0) {
+			ODECostRanking::write_csv_header(*ode_costs_stream, std::tuple_size<BasicPhysicalModel::state_t>::value);
+		}
+	}
+}
+
+void SharkRunner::impl::report_phase(const std::string &phase, int snapshot)
+{
+	if (status_file) {
+		status_file->phase(phase, snapshot);
+	}
+}
+
+void SharkRunner::impl::write_checkpoint(const std::vector<MergerTreePtr> &merger_trees, int snapshot)
+{
+	Checkpoint checkpoint;
+	checkpoint.snapshot = snapshot;
+	checkpoint.n_galaxy_ids = n_galaxy_ids;
+	checkpoint.options = options.values();
+	tracing::scoped_event trace_checkpoint("write checkpoint", "phase", "snapshot", snapshot);
+	checkpoint.write(writer->get_output_directory(snapshot) + "/checkpoint.bin", merger_trees, all_baryons);
+}
+
+int SharkRunner::impl::restore_checkpoint(const std::vector<MergerTreePtr> &merger_trees)
+{
+	Checkpoint checkpoint;
+	checkpoint.n_galaxy_ids = n_galaxy_ids;
+	checkpoint.read_header(exec_params.restart_file);
+	check_branch(checkpoint);
+	checkpoint.read(exec_params.restart_file, merger_trees, all_baryons);
+
+	LOG(info) << "Restarting evolution from snapshot " << checkpoint.snapshot;
+	return checkpoint.snapshot;
+}
+
+void SharkRunner::impl::check_branch(const Checkpoint &checkpoint)
+{
+	// Galaxies up to the checkpoint were evolved with the checkpoint's
+	// options, so changes must act only on later, lower redshifts
+	auto it = simulation_params.redshifts.find(checkpoint.snapshot);
+	if (it == simulation_params.redshifts.end()) {
+		throw invalid_option("Checkpoint " + exec_params.restart_file + " is for snapshot " + std::to_string(checkpoint.snapshot) + ", which has no redshift");
+	}
+	auto branch_redshift = it->second;
+
+	auto changes = OptionDependencies::shark_options().changes(Options(checkpoint.options), options);
+	std::ostringstream changed, invalid;
+	for (auto &change: changes) {
+		if (change.second > branch_redshift) {
+			invalid << " " << change.first;
+		}
+		else if (change.second >= 0) {
+			changed << " " << change.first;
+		}
+	}
+
+	if (!invalid.str().empty()) {
+		std::ostringstream os;
+		os << "Cannot branch off from checkpoint " << exec_params.restart_file << " at snapshot " << checkpoint.snapshot;
+		os << " (z=" << branch_redshift << "): these options differ from the checkpoint's and can affect galaxies";
+		os << " evolved before it:" << invalid.str();
+		throw invalid_option(os.str());
+	}
+	if (!changed.str().empty()) {
+		LOG(info) << "Branching off from checkpoint " << exec_params.restart_file << " with these changed options:" << changed.str();
+	}
+}
+
+std::vector<std::vector<unsigned int>> SharkRunner::impl::group_batches()
+{
+	auto &batches = exec_params.simulation_batches;
+	auto group_size = exec_params.batch_group_size;
+	if (group_size == 0 || group_size >= batches.size()) {
+		return {batches};
+	}
+
+	std::vector<std::vector<unsigned int>> groups;
+	for (std::size_t i = 0; i < batches.size(); i += group_size) {
+		auto group_end = batches.begin() + std::min(batches.size(), i + group_size);
+		groups.emplace_back(batches.begin() + i, group_end);
+	}
+	return groups;
+}
+
+void SharkRunner::impl::run_batches(const std::vector<unsigned int> &batches, const std::string &directory_suffix, const std::vector<unsigned int> *next_batches)
+{
+	exec_params.simulation_batches = batches;
+	exec_params.batch_directory_suffix = directory_suffix;
+	all_baryons = TotalBaryon();
+	tree_costs.clear();
 
-	std::vector<MergerTreePtr> merger_trees = import_trees();
+	report_phase(prefetching ? "waiting for prefetched trees" : "importing trees");
+	std::vector<MergerTreePtr> merger_trees = prefetching ? take_prefetched_trees() : import_trees();
+
+	// The next batch group is imported while this one is evolved
+	if (prefetcher && next_batches) {
+		prefetch_trees(*next_batches);
+	}
+	tree_total_micros.assign(merger_trees.size(), 0);
+	if (exec_params.numa_placement) {
+		tree_assignment = TreeAssignment(TreeAssignment::tree_costs(merger_trees), threads);
+	}
+	Timer index_t;
+	tracing::scoped_event trace_index("index trees", "stage");
+	tree_index.reset(new TreeIndex(merger_trees));
+	trace_index.finish();
+	LOG(info) << "Indexed merger trees in " << index_t;
 
 	/* Create the first generation of galaxies if halo is first appearing.*/
 	LOG(info) << "Creating initial galaxies in central subhalos across all merger trees";
-	GalaxyCreator galaxy_creator(cosmology, gas_cooling_params, simulation_params);
-	galaxy_creator.create_galaxies(merger_trees, all_baryons);
+	report_phase("creating galaxies");
+	GalaxyCreator galaxy_creator(cosmology, gas_cooling_params, simulation_params, exec_params.arena_allocation);
+	tracing::scoped_event trace_creation("create galaxies", "stage");
+	if (tree_assignment.empty()) {
+		n_galaxy_ids = galaxy_creator.create_galaxies(merger_trees, all_baryons);
+	}
+	else {
+		n_galaxy_ids = galaxy_creator.create_galaxies(merger_trees, all_baryons, tree_assignment);
+	}
+	trace_creation.finish();
+	adapt_to_memory_budget(memory_tracker.record("galaxy creation"));
+
+	// Created only now, as the memory budget might change how outputs are written
+	writer = make_galaxy_writer(exec_params, cosmo_params, cosmology, dark_matter_halos, simulation_params, threads);
+
+	int first_snapshot = simulation_params.min_snapshot;
+	if (!exec_params.restart_file.empty()) {
+		first_snapshot = restore_checkpoint(merger_trees);
+		for (int snapshot = simulation_params.min_snapshot; snapshot < first_snapshot; snapshot++) {
+			release_snapshot(merger_trees, snapshot);
+		}
+	}
+	if (status_file) {
+		status_file->set_group_snapshots(simulation_params.max_snapshot - first_snapshot);
+	}
 
 	// Go, go, go!
 	// Note that we evolve galaxies in merger tress in the snapshot range [min, max)
 	// This is because at snapshot "i" we don't evolve galaxies AT snapshot "i",
 	// but rather FROM snapshot "i" TO snapshot "i+1".
-	for(int snapshot = simulation_params.min_snapshot; snapshot <= simulation_params.max_snapshot - 1; snapshot++) {
+	for(int snapshot = first_snapshot; snapshot <= simulation_params.max_snapshot - 1; snapshot++) {
 		evolve_merger_trees(merger_trees, snapshot);
+		if (exec_params.checkpoint_snapshots.find(snapshot + 1) != exec_params.checkpoint_snapshots.end()) {
+			report_phase("writing checkpoint", snapshot + 1);
+			write_checkpoint(merger_trees, snapshot + 1);
+		}
+		release_snapshot(merger_trees, snapshot);
+		if (exec_params.tree_migration && snapshot + 1 < simulation_params.max_snapshot) {
+			migrate_trees(merger_trees, snapshot + 1);
+		}
+	}
+
+	// Outputs might still be being written in the background
+	report_phase("finishing outputs");
+	writer->finish();
+
+	if (!exec_params.halo_parallelism) {
+		for (auto micros: tree_total_micros) {
+			tree_time_histogram.add(micros);
+		}
+	}
+
+	tree_index.reset();
+	release_trees(merger_trees);
+}
+
+void SharkRunner::impl::adapt_to_memory_budget(const MemoryUsage &usage)
+{
+	auto budget = memory_tracker.get_budget();
+	if (exec_params.memory_budget_policy != ExecutionParameters::BUDGET_ADAPT || budget == 0 || usage.rss <= budget / 2) {
+		return;
+	}
+
+	// Evolving galaxies usually needs as much memory as the merger trees
+	// themselves, so start saving memory straight away
+	std::ostringstream os;
+	os << "Merger trees and initial galaxies take " << memory_amount(usage.rss);
+	os << ", more than half of the memory budget of " << memory_amount(budget) << ".";
+	if (!exec_params.release_evolved_snapshots) {
+		exec_params.release_evolved_snapshots = true;
+		os << " Enabling execution.release_evolved_snapshots.";
+	}
+	if (exec_params.output_sf_histories && !exec_params.stream_sf_histories && exec_params.restart_file.empty() && !exec_params.tree_migration) {
+		exec_params.stream_sf_histories = true;
+		os << " Enabling execution.stream_sf_histories.";
+	}
+	LOG(warning) << os.str();
+}
+
+void SharkRunner::impl::release_snapshot(const std::vector<MergerTreePtr> &merger_trees, int snapshot)
+{
+	if (!exec_params.release_evolved_snapshots) {
+		return;
+	}
+
+	// Outputs being written in the background hold copies of the values
+	// they need, so structures can be released straight away
+	Timer t;
+	tracing::scoped_event trace_release("release snapshot", "phase", "snapshot", snapshot);
+	tree_index->release_snapshot(snapshot);
+	omp_static_for(merger_trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+		tree->release_snapshot(snapshot);
+	});
+	LOG(debug) << "Released halos of snapshot " << snapshot << " in " << t;
+}
+
+void SharkRunner::impl::migrate_trees(std::vector<MergerTreePtr> &merger_trees, int snapshot)
+{
+	if (mpi::size() == 1) {
+		return;
+	}
+
+	// Trees are expected to cost next what they cost in the last snapshot.
+	// ODE evaluations rather than wall times are used so the same trees are
+	// migrated every time the same execution is repeated
+	Timer t;
+	tracing::scoped_event trace_migration("migrate trees", "phase", "snapshot", snapshot);
+	report_phase("migrating trees", snapshot);
+	std::vector<double> costs(tree_evaluations.begin(), tree_evaluations.end());
+	auto loads = mpi::gather_all(std::accumulate(costs.begin(), costs.end(), 0.));
+	auto transfers = tree_migration::plan_transfers(loads, exec_params.tree_migration_imbalance);
+	if (transfers.empty()) {
+		return;
+	}
+	auto destinations = tree_migration::select_trees(costs, transfers[mpi::rank()]);
+
+	std::vector<MergerTreePtr> staying;
+	std::vector<std::size_t> staying_indices;
+	std::vector<std::vector<MergerTreePtr>> leaving(mpi::size());
+	for (std::size_t i = 0; i != merger_trees.size(); i++) {
+		auto &tree = merger_trees[i];
+		if (destinations[i] < 0) {
+			staying.push_back(tree);
+			staying_indices.push_back(i);
+			continue;
+		}
+		while (!tree->halos.empty() && tree->halos.begin()->first < snapshot) {
+			tree->release_snapshot(tree->halos.begin()->first);
+		}
+		tree_time_histogram.add(tree_total_micros[i]);
+		leaving[destinations[i]].push_back(tree);
+	}
+
+	std::vector<std::string> outgoing(mpi::size());
+	std::size_t n_sent = 0;
+	for (int proc = 0; proc != mpi::size(); proc++) {
+		if (!leaving[proc].empty()) {
+			std::ostringstream os;
+			tree_migration::write_trees(os, "merger trees for process " + std::to_string(proc), leaving[proc], snapshot);
+			outgoing[proc] = os.str();
+			n_sent += leaving[proc].size();
+		}
+	}
+	leaving.clear();
+	auto incoming = mpi::exchange(outgoing);
+	outgoing.clear();
+
+	// Measurements of the trees that stay are kept, those of received ones
+	// start anew
+	merger_trees = std::move(staying);
+	std::vector<double> staying_costs;
+	std::vector<Timer::duration> staying_micros;
+	for (auto i: staying_indices) {
+		if (!tree_costs.empty()) {
+			staying_costs.push_back(tree_costs[i]);
+		}
+		staying_micros.push_back(tree_total_micros[i]);
+	}
+	tree_costs = std::move(staying_costs);
+	tree_total_micros = std::move(staying_micros);
+	auto n_staying = merger_trees.size();
+	for (int proc = 0; proc != mpi::size(); proc++) {
+		if (!incoming[proc].empty()) {
+			std::istringstream is(incoming[proc]);
+			tree_migration::read_trees(is, "merger trees from process " + std::to_string(proc), merger_trees, n_galaxy_ids, threads);
+		}
+	}
+	incoming.clear();
+	tree_total_micros.resize(merger_trees.size(), 0);
+	if (!tree_costs.empty()) {
+		tree_costs.resize(merger_trees.size(), 0);
+	}
+
+	tree_index.reset(new TreeIndex(merger_trees));
+	if (exec_params.numa_placement) {
+		tree_assignment = TreeAssignment(TreeAssignment::tree_costs(merger_trees), threads);
+	}
+	LOG(info) << "Sent " << n_sent << " merger trees to and received " << merger_trees.size() - n_staying
+	          << " from other processes before snapshot " << snapshot << " in " << t;
+}
+
+void SharkRunner::impl::write_global_properties(TotalBaryon &global_baryons)
+{
+	// Amounts are tracked in a per-snapshot basis starting from the minimum
+	// snapshot, so outputs get only those up to their snapshot
+	for (auto snapshot: exec_params.output_snapshots) {
+		if (snapshot <= simulation_params.min_snapshot || snapshot > simulation_params.max_snapshot) {
+			continue;
+		}
+		TotalBaryon baryons = global_baryons;
+		baryons.truncate(snapshot - simulation_params.min_snapshot);
+		writer->write_global(snapshot, baryons);
+	}
+}
+
+/**
+ * Records a trace of the execution while alive, which is written into a file
+ * when destroyed. Traces of failed executions are written too, as they show
+ * what was happening at the time of the failure.
+ */
+class trace_recording {
+
+public:
+	explicit trace_recording(const std::string &filename) :
+		filename(filename)
+	{
+		if (!filename.empty()) {
+			tracing::start();
+		}
+	}
+
+	~trace_recording()
+	{
+		if (filename.empty()) {
+			return;
+		}
+		tracing::stop();
+		try {
+			Timer t;
+			tracing::write_chrome_trace(filename, mpi::rank());
+			LOG(info) << "Trace written into " << filename << " in " << t;
+		} catch (const std::exception &e) {
+			LOG(error) << "Trace could not be written: " << e.what();
+		}
+	}
+
+private:
+	std::string filename;
+};
+
+void SharkRunner::impl::run() {
+
+	auto batch_groups = group_batches();
+	auto n_groups = batch_groups.size();
+	if (n_groups > 1 && !exec_params.restart_file.empty()) {
+		throw invalid_option("execution.restart_file cannot be used together with execution.batch_group_size");
+	}
+	if (exec_params.stream_sf_histories && !exec_params.restart_file.empty()) {
+		throw invalid_option("execution.restart_file cannot be used together with execution.stream_sf_histories");
+	}
+	// Shared files are written once per snapshot by all processes together
+	if (n_groups > 1 && exec_params.shared_output) {
+		throw invalid_option("execution.shared_output cannot be used together with execution.batch_group_size");
 	}
+	if (n_groups > 1 && exec_params.tree_migration) {
+		throw invalid_option("execution.tree_migration cannot be used together with execution.batch_group_size");
+	}
+
+	if (exec_params.numa_placement) {
+		pin_threads(threads);
+	}
+	huge_pages::enable(exec_params.huge_pages);
+	if (n_groups > 1 && exec_params.prefetch_threads > 0 && !shared_trees) {
+		prefetcher.reset(new BackgroundWorker(1));
+	}
+
+	std::string directory_suffix;
+	if (mpi::size() > 1) {
+		directory_suffix += "_" + std::to_string(mpi::rank());
+	}
+
+	// Batches never share merger trees, so groups of them can be evolved
+	// fully independently, keeping only one group in memory at a time
+	open_metrics_file();
+	if (!exec_params.status_file.empty()) {
+		status_file.reset(new StatusFile(exec_params.status_file, exec_params.name_model, n_groups));
+	}
+	trace_recording trace(exec_params.trace_file);
+	TotalBaryon global_baryons;
+	for (std::size_t i = 0; i != n_groups; i++) {
+		if (status_file) {
+			status_file->start_batch_group(i);
+		}
+		if (n_groups > 1) {
+			LOG(info) << "Processing batch group " << i + 1 << "/" << n_groups;
+			auto next_batches = i + 1 < n_groups ? &batch_groups[i + 1] : nullptr;
+			run_batches(batch_groups[i], directory_suffix + "_" + std::to_string(i), next_batches);
+		}
+		else {
+			run_batches(batch_groups[i], directory_suffix, nullptr);
+		}
+
+		if (i == 0) {
+			global_baryons = std::move(all_baryons);
+		}
+		else {
+			global_baryons += all_baryons;
+		}
+	}
+
+	if (!exec_params.halo_parallelism) {
+		LOG(info) << "Wall time spent on each merger tree over all snapshots, in [us]: " << tree_time_histogram;
+	}
+
+	const auto &phases = memory_tracker.get_phases();
+	auto highest = std::max_element(phases.begin(), phases.end(), [](const MemoryUsage &lhs, const MemoryUsage &rhs) {
+		return lhs.rss < rhs.rss;
+	});
+	if (highest != phases.end()) {
+		LOG(info) << "Highest memory usage was " << memory_amount(highest->rss) << " after " << highest->phase
+		          << ", peak memory usage was " << memory_amount(phases.back().peak_rss);
+	}
+
+	// Write the global properties of the whole volume handled by this
+	// execution when it has been split among processes and/or batch groups
+	if ((n_groups > 1 || mpi::size() > 1) && !summaries) {
+		mpi::sum_all(global_baryons);
+		if (mpi::rank() == 0) {
+			write_global_properties(global_baryons);
+		}
+	}
+
+	if (status_file) {
+		status_file->finish();
+	}
+}
+
+void SharkRunner::impl::run(std::map<int, SummaryStatistics> &summaries)
+{
+	// Only the summary statistics are produced, so nothing that ends up
+	// in other outputs is needed
+	this->summaries = &summaries;
+	exec_params.output_sf_histories = false;
+	exec_params.checkpoint_snapshots.clear();
+	run();
+	this->summaries = nullptr;
 }
 
 } // namespace shark
@@ -0,0 +1,123 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Implementation of SharkSession class methods
+ */
+
+#include <gsl/gsl_errno.h>
+
+#include "exceptions.h"
+#include "execution.h"
+#include "shark_runner.h"
+#include "shark_session.h"
+#include "simulation.h"
+
+namespace shark {
+
+static
+void throw_exception_gsl_handler(const char *reason, const char *file, int line, int gsl_errno)
+{
+	if (scoped_gsl_error_suppression::active()) {
+		return;
+	}
+	throw gsl_error(reason, file, line, gsl_errno, gsl_strerror(gsl_errno));
+}
+
+SharkSession::SharkSession(const Options &options, unsigned int threads) :
+	base_options(options),
+	threads(threads),
+	trees(std::make_shared<std::stringstream>())
+{
+	// GSL aborts the whole process on errors by default,
+	// which is not acceptable for a library
+	gsl_set_error_handler(&throw_exception_gsl_handler);
+
+	SharkRunner(base_options, threads, trees).import_trees();
+}
+
+void SharkSession::set(const std::string &optspec)
+{
+	optspecs.push_back(optspec);
+}
+
+void SharkSession::reset()
+{
+	optspecs.clear();
+}
+
+Options SharkSession::current_options() const
+{
+	Options options = base_options;
+	for (auto &optspec: optspecs) {
+		options.add(optspec);
+	}
+	return options;
+}
+
+void SharkSession::run()
+{
+	summaries.clear();
+	last_ode_evaluations = 0;
+	auto options = current_options();
+
+	SimulationParameters sim_params(options);
+	ExecutionParameters exec_params(options);
+	redshifts = sim_params.redshifts;
+	volume = sim_params.volume * exec_params.simulation_batches.size();
+
+	SharkRunner runner(options, threads, trees);
+	runner.run(summaries);
+	last_ode_evaluations = runner.get_ode_evaluations();
+}
+
+std::vector<int> SharkSession::snapshots() const
+{
+	std::vector<int> snapshots;
+	for (auto &snapshot_and_summary: summaries) {
+		snapshots.push_back(snapshot_and_summary.first);
+	}
+	return snapshots;
+}
+
+const SummaryStatistics &SharkSession::summary(int snapshot) const
+{
+	auto it = summaries.find(snapshot);
+	if (it == summaries.end()) {
+		throw invalid_argument("no summary statistics for snapshot " + std::to_string(snapshot));
+	}
+	return it->second;
+}
+
+std::vector<double> SharkSession::get(int snapshot, const std::string &name) const
+{
+	auto &stats = summary(snapshot);
+	if (name == "run_info/redshift") {
+		return {redshifts.at(snapshot)};
+	}
+	else if (name == "run_info/effective_volume") {
+		return {volume};
+	}
+	return stats.get(name, volume);
+}
+
+}  // namespace shark
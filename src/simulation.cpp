@@ -32,6 +32,7 @@
 #include "exceptions.h"
 #include "logging.h"
 #include "numerical_constants.h"
+#include "option_dependencies.h"
 #include "simulation.h"
 
 
@@ -56,6 +57,11 @@ SimulationParameters::SimulationParameters(const Options &options)
 
 }
 
+void SimulationParameters::declare_dependencies(OptionDependencies &dependencies)
+{
+	dependencies.never("simulation.sim_name");
+}
+
 void SimulationParameters::load_simulation_tables(const std::string &redshift_file)
 {
 
@@ -0,0 +1,138 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * SpatialSelection implementation
+ */
+
+#include <map>
+#include <ostream>
+#include <unordered_set>
+
+#include "exceptions.h"
+#include "spatial_selection.h"
+
+namespace shark {
+
+SpatialSelection::SpatialSelection(shape_t shape, const std::vector<double> &region) :
+	shape(shape), region(region)
+{
+	if (shape == NONE && !region.empty()) {
+		throw invalid_argument("A spatial selection without shape can't have a region");
+	}
+	else if (shape == BOX && (region.size() != 6 || region[3] <= region[0] || region[4] <= region[1] || region[5] <= region[2])) {
+		throw invalid_argument("A box needs a minimum x, y and z and a larger maximum x, y and z");
+	}
+	else if (shape == SPHERE && (region.size() != 4 || region[3] <= 0)) {
+		throw invalid_argument("A sphere needs the x, y and z of its centre and a positive radius");
+	}
+}
+
+bool SpatialSelection::contains(double x, double y, double z) const
+{
+	if (shape == BOX) {
+		// Half-open, so adjacent boxes never select the same tree
+		return x >= region[0] && x < region[3] &&
+		       y >= region[1] && y < region[4] &&
+		       z >= region[2] && z < region[5];
+	}
+	else if (shape == SPHERE) {
+		auto dx = x - region[0];
+		auto dy = y - region[1];
+		auto dz = z - region[2];
+		return dx * dx + dy * dy + dz * dz < region[3] * region[3];
+	}
+	return true;
+}
+
+std::vector<std::size_t> SpatialSelection::tree_rows(const std::vector<int> &snapshots, const std::vector<Halo::id_t> &host_halos,
+                                                     const std::vector<Halo::id_t> &descendant_halos, const std::vector<float> &root_positions,
+                                                     int root_snapshot) const
+{
+	auto n_rows = snapshots.size();
+	if (host_halos.size() != n_rows || descendant_halos.size() != n_rows) {
+		throw invalid_argument("snapshots, host and descendant halos must have the same number of rows");
+	}
+
+	std::map<int, std::vector<std::size_t>> rows_by_snapshot;
+	for (std::size_t i = 0; i != n_rows; i++) {
+		rows_by_snapshot[snapshots[i]].push_back(i);
+	}
+
+	// Root halos are selected by the position of their first row
+	std::unordered_set<Halo::id_t> selected;
+	std::unordered_set<Halo::id_t> roots;
+	auto &root_rows = rows_by_snapshot[root_snapshot];
+	if (root_positions.size() != 3 * root_rows.size()) {
+		throw invalid_argument("root_positions must have the x, y and z of every row in the root snapshot");
+	}
+	for (std::size_t j = 0; j != root_rows.size(); j++) {
+		auto halo = host_halos[root_rows[j]];
+		if (roots.insert(halo).second && contains(root_positions[3 * j], root_positions[3 * j + 1], root_positions[3 * j + 2])) {
+			selected.insert(halo);
+		}
+	}
+
+	// Progenitors, one snapshot at a time so links are followed all the way
+	auto root = rows_by_snapshot.find(root_snapshot);
+	for (auto it = std::map<int, std::vector<std::size_t>>::reverse_iterator(root); it != rows_by_snapshot.rend(); it++) {
+		for (auto i: it->second) {
+			if (selected.count(descendant_halos[i])) {
+				selected.insert(host_halos[i]);
+			}
+		}
+	}
+
+	// Descendants of the selected roots
+	for (auto it = root; it != rows_by_snapshot.end(); it++) {
+		for (auto i: it->second) {
+			if (selected.count(host_halos[i])) {
+				selected.insert(descendant_halos[i]);
+			}
+		}
+	}
+
+	std::vector<std::size_t> rows;
+	for (std::size_t i = 0; i != n_rows; i++) {
+		if (selected.count(host_halos[i])) {
+			rows.push_back(i);
+		}
+	}
+	return rows;
+}
+
+std::ostream &operator<<(std::ostream &os, const SpatialSelection &selection)
+{
+	auto &region = selection.get_region();
+	if (selection.get_shape() == SpatialSelection::BOX) {
+		os << "box [" << region[0] << ", " << region[3] << ") x [" << region[1] << ", " << region[4]
+		   << ") x [" << region[2] << ", " << region[5] << ")";
+	}
+	else if (selection.get_shape() == SpatialSelection::SPHERE) {
+		os << "sphere of radius " << region[3] << " around (" << region[0] << ", " << region[1] << ", " << region[2] << ")";
+	}
+	else {
+		os << "whole volume";
+	}
+	return os;
+}
+
+}  // namespace shark
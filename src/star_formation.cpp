@@ -26,7 +26,9 @@
 
 #include "logging.h"
 #include "numerical_constants.h"
+#include "profiling.h"
 #include "star_formation.h"
+#include "timer.h"
 #include "utils.h"
 
 namespace shark {
@@ -40,6 +42,82 @@ struct galaxy_properties_for_integration {
 	bool burst;
 };
 
+/**
+ * Borrows the Integrator of the calling thread during its lifetime,
+ * adding the intervals it used into the given counter when destroyed
+ */
+class BorrowedIntegrator {
+public:
+	BorrowedIntegrator(std::size_t max_intervals, unsigned long int &intervals) :
+		integrator(thread_integrator(max_intervals)),
+		intervals(intervals),
+		initial_intervals(integrator.get_num_intervals())
+	{
+	}
+
+	~BorrowedIntegrator()
+	{
+		intervals += integrator.get_num_intervals() - initial_intervals;
+	}
+
+	Integrator *operator->()
+	{
+		return &integrator;
+	}
+
+private:
+	Integrator &integrator;
+	unsigned long int &intervals;
+	unsigned long int initial_intervals;
+};
+
+struct StarFormationAndProps {
+	StarFormation *star_formation;
+	galaxy_properties_for_integration *props;
+};
+
+static
+double sfr_density_integrand(double r, void *ctx)
+{
+	StarFormationAndProps *sf_and_props = reinterpret_cast<StarFormationAndProps *>(ctx);
+	return sf_and_props->star_formation->star_formation_rate_surface_density(r, sf_and_props->props);
+}
+
+static
+double jsfr_density_integrand(double r, void *ctx)
+{
+	StarFormationAndProps *sf_and_props = reinterpret_cast<StarFormationAndProps *>(ctx);
+	return r * sf_and_props->star_formation->star_formation_rate_surface_density(r, sf_and_props->props);
+}
+
+static
+void sfr_and_jsfr_density_integrand(double r, void *ctx, double f[])
+{
+	f[0] = sfr_density_integrand(r, ctx);
+	f[1] = r * f[0];
+}
+
+static
+double molecular_density_integrand(double r, void *ctx)
+{
+	StarFormationAndProps *sf_and_props = reinterpret_cast<StarFormationAndProps *>(ctx);
+	return sf_and_props->star_formation->molecular_surface_density(r, sf_and_props->props);
+}
+
+static
+double jmol_density_integrand(double r, void *ctx)
+{
+	StarFormationAndProps *sf_and_props = reinterpret_cast<StarFormationAndProps *>(ctx);
+	return r * sf_and_props->star_formation->molecular_surface_density(r, sf_and_props->props);
+}
+
+static
+void molecular_and_jmol_density_integrand(double r, void *ctx, double f[])
+{
+	f[0] = molecular_density_integrand(r, ctx);
+	f[1] = r * f[0];
+}
+
 StarFormationParameters::StarFormationParameters(const Options &options)
 {
 	options.load("star_formation.model", model, true);
@@ -55,6 +133,10 @@ StarFormationParameters::StarFormationParameters(const Options &options)
 
 	options.load("star_formation.clump_factor_kmt09", clump_factor_KMT09);
 
+	options.load("star_formation.tabulated_integrals", tabulated_integrals);
+	options.load("star_formation.table_points_per_dex", table_points_per_dex);
+	options.load("star_formation.fixed_quadrature", fixed_quadrature);
+
 	// Convert surface density to internal code units.
 	sigma_HI_crit = sigma_HI_crit * std::pow(constants::MEGA,2.0);
 
@@ -84,17 +166,40 @@ Options::get<StarFormationParameters::StarFormationModel>(const std::string &nam
 	throw invalid_option(os.str());
 }
 
+constexpr std::size_t StarFormation::max_integration_intervals;
+
 StarFormation::StarFormation(StarFormationParameters parameters, RecyclingParameters recycleparams, const CosmologyPtr &cosmology) :
 	parameters(parameters),
 	recycleparams(recycleparams),
 	cosmology(cosmology),
-	integrator(1000)
+	integrals_table()
 {
-	// no-op
+	if (parameters.tabulated_integrals) {
+		integrals_table = create_integrals_table();
+	}
+}
+
+StarFormation::disk_properties StarFormation::get_disk_properties(double rgas, double rstar, double z) const {
+	return {
+		rgas,
+		rstar,
+		cosmology->comoving_to_physical_size(rgas / constants::RDISK_HALF_SCALE, z),
+		cosmology->comoving_to_physical_size(rstar / constants::RDISK_HALF_SCALE, z)
+	};
 }
 
 double StarFormation::star_formation_rate(double mcold, double mstar, double rgas, double rstar, double zgas, double z,
 								          bool burst, double vgal, double &jrate, double jgas) {
+	return star_formation_rate(mcold, mstar, get_disk_properties(rgas, rstar, z), zgas, burst, vgal, jrate, jgas);
+}
+
+double StarFormation::star_formation_rate(double mcold, double mstar, const disk_properties &disk, double zgas,
+								          bool burst, double vgal, double &jrate, double jgas) {
+
+	SHARK_PROFILE(STAR_FORMATION);
+
+	double rgas = disk.rgas;
+	double rstar = disk.rstars;
 
 	if (std::isnan(rgas)) {
 		throw invalid_argument("rgas is NaN, cannot calculate star formation rate");
@@ -119,8 +224,8 @@ double StarFormation::star_formation_rate(double mcold, double mstar, double rga
 	 */
 	// Define properties that are input for the SFR calculation.
 
-	double re = cosmology->comoving_to_physical_size(rgas / constants::RDISK_HALF_SCALE, z);
-	double rse = cosmology->comoving_to_physical_size(rstar / constants::RDISK_HALF_SCALE, z);
+	double re = disk.re;
+	double rse = disk.rse;
 
 	double Sigma_gas = cosmology->comoving_to_physical_mass(mcold) / constants::PI2 / (re * re);
 	double Sigma_star = 0;
@@ -137,36 +242,23 @@ double StarFormation::star_formation_rate(double mcold, double mstar, double rga
 		burst,
 	};
 
-	struct StarFormationAndProps {
-		StarFormation *star_formation;
-		galaxy_properties_for_integration *props;
-	};
-
-	auto f = [](double r, void *ctx) -> double {
-		StarFormationAndProps *sf_and_props = reinterpret_cast<StarFormationAndProps *>(ctx);
-		return sf_and_props->star_formation->star_formation_rate_surface_density(r, sf_and_props->props);
-	};
-
-	double rmin = 0;
-	double rmax = 5.0*re;
-
-	StarFormationAndProps sf_and_props = {this, &props};
-
+	bool calc_jsfr = !burst && parameters.angular_momentum_transfer;
 	double result = 0;
-	try{
-		result = integrator.integrate(f, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
-	} catch (gsl_error &e) {
-		auto gsl_errno = e.get_gsl_errno();
-		std::ostringstream os;
-		os << "SFR integration failed with GSL error number " << gsl_errno << ": ";
-		os << gsl_strerror(gsl_errno) << ", reason=" << e.get_reason();
-		os << ". We'll attempt manual integration now";
-		LOG(warning) << os.str();
-
-		// Perform manual integration.
-		// TODO: check that error is affordable (i.e., maybe the error is really bad and the
-		// program should stop)
-		result = manual_integral(f, &sf_and_props, rmin, rmax);
+	double jSFR = 0;
+	if (!tabulated_integrals(props, result, jSFR)) {
+		double integrals[2];
+		if (parameters.fixed_quadrature &&
+		    integrate_fixed(&StarFormation::star_formation_rate_surface_density, props, calc_jsfr ? 2 : 1, parameters.Accuracy_SFeqs, integrals)) {
+			result = integrals[0];
+			jSFR = calc_jsfr ? integrals[1] : 0;
+		}
+		else if (calc_jsfr) {
+			integrate(sfr_and_jsfr_density_integrand, sfr_density_integrand, jsfr_density_integrand,
+			          props, parameters.Accuracy_SFeqs, "SFR and jSFR", result, jSFR);
+		}
+		else {
+			result = integrate(sfr_density_integrand, props, parameters.Accuracy_SFeqs, "SFR");
+		}
 	}
 
 	// Avoid negative values.
@@ -181,33 +273,6 @@ double StarFormation::star_formation_rate(double mcold, double mstar, double rga
 		// Check whether user wishes to calculate angular momentum transfer from gas to stars.
 		if(parameters.angular_momentum_transfer){
 
-			// TODO: it would be nice to somehow reuse some of the values from the previous integration
-			// in here. At least initially during the first round the integration algorithm will run
-			// over the same set of 'r' that it used during the first round of the previous integration,
-			// so we could save ourselves lots of calculation by storing those values and reusing them here
-			auto f_j = [](double r, void *ctx) -> double {
-				StarFormationAndProps *sf_and_props = reinterpret_cast<StarFormationAndProps *>(ctx);
-				return r * sf_and_props->star_formation->star_formation_rate_surface_density(r, sf_and_props->props);
-			};
-
-			// React to integration errors by using a way-simpler 4-point manual integration
-			double jSFR;
-			try{
-				jSFR = integrator.integrate(f_j, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
-			} catch (gsl_error &e) {
-				auto gsl_errno = e.get_gsl_errno();
-				std::ostringstream os;
-				os << "jSFR integration failed with GSL error number " << gsl_errno << ": ";
-				os << gsl_strerror(gsl_errno) << ", reason=" << e.get_reason();
-				os << ". We'll attempt manual integration now";
-				LOG(warning) << os.str();
-
-				// Perform manual integration.
-				// TODO: check that error is affordable (i.e., maybe the error is really bad and the
-				// program should stop)
-				jSFR = manual_integral(f_j, &sf_and_props, rmin, rmax);
-			}
-
 			jrate = cosmology->physical_to_comoving_mass(jSFR) * vgal; //assumes a flat rotation curve.
 
 
@@ -243,137 +308,339 @@ double StarFormation::star_formation_rate(double mcold, double mstar, double rga
 
 }
 
-double StarFormation::star_formation_rate_surface_density(double r, void * params){
+double StarFormation::integrate(func_t f, galaxy_properties_for_integration &props, double epsrel, const char *name)
+{
+	double rmin = 0;
+	double rmax = 5.0*props.re;
 
-	using namespace constants;
+	StarFormationAndProps sf_and_props = {this, &props};
 
-	// apply molecular SF law
-	auto props = reinterpret_cast<galaxy_properties_for_integration *>(params);
+	double result;
+	BorrowedIntegrator integrator(max_integration_intervals, integration_intervals);
+	integrations++;
+	int gsl_errno = integrator->try_integrate(f, &sf_and_props, rmin, rmax, 0.0, epsrel, result);
+	if (gsl_errno == GSL_SUCCESS) {
+		return result;
+	}
 
-	double Sigma_gas = props->sigma_gas0 * std::exp(-r / props->re);
+	// Failures are counted, and the fraction that is affordable is checked
+	// at the end of each snapshot against the failure budget
+	integration_failures++;
+	LOG_LIMITED(warning) << name << " integration failed with GSL error number " << gsl_errno << ": "
+	                     << gsl_strerror(gsl_errno) << ". We'll attempt manual integration now";
+	return manual_integral(f, &sf_and_props, rmin, rmax);
+}
 
-	// Avoid negative numbers.
-	if(Sigma_gas < 0){
-		Sigma_gas = 0;
+void StarFormation::integrate(Integrator::vector_func_t f, func_t f0, func_t f1, galaxy_properties_for_integration &props, double epsrel,
+                              const char *name, double &i0, double &i1)
+{
+	StarFormationAndProps sf_and_props = {this, &props};
+	double result[2];
+
+	int gsl_errno;
+	{
+		BorrowedIntegrator integrator(max_integration_intervals, integration_intervals);
+		integrations++;
+		gsl_errno = integrator->try_integrate(f, &sf_and_props, 2, 0, 5.0*props.re, 0.0, epsrel, result);
+	}
+	if (gsl_errno == GSL_SUCCESS) {
+		i0 = result[0];
+		i1 = result[1];
+		return;
 	}
 
-	double Sigma_stars = 0;
+	integration_failures++;
+	LOG_LIMITED(warning) << name << " integration failed with GSL error number " << gsl_errno << ": "
+	                     << gsl_strerror(gsl_errno) << ". We'll attempt separate integrations now";
+	i0 = integrate(f0, props, epsrel, name);
+	i1 = integrate(f1, props, epsrel, name);
+}
 
-	// Define Sigma_stars only if stellar mass and radius are positive.
-	if(props->rse > 0 && props->sigma_star0 > 0){
-		Sigma_stars = props->sigma_star0 * std::exp(-r / props->rse);
+bool StarFormation::integrate_fixed(batch_density_t density, const galaxy_properties_for_integration &props, std::size_t n, double epsrel, double result[])
+{
+	// The second component, if requested, is the first one weighted by r
+	auto batch_f = [&](const double r[], std::size_t n_points, double values[]) {
+		(this->*density)(r, n_points, props, values);
+		if (n == 2) {
+			for (std::size_t i = 0; i != n_points; i++) {
+				values[n_points + i] = r[i] * values[i];
+			}
+		}
+	};
+	BorrowedIntegrator integrator(max_integration_intervals, integration_intervals);
+	return integrator->integrate_fixed(batch_f, n, 0, 5.0*props.re, 0.0, epsrel, result);
+}
+
+/**
+ * The SFR integrals scale with the disk size as re^2 (SFR) and re^3 (jSFR),
+ * and otherwise depend on:
+ *  * BR06: the central gas surface density, the ratio between the central
+ *    stellar surface density and re (the stellar term of the midplane
+ *    pressure goes as sqrt(Sigma_stars / r)), and the ratio re/rse.
+ *  * GD14, K13 and KMT09: the central gas surface density and the gas
+ *    metallicity.
+ * Tables are therefore built for re = 1, over the log10 of these quantities.
+ */
+static
+bool br06_model(const StarFormationParameters &parameters)
+{
+	return parameters.model == StarFormationParameters::BR06;
+}
+
+void StarFormation::table_integrals(const std::vector<double> &coords, double &i0, double &i1)
+{
+	galaxy_properties_for_integration props {std::pow(10., coords[0]), 0, 1, 0, 0, false};
+	if (br06_model(parameters)) {
+		props.sigma_star0 = std::pow(10., coords[1]);
+		props.rse = std::pow(10., -coords[2]);
+	}
+	else {
+		props.zgas = std::pow(10., coords[1]);
 	}
 
-	double fracmol = fmol(Sigma_gas, Sigma_stars, props->zgas, r);
+	// Tabulated values are calculated more accurately than what is required
+	// of the integrals, leaving room for the interpolation error
+	auto epsrel = parameters.Accuracy_SFeqs / 10;
+	integrate(sfr_and_jsfr_density_integrand, sfr_density_integrand, jsfr_density_integrand,
+	          props, epsrel, "Tabulated SFR and jSFR", i0, i1);
+}
 
-	double sfr_density = 0;
+std::shared_ptr<const StarFormationTable> StarFormation::create_integrals_table()
+{
+	auto points = [&](double min, double max) {
+		return StarFormationTable::axis {min, max, static_cast<unsigned int>(std::ceil((max - min) * parameters.table_points_per_dex)) + 1};
+	};
 
-	if(parameters.model == StarFormationParameters::BR06 || parameters.model == StarFormationParameters::GD14){
-		sfr_density = PI2 * parameters.nu_sf * fracmol * Sigma_gas * r; //Add the 2PI*r to Sigma_SFR to make integration.
+	// Gas surface densities in Msun/Mpc^2 (1e-3 to 1e5 Msun/pc^2)
+	std::vector<StarFormationTable::axis> axes {points(9, 17)};
+	if (br06_model(parameters)) {
+		axes.emplace_back(points(9, 23));
+		axes.emplace_back(points(-1.5, 1.5));
+	}
+	else {
+		axes.emplace_back(points(-5, 1));
 	}
-	else if (parameters.model == StarFormationParameters::KMT09 || parameters.model == StarFormationParameters::K13){
-		double sfr_ff = 0;
 
-		if(Sigma_gas < parameters.sigma_crit_KMT09){
-			sfr_ff = std::pow(Sigma_gas/parameters.sigma_crit_KMT09, -0.33);
-		}
-		else{
-			sfr_ff = std::pow(Sigma_gas/parameters.sigma_crit_KMT09, 0.33);
-		}
+	Timer t;
+	auto integrals = [this](const std::vector<double> &coords, double &i0, double &i1) {
+		table_integrals(coords, i0, i1);
+	};
+	auto table = std::make_shared<const StarFormationTable>(std::move(axes), integrals);
 
-		sfr_density = PI2 * fracmol * sfr_ff * Sigma_gas / 2.6 * r;
+	// Don't accept tables that are less precise than the integration itself
+	auto error = table->max_relative_error(integrals, 10000);
+	LOG(info) << "Created table of SFR integrals with " << table->size() << " points in " << t
+	          << ", maximum relative error is " << error;
+	if (error > parameters.Accuracy_SFeqs) {
+		std::ostringstream os;
+		os << "Maximum relative error of tabulated SFR integrals (" << error << ") is larger than ";
+		os << "star_formation.accuracy_sf_eqs (" << parameters.Accuracy_SFeqs << "), ";
+		os << "increase star_formation.table_points_per_dex";
+		throw invalid_option(os.str());
 	}
 
-	// If the star formation mode is starburst, then apply boosting in star formation.
-	if(props->burst){
-		sfr_density = sfr_density * parameters.boost_starburst;
+	return table;
+}
+
+bool StarFormation::tabulated_integrals(const galaxy_properties_for_integration &props, double &sfr, double &jsfr) const
+{
+	if (!integrals_table) {
+		return false;
 	}
 
-	if((props->sigma_gas0 > 0 && fracmol > 0) && sfr_density <= 0){
-		std::ostringstream os;
-		os << "Galaxy with SFR surface density =0, cold gas surface density " << props->sigma_gas0 << " and fmol > 0";
-		throw invalid_argument(os.str());
+	std::vector<double> coords {std::log10(props.sigma_gas0)};
+	if (br06_model(parameters)) {
+		// Tables don't cover disks without stars
+		if (props.sigma_star0 <= 0 || props.rse <= 0) {
+			return false;
+		}
+		coords.push_back(std::log10(props.sigma_star0 / props.re));
+		coords.push_back(std::log10(props.re / props.rse));
+	}
+	else {
+		if (props.zgas <= 0) {
+			return false;
+		}
+		coords.push_back(std::log10(props.zgas));
 	}
 
+	double i0, i1;
+	if (!integrals_table->get(coords, i0, i1)) {
+		return false;
+	}
+
+	double boost = props.burst ? parameters.boost_starburst : 1;
+	sfr = boost * i0 * props.re * props.re;
+	jsfr = boost * i1 * props.re * props.re * props.re;
+	return true;
+}
+
+double StarFormation::star_formation_rate_surface_density(double r, void * params){
+	double sfr_density;
+	star_formation_rate_surface_density(&r, 1, *reinterpret_cast<galaxy_properties_for_integration *>(params), &sfr_density);
 	return sfr_density;
 }
 
-double StarFormation::molecular_surface_density(double r, void * params){
+void StarFormation::star_formation_rate_surface_density(const double r[], std::size_t n, const galaxy_properties_for_integration &props, double sfr_density[]){
 
 	using namespace constants;
 
 	// apply molecular SF law
-	auto props = reinterpret_cast<galaxy_properties_for_integration *>(params);
+	surface_densities(r, n, props);
+	const double *Sigma_gas = sigma_gas_values.data();
+	const double *fracmol = fmol_values.data();
+	fmol(Sigma_gas, sigma_stars_values.data(), props.zgas, r, n, fmol_values.data());
 
-	double Sigma_gas = props->sigma_gas0 * std::exp(-r / props->re);
+	if(parameters.model == StarFormationParameters::BR06 || parameters.model == StarFormationParameters::GD14){
+		for (std::size_t i = 0; i != n; i++) {
+			sfr_density[i] = PI2 * parameters.nu_sf * fracmol[i] * Sigma_gas[i] * r[i]; //Add the 2PI*r to Sigma_SFR to make integration.
+		}
+	}
+	else if (parameters.model == StarFormationParameters::KMT09 || parameters.model == StarFormationParameters::K13){
+		for (std::size_t i = 0; i != n; i++) {
+			double sfr_ff = std::pow(Sigma_gas[i]/parameters.sigma_crit_KMT09, Sigma_gas[i] < parameters.sigma_crit_KMT09 ? -0.33 : 0.33);
+			sfr_density[i] = PI2 * fracmol[i] * sfr_ff * Sigma_gas[i] / 2.6 * r[i];
+		}
+	}
+	else {
+		std::fill(sfr_density, sfr_density + n, 0.);
+	}
 
-	// Avoid negative numbers.
-	if(Sigma_gas < 0){
-		Sigma_gas = 0;
+	// If the star formation mode is starburst, then apply boosting in star formation.
+	if(props.burst){
+		for (std::size_t i = 0; i != n; i++) {
+			sfr_density[i] = sfr_density[i] * parameters.boost_starburst;
+		}
 	}
 
-	// Check for low surface densities..
-	if(Sigma_gas < parameters.sigma_HI_crit){
-		return 0;
+	for (std::size_t i = 0; i != n; i++) {
+		if((props.sigma_gas0 > 0 && fracmol[i] > 0) && sfr_density[i] <= 0){
+			std::ostringstream os;
+			os << "Galaxy with SFR surface density =0, cold gas surface density " << props.sigma_gas0 << " and fmol > 0";
+			throw invalid_argument(os.str());
+		}
 	}
+}
 
-	double Sigma_stars = 0;
+double StarFormation::molecular_surface_density(double r, void * params){
+	double mol_density;
+	molecular_surface_density(&r, 1, *reinterpret_cast<galaxy_properties_for_integration *>(params), &mol_density);
+	return mol_density;
+}
 
-	// Define Sigma_stars only if stellar mass and radius are positive.
-	if(props->rse > 0 && props->sigma_star0 > 0){
-		Sigma_stars = props->sigma_star0 * std::exp(-r / props->rse);
+void StarFormation::molecular_surface_density(const double r[], std::size_t n, const galaxy_properties_for_integration &props, double mol_density[]){
+
+	using namespace constants;
+
+	surface_densities(r, n, props);
+	const double *Sigma_gas = sigma_gas_values.data();
+	const double *fracmol = fmol_values.data();
+	fmol(Sigma_gas, sigma_stars_values.data(), props.zgas, r, n, fmol_values.data());
+
+	for (std::size_t i = 0; i != n; i++) {
+		// Check for low surface densities..
+		if(Sigma_gas[i] < parameters.sigma_HI_crit){
+			mol_density[i] = 0;
+		}
+		else {
+			mol_density[i] = PI2 * fracmol[i] * Sigma_gas[i] * r[i]; //Add the 2PI*r to Sigma_SFR to make integration.
+		}
 	}
+}
+
+void StarFormation::surface_densities(const double r[], std::size_t n, const galaxy_properties_for_integration &props){
 
-	return PI2 * fmol(Sigma_gas, Sigma_stars, props->zgas, r) * Sigma_gas * r; //Add the 2PI*r to Sigma_SFR to make integration.
+	sigma_gas_values.resize(n);
+	sigma_stars_values.resize(n);
+	fmol_values.resize(n);
+
+	for (std::size_t i = 0; i != n; i++) {
+		double Sigma_gas = props.sigma_gas0 * std::exp(-r[i] / props.re);
+		// Avoid negative numbers.
+		sigma_gas_values[i] = Sigma_gas < 0 ? 0 : Sigma_gas;
+	}
+
+	// Define Sigma_stars only if stellar mass and radius are positive.
+	if(props.rse > 0 && props.sigma_star0 > 0){
+		for (std::size_t i = 0; i != n; i++) {
+			sigma_stars_values[i] = props.sigma_star0 * std::exp(-r[i] / props.rse);
+		}
+	}
+	else {
+		std::fill(sigma_stars_values.begin(), sigma_stars_values.end(), 0.);
+	}
 }
 
 double StarFormation::fmol(double Sigma_gas, double Sigma_stars, double zgas, double r){
+	double result;
+	fmol(&Sigma_gas, &Sigma_stars, zgas, &r, 1, &result);
+	return result;
+}
 
-	double rmol = 0;
+void StarFormation::fmol(const double Sigma_gas[], const double Sigma_stars[], double zgas, const double r[], std::size_t n, double fmol[]){
+
+	// rmol is calculated in place, and then turned into fmol
+	double *rmol = fmol;
 
 	if(parameters.model == StarFormationParameters::BR06){
-		rmol = std::pow((midplane_pressure(Sigma_gas,Sigma_stars,r)/parameters.Po),parameters.beta_press);
+		midplane_pressure(Sigma_gas, Sigma_stars, r, n, rmol);
+		for (std::size_t i = 0; i != n; i++) {
+			rmol[i] = std::pow((rmol[i]/parameters.Po),parameters.beta_press);
+		}
 	}
 	else if (parameters.model == StarFormationParameters::GD14){
 		//Galaxy parameters
 		double d_mw = zgas;
-		double u_mw = Sigma_gas / constants::sigma_gas_mw;
-
-		double alpha = 0.5 + 1/(1 + sqrt(u_mw * std::pow(d_mw,2.0)/600.0));
-		rmol = std::pow(Sigma_gas / gd14_sigma_norm(d_mw, u_mw), alpha);
+		for (std::size_t i = 0; i != n; i++) {
+			double u_mw = Sigma_gas[i] / constants::sigma_gas_mw;
+			double alpha = 0.5 + 1/(1 + sqrt(u_mw * std::pow(d_mw,2.0)/600.0));
+			rmol[i] = std::pow(Sigma_gas[i] / gd14_sigma_norm(d_mw, u_mw), alpha);
+		}
 	}
-	else if (parameters.model == StarFormationParameters::K13){
+	else if (parameters.model == StarFormationParameters::K13 || parameters.model == StarFormationParameters::KMT09){
 
-		double func = k13_fmol(zgas, Sigma_gas);
-		rmol =  (1.0 - func) / func;
-		if(rmol < 1e-4){
-			rmol = 1e-4;
+		if (parameters.model == StarFormationParameters::K13) {
+			k13_fmol(zgas, Sigma_gas, n, rmol);
+		}
+		else {
+			kmt09_fmol(zgas, Sigma_gas, n, rmol);
 		}
-	}
-	else if (parameters.model == StarFormationParameters::KMT09){
 
-		double func  = kmt09_fmol(zgas, Sigma_gas);
-		rmol  = (1.0 - func) / func;
-		if(rmol < 1e-4){
-			rmol = 1e-4;
+		for (std::size_t i = 0; i != n; i++) {
+			double func = rmol[i];
+			rmol[i] = (1.0 - func) / func;
+			if(rmol[i] < 1e-4){
+				rmol[i] = 1e-4;
+			}
 		}
 	}
+	else {
+		std::fill(rmol, rmol + n, 0.);
+	}
 
-	double fmol = rmol/(1+rmol);
+	for (std::size_t i = 0; i != n; i++) {
+		double f = rmol[i]/(1+rmol[i]);
 
-	// Avoid calculation errors.
-	if(fmol > 1){
-		return 1;
-	}
-	else if(fmol > 0 && fmol < 1){
-		return fmol;
-	}
-	else{
-		return 0;
+		// Avoid calculation errors.
+		if(f > 1){
+			fmol[i] = 1;
+		}
+		else if(f > 0 && f < 1){
+			fmol[i] = f;
+		}
+		else{
+			fmol[i] = 0;
+		}
 	}
 }
 
 double StarFormation::midplane_pressure(double Sigma_gas, double Sigma_stars, double r){
+	double pressure;
+	midplane_pressure(&Sigma_gas, &Sigma_stars, &r, 1, &pressure);
+	return pressure;
+}
+
+void StarFormation::midplane_pressure(const double Sigma_gas[], const double Sigma_stars[], const double r[], std::size_t n, double pressure[]){
 
 	/**
 	 * This function calculate the midplane pressure of the disk, and returns it in units of K/cm^-3.
@@ -381,18 +648,18 @@ double StarFormation::midplane_pressure(double Sigma_gas, double Sigma_stars, do
 
 	using namespace constants;
 
-	double hstar = 0.14 * r; //scaleheight of the stellar disk; from Kregel et al. (2002).
-	double veldisp_star = std::sqrt(PI * G * hstar * Sigma_stars); //stellar velocity dispersion in km/s.
+	for (std::size_t i = 0; i != n; i++) {
+		double hstar = 0.14 * r[i]; //scaleheight of the stellar disk; from Kregel et al. (2002).
+		double veldisp_star = std::sqrt(PI * G * hstar * Sigma_stars[i]); //stellar velocity dispersion in km/s.
 
-	double star_comp = 0;
+		double star_comp = 0;
 
-	if (Sigma_stars > 0 && veldisp_star > 0) {
-		star_comp = (parameters.gas_velocity_dispersion / veldisp_star) * Sigma_stars;
-	}
-
-	double pressure = Pressure_Conv * Sigma_gas * (Sigma_gas + star_comp); //in units of K/cm^3.
+		if (Sigma_stars[i] > 0 && veldisp_star > 0) {
+			star_comp = (parameters.gas_velocity_dispersion / veldisp_star) * Sigma_stars[i];
+		}
 
-	return pressure;
+		pressure[i] = Pressure_Conv * Sigma_gas[i] * (Sigma_gas[i] + star_comp); //in units of K/cm^3.
+	}
 }
 
 double StarFormation::gd14_sigma_norm(double d_mw, double u_mw){
@@ -405,44 +672,60 @@ double StarFormation::gd14_sigma_norm(double d_mw, double u_mw){
 }
 
 double StarFormation::kmt09_fmol(double zgas, double sigma_gas){
+	double func;
+	kmt09_fmol(zgas, &sigma_gas, 1, &func);
+	return func;
+}
+
+void StarFormation::kmt09_fmol(double zgas, const double sigma_gas[], std::size_t n, double func[]){
 
+	// Terms independent of the gas surface density
 	double chi   = 0.77 * (1.0 + 3.1 * std::pow(zgas,0.365));
-	double s     = std::log(1.0 + 0.6 * chi)/( 0.04 * parameters.clump_factor_KMT09 * sigma_gas/std::pow(constants::MEGA, 2.0) * zgas);
-	double delta = 0.0712 * std::pow(0.1 / s + 0.675, -2.8);
-	double func  = std::pow(1.0 + std::pow(0.75 * s / (1.0 + delta), -5.0), -0.2);
+	double log_chi = std::log(1.0 + 0.6 * chi);
 
-	return func;
+	for (std::size_t i = 0; i != n; i++) {
+		double s     = log_chi/( 0.04 * parameters.clump_factor_KMT09 * sigma_gas[i]/std::pow(constants::MEGA, 2.0) * zgas);
+		double delta = 0.0712 * std::pow(0.1 / s + 0.675, -2.8);
+		func[i]      = std::pow(1.0 + std::pow(0.75 * s / (1.0 + delta), -5.0), -0.2);
+	}
 }
 
 double StarFormation::k13_fmol(double zgas, double sigma_gas){
+	double func;
+	k13_fmol(zgas, &sigma_gas, 1, &func);
+	return func;
+}
+
+void StarFormation::k13_fmol(double zgas, const double sigma_gas[], std::size_t n, double func[]){
 
 	//Galaxy parameters
 	double d_mw = zgas;
-	double u_mw = sigma_gas / constants::sigma_gas_mw;
-	double Sigma0 = sigma_gas /std::pow(constants::MEGA, 2.0); // gas surface density in Msun/pc^2
 
-	// Calculate cold neutral medium densities in the regimes of hydrostatic and two-phase equilibrium.
-	double ncnm_2p    = 23.0 * u_mw * std::pow((1.0 + 3.1 * std::pow(d_mw, 0.365))/4.1, -1) / 10.0; //in units of 10xcm^-3
-	double ncnm_hydro = 0.0124068 * std::pow(Sigma0, 2.0) * (1.0 + std::pow(1.0 + 1250.56/std::pow(Sigma0, 2.0), 0.5)) / 10.0; //in units of 10xcm^-3
+	// Terms independent of the gas surface density
+	double ncnm_2p_norm = 23.0 * std::pow((1.0 + 3.1 * std::pow(d_mw, 0.365))/4.1, -1) / 10.0;
 
-	// Assign the maximum of the two densities.
-	double ncnm = std::max(ncnm_2p, ncnm_hydro);
+	for (std::size_t i = 0; i != n; i++) {
+		double u_mw = sigma_gas[i] / constants::sigma_gas_mw;
+		double Sigma0 = sigma_gas[i] /std::pow(constants::MEGA, 2.0); // gas surface density in Msun/pc^2
 
-	double Chi = 7.2 * u_mw/ncnm;
+		// Calculate cold neutral medium densities in the regimes of hydrostatic and two-phase equilibrium.
+		double ncnm_2p    = ncnm_2p_norm * u_mw; //in units of 10xcm^-3
+		double ncnm_hydro = 0.0124068 * std::pow(Sigma0, 2.0) * (1.0 + std::pow(1.0 + 1250.56/std::pow(Sigma0, 2.0), 0.5)) / 10.0; //in units of 10xcm^-3
 
-	double Tauc = 0.066 * parameters.clump_factor_KMT09 * d_mw * Sigma0;
-	double sfac = std::log10(1 + 0.6 * Chi + 0.01 * std::pow(Chi,2.0)) / (0.6 * Tauc);
+		// Assign the maximum of the two densities.
+		double ncnm = std::max(ncnm_2p, ncnm_hydro);
 
-	double func = 1 - 0.75 * sfac / (1 + 0.25 * sfac);
+		double Chi = 7.2 * u_mw/ncnm;
 
-	return func;
+		double Tauc = 0.066 * parameters.clump_factor_KMT09 * d_mw * Sigma0;
+		double sfac = std::log10(1 + 0.6 * Chi + 0.01 * std::pow(Chi,2.0)) / (0.6 * Tauc);
 
+		func[i] = 1 - 0.75 * sfac / (1 + 0.25 * sfac);
+	}
 }
 
-
-
 double StarFormation::molecular_hydrogen(double mcold, double mstar, double rgas, double rstar, double zgas, double z,
-		double &jmol, double jgas, double vgal, bool bulge, bool jcalc) {
+		double &jmol, double jgas, double vgal, bool bulge, bool jcalc, bool approximate) {
 
 	if (mcold <= 0 || rgas <= 0) {
 		return 0;
@@ -467,40 +750,32 @@ double StarFormation::molecular_hydrogen(double mcold, double mstar, double rgas
 		Sigma_star,
 		re,
 		rse,
-		zgas/recycleparams.zsun
-	};
-
-	struct StarFormationAndProps {
-		StarFormation *star_formation;
-		galaxy_properties_for_integration *props;
-	};
-
-	auto f = [](double r, void *ctx) -> double {
-		StarFormationAndProps *sf_and_props = reinterpret_cast<StarFormationAndProps *>(ctx);
-		return sf_and_props->star_formation->molecular_surface_density(r, sf_and_props->props);
+		zgas/recycleparams.zsun,
+		false
 	};
 
-	double rmin = 0;
-	double rmax = 5.0*re;
-
-	StarFormationAndProps sf_and_props = {this, &props};
-
-	// React to integration errors by using a way-simpler 4-point manual integration
+	// Integrals of the H2 mass and angular momentum share their evaluations
+	bool calc_jmol = !bulge && jcalc && parameters.angular_momentum_transfer;
 	double result = 0;
-	try{
-		result = integrator.integrate(f, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
-	} catch (gsl_error &e) {
-		auto gsl_errno = e.get_gsl_errno();
-		std::ostringstream os;
-		os << "jSFR integration failed with GSL error number " << gsl_errno << ": ";
-		os << gsl_strerror(gsl_errno) << ", reason=" << e.get_reason();
-		os << ". We'll attempt manual integration now";
-		LOG(warning) << os.str();
-
-		// Perform manual integration.
-		// TODO: check that error is affordable (i.e., maybe the error is really bad and the
-		// program should stop)
-		result = manual_integral(f, &sf_and_props, rmin, rmax);
+	double jmol_integral = 0;
+	double integrals[2];
+	if (approximate) {
+		// A single application of the rule, whatever its estimated error
+		integrate_fixed(&StarFormation::molecular_surface_density, props, calc_jmol ? 2 : 1, parameters.Accuracy_SFeqs, integrals);
+		result = integrals[0];
+		jmol_integral = calc_jmol ? integrals[1] : 0;
+	}
+	else if (parameters.fixed_quadrature &&
+	    integrate_fixed(&StarFormation::molecular_surface_density, props, calc_jmol ? 2 : 1, parameters.Accuracy_SFeqs, integrals)) {
+		result = integrals[0];
+		jmol_integral = calc_jmol ? integrals[1] : 0;
+	}
+	else if (calc_jmol) {
+		integrate(molecular_and_jmol_density_integrand, molecular_density_integrand, jmol_density_integrand,
+		          props, parameters.Accuracy_SFeqs, "H2 and jH2", result, jmol_integral);
+	}
+	else {
+		result = integrate(molecular_density_integrand, props, parameters.Accuracy_SFeqs, "H2");
 	}
 
 	// Avoid negative values.
@@ -515,34 +790,7 @@ double StarFormation::molecular_hydrogen(double mcold, double mstar, double rgas
 		// Check whether user wishes to calculate angular momentum transfer from gas to stars.
 		if(parameters.angular_momentum_transfer){
 
-			// TODO: it would be nice to somehow reuse some of the values from the previous integration
-			// in here. At least initially during the first round the integration algorithm will run
-			// over the same set of 'r' that it used during the first round of the previous integration,
-			// so we could save ourselves lots of calculation by storing those values and reusing them here
-			auto f_j = [](double r, void *ctx) -> double {
-				StarFormationAndProps *sf_and_props = reinterpret_cast<StarFormationAndProps *>(ctx);
-				return r * sf_and_props->star_formation->molecular_surface_density(r, sf_and_props->props);
-			};
-
-			// React to integration errors by using a way-simpler 4-point manual integration
-			jmol = 0;
-			try{
-				jmol = integrator.integrate(f_j, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
-			} catch (gsl_error &e) {
-				auto gsl_errno = e.get_gsl_errno();
-				std::ostringstream os;
-				os << "jSFR integration failed with GSL error number " << gsl_errno << ": ";
-				os << gsl_strerror(gsl_errno) << ", reason=" << e.get_reason();
-				os << ". We'll attempt manual integration now";
-				LOG(warning) << os.str();
-
-				// Perform manual integration.
-				// TODO: check that error is affordable (i.e., maybe the error is really bad and the
-				// program should stop)
-				jmol = manual_integral(f_j, &sf_and_props, rmin, rmax);
-			}
-
-			jmol = cosmology->physical_to_comoving_mass(jmol) * vgal; //assumes a flat rotation curve.
+			jmol = cosmology->physical_to_comoving_mass(jmol_integral) * vgal; //assumes a flat rotation curve.
 
 			// Avoid negative values.
 			if(jmol < 0){
@@ -595,8 +843,10 @@ double StarFormation::ionised_gas_fraction(double mgas, double rgas, double z){
 
 }
 
-StarFormation::molecular_gas StarFormation::get_molecular_gas(const GalaxyPtr &galaxy, double z, bool jcalc)
+StarFormation::molecular_gas StarFormation::get_molecular_gas(const GalaxyPtr &galaxy, double z, bool jcalc, bool approximate)
 {
+	SHARK_PROFILE(MOLECULAR_GAS);
+
 	double m_mol    = 0;
 	double m_atom   = 0;
 	double m_mol_b  = 0;
@@ -618,7 +868,7 @@ StarFormation::molecular_gas StarFormation::get_molecular_gas(const GalaxyPtr &g
 		zgas = galaxy->disk_gas.mass_metals / galaxy->disk_gas.mass;
 		m_neutral = (1-f_ion) * galaxy->disk_gas.mass;
 
-		m_mol = (1-f_ion) * molecular_hydrogen(galaxy->disk_gas.mass,galaxy->disk_stars.mass,galaxy->disk_gas.rscale, galaxy->disk_stars.rscale, zgas, z, j_mol, jgas, vgal, false, jcalc);
+		m_mol = (1-f_ion) * molecular_hydrogen(galaxy->disk_gas.mass,galaxy->disk_stars.mass,galaxy->disk_gas.rscale, galaxy->disk_stars.rscale, zgas, z, j_mol, jgas, vgal, false, jcalc, approximate);
 		m_atom = m_neutral - m_mol;
 
 		if(jcalc){
@@ -628,7 +878,7 @@ StarFormation::molecular_gas StarFormation::get_molecular_gas(const GalaxyPtr &g
 	}
 	if (galaxy->bulge_gas.mass > 0) {
 		zgas = galaxy->bulge_gas.mass_metals / galaxy->bulge_gas.mass;
-		m_mol_b = molecular_hydrogen(galaxy->bulge_gas.mass,galaxy->bulge_stars.mass,galaxy->bulge_gas.rscale, galaxy->bulge_stars.rscale, zgas, z, j_mol, jgas, vgal, true, jcalc);
+		m_mol_b = molecular_hydrogen(galaxy->bulge_gas.mass,galaxy->bulge_stars.mass,galaxy->bulge_gas.rscale, galaxy->bulge_stars.rscale, zgas, z, j_mol, jgas, vgal, true, jcalc, approximate);
 		m_atom_b = galaxy->bulge_gas.mass - m_mol_b;
 	}
 
@@ -655,7 +905,7 @@ double StarFormation::manual_integral(func_t f, void * params, double rmin, doub
 		rf = std::pow(10.0,rf) - 1.0;
 		double rx =(rf + ri) * 0.5 ;
 
-		integral += f(rx, &params) * (rf - ri);
+		integral += f(rx, params) * (rf - ri);
 	}
 
 	// Avoid negative numbers.
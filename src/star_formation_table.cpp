@@ -0,0 +1,161 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * StarFormationTable implementation
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "exceptions.h"
+#include "star_formation_table.h"
+
+namespace shark {
+
+static
+double safe_log10(double x)
+{
+	if (x <= 0) {
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+	return std::log10(x);
+}
+
+StarFormationTable::StarFormationTable(std::vector<axis> axes, const integrals_t &integrals) :
+	axes(std::move(axes)),
+	strides(this->axes.size()),
+	log_i0(),
+	log_i1()
+{
+	if (this->axes.empty() || this->axes.size() > 3) {
+		throw invalid_argument("StarFormationTable supports between one and three axes");
+	}
+
+	std::size_t size = 1;
+	for (std::size_t d = this->axes.size(); d-- != 0;) {
+		const auto &ax = this->axes[d];
+		if (ax.n < 2 || !(ax.max > ax.min)) {
+			throw invalid_argument("StarFormationTable axes need at least two points and max > min");
+		}
+		strides[d] = size;
+		size *= ax.n;
+	}
+
+	log_i0.resize(size);
+	log_i1.resize(size);
+	std::vector<double> coords(this->axes.size());
+	for (std::size_t idx = 0; idx != size; idx++) {
+		for (std::size_t d = 0; d != this->axes.size(); d++) {
+			coords[d] = this->axes[d].at((idx / strides[d]) % this->axes[d].n);
+		}
+		double i0, i1;
+		integrals(coords, i0, i1);
+		log_i0[idx] = safe_log10(i0);
+		log_i1[idx] = safe_log10(i1);
+	}
+}
+
+bool StarFormationTable::get(const std::vector<double> &coords, double &i0, double &i1) const
+{
+	auto dims = axes.size();
+
+	// Lower grid point and distance to it (in cell units) along each axis
+	std::size_t base = 0;
+	double fracs[3];
+	std::size_t lower[3];
+	for (std::size_t d = 0; d != dims; d++) {
+		const auto &ax = axes[d];
+		if (!(coords[d] >= ax.min && coords[d] <= ax.max)) {
+			return false;
+		}
+		double x = (coords[d] - ax.min) / (ax.max - ax.min) * (ax.n - 1);
+		lower[d] = std::min(static_cast<std::size_t>(x), std::size_t(ax.n - 2));
+		fracs[d] = x - lower[d];
+		base += lower[d] * strides[d];
+	}
+
+	// Multilinear interpolation over the corners of the cell
+	double v0 = 0, v1 = 0;
+	for (std::size_t corner = 0; corner != (std::size_t(1) << dims); corner++) {
+		double weight = 1;
+		std::size_t idx = base;
+		for (std::size_t d = 0; d != dims; d++) {
+			if (corner & (std::size_t(1) << d)) {
+				weight *= fracs[d];
+				idx += strides[d];
+			}
+			else {
+				weight *= 1 - fracs[d];
+			}
+		}
+		v0 += weight * log_i0[idx];
+		v1 += weight * log_i1[idx];
+	}
+
+	if (std::isnan(v0) || std::isnan(v1)) {
+		return false;
+	}
+
+	i0 = std::pow(10., v0);
+	i1 = std::pow(10., v1);
+	return true;
+}
+
+double StarFormationTable::max_relative_error(const integrals_t &integrals, std::size_t max_samples) const
+{
+	auto dims = axes.size();
+	std::size_t n_cells = 1;
+	for (auto &ax: axes) {
+		n_cells *= ax.n - 1;
+	}
+	auto stride = std::max(std::size_t(1), n_cells / std::max(std::size_t(1), max_samples));
+
+	double max_error = 0;
+	std::vector<double> coords(dims);
+	for (std::size_t cell = 0; cell < n_cells; cell += stride) {
+		auto rest = cell;
+		for (std::size_t d = dims; d-- != 0;) {
+			const auto &ax = axes[d];
+			auto i = rest % (ax.n - 1);
+			rest /= ax.n - 1;
+			coords[d] = (ax.at(i) + ax.at(i + 1)) / 2;
+		}
+
+		double i0, i1, expected_i0, expected_i1;
+		if (!get(coords, i0, i1)) {
+			continue;
+		}
+		integrals(coords, expected_i0, expected_i1);
+		if (expected_i0 > 0) {
+			max_error = std::max(max_error, std::abs(i0 - expected_i0) / expected_i0);
+		}
+		if (expected_i1 > 0) {
+			max_error = std::max(max_error, std::abs(i1 - expected_i1) / expected_i1);
+		}
+	}
+
+	return max_error;
+}
+
+}  // namespace shark
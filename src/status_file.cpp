@@ -0,0 +1,236 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * StatusFile implementation
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+#include <sstream>
+
+#include "exceptions.h"
+#include "logging.h"
+#include "status_file.h"
+
+namespace shark {
+
+constexpr std::size_t StatusFile::trend_snapshots;
+
+static
+std::string json_string(const std::string &value)
+{
+	std::ostringstream os;
+	os << '"';
+	for (char c: value) {
+		if (c == '"' || c == '\\') {
+			os << '\\' << c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20) {
+			os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+		}
+		else {
+			os << c;
+		}
+	}
+	os << '"';
+	return os.str();
+}
+
+StatusFile::StatusFile(const std::string &filename, const std::string &model, std::size_t batch_groups) :
+	filename(filename), model(model), batch_groups(batch_groups)
+{
+	// Fail early rather than after hours of evolution
+	write_file();
+}
+
+void StatusFile::start_batch_group(std::size_t group)
+{
+	if (group != batch_group) {
+		completed_groups.push_back(group_t.get());
+	}
+	batch_group = group;
+	group_snapshots = 0;
+	group_durations.clear();
+	group_t = Timer();
+	update();
+}
+
+void StatusFile::set_group_snapshots(int snapshots)
+{
+	group_snapshots = snapshots;
+	update();
+}
+
+void StatusFile::phase(const std::string &phase, int snapshot)
+{
+	current_phase = phase;
+	this->snapshot = snapshot;
+	update();
+}
+
+void StatusFile::snapshot_evolved(int snapshot, std::size_t n_galaxies, Timer::duration duration_millis,
+                                  unsigned long ode_evaluations, std::size_t rss, std::size_t peak_rss)
+{
+	this->snapshot = snapshot;
+	galaxies_per_second = duration_millis > 0 ? n_galaxies * 1000. / duration_millis : 0;
+	this->ode_evaluations = ode_evaluations;
+	this->rss = rss;
+	this->peak_rss = peak_rss;
+	group_durations.push_back(double(duration_millis));
+	update();
+}
+
+void StatusFile::finish()
+{
+	current_phase = "finished";
+	snapshot = -1;
+	finished = true;
+	update();
+}
+
+double StatusFile::group_remaining_millis() const
+{
+	// Before the first snapshot only earlier groups tell how long this one takes
+	auto n = group_durations.size();
+	if (n == 0) {
+		if (completed_groups.empty()) {
+			return -1;
+		}
+		auto mean = std::accumulate(completed_groups.begin(), completed_groups.end(), 0.) / completed_groups.size();
+		return std::max(mean - group_t.get(), 0.);
+	}
+
+	// Least-squares line through the durations of the last snapshots,
+	// extrapolated to the snapshots still to be evolved
+	auto window = std::min(n, trend_snapshots);
+	double sum_k = 0, sum_d = 0, sum_kk = 0, sum_kd = 0;
+	for (auto k = n - window; k != n; k++) {
+		auto d = group_durations[k];
+		sum_k += k;
+		sum_d += d;
+		sum_kk += double(k) * k;
+		sum_kd += k * d;
+	}
+	double slope = 0;
+	auto denominator = window * sum_kk - sum_k * sum_k;
+	if (window > 1 && denominator > 0) {
+		slope = (window * sum_kd - sum_k * sum_d) / denominator;
+	}
+	auto intercept = (sum_d - slope * sum_k) / window;
+
+	double remaining = 0;
+	for (auto k = n; k < std::size_t(std::max(group_snapshots, 0)); k++) {
+		remaining += std::max(intercept + slope * k, 0.);
+	}
+	return remaining;
+}
+
+double StatusFile::eta_seconds() const
+{
+	if (finished) {
+		return 0;
+	}
+	auto group_remaining = group_remaining_millis();
+	if (group_remaining < 0) {
+		return -1;
+	}
+
+	// Later groups take as long as the earlier ones did, or as the current
+	// one is estimated to take if there are none
+	auto later_groups = batch_groups - std::min(batch_groups, batch_group + 1);
+	double group_millis;
+	if (!completed_groups.empty()) {
+		group_millis = std::accumulate(completed_groups.begin(), completed_groups.end(), 0.) / completed_groups.size();
+	}
+	else {
+		group_millis = group_t.get() + group_remaining;
+	}
+	return (group_remaining + later_groups * group_millis) / 1000.;
+}
+
+void StatusFile::write(std::ostream &os, std::time_t now) const
+{
+	auto eta = eta_seconds();
+	os << "{\n";
+	os << "  \"model\": " << json_string(model) << ",\n";
+	os << "  \"phase\": " << json_string(current_phase) << ",\n";
+	os << "  \"snapshot\": ";
+	if (snapshot >= 0) {
+		os << snapshot;
+	}
+	else {
+		os << "null";
+	}
+	os << ",\n";
+	os << "  \"batch_group\": " << batch_group << ",\n";
+	os << "  \"batch_groups\": " << batch_groups << ",\n";
+	os << "  \"snapshots_evolved\": " << group_durations.size() << ",\n";
+	os << "  \"snapshots_total\": " << group_snapshots << ",\n";
+	os << "  \"galaxies_per_second\": " << fixed<3>(galaxies_per_second) << ",\n";
+	os << "  \"ode_evaluations\": " << ode_evaluations << ",\n";
+	os << "  \"rss\": " << rss << ",\n";
+	os << "  \"peak_rss\": " << peak_rss << ",\n";
+	os << "  \"elapsed_seconds\": " << fixed<3>(start_t.get() / 1000.) << ",\n";
+	os << "  \"eta_seconds\": ";
+	if (eta >= 0) {
+		os << fixed<3>(eta);
+	}
+	else {
+		os << "null";
+	}
+	os << ",\n";
+	os << "  \"updated\": " << static_cast<long long>(now) << "\n";
+	os << "}\n";
+}
+
+void StatusFile::update()
+{
+	try {
+		write_file();
+	} catch (const exception &e) {
+		LOG(warning) << "Status file could not be updated: " << e.what();
+	}
+}
+
+void StatusFile::write_file() const
+{
+	// Readers polling the file always find a complete status
+	auto tmp_filename = filename + ".tmp";
+	std::ofstream f(tmp_filename, std::ios::trunc);
+	if (!f) {
+		throw exception("cannot open " + tmp_filename + " for writing");
+	}
+	write(f, std::time(nullptr));
+	f.close();
+	if (!f) {
+		throw exception("error while writing " + tmp_filename);
+	}
+	if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		throw exception("cannot rename " + tmp_filename + " to " + filename);
+	}
+}
+
+}  // namespace shark
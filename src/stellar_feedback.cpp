@@ -91,19 +91,15 @@ StellarFeedback::StellarFeedback(StellarFeedbackParameters parameters) :
 	// no-op
 }
 
-void StellarFeedback::outflow_rate(double sfr, double vsubh, double vgal, double z, double &b1, double &b2, double &bj_1, double &bj_2) {
-
+StellarFeedback::outflow_factors StellarFeedback::get_outflow_factors(double vsubh, double vgal, double z) const {
 
 	double v = vsubh;
 	if(parameters.galaxy_scaling && vgal > 0){
 		v  = vgal;
 	}
 
-	b1 = 0;
-	b2 = 0;
-
-	if(sfr <= 0 || v <= 0){
-		return;
+	if(v <= 0){
+		return {};
 	}
 
 	double vsn = 1.9 * std::pow(v,1.1);
@@ -146,15 +142,31 @@ void StellarFeedback::outflow_rate(double sfr, double vsubh, double vgal, double
 		const_sn = std::pow((1+z),parameters.redshift_power) * std::pow(parameters.v_sn/v,power_index);
 	}
 
-	b1 = parameters.eps_disk * const_sn;
-
 	double eps_halo = parameters.eps_halo * const_sn *  0.5 * std::pow(vsn,2.0);
 
 	double energ_halo = 0.5 * std::pow(v,2.0);
 
+	outflow_factors factors;
+	factors.reheating = parameters.eps_disk * const_sn;
+	factors.ejection = eps_halo / energ_halo;
+	return factors;
+}
+
+void StellarFeedback::outflow_rate(double sfr, const outflow_factors &factors, double &b1, double &b2, double &bj_1, double &bj_2) const {
+
+	b1 = 0;
+	b2 = 0;
+
+	// Galaxies without a velocity have null factors, and therefore no outflows
+	if(sfr <= 0 || (factors.reheating == 0 && factors.ejection == 0)){
+		return;
+	}
+
+	b1 = factors.reheating;
+
 	double mreheat = b1 * sfr;
 
-	double mejected = eps_halo / energ_halo * sfr - mreheat;
+	double mejected = factors.ejection * sfr - mreheat;
 
 	if(mejected > 0) {
 		b2 = mejected/sfr;
@@ -164,7 +176,7 @@ void StellarFeedback::outflow_rate(double sfr, double vsubh, double vgal, double
 		}
 	}
 	else{
-		b1 = eps_halo / energ_halo;
+		b1 = factors.ejection;
 	}
 
 	// If no radial feedback is applied, then change in angular momentum reflects that of the mass.
@@ -178,4 +190,8 @@ void StellarFeedback::outflow_rate(double sfr, double vsubh, double vgal, double
 
 }
 
+void StellarFeedback::outflow_rate(double sfr, double vsubh, double vgal, double z, double &b1, double &b2, double &bj_1, double &bj_2) {
+	outflow_rate(sfr, get_outflow_factors(vsubh, vgal, z), b1, b2, bj_1, bj_2);
+}
+
 }  // namespace shark
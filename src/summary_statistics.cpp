@@ -0,0 +1,241 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Implementation of SummaryStatistics class methods
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "exceptions.h"
+#include "omp_utils.h"
+#include "summary_statistics.h"
+
+namespace shark {
+
+SummaryStatistics::SummaryStatistics(double log_mass_min, double log_mass_max, double bin_width) :
+	log_mass_min(log_mass_min),
+	bin_width(bin_width),
+	n_bins(bin_width > 0 && log_mass_max > log_mass_min ? std::size_t(std::ceil((log_mass_max - log_mass_min) / bin_width)) : 0),
+	stellar_mass_counts(n_bins),
+	atomic_mass_counts(n_bins),
+	molecular_mass_counts(n_bins),
+	size_counts(n_bins),
+	log_rstar_sum(n_bins),
+	log_rstar_sum2(n_bins)
+{
+	if (n_bins == 0) {
+		throw invalid_argument("summary statistics need a positive bin width and a non-empty mass range");
+	}
+}
+
+SummaryStatistics SummaryStatistics::collect(const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal,
+	double log_mass_min, double log_mass_max, double bin_width, unsigned int threads)
+{
+	return omp_parallel_reduce(halos, threads, SummaryStatistics(log_mass_min, log_mass_max, bin_width),
+		[&](SummaryStatistics &stats, const HaloPtr &halo, int thread_idx) {
+			double weight = halo->merger_tree ? halo->merger_tree->weight : 1;
+			for (auto &subhalo: halo->subhalos()) {
+				for (auto &galaxy: subhalo->galaxies) {
+					stats.add(*galaxy, molgas_per_gal.at(galaxy), weight);
+				}
+			}
+		},
+		[](SummaryStatistics &stats, const SummaryStatistics &partial) {
+			stats.merge(partial);
+		});
+}
+
+int SummaryStatistics::bin(double mass) const
+{
+	if (mass <= 0) {
+		return -1;
+	}
+	auto idx = std::floor((std::log10(mass) - log_mass_min) / bin_width);
+	if (idx < 0 || idx >= n_bins) {
+		return -1;
+	}
+	return int(idx);
+}
+
+void SummaryStatistics::add(const Galaxy &galaxy, const StarFormation::molecular_gas &molgas, double weight)
+{
+	n_galaxies++;
+	total_sfr += (galaxy.sfr_disk + galaxy.sfr_bulge_mergers + galaxy.sfr_bulge_diskins) * weight;
+
+	double mstars = galaxy.disk_stars.mass + galaxy.bulge_stars.mass;
+	int idx = bin(mstars);
+	if (idx >= 0) {
+		stellar_mass_counts[idx] += weight;
+
+		// mass-weighted half-mass radius of the disk and bulge
+		double rstar = (galaxy.disk_stars.mass * galaxy.disk_stars.rscale + galaxy.bulge_stars.mass * galaxy.bulge_stars.rscale) / mstars;
+		if (rstar > 0) {
+			double log_rstar = std::log10(rstar);
+			size_counts[idx] += weight;
+			log_rstar_sum[idx] += log_rstar * weight;
+			log_rstar_sum2[idx] += log_rstar * log_rstar * weight;
+		}
+	}
+
+	idx = bin(molgas.m_atom + molgas.m_atom_b);
+	if (idx >= 0) {
+		atomic_mass_counts[idx] += weight;
+	}
+	idx = bin(molgas.m_mol + molgas.m_mol_b);
+	if (idx >= 0) {
+		molecular_mass_counts[idx] += weight;
+	}
+}
+
+void SummaryStatistics::merge(const SummaryStatistics &other)
+{
+	if (other.n_bins != n_bins || other.log_mass_min != log_mass_min || other.bin_width != bin_width) {
+		throw invalid_argument("cannot merge summary statistics with different bins");
+	}
+	for (std::size_t i = 0; i != n_bins; i++) {
+		stellar_mass_counts[i] += other.stellar_mass_counts[i];
+		atomic_mass_counts[i] += other.atomic_mass_counts[i];
+		molecular_mass_counts[i] += other.molecular_mass_counts[i];
+		size_counts[i] += other.size_counts[i];
+		log_rstar_sum[i] += other.log_rstar_sum[i];
+		log_rstar_sum2[i] += other.log_rstar_sum2[i];
+	}
+	total_sfr += other.total_sfr;
+	n_galaxies += other.n_galaxies;
+}
+
+std::vector<double> SummaryStatistics::bin_centres() const
+{
+	std::vector<double> centres(n_bins);
+	for (std::size_t i = 0; i != n_bins; i++) {
+		centres[i] = log_mass_min + (i + 0.5) * bin_width;
+	}
+	return centres;
+}
+
+static
+std::vector<double> _mass_function(const std::vector<double> &counts, double volume, double bin_width)
+{
+	std::vector<double> phi(counts.size());
+	std::transform(counts.begin(), counts.end(), phi.begin(), [&](double count) {
+		return count / volume / bin_width;
+	});
+	return phi;
+}
+
+void SummaryStatistics::size_moments(std::vector<double> &mean, std::vector<double> &stddev) const
+{
+	mean.assign(n_bins, 0);
+	stddev.assign(n_bins, 0);
+	for (std::size_t i = 0; i != n_bins; i++) {
+		if (size_counts[i] > 0) {
+			mean[i] = log_rstar_sum[i] / size_counts[i];
+			stddev[i] = std::sqrt(std::max(0., log_rstar_sum2[i] / size_counts[i] - mean[i] * mean[i]));
+		}
+	}
+}
+
+std::vector<double> SummaryStatistics::get(const std::string &name, double volume) const
+{
+	const std::vector<std::pair<std::string, const std::vector<double> *>> mass_functions {
+		{"stellar_mass_function", &stellar_mass_counts},
+		{"atomic_mass_function", &atomic_mass_counts},
+		{"molecular_mass_function", &molecular_mass_counts}
+	};
+	for (auto &mass_function: mass_functions) {
+		if (name == mass_function.first + "/counts") {
+			return *mass_function.second;
+		}
+		else if (name == mass_function.first + "/phi") {
+			return _mass_function(*mass_function.second, volume, bin_width);
+		}
+	}
+
+	if (name == "bins/log_mass") {
+		return bin_centres();
+	}
+	else if (name == "bins/width") {
+		return {bin_width};
+	}
+	else if (name == "run_info/n_galaxies") {
+		return {double(n_galaxies)};
+	}
+	else if (name == "size_mass/counts") {
+		return size_counts;
+	}
+	else if (name == "size_mass/mean_log_rstar" || name == "size_mass/std_log_rstar") {
+		std::vector<double> mean, stddev;
+		size_moments(mean, stddev);
+		return name == "size_mass/mean_log_rstar" ? mean : stddev;
+	}
+	else if (name == "sfr_density") {
+		return {total_sfr / volume};
+	}
+	throw invalid_argument("unknown summary statistic: " + name);
+}
+
+void SummaryStatistics::write(hdf5::Writer &file, double redshift, double volume) const
+{
+	std::string comment;
+
+	comment = "output redshift";
+	file.write_dataset("run_info/redshift", redshift, comment);
+	comment = "effective volume of this run [(cMpc/h)^3]";
+	file.write_dataset("run_info/effective_volume", volume, comment);
+	comment = "number of galaxies";
+	file.write_dataset("run_info/n_galaxies", n_galaxies, comment);
+
+	comment = "centres of the mass bins of all distributions [log10(M/(Msun/h))]";
+	file.write_dataset("bins/log_mass", bin_centres(), comment);
+	comment = "width of the mass bins [dex]";
+	file.write_dataset("bins/width", bin_width, comment);
+
+	comment = "number of galaxies per bin of stellar mass, weighted by their galaxies/weight";
+	file.write_dataset("stellar_mass_function/counts", stellar_mass_counts, comment);
+	comment = "stellar mass function [(cMpc/h)^-3 dex^-1]";
+	file.write_dataset("stellar_mass_function/phi", _mass_function(stellar_mass_counts, volume, bin_width), comment);
+
+	comment = "number of galaxies per bin of atomic gas mass (helium plus hydrogen), weighted by their galaxies/weight";
+	file.write_dataset("atomic_mass_function/counts", atomic_mass_counts, comment);
+	comment = "atomic gas mass function [(cMpc/h)^-3 dex^-1]";
+	file.write_dataset("atomic_mass_function/phi", _mass_function(atomic_mass_counts, volume, bin_width), comment);
+
+	comment = "number of galaxies per bin of molecular gas mass (helium plus hydrogen), weighted by their galaxies/weight";
+	file.write_dataset("molecular_mass_function/counts", molecular_mass_counts, comment);
+	comment = "molecular gas mass function [(cMpc/h)^-3 dex^-1]";
+	file.write_dataset("molecular_mass_function/phi", _mass_function(molecular_mass_counts, volume, bin_width), comment);
+
+	std::vector<double> mean, stddev;
+	size_moments(mean, stddev);
+	comment = "number of galaxies with a non-zero stellar size per bin of stellar mass, weighted by their galaxies/weight";
+	file.write_dataset("size_mass/counts", size_counts, comment);
+	comment = "mean of the stellar half-mass radius per bin of stellar mass [log10(r/(cMpc/h))]";
+	file.write_dataset("size_mass/mean_log_rstar", mean, comment);
+	comment = "standard deviation of the stellar half-mass radius per bin of stellar mass [dex]";
+	file.write_dataset("size_mass/std_log_rstar", stddev, comment);
+
+	comment = "star formation rate density [Msun/Gyr/h (cMpc/h)^-3]";
+	file.write_dataset("sfr_density", total_sfr / volume, comment);
+}
+
+}  // namespace shark
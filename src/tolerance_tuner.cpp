@@ -0,0 +1,189 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Implementation of the ToleranceTuner class
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <ostream>
+#include <sstream>
+
+#include "exceptions.h"
+#include "logging.h"
+#include "shark_session.h"
+#include "tolerance_tuner.h"
+
+namespace shark {
+
+const std::vector<std::string> ToleranceTuner::properties {
+	"stellar_mass_function", "atomic_mass_function", "molecular_mass_function", "sfr_density"
+};
+
+double ToleranceTrial::max_deviation() const
+{
+	double max = 0;
+	for (auto &deviation: deviations) {
+		max = std::max(max, deviation.second);
+	}
+	return max;
+}
+
+ToleranceTuner::ToleranceTuner(const Options &options, unsigned int threads,
+    std::vector<double> ode_solver_precisions, std::vector<double> accuracies_sf_eqs) :
+	options(options),
+	threads(threads),
+	ode_solver_precisions(std::move(ode_solver_precisions)),
+	accuracies_sf_eqs(std::move(accuracies_sf_eqs))
+{
+	for (auto *values: {&this->ode_solver_precisions, &this->accuracies_sf_eqs}) {
+		if (values->empty()) {
+			throw invalid_argument("at least one value of each tolerance must be tried");
+		}
+		if (std::any_of(values->begin(), values->end(), [](double value) { return !(value > 0); })) {
+			throw invalid_argument("tolerances must be positive");
+		}
+		std::sort(values->begin(), values->end());
+		values->erase(std::unique(values->begin(), values->end()), values->end());
+	}
+}
+
+static
+std::string optspec(const std::string &name, double value)
+{
+	std::ostringstream os;
+	os.precision(std::numeric_limits<double>::max_digits10);
+	os << name << "=" << value;
+	return os.str();
+}
+
+std::vector<ToleranceTrial> ToleranceTuner::run()
+{
+	SharkSession session(options, threads);
+
+	// The tightest tolerances go first, as they are the reference
+	std::vector<ToleranceTrial> trials;
+	std::map<int, SummaryStatistics> reference;
+	for (auto ode_solver_precision: ode_solver_precisions) {
+		for (auto accuracy_sf_eqs: accuracies_sf_eqs) {
+			LOG(info) << "Evolving with execution.ode_solver_precision=" << ode_solver_precision
+			          << " and star_formation.accuracy_sf_eqs=" << accuracy_sf_eqs;
+			session.reset();
+			session.set(optspec("execution.ode_solver_precision", ode_solver_precision));
+			session.set(optspec("star_formation.accuracy_sf_eqs", accuracy_sf_eqs));
+
+			Timer t;
+			session.run();
+			ToleranceTrial trial {{ode_solver_precision, accuracy_sf_eqs}, session.ode_evaluations(), t.get(), {}};
+
+			if (trials.empty()) {
+				for (auto snapshot: session.snapshots()) {
+					reference.emplace(snapshot, session.summary(snapshot));
+				}
+			}
+			for (auto &property: properties) {
+				double max_deviation = 0;
+				for (auto &snapshot_and_stats: reference) {
+					auto &stats = session.summary(snapshot_and_stats.first);
+					max_deviation = std::max(max_deviation, deviation(stats, snapshot_and_stats.second, property));
+				}
+				trial.deviations[property] = max_deviation;
+			}
+			trials.emplace_back(std::move(trial));
+		}
+	}
+	return trials;
+}
+
+static
+double relative_difference(double value, double reference)
+{
+	if (value == reference) {
+		return 0;
+	}
+	if (reference == 0) {
+		return std::numeric_limits<double>::infinity();
+	}
+	return std::abs(value - reference) / std::abs(reference);
+}
+
+double ToleranceTuner::deviation(const SummaryStatistics &stats, const SummaryStatistics &reference, const std::string &property)
+{
+	if (property == "sfr_density") {
+		return relative_difference(stats.total_sfr, reference.total_sfr);
+	}
+
+	// Volumes cancel out, so counts are compared directly
+	auto values = stats.get(property + "/counts", 1);
+	auto reference_values = reference.get(property + "/counts", 1);
+	if (values.size() != reference_values.size()) {
+		throw invalid_argument("summary statistics of " + property + " have different bins");
+	}
+	double difference = 0;
+	for (std::size_t i = 0; i != values.size(); i++) {
+		difference += std::abs(values[i] - reference_values[i]);
+	}
+	auto total = std::accumulate(reference_values.begin(), reference_values.end(), 0.);
+	if (total == 0) {
+		return difference == 0 ? 0 : std::numeric_limits<double>::infinity();
+	}
+	return difference / total;
+}
+
+std::size_t ToleranceTuner::recommend(const std::vector<ToleranceTrial> &trials, double max_deviation)
+{
+	if (trials.empty()) {
+		throw invalid_argument("no tolerance trials to recommend from");
+	}
+
+	// The reference always qualifies
+	std::size_t recommended = 0;
+	for (std::size_t i = 1; i != trials.size(); i++) {
+		if (trials[i].max_deviation() <= max_deviation && trials[i].millis < trials[recommended].millis) {
+			recommended = i;
+		}
+	}
+	return recommended;
+}
+
+void ToleranceTuner::write_csv(std::ostream &os, const std::vector<ToleranceTrial> &trials, std::size_t recommended)
+{
+	os << "ode_solver_precision,accuracy_sf_eqs,ode_evaluations,millis";
+	for (auto &property: properties) {
+		os << "," << property << "_deviation";
+	}
+	os << ",max_deviation,recommended\n";
+	for (std::size_t i = 0; i != trials.size(); i++) {
+		auto &trial = trials[i];
+		os << trial.settings.ode_solver_precision << "," << trial.settings.accuracy_sf_eqs << ","
+		   << trial.ode_evaluations << "," << trial.millis;
+		for (auto &property: properties) {
+			os << "," << trial.deviations.at(property);
+		}
+		os << "," << trial.max_deviation() << "," << (i == recommended ? 1 : 0) << "\n";
+	}
+}
+
+}  // namespace shark
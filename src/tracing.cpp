@@ -0,0 +1,140 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Recording of timelines in the Chrome trace-event format
+ */
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#include "exceptions.h"
+#include "tracing.h"
+#include "utils.h"
+
+namespace shark {
+
+namespace tracing {
+
+namespace {
+
+/**
+ * The events of all threads that have recorded something. Threads register
+ * their buffers once, the only time a lock is needed while recording.
+ */
+struct events_registry {
+
+	std::mutex mutex;
+	std::vector<std::unique_ptr<thread_events>> buffers;
+	std::atomic<bool> enabled {false};
+
+	// Timestamps in traces are relative to the start of the recording
+	std::int64_t origin = now();
+
+	thread_events *add()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		buffers.emplace_back(new thread_events {static_cast<unsigned int>(buffers.size()), {}});
+		return buffers.back().get();
+	}
+};
+
+events_registry &registry()
+{
+	static events_registry the_registry;
+	return the_registry;
+}
+
+}  // anonymous namespace
+
+void start()
+{
+	auto &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	for (auto &buffer: reg.buffers) {
+		buffer->events.clear();
+	}
+	reg.origin = now();
+	reg.enabled.store(true);
+}
+
+void stop()
+{
+	registry().enabled.store(false);
+}
+
+bool enabled()
+{
+	return registry().enabled.load(std::memory_order_relaxed);
+}
+
+thread_events &local_events()
+{
+	thread_local thread_events *events = registry().add();
+	return *events;
+}
+
+void write_chrome_trace(std::ostream &os, int pid)
+{
+	auto &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+
+	// Complete ("X") events carry both their begin and duration, and are
+	// preceded by the names Perfetto shows for the process and its threads
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":\"shark\"}}";
+	for (auto &buffer: reg.buffers) {
+		os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+		   << ",\"args\":{\"name\":\"thread " << buffer->tid << "\"}}";
+	}
+	for (auto &buffer: reg.buffers) {
+		for (auto &e: buffer->events) {
+			os << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\""
+			   << ",\"ts\":" << fixed<3>((e.begin - reg.origin) / 1000.)
+			   << ",\"dur\":" << fixed<3>((e.end - e.begin) / 1000.)
+			   << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid;
+			if (e.arg_name) {
+				os << ",\"args\":{\"" << e.arg_name << "\":" << e.arg << "}";
+			}
+			os << "}";
+		}
+	}
+	os << "\n]}\n";
+}
+
+void write_chrome_trace(const std::string &filename, int pid)
+{
+	std::ofstream f(filename);
+	if (!f) {
+		throw exception("cannot open " + filename + " for writing");
+	}
+	write_chrome_trace(f, pid);
+	if (!f) {
+		throw exception("error while writing " + filename);
+	}
+}
+
+}  // namespace tracing
+
+}  // namespace shark
@@ -22,16 +22,25 @@
  */
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <exception>
 #include <iomanip>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <numeric>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 #include "cosmology.h"
 #include "exceptions.h"
 #include "logging.h"
 #include "omp_utils.h"
+#include "philox_engine.h"
+#include "radix_sort.h"
+#include "span.h"
 #include "timer.h"
 #include "tree_builder.h"
 
@@ -54,6 +63,11 @@ ExecutionParameters &TreeBuilder::get_exec_params()
 	return exec_params;
 }
 
+unsigned int TreeBuilder::get_threads() const
+{
+	return threads;
+}
+
 void TreeBuilder::ensure_trees_are_self_contained(const std::vector<MergerTreePtr> &trees) const
 {
 	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
@@ -69,6 +83,173 @@ void TreeBuilder::ensure_trees_are_self_contained(const std::vector<MergerTreePt
 	});
 }
 
+namespace {
+
+template <typename T>
+void remove_ascendant(small_vector<T, 2> &ascendants, const T &ascendant)
+{
+	auto it = std::find(ascendants.begin(), ascendants.end(), ascendant);
+	if (it != ascendants.end()) {
+		ascendants.erase(it);
+	}
+}
+
+// Removes @p halo from its merger tree, breaking all links between it, its
+// subhalos and their descendants so their memory is released. All
+// ascendants of @p halo must be removed as well
+void unlink_pruned_halo(const HaloPtr &halo)
+{
+	if (halo->descendant) {
+		remove_ascendant(halo->descendant->ascendants, halo);
+	}
+	for (auto &subhalo: halo->all_subhalos()) {
+		auto d_subhalo = subhalo->descendant;
+		if (d_subhalo) {
+			remove_ascendant(d_subhalo->ascendants, subhalo);
+
+			// The most massive of the remaining ascendants takes over
+			auto &ascendants = d_subhalo->ascendants;
+			if (subhalo->main_progenitor && !ascendants.empty()) {
+				auto it = std::max_element(ascendants.begin(), ascendants.end(), [](const SubhaloPtr &s1, const SubhaloPtr &s2) {
+					return s1->Mvir < s2->Mvir;
+				});
+				(*it)->main_progenitor = true;
+			}
+		}
+		subhalo->ascendants.clear();
+		subhalo->descendant.reset();
+		subhalo->host_halo.reset();
+	}
+	halo->central_subhalo.reset();
+	halo->satellite_subhalos.clear();
+	halo->subhalos_changed();
+	halo->ascendants.clear();
+	halo->descendant.reset();
+	halo->merger_tree.reset();
+}
+
+}  // anonymous namespace
+
+void TreeBuilder::prune_trees(std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params, Cosmology &cosmology, TotalBaryon &AllBaryons) const
+{
+	// A halo is pruned if neither it nor any of its progenitors reach the
+	// minimum mass, which means that all its progenitors are pruned too.
+	// Each thread keeps its own per-snapshot totals of pruned baryons
+	auto min_mass = exec_params.min_branch_mass;
+	auto universal_baryon_fraction = cosmology.universal_baryon_fraction();
+	auto n_snapshots = std::max(sim_params.max_snapshot - sim_params.min_snapshot + 1, 0);
+	std::vector<std::vector<double>> partial_pruned(std::max(threads, 1u), std::vector<double>(n_snapshots, 0));
+	std::vector<std::size_t> pruned_halos(std::max(threads, 1u), 0);
+	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+
+		// Snapshots are visited in increasing order, so ascendants come first
+		std::unordered_map<const Halo *, float> peak_mass;
+		for (auto &snapshot_and_halos: tree->halos) {
+			for (auto &halo: snapshot_and_halos.second) {
+				auto mass = halo->Mvir;
+				for (auto &ascendant: halo->ascendants) {
+					mass = std::max(mass, peak_mass[ascendant.get()]);
+				}
+				peak_mass[halo.get()] = mass;
+			}
+		}
+
+		auto &pruned_baryons = partial_pruned[thread_idx];
+		for (auto snapshot_and_halos = tree->halos.begin(); snapshot_and_halos != tree->halos.end();) {
+			auto snapshot = snapshot_and_halos->first;
+			auto &halos = snapshot_and_halos->second;
+			auto it = std::stable_partition(halos.begin(), halos.end(), [&](const HaloPtr &halo) {
+				return peak_mass[halo.get()] >= min_mass;
+			});
+			for (auto pruned = it; pruned != halos.end(); pruned++) {
+				if (snapshot >= sim_params.min_snapshot && snapshot <= sim_params.max_snapshot) {
+					pruned_baryons[snapshot - sim_params.min_snapshot] += (*pruned)->Mvir * universal_baryon_fraction;
+				}
+				unlink_pruned_halo(*pruned);
+			}
+			pruned_halos[thread_idx] += std::distance(it, halos.end());
+			halos.erase(it, halos.end());
+			if (halos.empty()) {
+				snapshot_and_halos = tree->halos.erase(snapshot_and_halos);
+			}
+			else {
+				snapshot_and_halos++;
+			}
+		}
+	});
+
+	for(int snapshot=sim_params.min_snapshot; snapshot <= sim_params.max_snapshot; snapshot++) {
+		double total_baryon_pruned = 0;
+		for(const auto &pruned_baryons: partial_pruned) {
+			total_baryon_pruned += pruned_baryons[snapshot - sim_params.min_snapshot];
+		}
+		AllBaryons.baryon_total_pruned[snapshot] = total_baryon_pruned;
+	}
+
+	// Trees whose root halo was pruned are left without halos
+	auto n_trees = trees.size();
+	trees.erase(std::remove_if(trees.begin(), trees.end(), [](const MergerTreePtr &tree) {
+		return tree->halos.empty();
+	}), trees.end());
+
+	LOG(info) << "Pruned " << std::accumulate(pruned_halos.begin(), pruned_halos.end(), std::size_t(0))
+	          << " halos below " << min_mass << " [Msun/h], dropping " << n_trees - trees.size()
+	          << " out of " << n_trees << " merger trees";
+}
+
+void TreeBuilder::sample_trees(std::vector<MergerTreePtr> &trees) const
+{
+	// Trees are grouped in bins of root halo mass, and a fixed fraction of
+	// each bin is kept so all masses remain represented. Which trees are kept
+	// depends only on the seed and their root halos, not on the order in
+	// which halos were read
+	const double log_mass_bin_width = 0.25;
+	struct sampled_tree {
+		std::uint32_t key;
+		std::size_t index;
+	};
+	std::map<int, std::vector<sampled_tree>> bins;
+	for (std::size_t i = 0; i != trees.size(); i++) {
+		const auto &root = trees[i]->halos.rbegin()->second.front();
+		auto bin = int(std::floor(std::log10(std::max(double(root->Mvir), 1.)) / log_mass_bin_width));
+		auto key = philox_engine(exec_params.seed, philox_engine::TREE_SAMPLING, root->id, root->snapshot)();
+		bins[bin].push_back({key, i});
+	}
+
+	std::vector<bool> keep(trees.size(), false);
+	for (auto &bin_and_trees: bins) {
+		auto &bin_trees = bin_and_trees.second;
+		std::sort(bin_trees.begin(), bin_trees.end(), [](const sampled_tree &a, const sampled_tree &b) {
+			return a.key < b.key || (a.key == b.key && a.index < b.index);
+		});
+		auto n_kept = std::size_t(std::ceil(exec_params.tree_sampling_rate * bin_trees.size()));
+		double weight = double(bin_trees.size()) / n_kept;
+		for (std::size_t i = 0; i != n_kept; i++) {
+			keep[bin_trees[i].index] = true;
+			trees[bin_trees[i].index]->weight = weight;
+		}
+	}
+
+	// Dropped trees are released snapshot by snapshot to break the cycles
+	// between their structures, keeping the rest in their original order
+	auto n_trees = trees.size();
+	std::vector<MergerTreePtr> sampled_trees;
+	for (std::size_t i = 0; i != trees.size(); i++) {
+		if (keep[i]) {
+			sampled_trees.emplace_back(std::move(trees[i]));
+			continue;
+		}
+		auto &tree = trees[i];
+		while (!tree->halos.empty()) {
+			tree->release_snapshot(tree->halos.begin()->first);
+		}
+	}
+	trees = std::move(sampled_trees);
+
+	LOG(info) << "Evolving " << trees.size() << " out of " << n_trees << " merger trees, sampled at a rate of "
+	          << exec_params.tree_sampling_rate << " over " << bins.size() << " bins of root halo mass";
+}
+
 std::vector<MergerTreePtr> TreeBuilder::build_trees(const std::vector<HaloPtr> &halos, SimulationParameters sim_params, GasCoolingParameters gas_cooling_params, const CosmologyPtr &cosmology, TotalBaryon &AllBaryons)
 {
 
@@ -116,6 +297,16 @@ std::vector<MergerTreePtr> TreeBuilder::build_trees(const std::vector<HaloPtr> &
 	// Make sure merger trees are fully self-contained
 	ensure_trees_are_self_contained(trees);
 
+	// Remove branches of halos that never become massive enough
+	if (exec_params.min_branch_mass > 0) {
+		prune_trees(trees, sim_params, *cosmology, AllBaryons);
+	}
+
+	// Evolve only a subsample of the trees if requested
+	if (exec_params.tree_sampling_rate < 1) {
+		sample_trees(trees);
+	}
+
 	if(exec_params.ensure_mass_growth){
 		// Ensure halos only grow in mass.
 		LOG(info) << "Making sure halos only grow in mass";
@@ -133,6 +324,16 @@ std::vector<MergerTreePtr> TreeBuilder::build_trees(const std::vector<HaloPtr> &
 	LOG(info) << "Defining accretion rate using cosmology";
 	define_accretion_rate_from_dm(trees, sim_params, gas_cooling_params, *cosmology, AllBaryons);
 
+	// The subhalo composition of halos doesn't change from here on,
+	// so build their ordered subhalo lists once upfront
+	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+		for (auto &snapshot_and_halos: tree->halos) {
+			for (auto &halo: snapshot_and_halos.second) {
+				halo->order_subhalos();
+			}
+		}
+	});
+
 	return trees;
 }
 
@@ -156,8 +357,7 @@ void TreeBuilder::link(const SubhaloPtr &parent_shalo, const SubhaloPtr &desc_su
 
 	// Establish ascendant and descendant link at halo level
 	// Ascendant is only added if not added previously
-	auto result = desc_halo->ascendants.insert(parent_halo);
-	auto halos_linked = std::get<1>(result);
+	auto halos_linked = desc_halo->add_ascendant(parent_halo);
 
 	// Fail if a halo has more than one descendant
 	if (parent_halo->descendant && parent_halo->descendant->id != desc_halo->id) {
@@ -185,6 +385,7 @@ SubhaloPtr TreeBuilder::define_central_subhalo(HaloPtr &halo, SubhaloPtr &subhal
 {
 	// point central subhalo to this subhalo.
 	halo->central_subhalo = subhalo;
+	halo->subhalos_changed();
 	halo->position = subhalo->position;
 	halo->velocity = subhalo->velocity;
 
@@ -222,7 +423,7 @@ void TreeBuilder::define_central_subhalos(const std::vector<MergerTreePtr> &tree
 					continue;
 				}
 
-				auto central_subhalo = halo->all_subhalos()[0];
+				auto central_subhalo = halo->subhalos()[0];
 				auto subhalo = define_central_subhalo(halo, central_subhalo);
 
 				// save value of lambda to make sure that all main progenitors of this subhalo have the same lambda value. This is done for consistency 
@@ -288,7 +489,7 @@ void TreeBuilder::define_central_subhalos(const std::vector<MergerTreePtr> &tree
 
 			for (auto &halo: tree->halos[snapshot]) {
 				int i = 0;
-				for (auto &subhalo: halo->all_subhalos()) {
+				for (const auto &subhalo: halo->subhalos()) {
 					if(subhalo->subhalo_type == Subhalo::CENTRAL){
 						i++;
 						if (i > 1) {
@@ -335,7 +536,7 @@ void TreeBuilder::spin_interpolated_halos(const std::vector<MergerTreePtr> &tree
 
 			for (auto &halo: tree->halos[snapshot]) {
 
-				for (auto &subhalo: halo->all_subhalos()) {
+				for (const auto &subhalo: halo->subhalos()) {
 					//Check if subhalo is there because of interpolation. If so, redefine its angular momentum and concentration to that of its progenitor.
 					if (subhalo->IsInterpolated) {
 						auto main_progenitor = subhalo->main();
@@ -359,9 +560,13 @@ void TreeBuilder::spin_interpolated_halos(const std::vector<MergerTreePtr> &tree
 void TreeBuilder::define_accretion_rate_from_dm(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params, GasCoolingParameters &gas_cooling_params, Cosmology &cosmology, TotalBaryon &AllBaryons){
 
 
-	//Loop over trees.
+	// Loop over trees. Each thread keeps its own per-snapshot totals of accreted
+	// baryons, which are then added up
 	auto universal_baryon_fraction = cosmology.universal_baryon_fraction();
-	for(auto &tree: trees) {
+	auto n_snapshots = std::max(sim_params.max_snapshot - sim_params.min_snapshot + 1, 0);
+	std::vector<std::vector<double>> partial_accreted(std::max(threads, 1u), std::vector<double>(n_snapshots, 0));
+	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+		auto &baryon_accreted = partial_accreted[thread_idx];
 		for(int snapshot=sim_params.max_snapshot; snapshot >= sim_params.min_snapshot; snapshot--) {
 				for(auto &halo: tree->halos[snapshot]){
 
@@ -383,18 +588,18 @@ void TreeBuilder::define_accretion_rate_from_dm(const std::vector<MergerTreePtr>
 					if(halo->central_subhalo->accreted_mass < 0){
 						halo->central_subhalo->accreted_mass = 0;
 					}
+
+					baryon_accreted[snapshot - sim_params.min_snapshot] += halo->central_subhalo->accreted_mass * tree->weight;
 				}
 		}
-	}
+	});
 
 	// Now accummulate baryons staring from the highest redshift.
 	double total_baryon_accreted = 0;
 
 	for(int snapshot=sim_params.min_snapshot; snapshot <= sim_params.max_snapshot; snapshot++) {
-		for(auto &tree: trees) {
-				for(auto &halo: tree->halos[snapshot]){
-					total_baryon_accreted += halo->central_subhalo->accreted_mass;
-				}
+		for(const auto &baryon_accreted: partial_accreted) {
+			total_baryon_accreted += baryon_accreted[snapshot - sim_params.min_snapshot];
 		}
 		// Keep track of the integral of the baryons mass accreted.
 		AllBaryons.baryon_total_created[snapshot] = total_baryon_accreted;
@@ -414,6 +619,7 @@ void TreeBuilder::remove_satellite(HaloPtr &halo, SubhaloPtr &subhalo){
 	}
 
 	halo->satellite_subhalos.erase(it);
+	halo->subhalos_changed();
 
 }
 
@@ -423,15 +629,108 @@ HaloBasedTreeBuilder::HaloBasedTreeBuilder(ExecutionParameters exec_params, unsi
 	// no-op
 }
 
+namespace {
+
+/**
+ * An index of halos by id, built over a sorted array of their ids. Like when
+ * inserting into a map, duplicate ids resolve to the last halo. Ids can be
+ * erased from the index, but not added to it
+ */
+class halo_index {
+
+public:
+	halo_index(const std::vector<HaloPtr> &halos, unsigned int threads) :
+		halos(halos), ids(halos.size()), erased(halos.size(), 0)
+	{
+		omp_static_for(std::size_t(0), halos.size(), threads, [&](std::size_t i, int thread_idx) {
+			ids[i] = halos[i]->id;
+		});
+		order = radix_sort(ids, threads);
+	}
+
+	const HaloPtr *find(Halo::id_t id) const
+	{
+		auto pos = position(id);
+		if (pos < 0 || erased[pos]) {
+			return nullptr;
+		}
+		return &halos[order[pos]];
+	}
+
+	void erase(Halo::id_t id)
+	{
+		auto pos = position(id);
+		if (pos >= 0) {
+			erased[pos] = 1;
+		}
+	}
+
+private:
+	std::ptrdiff_t position(Halo::id_t id) const
+	{
+		auto it = std::upper_bound(ids.begin(), ids.end(), id);
+		if (it == ids.begin() || *(it - 1) != id) {
+			return -1;
+		}
+		return (it - 1) - ids.begin();
+	}
+
+	const std::vector<HaloPtr> &halos;
+	std::vector<Halo::id_t> ids;
+	std::vector<std::size_t> order;
+	std::vector<char> erased;
+};
+
+/**
+ * What linking a halo to its descendant involves, as found by looking at its
+ * subhalos in the same order used to link them
+ */
+struct halo_links {
+	/// Subhalos to remove from the halo, as they have no descendant
+	std::vector<SubhaloPtr> removed;
+	/// Pairs of subhalo and descendant subhalo to link together
+	std::vector<std::pair<SubhaloPtr, SubhaloPtr>> links;
+	/// The descendant halo of the first link
+	HaloPtr descendant;
+	/// Whether the halo must be ignored by its ascendants
+	bool ignored = false;
+	/// Messages about missing descendant subhalos
+	std::vector<std::string> warnings;
+	/// The error this halo runs into while being linked
+	std::exception_ptr error;
+};
+
+SubhaloPtr find_subhalo(const Halo &halo, Subhalo::id_t id)
+{
+	if (halo.central_subhalo && halo.central_subhalo->id == id) {
+		return halo.central_subhalo;
+	}
+	for (const auto &subhalo: halo.satellite_subhalos) {
+		if (subhalo->id == id) {
+			return subhalo;
+		}
+	}
+	return {};
+}
+
+}  // anonymous namespace
+
 void HaloBasedTreeBuilder::loop_through_halos(const std::vector<HaloPtr> &halos)
 {
 
-	// Index all halos by snapshot and by ID, we'll need them later
-	std::map<int, std::vector<HaloPtr>> halos_by_snapshot;
-	std::map<Halo::id_t, HaloPtr> halos_by_id;
-	for(const auto &halo: halos) {
-		halos_by_snapshot[halo->snapshot].push_back(halo);
-		halos_by_id[halo->id] = halo;
+	// Index all halos by snapshot and by ID, we'll need them later.
+	// Halos are grouped by snapshot keeping their relative order
+	auto threads = get_threads();
+	halo_index halos_by_id(halos, threads);
+	std::vector<std::int64_t> snapshots(halos.size());
+	omp_static_for(std::size_t(0), halos.size(), threads, [&](std::size_t i, int thread_idx) {
+		snapshots[i] = halos[i]->snapshot;
+	});
+	auto by_snapshot = radix_sort(snapshots, threads);
+	std::map<int, span<std::size_t>> halos_by_snapshot;
+	for (std::size_t first = 0, last; first != snapshots.size(); first = last) {
+		last = std::upper_bound(snapshots.begin() + first, snapshots.end(), snapshots[first]) - snapshots.begin();
+		halos_by_snapshot[snapshots[first]] = span<std::size_t>(by_snapshot.data() + first, by_snapshot.data() + last);
 	}
 
 	// To find subhalos/halos that correspond to each other, we do the following
@@ -439,65 +738,72 @@ void HaloBasedTreeBuilder::loop_through_halos(const std::vector<HaloPtr> &halos)
 	//  2. For each snapshot S we iterate over its halos
 	//  3. For each halo H we iterate over its subhalos
 	//  4. For each subhalo SH we find the halo with subhalo.descendant_halo_id
-	//     (which we globally keep at the halos_by_id map)
+	//     (which we globally keep at the halos_by_id index)
 	//  5. When the descendant halo DH is found, we find the particular subhalo
 	//     DSH inside DH that matches SH's descendant_id
 	//  6. Now we have SH, H, DSH and DH. We link them all together,
 	//     and to their tree
-
-	// Get all snapshots in the Halos and sort them in decreasing order
+	//
+	// Steps 3-5 only read data and happen in parallel for all halos of S,
+	// gathering what needs to be done for each of them. Links are then applied
+	// in parallel for different merger trees; within a tree they are applied
+	// in the original halo order, which keeps ascendants and tree halos in the
+	// same order as if everything happened serially.
+
+	// Get all snapshots in the Halos in decreasing order
 	// (but skip the first one, those were already processed and MergerTrees
 	// were built for them)
 	std::vector<int> sorted_halo_snapshots;
-	{
-		std::set<int> halo_snapshots;
-		for(const auto &halo: halos) {
-			halo_snapshots.insert(halo->snapshot);
+	if (!halos_by_snapshot.empty()) {
+		for (auto it = ++halos_by_snapshot.rbegin(); it != halos_by_snapshot.rend(); it++) {
+			sorted_halo_snapshots.push_back(it->first);
 		}
-		sorted_halo_snapshots = std::vector<int>(++(halo_snapshots.rbegin()), halo_snapshots.rend());
 	}
 
 	// Loop as per instructions above
 	Timer t;
+	const auto &exec_params = get_exec_params();
 	for(int snapshot: sorted_halo_snapshots) {
 
 		LOG(info) << "Linking Halos/Subhalos at snapshot " << snapshot;
 
-		int ignored = 0;
-		for(auto &halo: halos_by_snapshot[snapshot]) {
+		auto snapshot_halos = halos_by_snapshot[snapshot];
+		auto n_snapshot_halos = snapshot_halos.size();
+		std::vector<halo_links> all_links(n_snapshot_halos);
+		omp_dynamic_for(std::size_t(0), n_snapshot_halos, threads, 1000, [&](std::size_t i, int thread_idx) {
 
-			bool halo_linked = false;
-			for(const auto &subhalo: halo->all_subhalos()) {
+			const auto &halo = halos[snapshot_halos[i]];
+			auto &links = all_links[i];
+			try {
+				for(const auto &subhalo: halo->all_subhalos()) {
 
-				// this subhalo has no descendants, let's not even try
-				if (!subhalo->has_descendant) {
-					if (LOG_ENABLED(debug)) {
-						LOG(debug) << subhalo << " has no descendant, not following";
+					// this subhalo has no descendants, let's not even try
+					if (!subhalo->has_descendant) {
+						if (LOG_ENABLED(debug)) {
+							LOG(debug) << subhalo << " has no descendant, not following";
+						}
+						links.removed.push_back(subhalo);
+						continue;
 					}
-					halo->remove_subhalo(subhalo);
-					continue;
-				}
 
-				// if the descendant halo is not found, we don't consider this
-				// halo anymore (and all its progenitors)
-				auto it = halos_by_id.find(subhalo->descendant_halo_id);
-				if (it == halos_by_id.end()) {
-					if (LOG_ENABLED(debug)) {
-						LOG(debug) << subhalo << " points to descendant halo/subhalo "
-						           << subhalo->descendant_halo_id << " / " << subhalo->descendant_id
-						           << ", which doesn't exist. Ignoring this halo and the rest of its progenitors";
+					// if the descendant halo is not found, we don't consider this
+					// halo anymore (and all its progenitors)
+					auto d_halo_ptr = halos_by_id.find(subhalo->descendant_halo_id);
+					if (!d_halo_ptr) {
+						if (LOG_ENABLED(debug)) {
+							LOG(debug) << subhalo << " points to descendant halo/subhalo "
+							           << subhalo->descendant_halo_id << " / " << subhalo->descendant_id
+							           << ", which doesn't exist. Ignoring this halo and the rest of its progenitors";
+						}
+						links.ignored = true;
+						break;
 					}
-					halos_by_id.erase(halo->id);
-					ignored++;
-					break;
-				}
 
-				// if the descendant subhalo is not found in the descendant halos'
-				// subhalos then we error
-				bool subhalo_descendant_found = false;
-				const auto &d_halo = halos_by_id[subhalo->descendant_halo_id];
-				for(auto &d_subhalo: d_halo->all_subhalos()) {
-					if (d_subhalo->id == subhalo->descendant_id) {
+					// if the descendant subhalo is not found in the descendant halos'
+					// subhalos then we error
+					const auto &d_halo = *d_halo_ptr;
+					auto d_subhalo = find_subhalo(*d_halo, subhalo->descendant_id);
+					if (d_subhalo) {
 
 						// We support only direct parentage; that is, descendants must be
 						// in the snapshot directly after ours
@@ -508,16 +814,28 @@ void HaloBasedTreeBuilder::loop_through_halos(const std::vector<HaloPtr> &halos)
 							throw invalid_data(os.str());
 						}
 
-						link(subhalo, d_subhalo, halo, d_halo);
-						subhalo_descendant_found = true;
-						halo_linked = true;
-						break;
+						// The checks done by link(), which can't happen there
+						// anymore when links are applied per merger tree
+						if (!links.descendant) {
+							links.descendant = d_halo;
+						}
+						else if (links.descendant->id != d_halo->id) {
+							std::ostringstream os;
+							os << halo << " already has a descendant " << links.descendant;
+							os << " but " << d_halo << " is claiming to be its descendant as well";
+							throw invalid_data(os.str());
+						}
+						if (!d_halo->merger_tree) {
+							std::ostringstream os;
+							os << "Descendant " << d_halo << " has no MergerTree associated to it";
+							throw invalid_data(os.str());
+						}
+
+						links.links.emplace_back(subhalo, std::move(d_subhalo));
+						continue;
 					}
-				}
-				if (!subhalo_descendant_found) {
 
 					std::ostringstream os;
-					auto exec_params = get_exec_params();
 					if (exec_params.skip_missing_descendants || exec_params.warn_on_missing_descendants) {
 						os << "Descendant Subhalo id=" << subhalo->descendant_id;
 						os << " for " << subhalo << " (mass: " << subhalo->Mvir << ") not found";
@@ -530,31 +848,82 @@ void HaloBasedTreeBuilder::loop_through_halos(const std::vector<HaloPtr> &halos)
 
 					// Users can choose whether to continue in these situations
 					// (with or without a warning) or if it should be considered an error
-					if (!get_exec_params().skip_missing_descendants) {
+					if (!exec_params.skip_missing_descendants) {
 						throw subhalo_not_found(os.str(), subhalo->descendant_id);
 					}
 
-					if (get_exec_params().warn_on_missing_descendants) {
-						LOG(warning) << os.str();
+					if (exec_params.warn_on_missing_descendants) {
+						links.warnings.emplace_back(os.str());
 					}
-					halo->remove_subhalo(subhalo);
+					links.removed.push_back(subhalo);
 				}
+			} catch (...) {
+				links.error = std::current_exception();
 			}
 
 			// If no subhalos were linked, this Halo will not have been linked,
 			// meaning that it also needs to be ignored
-			if (!halo_linked) {
+			if (links.links.empty() && !links.ignored) {
 				if (LOG_ENABLED(debug)) {
 					LOG(debug) << halo << " doesn't contain any Subhalo pointing to"
 					           << " descendants, ignoring it (and the rest of its progenitors)";
 				}
-				halos_by_id.erase(halo->id);
+				links.ignored = true;
+			}
+		});
+
+		// Report in halo order, failing on the first error
+		int ignored = 0;
+		for (std::size_t i = 0; i != n_snapshot_halos; i++) {
+			auto &links = all_links[i];
+			for (const auto &warning: links.warnings) {
+				LOG(warning) << warning;
+			}
+			if (links.error) {
+				std::rethrow_exception(links.error);
+			}
+			if (links.ignored) {
+				halos_by_id.erase(halos[snapshot_halos[i]]->id);
 				ignored++;
 			}
+		}
 
+		// Group linked halos by merger tree, keeping their order,
+		// and link each group in parallel
+		std::vector<std::int64_t> tree_ids;
+		std::vector<std::size_t> linked_halos;
+		for (std::size_t i = 0; i != n_snapshot_halos; i++) {
+			if (!all_links[i].links.empty()) {
+				tree_ids.push_back(all_links[i].descendant->merger_tree->id);
+				linked_halos.push_back(i);
+			}
+		}
+		auto by_tree = radix_sort(tree_ids, threads);
+		std::vector<std::size_t> tree_starts;
+		for (std::size_t i = 0; i != tree_ids.size(); i++) {
+			if (i == 0 || tree_ids[i] != tree_ids[i - 1]) {
+				tree_starts.push_back(i);
+			}
 		}
+		tree_starts.push_back(tree_ids.size());
+
+		omp_static_for(std::size_t(0), n_snapshot_halos, threads, [&](std::size_t i, int thread_idx) {
+			const auto &halo = halos[snapshot_halos[i]];
+			for (const auto &subhalo: all_links[i].removed) {
+				halo->remove_subhalo(subhalo);
+			}
+		});
+		omp_dynamic_for(std::size_t(0), tree_starts.size() - 1, threads, 100, [&](std::size_t tree, int thread_idx) {
+			for (auto j = tree_starts[tree]; j != tree_starts[tree + 1]; j++) {
+				auto i = linked_halos[by_tree[j]];
+				const auto &halo = halos[snapshot_halos[i]];
+				const auto &links = all_links[i];
+				for (const auto &link_pair: links.links) {
+					link(link_pair.first, link_pair.second, halo, links.descendant);
+				}
+			}
+		});
 
-		auto n_snapshot_halos = halos_by_snapshot[snapshot].size();
 		if (LOG_ENABLED(debug)) {
 			LOG(debug) << ignored << "/" << n_snapshot_halos << " ("
 			           << std::setprecision(2) << std::setiosflags(std::ios::fixed)
@@ -0,0 +1,619 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * TreeCache implementation
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+
+#include "arena.h"
+#include "binary_io.h"
+#include "exceptions.h"
+#include "logging.h"
+#include "numa.h"
+#include "omp_utils.h"
+#include "timer.h"
+#include "tree_cache.h"
+
+namespace shark {
+
+namespace {
+
+const char TREE_CACHE_MAGIC[8] = {'S', 'H', 'A', 'R', 'K', 'T', 'R', 'C'};
+const std::uint32_t TREE_CACHE_VERSION = 3;
+
+/// 64-bit FNV-1a hashing of arbitrary data
+class fnv1a_hash {
+
+public:
+	void add(const void *data, std::size_t size)
+	{
+		auto bytes = static_cast<const unsigned char *>(data);
+		for (std::size_t i = 0; i != size; i++) {
+			hash = (hash ^ bytes[i]) * prime;
+		}
+	}
+
+	template <typename T>
+	void add(const T &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be hashed raw");
+		add(&value, sizeof(T));
+	}
+
+	void add(const std::string &s)
+	{
+		add(std::uint64_t(s.size()));
+		add(s.data(), s.size());
+	}
+
+	template <typename K, typename V>
+	void add(const std::map<K, V> &values)
+	{
+		add(std::uint64_t(values.size()));
+		for (auto &item: values) {
+			add(item.first);
+			add(item.second);
+		}
+	}
+
+	std::uint64_t value() const
+	{
+		return hash;
+	}
+
+private:
+	static constexpr std::uint64_t prime = 1099511628211ull;
+	std::uint64_t hash = 14695981039346656037ull;
+};
+
+/**
+ * Calls @p f with each index in [0, n) and the thread handling it. Given
+ * @p offsets, indices in [offsets[t], offsets[t + 1]) are all handled by
+ * thread t; otherwise they are distributed statically across threads.
+ */
+template <typename Callable>
+void for_each_record(std::size_t n, const std::vector<std::size_t> &offsets, unsigned int threads, Callable &&f)
+{
+	if (offsets.empty()) {
+		omp_static_for(std::size_t(0), n, threads, f);
+		return;
+	}
+	omp_per_thread(threads, [&](unsigned int t, int thread_idx) {
+		for (auto i = offsets[t]; i != offsets[t + 1]; i++) {
+			f(i, thread_idx);
+		}
+	});
+}
+
+// Links between records are indices into the corresponding record arrays;
+// -1 stands for no link. Records are plain aggregates of fixed-size types
+// so they can be written and read as whole arrays
+
+const std::int64_t NO_LINK = -1;
+
+struct tree_record {
+	std::int64_t id;
+	std::uint64_t first_halo;
+	std::uint64_t n_halos;
+	double weight;
+};
+
+struct halo_record {
+	std::int64_t id;
+	std::int64_t descendant;
+	std::uint64_t first_subhalo;
+	std::uint64_t first_ascendant;
+	std::uint32_t n_subhalos;
+	std::uint32_t n_ascendants;
+	std::int32_t snapshot;
+	float mass_fraction_subhalos;
+	float Vvir;
+	float Mvir;
+	float concentration;
+	float lambda;
+	float cooling_rate;
+	float position[3];
+	float velocity[3];
+	std::uint8_t has_central;
+	std::uint8_t main_progenitor;
+};
+
+struct subhalo_record {
+	std::int64_t id;
+	std::int64_t descendant_id;
+	std::int64_t descendant_halo_id;
+	std::int64_t haloID;
+	std::int64_t descendant;
+	std::uint64_t first_ascendant;
+	std::uint32_t n_ascendants;
+	std::int32_t snapshot;
+	std::int32_t last_snapshot_identified;
+	std::int32_t descendant_snapshot;
+	std::int32_t subhalo_type;
+	float Vvir;
+	float Mvir;
+	float Vcirc;
+	float concentration;
+	float lambda;
+	float accreted_mass;
+	float L[3];
+	float position[3];
+	float velocity[3];
+	std::uint8_t has_descendant;
+	std::uint8_t main_progenitor;
+	std::uint8_t is_interpolated;
+};
+
+void to_array(const xyz<float> &v, float (&array)[3])
+{
+	array[0] = v.x;
+	array[1] = v.y;
+	array[2] = v.z;
+}
+
+xyz<float> from_array(const float (&array)[3])
+{
+	return {array[0], array[1], array[2]};
+}
+
+template <typename T>
+std::int64_t index_of(const std::unordered_map<const T *, std::uint64_t> &indices, const std::shared_ptr<T> &object)
+{
+	if (!object) {
+		return NO_LINK;
+	}
+	auto it = indices.find(object.get());
+	if (it == indices.end()) {
+		std::ostringstream os;
+		os << *object << " is referenced from the merger trees but is not part of them, cannot cache them";
+		throw invalid_data(os.str());
+	}
+	return std::int64_t(it->second);
+}
+
+void check_link(std::int64_t link, std::size_t n_records, const std::string &filename)
+{
+	if (link != NO_LINK && (link < 0 || std::uint64_t(link) >= n_records)) {
+		throw invalid_data("Tree cache " + filename + " contains invalid links");
+	}
+}
+
+void check_range(std::uint64_t first, std::uint64_t count, std::size_t n_records, const std::string &filename)
+{
+	if (first > n_records || count > n_records - first) {
+		throw invalid_data("Tree cache " + filename + " contains invalid ranges");
+	}
+}
+
+}  // anonymous namespace
+
+std::uint64_t TreeCache::checksum(const std::string &filename)
+{
+	std::ifstream f(filename, std::ios::binary);
+	if (!f) {
+		throw invalid_argument("cannot open " + filename + " to calculate its checksum");
+	}
+
+	fnv1a_hash hash;
+	std::vector<char> buffer(1024 * 1024);
+	while (f) {
+		f.read(buffer.data(), buffer.size());
+		hash.add(buffer.data(), f.gcount());
+	}
+	return hash.value();
+}
+
+std::uint64_t TreeCache::make_key(const std::vector<std::string> &tree_files, const ExecutionParameters &exec_params,
+                                  const SimulationParameters &sim_params, const DarkMatterHaloParameters &dark_matter_halo_params,
+                                  const CosmologicalParameters &cosmo_params)
+{
+	fnv1a_hash hash;
+	hash.add(TREE_CACHE_VERSION);
+
+	hash.add(std::uint64_t(tree_files.size()));
+	for (auto &tree_file: tree_files) {
+		hash.add(checksum(tree_file));
+	}
+
+	hash.add(std::int32_t(exec_params.last_output_snapshot()));
+	hash.add(exec_params.skip_missing_descendants);
+	hash.add(exec_params.ensure_mass_growth);
+	hash.add(exec_params.tree_sampling_rate);
+	hash.add(exec_params.min_branch_mass);
+	if (exec_params.spatial_selection.enabled()) {
+		hash.add(std::int32_t(exec_params.spatial_selection.get_shape()));
+		for (auto value: exec_params.spatial_selection.get_region()) {
+			hash.add(value);
+		}
+	}
+
+	hash.add(sim_params.min_snapshot);
+	hash.add(sim_params.max_snapshot);
+	hash.add(sim_params.particle_mass);
+	hash.add(sim_params.redshifts);
+
+	hash.add(std::int32_t(dark_matter_halo_params.haloprofile));
+	hash.add(std::int32_t(dark_matter_halo_params.sizemodel));
+	hash.add(std::int32_t(dark_matter_halo_params.concentrationmodel));
+	hash.add(dark_matter_halo_params.random_lambda);
+	hash.add(dark_matter_halo_params.use_converged_lambda_catalog);
+	hash.add(dark_matter_halo_params.min_part_convergence);
+	if (dark_matter_halo_params.random_lambda || exec_params.tree_sampling_rate < 1) {
+		hash.add(exec_params.seed);
+	}
+
+	hash.add(cosmo_params.OmegaM);
+	hash.add(cosmo_params.OmegaB);
+	hash.add(cosmo_params.OmegaL);
+	hash.add(cosmo_params.n_s);
+	hash.add(cosmo_params.sigma8);
+	hash.add(cosmo_params.Hubble_h);
+
+	return hash.value();
+}
+
+void TreeCache::write(const std::string &filename, const std::vector<MergerTreePtr> &merger_trees, const TotalBaryon &all_baryons) const
+{
+	// Write into a temporary file first so a failure while writing
+	// never leaves a truncated cache behind under the final name
+	auto tmp_filename = filename + ".tmp";
+	std::ofstream f(tmp_filename, std::ios::binary | std::ios::trunc);
+	if (!f) {
+		throw exception("cannot open tree cache file " + tmp_filename + " for writing");
+	}
+
+	write(f, filename, merger_trees, all_baryons);
+
+	f.close();
+	if (!f) {
+		throw exception("error while writing tree cache file " + tmp_filename);
+	}
+	if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		throw exception("cannot rename " + tmp_filename + " to " + filename);
+	}
+}
+
+void TreeCache::write(std::ostream &os, const std::string &name, const std::vector<MergerTreePtr> &merger_trees, const TotalBaryon &all_baryons) const
+{
+	Timer t;
+
+	// Number halos and subhalos in the order they are written
+	std::unordered_map<const Halo *, std::uint64_t> halo_indices;
+	std::unordered_map<const Subhalo *, std::uint64_t> subhalo_indices;
+	for (auto &tree: merger_trees) {
+		for (auto &snapshot_and_halos: tree->halos) {
+			for (auto &halo: snapshot_and_halos.second) {
+				halo_indices.emplace(halo.get(), halo_indices.size());
+				if (halo->central_subhalo) {
+					subhalo_indices.emplace(halo->central_subhalo.get(), subhalo_indices.size());
+				}
+				for (auto &subhalo: halo->satellite_subhalos) {
+					subhalo_indices.emplace(subhalo.get(), subhalo_indices.size());
+				}
+			}
+		}
+	}
+
+	std::vector<tree_record> trees(merger_trees.size());
+	std::vector<halo_record> halos(halo_indices.size());
+	std::vector<subhalo_record> subhalos(subhalo_indices.size());
+	std::vector<std::uint64_t> halo_ascendants;
+	std::vector<std::uint64_t> subhalo_ascendants;
+
+	std::uint64_t halo_idx = 0, subhalo_idx = 0;
+	auto add_subhalo = [&](const Subhalo &subhalo) {
+		auto &record = subhalos[subhalo_idx++];
+		record.id = subhalo.id;
+		record.descendant_id = subhalo.descendant_id;
+		record.descendant_halo_id = subhalo.descendant_halo_id;
+		record.haloID = subhalo.haloID;
+		record.descendant = index_of(subhalo_indices, subhalo.descendant);
+		record.first_ascendant = subhalo_ascendants.size();
+		record.n_ascendants = std::uint32_t(subhalo.ascendants.size());
+		for (auto &ascendant: subhalo.ascendants) {
+			subhalo_ascendants.push_back(std::uint64_t(index_of(subhalo_indices, ascendant)));
+		}
+		record.snapshot = subhalo.snapshot;
+		record.last_snapshot_identified = subhalo.last_snapshot_identified;
+		record.descendant_snapshot = subhalo.descendant_snapshot;
+		record.subhalo_type = std::int32_t(subhalo.subhalo_type);
+		record.Vvir = subhalo.Vvir;
+		record.Mvir = subhalo.Mvir;
+		record.Vcirc = subhalo.Vcirc;
+		record.concentration = subhalo.concentration;
+		record.lambda = subhalo.lambda;
+		record.accreted_mass = subhalo.accreted_mass;
+		to_array(subhalo.L, record.L);
+		to_array(subhalo.position, record.position);
+		to_array(subhalo.velocity, record.velocity);
+		record.has_descendant = subhalo.has_descendant;
+		record.main_progenitor = subhalo.main_progenitor;
+		record.is_interpolated = subhalo.IsInterpolated;
+	};
+
+	for (std::size_t i = 0; i != merger_trees.size(); i++) {
+		auto &tree = merger_trees[i];
+		trees[i].id = tree->id;
+		trees[i].weight = tree->weight;
+		trees[i].first_halo = halo_idx;
+		for (auto &snapshot_and_halos: tree->halos) {
+			for (auto &halo: snapshot_and_halos.second) {
+				auto &record = halos[halo_idx++];
+				record.id = halo->id;
+				record.descendant = index_of(halo_indices, halo->descendant);
+				record.first_subhalo = subhalo_idx;
+				record.n_subhalos = std::uint32_t(halo->subhalo_count());
+				record.first_ascendant = halo_ascendants.size();
+				record.n_ascendants = std::uint32_t(halo->ascendants.size());
+				for (auto &ascendant: halo->ascendants) {
+					halo_ascendants.push_back(std::uint64_t(index_of(halo_indices, ascendant)));
+				}
+				record.snapshot = halo->snapshot;
+				record.mass_fraction_subhalos = halo->mass_fraction_subhalos;
+				record.Vvir = halo->Vvir;
+				record.Mvir = halo->Mvir;
+				record.concentration = halo->concentration;
+				record.lambda = halo->lambda;
+				record.cooling_rate = halo->cooling_rate;
+				to_array(halo->position, record.position);
+				to_array(halo->velocity, record.velocity);
+				record.has_central = bool(halo->central_subhalo);
+				record.main_progenitor = halo->main_progenitor;
+
+				if (halo->central_subhalo) {
+					add_subhalo(*halo->central_subhalo);
+				}
+				for (auto &subhalo: halo->satellite_subhalos) {
+					add_subhalo(*subhalo);
+				}
+			}
+		}
+		trees[i].n_halos = halo_idx - trees[i].first_halo;
+	}
+
+	binary_writer w(os);
+	w.write(TREE_CACHE_MAGIC);
+	w.write(TREE_CACHE_VERSION);
+	w.write(key);
+	w.write(all_baryons.baryon_total_created);
+	w.write(all_baryons.baryon_total_pruned);
+	w.write(trees);
+	w.write(halos);
+	w.write(halo_ascendants);
+	w.write(subhalos);
+	w.write(subhalo_ascendants);
+	if (!os) {
+		throw exception("error while writing tree cache " + name);
+	}
+
+	LOG(info) << "Cached " << trees.size() << " merger trees (" << halos.size() << " halos, "
+	          << subhalos.size() << " subhalos) into " << name << " in " << t;
+}
+
+bool TreeCache::read(const std::string &filename, std::vector<MergerTreePtr> &merger_trees, TotalBaryon &all_baryons, unsigned int threads, bool arena_allocation, bool local_placement) const
+{
+	std::ifstream f(filename, std::ios::binary);
+	if (!f) {
+		LOG(info) << "No merger tree cache found at " << filename;
+		return false;
+	}
+	return read(f, filename, merger_trees, all_baryons, threads, arena_allocation, local_placement);
+}
+
+bool TreeCache::read(std::istream &is, const std::string &filename, std::vector<MergerTreePtr> &merger_trees, TotalBaryon &all_baryons, unsigned int threads, bool arena_allocation, bool local_placement) const
+{
+	Timer t;
+
+	binary_reader r(is, filename);
+	char magic[sizeof(TREE_CACHE_MAGIC)];
+	r.read(magic);
+	if (std::memcmp(magic, TREE_CACHE_MAGIC, sizeof(TREE_CACHE_MAGIC)) != 0) {
+		throw invalid_data(filename + " is not a shark tree cache file");
+	}
+	std::uint32_t version;
+	std::uint64_t key_;
+	r.read(version);
+	r.read(key_);
+	if (version != TREE_CACHE_VERSION || key_ != key) {
+		LOG(info) << "Merger tree cache " << filename << " was written for different inputs or options, ignoring it";
+		return false;
+	}
+
+	std::map<int, double> baryon_total_created;
+	std::map<int, double> baryon_total_pruned;
+	std::vector<tree_record> trees;
+	std::vector<halo_record> halos;
+	std::vector<std::uint64_t> halo_ascendants;
+	std::vector<subhalo_record> subhalos;
+	std::vector<std::uint64_t> subhalo_ascendants;
+	r.read(baryon_total_created);
+	r.read(baryon_total_pruned);
+	r.read(trees);
+	r.read(halos);
+	r.read(halo_ascendants);
+	r.read(subhalos);
+	r.read(subhalo_ascendants);
+
+	// Make sure all links and ranges are valid before following them,
+	// and that each halo and subhalo belongs to a single tree and halo
+	std::uint64_t next_halo = 0, next_subhalo = 0;
+	for (auto &tree: trees) {
+		if (tree.first_halo != next_halo) {
+			throw invalid_data("Tree cache " + filename + " contains invalid ranges");
+		}
+		check_range(tree.first_halo, tree.n_halos, halos.size(), filename);
+		next_halo += tree.n_halos;
+	}
+	for (auto &halo: halos) {
+		if (halo.first_subhalo != next_subhalo || (halo.has_central && halo.n_subhalos == 0)) {
+			throw invalid_data("Tree cache " + filename + " contains invalid ranges");
+		}
+		check_range(halo.first_subhalo, halo.n_subhalos, subhalos.size(), filename);
+		check_range(halo.first_ascendant, halo.n_ascendants, halo_ascendants.size(), filename);
+		check_link(halo.descendant, halos.size(), filename);
+		next_subhalo += halo.n_subhalos;
+	}
+	for (auto &subhalo: subhalos) {
+		check_range(subhalo.first_ascendant, subhalo.n_ascendants, subhalo_ascendants.size(), filename);
+		check_link(subhalo.descendant, subhalos.size(), filename);
+	}
+	for (auto ascendant: halo_ascendants) {
+		check_link(std::int64_t(ascendant), halos.size(), filename);
+	}
+	for (auto ascendant: subhalo_ascendants) {
+		check_link(std::int64_t(ascendant), subhalos.size(), filename);
+	}
+	if (next_halo != halos.size() || next_subhalo != subhalos.size()) {
+		throw invalid_data("Tree cache " + filename + " contains invalid ranges");
+	}
+
+	// Records are grouped by tree, so the trees of each thread span
+	// contiguous ranges of halo and subhalo records too
+	std::vector<std::size_t> tree_offsets, halo_offsets, subhalo_offsets;
+	if (local_placement) {
+		std::vector<std::size_t> costs;
+		for (auto &tree: trees) {
+			costs.push_back(tree.n_halos);
+		}
+		TreeAssignment assignment(costs, threads);
+		for (unsigned int t = 0; t <= assignment.threads(); t++) {
+			auto tree = assignment.begin(t);
+			auto halo = tree < trees.size() ? trees[tree].first_halo : halos.size();
+			tree_offsets.push_back(tree);
+			halo_offsets.push_back(halo);
+			subhalo_offsets.push_back(halo < halos.size() ? halos[halo].first_subhalo : subhalos.size());
+		}
+	}
+
+	// Create all objects first, then link them together
+	std::vector<MergerTreePtr> tree_ptrs(trees.size());
+	std::vector<HaloPtr> halo_ptrs(halos.size());
+	std::vector<SubhaloPtr> subhalo_ptrs(subhalos.size());
+	std::vector<ArenaSet<int>> t_arenas(arena_allocation ? std::max(threads, 1u) : 0);
+	for_each_record(subhalos.size(), subhalo_offsets, threads, [&](std::size_t i, int thread_idx) {
+		auto &record = subhalos[i];
+		ArenaPtr arena;
+		if (arena_allocation) {
+			arena = t_arenas[thread_idx].get(record.snapshot);
+		}
+		auto subhalo = make_shared_in<Subhalo>(arena, record.id, record.snapshot);
+		subhalo->descendant_id = record.descendant_id;
+		subhalo->descendant_halo_id = record.descendant_halo_id;
+		subhalo->haloID = record.haloID;
+		subhalo->last_snapshot_identified = record.last_snapshot_identified;
+		subhalo->descendant_snapshot = record.descendant_snapshot;
+		subhalo->subhalo_type = Subhalo::subhalo_type_t(record.subhalo_type);
+		subhalo->Vvir = record.Vvir;
+		subhalo->Mvir = record.Mvir;
+		subhalo->Vcirc = record.Vcirc;
+		subhalo->concentration = record.concentration;
+		subhalo->lambda = record.lambda;
+		subhalo->accreted_mass = record.accreted_mass;
+		subhalo->L = from_array(record.L);
+		subhalo->position = from_array(record.position);
+		subhalo->velocity = from_array(record.velocity);
+		subhalo->has_descendant = record.has_descendant;
+		subhalo->main_progenitor = record.main_progenitor;
+		subhalo->IsInterpolated = record.is_interpolated;
+		subhalo_ptrs[i] = std::move(subhalo);
+	});
+	for_each_record(halos.size(), halo_offsets, threads, [&](std::size_t i, int thread_idx) {
+		auto &record = halos[i];
+		ArenaPtr arena;
+		if (arena_allocation) {
+			arena = t_arenas[thread_idx].get(record.snapshot);
+		}
+		auto halo = make_shared_in<Halo>(arena, record.id, record.snapshot);
+		halo->mass_fraction_subhalos = record.mass_fraction_subhalos;
+		halo->Vvir = record.Vvir;
+		halo->Mvir = record.Mvir;
+		halo->concentration = record.concentration;
+		halo->lambda = record.lambda;
+		halo->cooling_rate = record.cooling_rate;
+		halo->position = from_array(record.position);
+		halo->velocity = from_array(record.velocity);
+		halo->main_progenitor = record.main_progenitor;
+		halo_ptrs[i] = std::move(halo);
+	});
+	for (std::size_t i = 0; i != trees.size(); i++) {
+		tree_ptrs[i] = std::make_shared<MergerTree>(trees[i].id);
+		tree_ptrs[i]->weight = trees[i].weight;
+	}
+
+	// Each halo, subhalo and tree is only modified by the thread linking it
+	for_each_record(subhalos.size(), subhalo_offsets, threads, [&](std::size_t i, int thread_idx) {
+		auto &record = subhalos[i];
+		auto &subhalo = subhalo_ptrs[i];
+		if (record.descendant != NO_LINK) {
+			subhalo->descendant = subhalo_ptrs[record.descendant];
+		}
+		for (auto j = record.first_ascendant; j != record.first_ascendant + record.n_ascendants; j++) {
+			subhalo->ascendants.push_back(subhalo_ptrs[subhalo_ascendants[j]]);
+		}
+	});
+	for_each_record(halos.size(), halo_offsets, threads, [&](std::size_t i, int thread_idx) {
+		auto &record = halos[i];
+		auto &halo = halo_ptrs[i];
+		if (record.descendant != NO_LINK) {
+			halo->descendant = halo_ptrs[record.descendant];
+		}
+		for (auto j = record.first_ascendant; j != record.first_ascendant + record.n_ascendants; j++) {
+			halo->ascendants.push_back(halo_ptrs[halo_ascendants[j]]);
+		}
+		auto first_satellite = record.first_subhalo;
+		if (record.has_central) {
+			halo->central_subhalo = subhalo_ptrs[first_satellite++];
+			halo->central_subhalo->host_halo = halo;
+		}
+		for (auto j = first_satellite; j != record.first_subhalo + record.n_subhalos; j++) {
+			subhalo_ptrs[j]->host_halo = halo;
+			halo->satellite_subhalos.push_back(subhalo_ptrs[j]);
+		}
+		halo->order_subhalos();
+	});
+	for_each_record(trees.size(), tree_offsets, threads, [&](std::size_t i, int thread_idx) {
+		auto &tree = tree_ptrs[i];
+		for (auto j = trees[i].first_halo; j != trees[i].first_halo + trees[i].n_halos; j++) {
+			halo_ptrs[j]->merger_tree = tree;
+			tree->add_halo(halo_ptrs[j]);
+		}
+	});
+
+	merger_trees = std::move(tree_ptrs);
+	all_baryons.baryon_total_created = std::move(baryon_total_created);
+	all_baryons.baryon_total_pruned = std::move(baryon_total_pruned);
+
+	LOG(info) << "Loaded " << merger_trees.size() << " merger trees (" << halos.size() << " halos, "
+	          << subhalos.size() << " subhalos) from " << filename << " in " << t;
+	return true;
+}
+
+}  // namespace shark
@@ -0,0 +1,137 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * TreeIndex implementation
+ */
+
+#include <unordered_map>
+
+#include "tree_index.h"
+
+namespace shark {
+
+constexpr TreeIndex::index_t TreeIndex::none;
+
+TreeIndex::TreeIndex(const std::vector<MergerTreePtr> &merger_trees) :
+	n_trees(merger_trees.size()),
+	snapshots(),
+	empty_snapshot()
+{
+	empty_snapshot.tree_offsets.assign(n_trees + 1, 0);
+	empty_snapshot.subhalo_offsets.assign(1, 0);
+
+	std::map<int, std::size_t> halos_per_snapshot;
+	for (auto &tree: merger_trees) {
+		for (auto &snapshot_and_halos: tree->halos) {
+			halos_per_snapshot[snapshot_and_halos.first] += snapshot_and_halos.second.size();
+		}
+	}
+
+	// Halos and subhalos of each snapshot, with their index within it
+	std::unordered_map<const Subhalo *, index_t> subhalo_indices;
+	for (auto &snapshot_and_count: halos_per_snapshot) {
+		auto snapshot = snapshot_and_count.first;
+		auto &index = snapshots[snapshot];
+		index.halos.reserve(snapshot_and_count.second);
+		index.tree_offsets.reserve(n_trees + 1);
+		index.subhalo_offsets.reserve(snapshot_and_count.second + 1);
+
+		for (auto &tree: merger_trees) {
+			index.tree_offsets.push_back(index_t(index.halos.size()));
+			auto it = tree->halos.find(snapshot);
+			if (it == tree->halos.end()) {
+				continue;
+			}
+			for (auto &halo: it->second) {
+				auto halo_idx = index_t(index.halos.size());
+				index.halos.push_back(halo);
+				index.subhalo_offsets.push_back(index_t(index.subhalos.size()));
+				for (auto &subhalo: halo->subhalos()) {
+					subhalo_indices[subhalo.get()] = index_t(index.subhalos.size());
+					index.subhalos.push_back(subhalo.get());
+					index.host_halo.push_back(halo_idx);
+				}
+			}
+		}
+		index.tree_offsets.push_back(index_t(index.halos.size()));
+		index.subhalo_offsets.push_back(index_t(index.subhalos.size()));
+	}
+
+	// Descendants always live in the next snapshot
+	for (auto &snapshot_and_index: snapshots) {
+		auto &index = snapshot_and_index.second;
+		index.descendant.resize(index.subhalos.size(), none);
+		for (std::size_t i = 0; i != index.subhalos.size(); i++) {
+			auto &descendant = index.subhalos[i]->descendant;
+			if (!descendant) {
+				continue;
+			}
+			auto it = subhalo_indices.find(descendant.get());
+			if (it != subhalo_indices.end()) {
+				index.descendant[i] = it->second;
+			}
+		}
+	}
+}
+
+const TreeIndex::snapshot_index *TreeIndex::at(int snapshot) const
+{
+	auto it = snapshots.find(snapshot);
+	if (it == snapshots.end()) {
+		return nullptr;
+	}
+	return &it->second;
+}
+
+const std::vector<HaloPtr> &TreeIndex::halos(int snapshot) const
+{
+	auto index = at(snapshot);
+	return index ? index->halos : empty_snapshot.halos;
+}
+
+span<HaloPtr> TreeIndex::tree_halos(int snapshot, std::size_t tree) const
+{
+	auto index = at(snapshot);
+	if (!index) {
+		index = &empty_snapshot;
+	}
+	const HaloPtr *halos = index->halos.data();
+	return {halos + index->tree_offsets[tree], halos + index->tree_offsets[tree + 1]};
+}
+
+span<Subhalo *> TreeIndex::subhalos(int snapshot) const
+{
+	auto index = at(snapshot);
+	if (!index) {
+		return {};
+	}
+	Subhalo *const *subhalos = index->subhalos.data();
+	return {subhalos, subhalos + index->subhalos.size()};
+}
+
+void TreeIndex::release_snapshot(int snapshot)
+{
+	snapshots.erase(snapshot);
+}
+
+}  // namespace shark
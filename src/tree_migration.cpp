@@ -0,0 +1,225 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Merger tree migration implementation
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+#include "binary_io.h"
+#include "checkpoint.h"
+#include "exceptions.h"
+#include "tree_cache.h"
+#include "tree_migration.h"
+
+namespace shark {
+
+namespace tree_migration {
+
+std::vector<std::vector<double>> plan_transfers(const std::vector<double> &loads, double max_imbalance)
+{
+	auto n_procs = loads.size();
+	if (n_procs < 2) {
+		return {};
+	}
+	auto mean = std::accumulate(loads.begin(), loads.end(), 0.) / n_procs;
+	auto max = *std::max_element(loads.begin(), loads.end());
+	if (mean <= 0 || max <= mean * max_imbalance) {
+		return {};
+	}
+
+	// Processes ordered by how far they are from the mean, ties by rank
+	std::vector<std::size_t> senders, receivers;
+	for (std::size_t i = 0; i != n_procs; i++) {
+		(loads[i] > mean ? senders : receivers).push_back(i);
+	}
+	auto by_distance = [&](std::size_t lhs, std::size_t rhs) {
+		auto lhs_distance = std::abs(loads[lhs] - mean);
+		auto rhs_distance = std::abs(loads[rhs] - mean);
+		return lhs_distance > rhs_distance || (lhs_distance == rhs_distance && lhs < rhs);
+	};
+	std::sort(senders.begin(), senders.end(), by_distance);
+	std::sort(receivers.begin(), receivers.end(), by_distance);
+
+	std::vector<std::vector<double>> transfers(n_procs, std::vector<double>(n_procs, 0));
+	std::vector<double> excess(n_procs), deficit(n_procs);
+	for (std::size_t i = 0; i != n_procs; i++) {
+		excess[i] = std::max(loads[i] - mean, 0.);
+		deficit[i] = std::max(mean - loads[i], 0.);
+	}
+	auto receiver = receivers.begin();
+	for (auto sender: senders) {
+		while (excess[sender] > 0 && receiver != receivers.end()) {
+			auto amount = std::min(excess[sender], deficit[*receiver]);
+			transfers[sender][*receiver] += amount;
+			excess[sender] -= amount;
+			deficit[*receiver] -= amount;
+			if (deficit[*receiver] <= 0) {
+				receiver++;
+			}
+		}
+	}
+	return transfers;
+}
+
+std::vector<int> select_trees(const std::vector<double> &tree_costs, const std::vector<double> &transfers)
+{
+	std::vector<std::size_t> order(tree_costs.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) {
+		return tree_costs[lhs] > tree_costs[rhs];
+	});
+
+	auto remaining = transfers;
+	std::vector<int> destinations(tree_costs.size(), -1);
+	for (auto i: order) {
+		auto cost = tree_costs[i];
+		if (cost <= 0) {
+			break;
+		}
+		for (std::size_t proc = 0; proc != remaining.size(); proc++) {
+			if (cost <= remaining[proc]) {
+				destinations[i] = int(proc);
+				remaining[proc] -= cost;
+				break;
+			}
+		}
+	}
+	return destinations;
+}
+
+void write_trees(std::ostream &os, const std::string &name, const std::vector<MergerTreePtr> &merger_trees, int snapshot)
+{
+	// Subhalos of later snapshots only hold the initial galaxies of the
+	// halos appearing in them, all other state is still empty
+	std::map<int, std::vector<SubhaloPtr>> subhalos;
+	for (auto &tree: merger_trees) {
+		if (!tree->halos.empty() && tree->halos.begin()->first < snapshot) {
+			std::ostringstream msg;
+			msg << "Merger tree " << tree->id << " still has halos before snapshot " << snapshot << ", cannot migrate it";
+			throw invalid_argument(msg.str());
+		}
+		for (auto &snapshot_and_halos: tree->halos) {
+			for (auto &halo: snapshot_and_halos.second) {
+				for (auto &subhalo: halo->subhalos()) {
+					if (snapshot_and_halos.first == snapshot || subhalo->galaxy_count() > 0) {
+						subhalos[snapshot_and_halos.first].push_back(subhalo);
+					}
+				}
+			}
+		}
+	}
+
+	TreeCache().write(os, name, merger_trees, TotalBaryon());
+
+	binary_writer w(os);
+	w.write(std::uint64_t(subhalos.size()));
+	for (auto &snapshot_and_subhalos: subhalos) {
+		w.write(std::int32_t(snapshot_and_subhalos.first));
+		w.write(std::uint64_t(snapshot_and_subhalos.second.size()));
+		for (auto &subhalo: snapshot_and_subhalos.second) {
+			write_subhalo_state(w, *subhalo);
+		}
+	}
+	if (!os) {
+		throw exception("error while writing merger trees for " + name);
+	}
+}
+
+void read_trees(std::istream &is, const std::string &name, std::vector<MergerTreePtr> &merger_trees, Galaxy::id_t &n_galaxy_ids, unsigned int threads)
+{
+	std::vector<MergerTreePtr> trees;
+	TotalBaryon ignored;
+	if (!TreeCache().read(is, name, trees, ignored, threads)) {
+		throw invalid_data("Merger trees from " + name + " were written by a different version of shark");
+	}
+
+	std::map<int, std::unordered_map<Subhalo::id_t, SubhaloPtr>> subhalos;
+	for (auto &tree: trees) {
+		for (auto &snapshot_and_halos: tree->halos) {
+			auto &snapshot_subhalos = subhalos[snapshot_and_halos.first];
+			for (auto &halo: snapshot_and_halos.second) {
+				for (auto &subhalo: halo->subhalos()) {
+					snapshot_subhalos[subhalo->id] = subhalo;
+				}
+			}
+		}
+	}
+
+	binary_reader r(is, name);
+	auto n_snapshots = r.read_size();
+	for (std::uint64_t i = 0; i != n_snapshots; i++) {
+		std::int32_t snapshot;
+		r.read(snapshot);
+		auto &snapshot_subhalos = subhalos[snapshot];
+		auto n_subhalos = r.read_size();
+		for (std::uint64_t j = 0; j != n_subhalos; j++) {
+			Subhalo::id_t id;
+			r.read(id);
+			auto it = snapshot_subhalos.find(id);
+			if (it == snapshot_subhalos.end()) {
+				std::ostringstream os;
+				os << "Subhalo " << id << " from " << name << " not found in snapshot " << snapshot << " of its merger trees";
+				throw invalid_data(os.str());
+			}
+			read_subhalo_state(r, *it->second);
+		}
+	}
+
+	// Galaxy IDs index per-galaxy values, so they must be unique within
+	// this process; descendants are always galaxies of the same trees.
+	// Random keys are kept, so migrated galaxies draw the same random numbers
+	std::unordered_map<Galaxy::id_t, Galaxy::id_t> new_ids;
+	std::vector<GalaxyPtr> galaxies;
+	for (auto &snapshot_and_subhalos: subhalos) {
+		for (auto &id_and_subhalo: snapshot_and_subhalos.second) {
+			for (auto &galaxy: id_and_subhalo.second->galaxies) {
+				galaxies.push_back(galaxy);
+			}
+		}
+	}
+	std::sort(galaxies.begin(), galaxies.end(), [](const GalaxyPtr &lhs, const GalaxyPtr &rhs) {
+		return lhs->id < rhs->id;
+	});
+	for (auto &galaxy: galaxies) {
+		new_ids[galaxy->id] = n_galaxy_ids;
+		galaxy->id = n_galaxy_ids++;
+	}
+	for (auto &galaxy: galaxies) {
+		if (galaxy->descendant_id >= 0) {
+			auto it = new_ids.find(galaxy->descendant_id);
+			galaxy->descendant_id = (it == new_ids.end()) ? -1 : it->second;
+		}
+	}
+
+	merger_trees.insert(merger_trees.end(), trees.begin(), trees.end());
+}
+
+}  // namespace tree_migration
+
+}  // namespace shark
@@ -25,6 +25,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <fstream>
 #include <functional>
 #include <locale>
 #include <string>
@@ -40,6 +41,11 @@
 # include <unistd.h>
 #endif // _WIN32
 
+// getrusage
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif // _WIN32
+
 #include "utils.h"
 
 using namespace std;
@@ -111,6 +117,39 @@ bool empty_or_comment(const std::string &s) {
 	return s.size() == 0 || s[0] == '#';
 }
 
+std::size_t peak_rss()
+{
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+# ifdef __APPLE__
+	// bytes in MacOS, kilobytes everywhere else
+	return usage.ru_maxrss;
+# else
+	return usage.ru_maxrss * 1024;
+# endif // __APPLE__
+#endif // _WIN32
+}
+
+std::size_t current_rss()
+{
+#ifdef __linux__
+	// The second field of statm is the resident set size, in pages
+	std::ifstream statm("/proc/self/statm");
+	std::size_t size, resident;
+	if (!(statm >> size >> resident)) {
+		return 0;
+	}
+	return resident * std::size_t(sysconf(_SC_PAGESIZE));
+#else
+	return 0;
+#endif // __linux__
+}
+
 std::string gethostname()
 {
 	/* is wrong to fix this to 100, but who cares (for now...) */
@@ -0,0 +1,112 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <memory>
+
+#include <cxxtest/TestSuite.h>
+
+#include "arena.h"
+#include "components.h"
+
+using namespace shark;
+
+class TestArena : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_alignment()
+	{
+		Arena arena(128);
+		for (std::size_t alignment: {1, 2, 8, 16, 32}) {
+			auto ptr = arena.allocate(3, alignment);
+			TS_ASSERT_EQUALS(reinterpret_cast<std::uintptr_t>(ptr) % alignment, 0);
+		}
+		TS_ASSERT_EQUALS(arena.used(), 15);
+		TS_ASSERT_EQUALS(arena.reserved(), 128);
+	}
+
+	void test_blocks()
+	{
+		Arena arena(128);
+		arena.allocate(100, 1);
+		arena.allocate(100, 1);
+		TS_ASSERT_EQUALS(arena.reserved(), 256);
+
+		// Objects bigger than blocks get their own
+		arena.allocate(1000, 8);
+		TS_ASSERT_EQUALS(arena.reserved(), 256 + 1008);
+		TS_ASSERT_EQUALS(arena.used(), 1200);
+	}
+
+	void test_huge_pages()
+	{
+		huge_pages::enable();
+		{
+			// Blocks are whole huge pages, and all of them can be used
+			Arena arena(128);
+			arena.allocate(100, 1);
+			arena.allocate(huge_pages::page_size - 100, 1);
+			TS_ASSERT_EQUALS(arena.reserved(), huge_pages::page_size);
+			arena.allocate(1, 1);
+			TS_ASSERT_EQUALS(arena.reserved(), 2 * huge_pages::page_size);
+		}
+		huge_pages::enable(false);
+	}
+
+	void test_shared_objects_keep_arena_alive()
+	{
+		auto arena = std::make_shared<Arena>();
+		std::weak_ptr<Arena> weak_arena = arena;
+		auto subhalo = make_shared_in<Subhalo>(arena, 1, 2);
+		auto halo = make_shared_in<Halo>(arena, 3, 2);
+		TS_ASSERT_LESS_THAN(sizeof(Subhalo) + sizeof(Halo), arena->used() + 1);
+
+		arena.reset();
+		TS_ASSERT(!weak_arena.expired());
+		TS_ASSERT_EQUALS(subhalo->id, 1);
+		TS_ASSERT_EQUALS(halo->id, 3);
+
+		subhalo.reset();
+		TS_ASSERT(!weak_arena.expired());
+		halo.reset();
+		TS_ASSERT(weak_arena.expired());
+	}
+
+	void test_no_arena()
+	{
+		auto galaxy = make_shared_in<Galaxy>(ArenaPtr(), 5);
+		TS_ASSERT_EQUALS(galaxy->id, 5);
+	}
+
+	void test_arena_set()
+	{
+		ArenaSet<int> arenas;
+		auto &arena1 = arenas.get(1);
+		TS_ASSERT_EQUALS(arena1.get(), arenas.get(1).get());
+		TS_ASSERT_DIFFERS(arena1.get(), arenas.get(2).get());
+		arenas.get(1)->allocate(10, 1);
+		arenas.get(2)->allocate(20, 1);
+		TS_ASSERT_EQUALS(arenas.used(), 30);
+		TS_ASSERT_EQUALS(arenas.reserved(), 2 * Arena::default_block_size);
+	}
+
+};
@@ -0,0 +1,107 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "background_worker.h"
+#include "exceptions.h"
+
+using namespace shark;
+
+class TestBackgroundWorker : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_invalid_pending_jobs()
+	{
+		TS_ASSERT_THROWS(BackgroundWorker(0), invalid_argument);
+	}
+
+	void test_jobs_run_in_order()
+	{
+		std::vector<int> results;
+		BackgroundWorker worker(2);
+		for (int i = 0; i != 10; i++) {
+			worker.submit([&results, i]() {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				results.push_back(i);
+			});
+		}
+		worker.wait();
+		TS_ASSERT_EQUALS(results, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+	}
+
+	void test_pending_jobs_are_bounded()
+	{
+		// The job being submitted counts as pending too, hence the +1 below
+		std::atomic<int> pending(0);
+		int max_pending = 0;
+		BackgroundWorker worker(2);
+		for (int i = 0; i != 10; i++) {
+			max_pending = std::max(max_pending, ++pending);
+			worker.submit([&pending]() {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				pending--;
+			});
+		}
+		worker.wait();
+		TS_ASSERT_LESS_THAN_EQUALS(max_pending, 2 + 1);
+		TS_ASSERT_EQUALS(pending, 0);
+	}
+
+	void test_errors_are_rethrown()
+	{
+		BackgroundWorker worker(1);
+		worker.submit([]() {
+			throw invalid_data("failed job");
+		});
+		TS_ASSERT_THROWS(worker.wait(), invalid_data);
+
+		// Errors are reported only once, and the worker keeps working
+		bool executed = false;
+		worker.submit([&executed]() {
+			executed = true;
+		});
+		worker.wait();
+		TS_ASSERT(executed);
+	}
+
+	void test_jobs_finish_on_destruction()
+	{
+		std::atomic<int> executed(0);
+		{
+			BackgroundWorker worker(5);
+			for (int i = 0; i != 5; i++) {
+				worker.submit([&executed]() {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					executed++;
+				});
+			}
+		}
+		TS_ASSERT_EQUALS(executed, 5);
+	}
+};
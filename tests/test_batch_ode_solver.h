@@ -0,0 +1,158 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include <cmath>
+#include <vector>
+
+#include <gsl/gsl_errno.h>
+
+#include "batch_ode_solver.h"
+#include "exceptions.h"
+
+using namespace shark;
+
+namespace {
+
+// dy/dt = -k * y, y(0) = y0 -> y(t) = y0 * exp(-k * t)
+int decay(double t, const double y[], double f[], void *data)
+{
+	auto k = *reinterpret_cast<double *>(data);
+	f[0] = -k * y[0];
+	return GSL_SUCCESS;
+}
+
+// y'' = -w^2 * y, y(0) = 1, y'(0) = 0 -> y(t) = cos(w * t)
+int oscillator(double t, const double y[], double f[], void *data)
+{
+	auto w = *reinterpret_cast<double *>(data);
+	f[0] = y[1];
+	f[1] = -w * w * y[0];
+	return GSL_SUCCESS;
+}
+
+int failing(double t, const double y[], double f[], void *data)
+{
+	return GSL_EBADFUNC;
+}
+
+}  // namespace
+
+class TestBatchODESolver : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_exponential_decay()
+	{
+		std::vector<double> k {0.1, 1, 10, 50};
+		std::vector<double> delta_t {1, 2, 0.5, 0.1};
+		std::vector<double> y {1, 2, 3, 4};
+		std::vector<void *> params;
+		for (auto &k_i: k) {
+			params.push_back(&k_i);
+		}
+
+		BatchODESolver solver(1, 1e-8, decay);
+		auto y0 = y;
+		solver.evolve(y, delta_t, params);
+		for (std::size_t l = 0; l != k.size(); l++) {
+			TS_ASSERT_DELTA(y[l], y0[l] * std::exp(-k[l] * delta_t[l]), 1e-6 * y0[l]);
+			TS_ASSERT_LESS_THAN(0, solver.num_evaluations(l));
+		}
+
+		// Stiffer systems need more steps
+		TS_ASSERT_LESS_THAN(solver.num_evaluations(0), solver.num_evaluations(2));
+	}
+
+	void test_lanes_are_independent()
+	{
+		// Solving systems together or each one on its own gives the same
+		std::vector<double> w {1, 3, 7};
+		std::vector<double> delta_t {5, 1, 2};
+		std::vector<double> y {1, 1, 1, 0, 0, 0};
+		std::vector<void *> params {&w[0], &w[1], &w[2]};
+
+		BatchODESolver solver(2, 1e-6, oscillator);
+		solver.evolve(y, delta_t, params);
+
+		for (std::size_t l = 0; l != w.size(); l++) {
+			std::vector<double> y_single {1, 0};
+			solver.evolve(y_single, {delta_t[l]}, {params[l]});
+			TS_ASSERT_EQUALS(y[l], y_single[0]);
+			TS_ASSERT_EQUALS(y[3 + l], y_single[1]);
+			TS_ASSERT_DELTA(y[l], std::cos(w[l] * delta_t[l]), 1e-4);
+		}
+	}
+
+	void test_initial_steps()
+	{
+		// Starting with a step closer to the one needed takes fewer steps
+		double k = 10;
+		std::vector<double> y {1, 1, 1};
+		std::vector<double> delta_t {1, 1, 1};
+		std::vector<void *> params {&k, &k, &k};
+
+		BatchODESolver solver(1, 1e-6, decay);
+		solver.evolve(y, delta_t, params);
+		auto mean_step = solver.mean_step(0);
+		TS_ASSERT_DELTA(mean_step, 1. / solver.num_evaluations(0), 1e-12);
+		auto cold_steps = solver.num_evaluations(0);
+
+		y.assign(3, 1);
+		solver.evolve(y, delta_t, params, {mean_step, 0, 2});
+		TS_ASSERT_LESS_THAN_EQUALS(solver.num_evaluations(0), cold_steps);
+		TS_ASSERT_EQUALS(solver.num_evaluations(1), cold_steps);
+		TS_ASSERT_EQUALS(solver.num_evaluations(2), cold_steps);
+		for (std::size_t l = 0; l != 3; l++) {
+			TS_ASSERT_DELTA(y[l], std::exp(-k), 1e-5);
+		}
+
+		TS_ASSERT_THROWS(solver.evolve(y, delta_t, params, {mean_step}), invalid_argument);
+	}
+
+	void test_empty_intervals()
+	{
+		double k = 1;
+		std::vector<double> y {1, 2};
+		BatchODESolver solver(1, 1e-6, decay);
+		solver.evolve(y, {0, 1}, {&k, &k});
+		TS_ASSERT_EQUALS(y[0], 1);
+		TS_ASSERT_EQUALS(solver.num_evaluations(0), 0);
+		TS_ASSERT_DELTA(y[1], 2 * std::exp(-1.), 1e-5);
+
+		std::vector<double> no_y;
+		solver.evolve(no_y, {}, {});
+		TS_ASSERT(no_y.empty());
+	}
+
+	void test_errors()
+	{
+		double k = 1;
+		std::vector<double> y {1, 2};
+		BatchODESolver solver(1, 1e-6, decay);
+		TS_ASSERT_THROWS(solver.evolve(y, {1}, {&k}), invalid_argument);
+		TS_ASSERT_THROWS(solver.evolve(y, {1, 1}, {&k}), invalid_argument);
+
+		BatchODESolver failing_solver(1, 1e-6, failing);
+		TS_ASSERT_THROWS(failing_solver.evolve(y, {1, 1}, {&k, &k}), math_error);
+	}
+};
@@ -0,0 +1,177 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+#include "components.h"
+#include "exceptions.h"
+
+using namespace shark;
+
+class TestCheckpoint : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string filename = "test_checkpoint.bin";
+
+	// A single tree with two halos at snapshot 10, one subhalo each
+	std::vector<MergerTreePtr> make_trees()
+	{
+		auto tree = std::make_shared<MergerTree>(0);
+		for (Subhalo::id_t id: {100, 200}) {
+			auto halo = std::make_shared<Halo>(id, 10);
+			auto subhalo = std::make_shared<Subhalo>(id, 10);
+			subhalo->host_halo = halo;
+			halo->central_subhalo = subhalo;
+			halo->merger_tree = tree;
+			tree->add_halo(halo);
+		}
+		return {tree};
+	}
+
+	void fill_state(const std::vector<MergerTreePtr> &trees, TotalBaryon &all_baryons)
+	{
+		Galaxy::id_t galaxy_id = 0;
+		for (auto &halo: trees[0]->halos[10]) {
+			auto &subhalo = halo->central_subhalo;
+			subhalo->hot_halo_gas.mass = 1e10f * (galaxy_id + 1);
+			subhalo->cold_halo_gas.sAM = 3.f;
+			subhalo->cooling_subhalo_tracking.add(1, 2, 3, 4);
+			subhalo->cooling_subhalo_tracking.rheat = 0.5;
+			auto galaxy = std::make_shared<Galaxy>(galaxy_id++);
+			galaxy->random_key = 50 + galaxy->id;
+			galaxy->galaxy_type = Galaxy::CENTRAL;
+			galaxy->disk_stars.mass = 2e9f;
+			galaxy->smbh.macc_sb = 7.f;
+			galaxy->interaction.major_mergers = 2;
+			galaxy->ode_step = 0.01;
+			galaxy->history.add(HistoryItem{1, 2, 3, 4, 5, 6, 9});
+			subhalo->galaxies.push_back(galaxy);
+		}
+		all_baryons.mstars.push_back(BaryonBase());
+		all_baryons.mstars.back().mass = 12;
+		all_baryons.SFR_disk = {1, 2};
+		all_baryons.baryon_total_created[9] = 5;
+	}
+
+	Checkpoint make_checkpoint()
+	{
+		Checkpoint checkpoint;
+		checkpoint.snapshot = 10;
+		checkpoint.n_galaxy_ids = 2;
+		checkpoint.options = {{"execution.name_model", "my_model"}, {"reionisation.zcut", "10"}};
+		return checkpoint;
+	}
+
+public:
+
+	void tearDown()
+	{
+		std::remove(filename.c_str());
+	}
+
+	void test_roundtrip()
+	{
+		auto original_trees = make_trees();
+		TotalBaryon original_baryons;
+		fill_state(original_trees, original_baryons);
+		make_checkpoint().write(filename, original_trees, original_baryons);
+
+		// Trees are re-created, and their initial galaxies are replaced
+		auto trees = make_trees();
+		trees[0]->halos[10][0]->central_subhalo->galaxies.push_back(std::make_shared<Galaxy>(33));
+		TotalBaryon all_baryons;
+		Checkpoint checkpoint;
+		checkpoint.n_galaxy_ids = 2;
+		checkpoint.read(filename, trees, all_baryons);
+
+		TS_ASSERT_EQUALS(checkpoint.snapshot, 10);
+		TS_ASSERT_EQUALS(checkpoint.options, make_checkpoint().options);
+		TS_ASSERT_EQUALS(all_baryons.mstars.size(), 1);
+		TS_ASSERT_EQUALS(all_baryons.mstars[0].mass, 12);
+		TS_ASSERT_EQUALS(all_baryons.SFR_disk, std::vector<double>({1, 2}));
+		TS_ASSERT_EQUALS(all_baryons.baryon_total_created[9], 5);
+
+		for (std::size_t i = 0; i != 2; i++) {
+			auto &expected = original_trees[0]->halos[10][i]->central_subhalo;
+			auto &actual = trees[0]->halos[10][i]->central_subhalo;
+			TS_ASSERT_EQUALS(actual->hot_halo_gas.mass, expected->hot_halo_gas.mass);
+			TS_ASSERT_EQUALS(actual->cold_halo_gas.sAM, expected->cold_halo_gas.sAM);
+			TS_ASSERT_EQUALS(actual->cooling_subhalo_tracking.integral, expected->cooling_subhalo_tracking.integral);
+			TS_ASSERT_EQUALS(actual->cooling_subhalo_tracking.rheat, expected->cooling_subhalo_tracking.rheat);
+			TS_ASSERT_EQUALS(actual->galaxy_count(), 1);
+			auto &expected_galaxy = expected->galaxies[0];
+			auto &actual_galaxy = actual->galaxies[0];
+			TS_ASSERT_EQUALS(actual_galaxy->id, expected_galaxy->id);
+			TS_ASSERT_EQUALS(actual_galaxy->random_key, expected_galaxy->random_key);
+			TS_ASSERT_EQUALS(actual_galaxy->galaxy_type, expected_galaxy->galaxy_type);
+			TS_ASSERT_EQUALS(actual_galaxy->disk_stars.mass, expected_galaxy->disk_stars.mass);
+			TS_ASSERT_EQUALS(actual_galaxy->smbh.macc_sb, expected_galaxy->smbh.macc_sb);
+			TS_ASSERT_EQUALS(actual_galaxy->interaction.major_mergers, expected_galaxy->interaction.major_mergers);
+			TS_ASSERT_EQUALS(actual_galaxy->ode_step, expected_galaxy->ode_step);
+			TS_ASSERT_EQUALS(actual_galaxy->history.size(), 1);
+			TS_ASSERT(actual_galaxy->history.exists(9));
+			TS_ASSERT_EQUALS(actual_galaxy->history.get(9).sfr_z_bulge_diskins, 6);
+		}
+	}
+
+	void test_header()
+	{
+		auto trees = make_trees();
+		TotalBaryon all_baryons;
+		make_checkpoint().write(filename, trees, all_baryons);
+
+		Checkpoint checkpoint;
+		checkpoint.read_header(filename);
+		TS_ASSERT_EQUALS(checkpoint.snapshot, 10);
+		TS_ASSERT_EQUALS(checkpoint.options.at("execution.name_model"), "my_model");
+	}
+
+	void test_mismatching_trees()
+	{
+		auto trees = make_trees();
+		TotalBaryon all_baryons;
+		make_checkpoint().write(filename, trees, all_baryons);
+
+		Checkpoint checkpoint;
+		checkpoint.n_galaxy_ids = 3;
+		TS_ASSERT_THROWS(checkpoint.read(filename, trees, all_baryons), invalid_data);
+
+		checkpoint.n_galaxy_ids = 2;
+		trees.push_back(std::make_shared<MergerTree>(1));
+		TS_ASSERT_THROWS(checkpoint.read(filename, trees, all_baryons), invalid_data);
+	}
+
+	void test_invalid_file()
+	{
+		std::ofstream(filename) << "not a checkpoint";
+		auto trees = make_trees();
+		TotalBaryon all_baryons;
+		Checkpoint checkpoint;
+		TS_ASSERT_THROWS(checkpoint.read(filename, trees, all_baryons), invalid_data);
+	}
+};
@@ -0,0 +1,116 @@
+//
+// ColumnarWriter unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include <boost/filesystem.hpp>
+#include "columnar_writer.h"
+
+using namespace shark;
+namespace fs = boost::filesystem;
+
+class TestColumnarWriter : public CxxTest::TestSuite {
+
+private:
+	const std::string directory {"test_columns"};
+
+	std::string read_file(const std::string &name)
+	{
+		std::ifstream f(directory + "/" + name, std::ios::binary);
+		TS_ASSERT(f.good());
+		return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	}
+
+	template <typename T>
+	std::vector<T> read_column(const std::string &name)
+	{
+		auto contents = read_file(name);
+		TS_ASSERT_EQUALS(0, contents.size() % sizeof(T));
+		std::vector<T> values(contents.size() / sizeof(T));
+		std::copy(contents.begin(), contents.end(), reinterpret_cast<char *>(values.data()));
+		return values;
+	}
+
+public:
+
+	virtual void tearDown() {
+		fs::remove_all(directory);
+	}
+
+	void test_columns()
+	{
+		std::vector<float> floats {1.5, -2, 3.25};
+		std::vector<std::int64_t> ids {10, -1, 1LL << 40};
+		std::vector<std::vector<double>> rows {{1, 2}, {3, 4}, {5, 6}};
+		std::vector<bool> flags {true, false, true};
+
+		ColumnarWriter writer(directory);
+		writer.write_dataset("galaxies/mstars_disk", floats, "stellar mass");
+		writer.write_dataset("galaxies/id_galaxy", ids);
+		writer.write_dataset("histories", rows);
+		writer.write_dataset("flags", flags);
+		TS_ASSERT(!fs::exists(directory));
+		writer.flush();
+
+		// Values are written as they are in memory in little-endian hosts
+		TS_ASSERT_EQUALS(floats, read_column<float>("galaxies/mstars_disk.bin"));
+		TS_ASSERT_EQUALS(ids, read_column<std::int64_t>("galaxies/id_galaxy.bin"));
+		TS_ASSERT_EQUALS((std::vector<double> {1, 2, 3, 4, 5, 6}), read_column<double>("histories.bin"));
+		TS_ASSERT_EQUALS(std::string("\1\0\1", 3), read_file("flags.bin"));
+
+		auto schema = read_file("schema.json");
+		TS_ASSERT_DIFFERS(std::string::npos, schema.find(R"({"name": "galaxies/mstars_disk", "file": "galaxies/mstars_disk.bin", "type": "float32", "shape": [3], "comment": "stellar mass"})"));
+		TS_ASSERT_DIFFERS(std::string::npos, schema.find(R"("type": "int64", "shape": [3])"));
+		TS_ASSERT_DIFFERS(std::string::npos, schema.find(R"("type": "float64", "shape": [3, 2])"));
+		TS_ASSERT_DIFFERS(std::string::npos, schema.find(R"("type": "bool", "shape": [3])"));
+	}
+
+	void test_values_and_attributes()
+	{
+		ColumnarWriter writer(directory);
+		writer.write_dataset("run_info/snapshot", 199, "output snapshot");
+		writer.write_dataset("run_info/redshift", 0.5);
+		writer.write_dataset("run_info/skip", true);
+		writer.write_dataset("run_info/version", std::string("2.0 \"beta\""));
+		writer.write_attribute("run_info/model_name", std::string("my_model"));
+		writer.flush();
+
+		auto schema = read_file("schema.json");
+		TS_ASSERT_DIFFERS(std::string::npos, schema.find(R"({"name": "run_info/snapshot", "type": "int32", "value": 199, "comment": "output snapshot"})"));
+		TS_ASSERT_DIFFERS(std::string::npos, schema.find(R"("type": "float64", "value": 0.5,)"));
+		TS_ASSERT_DIFFERS(std::string::npos, schema.find(R"("type": "bool", "value": true,)"));
+		TS_ASSERT_DIFFERS(std::string::npos, schema.find(R"("type": "string", "value": "2.0 \"beta\"",)"));
+		TS_ASSERT_DIFFERS(std::string::npos, schema.find(R"({"name": "run_info/model_name", "value": "my_model"})"));
+	}
+
+	void test_different_row_sizes()
+	{
+		ColumnarWriter writer(directory);
+		std::vector<std::vector<int>> rows {{1, 2}, {3}};
+		TS_ASSERT_THROWS(writer.write_dataset("rows", rows), invalid_argument);
+	}
+};
@@ -21,7 +21,9 @@
 
 #include <cxxtest/TestSuite.h>
 
+#include <algorithm>
 #include <functional>
+#include <vector>
 
 #include "components.h"
 #include "exceptions.h"
@@ -155,4 +157,210 @@ public:
 		_test_valid_satellite_galaxy_composition("122222C", false);
 	}
 
-};
\ No newline at end of file
+	void test_merger_queue()
+	{
+		// Galaxies 1 to 5 merge at ages 5, 1, 4, 2 and 3
+		auto subhalo = make_subhalo("C22222", Subhalo::CENTRAL);
+		std::vector<double> merger_ages {5, 1, 4, 2, 3};
+		for (std::size_t i = 0; i != merger_ages.size(); i++) {
+			subhalo->galaxies[i + 1]->merger_age = merger_ages[i];
+		}
+		subhalo->rebuild_merger_queue();
+		TS_ASSERT_EQUALS(subhalo->merger_queue.size(), 5);
+
+		std::vector<Galaxy::id_t> flagged;
+		subhalo->for_each_merger_before(3.5, [&flagged](const GalaxyPtr &galaxy) {
+			flagged.push_back(galaxy->id);
+		});
+		std::sort(flagged.begin(), flagged.end());
+		TS_ASSERT_EQUALS(flagged, (std::vector<Galaxy::id_t> {2, 4, 5}));
+
+		// Mergers come out in their original order
+		auto mergers = subhalo->remove_mergers(3.5);
+		TS_ASSERT_EQUALS(mergers.size(), 3);
+		TS_ASSERT_EQUALS(mergers[0]->id, 2);
+		TS_ASSERT_EQUALS(mergers[1]->id, 4);
+		TS_ASSERT_EQUALS(mergers[2]->id, 5);
+		TS_ASSERT_EQUALS(subhalo->galaxy_count(), 3);
+		TS_ASSERT_EQUALS(subhalo->galaxies[1]->id, 1);
+		TS_ASSERT_EQUALS(subhalo->galaxies[2]->id, 3);
+		TS_ASSERT(subhalo->remove_mergers(3.5).empty());
+		TS_ASSERT_EQUALS(subhalo->merger_queue.size(), 2);
+	}
+
+	void test_merger_queue_transfer()
+	{
+		auto subhalo = make_subhalo("C2", Subhalo::CENTRAL);
+		auto satellite = make_subhalo("122", Subhalo::SATELLITE);
+		subhalo->galaxies[1]->merger_age = 3;
+		satellite->galaxies[1]->merger_age = 2;
+		satellite->galaxies[2]->merger_age = 1;
+		subhalo->rebuild_merger_queue();
+		satellite->rebuild_merger_queue();
+
+		satellite->transfer_type2galaxies_to(subhalo);
+		TS_ASSERT(satellite->merger_queue.empty());
+		TS_ASSERT_EQUALS(subhalo->merger_queue.size(), 3);
+		TS_ASSERT_EQUALS(subhalo->merger_queue.front()->merger_age, 1);
+
+		// Galaxies that just became type 2 are added explicitly, their
+		// remaining timescale starting to elapse then
+		satellite->galaxies[0]->galaxy_type = Galaxy::TYPE2;
+		satellite->galaxies[0]->merger_age = 0.5;
+		satellite->queue_merger(satellite->galaxies[0], 4);
+		TS_ASSERT_EQUALS(satellite->galaxies[0]->merger_age, 4.5);
+		satellite->transfer_galaxies_to(subhalo);
+		TS_ASSERT_EQUALS(subhalo->merger_queue.size(), 4);
+		TS_ASSERT_EQUALS(subhalo->remove_mergers(4).size(), 3);
+		TS_ASSERT_EQUALS(subhalo->remove_mergers(10).size(), 1);
+		TS_ASSERT_EQUALS(subhalo->galaxy_count(), 1);
+	}
+
+};
+class TestTotalBaryon : public CxxTest::TestSuite
+{
+private:
+
+	TotalBaryon make_total_baryon(float mass, int mergers, double created)
+	{
+		TotalBaryon baryons;
+		for (int snapshot = 0; snapshot != 3; snapshot++) {
+			BaryonBase b;
+			b.mass = mass * (snapshot + 1);
+			baryons.mcold.push_back(b);
+			baryons.SFR_disk.push_back(mass);
+			baryons.major_mergers.push_back(mergers);
+		}
+		baryons.baryon_total_created[0] = created;
+		return baryons;
+	}
+
+public:
+
+	void test_addition()
+	{
+		auto b1 = make_total_baryon(1, 1, 10);
+		auto b2 = make_total_baryon(2, 3, 20);
+		b2.baryon_total_created[1] = 5;
+		b2.baryon_total_pruned[2] = 6;
+		b1 += b2;
+		TS_ASSERT_DELTA(b1.mcold[0].mass, 3., 1e-8);
+		TS_ASSERT_DELTA(b1.mcold[2].mass, 9., 1e-8);
+		TS_ASSERT_DELTA(b1.SFR_disk[1], 3., 1e-8);
+		TS_ASSERT_EQUALS(b1.major_mergers[2], 4);
+		TS_ASSERT_DELTA(b1.baryon_total_created[0], 30., 1e-8);
+		TS_ASSERT_DELTA(b1.baryon_total_created[1], 5., 1e-8);
+		TS_ASSERT_DELTA(b1.baryon_total_pruned[2], 6., 1e-8);
+	}
+
+	void test_addition_of_different_sizes()
+	{
+		auto b1 = make_total_baryon(1, 1, 10);
+		TotalBaryon b2;
+		TS_ASSERT_THROWS(b1 += b2, invalid_argument);
+	}
+
+	void test_truncate()
+	{
+		auto b = make_total_baryon(1, 1, 10);
+		b.truncate(5);
+		TS_ASSERT_EQUALS(b.mcold.size(), 3);
+		b.truncate(2);
+		TS_ASSERT_EQUALS(b.mcold.size(), 2);
+		TS_ASSERT_EQUALS(b.SFR_disk.size(), 2);
+		TS_ASSERT_EQUALS(b.major_mergers.size(), 2);
+		TS_ASSERT_DELTA(b.mcold[1].mass, 2., 1e-8);
+	}
+
+};
+
+class TestHalos : public CxxTest::TestSuite
+{
+public:
+
+	SubhaloPtr make_subhalo(Subhalo::id_t id, Subhalo::subhalo_type_t type, float mvir)
+	{
+		auto subhalo = std::make_shared<Subhalo>(id, 1);
+		subhalo->subhalo_type = type;
+		subhalo->Mvir = mvir;
+		return subhalo;
+	}
+
+	void _assert_same_subhalos(const Halo &halo)
+	{
+		auto all = halo.all_subhalos();
+		auto ordered = halo.subhalos();
+		TS_ASSERT_EQUALS(all.size(), ordered.size());
+		for (std::size_t i = 0; i != all.size(); i++) {
+			TS_ASSERT_EQUALS(all[i], ordered[i]);
+		}
+	}
+
+	void test_ordered_subhalos()
+	{
+		Halo halo(1, 1);
+		TS_ASSERT(halo.subhalos().empty());
+
+		halo.add_subhalo(make_subhalo(1, Subhalo::SATELLITE, 1));
+		halo.add_subhalo(make_subhalo(2, Subhalo::CENTRAL, 2));
+		halo.add_subhalo(make_subhalo(3, Subhalo::SATELLITE, 3));
+		_assert_same_subhalos(halo);
+		TS_ASSERT_EQUALS(halo.subhalos()[0]->id, 3);
+
+		// Changes to the halo's subhalos are reflected
+		auto satellite = halo.subhalos()[0];
+		halo.remove_subhalo(satellite);
+		_assert_same_subhalos(halo);
+		TS_ASSERT_EQUALS(halo.subhalos().size(), 2);
+		TS_ASSERT_EQUALS(halo.subhalos()[0]->id, 2);
+	}
+
+};
+
+class TestMergerTrees : public CxxTest::TestSuite
+{
+public:
+
+	void test_release_snapshot()
+	{
+		auto tree = std::make_shared<MergerTree>(0);
+		auto halo1 = std::make_shared<Halo>(1, 1);
+		auto halo2 = std::make_shared<Halo>(2, 2);
+		auto subhalo1 = std::make_shared<Subhalo>(1, 1);
+		auto subhalo2 = std::make_shared<Subhalo>(2, 2);
+		subhalo1->subhalo_type = Subhalo::CENTRAL;
+		subhalo2->subhalo_type = Subhalo::CENTRAL;
+		subhalo1->descendant = subhalo2;
+		subhalo2->ascendants.push_back(subhalo1);
+		subhalo1->host_halo = halo1;
+		subhalo2->host_halo = halo2;
+		halo1->add_subhalo(SubhaloPtr(subhalo1));
+		halo2->add_subhalo(SubhaloPtr(subhalo2));
+		halo1->descendant = halo2;
+		halo2->add_ascendant(halo1);
+		halo1->merger_tree = tree;
+		halo2->merger_tree = tree;
+		tree->add_halo(halo1);
+		tree->add_halo(halo2);
+
+		std::weak_ptr<Halo> weak_halo1 = halo1;
+		std::weak_ptr<Subhalo> weak_subhalo1 = subhalo1;
+		halo1.reset();
+		subhalo1.reset();
+		TS_ASSERT(!weak_halo1.expired());
+
+		tree->release_snapshot(1);
+		TS_ASSERT_EQUALS(tree->halos.count(1), 0);
+		TS_ASSERT_EQUALS(tree->halos.count(2), 1);
+		TS_ASSERT(weak_subhalo1.expired());
+		TS_ASSERT(weak_halo1.expired());
+		TS_ASSERT(halo2->ascendants.empty());
+		TS_ASSERT(subhalo2->ascendants.empty());
+		TS_ASSERT_EQUALS(halo2->central_subhalo, subhalo2);
+
+		tree->release_snapshot(2);
+		TS_ASSERT(tree->halos.empty());
+		TS_ASSERT(!halo2->central_subhalo);
+	}
+
+};
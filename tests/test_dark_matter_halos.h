@@ -0,0 +1,98 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+
+#include <cxxtest/TestSuite.h>
+
+#include "dark_matter_halos.h"
+#include "exceptions.h"
+
+using namespace shark;
+
+class TestDarkMatterProfileTable : public CxxTest::TestSuite
+{
+
+private:
+
+	// Same as NFWDarkMatterHalos::enclosed_mass
+	static double nfw_enclosed_mass(double r, double c)
+	{
+		double nom = 1.0 / (1.0 + c * r) - 1.0 + std::log(1.0 + c * r);
+		double denom = 1.0 / (1.0 + c) - 1.0 + std::log(1.0 + c);
+		return nom / denom;
+	}
+
+	void assert_accuracy(const DarkMatterProfileTable &table, const DarkMatterProfileTable::profile_t &profile, double accuracy)
+	{
+		for (double r: {1e-4, 3.3e-4, 0.01, 0.123, 0.5, 0.999}) {
+			for (double c: {1., 2.7, 5., 13.1, 99.}) {
+				double expected = profile(r, c);
+				double value = 0;
+				TS_ASSERT(table.get(r, c, value));
+				TS_ASSERT_DELTA(value, expected, accuracy * std::abs(expected));
+			}
+		}
+	}
+
+public:
+
+	void test_enclosed_mass()
+	{
+		DarkMatterProfileTable table("enclosed mass", nfw_enclosed_mass, 1e-5);
+		TS_ASSERT_LESS_THAN(0, table.size());
+		assert_accuracy(table, nfw_enclosed_mass, 1e-5);
+	}
+
+	void test_negative_profile()
+	{
+		auto potential = [](double r, double c) {
+			return -std::log(1 + r * c) / (r * c);
+		};
+		DarkMatterProfileTable table("potential", potential, 1e-4);
+		assert_accuracy(table, potential, 1e-4);
+	}
+
+	void test_out_of_range()
+	{
+		DarkMatterProfileTable table("enclosed mass", nfw_enclosed_mass, 1e-4);
+		double value = -1;
+		TS_ASSERT(!table.get(0, 5, value));
+		TS_ASSERT(!table.get(1, 5, value));
+		TS_ASSERT(!table.get(0.5, 0.5, value));
+		TS_ASSERT(!table.get(0.5, 101, value));
+		TS_ASSERT(!table.get(NAN, 5, value));
+		TS_ASSERT_EQUALS(value, -1);
+	}
+
+	void test_zero_profile()
+	{
+		DarkMatterProfileTable table("zero", [](double r, double c) { return 0.; }, 1e-4);
+		double value = -1;
+		TS_ASSERT(!table.get(0.5, 5, value));
+		TS_ASSERT_EQUALS(value, -1);
+	}
+
+	void test_unreachable_accuracy()
+	{
+		TS_ASSERT_THROWS(DarkMatterProfileTable("enclosed mass", nfw_enclosed_mass, 1e-15), invalid_option);
+	}
+
+};
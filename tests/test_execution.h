@@ -30,7 +30,7 @@ class TestSubhalos : public CxxTest::TestSuite
 
 private:
 
-	void assert_output_snapshots(const std::string &snapshots, std::set<int> expected_snapshots, int expected_last_snapshot)
+	Options base_options(const std::string &snapshots = "199")
 	{
 		Options opts {};
 		opts.add("execution.output_format = hdf5");
@@ -39,7 +39,12 @@ private:
 		opts.add("execution.ode_solver_precision = 0.5");
 		opts.add("execution.name_model = test");
 		opts.add(std::string("execution.output_snapshots = ") + snapshots);
-		ExecutionParameters params {opts};
+		return opts;
+	}
+
+	void assert_output_snapshots(const std::string &snapshots, std::set<int> expected_snapshots, int expected_last_snapshot)
+	{
+		ExecutionParameters params {base_options(snapshots)};
 
 		TS_ASSERT_EQUALS(params.output_snapshots, expected_snapshots);
 		TS_ASSERT_EQUALS(params.last_output_snapshot(), expected_last_snapshot);
@@ -60,4 +65,291 @@ public:
 		assert_output_snapshots("199 0 199", {0, 199}, 199);
 		assert_output_snapshots("0 199", {0, 199}, 199);
 	}
-};
\ No newline at end of file
+
+	void test_tree_scheduling()
+	{
+		TS_ASSERT_EQUALS(ExecutionParameters{base_options()}.tree_scheduling, ExecutionParameters::STATIC);
+
+		auto assert_scheduling = [&](const std::string &value, ExecutionParameters::tree_scheduling_t expected) {
+			auto opts = base_options();
+			opts.add("execution.tree_scheduling = " + value);
+			TS_ASSERT_EQUALS(ExecutionParameters{opts}.tree_scheduling, expected);
+		};
+		assert_scheduling("static", ExecutionParameters::STATIC);
+		assert_scheduling("dynamic", ExecutionParameters::DYNAMIC);
+		assert_scheduling("Cost_Aware", ExecutionParameters::COST_AWARE);
+
+		auto opts = base_options();
+		opts.add("execution.tree_scheduling = guided");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_ode_solver()
+	{
+		TS_ASSERT_EQUALS(ExecutionParameters{base_options()}.ode_solver, ExecutionParameters::ODE_GSL);
+
+		auto opts = base_options();
+		opts.add("execution.ode_solver = Batched");
+		TS_ASSERT_EQUALS(ExecutionParameters{opts}.ode_solver, ExecutionParameters::ODE_BATCHED);
+
+		opts = base_options();
+		opts.add("execution.ode_solver = simd");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_ode_stepper()
+	{
+		ExecutionParameters defaults {base_options()};
+		TS_ASSERT_EQUALS(defaults.ode_stepper, ExecutionParameters::RKCK);
+		TS_ASSERT_EQUALS(defaults.ode_starburst_stepper, ExecutionParameters::RKCK);
+
+		// Starbursts default to the general stepper
+		auto opts = base_options();
+		opts.add("execution.ode_stepper = msbdf");
+		ExecutionParameters params {opts};
+		TS_ASSERT_EQUALS(params.ode_stepper, ExecutionParameters::MSBDF);
+		TS_ASSERT_EQUALS(params.ode_starburst_stepper, ExecutionParameters::MSBDF);
+
+		opts = base_options();
+		opts.add("execution.ode_starburst_stepper = BSIMP");
+		params = ExecutionParameters{opts};
+		TS_ASSERT_EQUALS(params.ode_stepper, ExecutionParameters::RKCK);
+		TS_ASSERT_EQUALS(params.ode_starburst_stepper, ExecutionParameters::BSIMP);
+
+		opts = base_options();
+		opts.add("execution.ode_stepper = rk45");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_tree_sampling_rate()
+	{
+		ExecutionParameters defaults {base_options()};
+		TS_ASSERT_EQUALS(defaults.tree_sampling_rate, 1);
+
+		auto opts = base_options();
+		opts.add("execution.tree_sampling_rate = 0.1");
+		TS_ASSERT_DELTA(ExecutionParameters{opts}.tree_sampling_rate, 0.1, 1e-9);
+		opts.add("execution.tree_sampling_rate = 0");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.tree_sampling_rate = 1.5");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_min_branch_mass()
+	{
+		ExecutionParameters defaults {base_options()};
+		TS_ASSERT_EQUALS(defaults.min_branch_mass, 0);
+
+		auto opts = base_options();
+		opts.add("execution.min_branch_mass = 1e10");
+		TS_ASSERT_DELTA(ExecutionParameters{opts}.min_branch_mass, 1e10, 1);
+		opts.add("execution.min_branch_mass = -1");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_integration_failure_budget()
+	{
+		ExecutionParameters defaults {base_options()};
+		TS_ASSERT_EQUALS(defaults.integration_failure_budget, 1);
+
+		auto opts = base_options();
+		opts.add("execution.integration_failure_budget = 0.01");
+		TS_ASSERT_DELTA(ExecutionParameters{opts}.integration_failure_budget, 0.01, 1e-9);
+		opts.add("execution.integration_failure_budget = -0.1");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.integration_failure_budget = 1.1");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_pipelined_snapshots()
+	{
+		ExecutionParameters defaults {base_options()};
+		TS_ASSERT(!defaults.pipelined_snapshots);
+
+		auto opts = base_options();
+		opts.add("execution.pipelined_snapshots = true");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.fused_molecular_gas = true");
+		TS_ASSERT(ExecutionParameters{opts}.pipelined_snapshots);
+		opts.add("execution.halo_parallelism = true");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_tracked_molecular_gas()
+	{
+		ExecutionParameters defaults {base_options()};
+		TS_ASSERT_EQUALS(defaults.tracked_molecular_gas, ExecutionParameters::MOLGAS_FULL);
+
+		auto opts = base_options();
+		opts.add("execution.tracked_molecular_gas = Approximate");
+		TS_ASSERT_EQUALS(ExecutionParameters{opts}.tracked_molecular_gas, ExecutionParameters::MOLGAS_APPROXIMATE);
+		opts.add("execution.tracked_molecular_gas = none");
+		TS_ASSERT_EQUALS(ExecutionParameters{opts}.tracked_molecular_gas, ExecutionParameters::MOLGAS_NONE);
+		opts.add("execution.tracked_molecular_gas = subsample");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_memory_budget()
+	{
+		ExecutionParameters defaults {base_options()};
+		TS_ASSERT_EQUALS(defaults.memory_budget, 0);
+		TS_ASSERT_EQUALS(defaults.memory_budget_policy, ExecutionParameters::BUDGET_ABORT);
+
+		auto opts = base_options();
+		opts.add("execution.memory_budget = 1.5");
+		opts.add("execution.memory_budget_policy = adapt");
+		ExecutionParameters params {opts};
+		TS_ASSERT_DELTA(params.memory_budget, 1.5, 1e-6);
+		TS_ASSERT_EQUALS(params.memory_budget_policy, ExecutionParameters::BUDGET_ADAPT);
+
+		opts = base_options();
+		opts.add("execution.memory_budget = -1");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+
+		opts = base_options();
+		opts.add("execution.memory_budget_policy = ignore");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_output_compression()
+	{
+		ExecutionParameters defaults {base_options()};
+		TS_ASSERT_EQUALS(defaults.output_compression, ExecutionParameters::COMPRESSION_NONE);
+		TS_ASSERT_EQUALS(defaults.output_compression_level, 4);
+		TS_ASSERT(defaults.output_shuffle);
+		TS_ASSERT_EQUALS(defaults.output_chunk_size, 0);
+
+		auto opts = base_options();
+		opts.add("execution.output_compression = LZ4");
+		opts.add("execution.output_compression_level = 9");
+		opts.add("execution.output_shuffle = false");
+		opts.add("execution.output_chunk_size = 1000");
+		ExecutionParameters params {opts};
+		TS_ASSERT_EQUALS(params.output_compression, ExecutionParameters::COMPRESSION_LZ4);
+		TS_ASSERT_EQUALS(params.output_compression_level, 9);
+		TS_ASSERT(!params.output_shuffle);
+		TS_ASSERT_EQUALS(params.output_chunk_size, 1000);
+
+		opts = base_options();
+		opts.add("execution.output_compression = zstd");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+
+		opts = base_options();
+		opts.add("execution.output_compression_level = 10");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_shared_output()
+	{
+		TS_ASSERT(!ExecutionParameters{base_options()}.shared_output);
+
+		auto opts = base_options();
+		opts.add("execution.shared_output = true");
+		TS_ASSERT(ExecutionParameters{opts}.shared_output);
+
+		opts.add("execution.output_format = ascii");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_output_properties()
+	{
+		ExecutionParameters all {base_options()};
+		TS_ASSERT(all.output_property("galaxies/mstars_disk"));
+		TS_ASSERT(all.output_property("subhalo/id"));
+
+		auto opts = base_options();
+		opts.add("execution.output_properties = galaxies/mstars_disk subhalo");
+		ExecutionParameters selected {opts};
+		TS_ASSERT(selected.output_property("galaxies/mstars_disk"));
+		TS_ASSERT(!selected.output_property("galaxies/mstars_bulge"));
+		TS_ASSERT(!selected.output_property("galaxies/mstars_disk_2"));
+		TS_ASSERT(selected.output_property("subhalo/id"));
+		TS_ASSERT(selected.output_property("subhalo/host_id"));
+		TS_ASSERT(!selected.output_property("subhalos/id"));
+
+		opts.add("execution.excluded_output_properties = subhalo/host_id");
+		ExecutionParameters excluded {opts};
+		TS_ASSERT(excluded.output_property("subhalo/id"));
+		TS_ASSERT(!excluded.output_property("subhalo/host_id"));
+
+		opts = base_options();
+		opts.add("execution.excluded_output_properties = galaxies");
+		ExecutionParameters no_galaxies {opts};
+		TS_ASSERT(!no_galaxies.output_property("galaxies/type"));
+		TS_ASSERT(no_galaxies.output_property("subhalo/id"));
+	}
+
+	void test_sf_histories_encoding()
+	{
+		TS_ASSERT_EQUALS(ExecutionParameters::SFH_DENSE, ExecutionParameters{base_options()}.sf_histories_encoding);
+
+		auto opts = base_options();
+		opts.add("execution.sf_histories_encoding = Sparse");
+		TS_ASSERT_EQUALS(ExecutionParameters::SFH_SPARSE, ExecutionParameters{opts}.sf_histories_encoding);
+
+		opts.add("execution.sf_histories_encoding = float16");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_summary_statistics()
+	{
+		ExecutionParameters defaults {base_options()};
+		TS_ASSERT(!defaults.summary_statistics);
+		TS_ASSERT(!defaults.summary_only);
+		TS_ASSERT_EQUALS((std::vector<double> {6, 13, 0.2}), defaults.summary_mass_bins);
+
+		auto opts = base_options();
+		opts.add("execution.summary_only = true");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.summary_statistics = true");
+		TS_ASSERT(ExecutionParameters{opts}.summary_only);
+
+		opts.add("execution.summary_mass_bins = 8 12");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.summary_mass_bins = 12 8 0.1");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.summary_mass_bins = 8 12 0.1");
+		TS_ASSERT_EQUALS((std::vector<double> {8, 12, 0.1}), ExecutionParameters{opts}.summary_mass_bins);
+	}
+
+	void test_spatial_selection()
+	{
+		TS_ASSERT(!ExecutionParameters{base_options()}.spatial_selection.enabled());
+
+		auto opts = base_options();
+		opts.add("execution.spatial_selection = box");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.spatial_selection_region = 0 0 0 10 10");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.spatial_selection_region = 0 0 0 10 -10 10");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.spatial_selection_region = 0 0 0 10 20 30");
+		auto box = ExecutionParameters{opts}.spatial_selection;
+		TS_ASSERT_EQUALS(SpatialSelection::BOX, box.get_shape());
+		TS_ASSERT_EQUALS((std::vector<double> {0, 0, 0, 10, 20, 30}), box.get_region());
+
+		opts.add("execution.spatial_selection = Sphere");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.spatial_selection_region = 50 50 50 0");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.spatial_selection_region = 50 50 50 10");
+		TS_ASSERT_EQUALS(SpatialSelection::SPHERE, ExecutionParameters{opts}.spatial_selection.get_shape());
+
+		opts.add("execution.spatial_selection = cylinder");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+
+	void test_tree_migration()
+	{
+		TS_ASSERT(!ExecutionParameters{base_options()}.tree_migration);
+
+		auto opts = base_options();
+		opts.add("execution.tree_migration = true");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+		opts.add("execution.shared_output = true");
+		TS_ASSERT(ExecutionParameters{opts}.tree_migration);
+
+		opts.add("execution.halo_parallelism = true");
+		TS_ASSERT_THROWS(ExecutionParameters{opts}, invalid_option);
+	}
+};
@@ -0,0 +1,153 @@
+//
+// Galaxy history unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include "galaxy_history.h"
+
+using namespace shark;
+
+class TestGalaxyHistory : public CxxTest::TestSuite
+{
+public:
+
+	HistoryItem make_item(int snapshot)
+	{
+		float x = snapshot;
+		return HistoryItem{x, x + 1, x + 2, x + 3, x + 4, x + 5, snapshot};
+	}
+
+	void _assert_item(const GalaxyHistory &history, int snapshot)
+	{
+		TS_ASSERT(history.exists(snapshot));
+		auto item = history.get(snapshot);
+		TS_ASSERT_EQUALS(item.snapshot, snapshot);
+		TS_ASSERT_EQUALS(item.sfr_disk, snapshot);
+		TS_ASSERT_EQUALS(item.sfr_z_bulge_diskins, snapshot + 5);
+		TS_ASSERT_EQUALS(history.value(GalaxyHistory::SFR_BULGE_MERGERS, snapshot), snapshot + 1);
+	}
+
+	void test_empty()
+	{
+		GalaxyHistory history;
+		TS_ASSERT(history.empty());
+		TS_ASSERT(!history.exists(0));
+		TS_ASSERT(history.items().empty());
+		TS_ASSERT_EQUALS(history.last_snapshot(), history.first_snapshot() - 1);
+	}
+
+	void test_add_and_lookup()
+	{
+		GalaxyHistory history;
+		history.add(make_item(10));
+		history.add(make_item(11));
+		history.add(make_item(13));
+		TS_ASSERT_EQUALS(history.size(), 3);
+		TS_ASSERT_EQUALS(history.first_snapshot(), 10);
+		TS_ASSERT_EQUALS(history.last_snapshot(), 13);
+		_assert_item(history, 10);
+		_assert_item(history, 11);
+		_assert_item(history, 13);
+		TS_ASSERT(!history.exists(9));
+		TS_ASSERT(!history.exists(12));
+		TS_ASSERT(!history.exists(14));
+
+		// Earlier snapshots are inserted in place
+		history.add(make_item(7));
+		TS_ASSERT_EQUALS(history.size(), 4);
+		TS_ASSERT_EQUALS(history.first_snapshot(), 7);
+		_assert_item(history, 7);
+		_assert_item(history, 13);
+		TS_ASSERT(!history.exists(8));
+		TS_ASSERT_EQUALS(history.snapshots(), std::vector<int>({7, 10, 11, 13}));
+
+		auto items = history.items();
+		TS_ASSERT_EQUALS(items.size(), 4);
+		TS_ASSERT_EQUALS(items[0].snapshot, 7);
+		TS_ASSERT_EQUALS(items[3].snapshot, 13);
+	}
+
+	void test_replace_and_modify()
+	{
+		GalaxyHistory history;
+		history.add(make_item(5));
+		history.add(make_item(5));
+		TS_ASSERT_EQUALS(history.size(), 1);
+
+		history.value(GalaxyHistory::SFR_DISK, 5) += 1;
+		TS_ASSERT_EQUALS(history.get(5).sfr_disk, 6);
+
+		history.clear();
+		TS_ASSERT(history.empty());
+		TS_ASSERT(!history.exists(5));
+	}
+
+	void test_transfers()
+	{
+		GalaxyHistory central(1), satellite(2);
+		central.add(make_item(2));
+		satellite.add(make_item(1));
+		satellite.add(make_item(2));
+		satellite.add(make_item(3));
+
+		// Disk goes into the disk instabilities bulge
+		central.transfer_disk_to_bulge_diskins(0, 2);
+		auto item = central.get(2);
+		TS_ASSERT_EQUALS(item.sfr_disk, 0);
+		TS_ASSERT_EQUALS(item.sfr_bulge_diskins, 2 + 4);
+		TS_ASSERT_EQUALS(item.sfr_z_bulge_diskins, 5 + 7);
+
+		// Everything goes into the mergers bulge, only for snapshots <= 2
+		central.transfer_satellite_to_bulge_mergers(satellite, 0, 2);
+		TS_ASSERT_EQUALS(central.snapshots(), std::vector<int>({1, 2}));
+		TS_ASSERT_EQUALS(central.get(1).sfr_disk, 0);
+		TS_ASSERT_EQUALS(central.get(1).sfr_bulge_diskins, 0);
+		TS_ASSERT_EQUALS(central.get(1).sfr_bulge_mergers, 1 + 2 + 3);
+		TS_ASSERT_EQUALS(central.get(2).sfr_bulge_mergers, 3 + 3 + 4 + 2);
+
+		central.transfer_disk_to_bulge_mergers(0, 2);
+		TS_ASSERT_EQUALS(central.get(2).sfr_bulge_diskins, 0);
+		TS_ASSERT_EQUALS(central.get(2).sfr_bulge_mergers, 12 + 6);
+
+		// Nothing was streamed, so no events were recorded
+		TS_ASSERT(central.take_events().empty());
+	}
+
+	void test_streamed_transfers_are_recorded()
+	{
+		GalaxyHistory central(1), satellite(2);
+		satellite.set_streamed();
+		satellite.transfer_disk_to_bulge_diskins(0, 4);
+		central.transfer_satellite_to_bulge_mergers(satellite, 0, 4);
+		TS_ASSERT(central.streamed());
+		TS_ASSERT(satellite.take_events().empty());
+
+		auto events = central.take_events();
+		TS_ASSERT_EQUALS(events.size(), 2);
+		TS_ASSERT_EQUALS(events[0].type, HistoryEvent::DISK_TO_BULGE_DISKINS);
+		TS_ASSERT_EQUALS(events[0].galaxy_id, 2);
+		TS_ASSERT_EQUALS(events[1].type, HistoryEvent::SATELLITE_TO_BULGE_MERGERS);
+		TS_ASSERT_EQUALS(events[1].galaxy_id, 1);
+		TS_ASSERT_EQUALS(events[1].satellite_id, 2);
+		TS_ASSERT_EQUALS(events[1].last_snapshot, 4);
+		TS_ASSERT(central.take_events().empty());
+	}
+
+};
@@ -0,0 +1,106 @@
+//
+// GalaxyWriter unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include <boost/filesystem.hpp>
+#include "cosmology.h"
+#include "execution.h"
+#include "galaxy_writer.h"
+#include "options.h"
+#include "simulation.h"
+#include "star_formation.h"
+
+using namespace shark;
+namespace fs = boost::filesystem;
+
+class TestGalaxyWriter : public CxxTest::TestSuite {
+
+private:
+
+	const std::string output_dir {"galaxy_writer_output"};
+	const std::string redshift_file {"galaxy_writer_redshifts.txt"};
+
+	Options base_options(const std::string &batches)
+	{
+		Options opts {};
+		opts.add("execution.output_format = hdf5");
+		opts.add("execution.output_directory = " + output_dir);
+		opts.add("execution.simulation_batches = " + batches);
+		opts.add("execution.ode_solver_precision = 0.5");
+		opts.add("execution.name_model = test");
+		opts.add("execution.output_snapshots = 199");
+		opts.add("simulation.sim_name = sim");
+		opts.add("simulation.volume = 1000");
+		opts.add("simulation.lbox = 10");
+		opts.add("simulation.tot_n_subvolumes = 2");
+		opts.add("simulation.min_snapshot = 198");
+		opts.add("simulation.max_snapshot = 199");
+		opts.add("simulation.tree_files_prefix = tree.");
+		opts.add("simulation.redshift_file = " + redshift_file);
+		return opts;
+	}
+
+	GalaxyWriterPtr make_writer(const std::string &batches)
+	{
+		auto opts = base_options(batches);
+		CosmologicalParameters cosmo_params {opts};
+		auto cosmology = std::make_shared<Cosmology>(cosmo_params);
+		return make_galaxy_writer(ExecutionParameters {opts}, cosmo_params, cosmology, DarkMatterHalosPtr(), SimulationParameters {opts});
+	}
+
+public:
+
+	virtual void setUp() {
+		std::ofstream f(redshift_file);
+		f << "198 0.1\n199 0\n";
+	}
+
+	virtual void tearDown() {
+		fs::remove_all(output_dir);
+		fs::remove(redshift_file);
+	}
+
+	void test_output_directories_are_created()
+	{
+		TS_ASSERT(!fs::exists(output_dir));
+
+		auto writer = make_writer("0");
+		auto dirname = writer->get_output_directory(199);
+		TS_ASSERT_EQUALS(output_dir + "/sim/test/199/0", dirname);
+		TS_ASSERT(fs::is_directory(dirname));
+
+		// Outputs can be written straight into the new directory
+		writer->write_summary(199, {}, molgas_per_galaxy());
+		TS_ASSERT(fs::is_regular_file(dirname + "/summary.hdf5"));
+
+		writer = make_writer("0 1");
+		dirname = writer->get_output_directory(198);
+		TS_ASSERT_EQUALS(output_dir + "/sim/test/198/multiple_batches", dirname);
+		TS_ASSERT(fs::is_directory(dirname));
+	}
+
+};
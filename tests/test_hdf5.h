@@ -122,6 +122,129 @@ public:
 		TS_ASSERT_EQUALS(doubles, hdf5_doubles);
 	}
 
+	void test_read_dataset_rows()
+	{
+		std::vector<int> integers {1, 2, 3, 4, 5};
+		std::vector<std::vector<float>> pairs {{1, 2}, {3, 4}, {5, 6}, {7, 8}};
+		{
+			auto writer = get_writer();
+			writer.write_dataset("integers", integers);
+			writer.write_dataset("pairs", pairs);
+		}
+
+		auto reader = get_reader();
+		TS_ASSERT_EQUALS(reader.get_dataset_rows("integers"), 5);
+		TS_ASSERT_EQUALS(reader.get_dataset_rows("pairs"), 4);
+
+		TS_ASSERT_EQUALS(reader.read_dataset_v<int>("integers", 1, 3), (std::vector<int>{2, 3, 4}));
+		TS_ASSERT_EQUALS(reader.read_dataset_v<int>("integers", 4, 1), (std::vector<int>{5}));
+		TS_ASSERT(reader.read_dataset_v<int>("integers", 5, 0).empty());
+		TS_ASSERT_EQUALS(reader.read_dataset_v_2<float>("pairs", 2, 2), (std::vector<float>{5, 6, 7, 8}));
+
+		TS_ASSERT_THROWS(reader.read_dataset_v<int>("integers", 3, 3), invalid_argument);
+		TS_ASSERT_THROWS(reader.read_dataset_v<int>("integers", 6, 0), invalid_argument);
+		TS_ASSERT_THROWS(reader.read_dataset_v_2<float>("pairs", 4, 1), invalid_argument);
+
+		// Several ranges at once
+		std::vector<hdf5::row_range> rows {{0, 1}, {2, 0}, {3, 2}};
+		TS_ASSERT_EQUALS(reader.read_dataset_v<int>("integers", rows), (std::vector<int>{1, 4, 5}));
+		rows = {{0, 1}, {3, 1}};
+		TS_ASSERT_EQUALS(reader.read_dataset_v_2<float>("pairs", rows), (std::vector<float>{1, 2, 7, 8}));
+		TS_ASSERT(reader.read_dataset_v<int>("integers", std::vector<hdf5::row_range>{}).empty());
+		rows = {{2, 2}, {1, 1}};
+		TS_ASSERT_THROWS(reader.read_dataset_v<int>("integers", rows), invalid_argument);
+	}
+
+	void test_read_dataset_into()
+	{
+		std::vector<int> integers {1, 2, 3, 4, 5};
+		std::vector<std::vector<float>> triplets {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+		{
+			auto writer = get_writer();
+			writer.write_dataset("integers", integers);
+			writer.write_dataset("triplets", triplets);
+		}
+
+		auto reader = get_reader();
+
+		// Whole datasets, with type conversion
+		std::vector<double> doubles(5);
+		reader.read_dataset_into<double>("integers", doubles);
+		TS_ASSERT_EQUALS(doubles, (std::vector<double>{1, 2, 3, 4, 5}));
+		std::vector<float> floats(9);
+		reader.read_dataset_into<float>("triplets", floats);
+		TS_ASSERT_EQUALS(floats, (std::vector<float>{1, 2, 3, 4, 5, 6, 7, 8, 9}));
+
+		// Selected rows
+		std::vector<hdf5::row_range> rows {{0, 1}, {2, 1}};
+		std::vector<int> selected(2);
+		reader.read_dataset_into<int>("integers", rows, selected);
+		TS_ASSERT_EQUALS(selected, (std::vector<int>{1, 3}));
+
+		// Selected rows, one buffer per column
+		std::vector<float> x(2), y(2), z(2);
+		reader.read_dataset_columns_into<float>("triplets", rows, {x, y, z});
+		TS_ASSERT_EQUALS(x, (std::vector<float>{1, 7}));
+		TS_ASSERT_EQUALS(y, (std::vector<float>{2, 8}));
+		TS_ASSERT_EQUALS(z, (std::vector<float>{3, 9}));
+
+		// Buffers must have exactly the selected number of values,
+		// and columns must exist
+		std::vector<int> too_small(1);
+		TS_ASSERT_THROWS(reader.read_dataset_into<int>("integers", rows, too_small), invalid_argument);
+		std::vector<float> w(2);
+		TS_ASSERT_THROWS(reader.read_dataset_columns_into<float>("triplets", rows, {x, y, z, w}), invalid_argument);
+	}
+
+	void test_compressed_datasets()
+	{
+		// Enough values for a few chunks, the last one only partially filled
+		std::vector<double> doubles(2500);
+		std::vector<int> integers(2500);
+		for (std::size_t i = 0; i != doubles.size(); i++) {
+			doubles[i] = i * 0.5;
+			integers[i] = int(i % 7) - 3;
+		}
+		std::vector<std::vector<float>> triplets {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+
+		for (auto shuffle: {true, false}) {
+			hdf5::dataset_storage storage;
+			storage.compression = hdf5::dataset_storage::DEFLATE;
+			storage.chunk_size = 1000;
+			storage.shuffle = shuffle;
+			storage.threads = 2;
+			{
+				auto writer = get_writer();
+				writer.set_storage(storage);
+				writer.write_dataset("group/doubles", doubles);
+				writer.write_dataset("integers", integers);
+				writer.write_dataset("triplets", triplets);
+				writer.write_dataset("scalar", 1);
+				writer.write_dataset("empty", std::vector<int>());
+			}
+
+			auto reader = get_reader();
+			TS_ASSERT_EQUALS(reader.read_dataset_v<double>("group/doubles"), doubles);
+			TS_ASSERT_EQUALS(reader.read_dataset_v<int>("integers"), integers);
+			TS_ASSERT_EQUALS(reader.read_dataset_v_2<float>("triplets"), (std::vector<float>{1, 2, 3, 4, 5, 6, 7, 8, 9}));
+			TS_ASSERT_EQUALS(reader.read_dataset<int>("scalar"), 1);
+		}
+	}
+
+	void test_exists()
+	{
+		{
+			auto writer = get_writer();
+			writer.write_dataset("/group/integers", std::vector<int>{1, 2, 3, 4});
+		}
+
+		auto reader = get_reader();
+		TS_ASSERT(reader.exists("group"));
+		TS_ASSERT(reader.exists("/group/integers"));
+		TS_ASSERT(!reader.exists("group/floats"));
+		TS_ASSERT(!reader.exists("other_group/integers"));
+	}
+
 	void test_wrong_attribute_writes()
 	{
 		// Single-named attributes are not supported
@@ -0,0 +1,130 @@
+//
+// History stream unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "components.h"
+#include "history_stream.h"
+
+using namespace shark;
+
+class TestHistoryStream : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string filename = "test_history_stream.hdf5";
+
+	void add_item(const GalaxyPtr &galaxy, int snapshot)
+	{
+		float x = galaxy->id * 100 + snapshot;
+		galaxy->history.add({x, x + 1, x + 2, x + 3, x + 4, x + 5, snapshot});
+	}
+
+	void _assert_same_history(const GalaxyHistory &expected, const GalaxyHistory &actual)
+	{
+		TS_ASSERT_EQUALS(expected.snapshots(), actual.snapshots());
+		for (auto s: expected.snapshots()) {
+			for (int col = 0; col != GalaxyHistory::N_COLUMNS; col++) {
+				auto column = GalaxyHistory::column(col);
+				TS_ASSERT_EQUALS(expected.value(column, s), actual.value(column, s));
+			}
+		}
+	}
+
+	/// Evolves the histories of a central and a satellite galaxy for three
+	/// snapshots, optionally streaming them after each snapshot
+	GalaxyHistory evolve(HistoryStream *stream)
+	{
+		auto halo = std::make_shared<Halo>(1, 0);
+		auto subhalo = std::make_shared<Subhalo>(1, 0);
+		subhalo->subhalo_type = Subhalo::CENTRAL;
+		halo->add_subhalo(SubhaloPtr(subhalo));
+		auto central = std::make_shared<Galaxy>(1);
+		auto satellite = std::make_shared<Galaxy>(2);
+		subhalo->galaxies = {central, satellite};
+		std::vector<HaloPtr> halos {halo};
+
+		auto end_of_snapshot = [&](int snapshot) {
+			for (auto &galaxy: subhalo->galaxies) {
+				add_item(galaxy, snapshot);
+			}
+			if (stream) {
+				stream->append(HistoryStream::collect(snapshot, halos));
+			}
+		};
+
+		end_of_snapshot(0);
+
+		satellite->history.transfer_disk_to_bulge_diskins(0, 0);
+		end_of_snapshot(1);
+
+		central->history.transfer_disk_to_bulge_diskins(0, 1);
+		satellite->history.transfer_disk_to_bulge_diskins(0, 1);
+		central->history.transfer_satellite_to_bulge_mergers(satellite->history, 0, 1);
+		central->history.transfer_disk_to_bulge_mergers(0, 1);
+		subhalo->galaxies = {central};
+		end_of_snapshot(2);
+
+		return central->history;
+	}
+
+public:
+
+	void tearDown()
+	{
+		std::remove(filename.c_str());
+	}
+
+	void test_in_memory_histories_are_not_streamed()
+	{
+		auto history = evolve(nullptr);
+		TS_ASSERT(!history.streamed());
+		TS_ASSERT(history.take_events().empty());
+		TS_ASSERT_EQUALS(history.size(), 3);
+	}
+
+	void test_streamed_histories_are_reassembled()
+	{
+		auto expected = evolve(nullptr);
+
+		HistoryStream stream(filename);
+		auto in_memory = evolve(&stream);
+		TS_ASSERT(in_memory.empty());
+
+		auto histories = stream.assemble({1, 2, 3});
+		TS_ASSERT_EQUALS(histories.size(), 3);
+		_assert_same_history(expected, histories.at(1));
+		TS_ASSERT_EQUALS(histories.at(2).size(), 2);
+		TS_ASSERT(histories.at(3).empty());
+	}
+
+	void test_empty_stream()
+	{
+		HistoryStream stream(filename);
+		auto histories = stream.assemble({1});
+		TS_ASSERT(histories.at(1).empty());
+	}
+
+};
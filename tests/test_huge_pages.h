@@ -0,0 +1,85 @@
+//
+// Huge pages unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "huge_pages.h"
+
+using namespace shark;
+
+class TestHugePages : public CxxTest::TestSuite
+{
+
+public:
+
+	virtual void tearDown()
+	{
+		huge_pages::enable(false);
+	}
+
+	void test_disabled()
+	{
+		TS_ASSERT(!huge_pages::enabled());
+		auto block = huge_pages::allocate(100);
+		TS_ASSERT_EQUALS(block.size, 100);
+		TS_ASSERT_EQUALS(block.backed_by, huge_pages::REGULAR);
+		huge_pages::deallocate(block);
+	}
+
+	void test_enabled()
+	{
+		huge_pages::enable();
+		auto explicit_before = huge_pages::explicit_bytes();
+		auto block = huge_pages::allocate(huge_pages::page_size + 1);
+		TS_ASSERT_EQUALS(block.size, 2 * huge_pages::page_size);
+
+		// Regular pages only where huge pages are not supported at all
+#ifdef __linux__
+		TS_ASSERT_DIFFERS(block.backed_by, huge_pages::REGULAR);
+		TS_ASSERT_EQUALS(reinterpret_cast<std::uintptr_t>(block.data) % huge_pages::page_size, 0);
+#endif // __linux__
+		if (block.backed_by == huge_pages::EXPLICIT) {
+			TS_ASSERT_EQUALS(huge_pages::explicit_bytes(), explicit_before + block.size);
+		}
+		std::memset(block.data, 1, block.size);
+		huge_pages::deallocate(block);
+		TS_ASSERT_EQUALS(huge_pages::explicit_bytes(), explicit_before);
+	}
+
+	void test_advise()
+	{
+		// Advising is harmless regardless of the alignment of the memory
+		std::vector<float> values;
+		values.reserve(3 * huge_pages::page_size / sizeof(float));
+		for (bool enabled: {false, true}) {
+			huge_pages::enable(enabled);
+			huge_pages::advise(values.data(), 10);
+			huge_pages::advise(values.data() + 1, values.capacity() * sizeof(float) - 4);
+		}
+		values.resize(values.capacity(), 1.f);
+		TS_ASSERT_EQUALS(values.back(), 1.f);
+	}
+};
@@ -0,0 +1,167 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <thread>
+
+#include <cxxtest/TestSuite.h>
+#include <gsl/gsl_errno.h>
+
+#include "exceptions.h"
+#include "integrator.h"
+
+using namespace shark;
+
+namespace {
+
+void polynomials(double x, void *params, double f[])
+{
+	f[0] = x * x;
+	f[1] = x * x * x;
+}
+
+void peaks(double x, void *params, double f[])
+{
+	auto width = *reinterpret_cast<double *>(params);
+	f[0] = 1 / (width * width + x * x);
+	f[1] = x * f[0];
+	f[2] = std::exp(-x);
+}
+
+}  // namespace
+
+class TestIntegrator : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_polynomials()
+	{
+		// Integrated exactly with a single interval
+		Integrator integrator(100);
+		double result[2];
+		integrator.integrate(polynomials, nullptr, 2, 0, 2, 0, 1e-6, result);
+		TS_ASSERT_DELTA(result[0], 8. / 3, 1e-12);
+		TS_ASSERT_DELTA(result[1], 4., 1e-12);
+		TS_ASSERT_EQUALS(integrator.get_num_intervals(), 1);
+	}
+
+	void test_subdivision()
+	{
+		// Each component needs a different number of intervals,
+		// so all of them are integrated to at least their tolerance
+		double width = 1e-3;
+		Integrator integrator(1000);
+		double result[3];
+		integrator.integrate(peaks, &width, 3, -1, 2, 0, 1e-8, result);
+		TS_ASSERT_DELTA(result[0], (std::atan(2 / width) + std::atan(1 / width)) / width, 1e-8 * result[0]);
+		TS_ASSERT_DELTA(result[1], std::log((width * width + 4) / (width * width + 1)) / 2, 1e-8);
+		TS_ASSERT_DELTA(result[2], std::exp(1.) - std::exp(-2.), 1e-8 * result[2]);
+		TS_ASSERT_LESS_THAN(1, integrator.get_num_intervals());
+
+		integrator.reset_num_intervals();
+		TS_ASSERT_EQUALS(integrator.get_num_intervals(), 0);
+	}
+
+	void test_max_intervals()
+	{
+		double width = 1e-6;
+		Integrator integrator(3);
+		double result[3];
+		TS_ASSERT_THROWS(integrator.integrate(peaks, &width, 3, -1, 2, 0, 1e-10, result), gsl_error);
+		TS_ASSERT_EQUALS(integrator.get_num_intervals(), 3);
+	}
+
+	void test_try_integrate()
+	{
+		// Failures are reported through the return value, with the best
+		// estimates still written into the results
+		double width = 1e-6;
+		Integrator integrator(3);
+		double result[3] = {0, 0, 0};
+		TS_ASSERT_EQUALS(integrator.try_integrate(peaks, &width, 3, -1, 2, 0, 1e-10, result), GSL_EMAXITER);
+		TS_ASSERT_EQUALS(integrator.get_num_intervals(), 3);
+		TS_ASSERT_DELTA(result[2], std::exp(1.) - std::exp(-2.), 1e-6);
+
+		double polynomial_result[2];
+		TS_ASSERT_EQUALS(integrator.try_integrate(polynomials, nullptr, 2, 0, 2, 0, 1e-6, polynomial_result), GSL_SUCCESS);
+		TS_ASSERT_DELTA(polynomial_result[0], 8. / 3, 1e-12);
+	}
+
+	void test_fixed_rule()
+	{
+		// The Kronrod rule is exact up to degree 31, the embedded Gauss rule
+		// only up to degree 19, so the error estimate of x^30 is high
+		Integrator integrator(100);
+		double result[2];
+		auto monomials = [](const double x[], std::size_t n_points, double values[]) {
+			for (std::size_t i = 0; i != n_points; i++) {
+				values[i] = std::pow(x[i], 18);
+				values[n_points + i] = std::pow(x[i], 30);
+			}
+		};
+		TS_ASSERT(!integrator.integrate_fixed(monomials, 2, -1, 1, 0, 1e-10, result));
+		TS_ASSERT_DELTA(result[0], 2. / 19, 1e-14);
+		TS_ASSERT_DELTA(result[1], 2. / 31, 1e-14);
+		TS_ASSERT_EQUALS(integrator.get_num_intervals(), 1);
+
+		// Only the first component passes
+		TS_ASSERT(integrator.integrate_fixed(monomials, 1, -1, 1, 0, 1e-10, result));
+		TS_ASSERT_DELTA(result[0], 2. / 19, 1e-14);
+	}
+
+	void test_fixed_rule_smooth()
+	{
+		Integrator integrator(100);
+		double result;
+		auto decay = [](const double x[], std::size_t n_points, double values[]) {
+			for (std::size_t i = 0; i != n_points; i++) {
+				values[i] = x[i] * std::exp(-x[i]);
+			}
+		};
+		TS_ASSERT(integrator.integrate_fixed(decay, 1, 0, 5, 0, 1e-6, &result));
+		TS_ASSERT_DELTA(result, 1 - 6 * std::exp(-5.), 1e-12);
+
+		// A narrow peak is integrated badly, but that is detected
+		double width = 1e-3;
+		auto peak = [width](const double x[], std::size_t n_points, double values[]) {
+			for (std::size_t i = 0; i != n_points; i++) {
+				values[i] = 1 / (width * width + x[i] * x[i]);
+			}
+		};
+		TS_ASSERT(!integrator.integrate_fixed(peak, 1, -1, 2, 0, 0.05, &result));
+	}
+
+	void test_thread_integrator()
+	{
+		Integrator &integrator = thread_integrator(100);
+		TS_ASSERT_EQUALS(&integrator, &thread_integrator(100));
+		TS_ASSERT_EQUALS(integrator.get_max_intervals(), 100);
+		TS_ASSERT_DIFFERS(&integrator, &thread_integrator(200));
+		TS_ASSERT_EQUALS(thread_integrator(200).get_max_intervals(), 200);
+
+		Integrator *other_thread_integrator = nullptr;
+		std::thread other_thread([&other_thread_integrator]() {
+			other_thread_integrator = &thread_integrator(100);
+		});
+		other_thread.join();
+		TS_ASSERT_DIFFERS(&integrator, other_thread_integrator);
+	}
+};
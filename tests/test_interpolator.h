@@ -0,0 +1,107 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "interpolator.h"
+
+using namespace shark;
+
+namespace {
+
+// Bilinear functions are reproduced exactly by bilinear interpolation
+double bilinear(double x, double y)
+{
+	return 1 + 2 * x - 3 * y + 0.5 * x * y;
+}
+
+GridInterpolator create_interpolator(const std::vector<double> &xs, const std::vector<double> &ys)
+{
+	std::vector<double> zs;
+	for (auto y: ys) {
+		for (auto x: xs) {
+			zs.push_back(bilinear(x, y));
+		}
+	}
+	return GridInterpolator(xs, ys, zs);
+}
+
+}  // namespace
+
+class TestGridInterpolator : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_uniform_and_uneven_axes()
+	{
+		std::vector<double> xs;
+		for (int i = 0; i != 91; i++) {
+			xs.push_back(4 + i * 0.05);
+		}
+		std::vector<double> ys {0, 1e-4, 1e-3, 0.004, 0.0127, 0.02, 0.05};
+		auto interpolator = create_interpolator(xs, ys);
+
+		for (double x = 4; x <= 8.5; x += 0.0123) {
+			for (double y = 0; y <= 0.05; y += 0.00037) {
+				TS_ASSERT_DELTA(interpolator.get(x, y), bilinear(x, y), 1e-12);
+			}
+		}
+
+		// Exactly on the nodes, including the last ones
+		for (auto x: xs) {
+			for (auto y: ys) {
+				TS_ASSERT_DELTA(interpolator.get(x, y), bilinear(x, y), 1e-12);
+			}
+		}
+	}
+
+	void test_truncation()
+	{
+		auto interpolator = create_interpolator({0, 1, 2}, {0, 0.5, 3});
+		TS_ASSERT_DELTA(interpolator.get(-1, -1), bilinear(0, 0), 1e-12);
+		TS_ASSERT_DELTA(interpolator.get(5, 1), bilinear(2, 1), 1e-12);
+		TS_ASSERT_DELTA(interpolator.get(1.5, 10), bilinear(1.5, 3), 1e-12);
+	}
+
+	void test_batch()
+	{
+		auto interpolator = create_interpolator({0, 1, 2, 4}, {-1, 0, 0.5, 3});
+		std::vector<double> xs {-1, 0, 0.3, 1.7, 3.9, 10};
+		std::vector<double> ys {0.1, -2, 0.49, 2.5, 3, 0};
+		std::vector<double> out(xs.size());
+		interpolator.get(xs.data(), ys.data(), out.data(), xs.size());
+		for (std::size_t i = 0; i != xs.size(); i++) {
+			TS_ASSERT_EQUALS(out[i], interpolator.get(xs[i], ys[i]));
+		}
+	}
+
+	void test_invalid_grids()
+	{
+		TS_ASSERT_THROWS(GridInterpolator({0, 1}, {0, 1}, {0, 1, 2}), invalid_argument);
+		TS_ASSERT_THROWS(GridInterpolator({0}, {0, 1}, {0, 1}), invalid_argument);
+		TS_ASSERT_THROWS(GridInterpolator({0, 2, 1}, {0, 1}, {0, 1, 2, 3, 4, 5}), invalid_argument);
+		TS_ASSERT_THROWS(GridInterpolator({0, 1, 1}, {0, 1}, {0, 1, 2, 3, 4, 5}), invalid_argument);
+	}
+};
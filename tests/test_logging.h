@@ -0,0 +1,108 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <cxxtest/TestSuite.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logging.h"
+
+using namespace shark;
+
+class TestLogging : public CxxTest::TestSuite
+{
+
+private:
+
+	/// Logs @p n messages from the same LOG_LIMITED site, returning how many
+	/// of them were formatted
+	static unsigned long log_limited(unsigned long n)
+	{
+		unsigned long formatted = 0;
+		for (unsigned long i = 0; i != n; i++) {
+			LOG_LIMITED(trace) << "message " << formatted++;
+		}
+		return formatted;
+	}
+
+public:
+
+	void setUp()
+	{
+		logging_level = ::boost::log::trivial::severity_level::fatal;
+		report_suppressed_log_messages("before test");
+	}
+
+	void tearDown()
+	{
+		logging_level = ::boost::log::trivial::severity_level::trace;
+	}
+
+	void test_disabled_levels_are_not_formatted()
+	{
+		int formatted = 0;
+		LOG(debug) << formatted++;
+		LOG_LIMITED(debug) << formatted++;
+		TS_ASSERT_EQUALS(formatted, 0);
+	}
+
+	void test_limited_messages()
+	{
+		logging_level = ::boost::log::trivial::severity_level::trace;
+		TS_ASSERT_EQUALS(log_limited(LogSite::max_messages + 5), LogSite::max_messages);
+		TS_ASSERT_EQUALS(log_limited(1), 0);
+
+		// Reporting allows the site to write messages again
+		report_suppressed_log_messages("during test");
+		TS_ASSERT_EQUALS(log_limited(LogSite::max_messages), LogSite::max_messages);
+	}
+
+	void test_limited_messages_across_threads()
+	{
+		logging_level = ::boost::log::trivial::severity_level::trace;
+		std::vector<unsigned long> formatted(4);
+		std::vector<std::thread> threads;
+		for (std::size_t i = 0; i != formatted.size(); i++) {
+			threads.emplace_back([&formatted, i]() {
+				formatted[i] = log_limited(100);
+			});
+		}
+		for (auto &t: threads) {
+			t.join();
+		}
+		unsigned long total = 0;
+		for (auto n: formatted) {
+			total += n;
+		}
+		TS_ASSERT_EQUALS(total, LogSite::max_messages);
+	}
+
+	void test_async_logging()
+	{
+		logging_level = ::boost::log::trivial::severity_level::trace;
+		AsyncLogging async_logging;
+		for (int i = 0; i != 10; i++) {
+			LOG(trace) << "asynchronous message " << i;
+		}
+		async_logging.flush();
+	}
+};
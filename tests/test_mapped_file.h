@@ -0,0 +1,69 @@
+//
+// Memory-mapped file unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cxxtest/TestSuite.h>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "mapped_file.h"
+
+using namespace shark;
+
+class TestMappedFile : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string filename = "test_mapped_file.txt";
+
+public:
+
+	void tearDown()
+	{
+		std::remove(filename.c_str());
+	}
+
+	void test_contents()
+	{
+		std::string contents = "1 2 3\n4 5 6\n";
+		std::ofstream(filename) << contents;
+		MappedFile file(filename);
+		TS_ASSERT_EQUALS(file.size(), contents.size());
+		TS_ASSERT_EQUALS(std::string(file.data(), file.size()), contents);
+	}
+
+	void test_empty_file()
+	{
+		std::ofstream f(filename);
+		f.close();
+		MappedFile file(filename);
+		TS_ASSERT_EQUALS(file.size(), 0);
+	}
+
+	void test_missing_file()
+	{
+		TS_ASSERT_THROWS(MappedFile("this_file_does_not_exist.txt"), std::runtime_error);
+	}
+
+};
@@ -0,0 +1,80 @@
+//
+// MemoryTracker unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "memory_tracker.h"
+#include "utils.h"
+
+using namespace shark;
+
+class TestMemoryTracker : public CxxTest::TestSuite
+{
+public:
+
+	void test_record()
+	{
+		MemoryTracker tracker;
+		const auto &usage = tracker.record("first phase");
+		TS_ASSERT_EQUALS(usage.phase, "first phase");
+		TS_ASSERT(usage.rss <= usage.peak_rss);
+		tracker.record("second phase");
+		TS_ASSERT_EQUALS(tracker.get_phases().size(), 2);
+		TS_ASSERT_EQUALS(tracker.get_phases()[1].phase, "second phase");
+	}
+
+	void test_budget()
+	{
+		MemoryTracker unbounded;
+		TS_ASSERT(unbounded.within_budget(std::size_t(1) << 50));
+
+		// Any running process uses more than this
+		MemoryTracker tracker(1);
+		if (peak_rss() > 0) {
+			TS_ASSERT_THROWS(tracker.record("phase"), memory_budget_exceeded);
+		}
+
+		MemoryTracker generous(std::size_t(1) << 50);
+		TS_ASSERT_THROWS_NOTHING(generous.record("phase"));
+	}
+
+	void test_projection()
+	{
+		MemoryTracker tracker;
+
+		// Nothing to extrapolate from yet
+		tracker.record("snapshot 1", 10);
+		auto peak = tracker.get_phases().back().peak_rss;
+		TS_ASSERT_EQUALS(tracker.projected_peak_rss(10), peak);
+
+		// Memory growth between snapshots is extrapolated
+		std::vector<char> allocation(64 * 1024 * 1024, 1);
+		tracker.record("snapshot 2", 9);
+		const auto &last = tracker.get_phases().back();
+		if (last.rss > tracker.get_phases().front().rss) {
+			TS_ASSERT(tracker.projected_peak_rss(9) > last.rss);
+		}
+		TS_ASSERT(tracker.projected_peak_rss(9) >= last.peak_rss);
+		TS_ASSERT_EQUALS(tracker.projected_peak_rss(0), last.peak_rss);
+		TS_ASSERT_EQUALS(allocation[0], 1);
+	}
+
+};
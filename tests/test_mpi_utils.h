@@ -0,0 +1,62 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+
+#include "exceptions.h"
+#include "mpi_utils.h"
+
+using namespace shark;
+
+class TestMPIUtils : public CxxTest::TestSuite
+{
+
+	void assert_batches(const std::vector<unsigned int> &batches, int rank, int size, const std::vector<unsigned int> &expected)
+	{
+		TS_ASSERT_EQUALS(mpi::distribute_batches(batches, rank, size), expected);
+	}
+
+public:
+
+	void test_single_process()
+	{
+		assert_batches({0, 1, 2}, 0, 1, {0, 1, 2});
+		assert_batches({}, 0, 1, {});
+	}
+
+	void test_round_robin()
+	{
+		std::vector<unsigned int> batches {10, 11, 12, 13, 14};
+		assert_batches(batches, 0, 2, {10, 12, 14});
+		assert_batches(batches, 1, 2, {11, 13});
+		assert_batches(batches, 0, 5, {10});
+		assert_batches(batches, 4, 5, {14});
+		assert_batches(batches, 5, 6, {});
+	}
+
+	void test_invalid_rank()
+	{
+		TS_ASSERT_THROWS(mpi::distribute_batches({0}, 1, 1), invalid_argument);
+		TS_ASSERT_THROWS(mpi::distribute_batches({0}, -1, 1), invalid_argument);
+		TS_ASSERT_THROWS(mpi::distribute_batches({0}, 0, 0), invalid_argument);
+	}
+};
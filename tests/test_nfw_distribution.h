@@ -0,0 +1,96 @@
+//
+// small_vector unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <vector>
+
+#include <gsl/gsl_sf_lambert.h>
+#include <cxxtest/TestSuite.h>
+
+#include "nfw_distribution.h"
+
+using namespace shark;
+
+class TestNFWDistribution : public CxxTest::TestSuite
+{
+
+private:
+
+	struct gsl_lambert_w0 {
+		void operator()(const double x[], double w[], std::size_t n) const
+		{
+			for (std::size_t i = 0; i != n; i++) {
+				w[i] = gsl_sf_lambert_W0(x[i]);
+			}
+		}
+	};
+
+	std::vector<double> uniform_values(std::size_t n)
+	{
+		std::vector<double> values(n);
+		for (std::size_t i = 0; i != n; i++) {
+			values[i] = double(i) / n;
+		}
+		return values;
+	}
+
+public:
+
+	void test_approx_lambert_w0()
+	{
+		// The whole range, including both of its ends and the vicinity of
+		// the branch point
+		const double min_x = -1 / std::exp(1.);
+		approx_lambert_w0<double> approx;
+		for (int i = 0; i <= 10000; i++) {
+			double x = min_x * (1 - i / 10000.);
+			TS_ASSERT_DELTA(approx(x), gsl_sf_lambert_W0(x), 1e-13);
+		}
+		// W0 is ill-conditioned next to the branch point
+		for (double delta: {1e-15, 1e-12, 1e-9, 1e-6, 1e-3}) {
+			double x = min_x + delta;
+			TS_ASSERT_DELTA(approx(x), gsl_sf_lambert_W0(x), 1e-13 + 1e-16 / std::sqrt(delta));
+		}
+		TS_ASSERT_EQUALS(approx(0.), 0.);
+	}
+
+	void test_quantiles()
+	{
+		for (double c: {1., 4.5, 12., 50.}) {
+			nfw_distribution<double> nfw(c);
+			auto expected = uniform_values(1000);
+			auto values = expected;
+			nfw.quantiles<gsl_lambert_w0>(expected.data(), expected.size());
+			nfw.quantiles(values.data(), values.size());
+
+			// Radii are normalised by the virial radius, and grow with the deviates
+			TS_ASSERT_EQUALS(values.front(), 0.);
+			for (std::size_t i = 0; i != values.size(); i++) {
+				TS_ASSERT_DELTA(values[i], expected[i], 1e-10);
+				TS_ASSERT_LESS_THAN_EQUALS(0., values[i]);
+				TS_ASSERT_LESS_THAN(values[i], 1.);
+				if (i > 0) {
+					TS_ASSERT_LESS_THAN(values[i - 1], values[i]);
+				}
+			}
+		}
+	}
+
+};
@@ -0,0 +1,93 @@
+//
+// Tracing unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+
+#include "numa.h"
+#include "omp_utils.h"
+
+using namespace shark;
+
+class TestNuma : public CxxTest::TestSuite
+{
+
+private:
+
+	void assert_covers(const TreeAssignment &assignment, std::size_t n_trees)
+	{
+		TS_ASSERT_EQUALS(assignment.begin(0), 0);
+		for (unsigned int t = 0; t != assignment.threads(); t++) {
+			TS_ASSERT_LESS_THAN_EQUALS(assignment.begin(t), assignment.end(t));
+		}
+		TS_ASSERT_EQUALS(assignment.end(assignment.threads() - 1), n_trees);
+	}
+
+public:
+
+	void test_even_costs()
+	{
+		TreeAssignment assignment(std::vector<std::size_t>(8, 10), 4);
+		TS_ASSERT_EQUALS(assignment.threads(), 4);
+		assert_covers(assignment, 8);
+		for (unsigned int t = 0; t != 4; t++) {
+			TS_ASSERT_EQUALS(assignment.end(t) - assignment.begin(t), 2);
+		}
+	}
+
+	void test_uneven_costs()
+	{
+		// The first tree is as expensive as all the others together
+		std::vector<std::size_t> costs {60, 10, 10, 10, 10, 10, 10};
+		TreeAssignment assignment(costs, 2);
+		assert_covers(assignment, costs.size());
+		TS_ASSERT_EQUALS(assignment.end(0), 1);
+	}
+
+	void test_more_threads_than_trees()
+	{
+		TreeAssignment assignment(std::vector<std::size_t>(2, 1), 5);
+		TS_ASSERT_EQUALS(assignment.threads(), 5);
+		assert_covers(assignment, 2);
+		std::size_t assigned = 0;
+		for (unsigned int t = 0; t != 5; t++) {
+			assigned += assignment.end(t) - assignment.begin(t);
+		}
+		TS_ASSERT_EQUALS(assigned, 2);
+	}
+
+	void test_no_trees()
+	{
+		TreeAssignment assignment(std::vector<std::size_t>(), 3);
+		assert_covers(assignment, 0);
+		TS_ASSERT(TreeAssignment().empty());
+	}
+
+	void test_per_thread()
+	{
+		std::vector<int> calls(4, 0);
+		omp_per_thread(4, [&](unsigned int t, int thread_idx) {
+			calls[t]++;
+		});
+		TS_ASSERT_EQUALS(calls, std::vector<int>(4, 1));
+	}
+
+};
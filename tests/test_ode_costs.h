@@ -0,0 +1,119 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <sstream>
+#include <string>
+
+#include <cxxtest/TestSuite.h>
+
+#include "ode_costs.h"
+
+using namespace shark;
+
+class TestODECosts : public CxxTest::TestSuite
+{
+
+private:
+
+	ODECostRecord record(unsigned long int evaluations, long long galaxy_id)
+	{
+		return ODECostRecord {evaluations, galaxy_id, false, {{1, 2, 3, 4, 5, 6, 7, 8}}, {0.5, 0.25}};
+	}
+
+public:
+
+	void test_histogram_bins()
+	{
+		TS_ASSERT_EQUALS(ODECostHistogram::bin(0), 0);
+		TS_ASSERT_EQUALS(ODECostHistogram::bin(1), 1);
+		TS_ASSERT_EQUALS(ODECostHistogram::bin(2), 2);
+		TS_ASSERT_EQUALS(ODECostHistogram::bin(3), 2);
+		TS_ASSERT_EQUALS(ODECostHistogram::bin(4), 3);
+		TS_ASSERT_EQUALS(ODECostHistogram::bin(1023), 10);
+		TS_ASSERT_EQUALS(ODECostHistogram::bin(1024), 11);
+		TS_ASSERT_EQUALS(ODECostHistogram::bin(~0UL), ODECostHistogram::n_bins - 1);
+	}
+
+	void test_histogram()
+	{
+		ODECostHistogram h1, h2;
+		std::ostringstream os;
+		os << h1;
+		TS_ASSERT_EQUALS(os.str(), "-");
+
+		h1.add(0);
+		h1.add(5);
+		h2.add(6);
+		h2.add(1);
+		h1 += h2;
+		TS_ASSERT_EQUALS(h1[0], 1);
+		TS_ASSERT_EQUALS(h1[1], 1);
+		TS_ASSERT_EQUALS(h1[3], 2);
+
+		os.str("");
+		os << h1;
+		TS_ASSERT_EQUALS(os.str(), "[0]:1 [1]:1 [4-7]:2");
+
+		h1.reset();
+		TS_ASSERT_EQUALS(h1[3], 0);
+	}
+
+	void test_ranking()
+	{
+		ODECostRanking ranking(3);
+		for (unsigned long int evaluations: {5, 1, 9, 7, 2, 8}) {
+			ranking.add(record(evaluations, evaluations * 10));
+		}
+		auto records = ranking.sorted();
+		TS_ASSERT_EQUALS(records.size(), 3);
+		TS_ASSERT_EQUALS(records[0].evaluations, 9);
+		TS_ASSERT_EQUALS(records[1].evaluations, 8);
+		TS_ASSERT_EQUALS(records[2].evaluations, 7);
+		TS_ASSERT_EQUALS(records[2].galaxy_id, 70);
+		TS_ASSERT(!ranking.accepts(7));
+		TS_ASSERT(ranking.accepts(10));
+
+		ODECostRanking other(3);
+		other.add(record(100, 1));
+		ranking += other;
+		TS_ASSERT_EQUALS(ranking.sorted()[0].galaxy_id, 1);
+		TS_ASSERT_EQUALS(ranking.sorted().size(), 3);
+
+		ranking.reset();
+		TS_ASSERT(ranking.sorted().empty());
+
+		ODECostRanking disabled;
+		TS_ASSERT(!disabled.accepts(100));
+		disabled.add(record(100, 1));
+		TS_ASSERT(disabled.sorted().empty());
+	}
+
+	void test_csv()
+	{
+		ODECostRanking ranking(2);
+		ranking.add(record(3, 40));
+		std::ostringstream os;
+		ODECostRanking::write_csv_header(os, 2);
+		ranking.write_csv(os, 12);
+		TS_ASSERT_EQUALS(os.str(),
+			"snapshot,galaxy_id,starburst,evaluations,rgas,rstar,mcoolrate,jcold_halo,delta_t,redshift,vsubh,vgal,y0,y1\n"
+			"12,40,0,3,1,2,3,4,5,6,7,8,0.5,0.25\n");
+	}
+};
@@ -0,0 +1,143 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <cxxtest/TestSuite.h>
+
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "omp_utils.h"
+
+using namespace shark;
+
+class TestOmpUtils : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_parallel_reduce()
+	{
+		for (int threads: {1, 3, 8}) {
+			auto sum = omp_parallel_reduce(1, 1001, threads, 0L,
+				[](long &total, int i, int thread_idx) { total += i; },
+				[](long &total, const long &partial) { total += partial; });
+			TS_ASSERT_EQUALS(sum, 500500);
+		}
+	}
+
+	void test_parallel_reduce_container()
+	{
+		std::vector<double> values(1000, 0.25);
+		auto sum = omp_parallel_reduce(values, 4, 0.,
+			[](double &total, double value, int thread_idx) { total += value; },
+			[](double &total, const double &partial) { total += partial; });
+		TS_ASSERT_DELTA(sum, 250, 1e-12);
+	}
+
+	void test_parallel_reduce_is_reproducible()
+	{
+		std::vector<double> values(10000);
+		for (std::size_t i = 0; i != values.size(); i++) {
+			values[i] = 1. / (i + 1);
+		}
+		auto reduce = [&values]() {
+			return omp_parallel_reduce(values, 4, 0.,
+				[](double &total, double value, int thread_idx) { total += value; },
+				[](double &total, const double &partial) { total += partial; });
+		};
+		auto first = reduce();
+		for (int i = 0; i != 10; i++) {
+			TS_ASSERT_EQUALS(first, reduce());
+		}
+	}
+
+	void test_prefix_sum()
+	{
+		for (std::size_t n: {0, 1, 5, 17, 1000}) {
+			for (int threads: {1, 2, 3, 8}) {
+				std::vector<std::size_t> values(n), expected(n);
+				std::iota(values.begin(), values.end(), 1);
+				std::partial_sum(values.begin(), values.end(), expected.begin());
+				auto total = omp_prefix_sum(values, threads);
+				TS_ASSERT_EQUALS(values, expected);
+				TS_ASSERT_EQUALS(total, n * (n + 1) / 2);
+			}
+		}
+	}
+
+	void test_task_group()
+	{
+		std::vector<int> results(100, 0);
+		omp_task_region(4, [&results]() {
+			omp_task_group tasks;
+			for (std::size_t i = 0; i != results.size(); i++) {
+				tasks.run([&results, i](int thread_idx) {
+					results[i] = int(i);
+				});
+			}
+			tasks.wait();
+		});
+		for (std::size_t i = 0; i != results.size(); i++) {
+			TS_ASSERT_EQUALS(results[i], int(i));
+		}
+	}
+
+	void test_nested_task_groups()
+	{
+		std::atomic<int> count {0};
+		omp_task_region(4, [&count]() {
+			omp_task_group outer;
+			for (int i = 0; i != 10; i++) {
+				outer.run([&count](int thread_idx) {
+					omp_task_group inner;
+					for (int j = 0; j != 10; j++) {
+						inner.run([&count](int thread_idx) {
+							count++;
+						});
+					}
+					inner.wait();
+				});
+			}
+			outer.wait();
+		});
+		TS_ASSERT_EQUALS(count.load(), 100);
+	}
+
+	void test_task_group_errors()
+	{
+		auto run_failing_tasks = []() {
+			omp_task_region(4, []() {
+				omp_task_group tasks;
+				for (int i = 0; i != 10; i++) {
+					tasks.run([i](int thread_idx) {
+						if (i == 5) {
+							throw std::runtime_error("task failed");
+						}
+					});
+				}
+				tasks.wait();
+			});
+		};
+		TS_ASSERT_THROWS(run_failing_tasks(), std::runtime_error);
+	}
+
+};
@@ -0,0 +1,96 @@
+//
+// OptionDependencies unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <limits>
+#include <map>
+#include <string>
+
+#include <cxxtest/TestSuite.h>
+
+#include "option_dependencies.h"
+
+using namespace shark;
+
+class TestOptionDependencies : public CxxTest::TestSuite {
+
+private:
+
+	Options make_options(const std::map<std::string, std::string> &overrides)
+	{
+		Options::options_t values {
+			{"execution.name_model", "base"},
+			{"reionisation.vcut", "35"},
+			{"reionisation.zcut", "10"},
+			{"agn_feedback.kappa_agn", "0.01"}
+		};
+		for (auto &option: overrides) {
+			values[option.first] = option.second;
+		}
+		return Options(values);
+	}
+
+public:
+
+	void test_no_changes()
+	{
+		auto &dependencies = OptionDependencies::shark_options();
+		TS_ASSERT(dependencies.changes(make_options({}), make_options({})).empty());
+	}
+
+	void test_changes()
+	{
+		auto &dependencies = OptionDependencies::shark_options();
+		auto before = make_options({});
+		auto after = make_options({
+			{"execution.name_model", "branch"},
+			{"reionisation.vcut", "40"},
+			{"agn_feedback.kappa_agn", "0.02"},
+			{"execution.seed", "1"}
+		});
+
+		auto changes = dependencies.changes(before, after);
+		TS_ASSERT_EQUALS(4, changes.size());
+		TS_ASSERT(changes["execution.name_model"] < 0);
+		TS_ASSERT_EQUALS(10, changes["reionisation.vcut"]);
+		TS_ASSERT_EQUALS(std::numeric_limits<double>::infinity(), changes["agn_feedback.kappa_agn"]);
+		TS_ASSERT_EQUALS(std::numeric_limits<double>::infinity(), changes["execution.seed"]);
+
+		// Either value of zcut can make a difference
+		changes = dependencies.changes(before, make_options({{"reionisation.zcut", "6"}}));
+		TS_ASSERT_EQUALS(10, changes["reionisation.zcut"]);
+		changes = dependencies.changes(before, make_options({{"reionisation.zcut", "12"}}));
+		TS_ASSERT_EQUALS(12, changes["reionisation.zcut"]);
+	}
+
+	void test_custom_declarations()
+	{
+		OptionDependencies dependencies;
+		dependencies.never("group.output");
+		dependencies.acts_below("group.late", [](const Options &) { return 2.; });
+		auto changes = dependencies.changes(Options(), make_options({}));
+		TS_ASSERT_EQUALS(4, changes.size());
+
+		changes = dependencies.changes(Options({{"group.output", "a"}, {"group.late", "1"}}), Options({{"group.output", "b"}, {"group.late", "2"}}));
+		TS_ASSERT(changes["group.output"] < 0);
+		TS_ASSERT_EQUALS(2, changes["group.late"]);
+	}
+};
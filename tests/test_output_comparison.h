@@ -0,0 +1,201 @@
+//
+// Output comparison unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include <boost/filesystem.hpp>
+#include "hdf5/writer.h"
+#include "output_comparison.h"
+
+using namespace shark;
+namespace fs = boost::filesystem;
+
+class TestOutputComparison : public CxxTest::TestSuite {
+
+private:
+	const std::vector<std::int64_t> ids {10, 20, 30, 40};
+	const std::vector<double> masses {1e10, 2e10, 3e10, 4e10};
+	const std::vector<float> sizes {0.1f, 0.2f, 0.3f, 0.4f};
+
+	/// Writes a galaxies file like those of shark, without its run_info
+	void write_galaxies(const std::string &filename, const std::vector<double> &mstars, const std::vector<float> &rstars)
+	{
+		fs::create_directories(fs::path(filename).parent_path());
+		hdf5::Writer writer(filename);
+		writer.write_dataset("run_info/effective_seed", 1);
+		writer.write_dataset("galaxies/id_galaxy", ids);
+		writer.write_dataset("galaxies/mstars_disk", mstars);
+		writer.write_dataset("galaxies/rstar_disk", rstars);
+	}
+
+	void write_galaxies(const std::string &filename)
+	{
+		write_galaxies(filename, masses, sizes);
+	}
+
+	OutputComparison compare(const OutputComparisonParameters &params = OutputComparisonParameters())
+	{
+		return OutputComparison("reference", "other", params);
+	}
+
+	OutputComparison compare_files(const OutputComparisonParameters &params = OutputComparisonParameters())
+	{
+		return OutputComparison("reference/199/0/galaxies.hdf5", "other/199/0/galaxies.hdf5", params);
+	}
+
+public:
+
+	virtual void tearDown() {
+		fs::remove_all("reference");
+		fs::remove_all("other");
+	}
+
+	void test_equal_outputs()
+	{
+		write_galaxies("reference/199/0/galaxies.hdf5");
+		write_galaxies("reference/199/1/galaxies.hdf5");
+		write_galaxies("other/199/0/galaxies.hdf5");
+		write_galaxies("other/199/1/galaxies.hdf5");
+
+		for (unsigned int threads: {1, 2}) {
+			OutputComparisonParameters params;
+			params.threads = threads;
+			auto comparison = compare(params);
+			TS_ASSERT(comparison.equal());
+			TS_ASSERT_EQUALS(2, comparison.get_compared_files());
+			TS_ASSERT(comparison.get_missing().empty());
+			TS_ASSERT(comparison.get_galaxies().empty());
+
+			// run_info is excluded by the tool, not by default
+			auto &properties = comparison.get_properties();
+			TS_ASSERT_EQUALS(4, properties.size());
+			TS_ASSERT_EQUALS("galaxies/id_galaxy", properties[0].name);
+			TS_ASSERT_EQUALS(2, properties[0].files);
+			TS_ASSERT_EQUALS(8, properties[0].values);
+		}
+	}
+
+	void test_single_files()
+	{
+		write_galaxies("reference/199/0/galaxies.hdf5");
+		write_galaxies("other/199/0/galaxies.hdf5");
+		auto comparison = compare_files();
+		TS_ASSERT(comparison.equal());
+		TS_ASSERT_EQUALS(1, comparison.get_compared_files());
+	}
+
+	void test_differences_and_tolerances()
+	{
+		auto other_masses = masses;
+		other_masses[1] *= 1.001;
+		auto other_sizes = sizes;
+		other_sizes[1] *= 1.1f;
+		other_sizes[3] *= 1.1f;
+		write_galaxies("reference/199/0/galaxies.hdf5");
+		write_galaxies("other/199/0/galaxies.hdf5", other_masses, other_sizes);
+
+		auto comparison = compare_files();
+		TS_ASSERT(!comparison.equal());
+		auto &properties = comparison.get_properties();
+		TS_ASSERT_EQUALS(4, properties.size());
+		TS_ASSERT_EQUALS("galaxies/mstars_disk", properties[1].name);
+		TS_ASSERT_EQUALS(1, properties[1].differing_values);
+		TS_ASSERT_DELTA(2e7, properties[1].max_absolute_difference, 1);
+		TS_ASSERT_EQUALS("galaxies/rstar_disk", properties[2].name);
+		TS_ASSERT_EQUALS(2, properties[2].differing_values);
+
+		// Galaxy 20 has both properties different
+		auto &galaxies = comparison.get_galaxies();
+		TS_ASSERT_EQUALS(2, galaxies.size());
+		TS_ASSERT_EQUALS(20, galaxies[0].id_galaxy);
+		TS_ASSERT_EQUALS(2, galaxies[0].differing_properties);
+		TS_ASSERT_EQUALS(40, galaxies[1].id_galaxy);
+		TS_ASSERT_EQUALS(1, galaxies[1].differing_properties);
+
+		// Only the masses are within a relative tolerance of 1%...
+		OutputComparisonParameters params;
+		params.relative_tolerance = 0.01;
+		comparison = compare_files(params);
+		TS_ASSERT(!comparison.equal());
+		TS_ASSERT_EQUALS(0, comparison.get_properties()[1].differing_values);
+
+		// ... but sizes can have their own
+		params.tolerances.push_back(ComparisonTolerance {"galaxies/rstar_.*", 0, 0.2});
+		comparison = compare_files(params);
+		TS_ASSERT(comparison.equal());
+
+		// And can be ignored altogether
+		params.tolerances.clear();
+		params.excluded_datasets.push_back("galaxies/rstar_.*");
+		comparison = compare_files(params);
+		TS_ASSERT(comparison.equal());
+		TS_ASSERT_EQUALS(3, comparison.get_properties().size());
+	}
+
+	void test_missing_files_and_datasets()
+	{
+		write_galaxies("reference/199/0/galaxies.hdf5");
+		write_galaxies("reference/199/1/galaxies.hdf5");
+		fs::create_directories("other/199/0");
+		{
+			hdf5::Writer writer("other/199/0/galaxies.hdf5");
+			writer.write_dataset("run_info/effective_seed", 1);
+			writer.write_dataset("galaxies/id_galaxy", ids);
+			writer.write_dataset("galaxies/mgas_disk", masses);
+			writer.write_dataset("galaxies/mstars_disk", masses);
+			writer.write_dataset("galaxies/rstar_disk", sizes);
+		}
+
+		auto comparison = compare();
+		TS_ASSERT(!comparison.equal());
+		TS_ASSERT_EQUALS(1, comparison.get_compared_files());
+		auto &missing = comparison.get_missing();
+		TS_ASSERT_EQUALS(2, missing.size());
+		TS_ASSERT_EQUALS("199/1/galaxies.hdf5", missing[0]);
+		TS_ASSERT_EQUALS("199/0/galaxies.hdf5:galaxies/mgas_disk", missing[1]);
+	}
+
+	void test_mismatched_shapes()
+	{
+		write_galaxies("reference/199/0/galaxies.hdf5");
+		write_galaxies("other/199/0/galaxies.hdf5", {1e10, 2e10, 3e10}, sizes);
+
+		auto comparison = compare_files();
+		TS_ASSERT(!comparison.equal());
+		TS_ASSERT_EQUALS(1, comparison.get_mismatched_shapes().size());
+		TS_ASSERT_EQUALS(":galaxies/mstars_disk", comparison.get_mismatched_shapes()[0]);
+
+		std::ostringstream os;
+		comparison.write(os);
+		TS_ASSERT_DIFFERS(std::string::npos, os.str().find("Different shapes: :galaxies/mstars_disk"));
+	}
+
+	void test_invalid_outputs()
+	{
+		write_galaxies("reference/199/0/galaxies.hdf5");
+		TS_ASSERT_THROWS(compare(), invalid_argument);
+	}
+};
@@ -0,0 +1,108 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "philox_engine.h"
+
+using namespace shark;
+
+class TestPhiloxEngine : public CxxTest::TestSuite
+{
+
+private:
+
+	void assert_block(std::vector<std::uint32_t> ctr, std::vector<std::uint32_t> key, std::vector<std::uint32_t> expected)
+	{
+		std::uint32_t out[4];
+		philox_engine::generate(ctr.data(), key.data(), out);
+		for (int i = 0; i != 4; i++) {
+			TS_ASSERT_EQUALS(out[i], expected[i]);
+		}
+	}
+
+public:
+
+	void test_known_answers()
+	{
+		// Known-answer vectors of the Random123 reference implementation
+		assert_block({0, 0, 0, 0}, {0, 0},
+		             {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+		assert_block({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff},
+		             {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+		assert_block({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0},
+		             {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+	}
+
+	void test_independent_of_order()
+	{
+		// Entities produce the same numbers however they are interleaved
+		philox_engine a1(1234, philox_engine::HALO_SPIN, 1, 10);
+		philox_engine b1(1234, philox_engine::HALO_SPIN, 2, 10);
+		std::vector<std::uint32_t> a_values, b_values;
+		for (int i = 0; i != 10; i++) {
+			a_values.push_back(a1());
+		}
+		for (int i = 0; i != 10; i++) {
+			b_values.push_back(b1());
+		}
+
+		philox_engine a2(1234, philox_engine::HALO_SPIN, 1, 10);
+		philox_engine b2(1234, philox_engine::HALO_SPIN, 2, 10);
+		for (int i = 0; i != 10; i++) {
+			TS_ASSERT_EQUALS(b2(), b_values[i]);
+			TS_ASSERT_EQUALS(a2(), a_values[i]);
+		}
+	}
+
+	void test_different_streams()
+	{
+		std::uint32_t seed = 1234;
+		auto first = [&](philox_engine::stream purpose, std::uint64_t id, int snapshot) {
+			return philox_engine(seed, purpose, id, snapshot)();
+		};
+		auto value = first(philox_engine::HALO_SPIN, 1, 10);
+		TS_ASSERT_DIFFERS(value, first(philox_engine::SATELLITE_ORBITS, 1, 10));
+		TS_ASSERT_DIFFERS(value, first(philox_engine::HALO_SPIN, 2, 10));
+		TS_ASSERT_DIFFERS(value, first(philox_engine::HALO_SPIN, std::uint64_t(1) << 32 | 1, 10));
+		TS_ASSERT_DIFFERS(value, first(philox_engine::HALO_SPIN, 1, 11));
+		seed = 4321;
+		TS_ASSERT_DIFFERS(value, first(philox_engine::HALO_SPIN, 1, 10));
+	}
+
+	void test_distributions()
+	{
+		philox_engine engine(1, philox_engine::HALO_SPIN, 1, 1);
+		std::uniform_real_distribution<double> flat(0, 1);
+		double sum = 0;
+		const int n = 100000;
+		for (int i = 0; i != n; i++) {
+			double x = flat(engine);
+			TS_ASSERT(x >= 0 && x < 1);
+			sum += x;
+		}
+		TS_ASSERT_DELTA(sum / n, 0.5, 0.01);
+	}
+
+};
@@ -0,0 +1,107 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "profiling.h"
+
+using namespace shark;
+
+class TestProfiling : public CxxTest::TestSuite
+{
+
+public:
+
+	void setUp()
+	{
+		profiling::reset();
+	}
+
+	void test_calls_and_time_are_recorded()
+	{
+		for (int i = 0; i != 3; i++) {
+			profiling::scoped_timer timer(profiling::GAS_COOLING);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		auto totals = profiling::collect();
+		TS_ASSERT_EQUALS(totals.size(), std::size_t(profiling::N_REGIONS));
+		TS_ASSERT_EQUALS(totals[profiling::GAS_COOLING].calls, 3);
+		TS_ASSERT_LESS_THAN_EQUALS(14, totals[profiling::GAS_COOLING].millis);
+		TS_ASSERT_EQUALS(totals[profiling::ODE_SOLVER].calls, 0);
+		TS_ASSERT_EQUALS(totals[profiling::ODE_SOLVER].millis, 0);
+	}
+
+	void test_nested_regions()
+	{
+		{
+			profiling::scoped_timer outer(profiling::GALAXY_MERGERS);
+			profiling::scoped_timer inner(profiling::ODE_SOLVER);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		auto totals = profiling::collect();
+		TS_ASSERT_EQUALS(totals[profiling::GALAXY_MERGERS].calls, 1);
+		TS_ASSERT_EQUALS(totals[profiling::ODE_SOLVER].calls, 1);
+		TS_ASSERT_LESS_THAN_EQUALS(totals[profiling::ODE_SOLVER].millis, totals[profiling::GALAXY_MERGERS].millis);
+	}
+
+	void test_threads_are_aggregated()
+	{
+		std::vector<std::thread> threads;
+		for (int t = 0; t != 4; t++) {
+			threads.emplace_back([]() {
+				for (int i = 0; i != 1000; i++) {
+					profiling::scoped_timer timer(profiling::STAR_FORMATION);
+				}
+			});
+		}
+		for (auto &thread: threads) {
+			thread.join();
+		}
+		TS_ASSERT_EQUALS(profiling::collect()[profiling::STAR_FORMATION].calls, 4000);
+	}
+
+	void test_reset()
+	{
+		{
+			profiling::scoped_timer timer(profiling::DISK_INSTABILITY);
+		}
+		TS_ASSERT_EQUALS(profiling::collect()[profiling::DISK_INSTABILITY].calls, 1);
+		profiling::reset();
+		TS_ASSERT_EQUALS(profiling::collect()[profiling::DISK_INSTABILITY].calls, 0);
+	}
+
+	void test_table()
+	{
+		{
+			profiling::scoped_timer timer(profiling::MOLECULAR_GAS);
+		}
+		std::ostringstream os;
+		profiling::write_table(os, profiling::collect(), 100);
+		auto table = os.str();
+		for (int region = 0; region != profiling::N_REGIONS; region++) {
+			TS_ASSERT_DIFFERS(table.find(profiling::region_name(profiling::region_t(region))), std::string::npos);
+		}
+	}
+};
@@ -0,0 +1,102 @@
+//
+// Radix sort unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "radix_sort.h"
+
+using namespace shark;
+
+class TestRadixSort : public CxxTest::TestSuite
+{
+private:
+
+	void assert_sorts(const std::vector<std::int64_t> &keys, unsigned int threads)
+	{
+		std::vector<std::size_t> expected_order(keys.size());
+		std::iota(expected_order.begin(), expected_order.end(), 0);
+		std::stable_sort(expected_order.begin(), expected_order.end(), [&](std::size_t lhs, std::size_t rhs) {
+			return keys[lhs] < keys[rhs];
+		});
+
+		auto sorted_keys = keys;
+		auto order = radix_sort(sorted_keys, threads);
+		TS_ASSERT_EQUALS(order, expected_order);
+		TS_ASSERT(std::is_sorted(sorted_keys.begin(), sorted_keys.end()));
+		for (std::size_t i = 0; i != keys.size(); i++) {
+			TS_ASSERT_EQUALS(sorted_keys[i], keys[order[i]]);
+		}
+	}
+
+	void assert_sorts(const std::vector<std::int64_t> &keys)
+	{
+		for (unsigned int threads: {1, 3, 8}) {
+			assert_sorts(keys, threads);
+		}
+	}
+
+public:
+
+	void test_empty_and_single()
+	{
+		assert_sorts({});
+		assert_sorts({5});
+		assert_sorts({-5});
+	}
+
+	void test_equal_keys()
+	{
+		assert_sorts(std::vector<std::int64_t>(100, 42));
+	}
+
+	void test_extreme_keys()
+	{
+		auto min = std::numeric_limits<std::int64_t>::min();
+		auto max = std::numeric_limits<std::int64_t>::max();
+		assert_sorts({max, 0, min, -1, 1, min, max});
+	}
+
+	void test_random_keys()
+	{
+		std::mt19937_64 engine(1234);
+
+		// Wide range, so all passes are needed
+		std::vector<std::int64_t> keys(10000);
+		for (auto &key: keys) {
+			key = std::int64_t(engine());
+		}
+		assert_sorts(keys);
+
+		// Halo-like ids: snapshot-prefixed, with many repeated values
+		std::uniform_int_distribution<std::int64_t> snapshot(0, 199), halo(0, 999);
+		for (auto &key: keys) {
+			key = snapshot(engine) * 1000000000000LL + halo(engine);
+		}
+		assert_sorts(keys);
+	}
+
+};
@@ -0,0 +1,77 @@
+//
+// Tracing unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include <sstream>
+
+#include "exceptions.h"
+#include "resource_estimator.h"
+
+using namespace shark;
+
+class TestResourceEstimator : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_calibration()
+	{
+		// Two snapshots evolved with two threads
+		std::istringstream metrics(
+			"snapshot,redshift,n_halos,n_subhalos,n_galaxies,total_time,peak_rss,busy_time_thread_0,busy_time_thread_1\n"
+			"100,1.5,10,100,200,500,1000000,400,500\n"
+			"101,1.4,10,300,400,1000,3000000,900,1000\n");
+		auto costs = ResourceCosts::calibrate(metrics);
+		TS_ASSERT_DELTA(costs.bytes_per_subhalo, 7500., 1e-9);
+		TS_ASSERT_DELTA(costs.base_bytes, 0., 1e-9);
+		TS_ASSERT_DELTA(costs.galaxies_per_subhalo, 1.5, 1e-9);
+		TS_ASSERT_DELTA(costs.evolution_micros_per_galaxy, 5000., 1e-9);
+		TS_ASSERT_DELTA(costs.import_micros_per_subhalo, ResourceCosts().import_micros_per_subhalo, 1e-9);
+	}
+
+	void test_calibration_sub_millisecond_snapshots()
+	{
+		// Short snapshots have fractional total times
+		std::istringstream metrics(
+			"snapshot,n_subhalos,n_galaxies,total_time,peak_rss,busy_time_thread_0,busy_time_thread_1\n"
+			"100,100,200,0.250,1000000,0.200,0.250\n"
+			"101,300,400,0.500,3000000,0.450,0.500\n");
+		auto costs = ResourceCosts::calibrate(metrics);
+		TS_ASSERT_DELTA(costs.evolution_micros_per_galaxy, 2.5, 1e-9);
+	}
+
+	void test_calibration_errors()
+	{
+		std::istringstream no_column("snapshot,n_subhalos,total_time,peak_rss\n100,10,5,100\n");
+		TS_ASSERT_THROWS(ResourceCosts::calibrate(no_column), invalid_data);
+
+		std::istringstream no_rows("snapshot,n_subhalos,n_galaxies,total_time,peak_rss\n");
+		TS_ASSERT_THROWS(ResourceCosts::calibrate(no_rows), invalid_data);
+	}
+
+	void test_csv()
+	{
+		std::ostringstream os;
+		ResourceEstimator::write_csv(os, {{3, 1000, 2048, 1.5, 60}});
+		TS_ASSERT_EQUALS(os.str(), "batch,subhalos,peak_memory,import_time,evolution_time\n3,1000,2048,1.5,60.0\n");
+	}
+
+};
@@ -0,0 +1,50 @@
+//
+// C interface unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <string>
+
+#include <cxxtest/TestSuite.h>
+
+#include "shark_c.h"
+
+class TestSharkC : public CxxTest::TestSuite {
+
+public:
+
+	void test_missing_config_file()
+	{
+		const char *config_files[] = {"this_file_does_not_exist.txt"};
+		TS_ASSERT(shark_session_create(config_files, 1, 1) == nullptr);
+		TS_ASSERT_DIFFERS(std::string(), shark_last_error());
+	}
+
+	void test_null_session()
+	{
+		TS_ASSERT_EQUALS(-1, shark_session_set_option(nullptr, "execution.seed = 1"));
+		TS_ASSERT_EQUALS(std::string("session is NULL"), shark_last_error());
+		TS_ASSERT_EQUALS(-1, shark_session_reset_options(nullptr));
+		TS_ASSERT_EQUALS(-1, shark_session_run(nullptr));
+		double value;
+		TS_ASSERT_EQUALS(-1, shark_session_get_statistic(nullptr, 199, "sfr_density", &value, 1, nullptr));
+		shark_session_destroy(nullptr);
+	}
+};
@@ -0,0 +1,118 @@
+//
+// small_vector unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "small_vector.h"
+
+using namespace shark;
+
+class TestSmallVector : public CxxTest::TestSuite
+{
+private:
+	typedef small_vector<std::shared_ptr<int>, 2> ptr_vector;
+
+	template <typename V>
+	void _assert_contents(const V &v, const std::vector<int> &expected)
+	{
+		TS_ASSERT_EQUALS(v.size(), expected.size());
+		for (std::size_t i = 0; i != expected.size(); i++) {
+			TS_ASSERT_EQUALS(*v[i], expected[i]);
+		}
+	}
+
+	ptr_vector make_vector(int n)
+	{
+		ptr_vector v;
+		for (int i = 0; i != n; i++) {
+			v.push_back(std::make_shared<int>(i));
+		}
+		return v;
+	}
+
+public:
+
+	void test_inline_and_heap_storage()
+	{
+		auto v = make_vector(2);
+		TS_ASSERT(v.is_inline());
+		TS_ASSERT_EQUALS(v.capacity(), 2);
+		_assert_contents(v, {0, 1});
+
+		v.push_back(std::make_shared<int>(2));
+		TS_ASSERT(!v.is_inline());
+		TS_ASSERT(v.capacity() >= 3);
+		_assert_contents(v, {0, 1, 2});
+
+		v.clear();
+		TS_ASSERT(v.empty());
+	}
+
+	void test_copy_and_move()
+	{
+		for (int n: {1, 3}) {
+			auto v = make_vector(n);
+			auto copy = v;
+			TS_ASSERT_EQUALS(copy.size(), v.size());
+			TS_ASSERT_EQUALS(copy[0], v[0]);
+
+			auto moved = std::move(v);
+			TS_ASSERT(v.empty());
+			TS_ASSERT_EQUALS(moved.size(), copy.size());
+			TS_ASSERT_EQUALS(moved[0].use_count(), 2);
+
+			copy = std::move(moved);
+			TS_ASSERT_EQUALS(copy[0].use_count(), 1);
+		}
+	}
+
+	void test_insert_and_erase()
+	{
+		small_vector<std::string, 1> v {"a", "d"};
+		std::vector<std::string> middle {"b", "c"};
+		v.insert(v.begin() + 1, middle.begin(), middle.end());
+		TS_ASSERT_EQUALS(v.size(), 4);
+		TS_ASSERT_EQUALS(v[1], "b");
+		TS_ASSERT_EQUALS(v.back(), "d");
+
+		auto it = v.erase(v.begin());
+		TS_ASSERT_EQUALS(*it, "b");
+		v.erase(v.begin() + 1, v.end());
+		TS_ASSERT_EQUALS(v.size(), 1);
+		TS_ASSERT_EQUALS(v.front(), "b");
+	}
+
+	void test_elements_released()
+	{
+		auto value = std::make_shared<int>(0);
+		{
+			ptr_vector v {value, value, value};
+			TS_ASSERT_EQUALS(value.use_count(), 4);
+			v.pop_back();
+			TS_ASSERT_EQUALS(value.use_count(), 3);
+		}
+		TS_ASSERT_EQUALS(value.use_count(), 1);
+	}
+
+};
@@ -0,0 +1,101 @@
+//
+// SpatialSelection unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "spatial_selection.h"
+
+using namespace shark;
+
+class TestSpatialSelection : public CxxTest::TestSuite
+{
+
+private:
+
+	// Two trees with roots in snapshot 2: 201 at (1, 1, 1), with progenitors
+	// 101 and 103 (and 11 before that) and descendant 301, and 202 at
+	// (50, 50, 50), with progenitor 102 and descendant 302. The second row of
+	// 201 lies far away, but only the first one positions the halo
+	const std::vector<int> snapshots {1, 1, 1, 2, 2, 2, 3, 3, 0};
+	const std::vector<Halo::id_t> host_halos {101, 102, 103, 201, 201, 202, 301, 302, 11};
+	const std::vector<Halo::id_t> descendant_halos {201, 202, 201, 301, 301, 302, -1, -1, 101};
+	const std::vector<float> root_positions {1, 1, 1, 50, 50, 50, 50, 50, 50};
+
+	std::vector<std::size_t> tree_rows(const SpatialSelection &selection)
+	{
+		return selection.tree_rows(snapshots, host_halos, descendant_halos, root_positions, 2);
+	}
+
+public:
+
+	void test_box()
+	{
+		SpatialSelection box(SpatialSelection::BOX, {0, 0, 0, 10, 20, 30});
+		TS_ASSERT(box.enabled());
+		TS_ASSERT(box.contains(0, 0, 0));
+		TS_ASSERT(box.contains(9.9, 19.9, 29.9));
+		TS_ASSERT(!box.contains(10, 5, 5));
+		TS_ASSERT(!box.contains(5, 5, -0.1));
+
+		TS_ASSERT_THROWS(SpatialSelection(SpatialSelection::BOX, {0, 0, 0, 10, 20}), invalid_argument);
+		TS_ASSERT_THROWS(SpatialSelection(SpatialSelection::BOX, {0, 0, 0, 10, 0, 30}), invalid_argument);
+	}
+
+	void test_sphere()
+	{
+		SpatialSelection sphere(SpatialSelection::SPHERE, {50, 50, 50, 10});
+		TS_ASSERT(sphere.contains(50, 50, 50));
+		TS_ASSERT(sphere.contains(55, 55, 55));
+		TS_ASSERT(!sphere.contains(60, 50, 50));
+		TS_ASSERT(!sphere.contains(0, 0, 0));
+
+		TS_ASSERT_THROWS(SpatialSelection(SpatialSelection::SPHERE, {50, 50, 50}), invalid_argument);
+		TS_ASSERT_THROWS(SpatialSelection(SpatialSelection::SPHERE, {50, 50, 50, -1}), invalid_argument);
+	}
+
+	void test_none()
+	{
+		SpatialSelection everywhere;
+		TS_ASSERT(!everywhere.enabled());
+		TS_ASSERT(everywhere.contains(-1e6, 0, 1e6));
+		TS_ASSERT_EQUALS(tree_rows(everywhere), (std::vector<std::size_t> {0, 1, 2, 3, 4, 5, 6, 7, 8}));
+	}
+
+	void test_tree_rows()
+	{
+		SpatialSelection box(SpatialSelection::BOX, {0, 0, 0, 10, 10, 10});
+		TS_ASSERT_EQUALS(tree_rows(box), (std::vector<std::size_t> {0, 2, 3, 4, 6, 8}));
+
+		SpatialSelection sphere(SpatialSelection::SPHERE, {50, 50, 50, 1});
+		TS_ASSERT_EQUALS(tree_rows(sphere), (std::vector<std::size_t> {1, 5, 7}));
+
+		SpatialSelection empty(SpatialSelection::SPHERE, {-50, -50, -50, 1});
+		TS_ASSERT(tree_rows(empty).empty());
+
+		// Root positions must be given for all rows of the root snapshot
+		TS_ASSERT_THROWS(box.tree_rows(snapshots, host_halos, descendant_halos, {1, 1, 1}, 2), invalid_argument);
+		TS_ASSERT_THROWS(box.tree_rows(snapshots, host_halos, {201}, root_positions, 2), invalid_argument);
+	}
+
+};
@@ -0,0 +1,105 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "star_formation_table.h"
+
+using namespace shark;
+
+class TestStarFormationTable : public CxxTest::TestSuite
+{
+
+private:
+
+	// Power laws are linear in log space, so they are interpolated exactly
+	static void power_laws(const std::vector<double> &coords, double &i0, double &i1)
+	{
+		i0 = std::pow(10., 2 * coords[0] - coords[1]);
+		i1 = std::pow(10., coords[0] + 3 * coords[1]);
+	}
+
+public:
+
+	void test_power_laws()
+	{
+		StarFormationTable table({{0, 2, 5}, {-1, 1, 3}}, power_laws);
+		TS_ASSERT_EQUALS(table.size(), 15);
+
+		double i0, i1;
+		for (double x: {0., 0.3, 1.1, 2.}) {
+			for (double y: {-1., -0.2, 0.7, 1.}) {
+				TS_ASSERT(table.get({x, y}, i0, i1));
+				TS_ASSERT_DELTA(i0, std::pow(10., 2 * x - y), 1e-10 * i0);
+				TS_ASSERT_DELTA(i1, std::pow(10., x + 3 * y), 1e-10 * i1);
+			}
+		}
+		TS_ASSERT_DELTA(table.max_relative_error(power_laws, 100), 0, 1e-10);
+	}
+
+	void test_out_of_range()
+	{
+		StarFormationTable table({{0, 2, 5}, {-1, 1, 3}}, power_laws);
+		double i0 = -1, i1 = -1;
+		TS_ASSERT(!table.get({-0.1, 0}, i0, i1));
+		TS_ASSERT(!table.get({1, 1.1}, i0, i1));
+		TS_ASSERT(!table.get({NAN, 0}, i0, i1));
+		TS_ASSERT_EQUALS(i0, -1);
+		TS_ASSERT_EQUALS(i1, -1);
+	}
+
+	void test_non_positive_values()
+	{
+		auto integrals = [](const std::vector<double> &coords, double &i0, double &i1) {
+			i0 = coords[0] < 1 ? 0 : 1;
+			i1 = 1;
+		};
+		StarFormationTable table({{0, 2, 3}}, integrals);
+		double i0, i1;
+		TS_ASSERT(!table.get({0.5}, i0, i1));
+		TS_ASSERT(table.get({1.5}, i0, i1));
+		TS_ASSERT_DELTA(i0, 1, 1e-10);
+	}
+
+	void test_interpolation_error()
+	{
+		auto integrals = [](const std::vector<double> &coords, double &i0, double &i1) {
+			i0 = i1 = 1 + std::pow(10., coords[0]);
+		};
+		StarFormationTable coarse({{0, 4, 3}}, integrals);
+		StarFormationTable fine({{0, 4, 41}}, integrals);
+		auto coarse_error = coarse.max_relative_error(integrals, 100);
+		auto fine_error = fine.max_relative_error(integrals, 100);
+		TS_ASSERT_LESS_THAN(0, fine_error);
+		TS_ASSERT_LESS_THAN(fine_error, coarse_error);
+	}
+
+	void test_invalid_axes()
+	{
+		TS_ASSERT_THROWS(StarFormationTable({}, power_laws), invalid_argument);
+		TS_ASSERT_THROWS(StarFormationTable({{0, 1, 1}}, power_laws), invalid_argument);
+		TS_ASSERT_THROWS(StarFormationTable({{1, 0, 2}}, power_laws), invalid_argument);
+		TS_ASSERT_THROWS(StarFormationTable({{0, 1, 2}, {0, 1, 2}, {0, 1, 2}, {0, 1, 2}}, power_laws), invalid_argument);
+	}
+};
@@ -0,0 +1,144 @@
+//
+// StatusFile unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "status_file.h"
+
+using namespace shark;
+
+class TestStatusFile : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string filename = "test_status_file.json";
+
+	boost::property_tree::ptree read_status()
+	{
+		boost::property_tree::ptree status;
+		boost::property_tree::read_json(filename, status);
+		return status;
+	}
+
+public:
+
+	void tearDown()
+	{
+		std::remove(filename.c_str());
+	}
+
+	void test_initial_status()
+	{
+		StatusFile status_file(filename, "my_model", 1);
+		auto status = read_status();
+		TS_ASSERT_EQUALS(status.get<std::string>("model"), "my_model");
+		TS_ASSERT_EQUALS(status.get<std::string>("phase"), "starting");
+		TS_ASSERT_EQUALS(status.get<std::string>("snapshot"), "null");
+		TS_ASSERT_EQUALS(status.get<std::string>("eta_seconds"), "null");
+		TS_ASSERT(!std::ifstream(filename + ".tmp"));
+
+		TS_ASSERT_THROWS(StatusFile("non_existing_directory/status.json", "my_model", 1), exception);
+	}
+
+	void test_progress()
+	{
+		StatusFile status_file(filename, "my_model", 1);
+		status_file.start_batch_group(0);
+		status_file.set_group_snapshots(10);
+		status_file.phase("evolve", 5);
+		TS_ASSERT_EQUALS(read_status().get<std::string>("phase"), "evolve");
+		TS_ASSERT_EQUALS(read_status().get<int>("snapshot"), 5);
+
+		status_file.snapshot_evolved(5, 3000, 1500, 42, 100, 200);
+		auto status = read_status();
+		TS_ASSERT_DELTA(status.get<double>("galaxies_per_second"), 2000, 1e-6);
+		TS_ASSERT_EQUALS(status.get<unsigned long>("ode_evaluations"), 42);
+		TS_ASSERT_EQUALS(status.get<std::size_t>("rss"), 100);
+		TS_ASSERT_EQUALS(status.get<std::size_t>("peak_rss"), 200);
+		TS_ASSERT_EQUALS(status.get<int>("snapshots_evolved"), 1);
+		TS_ASSERT_EQUALS(status.get<int>("snapshots_total"), 10);
+
+		status_file.finish();
+		status = read_status();
+		TS_ASSERT_EQUALS(status.get<std::string>("phase"), "finished");
+		TS_ASSERT_DELTA(status.get<double>("eta_seconds"), 0, 1e-6);
+	}
+
+	void test_eta()
+	{
+		StatusFile status_file(filename, "my_model", 1);
+		status_file.set_group_snapshots(5);
+		TS_ASSERT(status_file.eta_seconds() < 0);
+
+		// A constant cost is extrapolated as it is...
+		status_file.snapshot_evolved(0, 10, 1000, 0, 0, 0);
+		TS_ASSERT_DELTA(status_file.eta_seconds(), 4, 1e-6);
+
+		// ...and a growing one along its trend
+		status_file.snapshot_evolved(1, 10, 2000, 0, 0, 0);
+		status_file.snapshot_evolved(2, 10, 3000, 0, 0, 0);
+		TS_ASSERT_DELTA(status_file.eta_seconds(), 4 + 5, 1e-6);
+		TS_ASSERT_DELTA(read_status().get<double>("eta_seconds"), 9, 1e-6);
+	}
+
+	void test_eta_trend_window()
+	{
+		// Only the last snapshots count, early outliers are forgotten
+		StatusFile status_file(filename, "my_model", 1);
+		auto n = StatusFile::trend_snapshots;
+		status_file.set_group_snapshots(int(n + 4));
+		status_file.snapshot_evolved(0, 10, 100000, 0, 0, 0);
+		status_file.snapshot_evolved(1, 10, 100000, 0, 0, 0);
+		for (std::size_t i = 2; i != n + 2; i++) {
+			status_file.snapshot_evolved(int(i), 10, 1000, 0, 0, 0);
+		}
+		TS_ASSERT_DELTA(status_file.eta_seconds(), 2, 1e-6);
+	}
+
+	void test_eta_batch_groups()
+	{
+		// Later batch groups are expected to take as long as the current one
+		StatusFile status_file(filename, "my_model", 3);
+		status_file.start_batch_group(0);
+		status_file.set_group_snapshots(4);
+		status_file.snapshot_evolved(0, 10, 1000, 0, 0, 0);
+		status_file.snapshot_evolved(1, 10, 1000, 0, 0, 0);
+		TS_ASSERT_DELTA(status_file.eta_seconds(), 2 + 2 * 2, 0.5);
+
+		// ...or as long as the earlier ones took
+		status_file.start_batch_group(1);
+		TS_ASSERT_DELTA(status_file.eta_seconds(), 0, 0.5);
+		auto status = read_status();
+		TS_ASSERT_EQUALS(status.get<int>("batch_group"), 1);
+		TS_ASSERT_EQUALS(status.get<int>("batch_groups"), 3);
+		TS_ASSERT_EQUALS(status.get<int>("snapshots_evolved"), 0);
+	}
+
+};
@@ -0,0 +1,114 @@
+//
+// SummaryStatistics unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cmath>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "summary_statistics.h"
+
+using namespace shark;
+
+class TestSummaryStatistics : public CxxTest::TestSuite {
+
+private:
+
+	Galaxy make_galaxy(double mdisk, double rdisk, double mbulge, double rbulge, double sfr)
+	{
+		Galaxy galaxy(0);
+		galaxy.disk_stars.mass = mdisk;
+		galaxy.disk_stars.rscale = rdisk;
+		galaxy.bulge_stars.mass = mbulge;
+		galaxy.bulge_stars.rscale = rbulge;
+		galaxy.sfr_disk = sfr;
+		return galaxy;
+	}
+
+	StarFormation::molecular_gas make_molgas(double m_atom, double m_mol)
+	{
+		return {m_mol, m_atom, 0, 0, 0, 0};
+	}
+
+public:
+
+	void test_bins()
+	{
+		SummaryStatistics stats(8, 12, 0.5);
+		TS_ASSERT_EQUALS(8, stats.n_bins);
+		TS_ASSERT_EQUALS(-1, stats.bin(0));
+		TS_ASSERT_EQUALS(-1, stats.bin(1e7));
+		TS_ASSERT_EQUALS(0, stats.bin(1e8));
+		TS_ASSERT_EQUALS(1, stats.bin(5e8));
+		TS_ASSERT_EQUALS(7, stats.bin(9e11));
+		TS_ASSERT_EQUALS(-1, stats.bin(1e12));
+		TS_ASSERT_DELTA(8.25, stats.bin_centres()[0], 1e-9);
+		TS_ASSERT_DELTA(11.75, stats.bin_centres()[7], 1e-9);
+
+		TS_ASSERT_THROWS(SummaryStatistics(8, 8, 0.5), invalid_argument);
+		TS_ASSERT_THROWS(SummaryStatistics(8, 12, 0), invalid_argument);
+	}
+
+	void test_add_and_merge()
+	{
+		SummaryStatistics stats1(8, 12, 1);
+		stats1.add(make_galaxy(1e9, 0.01, 1e9, 0.001, 2), make_molgas(2e8, 1e10));
+		stats1.add(make_galaxy(0, 0, 0, 0, 1), make_molgas(0, 0));
+
+		SummaryStatistics stats2(8, 12, 1);
+		stats2.add(make_galaxy(5e10, 0.1, 0, 0, 3), make_molgas(3e9, 0));
+
+		stats1.merge(stats2);
+		TS_ASSERT_EQUALS(3, stats1.n_galaxies);
+		TS_ASSERT_DELTA(6, stats1.total_sfr, 1e-9);
+		TS_ASSERT_EQUALS((std::vector<double> {0, 1, 1, 0}), stats1.stellar_mass_counts);
+		TS_ASSERT_EQUALS((std::vector<double> {1, 1, 0, 0}), stats1.atomic_mass_counts);
+		TS_ASSERT_EQUALS((std::vector<double> {0, 0, 1, 0}), stats1.molecular_mass_counts);
+
+		// sizes are mass-weighted between disk and bulge
+		TS_ASSERT_EQUALS((std::vector<double> {0, 1, 1, 0}), stats1.size_counts);
+		TS_ASSERT_DELTA(std::log10(0.0055), stats1.log_rstar_sum[1], 1e-6);
+		TS_ASSERT_DELTA(-1, stats1.log_rstar_sum[2], 1e-6);
+
+		TS_ASSERT_EQUALS((std::vector<double> {0, 1, 1, 0}), stats1.get("stellar_mass_function/counts", 100));
+		TS_ASSERT_EQUALS((std::vector<double> {0, 0.01, 0.01, 0}), stats1.get("stellar_mass_function/phi", 100));
+		TS_ASSERT_EQUALS((std::vector<double> {0.06}), stats1.get("sfr_density", 100));
+		TS_ASSERT_DELTA(-1, stats1.get("size_mass/mean_log_rstar", 100)[2], 1e-6);
+		TS_ASSERT_DELTA(0, stats1.get("size_mass/std_log_rstar", 100)[2], 1e-6);
+		TS_ASSERT_THROWS(stats1.get("unknown", 100), invalid_argument);
+
+		SummaryStatistics other_bins(8, 12, 0.5);
+		TS_ASSERT_THROWS(stats1.merge(other_bins), invalid_argument);
+	}
+
+	void test_weights()
+	{
+		SummaryStatistics stats(8, 12, 1);
+		stats.add(make_galaxy(1e9, 0.01, 0, 0, 2), make_molgas(2e8, 0), 4);
+		stats.add(make_galaxy(2e9, 0.1, 0, 0, 1), make_molgas(0, 0));
+		TS_ASSERT_EQUALS(2, stats.n_galaxies);
+		TS_ASSERT_DELTA(9, stats.total_sfr, 1e-9);
+		TS_ASSERT_EQUALS((std::vector<double> {0, 5, 0, 0}), stats.stellar_mass_counts);
+		TS_ASSERT_EQUALS((std::vector<double> {4, 0, 0, 0}), stats.atomic_mass_counts);
+		TS_ASSERT_EQUALS((std::vector<double> {0, 5, 0, 0}), stats.size_counts);
+		TS_ASSERT_DELTA(-1.8, stats.get("size_mass/mean_log_rstar", 100)[1], 1e-6);
+	}
+};
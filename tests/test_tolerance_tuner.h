@@ -0,0 +1,108 @@
+//
+// Tolerance tuner unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "tolerance_tuner.h"
+
+using namespace shark;
+
+class TestToleranceTuner : public CxxTest::TestSuite {
+
+private:
+
+	ToleranceTrial make_trial(double ode_solver_precision, Timer::duration millis, double deviation)
+	{
+		ToleranceTrial trial {{ode_solver_precision, 0.05}, 1000, millis, {}};
+		for (auto &property: ToleranceTuner::properties) {
+			trial.deviations[property] = 0;
+		}
+		trial.deviations["sfr_density"] = deviation;
+		return trial;
+	}
+
+public:
+
+	void test_invalid_tolerances()
+	{
+		Options options;
+		TS_ASSERT_THROWS(ToleranceTuner(options, 1, {}, {0.05}), invalid_argument);
+		TS_ASSERT_THROWS(ToleranceTuner(options, 1, {0.05}, {}), invalid_argument);
+		TS_ASSERT_THROWS(ToleranceTuner(options, 1, {0.05, 0}, {0.05}), invalid_argument);
+		TS_ASSERT_THROWS(ToleranceTuner(options, 1, {0.05}, {-0.05}), invalid_argument);
+	}
+
+	void test_deviation()
+	{
+		SummaryStatistics reference(8, 10, 1);
+		reference.stellar_mass_counts = {10, 10};
+		reference.total_sfr = 2;
+
+		auto stats = reference;
+		for (auto &property: ToleranceTuner::properties) {
+			TS_ASSERT_EQUALS(0, ToleranceTuner::deviation(stats, reference, property));
+		}
+
+		// One galaxy moving to the next bin changes two counts
+		stats.stellar_mass_counts = {9, 11};
+		stats.total_sfr = 2.1;
+		TS_ASSERT_DELTA(0.1, ToleranceTuner::deviation(stats, reference, "stellar_mass_function"), 1e-12);
+		TS_ASSERT_DELTA(0.05, ToleranceTuner::deviation(stats, reference, "sfr_density"), 1e-12);
+
+		// Anything that appears out of nothing is infinitely off
+		stats.atomic_mass_counts = {0, 1};
+		TS_ASSERT_EQUALS(std::numeric_limits<double>::infinity(), ToleranceTuner::deviation(stats, reference, "atomic_mass_function"));
+	}
+
+	void test_recommend()
+	{
+		std::vector<ToleranceTrial> trials {
+			make_trial(0.005, 100, 0),
+			make_trial(0.05, 60, 0.005),
+			make_trial(0.1, 40, 0.02),
+			make_trial(0.5, 70, 0.001)
+		};
+		TS_ASSERT_EQUALS(0.02, trials[2].max_deviation());
+		TS_ASSERT_EQUALS(1, ToleranceTuner::recommend(trials, 0.01));
+		TS_ASSERT_EQUALS(2, ToleranceTuner::recommend(trials, 0.1));
+		TS_ASSERT_EQUALS(0, ToleranceTuner::recommend(trials, 0));
+		TS_ASSERT_THROWS(ToleranceTuner::recommend({}, 0.01), invalid_argument);
+
+		std::ostringstream os;
+		ToleranceTuner::write_csv(os, trials, 1);
+		std::istringstream is(os.str());
+		std::string header, reference, recommended;
+		std::getline(is, header);
+		std::getline(is, reference);
+		std::getline(is, recommended);
+		TS_ASSERT_EQUALS("ode_solver_precision,accuracy_sf_eqs,ode_evaluations,millis,stellar_mass_function_deviation,"
+		                 "atomic_mass_function_deviation,molecular_mass_function_deviation,sfr_density_deviation,"
+		                 "max_deviation,recommended", header);
+		TS_ASSERT_EQUALS("0.005,0.05,1000,100,0,0,0,0,0,0", reference);
+		TS_ASSERT_EQUALS("0.05,0.05,1000,60,0,0,0,0.005,0.005,1", recommended);
+	}
+};
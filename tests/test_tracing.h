@@ -0,0 +1,141 @@
+//
+// Tracing unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cxxtest/TestSuite.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "tracing.h"
+
+using namespace shark;
+
+class TestTracing : public CxxTest::TestSuite
+{
+
+private:
+
+	/// Writes and parses the current trace, returning its complete events
+	std::vector<boost::property_tree::ptree> complete_events()
+	{
+		std::stringstream ss;
+		tracing::write_chrome_trace(ss, 3);
+		boost::property_tree::ptree trace;
+		boost::property_tree::read_json(ss, trace);
+		std::vector<boost::property_tree::ptree> events;
+		for (auto &e: trace.get_child("traceEvents")) {
+			if (e.second.get<std::string>("ph") == "X") {
+				events.push_back(e.second);
+			}
+		}
+		return events;
+	}
+
+public:
+
+	void setUp()
+	{
+		tracing::start();
+	}
+
+	void tearDown()
+	{
+		tracing::stop();
+	}
+
+	void test_events_are_recorded()
+	{
+		{
+			tracing::scoped_event outer("snapshot", "phase", "snapshot", 12);
+			tracing::scoped_event inner("evolve tree", "task");
+		}
+		auto events = complete_events();
+		TS_ASSERT_EQUALS(events.size(), 2);
+
+		// Inner events end first
+		TS_ASSERT_EQUALS(events[0].get<std::string>("name"), "evolve tree");
+		TS_ASSERT_EQUALS(events[0].get<std::string>("cat"), "task");
+		TS_ASSERT_EQUALS(events[0].count("args"), 0);
+		TS_ASSERT_EQUALS(events[1].get<std::string>("name"), "snapshot");
+		TS_ASSERT_EQUALS(events[1].get<int>("args.snapshot"), 12);
+		TS_ASSERT_EQUALS(events[1].get<int>("pid"), 3);
+		TS_ASSERT_LESS_THAN_EQUALS(events[1].get<double>("ts"), events[0].get<double>("ts"));
+		TS_ASSERT_LESS_THAN_EQUALS(events[0].get<double>("dur"), events[1].get<double>("dur"));
+	}
+
+	void test_nothing_is_recorded_when_disabled()
+	{
+		tracing::stop();
+		{
+			tracing::scoped_event event("import trees", "stage");
+		}
+		TS_ASSERT(!tracing::enabled());
+		TS_ASSERT_EQUALS(complete_events().size(), 0);
+	}
+
+	void test_start_discards_previous_events()
+	{
+		{
+			tracing::scoped_event event("import trees", "stage");
+		}
+		TS_ASSERT_EQUALS(complete_events().size(), 1);
+		tracing::start();
+		TS_ASSERT_EQUALS(complete_events().size(), 0);
+	}
+
+	void test_finish()
+	{
+		tracing::scoped_event event("read halos", "stage");
+		event.finish();
+		event.finish();
+		TS_ASSERT_EQUALS(complete_events().size(), 1);
+	}
+
+	void test_threads_have_their_own_events()
+	{
+		std::vector<std::thread> threads;
+		for (int t = 0; t != 4; t++) {
+			threads.emplace_back([t]() {
+				for (int i = 0; i != 100; i++) {
+					tracing::scoped_event event("evolve tree", "task", "tree", t * 100 + i);
+				}
+			});
+		}
+		for (auto &thread: threads) {
+			thread.join();
+		}
+
+		auto events = complete_events();
+		TS_ASSERT_EQUALS(events.size(), 400);
+
+		// Events of the same thread keep their order
+		for (std::size_t i = 0; i != events.size(); i++) {
+			auto tree = events[i].get<int>("args.tree");
+			auto first = events[i - i % 100];
+			TS_ASSERT_EQUALS(events[i].get<int>("tid"), first.get<int>("tid"));
+			TS_ASSERT_EQUALS(tree, first.get<int>("args.tree") + int(i % 100));
+		}
+	}
+};
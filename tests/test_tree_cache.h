@@ -0,0 +1,230 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cxxtest/TestSuite.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "components.h"
+#include "exceptions.h"
+#include "tree_cache.h"
+
+using namespace shark;
+
+class TestTreeCache : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string filename = "test_tree_cache.bin";
+
+	// A single tree with a halo at snapshot 11 hosting a central and a
+	// satellite subhalo, which descend from two halos at snapshot 10
+	std::vector<MergerTreePtr> make_trees()
+	{
+		auto tree = std::make_shared<MergerTree>(3);
+		tree->weight = 2.5;
+		auto d_halo = std::make_shared<Halo>(300, 11);
+		d_halo->Mvir = 1e12f;
+		d_halo->position = {1, 2, 3};
+		d_halo->merger_tree = tree;
+		tree->add_halo(d_halo);
+		for (Subhalo::id_t id: {100, 200}) {
+			auto halo = std::make_shared<Halo>(id, 10);
+			auto subhalo = std::make_shared<Subhalo>(id, 10);
+			subhalo->Mvir = id * 1e9f;
+			subhalo->host_halo = halo;
+			subhalo->has_descendant = true;
+			subhalo->main_progenitor = (id == 100);
+			halo->central_subhalo = subhalo;
+			halo->merger_tree = tree;
+			tree->add_halo(halo);
+
+			auto d_subhalo = std::make_shared<Subhalo>(id + 1000, 11);
+			d_subhalo->subhalo_type = (id == 100 ? Subhalo::CENTRAL : Subhalo::SATELLITE);
+			d_subhalo->accreted_mass = 5;
+			d_subhalo->L = {4, 5, 6};
+			d_subhalo->host_halo = d_halo;
+			if (id == 100) {
+				d_halo->central_subhalo = d_subhalo;
+			}
+			else {
+				d_halo->satellite_subhalos.push_back(d_subhalo);
+			}
+			d_subhalo->ascendants.push_back(subhalo);
+			subhalo->descendant = d_subhalo;
+			halo->descendant = d_halo;
+			d_halo->add_ascendant(halo);
+		}
+		return {tree};
+	}
+
+	TreeCache make_cache(std::uint64_t key)
+	{
+		TreeCache cache;
+		cache.key = key;
+		return cache;
+	}
+
+public:
+
+	void tearDown()
+	{
+		std::remove(filename.c_str());
+	}
+
+	void test_roundtrip()
+	{
+		auto original_trees = make_trees();
+		TotalBaryon original_baryons;
+		original_baryons.baryon_total_created[10] = 7;
+		original_baryons.baryon_total_pruned[10] = 3;
+		make_cache(1234).write(filename, original_trees, original_baryons);
+
+		std::vector<MergerTreePtr> trees;
+		TotalBaryon all_baryons;
+		TS_ASSERT(make_cache(1234).read(filename, trees, all_baryons, 2));
+		TS_ASSERT_EQUALS(all_baryons.baryon_total_created[10], 7);
+		TS_ASSERT_EQUALS(all_baryons.baryon_total_pruned[10], 3);
+		TS_ASSERT_EQUALS(trees.size(), 1);
+		auto &tree = trees[0];
+		TS_ASSERT_EQUALS(tree->id, 3);
+		TS_ASSERT_EQUALS(tree->weight, 2.5);
+		TS_ASSERT_EQUALS(tree->halos.size(), 2);
+		TS_ASSERT_EQUALS(tree->halos[10].size(), 2);
+		TS_ASSERT_EQUALS(tree->halos[11].size(), 1);
+
+		auto &d_halo = tree->halos[11][0];
+		TS_ASSERT_EQUALS(d_halo->id, 300);
+		TS_ASSERT_EQUALS(d_halo->Mvir, 1e12f);
+		TS_ASSERT_EQUALS(d_halo->position.z, 3);
+		TS_ASSERT_EQUALS(d_halo->merger_tree, tree);
+		TS_ASSERT_EQUALS(d_halo->central_subhalo->id, 1100);
+		TS_ASSERT_EQUALS(d_halo->satellite_subhalos.size(), 1);
+		TS_ASSERT_EQUALS(d_halo->satellite_subhalos[0]->id, 1200);
+		TS_ASSERT_EQUALS(d_halo->satellite_subhalos[0]->subhalo_type, Subhalo::SATELLITE);
+		TS_ASSERT_EQUALS(d_halo->subhalos().size(), 2);
+		TS_ASSERT_EQUALS(d_halo->ascendants.size(), 2);
+
+		for (std::size_t i = 0; i != 2; i++) {
+			auto &halo = tree->halos[10][i];
+			TS_ASSERT_EQUALS(halo->id, (i + 1) * 100);
+			TS_ASSERT_EQUALS(halo->descendant, d_halo);
+			TS_ASSERT_EQUALS(d_halo->ascendants[i], halo);
+			auto &subhalo = halo->central_subhalo;
+			TS_ASSERT_EQUALS(subhalo->host_halo, halo);
+			TS_ASSERT_EQUALS(subhalo->Mvir, (i + 1) * 100 * 1e9f);
+			TS_ASSERT_EQUALS(subhalo->main_progenitor, i == 0);
+			TS_ASSERT(subhalo->has_descendant);
+			auto &d_subhalo = subhalo->descendant;
+			TS_ASSERT_EQUALS(d_subhalo->host_halo, d_halo);
+			TS_ASSERT_EQUALS(d_subhalo->accreted_mass, 5);
+			TS_ASSERT_EQUALS(d_subhalo->L.y, 5);
+			TS_ASSERT_EQUALS(d_subhalo->ascendants.size(), 1);
+			TS_ASSERT_EQUALS(d_subhalo->ascendants[0], subhalo);
+		}
+	}
+
+	void test_roundtrip_in_memory()
+	{
+		auto original_trees = make_trees();
+		TotalBaryon original_baryons;
+		std::stringstream buffer;
+		make_cache(1234).write(buffer, "memory", original_trees, original_baryons);
+
+		// The same contents can be loaded many times over
+		for (int i = 0; i != 2; i++) {
+			buffer.clear();
+			buffer.seekg(0);
+			std::vector<MergerTreePtr> trees;
+			TotalBaryon all_baryons;
+			TS_ASSERT(make_cache(1234).read(buffer, "memory", trees, all_baryons, 1));
+			TS_ASSERT_EQUALS(trees.size(), 1);
+			TS_ASSERT_EQUALS(trees[0]->halos[11][0]->subhalos().size(), 2);
+			TS_ASSERT_DIFFERS(trees[0], original_trees[0]);
+		}
+	}
+
+	void test_roundtrip_local_placement()
+	{
+		// Each thread creates the structures of a different tree
+		auto original_trees = make_trees();
+		auto other_trees = make_trees();
+		original_trees.push_back(other_trees[0]);
+		TotalBaryon original_baryons;
+		std::stringstream buffer;
+		make_cache(1234).write(buffer, "memory", original_trees, original_baryons);
+
+		std::vector<MergerTreePtr> trees;
+		TotalBaryon all_baryons;
+		TS_ASSERT(make_cache(1234).read(buffer, "memory", trees, all_baryons, 2, true, true));
+		TS_ASSERT_EQUALS(trees.size(), 2);
+		for (auto &tree: trees) {
+			auto &d_halo = tree->halos[11][0];
+			TS_ASSERT_EQUALS(d_halo->merger_tree, tree);
+			TS_ASSERT_EQUALS(d_halo->subhalos().size(), 2);
+			TS_ASSERT_EQUALS(d_halo->ascendants.size(), 2);
+			for (auto &halo: tree->halos[10]) {
+				TS_ASSERT_EQUALS(halo->descendant, d_halo);
+				TS_ASSERT_EQUALS(halo->central_subhalo->descendant->host_halo, d_halo);
+			}
+		}
+	}
+
+	void test_different_key()
+	{
+		auto trees = make_trees();
+		TotalBaryon all_baryons;
+		make_cache(1234).write(filename, trees, all_baryons);
+
+		std::vector<MergerTreePtr> loaded_trees;
+		TS_ASSERT(!make_cache(4321).read(filename, loaded_trees, all_baryons, 1));
+		TS_ASSERT(loaded_trees.empty());
+	}
+
+	void test_missing_file()
+	{
+		std::vector<MergerTreePtr> trees;
+		TotalBaryon all_baryons;
+		TS_ASSERT(!make_cache(1234).read(filename, trees, all_baryons, 1));
+	}
+
+	void test_invalid_file()
+	{
+		std::ofstream(filename) << "not a tree cache";
+		std::vector<MergerTreePtr> trees;
+		TotalBaryon all_baryons;
+		TS_ASSERT_THROWS(make_cache(1234).read(filename, trees, all_baryons, 1), invalid_data);
+	}
+
+	void test_checksum()
+	{
+		std::ofstream(filename) << "some contents";
+		auto checksum = TreeCache::checksum(filename);
+		TS_ASSERT_EQUALS(checksum, TreeCache::checksum(filename));
+		std::ofstream(filename) << "other contents";
+		TS_ASSERT_DIFFERS(checksum, TreeCache::checksum(filename));
+	}
+};
@@ -0,0 +1,99 @@
+//
+// Mixins unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "components.h"
+#include "tree_index.h"
+
+using namespace shark;
+
+class TestTreeIndex : public CxxTest::TestSuite
+{
+
+private:
+
+	HaloPtr add_halo(const MergerTreePtr &tree, Halo::id_t id, int snapshot, int n_subhalos)
+	{
+		auto halo = std::make_shared<Halo>(id, snapshot);
+		for (int i = 0; i != n_subhalos; i++) {
+			auto subhalo = std::make_shared<Subhalo>(id * 10 + i, snapshot);
+			subhalo->host_halo = halo;
+			if (i == 0) {
+				halo->central_subhalo = subhalo;
+			}
+			else {
+				halo->satellite_subhalos.push_back(subhalo);
+			}
+		}
+		halo->merger_tree = tree;
+		tree->add_halo(halo);
+		return halo;
+	}
+
+	void link(const HaloPtr &halo, const HaloPtr &descendant)
+	{
+		halo->central_subhalo->descendant = descendant->central_subhalo;
+		halo->descendant = descendant;
+	}
+
+public:
+
+	void test_index()
+	{
+		// Tree 0 lives in snapshots 1 and 2, tree 1 only in snapshot 2
+		auto tree0 = std::make_shared<MergerTree>(0);
+		auto tree1 = std::make_shared<MergerTree>(1);
+		auto h1 = add_halo(tree0, 1, 1, 2);
+		auto h2 = add_halo(tree0, 2, 2, 1);
+		auto h3 = add_halo(tree1, 3, 2, 3);
+		link(h1, h2);
+
+		TreeIndex index({tree0, tree1});
+
+		TS_ASSERT_EQUALS(index.halos(1), std::vector<HaloPtr>({h1}));
+		TS_ASSERT_EQUALS(index.halos(2), std::vector<HaloPtr>({h2, h3}));
+		TS_ASSERT(index.halos(3).empty());
+
+		TS_ASSERT_EQUALS(index.tree_halos(1, 0).size(), 1);
+		TS_ASSERT(index.tree_halos(1, 1).empty());
+		TS_ASSERT_EQUALS(*index.tree_halos(2, 1).begin(), h3);
+		TS_ASSERT(index.tree_halos(5, 1).empty());
+
+		TS_ASSERT_EQUALS(index.subhalos(1).size(), 2);
+		TS_ASSERT_EQUALS(index.subhalos(2).size(), 4);
+		TS_ASSERT_EQUALS(*index.subhalos(2).begin(), h2->central_subhalo.get());
+
+		auto snapshot1 = index.at(1);
+		TS_ASSERT(snapshot1);
+		TS_ASSERT_EQUALS(snapshot1->host_halo, std::vector<TreeIndex::index_t>({0, 0}));
+		TS_ASSERT_EQUALS(snapshot1->descendant, std::vector<TreeIndex::index_t>({0, TreeIndex::none}));
+		auto snapshot2 = index.at(2);
+		TS_ASSERT_EQUALS(snapshot2->subhalo_offsets, std::vector<TreeIndex::index_t>({0, 1, 4}));
+		TS_ASSERT_EQUALS(snapshot2->host_halo, std::vector<TreeIndex::index_t>({0, 1, 1, 1}));
+
+		index.release_snapshot(1);
+		TS_ASSERT(!index.at(1));
+		TS_ASSERT(index.halos(1).empty());
+	}
+
+};
@@ -0,0 +1,180 @@
+//
+// Merger tree migration unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cxxtest/TestSuite.h>
+
+#include <sstream>
+#include <vector>
+
+#include "components.h"
+#include "exceptions.h"
+#include "tree_migration.h"
+
+using namespace shark;
+
+class TestTreeMigration : public CxxTest::TestSuite
+{
+
+private:
+
+	GalaxyPtr make_galaxy(Galaxy::id_t id, Galaxy::galaxy_type_t type)
+	{
+		auto galaxy = std::make_shared<Galaxy>(id);
+		galaxy->galaxy_type = type;
+		galaxy->disk_stars.mass = id * 1e8f;
+		return galaxy;
+	}
+
+	// A tree with a halo at snapshot 11, descending from a halo at snapshot
+	// 10, whose central subhalo hosts a central and a type 2 galaxy about to
+	// merge with it and whose satellite subhalo hosts a type 1 galaxy, plus
+	// a halo appearing at snapshot 12 with its initial galaxy
+	MergerTreePtr make_tree()
+	{
+		auto tree = std::make_shared<MergerTree>(5);
+		auto p_halo = std::make_shared<Halo>(100, 10);
+		auto p_subhalo = std::make_shared<Subhalo>(1000, 10);
+		p_halo->central_subhalo = p_subhalo;
+		p_subhalo->host_halo = p_halo;
+		p_halo->merger_tree = tree;
+		tree->add_halo(p_halo);
+
+		auto halo = std::make_shared<Halo>(300, 11);
+		auto central = std::make_shared<Subhalo>(3000, 11);
+		auto satellite = std::make_shared<Subhalo>(3001, 11);
+		central->subhalo_type = Subhalo::CENTRAL;
+		satellite->subhalo_type = Subhalo::SATELLITE;
+		central->host_halo = halo;
+		satellite->host_halo = halo;
+		central->hot_halo_gas.mass = 1e10f;
+		central->ascendants.push_back(p_subhalo);
+		p_subhalo->descendant = central;
+		halo->central_subhalo = central;
+		halo->satellite_subhalos.push_back(satellite);
+		halo->add_ascendant(p_halo);
+		p_halo->descendant = halo;
+		halo->merger_tree = tree;
+		tree->add_halo(halo);
+
+		central->galaxies.push_back(make_galaxy(7, Galaxy::CENTRAL));
+		auto merging = make_galaxy(9, Galaxy::TYPE2);
+		merging->descendant_id = 7;
+		merging->merger_age = 3;
+		central->galaxies.push_back(merging);
+		central->rebuild_merger_queue();
+		satellite->galaxies.push_back(make_galaxy(8, Galaxy::TYPE1));
+
+		auto new_halo = std::make_shared<Halo>(400, 12);
+		auto new_subhalo = std::make_shared<Subhalo>(4000, 12);
+		new_subhalo->host_halo = new_halo;
+		new_subhalo->hot_halo_gas.mass = 2e10f;
+		new_subhalo->galaxies.push_back(make_galaxy(20, Galaxy::CENTRAL));
+		new_halo->central_subhalo = new_subhalo;
+		new_halo->merger_tree = tree;
+		tree->add_halo(new_halo);
+		return tree;
+	}
+
+public:
+
+	void test_plan_transfers()
+	{
+		// Balanced enough, or a single process
+		TS_ASSERT(tree_migration::plan_transfers({10, 10, 11}, 1.1).empty());
+		TS_ASSERT(tree_migration::plan_transfers({10}, 1).empty());
+		TS_ASSERT(tree_migration::plan_transfers({0, 0}, 1).empty());
+
+		// The largest excess goes to the largest deficit first
+		auto transfers = tree_migration::plan_transfers({100, 20, 60, 60, 10}, 1.1);
+		TS_ASSERT_EQUALS(transfers.size(), 5);
+		TS_ASSERT_DELTA(transfers[0][4], 40, 1e-9);
+		TS_ASSERT_DELTA(transfers[0][1], 10, 1e-9);
+		TS_ASSERT_DELTA(transfers[2][1], 10, 1e-9);
+		TS_ASSERT_DELTA(transfers[3][1], 10, 1e-9);
+		double total = 0;
+		for (auto &row: transfers) {
+			for (auto amount: row) {
+				total += amount;
+			}
+		}
+		TS_ASSERT_DELTA(total, 70, 1e-9);
+	}
+
+	void test_select_trees()
+	{
+		// Trees that would overshoot a destination's planned cost stay
+		std::vector<double> costs {5, 30, 0, 10, 20};
+		auto destinations = tree_migration::select_trees(costs, {0, 25, 12});
+		TS_ASSERT_EQUALS(destinations, (std::vector<int> {1, -1, -1, 2, 1}));
+
+		TS_ASSERT_EQUALS(tree_migration::select_trees(costs, {0, 0, 0}), (std::vector<int> {-1, -1, -1, -1, -1}));
+	}
+
+	void test_roundtrip()
+	{
+		auto tree = make_tree();
+		std::stringstream buffer;
+		TS_ASSERT_THROWS(tree_migration::write_trees(buffer, "test", {tree}, 11), invalid_argument);
+
+		tree->release_snapshot(10);
+		buffer.str("");
+		tree_migration::write_trees(buffer, "test", {tree}, 11);
+
+		auto existing = std::make_shared<MergerTree>(1);
+		std::vector<MergerTreePtr> trees {existing};
+		Galaxy::id_t n_galaxy_ids = 100;
+		tree_migration::read_trees(buffer, "test", trees, n_galaxy_ids, 1);
+		TS_ASSERT_EQUALS(trees.size(), 2);
+		TS_ASSERT_EQUALS(trees[0], existing);
+		TS_ASSERT_EQUALS(n_galaxy_ids, 104);
+
+		auto &migrated = trees[1];
+		TS_ASSERT_EQUALS(migrated->id, 5);
+		TS_ASSERT_EQUALS(migrated->halos.size(), 2);
+		auto &halo = migrated->halos[11][0];
+		TS_ASSERT_EQUALS(halo->merger_tree, migrated);
+		TS_ASSERT(halo->ascendants.empty());
+
+		// Galaxies get new IDs in the order of their old ones, but keep
+		// their random keys
+		auto &central = halo->central_subhalo;
+		TS_ASSERT_DELTA(central->hot_halo_gas.mass, 1e10f, 1);
+		TS_ASSERT_EQUALS(central->galaxies.size(), 2);
+		TS_ASSERT_EQUALS(central->galaxies[0]->id, 100);
+		TS_ASSERT_EQUALS(central->galaxies[0]->random_key, 7);
+		TS_ASSERT_EQUALS(central->galaxies[0]->disk_stars.mass, 7e8f);
+		TS_ASSERT_EQUALS(central->galaxies[1]->id, 102);
+		TS_ASSERT_EQUALS(central->galaxies[1]->random_key, 9);
+		TS_ASSERT_EQUALS(central->galaxies[1]->galaxy_type, Galaxy::TYPE2);
+		TS_ASSERT_EQUALS(central->galaxies[1]->descendant_id, 100);
+		TS_ASSERT_EQUALS(central->galaxies[1]->merger_age, 3);
+		TS_ASSERT_EQUALS(central->remove_mergers(4).size(), 1);
+		auto &satellite = halo->satellite_subhalos[0];
+		TS_ASSERT_EQUALS(satellite->galaxies.size(), 1);
+		TS_ASSERT_EQUALS(satellite->galaxies[0]->id, 101);
+
+		auto &new_subhalo = migrated->halos[12][0]->central_subhalo;
+		TS_ASSERT_DELTA(new_subhalo->hot_halo_gas.mass, 2e10f, 1);
+		TS_ASSERT_EQUALS(new_subhalo->galaxies.size(), 1);
+		TS_ASSERT_EQUALS(new_subhalo->galaxies[0]->id, 103);
+	}
+
+};